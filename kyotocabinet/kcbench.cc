@@ -0,0 +1,805 @@
+/*************************************************************************************************
+ * The workload benchmark of the polymorphic database
+ *                                                               Copyright (C) 2009-2012 FAL Labs
+ * This file is part of Kyoto Cabinet.
+ * This program is free software: you can redistribute it and/or modify it under the terms of
+ * the GNU General Public License as published by the Free Software Foundation, either version
+ * 3 of the License, or any later version.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************************************/
+
+
+#include <kcpolydb.h>
+#include "cmdcommon.h"
+
+
+// constants
+enum {                                   // operation types
+  OPREAD,                                ///< reading a record
+  OPUPDATE,                              ///< updating an existing record
+  OPINSERT,                              ///< inserting a new record
+  OPSCAN,                                ///< scanning a range of records
+  OPRMW,                                 ///< reading and then updating a record
+  OPNUM                                  ///< number of operation types
+};
+enum {                                   // distributions
+  DISTFIXED,                             ///< fixed value
+  DISTUNIFORM,                           ///< uniform distribution
+  DISTZIPF,                              ///< scrambled zipfian distribution
+  DISTLATEST                             ///< zipfian distribution biased to recent records
+};
+const char* const OPNAMES[] = { "read", "update", "insert", "scan", "rmw" };
+const char* const DISTNAMES[] = { "fixed", "uniform", "zipf", "latest" };
+const double THETADEF = 0.99;            // default skew of zipfian distributions
+const int64_t VSIZDEF = 100;             // default size of each value
+const int64_t SLENDEF = 100;             // default maximum length of each scan
+
+
+// global variables
+const char* g_progname;                  // program name
+uint32_t g_randseed;                     // random seed
+int64_t g_memusage;                      // memory usage
+
+
+// random number generator of each worker
+class BenchRandom {
+ public:
+  explicit BenchRandom(uint64_t seed) : x_(123456789), y_(362436069), z_(521288629), w_(seed) {
+    for (int32_t i = 0; i < 16; i++) {
+      next();
+    }
+  }
+  uint64_t next() {
+    uint64_t t = x_ ^ (x_ << 11);
+    x_ = y_;
+    y_ = z_;
+    z_ = w_;
+    w_ = (w_ ^ (w_ >> 19)) ^ (t ^ (t >> 8));
+    return w_;
+  }
+  int64_t number(int64_t range) {
+    return (int64_t)((next() & kc::INT64MAX) % range);
+  }
+  double real() {
+    return (next() >> 11) / 9007199254740992.0;
+  }
+ private:
+  uint64_t x_;
+  uint64_t y_;
+  uint64_t z_;
+  uint64_t w_;
+};
+
+
+// generator of zipfian distribution
+class ZipfGenerator {
+ public:
+  ZipfGenerator(int64_t num, double theta) :
+      num_(num > 0 ? num : 1), theta_(theta), zetan_(0), alpha_(0), eta_(0), half_(0) {
+    for (int64_t i = 1; i <= num_; i++) {
+      zetan_ += 1.0 / std::pow((double)i, theta_);
+    }
+    double zeta2 = 1.0 + std::pow(0.5, theta_);
+    alpha_ = 1.0 / (1.0 - theta_);
+    eta_ = (1.0 - std::pow(2.0 / num_, 1.0 - theta_)) / (1.0 - zeta2 / zetan_);
+    half_ = std::pow(0.5, theta_);
+  }
+  int64_t next(BenchRandom* rnd) const {
+    double u = rnd->real();
+    double uz = u * zetan_;
+    if (uz < 1.0) return 0;
+    if (uz < 1.0 + half_) return num_ > 1 ? 1 : 0;
+    int64_t rv = (int64_t)(num_ * std::pow(eta_ * u - eta_ + 1.0, alpha_));
+    return rv < num_ ? rv : num_ - 1;
+  }
+ private:
+  int64_t num_;
+  double theta_;
+  double zetan_;
+  double alpha_;
+  double eta_;
+  double half_;
+};
+
+
+// histogram of latencies in nanoseconds
+class LatencyHistogram {
+ public:
+  LatencyHistogram() : buckets_((size_t)BUCKETNUM, 0), count_(0), sum_(0), max_(0) {}
+  void add(uint64_t ns) {
+    buckets_[index(ns)]++;
+    count_++;
+    sum_ += ns;
+    if (ns > max_) max_ = ns;
+  }
+  void merge(const LatencyHistogram& hist) {
+    for (size_t i = 0; i < BUCKETNUM; i++) {
+      buckets_[i] += hist.buckets_[i];
+    }
+    count_ += hist.count_;
+    sum_ += hist.sum_;
+    if (hist.max_ > max_) max_ = hist.max_;
+  }
+  uint64_t quantile(double q) const {
+    if (count_ < 1) return 0;
+    uint64_t rank = (uint64_t)(q * count_);
+    if (rank >= count_) rank = count_ - 1;
+    uint64_t acc = 0;
+    for (size_t i = 0; i < BUCKETNUM; i++) {
+      acc += buckets_[i];
+      if (acc > rank) {
+        uint64_t bound = upper(i);
+        return bound < max_ ? bound : max_;
+      }
+    }
+    return max_;
+  }
+  uint64_t count() const {
+    return count_;
+  }
+  double mean() const {
+    return count_ > 0 ? (double)sum_ / count_ : 0.0;
+  }
+  uint64_t max() const {
+    return max_;
+  }
+ private:
+  enum {
+    SUBBITS = 5,                         ///< bits of the sub-buckets of each power of two
+    SUBNUM = 1 << SUBBITS,               ///< number of the sub-buckets of each power of two
+    BUCKETNUM = 64 * SUBNUM              ///< number of all buckets
+  };
+  static size_t index(uint64_t ns) {
+    if (ns < SUBNUM * 2) return ns;
+    size_t msb = 0;
+    for (uint64_t v = ns; v > 1; v >>= 1) {
+      msb++;
+    }
+    size_t shift = msb - SUBBITS;
+    return (shift + 1) * SUBNUM + (size_t)(ns >> shift) - SUBNUM;
+  }
+  static uint64_t upper(size_t idx) {
+    if (idx < SUBNUM * 2) return idx;
+    size_t shift = idx / SUBNUM - 1;
+    return ((uint64_t)(SUBNUM + idx % SUBNUM + 1) << shift) - 1;
+  }
+  std::vector<uint64_t> buckets_;
+  uint64_t count_;
+  uint64_t sum_;
+  uint64_t max_;
+};
+
+
+// configuration of a workload
+struct Workload {
+  int64_t weights[OPNUM];                ///< weights of the operation types
+  int32_t kdist;                         ///< distribution of keys
+  double theta;                          ///< skew of zipfian distributions
+  bool seq;                              ///< whether keys are in insertion order
+  int64_t vmin;                          ///< minimum size of each value
+  int64_t vmax;                          ///< maximum size of each value
+  int32_t vdist;                         ///< distribution of value sizes
+  int64_t slen;                          ///< maximum length of each scan
+};
+
+
+// function prototypes
+int main(int argc, char** argv);
+static void usage();
+static void dberrprint(kc::BasicDB* db, int32_t line, const char* func);
+static uint64_t nanotime();
+static int32_t parsedist(const char* str);
+static bool setworkload(Workload* wl, const char* name);
+static std::string jsonescape(const char* str);
+static int32_t runload(int argc, char** argv);
+static int32_t runrun(int argc, char** argv);
+static int32_t procbench(const char* cmd, const char* path, int64_t opnum, int32_t thnum,
+                         int64_t warm, const Workload& wl, int32_t oflags, bool lv, bool json);
+
+
+// main routine
+int main(int argc, char** argv) {
+  g_progname = argv[0];
+  const char* ebuf = kc::getenv("KCRNDSEED");
+  g_randseed = ebuf ? (uint32_t)kc::atoi(ebuf) : (uint32_t)(kc::time() * 1000);
+  mysrand(g_randseed);
+  g_memusage = memusage();
+  kc::setstdiobin();
+  if (argc < 2) usage();
+  int32_t rv = 0;
+  if (!std::strcmp(argv[1], "load")) {
+    rv = runload(argc, argv);
+  } else if (!std::strcmp(argv[1], "run")) {
+    rv = runrun(argc, argv);
+  } else {
+    usage();
+  }
+  if (rv != 0) {
+    oprintf("FAILED: KCRNDSEED=%u PID=%ld", g_randseed, (long)kc::getpid());
+    for (int32_t i = 0; i < argc; i++) {
+      oprintf(" %s", argv[i]);
+    }
+    oprintf("\n\n");
+  }
+  return rv;
+}
+
+
+// print the usage and exit
+static void usage() {
+  eprintf("%s: workload benchmark of the polymorphic database of Kyoto Cabinet\n", g_progname);
+  eprintf("\n");
+  eprintf("usage:\n");
+  eprintf("  %s load [-th num] [-seq] [-vsiz num] [-vmin num] [-vdist str] [-theta num]"
+          " [-oat|-oas|-onl|-otl|-onr] [-lv] [-json] path rnum\n", g_progname);
+  eprintf("  %s run [-th num] [-warm num] [-wl str] [-read num] [-update num] [-insert num]"
+          " [-scan num] [-rmw num] [-dist str] [-theta num] [-seq] [-vsiz num] [-vmin num]"
+          " [-vdist str] [-slen num] [-oat|-oas|-onl|-otl|-onr] [-lv] [-json]"
+          " path opnum\n", g_progname);
+  eprintf("\n");
+  std::exit(1);
+}
+
+
+// print the error message of a database
+static void dberrprint(kc::BasicDB* db, int32_t line, const char* func) {
+  const kc::BasicDB::Error& err = db->error();
+  oprintf("%s: %d: %s: %s: %d: %s: %s\n",
+          g_progname, line, func, db->path().c_str(), err.code(), err.name(), err.message());
+}
+
+
+// get the time of a monotonic clock in nanoseconds
+static uint64_t nanotime() {
+#if defined(_SYS_MSVC_) || defined(_SYS_MINGW_)
+  return (uint64_t)(kc::time() * 1000000000.0);
+#else
+  struct ::timespec ts;
+  if (::clock_gettime(CLOCK_MONOTONIC, &ts) != 0) return (uint64_t)(kc::time() * 1000000000.0);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+
+// parse the name of a distribution
+static int32_t parsedist(const char* str) {
+  for (int32_t i = 0; i < (int32_t)(sizeof(DISTNAMES) / sizeof(*DISTNAMES)); i++) {
+    if (!kc::stricmp(str, DISTNAMES[i])) return i;
+  }
+  return -1;
+}
+
+
+// set the operation mix of a predefined workload
+static bool setworkload(Workload* wl, const char* name) {
+  int64_t read = 0;
+  int64_t update = 0;
+  int64_t insert = 0;
+  int64_t scan = 0;
+  int64_t rmw = 0;
+  int32_t kdist = DISTZIPF;
+  switch (std::tolower(*(unsigned char*)name)) {
+    case 'a': read = 50; update = 50; break;
+    case 'b': read = 95; update = 5; break;
+    case 'c': read = 100; break;
+    case 'd': read = 95; insert = 5; kdist = DISTLATEST; break;
+    case 'e': scan = 95; insert = 5; break;
+    case 'f': read = 50; rmw = 50; break;
+    default: return false;
+  }
+  if (name[1] != '\0') return false;
+  wl->weights[OPREAD] = read;
+  wl->weights[OPUPDATE] = update;
+  wl->weights[OPINSERT] = insert;
+  wl->weights[OPSCAN] = scan;
+  wl->weights[OPRMW] = rmw;
+  wl->kdist = kdist;
+  return true;
+}
+
+
+// escape a string for JSON
+static std::string jsonescape(const char* str) {
+  std::string rv;
+  for (const unsigned char* rp = (const unsigned char*)str; *rp != '\0'; rp++) {
+    if (*rp == '"' || *rp == '\\') {
+      rv.push_back('\\');
+      rv.push_back(*rp);
+    } else if (*rp < 0x20) {
+      kc::strprintf(&rv, "\\u%04x", *rp);
+    } else {
+      rv.push_back(*rp);
+    }
+  }
+  return rv;
+}
+
+
+// parse arguments of load command
+static int32_t runload(int argc, char** argv) {
+  bool argbrk = false;
+  const char* path = NULL;
+  const char* rstr = NULL;
+  int32_t thnum = 1;
+  Workload wl;
+  std::memset(wl.weights, 0, sizeof(wl.weights));
+  wl.weights[OPINSERT] = 1;
+  wl.kdist = DISTUNIFORM;
+  wl.theta = THETADEF;
+  wl.seq = false;
+  wl.vmin = -1;
+  wl.vmax = VSIZDEF;
+  wl.vdist = DISTFIXED;
+  wl.slen = SLENDEF;
+  int32_t oflags = 0;
+  bool lv = false;
+  bool json = false;
+  for (int32_t i = 2; i < argc; i++) {
+    if (!argbrk && argv[i][0] == '-') {
+      if (!std::strcmp(argv[i], "--")) {
+        argbrk = true;
+      } else if (!std::strcmp(argv[i], "-th")) {
+        if (++i >= argc) usage();
+        thnum = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-seq")) {
+        wl.seq = true;
+      } else if (!std::strcmp(argv[i], "-vsiz")) {
+        if (++i >= argc) usage();
+        wl.vmax = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-vmin")) {
+        if (++i >= argc) usage();
+        wl.vmin = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-vdist")) {
+        if (++i >= argc) usage();
+        wl.vdist = parsedist(argv[i]);
+      } else if (!std::strcmp(argv[i], "-theta")) {
+        if (++i >= argc) usage();
+        wl.theta = kc::atof(argv[i]);
+      } else if (!std::strcmp(argv[i], "-oat")) {
+        oflags |= kc::PolyDB::OAUTOTRAN;
+      } else if (!std::strcmp(argv[i], "-oas")) {
+        oflags |= kc::PolyDB::OAUTOSYNC;
+      } else if (!std::strcmp(argv[i], "-onl")) {
+        oflags |= kc::PolyDB::ONOLOCK;
+      } else if (!std::strcmp(argv[i], "-otl")) {
+        oflags |= kc::PolyDB::OTRYLOCK;
+      } else if (!std::strcmp(argv[i], "-onr")) {
+        oflags |= kc::PolyDB::ONOREPAIR;
+      } else if (!std::strcmp(argv[i], "-lv")) {
+        lv = true;
+      } else if (!std::strcmp(argv[i], "-json")) {
+        json = true;
+      } else {
+        usage();
+      }
+    } else if (!path) {
+      argbrk = true;
+      path = argv[i];
+    } else if (!rstr) {
+      rstr = argv[i];
+    } else {
+      usage();
+    }
+  }
+  if (!path || !rstr) usage();
+  int64_t rnum = kc::atoix(rstr);
+  if (wl.vmin < 0) wl.vmin = wl.vdist == DISTFIXED ? wl.vmax : 0;
+  if (rnum < 1 || thnum < 1 || wl.vmin > wl.vmax || wl.vdist < 0 || wl.vdist == DISTLATEST ||
+      wl.theta <= 0 || wl.theta >= 1) usage();
+  if (thnum > THREADMAX) thnum = THREADMAX;
+  int32_t rv = procbench("load", path, rnum, thnum, 0, wl, oflags, lv, json);
+  return rv;
+}
+
+
+// parse arguments of run command
+static int32_t runrun(int argc, char** argv) {
+  bool argbrk = false;
+  const char* path = NULL;
+  const char* ostr = NULL;
+  int32_t thnum = 1;
+  int64_t warm = 0;
+  Workload wl;
+  setworkload(&wl, "a");
+  wl.theta = THETADEF;
+  wl.seq = false;
+  wl.vmin = -1;
+  wl.vmax = VSIZDEF;
+  wl.vdist = DISTFIXED;
+  wl.slen = SLENDEF;
+  bool mixed = false;
+  int32_t oflags = 0;
+  bool lv = false;
+  bool json = false;
+  for (int32_t i = 2; i < argc; i++) {
+    if (!argbrk && argv[i][0] == '-') {
+      if (!std::strcmp(argv[i], "--")) {
+        argbrk = true;
+      } else if (!std::strcmp(argv[i], "-th")) {
+        if (++i >= argc) usage();
+        thnum = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-warm")) {
+        if (++i >= argc) usage();
+        warm = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-wl")) {
+        if (++i >= argc) usage();
+        if (!setworkload(&wl, argv[i])) usage();
+      } else if (!std::strcmp(argv[i], "-read") || !std::strcmp(argv[i], "-update") ||
+                 !std::strcmp(argv[i], "-insert") || !std::strcmp(argv[i], "-scan") ||
+                 !std::strcmp(argv[i], "-rmw")) {
+        if (!mixed) {
+          std::memset(wl.weights, 0, sizeof(wl.weights));
+          mixed = true;
+        }
+        int32_t op = 0;
+        while (std::strcmp(argv[i] + 1, OPNAMES[op])) {
+          op++;
+        }
+        if (++i >= argc) usage();
+        wl.weights[op] = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-dist")) {
+        if (++i >= argc) usage();
+        wl.kdist = parsedist(argv[i]);
+      } else if (!std::strcmp(argv[i], "-theta")) {
+        if (++i >= argc) usage();
+        wl.theta = kc::atof(argv[i]);
+      } else if (!std::strcmp(argv[i], "-seq")) {
+        wl.seq = true;
+      } else if (!std::strcmp(argv[i], "-vsiz")) {
+        if (++i >= argc) usage();
+        wl.vmax = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-vmin")) {
+        if (++i >= argc) usage();
+        wl.vmin = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-vdist")) {
+        if (++i >= argc) usage();
+        wl.vdist = parsedist(argv[i]);
+      } else if (!std::strcmp(argv[i], "-slen")) {
+        if (++i >= argc) usage();
+        wl.slen = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-oat")) {
+        oflags |= kc::PolyDB::OAUTOTRAN;
+      } else if (!std::strcmp(argv[i], "-oas")) {
+        oflags |= kc::PolyDB::OAUTOSYNC;
+      } else if (!std::strcmp(argv[i], "-onl")) {
+        oflags |= kc::PolyDB::ONOLOCK;
+      } else if (!std::strcmp(argv[i], "-otl")) {
+        oflags |= kc::PolyDB::OTRYLOCK;
+      } else if (!std::strcmp(argv[i], "-onr")) {
+        oflags |= kc::PolyDB::ONOREPAIR;
+      } else if (!std::strcmp(argv[i], "-lv")) {
+        lv = true;
+      } else if (!std::strcmp(argv[i], "-json")) {
+        json = true;
+      } else {
+        usage();
+      }
+    } else if (!path) {
+      argbrk = true;
+      path = argv[i];
+    } else if (!ostr) {
+      ostr = argv[i];
+    } else {
+      usage();
+    }
+  }
+  if (!path || !ostr) usage();
+  int64_t opnum = kc::atoix(ostr);
+  int64_t wsum = 0;
+  for (int32_t i = 0; i < OPNUM; i++) {
+    if (wl.weights[i] < 0) usage();
+    wsum += wl.weights[i];
+  }
+  if (wl.vmin < 0) wl.vmin = wl.vdist == DISTFIXED ? wl.vmax : 0;
+  if (opnum < 1 || thnum < 1 || warm < 0 || wsum < 1 || wl.kdist < DISTUNIFORM ||
+      wl.vmin > wl.vmax || wl.vdist < 0 || wl.vdist == DISTLATEST || wl.slen < 1 ||
+      wl.theta <= 0 || wl.theta >= 1) usage();
+  if (thnum > THREADMAX) thnum = THREADMAX;
+  int32_t rv = procbench("run", path, opnum, thnum, warm, wl, oflags, lv, json);
+  return rv;
+}
+
+
+// perform load and run commands
+static int32_t procbench(const char* cmd, const char* path, int64_t opnum, int32_t thnum,
+                         int64_t warm, const Workload& wl, int32_t oflags, bool lv, bool json) {
+  if (!json) {
+    oprintf("<Workload Benchmark>\n  seed=%u  cmd=%s  path=%s  opnum=%lld  thnum=%d  warm=%lld\n"
+            "  read=%lld  update=%lld  insert=%lld  scan=%lld  rmw=%lld  dist=%s  theta=%.3f"
+            "  seq=%d\n  vmin=%lld  vmax=%lld  vdist=%s  slen=%lld  oflags=%d  lv=%d\n\n",
+            g_randseed, cmd, path, (long long)opnum, thnum, (long long)warm,
+            (long long)wl.weights[OPREAD], (long long)wl.weights[OPUPDATE],
+            (long long)wl.weights[OPINSERT], (long long)wl.weights[OPSCAN],
+            (long long)wl.weights[OPRMW], DISTNAMES[wl.kdist], wl.theta, wl.seq,
+            (long long)wl.vmin, (long long)wl.vmax, DISTNAMES[wl.vdist], (long long)wl.slen,
+            oflags, lv);
+  }
+  bool err = false;
+  bool load = !std::strcmp(cmd, "load");
+  kc::PolyDB db;
+  if (!json) oprintf("opening the database:\n");
+  double stime = kc::time();
+  db.tune_logger(stdlogger(g_progname, &std::cout),
+                 lv ? kc::UINT32MAX : kc::BasicDB::Logger::WARN | kc::BasicDB::Logger::ERROR);
+  uint32_t omode = kc::PolyDB::OWRITER | kc::PolyDB::OCREATE;
+  if (load) omode |= kc::PolyDB::OTRUNCATE;
+  if (!db.open(path, omode | oflags)) {
+    dberrprint(&db, __LINE__, "DB::open");
+    return 1;
+  }
+  double etime = kc::time();
+  if (!json) oprintf("time: %.3f\n", etime - stime);
+  int64_t rnum = db.count();
+  if (rnum < 0) {
+    dberrprint(&db, __LINE__, "DB::count");
+    err = true;
+    rnum = 0;
+  }
+  kc::AtomicInt64 inscnt(rnum);
+  ZipfGenerator kzipf(wl.kdist >= DISTZIPF ? (rnum > 0 ? rnum : opnum) : 1, wl.theta);
+  ZipfGenerator vzipf(wl.vdist == DISTZIPF ? wl.vmax - wl.vmin + 1 : 1, wl.theta);
+  class Worker : public kc::Thread {
+   public:
+    Worker() : hists_(OPNUM), misses_(0), err_(false) {}
+    void setparams(int32_t id, kc::PolyDB* db, int64_t opnum, const Workload* wl,
+                   kc::AtomicInt64* inscnt, const ZipfGenerator* kzipf,
+                   const ZipfGenerator* vzipf, const char* vbuf, bool quiet) {
+      id_ = id;
+      db_ = db;
+      opnum_ = opnum;
+      wl_ = wl;
+      inscnt_ = inscnt;
+      kzipf_ = kzipf;
+      vzipf_ = vzipf;
+      vbuf_ = vbuf;
+      quiet_ = quiet;
+      for (int32_t i = 0; i < OPNUM; i++) {
+        hists_[i] = LatencyHistogram();
+      }
+      misses_ = 0;
+    }
+    bool error() {
+      return err_;
+    }
+    const LatencyHistogram& histogram(int32_t op) {
+      return hists_[op];
+    }
+    int64_t misses() {
+      return misses_;
+    }
+    void run() {
+      BenchRandom rnd(((uint64_t)g_randseed << 16) + id_ * 0x9e3779b97f4a7c15ULL + opnum_);
+      int64_t wsum = 0;
+      for (int32_t i = 0; i < OPNUM; i++) {
+        wsum += wl_->weights[i];
+      }
+      for (int64_t i = 0; !err_ && i < opnum_; i++) {
+        int64_t sel = rnd.number(wsum);
+        int32_t op = 0;
+        while (sel >= wl_->weights[op]) {
+          sel -= wl_->weights[op];
+          op++;
+        }
+        char kbuf[RECBUFSIZ];
+        size_t ksiz = 0;
+        if (op == OPINSERT) {
+          ksiz = keystr(kbuf, inscnt_->add(1));
+        } else {
+          int64_t cnt = inscnt_->get();
+          ksiz = keystr(kbuf, cnt > 0 ? ordinal(&rnd, cnt) : 0);
+        }
+        size_t vsiz = valsiz(&rnd);
+        const char* vbuf = vbuf_ + rnd.number(wl_->vmax - vsiz + 1);
+        uint64_t stime = nanotime();
+        switch (op) {
+          case OPREAD: {
+            size_t rsiz;
+            char* rbuf = db_->get(kbuf, ksiz, &rsiz);
+            if (rbuf) {
+              delete[] rbuf;
+            } else {
+              miss(__LINE__, "DB::get");
+            }
+            break;
+          }
+          case OPUPDATE:
+          case OPINSERT: {
+            if (!db_->set(kbuf, ksiz, vbuf, vsiz)) {
+              dberrprint(db_, __LINE__, "DB::set");
+              err_ = true;
+            }
+            break;
+          }
+          case OPSCAN: {
+            int64_t len = rnd.number(wl_->slen) + 1;
+            kc::PolyDB::Cursor* cur = db_->cursor();
+            if (cur->jump(kbuf, ksiz)) {
+              for (int64_t j = 0; j < len; j++) {
+                size_t rksiz, rvsiz;
+                const char* rvbuf;
+                char* rkbuf = cur->get(&rksiz, &rvbuf, &rvsiz, true);
+                if (!rkbuf) break;
+                delete[] rkbuf;
+              }
+              if (db_->error() != kc::BasicDB::Error::SUCCESS &&
+                  db_->error() != kc::BasicDB::Error::NOREC) {
+                dberrprint(db_, __LINE__, "Cursor::get");
+                err_ = true;
+              }
+            } else {
+              miss(__LINE__, "Cursor::jump");
+            }
+            delete cur;
+            break;
+          }
+          case OPRMW: {
+            size_t rsiz;
+            char* rbuf = db_->get(kbuf, ksiz, &rsiz);
+            if (rbuf) {
+              delete[] rbuf;
+              if (!db_->set(kbuf, ksiz, vbuf, vsiz)) {
+                dberrprint(db_, __LINE__, "DB::set");
+                err_ = true;
+              }
+            } else {
+              miss(__LINE__, "DB::get");
+            }
+            break;
+          }
+        }
+        hists_[op].add(nanotime() - stime);
+        if (!quiet_ && id_ < 1 && opnum_ > 250 && (i + 1) % (opnum_ / 250) == 0) {
+          oputchar('.');
+          if (i + 1 == opnum_ || (i + 1) % (opnum_ / 10) == 0)
+            oprintf(" (%08lld)\n", (long long)(i + 1));
+        }
+      }
+    }
+   private:
+    size_t keystr(char* kbuf, int64_t ord) {
+      uint64_t num = wl_->seq ? (uint64_t)ord : kc::hashfnv(&ord, sizeof(ord));
+      return std::sprintf(kbuf, "user%020llu", (unsigned long long)num);
+    }
+    int64_t ordinal(BenchRandom* rnd, int64_t cnt) {
+      switch (wl_->kdist) {
+        case DISTZIPF: {
+          int64_t num = kzipf_->next(rnd);
+          return (int64_t)(kc::hashfnv(&num, sizeof(num)) % (uint64_t)cnt);
+        }
+        case DISTLATEST: {
+          return cnt - 1 - kzipf_->next(rnd) % cnt;
+        }
+      }
+      return rnd->number(cnt);
+    }
+    size_t valsiz(BenchRandom* rnd) {
+      switch (wl_->vdist) {
+        case DISTUNIFORM: return wl_->vmin + rnd->number(wl_->vmax - wl_->vmin + 1);
+        case DISTZIPF: return wl_->vmin + vzipf_->next(rnd);
+      }
+      return wl_->vmax;
+    }
+    void miss(int32_t line, const char* func) {
+      if (db_->error() == kc::BasicDB::Error::NOREC) {
+        misses_++;
+      } else {
+        dberrprint(db_, line, func);
+        err_ = true;
+      }
+    }
+    int32_t id_;
+    kc::PolyDB* db_;
+    int64_t opnum_;
+    const Workload* wl_;
+    kc::AtomicInt64* inscnt_;
+    const ZipfGenerator* kzipf_;
+    const ZipfGenerator* vzipf_;
+    const char* vbuf_;
+    bool quiet_;
+    std::vector<LatencyHistogram> hists_;
+    int64_t misses_;
+    bool err_;
+  };
+  char* vbuf = new char[wl.vmax + 1];
+  for (int64_t i = 0; i <= wl.vmax; i++) {
+    vbuf[i] = 'a' + myrand(26);
+  }
+  Worker* workers = new Worker[thnum];
+  double btime = 0;
+  for (int32_t pass = 0; !err && pass < 2; pass++) {
+    int64_t num = pass == 0 ? warm : opnum;
+    if (num < 1) continue;
+    if (!json) oprintf(pass == 0 ? "warming up:\n" : load ? "loading:\n" : "running:\n");
+    stime = kc::time();
+    for (int32_t i = 0; i < thnum; i++) {
+      workers[i].setparams(i, &db, num / thnum + (i < num % thnum),
+                           &wl, &inscnt, &kzipf, &vzipf, vbuf, json);
+    }
+    if (thnum < 2) {
+      workers[0].run();
+    } else {
+      for (int32_t i = 0; i < thnum; i++) {
+        workers[i].start();
+      }
+      for (int32_t i = 0; i < thnum; i++) {
+        workers[i].join();
+      }
+    }
+    for (int32_t i = 0; i < thnum; i++) {
+      if (workers[i].error()) err = true;
+    }
+    etime = kc::time();
+    btime = etime - stime;
+    if (!json) oprintf("time: %.3f\n", btime);
+  }
+  LatencyHistogram hists[OPNUM];
+  int64_t misses = 0;
+  for (int32_t i = 0; i < thnum; i++) {
+    for (int32_t j = 0; j < OPNUM; j++) {
+      hists[j].merge(workers[i].histogram(j));
+    }
+    misses += workers[i].misses();
+  }
+  delete[] workers;
+  delete[] vbuf;
+  int64_t count = db.count();
+  if (!json) oprintf("closing the database:\n");
+  stime = kc::time();
+  if (!db.close()) {
+    dberrprint(&db, __LINE__, "DB::close");
+    err = true;
+  }
+  etime = kc::time();
+  if (!json) oprintf("time: %.3f\n", etime - stime);
+  double tput = btime > 0 ? opnum / btime : 0.0;
+  if (json) {
+    std::string str;
+    kc::strprintf(&str, "{\"command\":\"%s\",\"path\":\"%s\",\"seed\":%u,\"opnum\":%lld,"
+                  "\"thnum\":%d,\"warm\":%lld,\"dist\":\"%s\",\"theta\":%.3f,\"seq\":%s,"
+                  "\"vmin\":%lld,\"vmax\":%lld,\"vdist\":\"%s\",\"slen\":%lld,",
+                  cmd, jsonescape(path).c_str(), g_randseed, (long long)opnum, thnum,
+                  (long long)warm, DISTNAMES[wl.kdist], wl.theta, wl.seq ? "true" : "false",
+                  (long long)wl.vmin, (long long)wl.vmax, DISTNAMES[wl.vdist],
+                  (long long)wl.slen);
+    kc::strprintf(&str, "\"time\":%.6f,\"throughput\":%.3f,\"count\":%lld,\"misses\":%lld,"
+                  "\"error\":%s,\"operations\":{", btime, tput, (long long)count,
+                  (long long)misses, err ? "true" : "false");
+    bool first = true;
+    for (int32_t i = 0; i < OPNUM; i++) {
+      if (wl.weights[i] < 1) continue;
+      const LatencyHistogram& hist = hists[i];
+      if (!first) str.append(",");
+      first = false;
+      kc::strprintf(&str, "\"%s\":{\"count\":%llu,\"mean\":%.3f,\"p50\":%.3f,\"p99\":%.3f,"
+                    "\"p999\":%.3f,\"max\":%.3f}", OPNAMES[i],
+                    (unsigned long long)hist.count(), hist.mean() / 1000.0,
+                    hist.quantile(0.5) / 1000.0, hist.quantile(0.99) / 1000.0,
+                    hist.quantile(0.999) / 1000.0, hist.max() / 1000.0);
+    }
+    str.append("}}\n");
+    oprintf("%s", str.c_str());
+  } else {
+    oprintf("count: %lld\n", (long long)count);
+    oprintf("misses: %lld\n", (long long)misses);
+    oprintf("throughput: %.3f ops/sec\n", tput);
+    oprintf("latency (usec):\n");
+    for (int32_t i = 0; i < OPNUM; i++) {
+      if (wl.weights[i] < 1) continue;
+      const LatencyHistogram& hist = hists[i];
+      oprintf("  %-6s count=%llu  mean=%.3f  p50=%.3f  p99=%.3f  p99.9=%.3f  max=%.3f\n",
+              OPNAMES[i], (unsigned long long)hist.count(), hist.mean() / 1000.0,
+              hist.quantile(0.5) / 1000.0, hist.quantile(0.99) / 1000.0,
+              hist.quantile(0.999) / 1000.0, hist.max() / 1000.0);
+    }
+    oprintf("%s\n\n", err ? "error" : "ok");
+  }
+  return err ? 1 : 0;
+}
+
+
+
+// END OF FILE
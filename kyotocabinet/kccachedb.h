@@ -27,6 +27,8 @@
 #include <kcdb.h>
 #include <kcplantdb.h>
 
+#define KCCDBIMGMAGIC  "KCCI\n"          ///< magic data of the memory image file
+
 namespace kyotocabinet {                 // common namespace
 
 
@@ -51,7 +53,9 @@ class CacheDB : public BasicDB {
   class Repeater;
   class Setter;
   class Remover;
+  class Expirer;
   class ScopedVisitor;
+  class ImageWriter;
   /** An alias of list of cursors. */
   typedef std::list<Cursor*> CursorList;
   /** An alias of list of transaction logs. */
@@ -62,6 +66,10 @@ class CacheDB : public BasicDB {
   static const size_t DEFBNUM = 1048583LL;
   /** The mininum number of buckets to use mmap. */
   static const size_t ZMAPBNUM = 32768;
+  /** The default maximum load factor of the hash table. */
+  static const int32_t DEFLFMAX = 4;
+  /** The number of old buckets migrated by each operation under resizing. */
+  static const size_t RSZSTEP = 8;
   /** The maximum size of each key. */
   static const uint32_t KSIZMAX = 0xfffff;
   /** The size of the record buffer. */
@@ -70,6 +78,14 @@ class CacheDB : public BasicDB {
   static const size_t OPAQUESIZ = 16;
   /** The threshold of busy loop and sleep for locking. */
   static const uint32_t LOCKBUSYLOOP = 8192;
+  /** The size of the header of the memory image. */
+  static const size_t IMGHEADSIZ = 32;
+  /** The size of the header of each slot in the memory image. */
+  static const size_t IMGSLOTSIZ = 32;
+  /** The alignment of each record in the memory image. */
+  static const size_t IMGALIGN = 8;
+  /** The unit size of the memory image IO. */
+  static const size_t IMGIOUNIT = 1 << 20;
  public:
   /**
    * Cursor to indicate a record.
@@ -194,6 +210,7 @@ class CacheDB : public BasicDB {
       int32_t sidx = hash % SLOTNUM;
       hash /= SLOTNUM;
       Slot* slot = db_->slots_ + sidx;
+      if (slot->obuckets) db_->migrate_bucket(slot, hash % slot->obnum);
       size_t bidx = hash % slot->bnum;
       Record* rec = slot->buckets[bidx];
       Record** entp = slot->buckets + bidx;
@@ -360,7 +377,8 @@ class CacheDB : public BasicDB {
   enum Option {
     TSMALL = 1 << 0,                     ///< dummy for compatibility
     TLINEAR = 1 << 1,                    ///< dummy for compatibility
-    TCOMPRESS = 1 << 2                   ///< compress each record
+    TCOMPRESS = 1 << 2,                  ///< compress each record
+    TNUMA = 1 << 3                       ///< bind slot bucket arrays to NUMA nodes
   };
   /**
    * Status flags.
@@ -375,8 +393,9 @@ class CacheDB : public BasicDB {
   explicit CacheDB() :
       mlock_(), flock_(), error_(), logger_(NULL), logkinds_(0), mtrigger_(NULL),
       omode_(0), curs_(), path_(""), type_(TYPECACHE),
-      opts_(0), bnum_(DEFBNUM), capcnt_(-1), capsiz_(-1),
-      opaque_(), embcomp_(ZLIBRAWCOMP), comp_(NULL), slots_(), rttmode_(true), tran_(false) {
+      opts_(0), bnum_(DEFBNUM), lfmax_(DEFLFMAX), capcnt_(-1), capsiz_(-1), xtwidth_(0),
+      opaque_(), embcomp_(ZLIBRAWCOMP), comp_(NULL), nodenum_(0), slots_(),
+      rttmode_(true), tran_(false) {
     _assert_(true);
   }
   /**
@@ -727,6 +746,8 @@ class CacheDB : public BasicDB {
    * CacheDB::OTRYLOCK, which means locking is performed without blocking, CacheDB::ONOREPAIR,
    * which means the database file is not repaired implicitly even if file destruction is
    * detected.
+   * CacheDB::OREADBIAS may also be added to bias the lock of the database object to readers,
+   * which makes reading operations cheaper and updating operations dearer.
    * @return true on success, or false on failure.
    * @note Every opened database must be closed by the CacheDB::close method when it is no
    * longer in use.  It is not allowed for two or more database objects in the same process to
@@ -735,6 +756,7 @@ class CacheDB : public BasicDB {
   bool open(const std::string& path, uint32_t mode = OWRITER | OCREATE) {
     _assert_(true);
     ScopedRWLock lock(&mlock_, true);
+    mlock_.set_bias(mode & OREADBIAS);
     if (omode_ != 0) {
       set_error(_KCCODELINE_, Error::INVALID, "already opened");
       return false;
@@ -747,6 +769,11 @@ class CacheDB : public BasicDB {
     size_t capsiz = capsiz_ > 0 ? capsiz_ / SLOTNUM + 1 : (1ULL << (sizeof(capsiz) * 8 - 1));
     if (capsiz > sizeof(*this) / SLOTNUM) capsiz -= sizeof(*this) / SLOTNUM;
     if (capsiz > bnum * sizeof(Record*)) capsiz -= bnum * sizeof(Record*);
+    nodenum_ = (opts_ & TNUMA) ? numanodes() : 0;
+    if (nodenum_ < 2) nodenum_ = 0;
+    if (nodenum_ > 0)
+      report(_KCCODELINE_, Logger::INFO, "binding slots to NUMA nodes (nodenum=%d)",
+             (int)nodenum_);
     for (int32_t i = 0; i < SLOTNUM; i++) {
       initialize_slot(slots_ + i, bnum, capcnt, capsiz);
     }
@@ -1022,6 +1049,21 @@ class CacheDB : public BasicDB {
       }
       (*strmap)["bnum_used"] = strprintf("%lld", (long long)cnt);
     }
+    int64_t bnum = 0;
+    int64_t rsznum = 0;
+    int64_t rszrem = 0;
+    for (int32_t i = 0; i < SLOTNUM; i++) {
+      Slot* slot = slots_ + i;
+      bnum += slot->bnum;
+      if (slot->obuckets) {
+        rsznum++;
+        rszrem += slot->obnum - slot->rszidx;
+      }
+    }
+    (*strmap)["bnum_cur"] = strprintf("%lld", (long long)bnum);
+    (*strmap)["lfmax"] = strprintf("%.3f", lfmax_);
+    (*strmap)["rsznum"] = strprintf("%lld", (long long)rsznum);
+    (*strmap)["rszrem"] = strprintf("%lld", (long long)rszrem);
     (*strmap)["count"] = strprintf("%lld", (long long)count_impl());
     (*strmap)["size"] = strprintf("%lld", (long long)size_impl());
     return true;
@@ -1088,8 +1130,12 @@ class CacheDB : public BasicDB {
   }
   /**
    * Set the optional features.
-   * @param opts the optional features by bitwise-or: DirDB::TCOMPRESS to compress each record.
+   * @param opts the optional features by bitwise-or: CacheDB::TCOMPRESS to compress each
+   * record, CacheDB::TNUMA to bind the slot tables to NUMA nodes in round robin.  TNUMA has no
+   * effect on systems with a single node.
    * @return true on success, or false on failure.
+   * @note TNUMA binds only the bucket array of each slot.  Records are allocated from the
+   * process heap and are placed wherever the memory allocator puts them.
    */
   bool tune_options(int8_t opts) {
     _assert_(true);
@@ -1116,6 +1162,24 @@ class CacheDB : public BasicDB {
     bnum_ = bnum >= 0 ? bnum : DEFBNUM;
     return true;
   }
+  /**
+   * Set the maximum load factor of the hash table.
+   * @param lfmax the maximum number of records per bucket.  If it is not more than 0, the hash
+   * table is never resized.
+   * @return true on success, or false on failure.
+   * @note When the load factor of a slot table exceeds the limit, its bucket array is enlarged
+   * and records are rehashed incrementally by subsequent operations on the slot table.
+   */
+  bool tune_load_factor(double lfmax) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    lfmax_ = lfmax;
+    return true;
+  }
   /**
    * Set the data compressor.
    * @param comp the data compressor object.
@@ -1161,6 +1225,26 @@ class CacheDB : public BasicDB {
     capsiz_ = size;
     return true;
   }
+  /**
+   * Set the width of the expiration time embedded in record values.
+   * @param width the width of the expiration time.  If it is positive, each record value whose
+   * size is not less than the width is regarded to begin with the expiration time in seconds
+   * of the epoch, stored as a big-endian integer.  Records whose expiration time is the maximum
+   * value of the width never expire.
+   * @return true on success, or false on failure.
+   * @note Expiration times are tracked in a timer wheel and expired records are removed by the
+   * expire_records method.
+   */
+  bool tune_expiration(int32_t width) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    xtwidth_ = width > (int32_t)sizeof(int64_t) ? (int32_t)sizeof(int64_t) : width;
+    return true;
+  }
   /**
    * Switch the mode of LRU rotation.
    * @param rttmode true to enable LRU rotation, false to disable LRU rotation.
@@ -1173,6 +1257,68 @@ class CacheDB : public BasicDB {
     rttmode_ = rttmode;
     return true;
   }
+  /**
+   * Remove expired records.
+   * @param max the maximum number of records to be removed.
+   * @return true on success, or false on failure.
+   * @note This function does nothing unless the width of the expiration time is set by the
+   * tune_expiration method.  Expired records are taken out of the timer wheel without scanning
+   * the database.
+   */
+  bool expire_records(int64_t max = INT64MAX) {
+    _assert_(max >= 0);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!(omode_ & OWRITER)) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    if (xtwidth_ < 1) return true;
+    int64_t ct = std::time(NULL);
+    size_t smax = max / SLOTNUM + 1;
+    for (int32_t i = 0; i < SLOTNUM; i++) {
+      Slot* slot = slots_ + i;
+      ScopedMutex slock(&slot->lock);
+      std::vector<uint64_t> hashes;
+      slot->xwheel->expire(ct, smax, &hashes);
+      std::vector<uint64_t>::iterator it = hashes.begin();
+      std::vector<uint64_t>::iterator itend = hashes.end();
+      while (it != itend) {
+        int64_t xt = expire_hash(slot, *it, ct);
+        if (xt >= 0) slot->xwheel->set(*it, xt);
+        ++it;
+      }
+    }
+    return true;
+  }
+  /**
+   * Get the time when expired records should be removed next.
+   * @return the time in seconds of the epoch from which the expire_records method removes any
+   * record, INT64MAX if no record will expire, or -1 on failure.
+   * @note The time is taken from the timer wheels without scanning the database, so that a
+   * timer can call this function and then the expire_records method to reclaim expired records
+   * without waiting for further updates.
+   */
+  int64_t expiration_deadline() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return -1;
+    }
+    if (xtwidth_ < 1) return INT64MAX;
+    int64_t dl = INT64MAX;
+    for (int32_t i = 0; i < SLOTNUM; i++) {
+      Slot* slot = slots_ + i;
+      ScopedMutex slock(&slot->lock);
+      int64_t sdl = slot->xwheel->deadline();
+      if (sdl < dl) dl = sdl;
+    }
+    return dl;
+  }
   /**
    * Get the opaque data.
    * @return the pointer to the opaque data region, whose size is 16 bytes.
@@ -1203,6 +1349,161 @@ class CacheDB : public BasicDB {
     }
     return true;
   }
+  /**
+   * Get the NUMA node to which the slot table of a record is bound.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @return the index of the node, or -1 if the database is not bound to NUMA nodes.
+   * @note Threads running on the node walk the bucket array without crossing the
+   * interconnect.  The record itself is not bound to the node.
+   */
+  int32_t numa_node(const char* kbuf, size_t ksiz) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0 || nodenum_ < 1) return -1;
+    return hash_record(kbuf, ksiz) % SLOTNUM % nodenum_;
+  }
+  /**
+   * Dump the memory image of the database into a file.
+   * @param dest the path of the destination file.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note The image keeps the bucket arrays, the record trees and the LRU order of every slot
+   * as they are, so that the CacheDB::load_image method can restore them without rehashing.
+   * The image depends on the architecture of the host.  The whole operation is performed
+   * atomically and other threads are blocked.
+   */
+  bool dump_image(const std::string& dest, ProgressChecker* checker = NULL) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (tran_) {
+      set_error(_KCCODELINE_, Error::LOGIC, "competition avoided");
+      return false;
+    }
+    int64_t allcnt = count_impl();
+    if (checker && !checker->check("dump_image", "beginning", 0, allcnt)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      return false;
+    }
+    File file;
+    if (!file.open(dest, File::OWRITER | File::OCREATE | File::OTRUNCATE)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+      return false;
+    }
+    bool err = false;
+    ImageWriter writer(&file);
+    char head[IMGHEADSIZ];
+    std::memset(head, 0, sizeof(head));
+    std::memcpy(head, KCCDBIMGMAGIC, sizeof(KCCDBIMGMAGIC));
+    head[sizeof(KCCDBIMGMAGIC)] = sizeof(void*);
+    head[sizeof(KCCDBIMGMAGIC)+1] = opts_;
+    writefixnum(head + 8, SLOTNUM, sizeof(uint32_t));
+    std::memcpy(head + 16, opaque_, sizeof(opaque_));
+    if (!writer.write(head, sizeof(head))) err = true;
+    int64_t curcnt = 0;
+    for (int32_t i = 0; !err && i < SLOTNUM; i++) {
+      if (!dump_image_slot(&writer, slots_ + i, checker, &curcnt, allcnt)) err = true;
+    }
+    if (!err && !writer.flush()) err = true;
+    if (err && writer.error()) set_error(_KCCODELINE_, Error::SYSTEM, writer.error());
+    if (!file.close()) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+      err = true;
+    }
+    if (!err && checker && !checker->check("dump_image", "ending", -1, allcnt)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      err = true;
+    }
+    trigger_meta(MetaTrigger::MISC, "dump_image");
+    return !err;
+  }
+  /**
+   * Load the memory image of the database from a file.
+   * @param src the path of the source file, which is made by the CacheDB::dump_image method.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note All existing records are removed and replaced with the ones in the image.  The
+   * bucket number of the image has priority over the tuning parameter.  The image file is
+   * mapped into memory and records are copied from it with fixing up their pointers.  The whole
+   * operation is performed atomically and other threads are blocked.
+   */
+  bool load_image(const std::string& src, ProgressChecker* checker = NULL) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!(omode_ & OWRITER)) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    if (tran_) {
+      set_error(_KCCODELINE_, Error::LOGIC, "competition avoided");
+      return false;
+    }
+    File::Status sbuf;
+    if (!File::status(src, &sbuf) || sbuf.isdir) {
+      set_error(_KCCODELINE_, Error::NOREPOS, "open failed (file not found)");
+      return false;
+    }
+    File file;
+    if (!file.open(src, File::OREADER, sbuf.size)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+      return false;
+    }
+    char head[IMGHEADSIZ];
+    if (!file.read(0, head, sizeof(head))) {
+      set_error(_KCCODELINE_, Error::INVALID, "missing magic data of the file");
+      file.close();
+      return false;
+    }
+    if (std::memcmp(head, KCCDBIMGMAGIC, sizeof(KCCDBIMGMAGIC)) ||
+        head[sizeof(KCCDBIMGMAGIC)] != (char)sizeof(void*) ||
+        readfixnum(head + 8, sizeof(uint32_t)) != (uint64_t)SLOTNUM) {
+      set_error(_KCCODELINE_, Error::INVALID, "invalid magic data of the file");
+      file.close();
+      return false;
+    }
+    if ((head[sizeof(KCCDBIMGMAGIC)+1] & TCOMPRESS) != (opts_ & TCOMPRESS)) {
+      set_error(_KCCODELINE_, Error::INVALID, "incompatible options");
+      file.close();
+      return false;
+    }
+    if (checker && !checker->check("load_image", "beginning", 0, -1)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      file.close();
+      return false;
+    }
+    disable_cursors();
+    bool err = false;
+    int64_t off = sizeof(head);
+    int64_t curcnt = 0;
+    for (int32_t i = 0; !err && i < SLOTNUM; i++) {
+      if (!load_image_slot(&file, &off, slots_ + i, checker, &curcnt)) err = true;
+    }
+    if (err) {
+      for (int32_t i = 0; i < SLOTNUM; i++) {
+        clear_slot(slots_ + i);
+      }
+    } else {
+      std::memcpy(opaque_, head + 16, sizeof(opaque_));
+    }
+    if (!file.close()) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+      err = true;
+    }
+    if (!err && checker && !checker->check("load_image", "ending", -1, curcnt)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      err = true;
+    }
+    trigger_meta(MetaTrigger::MISC, "load_image");
+    return !err;
+  }
  protected:
   /**
    * Report a message for debugging.
@@ -1523,6 +1824,9 @@ class CacheDB : public BasicDB {
     Mutex lock;                       ///< lock
     Record** buckets;                    ///< bucket array
     size_t bnum;                         ///< number of buckets
+    Record** obuckets;                   ///< old bucket array under resizing
+    size_t obnum;                        ///< number of old buckets
+    size_t rszidx;                       ///< index of the next old bucket to be migrated
     size_t capcnt;                       ///< cap of record number
     size_t capsiz;                       ///< cap of memory usage
     Record* first;                       ///< first record
@@ -1531,6 +1835,7 @@ class CacheDB : public BasicDB {
     size_t size;                         ///< total size of records
     TranLogList trlogs;                  ///< transaction logs
     size_t trsize;                       ///< size before transaction
+    TimerWheel* xwheel;                  ///< timer wheel of expiration
   };
   /**
    * Repeating visitor.
@@ -1586,6 +1891,32 @@ class CacheDB : public BasicDB {
       return REMOVE;
     }
   };
+  /**
+   * Removing visitor of expired records.
+   */
+  class Expirer : public Visitor {
+   public:
+    /** constructor */
+    explicit Expirer(CacheDB* db, int64_t ct) : db_(db), ct_(ct), xt_(-1) {}
+    /** get the expiration time of the living record */
+    int64_t xt() {
+      return xt_;
+    }
+   private:
+    /** visit a record */
+    const char* visit_full(const char* kbuf, size_t ksiz,
+                           const char* vbuf, size_t vsiz, size_t* sp) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ && sp);
+      int64_t xt = db_->read_expiration(vbuf, vsiz);
+      if (xt < 0) return NOP;
+      if (xt < ct_) return REMOVE;
+      xt_ = xt;
+      return NOP;
+    }
+    CacheDB* db_;                        ///< database
+    int64_t ct_;                         ///< current time
+    int64_t xt_;                         ///< expiration time
+  };
   /**
    * Scoped visitor.
    */
@@ -1604,6 +1935,232 @@ class CacheDB : public BasicDB {
    private:
     Visitor* visitor_;                   ///< visitor
   };
+  /**
+   * Buffered writer of the memory image.
+   */
+  class ImageWriter {
+   public:
+    /** constructor */
+    explicit ImageWriter(File* file) : file_(file), buf_(), emsg_(NULL) {}
+    /** write data */
+    bool write(const void* buf, size_t size) {
+      _assert_(buf && size <= MEMMAXSIZ);
+      buf_.append((const char*)buf, size);
+      if (buf_.size() < IMGIOUNIT) return true;
+      return flush();
+    }
+    /** flush the buffer */
+    bool flush() {
+      _assert_(true);
+      if (buf_.empty()) return true;
+      bool err = false;
+      if (!file_->append(buf_.data(), buf_.size())) {
+        emsg_ = file_->error();
+        err = true;
+      }
+      buf_.clear();
+      return !err;
+    }
+    /** get the error message */
+    const char* error() {
+      _assert_(true);
+      return emsg_;
+    }
+   private:
+    File* file_;                         ///< destination file
+    std::string buf_;                    ///< write buffer
+    const char* emsg_;                   ///< error message
+  };
+  /**
+   * Get the size of a record in the memory image.
+   * @param rec the record.
+   * @return the size of the record region including the padding.
+   */
+  size_t image_record_size(const Record* rec) {
+    _assert_(rec);
+    size_t rsiz = sizeof(*rec) + (rec->ksiz & KSIZMAX) + rec->vsiz;
+    return (rsiz + IMGALIGN - 1) / IMGALIGN * IMGALIGN;
+  }
+  /**
+   * Dump a slot table into the memory image.
+   * @param writer the image writer.
+   * @param slot the slot table.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @param curcntp the pointer to the counter of processed records.
+   * @param allcnt the number of all records.
+   * @return true on success, or false on failure.
+   * @note The previous links of records are used as temporary record numbers and restored at
+   * the end.
+   */
+  bool dump_image_slot(ImageWriter* writer, Slot* slot, ProgressChecker* checker,
+                       int64_t* curcntp, int64_t allcnt) {
+    _assert_(writer && slot && curcntp);
+    if (slot->obuckets) step_resizing(slot, slot->obnum);
+    uint64_t rnum = 0;
+    int64_t rsiz = 0;
+    Record* rec = slot->first;
+    while (rec) {
+      rec->prev = (Record*)(uintptr_t)++rnum;
+      rsiz += image_record_size(rec);
+      rec = rec->next;
+    }
+    bool err = false;
+    char head[IMGSLOTSIZ];
+    writefixnum(head, slot->bnum, sizeof(uint64_t));
+    writefixnum(head + 8, rnum, sizeof(uint64_t));
+    writefixnum(head + 16, slot->size, sizeof(uint64_t));
+    writefixnum(head + 24, rsiz, sizeof(uint64_t));
+    if (!writer->write(head, sizeof(head))) err = true;
+    char pad[IMGALIGN];
+    std::memset(pad, 0, sizeof(pad));
+    rec = slot->first;
+    while (!err && rec) {
+      Record irec;
+      irec.ksiz = rec->ksiz;
+      irec.vsiz = rec->vsiz;
+      irec.left = rec->left ? rec->left->prev : NULL;
+      irec.right = rec->right ? rec->right->prev : NULL;
+      irec.prev = NULL;
+      irec.next = NULL;
+      size_t dsiz = (rec->ksiz & KSIZMAX) + rec->vsiz;
+      size_t psiz = image_record_size(rec) - sizeof(irec) - dsiz;
+      if (!writer->write(&irec, sizeof(irec)) ||
+          !writer->write((char*)rec + sizeof(*rec), dsiz) ||
+          !writer->write(pad, psiz)) err = true;
+      (*curcntp)++;
+      if (checker && !checker->check("dump_image", "processing", *curcntp, allcnt)) {
+        set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+        err = true;
+      }
+      rec = rec->next;
+    }
+    Record** buckets = slot->buckets;
+    size_t bnum = slot->bnum;
+    for (size_t i = 0; !err && i < bnum; i++) {
+      Record* ent = buckets[i] ? buckets[i]->prev : NULL;
+      if (!writer->write(&ent, sizeof(ent))) err = true;
+    }
+    Record* prev = NULL;
+    rec = slot->first;
+    while (rec) {
+      rec->prev = prev;
+      prev = rec;
+      rec = rec->next;
+    }
+    return !err;
+  }
+  /**
+   * Load a slot table from the memory image.
+   * @param file the image file.
+   * @param offp the pointer to the variable of the offset of the slot, which is set to the
+   * offset of the next slot.
+   * @param slot the slot table.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @param curcntp the pointer to the counter of processed records.
+   * @return true on success, or false on failure.
+   */
+  bool load_image_slot(File* file, int64_t* offp, Slot* slot, ProgressChecker* checker,
+                       int64_t* curcntp) {
+    _assert_(file && offp && slot && curcntp);
+    int64_t off = *offp;
+    char head[IMGSLOTSIZ];
+    if (!file->read(off, head, sizeof(head))) {
+      set_error(_KCCODELINE_, Error::BROKEN, "too short record region");
+      return false;
+    }
+    off += sizeof(head);
+    uint64_t bnum = readfixnum(head, sizeof(uint64_t));
+    uint64_t rnum = readfixnum(head + 8, sizeof(uint64_t));
+    uint64_t size = readfixnum(head + 16, sizeof(uint64_t));
+    int64_t rsiz = readfixnum(head + 24, sizeof(uint64_t));
+    int64_t fsiz = file->size();
+    if (bnum < 1 || rsiz < 0 || rnum > (uint64_t)rsiz / sizeof(Record) ||
+        off + rsiz > fsiz || (fsiz - off - rsiz) / (int64_t)sizeof(Record*) < (int64_t)bnum) {
+      set_error(_KCCODELINE_, Error::BROKEN, "invalid meta data");
+      return false;
+    }
+    size_t capcnt = slot->capcnt;
+    size_t capsiz = slot->capsiz;
+    destroy_slot(slot);
+    initialize_slot(slot, bnum, capcnt, capsiz);
+    Record** recs = new Record*[rnum+1];
+    recs[0] = NULL;
+    uint64_t lnum = 0;
+    int64_t rend = off + rsiz;
+    bool err = false;
+    while (lnum < rnum) {
+      Record irec;
+      if (off + (int64_t)sizeof(irec) > rend || !file->read(off, &irec, sizeof(irec))) {
+        set_error(_KCCODELINE_, Error::BROKEN, "too short record region");
+        err = true;
+        break;
+      }
+      size_t dsiz = (irec.ksiz & KSIZMAX) + irec.vsiz;
+      int64_t isiz = image_record_size(&irec);
+      if (off + isiz > rend || (uintptr_t)irec.left > rnum || (uintptr_t)irec.right > rnum) {
+        set_error(_KCCODELINE_, Error::BROKEN, "invalid record header");
+        err = true;
+        break;
+      }
+      Record* rec = (Record*)xmalloc(sizeof(*rec) + dsiz);
+      *rec = irec;
+      if (!file->read(off + sizeof(irec), (char*)rec + sizeof(*rec), dsiz)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, file->error());
+        xfree(rec);
+        err = true;
+        break;
+      }
+      recs[++lnum] = rec;
+      off += isiz;
+      (*curcntp)++;
+      if (checker && !checker->check("load_image", "processing", *curcntp, -1)) {
+        set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+        err = true;
+        break;
+      }
+    }
+    if (err) {
+      for (uint64_t i = 1; i <= lnum; i++) {
+        xfree(recs[i]);
+      }
+      delete[] recs;
+      return false;
+    }
+    for (uint64_t i = 1; i <= rnum; i++) {
+      Record* rec = recs[i];
+      rec->left = recs[(uintptr_t)rec->left];
+      rec->right = recs[(uintptr_t)rec->right];
+      rec->prev = recs[i-1];
+      rec->next = i < rnum ? recs[i+1] : NULL;
+    }
+    slot->first = recs[rnum > 0 ? 1 : 0];
+    slot->last = recs[rnum];
+    slot->count = rnum;
+    slot->size = size;
+    for (uint64_t i = 1; slot->xwheel && i <= rnum; i++) {
+      Record* rec = recs[i];
+      uint32_t rksiz = rec->ksiz & KSIZMAX;
+      const char* dbuf = (char*)rec + sizeof(*rec);
+      track_expiration(slot, dbuf, rksiz, dbuf + rksiz, rec->vsiz, comp_);
+    }
+    Record** buckets = slot->buckets;
+    if (!file->read(off, buckets, sizeof(*buckets) * bnum)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file->error());
+      err = true;
+    }
+    for (size_t i = 0; i < bnum; i++) {
+      uintptr_t idx = err ? 0 : (uintptr_t)buckets[i];
+      if (idx > rnum) {
+        set_error(_KCCODELINE_, Error::BROKEN, "invalid bucket data");
+        err = true;
+        idx = 0;
+      }
+      buckets[i] = recs[idx];
+    }
+    delete[] recs;
+    *offp = off + sizeof(*buckets) * bnum;
+    return !err;
+  }
   /**
    * Accept a visitor to a record.
    * @param slot the slot of the record.
@@ -1617,6 +2174,10 @@ class CacheDB : public BasicDB {
   void accept_impl(Slot* slot, uint64_t hash, const char* kbuf, size_t ksiz, Visitor* visitor,
                    Compressor* comp, bool rtt) {
     _assert_(slot && kbuf && ksiz <= MEMMAXSIZ && visitor);
+    if (slot->obuckets) {
+      migrate_bucket(slot, hash % slot->obnum);
+      step_resizing(slot, RSZSTEP);
+    }
     size_t bidx = hash % slot->bnum;
     Record* rec = slot->buckets[bidx];
     Record** entp = slot->buckets + bidx;
@@ -1659,6 +2220,7 @@ class CacheDB : public BasicDB {
               TranLog log(kbuf, ksiz, dbuf + rksiz, rec->vsiz);
               slot->trlogs.push_back(log);
             }
+            if (slot->xwheel) slot->xwheel->remove(hash_record(kbuf, ksiz));
             if (!curs_.empty()) escape_cursors(rec);
             if (rec == slot->first) slot->first = rec->next;
             if (rec == slot->last) slot->last = rec->prev;
@@ -1694,6 +2256,8 @@ class CacheDB : public BasicDB {
           } else {
             bool adj = false;
             if (vbuf != Visitor::NOP) {
+              if (slot->xwheel)
+                track_expiration(slot, kbuf, ksiz, vbuf, vsiz, comp ? NULL : comp_);
               char* zbuf = NULL;
               size_t zsiz = 0;
               if (comp) {
@@ -1747,6 +2311,7 @@ class CacheDB : public BasicDB {
     size_t vsiz;
     const char* vbuf = visitor->visit_empty(kbuf, ksiz, &vsiz);
     if (vbuf != Visitor::NOP && vbuf != Visitor::REMOVE) {
+      if (slot->xwheel) track_expiration(slot, kbuf, ksiz, vbuf, vsiz, comp ? NULL : comp_);
       char* zbuf = NULL;
       size_t zsiz = 0;
       if (comp) {
@@ -1777,6 +2342,8 @@ class CacheDB : public BasicDB {
       slot->last = rec;
       slot->count++;
       if (!tran_) adjust_slot_capacity(slot);
+      if (lfmax_ > 0 && !slot->obuckets && slot->count > slot->bnum * lfmax_)
+        begin_resizing(slot);
       delete[] zbuf;
     }
   }
@@ -1804,7 +2371,7 @@ class CacheDB : public BasicDB {
     for (int32_t i = 0; i < SLOTNUM; i++) {
       Slot* slot = slots_ + i;
       ScopedMutex lock(&slot->lock);
-      sum += slot->bnum * sizeof(Record*);
+      sum += (slot->bnum + slot->obnum) * sizeof(Record*);
       sum += slot->size;
     }
     return sum;
@@ -1818,23 +2385,18 @@ class CacheDB : public BasicDB {
    */
   void initialize_slot(Slot* slot, size_t bnum, size_t capcnt, size_t capsiz) {
     _assert_(slot);
-    Record** buckets;
-    if (bnum >= ZMAPBNUM) {
-      buckets = (Record**)mapalloc(sizeof(*buckets) * bnum);
-    } else {
-      buckets = new Record*[bnum];
-      for (size_t i = 0; i < bnum; i++) {
-        buckets[i] = NULL;
-      }
-    }
-    slot->buckets = buckets;
+    slot->buckets = create_bucket_array(bnum, slot_node(slot));
     slot->bnum = bnum;
+    slot->obuckets = NULL;
+    slot->obnum = 0;
+    slot->rszidx = 0;
     slot->capcnt = capcnt;
     slot->capsiz = capsiz;
     slot->first = NULL;
     slot->last = NULL;
     slot->count = 0;
     slot->size = 0;
+    slot->xwheel = xtwidth_ > 0 ? new TimerWheel(std::time(NULL)) : NULL;
   }
   /**
    * Destroy a slot table.
@@ -1849,11 +2411,9 @@ class CacheDB : public BasicDB {
       xfree(rec);
       rec = prev;
     }
-    if (slot->bnum >= ZMAPBNUM) {
-      mapfree(slot->buckets);
-    } else {
-      delete[] slot->buckets;
-    }
+    destroy_bucket_array(slot->buckets, slot->bnum);
+    if (slot->obuckets) destroy_bucket_array(slot->obuckets, slot->obnum);
+    delete slot->xwheel;
   }
   /**
    * Clear a slot table.
@@ -1878,10 +2438,17 @@ class CacheDB : public BasicDB {
     for (size_t i = 0; i < bnum; i++) {
       buckets[i] = NULL;
     }
+    if (slot->obuckets) {
+      destroy_bucket_array(slot->obuckets, slot->obnum);
+      slot->obuckets = NULL;
+      slot->obnum = 0;
+      slot->rszidx = 0;
+    }
     slot->first = NULL;
     slot->last = NULL;
     slot->count = 0;
     slot->size = 0;
+    if (slot->xwheel) slot->xwheel->clear(std::time(NULL));
   }
   /**
    * Apply transaction logs of a slot table.
@@ -1927,6 +2494,203 @@ class CacheDB : public BasicDB {
       if (kbuf != stack) delete[] kbuf;
     }
   }
+  /**
+   * Get the NUMA node of a slot table.
+   * @param slot the slot table.
+   * @return the index of the node, or -1 if the slot table is not bound.
+   */
+  int32_t slot_node(Slot* slot) {
+    _assert_(slot);
+    if (nodenum_ < 1) return -1;
+    return (slot - slots_) % nodenum_;
+  }
+  /**
+   * Create a bucket array.
+   * @param bnum the number of buckets.
+   * @param node the NUMA node to which the array is bound, or -1 not to bind it.
+   * @return the bucket array whose elements are all NULL.
+   */
+  Record** create_bucket_array(size_t bnum, int32_t node) {
+    _assert_(true);
+    if (bnum >= ZMAPBNUM) {
+      Record** buckets = (Record**)mapalloc(sizeof(Record*) * bnum);
+      if (node >= 0 && !numabind(buckets, sizeof(Record*) * bnum, node))
+        report(_KCCODELINE_, Logger::WARN, "binding to a NUMA node failed (node=%d)",
+               (int)node);
+      return buckets;
+    }
+    Record** buckets = new Record*[bnum];
+    for (size_t i = 0; i < bnum; i++) {
+      buckets[i] = NULL;
+    }
+    return buckets;
+  }
+  /**
+   * Destroy a bucket array.
+   * @param buckets the bucket array.
+   * @param bnum the number of buckets.
+   */
+  void destroy_bucket_array(Record** buckets, size_t bnum) {
+    _assert_(buckets);
+    if (bnum >= ZMAPBNUM) {
+      mapfree(buckets);
+    } else {
+      delete[] buckets;
+    }
+  }
+  /**
+   * Begin to resize the bucket array of a slot table.
+   * @param slot the slot table.
+   * @note Records are not moved here but migrated from the old bucket array incrementally.
+   */
+  void begin_resizing(Slot* slot) {
+    _assert_(slot);
+    size_t bnum = nearbyprime(slot->bnum * 2 + 1);
+    if (bnum <= slot->bnum) return;
+    size_t inc = (bnum - slot->bnum) * sizeof(Record*);
+    slot->capsiz = slot->capsiz > inc ? slot->capsiz - inc : 0;
+    slot->obuckets = slot->buckets;
+    slot->obnum = slot->bnum;
+    slot->rszidx = 0;
+    slot->buckets = create_bucket_array(bnum, slot_node(slot));
+    slot->bnum = bnum;
+  }
+  /**
+   * Migrate records from old buckets to the current bucket array.
+   * @param slot the slot table.
+   * @param num the number of old buckets to be migrated.
+   */
+  void step_resizing(Slot* slot, size_t num) {
+    _assert_(slot && slot->obuckets);
+    size_t end = num < slot->obnum - slot->rszidx ? slot->rszidx + num : slot->obnum;
+    while (slot->rszidx < end) {
+      migrate_bucket(slot, slot->rszidx++);
+    }
+    if (slot->rszidx < slot->obnum) return;
+    destroy_bucket_array(slot->obuckets, slot->obnum);
+    slot->obuckets = NULL;
+    slot->obnum = 0;
+    slot->rszidx = 0;
+  }
+  /**
+   * Migrate records of an old bucket to the current bucket array.
+   * @param slot the slot table.
+   * @param obidx the index of the old bucket.
+   */
+  void migrate_bucket(Slot* slot, size_t obidx) {
+    _assert_(slot && slot->obuckets && obidx < slot->obnum);
+    Record* rec = slot->obuckets[obidx];
+    if (!rec) return;
+    slot->obuckets[obidx] = NULL;
+    std::vector<Record*> stack;
+    stack.push_back(rec);
+    while (!stack.empty()) {
+      rec = stack.back();
+      stack.pop_back();
+      if (rec->left) stack.push_back(rec->left);
+      if (rec->right) stack.push_back(rec->right);
+      rec->left = NULL;
+      rec->right = NULL;
+      uint32_t rhash = rec->ksiz & ~KSIZMAX;
+      uint32_t rksiz = rec->ksiz & KSIZMAX;
+      char* dbuf = (char*)rec + sizeof(*rec);
+      Record** entp = slot->buckets + hash_record(dbuf, rksiz) / SLOTNUM % slot->bnum;
+      while (*entp) {
+        Record* cur = *entp;
+        uint32_t chash = cur->ksiz & ~KSIZMAX;
+        if (rhash > chash) {
+          entp = &cur->left;
+        } else if (rhash < chash) {
+          entp = &cur->right;
+        } else {
+          char* cbuf = (char*)cur + sizeof(*cur);
+          entp = compare_keys(dbuf, rksiz, cbuf, cur->ksiz & KSIZMAX) < 0 ?
+              &cur->left : &cur->right;
+        }
+      }
+      *entp = rec;
+    }
+  }
+  /**
+   * Track the expiration time of a record.
+   * @param slot the slot of the record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param vbuf the pointer to the value region.
+   * @param vsiz the size of the value region.
+   * @param comp the data compressor of the value, or NULL if the value is not compressed.
+   */
+  void track_expiration(Slot* slot, const char* kbuf, size_t ksiz,
+                        const char* vbuf, size_t vsiz, Compressor* comp) {
+    _assert_(slot && kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ);
+    char* zbuf = NULL;
+    size_t zsiz = 0;
+    if (comp) {
+      zbuf = comp->decompress(vbuf, vsiz, &zsiz);
+      if (zbuf) {
+        vbuf = zbuf;
+        vsiz = zsiz;
+      }
+    }
+    int64_t xt = read_expiration(vbuf, vsiz);
+    delete[] zbuf;
+    if (xt >= 0) {
+      slot->xwheel->set(hash_record(kbuf, ksiz), xt);
+    } else {
+      slot->xwheel->remove(hash_record(kbuf, ksiz));
+    }
+  }
+  /**
+   * Remove expired records of a hash value.
+   * @param slot the slot of the records.
+   * @param hash the hash value of the keys.
+   * @param ct the current time.
+   * @return the earliest expiration time of the living records of the hash value, or -1 if
+   * there is no such record.
+   */
+  int64_t expire_hash(Slot* slot, uint64_t hash, int64_t ct) {
+    _assert_(slot);
+    uint64_t shash = hash / SLOTNUM;
+    if (slot->obuckets) migrate_bucket(slot, shash % slot->obnum);
+    uint32_t fhash = fold_hash(shash) & ~KSIZMAX;
+    std::vector<std::string> keys;
+    std::vector<Record*> stack;
+    Record* rec = slot->buckets[shash % slot->bnum];
+    if (rec) stack.push_back(rec);
+    while (!stack.empty()) {
+      rec = stack.back();
+      stack.pop_back();
+      if (rec->left) stack.push_back(rec->left);
+      if (rec->right) stack.push_back(rec->right);
+      if ((rec->ksiz & ~KSIZMAX) != fhash) continue;
+      uint32_t rksiz = rec->ksiz & KSIZMAX;
+      const char* dbuf = (char*)rec + sizeof(*rec);
+      if (hash_record(dbuf, rksiz) == hash) keys.push_back(std::string(dbuf, rksiz));
+    }
+    int64_t xt = -1;
+    std::vector<std::string>::iterator it = keys.begin();
+    std::vector<std::string>::iterator itend = keys.end();
+    while (it != itend) {
+      Expirer expirer(this, ct);
+      accept_impl(slot, shash, it->data(), it->size(), &expirer, comp_, false);
+      if (expirer.xt() >= 0 && (xt < 0 || expirer.xt() < xt)) xt = expirer.xt();
+      ++it;
+    }
+    return xt;
+  }
+  /**
+   * Read the expiration time embedded in a record value.
+   * @param vbuf the pointer to the value region.
+   * @param vsiz the size of the value region.
+   * @return the expiration time, or -1 if the record never expires.
+   */
+  int64_t read_expiration(const char* vbuf, size_t vsiz) {
+    _assert_(vbuf && vsiz <= MEMMAXSIZ);
+    if (vsiz < (size_t)xtwidth_) return -1;
+    int64_t xt = readfixnum(vbuf, xtwidth_);
+    if (xtwidth_ < (int32_t)sizeof(xt) && xt >= ((int64_t)1 << (xtwidth_ * 8)) - 1) return -1;
+    return xt < 0 ? -1 : xt;
+  }
   /**
    * Get the hash value of a record.
    * @param kbuf the pointer to the key region.
@@ -2037,16 +2801,22 @@ class CacheDB : public BasicDB {
   uint8_t opts_;
   /** The bucket number. */
   int64_t bnum_;
+  /** The maximum load factor. */
+  double lfmax_;
   /** The capacity of record number. */
   int64_t capcnt_;
   /** The capacity of memory usage. */
   int64_t capsiz_;
+  /** The width of the expiration time. */
+  int32_t xtwidth_;
   /** The opaque data. */
   char opaque_[OPAQUESIZ];
   /** The embedded data compressor. */
   Compressor* embcomp_;
   /** The data compressor. */
   Compressor* comp_;
+  /** The number of NUMA nodes to which slot tables are bound. */
+  int32_t nodenum_;
   /** The slot tables. */
   Slot slots_[SLOTNUM];
   /** The flag whether in LRU rotation. */
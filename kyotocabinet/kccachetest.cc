@@ -1213,6 +1213,34 @@ static int32_t procorder(int64_t rnum, int32_t thnum, bool rnd, bool etc, bool t
     dbmetaprint(&db, false);
     oprintf("time: %.3f\n", etime - stime);
   }
+  if (etc && db.size() < (256LL << 20)) {
+    oprintf("dumping records into image:\n");
+    stime = kc::time();
+    const std::string imgpath = "casket.kcci";
+    int64_t cnt = db.count();
+    int64_t size = db.size();
+    if (!db.dump_image(imgpath)) {
+      dberrprint(&db, __LINE__, "DB::dump_image");
+      err = true;
+    }
+    etime = kc::time();
+    dbmetaprint(&db, false);
+    oprintf("time: %.3f\n", etime - stime);
+    oprintf("loading records from image:\n");
+    stime = kc::time();
+    if (rnd && myrand(2) == 0 && !db.clear()) {
+      dberrprint(&db, __LINE__, "DB::clear");
+      err = true;
+    }
+    if (!db.load_image(imgpath) || db.count() != cnt || db.size() != size) {
+      dberrprint(&db, __LINE__, "DB::load_image");
+      err = true;
+    }
+    kc::File::remove(imgpath);
+    etime = kc::time();
+    dbmetaprint(&db, false);
+    oprintf("time: %.3f\n", etime - stime);
+  }
   oprintf("removing records:\n");
   stime = kc::time();
   class ThreadRemove : public kc::Thread {
@@ -70,6 +70,10 @@ extern "C" {
 #define snprintf  _snprintf
 #endif
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #if defined(__CYGWIN__)
 inline long double modfl(long double val, long double* iptr) {
   double integ;
@@ -34,6 +34,12 @@ extern "C" {
 }
 #endif
 
+#if _KC_AESNI
+#include <wmmintrin.h>
+#include <tmmintrin.h>
+#define _KC_AESNIFUNC  __attribute__((target("aes,pclmul,ssse3")))
+#endif
+
 namespace kyotocabinet {                 // common namespace
 
 
@@ -391,6 +397,660 @@ uint32_t LZMA::calculate_crc(const void* buf, size_t size, uint32_t seed) {
 }
 
 
+const int32_t AESRNUMMAX = 14;           ///< maximum number of the rounds of AES
+const size_t AESPIPENUM = 8;             ///< number of the blocks processed at once
+
+
+/**
+ * Inner state of the AES cipher.
+ */
+struct AESCore {
+  uint32_t rk[4*(AESRNUMMAX+1)];         ///< round keys
+  uint8_t rkb[16*(AESRNUMMAX+1)];        ///< round keys in bytes
+  int32_t rnum;                          ///< number of the rounds
+  uint8_t hkey[16];                      ///< hash key
+  uint64_t hh[16];                       ///< upper halves of the multiples of the hash key
+  uint64_t hl[16];                       ///< lower halves of the multiples of the hash key
+  uint8_t hpow[16*AESPIPENUM];           ///< reversed powers of the hash key
+};
+
+
+/**
+ * Substitution box of AES.
+ */
+static uint8_t aes_sbox[256];
+
+
+/**
+ * Table of the substitution and the mixing of AES.
+ */
+static uint32_t aes_table[256];
+
+
+/**
+ * Whether the processor instructions are usable.
+ */
+static bool aes_ni = false;
+
+
+/**
+ * Initialize the tables of AES.
+ */
+static int32_t aes_init_func() {
+  uint8_t p = 1;
+  uint8_t q = 1;
+  do {
+    p = (uint8_t)(p ^ (p << 1) ^ ((p & 0x80) ? 0x1b : 0));
+    q ^= (uint8_t)(q << 1);
+    q ^= (uint8_t)(q << 2);
+    q ^= (uint8_t)(q << 4);
+    if (q & 0x80) q ^= 0x09;
+    uint8_t x = q ^ (uint8_t)((q << 1) | (q >> 7)) ^ (uint8_t)((q << 2) | (q >> 6)) ^
+      (uint8_t)((q << 3) | (q >> 5)) ^ (uint8_t)((q << 4) | (q >> 4));
+    aes_sbox[p] = x ^ 0x63;
+  } while (p != 1);
+  aes_sbox[0] = 0x63;
+  for (int32_t i = 0; i < 256; i++) {
+    uint32_t s = aes_sbox[i];
+    uint32_t d = ((s << 1) ^ ((s & 0x80) ? 0x1b : 0)) & 0xff;
+    aes_table[i] = (d << 24) | (s << 16) | (s << 8) | (d ^ s);
+  }
+#if _KC_AESNI
+  __builtin_cpu_init();
+  aes_ni = __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul") &&
+    __builtin_cpu_supports("ssse3");
+#endif
+  return 0;
+}
+int32_t aes_init_var = aes_init_func();
+
+
+/**
+ * Rotate a 32-bit word to the right.
+ */
+static inline uint32_t aes_ror(uint32_t num, int32_t bits) {
+  return (num >> bits) | (num << (32 - bits));
+}
+
+
+/**
+ * Read a big-endian 32-bit word.
+ */
+static inline uint32_t aes_read32(const uint8_t* rp) {
+  return ((uint32_t)rp[0] << 24) | ((uint32_t)rp[1] << 16) | ((uint32_t)rp[2] << 8) | rp[3];
+}
+
+
+/**
+ * Write a big-endian 32-bit word.
+ */
+static inline void aes_write32(uint8_t* wp, uint32_t num) {
+  wp[0] = num >> 24;
+  wp[1] = num >> 16;
+  wp[2] = num >> 8;
+  wp[3] = num;
+}
+
+
+/**
+ * Encrypt a block with the portable code.
+ */
+static void aes_encrypt_block(const AESCore* core, const uint8_t* in, uint8_t* out) {
+  const uint32_t* rk = core->rk;
+  uint32_t s0 = aes_read32(in) ^ rk[0];
+  uint32_t s1 = aes_read32(in + 4) ^ rk[1];
+  uint32_t s2 = aes_read32(in + 8) ^ rk[2];
+  uint32_t s3 = aes_read32(in + 12) ^ rk[3];
+  const uint32_t* tb = aes_table;
+  for (int32_t r = 1; r < core->rnum; r++) {
+    rk += 4;
+    uint32_t t0 = tb[s0>>24] ^ aes_ror(tb[(s1>>16)&0xff], 8) ^
+      aes_ror(tb[(s2>>8)&0xff], 16) ^ aes_ror(tb[s3&0xff], 24) ^ rk[0];
+    uint32_t t1 = tb[s1>>24] ^ aes_ror(tb[(s2>>16)&0xff], 8) ^
+      aes_ror(tb[(s3>>8)&0xff], 16) ^ aes_ror(tb[s0&0xff], 24) ^ rk[1];
+    uint32_t t2 = tb[s2>>24] ^ aes_ror(tb[(s3>>16)&0xff], 8) ^
+      aes_ror(tb[(s0>>8)&0xff], 16) ^ aes_ror(tb[s1&0xff], 24) ^ rk[2];
+    uint32_t t3 = tb[s3>>24] ^ aes_ror(tb[(s0>>16)&0xff], 8) ^
+      aes_ror(tb[(s1>>8)&0xff], 16) ^ aes_ror(tb[s2&0xff], 24) ^ rk[3];
+    s0 = t0;
+    s1 = t1;
+    s2 = t2;
+    s3 = t3;
+  }
+  rk += 4;
+  const uint8_t* sb = aes_sbox;
+  aes_write32(out, (((uint32_t)sb[s0>>24] << 24) | ((uint32_t)sb[(s1>>16)&0xff] << 16) |
+                    ((uint32_t)sb[(s2>>8)&0xff] << 8) | sb[s3&0xff]) ^ rk[0]);
+  aes_write32(out + 4, (((uint32_t)sb[s1>>24] << 24) | ((uint32_t)sb[(s2>>16)&0xff] << 16) |
+                        ((uint32_t)sb[(s3>>8)&0xff] << 8) | sb[s0&0xff]) ^ rk[1]);
+  aes_write32(out + 8, (((uint32_t)sb[s2>>24] << 24) | ((uint32_t)sb[(s3>>16)&0xff] << 16) |
+                        ((uint32_t)sb[(s0>>8)&0xff] << 8) | sb[s1&0xff]) ^ rk[2]);
+  aes_write32(out + 12, (((uint32_t)sb[s3>>24] << 24) | ((uint32_t)sb[(s0>>16)&0xff] << 16) |
+                         ((uint32_t)sb[(s1>>8)&0xff] << 8) | sb[s2&0xff]) ^ rk[3]);
+}
+
+
+/**
+ * Double a block in GF(2^128) for the subkeys of CMAC.
+ */
+static void aes_cmac_double(const uint8_t* in, uint8_t* out) {
+  uint8_t carry = in[0] >> 7;
+  for (int32_t i = 0; i < 15; i++) {
+    out[i] = (uint8_t)((in[i] << 1) | (in[i+1] >> 7));
+  }
+  out[15] = (uint8_t)((in[15] << 1) ^ (carry ? 0x87 : 0));
+}
+
+
+/**
+ * Calculate the subkeys of CMAC of RFC 4493.
+ */
+static void aes_cmac_subkeys(const AESCore* core, uint8_t* sub) {
+  uint8_t zbuf[16];
+  std::memset(zbuf, 0, sizeof(zbuf));
+  aes_encrypt_block(core, zbuf, sub);
+  aes_cmac_double(sub, sub);
+  aes_cmac_double(sub, sub + 16);
+}
+
+
+/**
+ * Calculate the CMAC of RFC 4493 with the portable code.
+ */
+static void aes_cmac(const AESCore* core, const uint8_t* sub, const uint8_t* buf, size_t size,
+                     uint8_t* mac) {
+  size_t bnum = size > 0 ? (size + 15) / 16 : 1;
+  bool full = size > 0 && size % 16 == 0;
+  if (!full) sub += 16;
+  uint8_t x[16];
+  std::memset(x, 0, sizeof(x));
+  for (size_t i = 0; i + 1 < bnum; i++) {
+    for (int32_t j = 0; j < 16; j++) {
+      x[j] ^= buf[j];
+    }
+    aes_encrypt_block(core, x, x);
+    buf += 16;
+  }
+  size_t rsiz = size - (bnum - 1) * 16;
+  uint8_t last[16];
+  std::memset(last, 0, sizeof(last));
+  std::memcpy(last, buf, rsiz);
+  if (!full) last[rsiz] = 0x80;
+  for (int32_t j = 0; j < 16; j++) {
+    x[j] ^= last[j] ^ sub[j];
+  }
+  aes_encrypt_block(core, x, mac);
+}
+
+
+/**
+ * Multiply a block by the hash key in GF(2^128) with the portable code.
+ */
+static void aes_ghash_mult(const AESCore* core, uint8_t* x) {
+  static const uint64_t last4[16] = {
+    0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+    0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+  };
+  uint32_t lo = x[15] & 0xf;
+  uint64_t zh = core->hh[lo];
+  uint64_t zl = core->hl[lo];
+  for (int32_t i = 15; i >= 0; i--) {
+    lo = x[i] & 0xf;
+    uint32_t hi = (x[i] >> 4) & 0xf;
+    uint32_t rem;
+    if (i != 15) {
+      rem = zl & 0xf;
+      zl = (zh << 60) | (zl >> 4);
+      zh = (zh >> 4) ^ (last4[rem] << 48) ^ core->hh[lo];
+      zl ^= core->hl[lo];
+    }
+    rem = zl & 0xf;
+    zl = (zh << 60) | (zl >> 4);
+    zh = (zh >> 4) ^ (last4[rem] << 48) ^ core->hh[hi];
+    zl ^= core->hl[hi];
+  }
+  aes_write32(x, zh >> 32);
+  aes_write32(x + 4, zh);
+  aes_write32(x + 8, zl >> 32);
+  aes_write32(x + 12, zl);
+}
+
+
+/**
+ * Accumulate data into the hash value with the portable code.
+ */
+static void aes_ghash_update(const AESCore* core, uint8_t* x, const uint8_t* rp, size_t size) {
+  while (size > 0) {
+    size_t len = size < AES::BLOCKSIZ ? size : AES::BLOCKSIZ;
+    for (size_t i = 0; i < len; i++) {
+      x[i] ^= rp[i];
+    }
+    aes_ghash_mult(core, x);
+    rp += len;
+    size -= len;
+  }
+}
+
+
+/**
+ * Process a serial data in the counter mode and the hash with the portable code.
+ */
+static void aes_gcm_portable(const AESCore* core, const uint8_t* iv,
+                             const uint8_t* rp, size_t size, uint8_t* wp,
+                             const uint8_t* abuf, size_t asiz, bool enc, uint8_t* tag) {
+  uint8_t x[AES::BLOCKSIZ];
+  std::memset(x, 0, sizeof(x));
+  aes_ghash_update(core, x, abuf, asiz);
+  uint8_t ctr[AES::BLOCKSIZ];
+  std::memcpy(ctr, iv, AES::IVSIZ);
+  uint32_t cnt = 2;
+  size_t rsiz = size;
+  while (rsiz > 0) {
+    size_t len = rsiz < AES::BLOCKSIZ ? rsiz : AES::BLOCKSIZ;
+    uint8_t ks[AES::BLOCKSIZ];
+    aes_write32(ctr + AES::IVSIZ, cnt++);
+    aes_encrypt_block(core, ctr, ks);
+    if (!enc) {
+      for (size_t i = 0; i < len; i++) {
+        x[i] ^= rp[i];
+      }
+    }
+    for (size_t i = 0; i < len; i++) {
+      wp[i] = rp[i] ^ ks[i];
+    }
+    if (enc) {
+      for (size_t i = 0; i < len; i++) {
+        x[i] ^= wp[i];
+      }
+    }
+    aes_ghash_mult(core, x);
+    rp += len;
+    wp += len;
+    rsiz -= len;
+  }
+  uint8_t lbuf[AES::BLOCKSIZ];
+  uint64_t abits = (uint64_t)asiz * 8;
+  uint64_t dbits = (uint64_t)size * 8;
+  aes_write32(lbuf, abits >> 32);
+  aes_write32(lbuf + 4, abits);
+  aes_write32(lbuf + 8, dbits >> 32);
+  aes_write32(lbuf + 12, dbits);
+  aes_ghash_update(core, x, lbuf, sizeof(lbuf));
+  aes_write32(ctr + AES::IVSIZ, 1);
+  aes_encrypt_block(core, ctr, tag);
+  for (size_t i = 0; i < AES::BLOCKSIZ; i++) {
+    tag[i] ^= x[i];
+  }
+}
+
+
+#if _KC_AESNI
+
+
+/**
+ * Accumulate the product of two byte-reversed blocks with the carry-less multiplication.
+ */
+_KC_AESNIFUNC
+static inline void aes_ni_clmul(__m128i a, __m128i b, __m128i* lo, __m128i* hi) {
+  __m128i t3 = _mm_clmulepi64_si128(a, b, 0x00);
+  __m128i t4 = _mm_clmulepi64_si128(a, b, 0x10);
+  __m128i t5 = _mm_clmulepi64_si128(a, b, 0x01);
+  __m128i t6 = _mm_clmulepi64_si128(a, b, 0x11);
+  t4 = _mm_xor_si128(t4, t5);
+  *lo = _mm_xor_si128(*lo, _mm_xor_si128(t3, _mm_slli_si128(t4, 8)));
+  *hi = _mm_xor_si128(*hi, _mm_xor_si128(t6, _mm_srli_si128(t4, 8)));
+}
+
+
+/**
+ * Reduce an accumulated product into a byte-reversed block in GF(2^128).
+ */
+_KC_AESNIFUNC
+static inline __m128i aes_ni_reduce(__m128i t3, __m128i t6) {
+  __m128i t7 = _mm_srli_epi32(t3, 31);
+  __m128i t8 = _mm_srli_epi32(t6, 31);
+  t3 = _mm_slli_epi32(t3, 1);
+  t6 = _mm_slli_epi32(t6, 1);
+  __m128i t9 = _mm_srli_si128(t7, 12);
+  t8 = _mm_slli_si128(t8, 4);
+  t7 = _mm_slli_si128(t7, 4);
+  t3 = _mm_or_si128(t3, t7);
+  t6 = _mm_or_si128(t6, t8);
+  t6 = _mm_or_si128(t6, t9);
+  t7 = _mm_slli_epi32(t3, 31);
+  t8 = _mm_slli_epi32(t3, 30);
+  t9 = _mm_slli_epi32(t3, 25);
+  t7 = _mm_xor_si128(t7, t8);
+  t7 = _mm_xor_si128(t7, t9);
+  t8 = _mm_srli_si128(t7, 4);
+  t7 = _mm_slli_si128(t7, 12);
+  t3 = _mm_xor_si128(t3, t7);
+  __m128i t2 = _mm_srli_epi32(t3, 1);
+  __m128i t4 = _mm_srli_epi32(t3, 2);
+  __m128i t5 = _mm_srli_epi32(t3, 7);
+  t2 = _mm_xor_si128(t2, t4);
+  t2 = _mm_xor_si128(t2, t5);
+  t2 = _mm_xor_si128(t2, t8);
+  t3 = _mm_xor_si128(t3, t2);
+  return _mm_xor_si128(t6, t3);
+}
+
+
+/**
+ * Multiply two byte-reversed blocks in GF(2^128) with the carry-less multiplication.
+ */
+_KC_AESNIFUNC
+static inline __m128i aes_ni_gfmul(__m128i a, __m128i b) {
+  __m128i lo = _mm_setzero_si128();
+  __m128i hi = _mm_setzero_si128();
+  aes_ni_clmul(a, b, &lo, &hi);
+  return aes_ni_reduce(lo, hi);
+}
+
+
+/**
+ * Calculate the powers of the hash key for aggregated reduction.
+ */
+_KC_AESNIFUNC
+static void aes_ni_hpow(AESCore* core) {
+  const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  __m128i hkey = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)core->hkey), bswap);
+  __m128i pow = hkey;
+  for (size_t i = 0; i < AESPIPENUM; i++) {
+    _mm_storeu_si128((__m128i*)(core->hpow + i * AES::BLOCKSIZ), pow);
+    pow = aes_ni_gfmul(pow, hkey);
+  }
+}
+
+
+/**
+ * Load a partial block padded with zero.
+ */
+_KC_AESNIFUNC
+static inline __m128i aes_ni_loadpart(const uint8_t* rp, size_t size) {
+  uint8_t buf[AES::BLOCKSIZ];
+  std::memset(buf, 0, sizeof(buf));
+  std::memcpy(buf, rp, size);
+  return _mm_loadu_si128((const __m128i*)buf);
+}
+
+
+/**
+ * Process a serial data in the counter mode and the hash with the processor instructions.
+ */
+_KC_AESNIFUNC
+static void aes_gcm_ni(const AESCore* core, const uint8_t* iv,
+                       const uint8_t* rp, size_t size, uint8_t* wp,
+                       const uint8_t* abuf, size_t asiz, bool enc, uint8_t* tag) {
+  const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  const int32_t rnum = core->rnum;
+  __m128i rk[AESRNUMMAX+1];
+  for (int32_t i = 0; i <= rnum; i++) {
+    rk[i] = _mm_loadu_si128((const __m128i*)(core->rkb + i * AES::BLOCKSIZ));
+  }
+  __m128i hpow[AESPIPENUM];
+  for (size_t i = 0; i < AESPIPENUM; i++) {
+    hpow[i] = _mm_loadu_si128((const __m128i*)(core->hpow + i * AES::BLOCKSIZ));
+  }
+  const __m128i hkey = hpow[0];
+  __m128i x = _mm_setzero_si128();
+  uint64_t atotal = asiz;
+  while (asiz > 0) {
+    size_t len = asiz < AES::BLOCKSIZ ? asiz : AES::BLOCKSIZ;
+    __m128i blk = aes_ni_loadpart(abuf, len);
+    x = aes_ni_gfmul(_mm_xor_si128(x, _mm_shuffle_epi8(blk, bswap)), hkey);
+    abuf += len;
+    asiz -= len;
+  }
+  uint8_t cbuf[AES::BLOCKSIZ];
+  std::memcpy(cbuf, iv, AES::IVSIZ);
+  aes_write32(cbuf + AES::IVSIZ, 1);
+  __m128i ctr = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)cbuf), bswap);
+  __m128i j0 = _mm_loadu_si128((const __m128i*)cbuf);
+  const __m128i one = _mm_set_epi32(0, 0, 0, 1);
+  size_t rsiz = size;
+  while (rsiz >= AES::BLOCKSIZ * AESPIPENUM) {
+    __m128i b[AESPIPENUM];
+    for (size_t i = 0; i < AESPIPENUM; i++) {
+      ctr = _mm_add_epi32(ctr, one);
+      b[i] = _mm_xor_si128(_mm_shuffle_epi8(ctr, bswap), rk[0]);
+    }
+    for (int32_t r = 1; r < rnum; r++) {
+      for (size_t i = 0; i < AESPIPENUM; i++) {
+        b[i] = _mm_aesenc_si128(b[i], rk[r]);
+      }
+    }
+    __m128i lo = _mm_setzero_si128();
+    __m128i hi = _mm_setzero_si128();
+    for (size_t i = 0; i < AESPIPENUM; i++) {
+      __m128i in = _mm_loadu_si128((const __m128i*)(rp + i * AES::BLOCKSIZ));
+      __m128i out = _mm_xor_si128(_mm_aesenclast_si128(b[i], rk[rnum]), in);
+      _mm_storeu_si128((__m128i*)(wp + i * AES::BLOCKSIZ), out);
+      __m128i blk = _mm_shuffle_epi8(enc ? out : in, bswap);
+      if (i == 0) blk = _mm_xor_si128(blk, x);
+      aes_ni_clmul(blk, hpow[AESPIPENUM-1-i], &lo, &hi);
+    }
+    x = aes_ni_reduce(lo, hi);
+    rp += AES::BLOCKSIZ * AESPIPENUM;
+    wp += AES::BLOCKSIZ * AESPIPENUM;
+    rsiz -= AES::BLOCKSIZ * AESPIPENUM;
+  }
+  while (rsiz > 0) {
+    size_t len = rsiz < AES::BLOCKSIZ ? rsiz : AES::BLOCKSIZ;
+    ctr = _mm_add_epi32(ctr, one);
+    __m128i b = _mm_xor_si128(_mm_shuffle_epi8(ctr, bswap), rk[0]);
+    for (int32_t r = 1; r < rnum; r++) {
+      b = _mm_aesenc_si128(b, rk[r]);
+    }
+    b = _mm_aesenclast_si128(b, rk[rnum]);
+    __m128i in = aes_ni_loadpart(rp, len);
+    __m128i out = _mm_xor_si128(b, in);
+    uint8_t obuf[AES::BLOCKSIZ];
+    _mm_storeu_si128((__m128i*)obuf, out);
+    std::memcpy(wp, obuf, len);
+    if (enc) out = aes_ni_loadpart(obuf, len);
+    x = aes_ni_gfmul(_mm_xor_si128(x, _mm_shuffle_epi8(enc ? out : in, bswap)), hkey);
+    rp += len;
+    wp += len;
+    rsiz -= len;
+  }
+  __m128i lens = _mm_set_epi64x((int64_t)(atotal * 8), (int64_t)(size * 8));
+  x = aes_ni_gfmul(_mm_xor_si128(x, lens), hkey);
+  __m128i b = _mm_xor_si128(j0, rk[0]);
+  for (int32_t r = 1; r < rnum; r++) {
+    b = _mm_aesenc_si128(b, rk[r]);
+  }
+  b = _mm_aesenclast_si128(b, rk[rnum]);
+  _mm_storeu_si128((__m128i*)tag, _mm_xor_si128(b, _mm_shuffle_epi8(x, bswap)));
+}
+
+
+#endif
+
+
+/**
+ * Constructor.
+ */
+AES::AES() : opq_(NULL) {
+  _assert_(true);
+  AESCore* core = new AESCore;
+  std::memset(core, 0, sizeof(*core));
+  opq_ = core;
+}
+
+
+/**
+ * Destructor.
+ */
+AES::~AES() {
+  _assert_(true);
+  delete (AESCore*)opq_;
+}
+
+
+/**
+ * Set the cipher key.
+ */
+bool AES::set_key(const void* kbuf, size_t ksiz) {
+  _assert_(kbuf);
+  if (ksiz != 16 && ksiz != 24 && ksiz != 32) return false;
+  AESCore* core = (AESCore*)opq_;
+  int32_t knum = ksiz / 4;
+  core->rnum = knum + 6;
+  int32_t wnum = 4 * (core->rnum + 1);
+  uint32_t* rk = core->rk;
+  const uint8_t* kp = (const uint8_t*)kbuf;
+  for (int32_t i = 0; i < knum; i++) {
+    rk[i] = aes_read32(kp + i * 4);
+  }
+  uint32_t rcon = 0x01;
+  for (int32_t i = knum; i < wnum; i++) {
+    uint32_t num = rk[i-1];
+    if (i % knum == 0) {
+      num = (num << 8) | (num >> 24);
+      num = (((uint32_t)aes_sbox[num>>24] << 24) | ((uint32_t)aes_sbox[(num>>16)&0xff] << 16) |
+             ((uint32_t)aes_sbox[(num>>8)&0xff] << 8) | aes_sbox[num&0xff]) ^ (rcon << 24);
+      rcon = ((rcon << 1) ^ ((rcon & 0x80) ? 0x1b : 0)) & 0xff;
+    } else if (knum > 6 && i % knum == 4) {
+      num = ((uint32_t)aes_sbox[num>>24] << 24) | ((uint32_t)aes_sbox[(num>>16)&0xff] << 16) |
+        ((uint32_t)aes_sbox[(num>>8)&0xff] << 8) | aes_sbox[num&0xff];
+    }
+    rk[i] = rk[i-knum] ^ num;
+  }
+  for (int32_t i = 0; i < wnum; i++) {
+    aes_write32(core->rkb + i * 4, rk[i]);
+  }
+  uint8_t zbuf[BLOCKSIZ];
+  std::memset(zbuf, 0, sizeof(zbuf));
+  aes_encrypt_block(core, zbuf, core->hkey);
+  uint64_t vh = ((uint64_t)aes_read32(core->hkey) << 32) | aes_read32(core->hkey + 4);
+  uint64_t vl = ((uint64_t)aes_read32(core->hkey + 8) << 32) | aes_read32(core->hkey + 12);
+  core->hh[0] = 0;
+  core->hl[0] = 0;
+  core->hh[8] = vh;
+  core->hl[8] = vl;
+  for (int32_t i = 4; i > 0; i >>= 1) {
+    uint64_t rem = (vl & 1) ? 0xe1000000ULL : 0;
+    vl = (vh << 63) | (vl >> 1);
+    vh = (vh >> 1) ^ (rem << 32);
+    core->hh[i] = vh;
+    core->hl[i] = vl;
+  }
+  for (int32_t i = 2; i <= 8; i *= 2) {
+    for (int32_t j = 1; j < i; j++) {
+      core->hh[i+j] = core->hh[i] ^ core->hh[j];
+      core->hl[i+j] = core->hl[i] ^ core->hl[j];
+    }
+  }
+#if _KC_AESNI
+  if (aes_ni) aes_ni_hpow(core);
+#endif
+  return true;
+}
+
+
+/**
+ * Encrypt a serial data.
+ */
+void AES::encrypt(const void* iv, const void* buf, size_t size, char* obuf, char* tag,
+                  const void* abuf, size_t asiz) const {
+  _assert_(iv && buf && size <= MEMMAXSIZ && obuf && tag && asiz <= MEMMAXSIZ);
+  const AESCore* core = (const AESCore*)opq_;
+#if _KC_AESNI
+  if (aes_ni) {
+    aes_gcm_ni(core, (const uint8_t*)iv, (const uint8_t*)buf, size, (uint8_t*)obuf,
+               (const uint8_t*)abuf, asiz, true, (uint8_t*)tag);
+    return;
+  }
+#endif
+  aes_gcm_portable(core, (const uint8_t*)iv, (const uint8_t*)buf, size, (uint8_t*)obuf,
+                   (const uint8_t*)abuf, asiz, true, (uint8_t*)tag);
+}
+
+
+/**
+ * Decrypt a serial data.
+ */
+bool AES::decrypt(const void* iv, const void* buf, size_t size, char* obuf, const char* tag,
+                  const void* abuf, size_t asiz) const {
+  _assert_(iv && buf && size <= MEMMAXSIZ && obuf && tag && asiz <= MEMMAXSIZ);
+  const AESCore* core = (const AESCore*)opq_;
+  uint8_t ctag[TAGSIZ];
+#if _KC_AESNI
+  if (aes_ni) {
+    aes_gcm_ni(core, (const uint8_t*)iv, (const uint8_t*)buf, size, (uint8_t*)obuf,
+               (const uint8_t*)abuf, asiz, false, ctag);
+  } else {
+    aes_gcm_portable(core, (const uint8_t*)iv, (const uint8_t*)buf, size, (uint8_t*)obuf,
+                     (const uint8_t*)abuf, asiz, false, ctag);
+  }
+#else
+  aes_gcm_portable(core, (const uint8_t*)iv, (const uint8_t*)buf, size, (uint8_t*)obuf,
+                   (const uint8_t*)abuf, asiz, false, ctag);
+#endif
+  uint8_t diff = 0;
+  for (size_t i = 0; i < TAGSIZ; i++) {
+    diff |= ctag[i] ^ ((const uint8_t*)tag)[i];
+  }
+  return diff == 0;
+}
+
+
+/**
+ * Check whether the processor instructions are used.
+ */
+bool AES::accelerated() {
+  _assert_(true);
+  return aes_ni;
+}
+
+
+/**
+ * Derive a cipher key from a passphrase.
+ */
+void AES::derive_key(const void* pbuf, size_t psiz, const void* sbuf, size_t ssiz,
+                     int64_t iternum, char* kbuf, size_t ksiz) {
+  _assert_(pbuf && psiz <= MEMMAXSIZ && sbuf && ssiz <= MEMMAXSIZ && kbuf);
+  if (iternum < 1) iternum = 1;
+  AES aes;
+  AESCore* core = (AESCore*)aes.opq_;
+  uint8_t pkey[BLOCKSIZ], sub[BLOCKSIZ*2];
+  if (psiz == BLOCKSIZ) {
+    std::memcpy(pkey, pbuf, BLOCKSIZ);
+  } else {
+    std::memset(pkey, 0, sizeof(pkey));
+    aes.set_key(pkey, sizeof(pkey));
+    aes_cmac_subkeys(core, sub);
+    aes_cmac(core, sub, (const uint8_t*)pbuf, psiz, pkey);
+  }
+  aes.set_key(pkey, sizeof(pkey));
+  aes_cmac_subkeys(core, sub);
+  std::memset(pkey, 0, sizeof(pkey));
+  size_t msiz = ssiz + sizeof(uint32_t);
+  uint8_t* mbuf = new uint8_t[msiz];
+  std::memcpy(mbuf, sbuf, ssiz);
+  uint8_t* wp = (uint8_t*)kbuf;
+  for (uint32_t bidx = 1; ksiz > 0; bidx++) {
+    aes_write32(mbuf + ssiz, bidx);
+    uint8_t ubuf[BLOCKSIZ], tbuf[BLOCKSIZ];
+    aes_cmac(core, sub, mbuf, msiz, ubuf);
+    std::memcpy(tbuf, ubuf, BLOCKSIZ);
+    for (int64_t i = 1; i < iternum; i++) {
+      aes_cmac(core, sub, ubuf, BLOCKSIZ, ubuf);
+      for (size_t j = 0; j < BLOCKSIZ; j++) {
+        tbuf[j] ^= ubuf[j];
+      }
+    }
+    size_t csiz = ksiz < BLOCKSIZ ? ksiz : BLOCKSIZ;
+    std::memcpy(wp, tbuf, csiz);
+    wp += csiz;
+    ksiz -= csiz;
+  }
+  std::memset(sub, 0, sizeof(sub));
+  delete[] mbuf;
+}
+
+
 /**
  * Prepared pointer of the ZLIB raw mode.
  */
@@ -208,6 +208,89 @@ class LZMA {
 };
 
 
+/**
+ * AES block cipher in the Galois/Counter mode.
+ * @note The AES-NI and the carry-less multiplication instructions are used if the processor
+ * supports them, and portable code is used otherwise.
+ */
+class AES {
+ public:
+  /** The size of each block. */
+  static const size_t BLOCKSIZ = 16;
+  /** The size of the initial vector. */
+  static const size_t IVSIZ = 12;
+  /** The size of the authentication tag. */
+  static const size_t TAGSIZ = 16;
+  /**
+   * Default constructor.
+   */
+  explicit AES();
+  /**
+   * Destructor.
+   */
+  ~AES();
+  /**
+   * Set the cipher key.
+   * @param kbuf the pointer to the region of the cipher key.
+   * @param ksiz the size of the region of the cipher key, which should be 16, 24, or 32.
+   * @return true on success, or false on failure.
+   */
+  bool set_key(const void* kbuf, size_t ksiz);
+  /**
+   * Encrypt a serial data.
+   * @param iv the initial vector of IVSIZ bytes, which must not be reused with the same key.
+   * @param buf the input buffer.
+   * @param size the size of the input buffer.
+   * @param obuf the output buffer of the same size as the input buffer.
+   * @param tag the buffer of TAGSIZ bytes into which the authentication tag is written.
+   * @param abuf the additional data to be authenticated, or NULL for nothing.
+   * @param asiz the size of the additional data.
+   */
+  void encrypt(const void* iv, const void* buf, size_t size, char* obuf, char* tag,
+               const void* abuf = NULL, size_t asiz = 0) const;
+  /**
+   * Decrypt a serial data.
+   * @param iv the initial vector of IVSIZ bytes.
+   * @param buf the input buffer.
+   * @param size the size of the input buffer.
+   * @param obuf the output buffer of the same size as the input buffer.
+   * @param tag the authentication tag of TAGSIZ bytes.
+   * @param abuf the additional data to be authenticated, or NULL for nothing.
+   * @param asiz the size of the additional data.
+   * @return true on success, or false if the authentication tag does not match.
+   */
+  bool decrypt(const void* iv, const void* buf, size_t size, char* obuf, const char* tag,
+               const void* abuf = NULL, size_t asiz = 0) const;
+  /**
+   * Check whether the processor instructions are used.
+   * @return true if they are used, or false if not.
+   */
+  static bool accelerated();
+  /**
+   * Derive a cipher key from a passphrase.
+   * @param pbuf the pointer to the region of the passphrase.
+   * @param psiz the size of the region of the passphrase.
+   * @param sbuf the pointer to the region of the salt.
+   * @param ssiz the size of the region of the salt.
+   * @param iternum the number of iterations.
+   * @param kbuf the buffer into which the key is written.
+   * @param ksiz the size of the key.
+   * @note The key is derived by PBKDF2 of RFC 8018 with AES-CMAC-PRF-128 of RFC 4615 as the
+   * pseudorandom function, so that a passphrase of any length is stretched into a key whose
+   * every bit depends on the whole passphrase.
+   */
+  static void derive_key(const void* pbuf, size_t psiz, const void* sbuf, size_t ssiz,
+                         int64_t iternum, char* kbuf, size_t ksiz);
+ private:
+  /** Dummy constructor to forbid the use. */
+  AES(const AES&);
+  /** Dummy Operator to forbid the use. */
+  AES& operator =(const AES&);
+  /** Opaque pointer. */
+  void* opq_;
+};
+
+
 /**
  * Compressor with ZLIB.
  */
@@ -390,12 +473,311 @@ class ArcfourCompressor : public Compressor {
 };
 
 
+/**
+ * Compressor with the AES cipher in the Galois/Counter mode.
+ * @note Each result is composed of the initial vector, the cipher text, and the authentication
+ * tag, and tampered data fail to be decompressed.  The initial vector is composed of a random
+ * prefix of each object and a counter, which must not be reused with the same key.  The cipher
+ * key is derived from the passphrase given by set_key, and nothing is compressed before it is
+ * given.
+ */
+class AESCompressor : public Compressor {
+ public:
+  /** The number of iterations of the key derivation. */
+  static const int64_t KDFITERNUM = 1LL << 16;
+  /**
+   * Constructor.
+   */
+  AESCompressor() : aes_(), comp_(NULL), salt_(0), prefix_(0), keyed_(false) {
+    _assert_(true);
+    double now = time();
+    uint64_t seed[2];
+    seed[0] = (uint64_t)(now * 1000000);
+    seed[1] = (uint64_t)(intptr_t)this;
+    prefix_ = hashmurmur(seed, sizeof(seed));
+    salt_.set(seed[0]);
+  }
+  /**
+   * Set the passphrase of the cipher key.
+   * @param kbuf the pointer to the region of the passphrase.
+   * @param ksiz the size of the region of the passphrase.
+   * @return true on success, or false if the passphrase is empty.
+   * @note The 256-bit cipher key is derived from the passphrase by AES::derive_key with
+   * KDFITERNUM iterations, which takes a few milliseconds on purpose.
+   */
+  bool set_key(const void* kbuf, size_t ksiz) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ);
+    if (ksiz < 1) return false;
+    static const char ksalt[] = "kyotocabinet:aes";
+    char key[32];
+    AES::derive_key(kbuf, ksiz, ksalt, sizeof(ksalt) - 1, KDFITERNUM, key, sizeof(key));
+    keyed_ = aes_.set_key(key, sizeof(key));
+    std::memset(key, 0, sizeof(key));
+    return keyed_;
+  }
+  /**
+   * Set an additional data compressor applied before encryption.
+   * @param comp the additional data data compressor.
+   */
+  void set_compressor(Compressor* comp) {
+    _assert_(comp);
+    comp_ = comp;
+  }
+  /**
+   * Begin the cycle of the counter of the initial vector.
+   * @param salt the initial value of the counter.
+   */
+  void begin_cycle(uint64_t salt = 0) {
+    _assert_(true);
+    salt_.set(salt);
+  }
+ private:
+  /**
+   * Compress a serial data.
+   */
+  char* compress(const void* buf, size_t size, size_t* sp) {
+    _assert_(buf && size <= MEMMAXSIZ && sp);
+    if (!keyed_) return NULL;
+    char* tbuf = NULL;
+    if (comp_) {
+      tbuf = comp_->compress(buf, size, &size);
+      if (!tbuf) return NULL;
+      buf = tbuf;
+    }
+    size_t zsiz = AES::IVSIZ + size + AES::TAGSIZ;
+    char* zbuf = new char[zsiz];
+    writefixnum(zbuf, prefix_, AES::IVSIZ - sizeof(uint64_t));
+    writefixnum(zbuf + AES::IVSIZ - sizeof(uint64_t), salt_.add(1), sizeof(uint64_t));
+    aes_.encrypt(zbuf, buf, size, zbuf + AES::IVSIZ, zbuf + AES::IVSIZ + size);
+    delete[] tbuf;
+    *sp = zsiz;
+    return zbuf;
+  }
+  /**
+   * Decompress a serial data.
+   */
+  char* decompress(const void* buf, size_t size, size_t* sp) {
+    _assert_(buf && size <= MEMMAXSIZ && sp);
+    if (!keyed_ || size < AES::IVSIZ + AES::TAGSIZ) return NULL;
+    const char* rp = (const char*)buf;
+    size -= AES::IVSIZ + AES::TAGSIZ;
+    char* zbuf = new char[size+1];
+    if (!aes_.decrypt(rp, rp + AES::IVSIZ, size, zbuf, rp + AES::IVSIZ + size)) {
+      delete[] zbuf;
+      return NULL;
+    }
+    zbuf[size] = '\0';
+    if (comp_) {
+      char* tbuf = comp_->decompress(zbuf, size, &size);
+      delete[] zbuf;
+      if (!tbuf) return NULL;
+      zbuf = tbuf;
+    }
+    *sp = size;
+    return zbuf;
+  }
+  /** The cipher. */
+  AES aes_;
+  /** The data compressor. */
+  Compressor* comp_;
+  /** The counter of the initial vector. */
+  AtomicInt64 salt_;
+  /** The prefix of the initial vector. */
+  uint64_t prefix_;
+  /** The flag whether the key is set. */
+  bool keyed_;
+};
+
+
 /**
  * Prepared pointer of the compressor with ZLIB raw mode.
  */
 extern ZLIBCompressor<ZLIB::RAW>* const ZLIBRAWCOMP;
 
 
+/**
+ * Compressor which stores incompressible data as is.
+ * @note Each result is tagged with a leading byte of the codec.  Data whose byte entropy
+ * estimated from a sample is too high are stored raw without trying the compressor, and so are
+ * data whose compressed size does not satisfy the ratio.  Results are not compatible with the
+ * underlying compressor used alone.
+ */
+class AdaptiveCompressor : public Compressor {
+ public:
+  /**
+   * Codec tags.
+   */
+  enum Tag {
+    TRAW = 0,                            ///< stored as is
+    TCOMP = 1                            ///< compressed by the underlying compressor
+  };
+  /**
+   * Default constructor.
+   */
+  explicit AdaptiveCompressor() :
+      comp_(ZLIBRAWCOMP), ratio_(0.9), entmax_(7.5),
+      rawcnt_(0), skipcnt_(0), compcnt_(0), insize_(0), outsize_(0), usec_(0) {
+    _assert_(true);
+  }
+  /**
+   * Set the underlying data compressor.
+   * @param comp the underlying data compressor.  By default, the ZLIB raw compressor is used.
+   */
+  void set_compressor(Compressor* comp) {
+    _assert_(comp);
+    comp_ = comp;
+  }
+  /**
+   * Set the ratio of the compressed size to the original size to be stored compressed.
+   * @param ratio the maximum ratio.  By default, it is 0.9.
+   */
+  void set_ratio(double ratio) {
+    _assert_(ratio > 0);
+    ratio_ = ratio;
+  }
+  /**
+   * Set the maximum byte entropy of samples to try the underlying compressor.
+   * @param bits the maximum entropy in bits per byte.  By default, it is 7.5.  If it is 8 or
+   * more, the compressor is always tried.
+   */
+  void set_entropy(double bits) {
+    _assert_(bits > 0);
+    entmax_ = bits;
+  }
+  /**
+   * Get the statistics of compression.
+   * @param strmap a string map to contain the result.  "zraw" is the number of results stored
+   * raw, "zskip" is the number of those not tried by the compressor, "zcomp" is the number of
+   * results stored compressed, "zinsize" is the total size of the input, "zoutsize" is the
+   * total size of the results, "zsaved" is the difference between them, and "ztime" is the
+   * time spent for compression in microseconds.
+   */
+  void status(std::map<std::string, std::string>* strmap) {
+    _assert_(strmap);
+    int64_t insize = insize_.get();
+    int64_t outsize = outsize_.get();
+    (*strmap)["zraw"] = strprintf("%lld", (long long)rawcnt_.get());
+    (*strmap)["zskip"] = strprintf("%lld", (long long)skipcnt_.get());
+    (*strmap)["zcomp"] = strprintf("%lld", (long long)compcnt_.get());
+    (*strmap)["zinsize"] = strprintf("%lld", (long long)insize);
+    (*strmap)["zoutsize"] = strprintf("%lld", (long long)outsize);
+    (*strmap)["zsaved"] = strprintf("%lld", (long long)(insize - outsize));
+    (*strmap)["ztime"] = strprintf("%lld", (long long)usec_.get());
+  }
+  /**
+   * Estimate the byte entropy of a sample of a serial data.
+   * @param buf the input buffer.
+   * @param size the size of the input buffer.
+   * @return the estimated entropy in bits per byte.
+   */
+  static double estimate_entropy(const void* buf, size_t size) {
+    _assert_(buf && size <= MEMMAXSIZ);
+    const unsigned char* rp = (const unsigned char*)buf;
+    if (size > SAMPLESIZ) {
+      rp += (size - SAMPLESIZ) / 2;
+      size = SAMPLESIZ;
+    }
+    if (size < 1) return 0;
+    uint32_t freqs[UINT8MAX+1];
+    std::memset(freqs, 0, sizeof(freqs));
+    const unsigned char* ep = rp + size;
+    while (rp < ep) {
+      freqs[*rp]++;
+      rp++;
+    }
+    double ent = 0;
+    for (int32_t i = 0; i <= UINT8MAX; i++) {
+      if (freqs[i] < 1) continue;
+      double prob = (double)freqs[i] / size;
+      ent -= prob * std::log(prob);
+    }
+    return ent / std::log(2.0);
+  }
+ private:
+  /** The size of samples to estimate entropy. */
+  static const size_t SAMPLESIZ = 1024;
+  /** The minimum size to estimate entropy. */
+  static const size_t SAMPLEMIN = 256;
+  /**
+   * Compress a serial data.
+   */
+  char* compress(const void* buf, size_t size, size_t* sp) {
+    _assert_(buf && size <= MEMMAXSIZ && sp);
+    double stime = time();
+    char* zbuf = NULL;
+    size_t zsiz = 0;
+    bool skip = entmax_ < 8 && size >= SAMPLEMIN && estimate_entropy(buf, size) > entmax_;
+    if (!skip) {
+      char* tbuf = comp_->compress(buf, size, &zsiz);
+      if (tbuf) {
+        if (zsiz < size * ratio_) {
+          zbuf = new char[1+zsiz];
+          *zbuf = TCOMP;
+          std::memcpy(zbuf + 1, tbuf, zsiz);
+        }
+        delete[] tbuf;
+      }
+    }
+    if (zbuf) {
+      compcnt_.add(1);
+    } else {
+      zsiz = size;
+      zbuf = new char[1+zsiz];
+      *zbuf = TRAW;
+      std::memcpy(zbuf + 1, buf, zsiz);
+      rawcnt_.add(1);
+      if (skip) skipcnt_.add(1);
+    }
+    zsiz++;
+    insize_.add(size);
+    outsize_.add(zsiz);
+    usec_.add((int64_t)((time() - stime) * 1000000));
+    *sp = zsiz;
+    return zbuf;
+  }
+  /**
+   * Decompress a serial data.
+   */
+  char* decompress(const void* buf, size_t size, size_t* sp) {
+    _assert_(buf && size <= MEMMAXSIZ && sp);
+    if (size < 1) return NULL;
+    const char* rp = (const char*)buf;
+    switch (*rp) {
+      case TRAW: {
+        size--;
+        char* zbuf = new char[size+1];
+        std::memcpy(zbuf, rp + 1, size);
+        zbuf[size] = '\0';
+        *sp = size;
+        return zbuf;
+      }
+      case TCOMP: {
+        return comp_->decompress(rp + 1, size - 1, sp);
+      }
+    }
+    return NULL;
+  }
+  /** The underlying data compressor. */
+  Compressor* comp_;
+  /** The maximum ratio to store compressed. */
+  double ratio_;
+  /** The maximum entropy to try the compressor. */
+  double entmax_;
+  /** The number of results stored raw. */
+  ShardedInt64 rawcnt_;
+  /** The number of results stored raw without trial. */
+  ShardedInt64 skipcnt_;
+  /** The number of results stored compressed. */
+  ShardedInt64 compcnt_;
+  /** The total size of the input. */
+  ShardedInt64 insize_;
+  /** The total size of the output. */
+  ShardedInt64 outsize_;
+  /** The total time of compression in microseconds. */
+  ShardedInt64 usec_;
+};
+
+
 }                                        // common namespace
 
 #endif                                   // duplication check
@@ -26,6 +26,34 @@ const char* const DB::Visitor::NOP = (const char*)0;
 const char* const DB::Visitor::REMOVE = (const char*)1;
 
 
+/**
+ * Prepared pointer of the merge operator to add integers.
+ */
+IntegerAddMerger intaddmergefunc;
+IntegerAddMerger* const INTADDMERGE = &intaddmergefunc;
+
+
+/**
+ * Prepared pointer of the merge operator to add real numbers.
+ */
+DoubleAddMerger doubleaddmergefunc;
+DoubleAddMerger* const DOUBLEADDMERGE = &doubleaddmergefunc;
+
+
+/**
+ * Prepared pointer of the merge operator to append operands.
+ */
+AppendMerger appendmergefunc;
+AppendMerger* const APPENDMERGE = &appendmergefunc;
+
+
+/**
+ * Prepared pointer of the merge operator to keep the maximum.
+ */
+MaximumMerger maxmergefunc;
+MaximumMerger* const MAXMERGE = &maxmergefunc;
+
+
 }                                        // common namespace
 
 // END OF FILE
@@ -29,6 +29,223 @@
 namespace kyotocabinet {                 // common namespace
 
 
+/**
+ * Interface of merge operator of record values.
+ * @note A merge operator folds an operand into the value of a record.  It must be associative
+ * so that operands can be folded into each other before they are folded into the value.
+ */
+class MergeOperator {
+ public:
+  /**
+   * Destructor.
+   */
+  virtual ~MergeOperator() {}
+  /**
+   * Merge an operand into a value.
+   * @param vbuf the pointer to the region of the current value.  NULL means that no record
+   * corresponds.
+   * @param vsiz the size of the region of the current value.
+   * @param obuf the pointer to the region of the operand.
+   * @param osiz the size of the region of the operand.
+   * @param sp the pointer to the variable into which the size of the region of the return
+   * value is assigned.
+   * @return the pointer to the region of the merged value, or NULL if the operand can not be
+   * merged into the value.
+   * @note Because the region of the return value is allocated with the the new[] operator, it
+   * should be released with the delete[] operator when it is no longer in use.
+   */
+  virtual char* merge(const char* vbuf, size_t vsiz, const char* obuf, size_t osiz,
+                      size_t* sp) = 0;
+};
+
+
+/**
+ * Merge operator to add integers.
+ * @note The value and the operand are serialized as 8-byte binary integers in big-endian order
+ * as with the BasicDB::increment method.
+ */
+class IntegerAddMerger : public MergeOperator {
+ public:
+  explicit IntegerAddMerger() {}
+  char* merge(const char* vbuf, size_t vsiz, const char* obuf, size_t osiz, size_t* sp) {
+    _assert_(obuf && sp);
+    int64_t num;
+    if (osiz != sizeof(num) || (vbuf && vsiz != sizeof(num))) return NULL;
+    std::memcpy(&num, obuf, sizeof(num));
+    num = ntoh64(num);
+    if (vbuf) {
+      int64_t onum;
+      std::memcpy(&onum, vbuf, sizeof(onum));
+      num += ntoh64(onum);
+    }
+    num = hton64(num);
+    char* rbuf = new char[sizeof(num)];
+    std::memcpy(rbuf, &num, sizeof(num));
+    *sp = sizeof(num);
+    return rbuf;
+  }
+};
+
+
+/**
+ * Merge operator to add real numbers.
+ * @note The value and the operand are serialized as 16-byte binary fixed-point numbers in
+ * big-endian order as with the BasicDB::increment_double method.
+ */
+class DoubleAddMerger : public MergeOperator {
+ public:
+  /** The unit of the fraction part. */
+  static const int64_t DECUNIT = 1000000000000000LL;
+  /** The size of a serialized number. */
+  static const size_t NUMSIZ = sizeof(int64_t) * 2;
+  explicit DoubleAddMerger() {}
+  char* merge(const char* vbuf, size_t vsiz, const char* obuf, size_t osiz, size_t* sp) {
+    _assert_(obuf && sp);
+    if (osiz != NUMSIZ || (vbuf && vsiz != NUMSIZ)) return NULL;
+    int64_t linteg, lfract;
+    decode(obuf, &linteg, &lfract);
+    if (vbuf && !special(linteg, lfract)) {
+      int64_t ointeg, ofract;
+      decode(vbuf, &ointeg, &ofract);
+      if (special(ointeg, ofract)) {
+        linteg = ointeg;
+        lfract = ofract;
+      } else {
+        linteg += ointeg;
+        lfract += ofract;
+        if (lfract >= DECUNIT) {
+          linteg += 1;
+          lfract -= DECUNIT;
+        } else if (lfract <= -DECUNIT) {
+          linteg -= 1;
+          lfract += DECUNIT;
+        }
+      }
+    }
+    char* rbuf = new char[NUMSIZ];
+    linteg = hton64(linteg);
+    std::memcpy(rbuf, &linteg, sizeof(linteg));
+    lfract = hton64(lfract);
+    std::memcpy(rbuf + sizeof(linteg), &lfract, sizeof(lfract));
+    *sp = NUMSIZ;
+    return rbuf;
+  }
+  /**
+   * Serialize a real number into an operand.
+   * @param num the number.
+   * @param buf the pointer to the region into which the operand is written.  The size of the
+   * region should be DoubleAddMerger::NUMSIZ.
+   */
+  static void encode(double num, char* buf) {
+    _assert_(buf);
+    long double dinteg;
+    long double dfract = std::modfl(num, &dinteg);
+    int64_t linteg, lfract;
+    if (chknan(dinteg)) {
+      linteg = INT64MIN;
+      lfract = INT64MIN;
+    } else if (chkinf(dinteg)) {
+      linteg = dinteg > 0 ? INT64MAX : INT64MIN;
+      lfract = 0;
+    } else {
+      linteg = (int64_t)dinteg;
+      lfract = (int64_t)(dfract * DECUNIT);
+    }
+    linteg = hton64(linteg);
+    std::memcpy(buf, &linteg, sizeof(linteg));
+    lfract = hton64(lfract);
+    std::memcpy(buf + sizeof(linteg), &lfract, sizeof(lfract));
+  }
+  /**
+   * Deserialize a real number from a value.
+   * @param buf the pointer to the region of the value, whose size should be
+   * DoubleAddMerger::NUMSIZ.
+   * @return the number.
+   */
+  static double decode(const char* buf) {
+    _assert_(buf);
+    int64_t linteg, lfract;
+    decode(buf, &linteg, &lfract);
+    if (lfract == INT64MIN && linteg == INT64MIN) return nan();
+    if (linteg == INT64MAX) return HUGE_VAL;
+    if (linteg == INT64MIN) return -HUGE_VAL;
+    return linteg + (double)lfract / DECUNIT;
+  }
+ private:
+  static void decode(const char* buf, int64_t* ip, int64_t* fp) {
+    std::memcpy(ip, buf, sizeof(*ip));
+    *ip = ntoh64(*ip);
+    std::memcpy(fp, buf + sizeof(*ip), sizeof(*fp));
+    *fp = ntoh64(*fp);
+  }
+  static bool special(int64_t linteg, int64_t lfract) {
+    return linteg == INT64MAX || linteg == INT64MIN;
+  }
+};
+
+
+/**
+ * Merge operator to append operands.
+ */
+class AppendMerger : public MergeOperator {
+ public:
+  explicit AppendMerger() {}
+  char* merge(const char* vbuf, size_t vsiz, const char* obuf, size_t osiz, size_t* sp) {
+    _assert_(obuf && sp);
+    if (!vbuf) vsiz = 0;
+    char* rbuf = new char[vsiz+osiz];
+    if (vsiz > 0) std::memcpy(rbuf, vbuf, vsiz);
+    std::memcpy(rbuf + vsiz, obuf, osiz);
+    *sp = vsiz + osiz;
+    return rbuf;
+  }
+};
+
+
+/**
+ * Merge operator to keep the maximum in the lexical order.
+ */
+class MaximumMerger : public MergeOperator {
+ public:
+  explicit MaximumMerger() {}
+  char* merge(const char* vbuf, size_t vsiz, const char* obuf, size_t osiz, size_t* sp) {
+    _assert_(obuf && sp);
+    if (vbuf && LEXICALCOMP->compare(vbuf, vsiz, obuf, osiz) > 0) {
+      obuf = vbuf;
+      osiz = vsiz;
+    }
+    char* rbuf = new char[osiz];
+    std::memcpy(rbuf, obuf, osiz);
+    *sp = osiz;
+    return rbuf;
+  }
+};
+
+
+/**
+ * Prepared pointer of the merge operator to add integers.
+ */
+extern IntegerAddMerger* const INTADDMERGE;
+
+
+/**
+ * Prepared pointer of the merge operator to add real numbers.
+ */
+extern DoubleAddMerger* const DOUBLEADDMERGE;
+
+
+/**
+ * Prepared pointer of the merge operator to append operands.
+ */
+extern AppendMerger* const APPENDMERGE;
+
+
+/**
+ * Prepared pointer of the merge operator to keep the maximum.
+ */
+extern MaximumMerger* const MAXMERGE;
+
+
 /**
  * Interface of database abstraction.
  * @note This class is an abstract class to prescribe the interface of record access.
@@ -485,6 +702,7 @@ class BasicDB : public DB {
   class FileProcessor;
   class Logger;
   class MetaTrigger;
+  class WriteBatch;
  private:
   /** The size of the IO buffer. */
   static const size_t IOBUFSIZ = 8192;
@@ -1151,6 +1369,246 @@ class BasicDB : public DB {
      */
     virtual void trigger(Kind kind, const char* message) = 0;
   };
+  /**
+   * Batch of updating operations to be applied at once.
+   * @note Operations are grouped by the key and replayed in the order of addition for each
+   * record.  The records are visited in the lexical order of the keys.
+   */
+  class WriteBatch {
+   public:
+    /**
+     * Replay results.
+     */
+    enum Result {
+      RNOP,                              ///< the record is not changed
+      RSET,                              ///< the record is set
+      RREMOVE,                           ///< the record is removed
+      RFAIL                              ///< logical inconsistency
+    };
+   private:
+    /** Operation kinds. */
+    enum OpType {
+      OSET,                              ///< setting
+      OAPPEND,                           ///< appending
+      OREMOVE,                           ///< removing
+      OINCREMENT                         ///< incrementing
+    };
+    /** Updating operation. */
+    struct Operation {
+      OpType type;                       ///< kind of the operation
+      std::string value;                 ///< value
+      int64_t num;                       ///< additional number
+      int64_t orig;                      ///< origin number
+    };
+    /** Type of the map of operations. */
+    typedef std::map<std::string, std::vector<Operation> > OperationMap;
+   public:
+    /**
+     * Default constructor.
+     */
+    explicit WriteBatch() : ops_(), count_(0) {
+      _assert_(true);
+    }
+    /**
+     * Add a setting operation.
+     * @param kbuf the pointer to the key region.
+     * @param ksiz the size of the key region.
+     * @param vbuf the pointer to the value region.
+     * @param vsiz the size of the value region.
+     */
+    void set(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ);
+      add(OSET, kbuf, ksiz, vbuf, vsiz, 0, 0);
+    }
+    /**
+     * Add a setting operation.
+     * @note Equal to the original WriteBatch::set method except that the parameters are
+     * std::string.
+     */
+    void set(const std::string& key, const std::string& value) {
+      _assert_(true);
+      set(key.data(), key.size(), value.data(), value.size());
+    }
+    /**
+     * Add an appending operation.
+     * @param kbuf the pointer to the key region.
+     * @param ksiz the size of the key region.
+     * @param vbuf the pointer to the value region.
+     * @param vsiz the size of the value region.
+     */
+    void append(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ);
+      add(OAPPEND, kbuf, ksiz, vbuf, vsiz, 0, 0);
+    }
+    /**
+     * Add an appending operation.
+     * @note Equal to the original WriteBatch::append method except that the parameters are
+     * std::string.
+     */
+    void append(const std::string& key, const std::string& value) {
+      _assert_(true);
+      append(key.data(), key.size(), value.data(), value.size());
+    }
+    /**
+     * Add a removing operation.
+     * @param kbuf the pointer to the key region.
+     * @param ksiz the size of the key region.
+     */
+    void remove(const char* kbuf, size_t ksiz) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ);
+      add(OREMOVE, kbuf, ksiz, "", 0, 0, 0);
+    }
+    /**
+     * Add a removing operation.
+     * @note Equal to the original WriteBatch::remove method except that the parameter is
+     * std::string.
+     */
+    void remove(const std::string& key) {
+      _assert_(true);
+      remove(key.data(), key.size());
+    }
+    /**
+     * Add an incrementing operation.
+     * @param kbuf the pointer to the key region.
+     * @param ksiz the size of the key region.
+     * @param num the additional number.
+     * @param orig the origin number if no record corresponds to the key.  It is treated as the
+     * same as the parameter of the BasicDB::increment method.
+     */
+    void increment(const char* kbuf, size_t ksiz, int64_t num, int64_t orig = 0) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ);
+      add(OINCREMENT, kbuf, ksiz, "", 0, num, orig);
+    }
+    /**
+     * Add an incrementing operation.
+     * @note Equal to the original WriteBatch::increment method except that the parameter is
+     * std::string.
+     */
+    void increment(const std::string& key, int64_t num, int64_t orig = 0) {
+      _assert_(true);
+      increment(key.data(), key.size(), num, orig);
+    }
+    /**
+     * Get the number of operations.
+     * @return the number of operations.
+     */
+    int64_t count() const {
+      _assert_(true);
+      return count_;
+    }
+    /**
+     * Remove all operations.
+     */
+    void clear() {
+      _assert_(true);
+      ops_.clear();
+      count_ = 0;
+    }
+    /**
+     * Get the keys of the target records.
+     * @param dest the vector to contain the distinct keys in the lexical order.
+     */
+    void keys(std::vector<std::string>* dest) const {
+      _assert_(dest);
+      dest->reserve(dest->size() + ops_.size());
+      OperationMap::const_iterator it = ops_.begin();
+      OperationMap::const_iterator itend = ops_.end();
+      while (it != itend) {
+        dest->push_back(it->first);
+        ++it;
+      }
+    }
+    /**
+     * Replay the operations for a record.
+     * @param kbuf the pointer to the key region.
+     * @param ksiz the size of the key region.
+     * @param vbuf the pointer to the current value region, or NULL if no record corresponds.
+     * @param vsiz the size of the current value region.
+     * @param rbuf a string to contain the result value.
+     * @return WriteBatch::RSET if the record is to be set as the result value,
+     * WriteBatch::RREMOVE if the record is to be removed, WriteBatch::RNOP if the record is not
+     * changed, or WriteBatch::RFAIL if an incrementing operation is inconsistent.
+     */
+    Result replay(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz,
+                  std::string* rbuf) const {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ && rbuf);
+      OperationMap::const_iterator it = ops_.find(std::string(kbuf, ksiz));
+      if (it == ops_.end()) return RNOP;
+      bool exist = vbuf != NULL;
+      bool changed = false;
+      rbuf->clear();
+      if (exist) rbuf->append(vbuf, vsiz);
+      std::vector<Operation>::const_iterator oit = it->second.begin();
+      std::vector<Operation>::const_iterator oitend = it->second.end();
+      while (oit != oitend) {
+        switch (oit->type) {
+          case OSET: {
+            *rbuf = oit->value;
+            exist = true;
+            changed = true;
+            break;
+          }
+          case OAPPEND: {
+            if (!exist) rbuf->clear();
+            rbuf->append(oit->value);
+            exist = true;
+            changed = true;
+            break;
+          }
+          case OREMOVE: {
+            if (exist) {
+              rbuf->clear();
+              exist = false;
+              changed = true;
+            }
+            break;
+          }
+          case OINCREMENT: {
+            int64_t num = oit->num;
+            if (exist) {
+              if (rbuf->size() != sizeof(num)) return RFAIL;
+              if (oit->orig != INT64MAX) {
+                if (num == 0) break;
+                int64_t onum;
+                std::memcpy(&onum, rbuf->data(), sizeof(onum));
+                num += ntoh64(onum);
+              }
+            } else {
+              if (oit->orig == INT64MIN) return RFAIL;
+              if (oit->orig != INT64MAX) num += oit->orig;
+            }
+            uint64_t big = hton64(num);
+            rbuf->assign((const char*)&big, sizeof(big));
+            exist = true;
+            changed = true;
+            break;
+          }
+        }
+        ++oit;
+      }
+      if (!changed || (!exist && !vbuf)) return RNOP;
+      return exist ? RSET : RREMOVE;
+    }
+   private:
+    /**
+     * Add an operation.
+     */
+    void add(OpType type, const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz,
+             int64_t num, int64_t orig) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ);
+      Operation op;
+      op.type = type;
+      op.value.append(vbuf, vsiz);
+      op.num = num;
+      op.orig = orig;
+      ops_[std::string(kbuf, ksiz)].push_back(op);
+      count_++;
+    }
+    /** The operations grouped by the key. */
+    OperationMap ops_;
+    /** The number of operations. */
+    int64_t count_;
+  };
   /**
    * Open modes.
    */
@@ -1163,7 +1621,8 @@ class BasicDB : public DB {
     OAUTOSYNC = 1 << 5,                  ///< auto synchronization
     ONOLOCK = 1 << 6,                    ///< open without locking
     OTRYLOCK = 1 << 7,                   ///< lock without blocking
-    ONOREPAIR = 1 << 8                   ///< open without auto repair
+    ONOREPAIR = 1 << 8,                  ///< open without auto repair
+    OREADBIAS = 1 << 9                   ///< bias the locking to readers
   };
   /**
    * Destructor.
@@ -1200,6 +1659,8 @@ class BasicDB : public DB {
    * bitwise-or: BasicDB::ONOLOCK, which means it opens the database file without file locking,
    * BasicDB::OTRYLOCK, which means locking is performed without blocking, File::ONOREPAIR, which
    * means the database file is not repaired implicitly even if file destruction is detected.
+   * BasicDB::OREADBIAS may also be added to bias the lock of the database object to readers,
+   * which makes reading operations cheaper and updating operations dearer.
    * @return true on success, or false on failure.
    * @note Every opened database must be closed by the BasicDB::close method when it is no longer
    * in use.  It is not allowed for two or more database objects in the same process to keep
@@ -1269,25 +1730,65 @@ class BasicDB : public DB {
    * be performed in this function.
    */
   virtual bool occupy(bool writable = true, FileProcessor* proc = NULL) = 0;
+  /**
+   * Perform defragmentation of the file.
+   * @param step the number of steps.  If it is not more than 0, the whole region is defraged.
+   * @return true on success, or false on failure.
+   * @note This default implementation does nothing.  Database classes whose storage can be
+   * fragmented override it.
+   */
+  virtual bool defrag(int64_t step = 0) {
+    _assert_(true);
+    return true;
+  }
   /**
    * Create a copy of the database file.
    * @param dest the path of the destination file.
    * @param checker a progress checker object.  If it is NULL, no checking is performed.
    * @return true on success, or false on failure.
+   * @note Updating operations are blocked while the database is synchronized and copied.  If
+   * the file system supports it, the copy shares the extents of the database file and takes
+   * constant time.  Otherwise, the whole file is copied while the database is blocked, which
+   * takes as long as reading and writing all of its data.  The checker is called after each
+   * chunk of the data is copied, so that the progress can be tracked and the copy can be
+   * cancelled.  If the database consists of multiple files, such as a sharded database, each
+   * of them is copied to the path made by inserting "-" and its index before the suffix of the
+   * file name of the destination, as the default paths of the shards of PolyDB.
    */
   bool copy(const std::string& dest, ProgressChecker* checker = NULL) {
     _assert_(true);
+    class CopyCheckerImpl : public File::CopyChecker {
+     public:
+      explicit CopyCheckerImpl(ProgressChecker* checker, BasicDB* db) :
+          checker_(checker), db_(db) {}
+     private:
+      bool check(int64_t cursiz, int64_t allsiz) {
+        if (!checker_->check("copy", "processing", cursiz, allsiz)) {
+          db_->set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+          return false;
+        }
+        return true;
+      }
+      ProgressChecker* checker_;
+      BasicDB* db_;
+    };
     class FileProcessorImpl : public FileProcessor {
      public:
       explicit FileProcessorImpl(const std::string& dest, ProgressChecker* checker,
                                  BasicDB* db) :
-          dest_(dest), checker_(checker), db_(db) {}
+          dest_(dest), checker_(checker), db_(db), cnt_(0) {}
      private:
       bool process(const std::string& path, int64_t count, int64_t size) {
+        if (cnt_ == 1 && !File::rename(dest_, shard_path(0))) {
+          db_->set_error(_KCCODELINE_, Error::SYSTEM, "renaming the destination failed");
+          return false;
+        }
+        const std::string& dest = cnt_ > 0 ? shard_path(cnt_) : dest_;
+        cnt_++;
         File::Status sbuf;
         if (!File::status(path, &sbuf)) return false;
         if (sbuf.isdir) {
-          if (!File::make_directory(dest_)) return false;
+          if (!File::make_directory(dest)) return false;
           bool err = false;
           DirStream dir;
           if (dir.open(path)) {
@@ -1299,21 +1800,8 @@ class BasicDB : public DB {
             int64_t curcnt = 0;
             while (!err && dir.read(&name)) {
               const std::string& spath = path + File::PATHCHR + name;
-              const std::string& dpath = dest_ + File::PATHCHR + name;
-              int64_t dsiz;
-              char* dbuf = File::read_file(spath, &dsiz);
-              if (dbuf) {
-                if (!File::write_file(dpath, dbuf, dsiz)) err = true;
-                delete[] dbuf;
-              } else {
-                err = true;
-              }
-              curcnt++;
-              if (checker_ && !checker_->check("copy", "processing", curcnt, -1)) {
-                db_->set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
-                err = true;
-                break;
-              }
+              const std::string& dpath = dest + File::PATHCHR + name;
+              if (!copy_entry(spath, dpath, &curcnt)) err = true;
             }
             if (checker_ && !checker_->check("copy", "ending", -1, -1)) {
               db_->set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
@@ -1325,52 +1813,60 @@ class BasicDB : public DB {
           }
           return !err;
         }
-        std::ofstream ofs;
-        ofs.open(dest_.c_str(),
-                 std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
-        if (!ofs) return false;
         bool err = false;
-        std::ifstream ifs;
-        ifs.open(path.c_str(), std::ios_base::in | std::ios_base::binary);
         if (checker_ && !checker_->check("copy", "beginning", 0, size)) {
           db_->set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
           err = true;
         }
-        if (ifs) {
-          char buf[IOBUFSIZ];
-          int64_t curcnt = 0;
-          while (!err && !ifs.eof()) {
-            size_t n = ifs.read(buf, sizeof(buf)).gcount();
-            if (n > 0) {
-              ofs.write(buf, n);
-              if (!ofs) {
-                err = true;
-                break;
-              }
-            }
-            curcnt += n;
-            if (checker_ && !checker_->check("copy", "processing", curcnt, size)) {
-              db_->set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
-              err = true;
-              break;
-            }
-          }
-          ifs.close();
-          if (ifs.bad()) err = true;
-        } else {
-          err = true;
-        }
+        CopyCheckerImpl cchecker(checker_, db_);
+        if (!err && !File::copy_file(path, dest, checker_ ? &cchecker : NULL)) err = true;
         if (checker_ && !checker_->check("copy", "ending", -1, size)) {
           db_->set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
           err = true;
         }
-        ofs.close();
-        if (!ofs) err = true;
         return !err;
       }
+      bool copy_entry(const std::string& spath, const std::string& dpath, int64_t* curcnt) {
+        File::Status sbuf;
+        if (!File::status(spath, &sbuf)) return false;
+        if (sbuf.isdir) {
+          if (!File::make_directory(dpath)) return false;
+          bool err = false;
+          DirStream dir;
+          if (!dir.open(spath)) return false;
+          std::string name;
+          while (!err && dir.read(&name)) {
+            if (!copy_entry(spath + File::PATHCHR + name, dpath + File::PATHCHR + name,
+                            curcnt)) err = true;
+          }
+          if (!dir.close()) err = true;
+          return !err;
+        }
+        if (!File::copy_file(spath, dpath)) return false;
+        (*curcnt)++;
+        if (checker_ && !checker_->check("copy", "processing", *curcnt, -1)) {
+          db_->set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+          return false;
+        }
+        return true;
+      }
+      std::string shard_path(int32_t idx) {
+        std::string base = "";
+        std::string name = dest_;
+        size_t pos = dest_.rfind(File::PATHCHR);
+        if (pos != std::string::npos) {
+          base = dest_.substr(0, pos + 1);
+          name = dest_.substr(pos + 1);
+        }
+        size_t epos = name.rfind(File::EXTCHR);
+        if (epos == std::string::npos || epos == 0) epos = name.size();
+        name.insert(epos, strprintf("-%d", idx));
+        return base + name;
+      }
       const std::string& dest_;
       ProgressChecker* checker_;
       BasicDB* db_;
+      int32_t cnt_;
     };
     FileProcessorImpl proc(dest, checker, this);
     return synchronize(false, &proc, checker);
@@ -1591,6 +2087,72 @@ class BasicDB : public DB {
     _assert_(true);
     return append(key.c_str(), key.size(), value.c_str(), value.size());
   }
+  /**
+   * Merge an operand into the value of a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param obuf the pointer to the operand region.
+   * @param osiz the size of the operand region.
+   * @param op the merge operator.
+   * @return true on success, or false on failure.
+   * @note If no record corresponds to the key, a new record is created with the operand merged
+   * into nothing.  If the operand can not be merged into the existing value, this function
+   * fails and the record is not modified.
+   */
+  virtual bool merge(const char* kbuf, size_t ksiz, const char* obuf, size_t osiz,
+                     MergeOperator* op) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && obuf && osiz <= MEMMAXSIZ && op);
+    class VisitorImpl : public Visitor {
+     public:
+      explicit VisitorImpl(const char* obuf, size_t osiz, MergeOperator* op) :
+          obuf_(obuf), osiz_(osiz), op_(op), nbuf_(NULL), err_(false) {}
+      ~VisitorImpl() {
+        delete[] nbuf_;
+      }
+      bool error() {
+        return err_;
+      }
+     private:
+      const char* visit_full(const char* kbuf, size_t ksiz,
+                             const char* vbuf, size_t vsiz, size_t* sp) {
+        nbuf_ = op_->merge(vbuf, vsiz, obuf_, osiz_, sp);
+        if (!nbuf_) {
+          err_ = true;
+          return NOP;
+        }
+        return nbuf_;
+      }
+      const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
+        nbuf_ = op_->merge(NULL, 0, obuf_, osiz_, sp);
+        if (!nbuf_) {
+          err_ = true;
+          return NOP;
+        }
+        return nbuf_;
+      }
+      const char* obuf_;
+      size_t osiz_;
+      MergeOperator* op_;
+      char* nbuf_;
+      bool err_;
+    };
+    VisitorImpl visitor(obuf, osiz, op);
+    if (!accept(kbuf, ksiz, &visitor, true)) return false;
+    if (visitor.error()) {
+      set_error(_KCCODELINE_, Error::LOGIC, "logical inconsistency");
+      return false;
+    }
+    return true;
+  }
+  /**
+   * Merge an operand into the value of a record.
+   * @note Equal to the original BasicDB::merge method except that the parameters are
+   * std::string.
+   */
+  bool merge(const std::string& key, const std::string& operand, MergeOperator* op) {
+    _assert_(op);
+    return merge(key.c_str(), key.size(), operand.c_str(), operand.size(), op);
+  }
   /**
    * Add a number to the numeric value of a record.
    * @param kbuf the pointer to the key region.
@@ -2262,6 +2824,72 @@ class BasicDB : public DB {
     }
     return recs->size();
   }
+  /**
+   * Apply a batch of updating operations at once.
+   * @param batch the batch of operations.
+   * @return the number of changed records, or -1 on failure.
+   * @note All target records are locked in one pass and the operations for them are performed
+   * atomically.  If an incrementing operation is inconsistent with the existing record, the
+   * operations for the record are discarded and this function fails after the other records
+   * are updated.  Use a transaction to roll back them together.
+   */
+  int64_t write_batch(const WriteBatch& batch) {
+    _assert_(true);
+    std::vector<std::string> keys;
+    batch.keys(&keys);
+    class VisitorImpl : public Visitor {
+     public:
+      explicit VisitorImpl(const WriteBatch& batch) :
+          batch_(batch), rbuf_(), cnt_(0), fail_(false) {}
+      int64_t cnt() const {
+        return cnt_;
+      }
+      bool fail() const {
+        return fail_;
+      }
+     private:
+      const char* visit_full(const char* kbuf, size_t ksiz,
+                             const char* vbuf, size_t vsiz, size_t* sp) {
+        return replay(kbuf, ksiz, vbuf, vsiz, sp);
+      }
+      const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
+        return replay(kbuf, ksiz, NULL, 0, sp);
+      }
+      const char* replay(const char* kbuf, size_t ksiz,
+                         const char* vbuf, size_t vsiz, size_t* sp) {
+        switch (batch_.replay(kbuf, ksiz, vbuf, vsiz, &rbuf_)) {
+          case WriteBatch::RSET: {
+            cnt_++;
+            *sp = rbuf_.size();
+            return rbuf_.data();
+          }
+          case WriteBatch::RREMOVE: {
+            cnt_++;
+            return REMOVE;
+          }
+          case WriteBatch::RFAIL: {
+            fail_ = true;
+            break;
+          }
+          default: {
+            break;
+          }
+        }
+        return NOP;
+      }
+      const WriteBatch& batch_;
+      std::string rbuf_;
+      int64_t cnt_;
+      bool fail_;
+    };
+    VisitorImpl visitor(batch);
+    if (!accept_bulk(keys, &visitor, true)) return -1;
+    if (visitor.fail()) {
+      set_error(_KCCODELINE_, Error::LOGIC, "logical inconsistency");
+      return -1;
+    }
+    return visitor.cnt();
+  }
   /**
    * Dump records into a data stream.
    * @param dest the destination stream.
@@ -914,6 +914,7 @@ class IndexDB {
             uint32_t mode = BasicDB::OWRITER | BasicDB::OCREATE) {
     _assert_(true);
     ScopedRWLock lock(&mlock_, true);
+    mlock_.set_bias(mode & BasicDB::OREADBIAS);
     if (omode_ != 0) {
       set_error(_KCCODELINE_, BasicDB::Error::INVALID, "already opened");
       return false;
@@ -1683,6 +1684,330 @@ class IndexDB {
 };
 
 
+/**
+ * Asynchronous database interface.
+ * @note This class is a wrapper of a database object to perform record operations in background
+ * by a pool of worker threads.  Each operation is submitted with a ticket number and its result
+ * is delivered to the completion queue, from which it is retrieved by the AsyncDB::poll method
+ * or the AsyncDB::wait method.  Operations are completed in arbitrary order, so the ticket
+ * number of each result should be checked.  The wrapped database object must be kept opened
+ * while the worker threads are running.  At most as many operations as the worker threads are
+ * performed at the same time, and the others wait in the task queue, whose depth can be
+ * limited when the worker threads are started.
+ */
+class AsyncDB {
+ public:
+  struct Completion;
+ private:
+  class TaskImpl;
+  class TaskQueueImpl;
+  /** An alias of queue of completions. */
+  typedef std::deque<Completion> CompletionQueue;
+ public:
+  /** The default number of worker threads and of operations performed at the same time. */
+  static const size_t DEFTHNUM = 8;
+  /**
+   * Kinds of operations.
+   */
+  enum Operation {
+    OGET,                                ///< retrieve the value of a record
+    OSET,                                ///< set the value of a record
+    OREMOVE,                             ///< remove a record
+    OACCEPT                              ///< accept a visitor to a record
+  };
+  /**
+   * Result of an operation.
+   */
+  struct Completion {
+    uint64_t ticket;                     ///< ticket number of the operation
+    Operation op;                        ///< kind of the operation
+    BasicDB::Error error;                ///< error status
+    std::string key;                     ///< key of the record
+    std::string value;                   ///< value retrieved by the get operation
+  };
+  /**
+   * Constructor.
+   * @param db the database object to be operated.  Its possession is not transferred.
+   */
+  explicit AsyncDB(BasicDB* db) :
+      db_(db), queue_(NULL), qmax_(0), tlock_(), seed_(0), clock_(), cond_(), qcond_(),
+      comps_(), inflight_(0), queued_(0) {
+    _assert_(db);
+  }
+  /**
+   * Destructor.
+   * @note If the worker threads are running, they are stopped implicitly.
+   */
+  ~AsyncDB() {
+    _assert_(true);
+    if (queue_) stop();
+  }
+  /**
+   * Start the worker threads.
+   * @param thnum the number of worker threads, which is also the number of operations
+   * performed at the same time.
+   * @param qmax the maximum number of operations waiting to be performed.  If it is not more
+   * than 0, the task queue is not limited.
+   * @return true on success, or false on failure.
+   * @note If the task queue is full, submitting an operation blocks until a worker thread
+   * takes the first one.
+   */
+  bool start(size_t thnum = DEFTHNUM, size_t qmax = 0) {
+    _assert_(thnum <= MEMMAXSIZ && qmax <= MEMMAXSIZ);
+    ScopedMutex lock(&tlock_);
+    if (queue_ || thnum < 1) return false;
+    qmax_ = qmax;
+    queue_ = new TaskQueueImpl(this);
+    queue_->start(thnum);
+    return true;
+  }
+  /**
+   * Stop the worker threads.
+   * @return true on success, or false on failure.
+   * @note Operations submitted already are performed before the worker threads are stopped.
+   * Their results are kept in the completion queue.
+   */
+  bool stop() {
+    _assert_(true);
+    ScopedMutex lock(&tlock_);
+    if (!queue_) return false;
+    queue_->finish();
+    delete queue_;
+    queue_ = NULL;
+    return true;
+  }
+  /**
+   * Submit an operation to retrieve the value of a record.
+   * @param key the key.
+   * @return the ticket number of the operation, or 0 on failure.
+   */
+  uint64_t submit_get(const std::string& key) {
+    _assert_(true);
+    return submit(OGET, key, "", NULL, false);
+  }
+  /**
+   * Submit an operation to set the value of a record.
+   * @param key the key.
+   * @param value the value.
+   * @return the ticket number of the operation, or 0 on failure.
+   */
+  uint64_t submit_set(const std::string& key, const std::string& value) {
+    _assert_(true);
+    return submit(OSET, key, value, NULL, true);
+  }
+  /**
+   * Submit an operation to remove a record.
+   * @param key the key.
+   * @return the ticket number of the operation, or 0 on failure.
+   */
+  uint64_t submit_remove(const std::string& key) {
+    _assert_(true);
+    return submit(OREMOVE, key, "", NULL, true);
+  }
+  /**
+   * Submit an operation to accept a visitor to a record.
+   * @param key the key.
+   * @param visitor a visitor object.  It must be kept alive until the operation is completed.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @return the ticket number of the operation, or 0 on failure.
+   * @note The visitor is called by a worker thread.
+   */
+  uint64_t submit_accept(const std::string& key, BasicDB::Visitor* visitor,
+                         bool writable = true) {
+    _assert_(visitor);
+    return submit(OACCEPT, key, "", visitor, writable);
+  }
+  /**
+   * Retrieve the result of a completed operation without blocking.
+   * @param comp the structure to contain the result.
+   * @return true on success, or false if no operation has been completed.
+   */
+  bool poll(Completion* comp) {
+    _assert_(comp);
+    ScopedMutex lock(&clock_);
+    if (comps_.empty()) return false;
+    pop(comp);
+    return true;
+  }
+  /**
+   * Wait for the result of a completed operation.
+   * @param comp the structure to contain the result.
+   * @param sec the timeout in seconds.  If it is negative, no timeout is specified.
+   * @return true on success, or false if no operation is pending or on timeout.
+   */
+  bool wait(Completion* comp, double sec = -1) {
+    _assert_(comp);
+    ScopedMutex lock(&clock_);
+    double deadline = sec >= 0 ? time() + sec : 0;
+    while (comps_.empty()) {
+      if (inflight_ < 1) return false;
+      if (sec < 0) {
+        cond_.wait(&clock_);
+        continue;
+      }
+      double rest = deadline - time();
+      if (rest <= 0) return false;
+      cond_.wait(&clock_, rest);
+    }
+    pop(comp);
+    return true;
+  }
+  /**
+   * Get the number of operations whose results have not been retrieved.
+   * @return the number of operations whose results have not been retrieved.
+   */
+  int64_t pending() {
+    _assert_(true);
+    ScopedMutex lock(&clock_);
+    return inflight_;
+  }
+ private:
+  /**
+   * Task of an operation.
+   */
+  class TaskImpl : public TaskQueue::Task {
+    friend class AsyncDB;
+   public:
+    /** constructor */
+    explicit TaskImpl() : ticket_(0), op_(OGET), key_(), value_(), visitor_(NULL),
+                          writable_(false) {}
+   private:
+    uint64_t ticket_;                    ///< ticket number
+    Operation op_;                       ///< kind of the operation
+    std::string key_;                    ///< key
+    std::string value_;                  ///< value
+    BasicDB::Visitor* visitor_;          ///< visitor
+    bool writable_;                      ///< whether writable
+  };
+  /**
+   * Task queue of the worker threads.
+   */
+  class TaskQueueImpl : public TaskQueue {
+   public:
+    /** constructor */
+    explicit TaskQueueImpl(AsyncDB* adb) : adb_(adb) {}
+   private:
+    void do_task(Task* task) {
+      TaskImpl* atask = (TaskImpl*)task;
+      adb_->perform(atask);
+      delete atask;
+    }
+    AsyncDB* adb_;                       ///< database
+  };
+  /**
+   * Submit an operation.
+   * @param op the kind of the operation.
+   * @param key the key.
+   * @param value the value.
+   * @param visitor the visitor, or NULL.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @return the ticket number of the operation, or 0 on failure.
+   */
+  uint64_t submit(Operation op, const std::string& key, const std::string& value,
+                  BasicDB::Visitor* visitor, bool writable) {
+    _assert_(true);
+    ScopedMutex lock(&tlock_);
+    if (!queue_) return 0;
+    TaskImpl* task = new TaskImpl;
+    task->ticket_ = ++seed_;
+    task->op_ = op;
+    task->key_ = key;
+    task->value_ = value;
+    task->visitor_ = visitor;
+    task->writable_ = writable;
+    uint64_t ticket = task->ticket_;
+    clock_.lock();
+    while (qmax_ > 0 && queued_ >= (int64_t)qmax_) {
+      qcond_.wait(&clock_);
+    }
+    inflight_++;
+    queued_++;
+    clock_.unlock();
+    queue_->add_task(task);
+    return ticket;
+  }
+  /**
+   * Perform an operation and deliver the result to the completion queue.
+   * @param task the task of the operation.
+   */
+  void perform(TaskImpl* task) {
+    _assert_(task);
+    clock_.lock();
+    queued_--;
+    qcond_.signal();
+    clock_.unlock();
+    Completion comp;
+    comp.ticket = task->ticket_;
+    comp.op = task->op_;
+    comp.key.swap(task->key_);
+    bool ok = false;
+    switch (task->op_) {
+      case OGET: {
+        ok = db_->get(comp.key, &comp.value);
+        break;
+      }
+      case OSET: {
+        ok = db_->set(comp.key, task->value_);
+        break;
+      }
+      case OREMOVE: {
+        ok = db_->remove(comp.key);
+        break;
+      }
+      case OACCEPT: {
+        ok = db_->accept(comp.key.data(), comp.key.size(), task->visitor_, task->writable_);
+        break;
+      }
+    }
+    if (!ok) comp.error = db_->error();
+    ScopedMutex lock(&clock_);
+    comps_.push_back(comp);
+    cond_.broadcast();
+  }
+  /**
+   * Pop the first completion.
+   * @param comp the structure to contain the result.
+   */
+  void pop(Completion* comp) {
+    _assert_(comp);
+    Completion& first = comps_.front();
+    comp->ticket = first.ticket;
+    comp->op = first.op;
+    comp->error = first.error;
+    comp->key.swap(first.key);
+    comp->value.swap(first.value);
+    comps_.pop_front();
+    inflight_--;
+  }
+  /** Dummy constructor to forbid the use. */
+  AsyncDB(const AsyncDB&);
+  /** Dummy Operator to forbid the use. */
+  AsyncDB& operator =(const AsyncDB&);
+  /** The database. */
+  BasicDB* db_;
+  /** The task queue. */
+  TaskQueueImpl* queue_;
+  /** The maximum number of waiting operations. */
+  size_t qmax_;
+  /** The lock for the task queue. */
+  Mutex tlock_;
+  /** The seed of ticket numbers. */
+  uint64_t seed_;
+  /** The lock for the completion queue. */
+  Mutex clock_;
+  /** The condition variable for the completion queue. */
+  CondVar cond_;
+  /** The condition variable for the task queue. */
+  CondVar qcond_;
+  /** The completion queue. */
+  CompletionQueue comps_;
+  /** The number of operations whose results have not been retrieved. */
+  int64_t inflight_;
+  /** The number of operations waiting to be performed. */
+  int64_t queued_;
+};
+
+
 }                                        // common namespace
 
 #endif                                   // duplication check
@@ -55,6 +55,9 @@ class DirDB : public BasicDB {
   class Cursor;
  private:
   struct Record;
+  struct FileOperation;
+  struct FileBatch;
+  class RecordStream;
   class ScopedVisitor;
   /** An alias of list of cursors. */
   typedef std::list<Cursor*> CursorList;
@@ -72,6 +75,85 @@ class DirDB : public BasicDB {
   static const size_t OPAQUESIZ = 16;
   /** The threshold of busy loop and sleep for locking. */
   static const uint32_t LOCKBUSYLOOP = 8192;
+  /** The maximum depth of hashed subdirectories. */
+  static const int32_t FANOUTMAX = 3;
+  /** The minimum number of file operations performed by each I/O thread. */
+  static const size_t IOBATCHMIN = 8;
+  /** The maximum number of I/O threads. */
+  static const size_t IOTHMAX = 8;
+  /**
+   * Stream of the file names of records in the hashed subdirectories.
+   */
+  class RecordStream {
+   public:
+    /** constructor */
+    explicit RecordStream() : dirs_(), paths_(), depth_(-1), fanout_(0) {
+      _assert_(true);
+    }
+    /** destructor */
+    ~RecordStream() {
+      _assert_(true);
+      close();
+    }
+    /**
+     * Open the stream.
+     * @param path the path of the database directory.
+     * @param fanout the depth of hashed subdirectories.
+     * @return true on success, or false on failure.
+     */
+    bool open(const std::string& path, int32_t fanout) {
+      _assert_(fanout >= 0 && fanout <= FANOUTMAX);
+      if (depth_ >= 0 || !dirs_[0].open(path)) return false;
+      paths_[0] = path;
+      depth_ = 0;
+      fanout_ = fanout;
+      return true;
+    }
+    /**
+     * Close the stream.
+     * @return true on success, or false on failure.
+     */
+    bool close() {
+      _assert_(true);
+      if (depth_ < 0) return false;
+      bool err = false;
+      while (depth_ >= 0) {
+        if (!dirs_[depth_].close()) err = true;
+        depth_--;
+      }
+      return !err;
+    }
+    /**
+     * Read the file name of the next record.
+     * @param name the string to contain the file name.
+     * @return true on success, or false on failure.
+     * @note Subdirectories are entered in depth-first order and the names of magic files are
+     * skipped.
+     */
+    bool read(std::string* name) {
+      _assert_(name);
+      while (depth_ >= 0) {
+        if (!dirs_[depth_].read(name)) {
+          if (depth_ < 1) return false;
+          dirs_[depth_--].close();
+          continue;
+        }
+        if (*name->c_str() == *KCDDBMAGICFILE) continue;
+        if (depth_ < fanout_) {
+          const std::string& dpath = paths_[depth_] + File::PATHCHR + *name;
+          if (dirs_[depth_+1].open(dpath)) paths_[++depth_] = dpath;
+          continue;
+        }
+        return true;
+      }
+      return false;
+    }
+   private:
+    DirStream dirs_[FANOUTMAX+1];        ///< directory streams of each level
+    std::string paths_[FANOUTMAX+1];     ///< paths of the opened directories
+    int32_t depth_;                      ///< depth of the current directory
+    int32_t fanout_;                     ///< depth of hashed subdirectories
+  };
  public:
   /**
    * Cursor to indicate a record.
@@ -123,7 +205,7 @@ class DirDB : public BasicDB {
         return false;
       }
       bool err = false;
-      const std::string& rpath = db_->path_ + File::PATHCHR + name_;
+      const std::string& rpath = db_->record_path(db_->path_, name_.c_str());
       int64_t cnt = db_->count_;
       Record rec;
       if (db_->read_record(rpath, &rec)) {
@@ -146,7 +228,7 @@ class DirDB : public BasicDB {
             break;
           }
           if (*name_.c_str() == *KCDDBMAGICFILE) continue;
-          const std::string& npath = db_->path_ + File::PATHCHR + name_;
+          const std::string& npath = db_->record_path(db_->path_, name_.c_str());
           if (!File::status(npath)) continue;
           if (db_->read_record(npath, &rec)) {
             if (!db_->accept_visit_full(rec.kbuf, rec.ksiz, rec.vbuf, rec.vsiz, rec.rsiz,
@@ -181,7 +263,7 @@ class DirDB : public BasicDB {
         db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
         return false;
       }
-      if (!dir_.open(db_->path_)) {
+      if (!dir_.open(db_->path_, db_->fanout_)) {
         db_->set_error(_KCCODELINE_, Error::SYSTEM, "opening a directory failed");
         return false;
       }
@@ -205,7 +287,7 @@ class DirDB : public BasicDB {
       _assert_(kbuf && ksiz <= MEMMAXSIZ);
       ScopedRWLock lock(&db_->mlock_, true);
       if (alive_ && !disable()) return false;
-      if (!dir_.open(db_->path_)) {
+      if (!dir_.open(db_->path_, db_->fanout_)) {
         db_->set_error(_KCCODELINE_, Error::SYSTEM, "opening a directory failed");
         return false;
       }
@@ -217,7 +299,7 @@ class DirDB : public BasicDB {
           return false;
         }
         if (*name_.c_str() == *KCDDBMAGICFILE) continue;
-        const std::string& rpath = db_->path_ + File::PATHCHR + name_;
+        const std::string& rpath = db_->record_path(db_->path_, name_.c_str());
         Record rec;
         if (db_->read_record(rpath, &rec)) {
           if (rec.ksiz == ksiz && !std::memcmp(rec.kbuf, kbuf, ksiz)) {
@@ -350,7 +432,7 @@ class DirDB : public BasicDB {
     /** The inner database. */
     DirDB* db_;
     /** The inner directory stream. */
-    DirStream dir_;
+    RecordStream dir_;
     /** The flag if alive. */
     bool alive_;
     /** The current name. */
@@ -382,7 +464,8 @@ class DirDB : public BasicDB {
       file_(), curs_(), path_(""),
       libver_(LIBVER), librev_(LIBREV), fmtver_(FMTVER), chksum_(0), type_(TYPEDIR),
       flags_(0), opts_(0), count_(0), size_(0), opaque_(), embcomp_(ZLIBRAWCOMP), comp_(NULL),
-      tran_(false), trhard_(false), trcount_(0), trsize_(0), walpath_(""), tmppath_("") {
+      fanout_(0), tran_(false), trhard_(false), trcount_(0), trsize_(0),
+      walpath_(""), tmppath_("") {
     _assert_(true);
   }
   /**
@@ -444,7 +527,8 @@ class DirDB : public BasicDB {
    * @return true on success, or false on failure.
    * @note The operations for specified records are performed atomically and other threads
    * accessing the same records are blocked.  To avoid deadlock, any explicit database operation
-   * must not be performed in this function.
+   * must not be performed in this function.  The visitor is called in the caller thread while
+   * the files of the updated records are written in a batch by multiple threads.
    */
   bool accept_bulk(const std::vector<std::string>& keys, Visitor* visitor,
                    bool writable = true) {
@@ -486,13 +570,20 @@ class DirDB : public BasicDB {
       }
       ++lit;
     }
+    FileBatch batch;
+    FileBatch* bp = writable && knum >= IOBATCHMIN ? &batch : NULL;
     for (size_t i = 0; i < knum; i++) {
       RecordKey* rkey = rkeys + i;
-      if (!accept_impl(rkey->kbuf, rkey->ksiz, visitor, rkey->name)) {
+      if (bp && bp->names.find(rkey->name) != bp->names.end() && !commit_batch(bp)) {
+        err = true;
+        break;
+      }
+      if (!accept_impl(rkey->kbuf, rkey->ksiz, visitor, rkey->name, bp)) {
         err = true;
         break;
       }
     }
+    if (bp && !commit_batch(bp)) err = true;
     lit = lidxs.begin();
     litend = lidxs.end();
     while (lit != litend) {
@@ -597,6 +688,8 @@ class DirDB : public BasicDB {
    * DirDB::OTRYLOCK, which means locking is performed without blocking, DirDB::ONOREPAIR,
    * which means the database file is not repaired implicitly even if file destruction is
    * detected.
+   * DirDB::OREADBIAS may also be added to bias the lock of the database object to readers,
+   * which makes reading operations cheaper and updating operations dearer.
    * @return true on success, or false on failure.
    * @note Every opened database must be closed by the DirDB::close method when it is no
    * longer in use.  It is not allowed for two or more database objects in the same process to
@@ -605,6 +698,7 @@ class DirDB : public BasicDB {
   bool open(const std::string& path, uint32_t mode = OWRITER | OCREATE) {
     _assert_(true);
     ScopedRWLock lock(&mlock_, true);
+    mlock_.set_bias(mode & OREADBIAS);
     if (omode_ != 0) {
       set_error(_KCCODELINE_, Error::INVALID, "already opened");
       return false;
@@ -710,12 +804,16 @@ class DirDB : public BasicDB {
         return false;
       }
       std::memset(opaque_, 0, sizeof(opaque_));
-      if (autosync_ && !File::synchronize_whole()) {
+      if (autosync_ && !File::synchronize_filesystem(cpath)) {
         set_error(_KCCODELINE_, Error::SYSTEM, "synchronizing the file system failed");
         file_.close();
         return false;
       }
     } else {
+      if (!load_meta(metapath)) {
+        file_.close();
+        return false;
+      }
       if (File::status(walpath, &sbuf)) {
         if (writer_) {
           file_.truncate(0);
@@ -728,11 +826,12 @@ class DirDB : public BasicDB {
           std::string name;
           while (dir.read(&name)) {
             const std::string& srcpath = walpath + File::PATHCHR + name;
-            const std::string& destpath = cpath + File::PATHCHR + name;
+            const std::string& destpath = record_path(cpath, name.c_str());
             File::Status sbuf;
             if (File::status(srcpath, &sbuf)) {
               if (sbuf.size > 1) {
-                File::rename(srcpath, destpath);
+                if (!File::rename(srcpath, destpath) && make_leaf(destpath))
+                  File::rename(srcpath, destpath);
               } else {
                 if (File::remove(destpath) || !File::status(destpath)) File::remove(srcpath);
               }
@@ -744,10 +843,6 @@ class DirDB : public BasicDB {
           report(_KCCODELINE_, Logger::WARN, "recovered by the WAL directory");
         }
       }
-      if (!load_meta(metapath)) {
-        file_.close();
-        return false;
-      }
       comp_ = (opts_ & TCOMPRESS) ? embcomp_ : NULL;
       uint8_t chksum = calc_checksum();
       if (chksum != chksum_) {
@@ -992,12 +1087,11 @@ class DirDB : public BasicDB {
     bool err = false;
     if (!disable_cursors()) err = true;
     if (tran_) {
-      DirStream dir;
-      if (dir.open(path_)) {
+      RecordStream dir;
+      if (dir.open(path_, fanout_)) {
         std::string name;
         while (dir.read(&name)) {
-          if (*name.c_str() == *KCDDBMAGICFILE) continue;
-          const std::string& rpath = path_ + File::PATHCHR + name;
+          const std::string& rpath = record_path(path_, name.c_str());
           const std::string& walpath = walpath_ + File::PATHCHR + name;
           if (File::status(walpath)) {
             if (!File::remove(rpath)) {
@@ -1089,6 +1183,7 @@ class DirDB : public BasicDB {
     (*strmap)["chksum"] = strprintf("%u", chksum_);
     (*strmap)["flags"] = strprintf("%u", flags_);
     (*strmap)["opts"] = strprintf("%u", opts_);
+    (*strmap)["fanout"] = strprintf("%d", (int)fanout_);
     (*strmap)["recovered"] = strprintf("%d", recov_);
     (*strmap)["reorganized"] = strprintf("%d", reorg_);
     if (strmap->count("opaque") > 0)
@@ -1187,6 +1282,26 @@ class DirDB : public BasicDB {
     embcomp_ = comp;
     return true;
   }
+  /**
+   * Set the depth of hashed subdirectories.
+   * @param depth the number of levels of subdirectories between the database directory and
+   * each record file.  Each level fans out into 256 subdirectories chosen by the hash value of
+   * the file name of the record.  0 means the flat layout and the maximum is 3.
+   * @return true on success, or false on failure.
+   * @note The depth is fixed when the database is created and recorded in the meta data file.
+   * Existing databases are opened with their own depth.
+   */
+  bool tune_fanout(int8_t depth) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    fanout_ = depth > 0 ? depth : 0;
+    if (fanout_ > FANOUTMAX) fanout_ = FANOUTMAX;
+    return true;
+  }
   /**
    * Get the opaque data.
    * @return the pointer to the opaque data region, whose size is 16 bytes.
@@ -1528,6 +1643,24 @@ class DirDB : public BasicDB {
     const char* vbuf;                    ///< value buffer
     size_t vsiz;                         ///< value size
   };
+  /**
+   * File operation on a record.
+   */
+  struct FileOperation {
+    std::string rpath;                   ///< path of the record file
+    std::string tpath;                   ///< path of the temporary file for atomic update
+    std::string wpath;                   ///< path of the WAL file in transaction
+    bool exist;                          ///< whether the record file exists
+    char* rbuf;                          ///< image of the record, or NULL for removal
+    size_t rsiz;                         ///< size of the image
+  };
+  /**
+   * Batch of file operations.
+   */
+  struct FileBatch {
+    std::vector<FileOperation> ops;      ///< file operations
+    std::set<std::string> names;         ///< file names of the records
+  };
   /**
    * Scoped visitor.
    */
@@ -1602,16 +1735,15 @@ class DirDB : public BasicDB {
     _assert_(true);
     count_ = 0;
     size_ = 0;
-    DirStream dir;
-    if (!dir.open(cpath)) {
+    RecordStream dir;
+    if (!dir.open(cpath, fanout_)) {
       set_error(_KCCODELINE_, Error::SYSTEM, "opening a directory failed");
       return false;
     }
     bool err = false;
     std::string name;
     while (dir.read(&name)) {
-      if (*name.c_str() == *KCDDBMAGICFILE) continue;
-      const std::string& rpath = cpath + File::PATHCHR + name;
+      const std::string& rpath = record_path(cpath, name.c_str());
       File::Status sbuf;
       if (File::status(rpath, &sbuf)) {
         if (sbuf.size >= 4) {
@@ -1669,6 +1801,7 @@ class DirDB : public BasicDB {
     wp += std::sprintf(wp, "%u\n", chksum_);
     wp += std::sprintf(wp, "%u\n", type_);
     wp += std::sprintf(wp, "%u\n", opts_);
+    if (fanout_ > 0) wp += std::sprintf(wp, "%d\n", (int)fanout_);
     wp += std::sprintf(wp, "%s\n", KCDDBMAGICEOF);
     if (!File::write_file(metapath, buf, wp - buf)) {
       set_error(_KCCODELINE_, Error::SYSTEM, "writing a file failed");
@@ -1692,16 +1825,24 @@ class DirDB : public BasicDB {
     std::string str(buf, size);
     delete[] buf;
     std::vector<std::string> elems;
-    if (strsplit(str, '\n', &elems) < 7 || elems[6] != KCDDBMAGICEOF) {
+    size_t esiz = strsplit(str, '\n', &elems);
+    size_t eidx = esiz > 7 && elems[7] == KCDDBMAGICEOF ? 7 : 6;
+    if (esiz < 7 || elems[eidx] != KCDDBMAGICEOF) {
       set_error(_KCCODELINE_, Error::BROKEN, "invalid meta data file");
       return false;
     }
+    int64_t fanout = eidx > 6 ? atoi(elems[6].c_str()) : 0;
+    if (fanout < 0 || fanout > FANOUTMAX) {
+      set_error(_KCCODELINE_, Error::BROKEN, "invalid depth of subdirectories");
+      return false;
+    }
     libver_ = atoi(elems[0].c_str());
     librev_ = atoi(elems[1].c_str());
     fmtver_ = atoi(elems[2].c_str());
     chksum_ = atoi(elems[3].c_str());
     type_ = atoi(elems[4].c_str());
     opts_ = atoi(elems[5].c_str());
+    fanout_ = fanout;
     return true;
   }
   /**
@@ -1751,8 +1892,17 @@ class DirDB : public BasicDB {
       if (*name.c_str() == *KCDDBMAGICFILE) continue;
       const std::string& rpath = cpath + File::PATHCHR + name;
       if (!File::remove(rpath)) {
-        set_error(_KCCODELINE_, Error::SYSTEM, "removing a file failed");
-        err = true;
+        File::Status sbuf;
+        if (File::status(rpath, &sbuf) && sbuf.isdir) {
+          if (!remove_files(rpath)) err = true;
+          if (!File::remove_directory(rpath)) {
+            set_error(_KCCODELINE_, Error::SYSTEM, "removing a directory failed");
+            err = true;
+          }
+        } else {
+          set_error(_KCCODELINE_, Error::SYSTEM, "removing a file failed");
+          err = true;
+        }
       }
     }
     if (!dir.close()) {
@@ -1823,21 +1973,18 @@ class DirDB : public BasicDB {
     return true;
   }
   /**
-   * Write a record.
-   * @param rpath the path of the record.
-   * @param name the file name of the record.
+   * Make the image of a record file.
    * @param kbuf the pointer to the key region.
    * @param ksiz the size of the key region.
    * @param vbuf the pointer to the value region.
    * @param vsiz the size of the value region.
-   * @param wsp the pointer to the variable into which the size of the written record is
-   * assigned.
-   * @return true on success, or false on failure.
+   * @param sp the pointer to the variable into which the size of the image is assigned.
+   * @return the pointer to the image, or NULL on failure.  Because the region of the return
+   * value is allocated with the the new[] operator, it should be released with the delete[]
+   * operator when it is no longer in use.
    */
-  bool write_record(const std::string& rpath, const char* name, const char* kbuf, size_t ksiz,
-                    const char* vbuf, size_t vsiz, size_t* wsp) {
-    _assert_(kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ && wsp);
-    bool err = false;
+  char* make_record(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz, size_t* sp) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ && sp);
     char* rbuf = new char[NUMBUFSIZ*2+ksiz+vsiz];
     char* wp = rbuf;
     *(wp++) = RECMAGIC;
@@ -1852,35 +1999,156 @@ class DirDB : public BasicDB {
     if (comp_) {
       size_t zsiz;
       char* zbuf = comp_->compress(rbuf, rsiz, &zsiz);
+      delete[] rbuf;
       if (!zbuf) {
         set_error(_KCCODELINE_, Error::SYSTEM, "data compression failed");
-        delete[] rbuf;
-        *wsp = 0;
-        return false;
+        *sp = 0;
+        return NULL;
       }
-      delete[] rbuf;
       rbuf = zbuf;
       rsiz = zsiz;
     }
-    if (autotran_ && !tran_) {
-      const std::string& tpath = path_ + File::PATHCHR + KCDDBATRANPREFIX + name;
-      if (!File::write_file(tpath, rbuf, rsiz)) {
-        set_error(_KCCODELINE_, Error::SYSTEM, "writing a file failed");
-        err = true;
+    *sp = rsiz;
+    return rbuf;
+  }
+  /**
+   * Perform a file operation.
+   * @param op the file operation.
+   * @return NULL on success, or the error message on failure.
+   * @note This function does not touch the state of the database object except for the hashed
+   * subdirectories, so it can be called by multiple threads at the same time.
+   */
+  const char* perform_operation(const FileOperation& op) {
+    _assert_(true);
+    if (!op.wpath.empty() && !File::status(op.wpath)) {
+      if (op.exist) {
+        if (!File::rename(op.rpath, op.wpath)) return "renaming a file failed";
+        if (!op.rbuf) return NULL;
+      } else if (!File::write_file(op.wpath, "", 0)) {
+        return "writing a file failed";
       }
-      if (!File::rename(tpath, rpath)) {
-        set_error(_KCCODELINE_, Error::SYSTEM, "renaming a file failed");
-        err = true;
-        File::remove(tpath);
+    }
+    if (!op.rbuf) {
+      if (!File::remove(op.rpath)) return "removing a file failed";
+      return NULL;
+    }
+    if (!op.tpath.empty()) {
+      if (!File::write_file(op.tpath, op.rbuf, op.rsiz)) {
+        File::remove(op.tpath);
+        return "writing a file failed";
+      }
+      if (!File::rename(op.tpath, op.rpath) &&
+          !(make_leaf(op.rpath) && File::rename(op.tpath, op.rpath))) {
+        File::remove(op.tpath);
+        return "renaming a file failed";
+      }
+      return NULL;
+    }
+    if (!File::write_file(op.rpath, op.rbuf, op.rsiz) &&
+        !(make_leaf(op.rpath) && File::write_file(op.rpath, op.rbuf, op.rsiz)))
+      return "writing a file failed";
+    return NULL;
+  }
+  /**
+   * Submit a file operation.
+   * @param op the file operation.  Its record image is released or taken by the batch.
+   * @param name the file name of the record.
+   * @param batch the batch to which the operation is added, or NULL to perform it at once.
+   * @return true on success, or false on failure.
+   */
+  bool submit_operation(FileOperation* op, const char* name, FileBatch* batch) {
+    _assert_(op && name);
+    if (batch) {
+      batch->ops.push_back(*op);
+      batch->names.insert(name);
+      return true;
+    }
+    bool err = false;
+    const char* emsg = perform_operation(*op);
+    delete[] op->rbuf;
+    if (emsg) {
+      set_error(_KCCODELINE_, Error::SYSTEM, emsg);
+      err = true;
+    }
+    if (autosync_ && !File::synchronize_filesystem(path_)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, "synchronizing the file system failed");
+      err = true;
+    }
+    return !err;
+  }
+  /**
+   * Perform all file operations in a batch.
+   * @param batch the batch of file operations, which is cleared.
+   * @return true on success, or false on failure.
+   */
+  bool commit_batch(FileBatch* batch) {
+    _assert_(batch);
+    std::vector<FileOperation>& ops = batch->ops;
+    size_t onum = ops.size();
+    if (onum < 1) return true;
+    class ThreadImpl : public Thread {
+     public:
+      explicit ThreadImpl() : db_(NULL), ops_(NULL), onum_(0), oidx_(NULL), emsg_(NULL) {}
+      void init(DirDB* db, const FileOperation* ops, size_t onum, AtomicInt64* oidx) {
+        db_ = db;
+        ops_ = ops;
+        onum_ = onum;
+        oidx_ = oidx;
+      }
+      const char* emsg() {
+        return emsg_;
+      }
+      void run() {
+        while (true) {
+          int64_t idx = oidx_->add(1);
+          if (idx >= (int64_t)onum_) break;
+          const char* emsg = db_->perform_operation(ops_[idx]);
+          if (emsg) emsg_ = emsg;
+        }
+      }
+     private:
+      DirDB* db_;
+      const FileOperation* ops_;
+      size_t onum_;
+      AtomicInt64* oidx_;
+      const char* emsg_;
+    };
+    size_t thnum = onum / IOBATCHMIN;
+    if (thnum < 1) thnum = 1;
+    if (thnum > IOTHMAX) thnum = IOTHMAX;
+    AtomicInt64 oidx(0);
+    ThreadImpl* threads = new ThreadImpl[thnum];
+    for (size_t i = 0; i < thnum; i++) {
+      threads[i].init(this, &ops[0], onum, &oidx);
+    }
+    if (thnum > 1) {
+      for (size_t i = 0; i < thnum; i++) {
+        threads[i].start();
+      }
+      for (size_t i = 0; i < thnum; i++) {
+        threads[i].join();
       }
     } else {
-      if (!File::write_file(rpath, rbuf, rsiz)) {
-        set_error(_KCCODELINE_, Error::SYSTEM, "writing a file failed");
+      threads[0].run();
+    }
+    bool err = false;
+    for (size_t i = 0; i < thnum; i++) {
+      const char* emsg = threads[i].emsg();
+      if (emsg) {
+        set_error(_KCCODELINE_, Error::SYSTEM, emsg);
         err = true;
       }
     }
-    delete[] rbuf;
-    *wsp = rsiz;
+    delete[] threads;
+    for (size_t i = 0; i < onum; i++) {
+      delete[] ops[i].rbuf;
+    }
+    ops.clear();
+    batch->names.clear();
+    if (autosync_ && !File::synchronize_filesystem(path_)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, "synchronizing the file system failed");
+      err = true;
+    }
     return !err;
   }
   /**
@@ -1931,24 +2199,26 @@ class DirDB : public BasicDB {
    * @param ksiz the size of the key region.
    * @param visitor a visitor object.
    * @param name the encoded key.
+   * @param batch the batch to which file operations are added, or NULL to perform them at once.
    * @return true on success, or false on failure.
    */
-  bool accept_impl(const char* kbuf, size_t ksiz, Visitor* visitor, const char* name) {
+  bool accept_impl(const char* kbuf, size_t ksiz, Visitor* visitor, const char* name,
+                   FileBatch* batch = NULL) {
     _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor && name);
     bool err = false;
-    const std::string& rpath = path_ + File::PATHCHR + name;
+    const std::string& rpath = record_path(path_, name);
     Record rec;
     if (read_record(rpath, &rec)) {
       if (rec.ksiz == ksiz || !std::memcmp(rec.kbuf, kbuf, ksiz)) {
         if (!accept_visit_full(kbuf, ksiz, rec.vbuf, rec.vsiz, rec.rsiz,
-                               visitor, rpath, name)) err = true;
+                               visitor, rpath, name, batch)) err = true;
       } else {
         set_error(_KCCODELINE_, Error::LOGIC, "collision of the hash values");
         err = true;
       }
       delete[] rec.rbuf;
     } else {
-      if (!accept_visit_empty(kbuf, ksiz, visitor, rpath, name)) err = true;
+      if (!accept_visit_empty(kbuf, ksiz, visitor, rpath, name, batch)) err = true;
     }
     return !err;
   }
@@ -1962,53 +2232,38 @@ class DirDB : public BasicDB {
    * @param visitor a visitor object.
    * @param rpath the file path of the record.
    * @param name the file name of the record.
+   * @param batch the batch to which file operations are added, or NULL to perform them at once.
    * @return true on success, or false on failure.
    */
   bool accept_visit_full(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz,
                          size_t osiz, Visitor *visitor, const std::string& rpath,
-                         const char* name) {
+                         const char* name, FileBatch* batch = NULL) {
     _assert_(kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ && visitor);
     bool err = false;
     size_t rsiz;
     const char* rbuf = visitor->visit_full(kbuf, ksiz, vbuf, vsiz, &rsiz);
     if (rbuf == Visitor::REMOVE) {
-      if (tran_) {
-        const std::string& walpath = walpath_ + File::PATHCHR + name;
-        if (File::status(walpath)) {
-          if (!File::remove(rpath)) {
-            set_error(_KCCODELINE_, Error::SYSTEM, "removing a file failed");
-            err = true;
-          }
-        } else if (!File::rename(rpath, walpath)) {
-          set_error(_KCCODELINE_, Error::SYSTEM, "renaming a file failed");
-          err = true;
-        }
-      } else {
-        if (!File::remove(rpath)) {
-          set_error(_KCCODELINE_, Error::SYSTEM, "removing a file failed");
-          err = true;
-        }
-      }
+      FileOperation op;
+      op.rpath = rpath;
+      if (tran_) op.wpath = walpath_ + File::PATHCHR + name;
+      op.exist = true;
+      op.rbuf = NULL;
+      op.rsiz = 0;
+      if (!submit_operation(&op, name, batch)) err = true;
       if (!escape_cursors(rpath, name)) err = true;
       count_ -= 1;
       size_ -= osiz;
-      if (autosync_ && !File::synchronize_whole()) {
-        set_error(_KCCODELINE_, Error::SYSTEM, "synchronizing the file system failed");
-        err = true;
-      }
     } else if (rbuf != Visitor::NOP) {
-      if (tran_) {
-        const std::string& walpath = walpath_ + File::PATHCHR + name;
-        if (!File::status(walpath) && !File::rename(rpath, walpath)) {
-          set_error(_KCCODELINE_, Error::SYSTEM, "renaming a file failed");
-          err = true;
-        }
-      }
-      size_t wsiz;
-      if (!write_record(rpath, name, kbuf, ksiz, rbuf, rsiz, &wsiz)) err = true;
-      size_ += (int64_t)wsiz - (int64_t)osiz;
-      if (autosync_ && !File::synchronize_whole()) {
-        set_error(_KCCODELINE_, Error::SYSTEM, "synchronizing the file system failed");
+      FileOperation op;
+      op.rpath = rpath;
+      if (autotran_ && !tran_) op.tpath = path_ + File::PATHCHR + KCDDBATRANPREFIX + name;
+      if (tran_) op.wpath = walpath_ + File::PATHCHR + name;
+      op.exist = true;
+      op.rbuf = make_record(kbuf, ksiz, rbuf, rsiz, &op.rsiz);
+      if (op.rbuf) {
+        size_ += (int64_t)op.rsiz - (int64_t)osiz;
+        if (!submit_operation(&op, name, batch)) err = true;
+      } else {
         err = true;
       }
     }
@@ -2021,28 +2276,27 @@ class DirDB : public BasicDB {
    * @param visitor a visitor object.
    * @param rpath the file path of the record.
    * @param name the file name of the record.
+   * @param batch the batch to which file operations are added, or NULL to perform them at once.
    * @return true on success, or false on failure.
    */
-  bool accept_visit_empty(const char* kbuf, size_t ksiz,
-                          Visitor *visitor, const std::string& rpath, const char* name) {
+  bool accept_visit_empty(const char* kbuf, size_t ksiz, Visitor *visitor,
+                          const std::string& rpath, const char* name, FileBatch* batch = NULL) {
     _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
     bool err = false;
     size_t rsiz;
     const char* rbuf = visitor->visit_empty(kbuf, ksiz, &rsiz);
     if (rbuf != Visitor::NOP && rbuf != Visitor::REMOVE) {
-      if (tran_) {
-        const std::string& walpath = walpath_ + File::PATHCHR + name;
-        if (!File::status(walpath) && !File::write_file(walpath, "", 0)) {
-          set_error(_KCCODELINE_, Error::SYSTEM, "renaming a file failed");
-          err = true;
-        }
-      }
-      size_t wsiz;
-      if (!write_record(rpath, name, kbuf, ksiz, rbuf, rsiz, &wsiz)) err = true;
-      count_ += 1;
-      size_ += wsiz;
-      if (autosync_ && !File::synchronize_whole()) {
-        set_error(_KCCODELINE_, Error::SYSTEM, "synchronizing the file system failed");
+      FileOperation op;
+      op.rpath = rpath;
+      if (autotran_ && !tran_) op.tpath = path_ + File::PATHCHR + KCDDBATRANPREFIX + name;
+      if (tran_) op.wpath = walpath_ + File::PATHCHR + name;
+      op.exist = false;
+      op.rbuf = make_record(kbuf, ksiz, rbuf, rsiz, &op.rsiz);
+      if (op.rbuf) {
+        count_ += 1;
+        size_ += op.rsiz;
+        if (!submit_operation(&op, name, batch)) err = true;
+      } else {
         err = true;
       }
     }
@@ -2061,8 +2315,8 @@ class DirDB : public BasicDB {
       set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
       return false;
     }
-    DirStream dir;
-    if (!dir.open(path_)) {
+    RecordStream dir;
+    if (!dir.open(path_, fanout_)) {
       set_error(_KCCODELINE_, Error::SYSTEM, "opening a directory failed");
       return false;
     }
@@ -2070,8 +2324,7 @@ class DirDB : public BasicDB {
     std::string name;
     int64_t curcnt = 0;
     while (dir.read(&name)) {
-      if (*name.c_str() == *KCDDBMAGICFILE) continue;
-      const std::string& rpath = path_ + File::PATHCHR + name;
+      const std::string& rpath = record_path(path_, name.c_str());
       Record rec;
       if (read_record(rpath, &rec)) {
         if (!accept_visit_full(rec.kbuf, rec.ksiz, rec.vbuf, rec.vsiz, rec.rsiz,
@@ -2112,8 +2365,8 @@ class DirDB : public BasicDB {
       set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
       return false;
     }
-    DirStream dir;
-    if (!dir.open(path_)) {
+    RecordStream dir;
+    if (!dir.open(path_, fanout_)) {
       set_error(_KCCODELINE_, Error::SYSTEM, "opening a directory failed");
       return false;
     }
@@ -2123,7 +2376,7 @@ class DirDB : public BasicDB {
           db_(NULL), visitor_(NULL), checker_(NULL), allcnt_(0),
           dir_(NULL), itmtx_(NULL), error_() {}
       void init(DirDB* db, Visitor* visitor, ProgressChecker* checker, int64_t allcnt,
-                DirStream* dir, Mutex* itmtx) {
+                RecordStream* dir, Mutex* itmtx) {
         db_ = db;
         visitor_ = visitor;
         checker_ = checker;
@@ -2140,7 +2393,7 @@ class DirDB : public BasicDB {
         Visitor* visitor = visitor_;
         ProgressChecker* checker = checker_;
         int64_t allcnt = allcnt_;
-        DirStream* dir = dir_;
+        RecordStream* dir = dir_;
         Mutex* itmtx = itmtx_;
         const std::string& path = db->path_;
         while (true) {
@@ -2151,8 +2404,7 @@ class DirDB : public BasicDB {
             break;
           }
           itmtx->unlock();
-          if (*name.c_str() == *KCDDBMAGICFILE) continue;
-          const std::string& rpath = path + File::PATHCHR + name;
+          const std::string& rpath = db->record_path(path, name.c_str());
           Record rec;
           if (db->read_record(rpath, &rec)) {
             size_t vsiz;
@@ -2173,7 +2425,7 @@ class DirDB : public BasicDB {
       Visitor* visitor_;
       ProgressChecker* checker_;
       int64_t allcnt_;
-      DirStream* dir_;
+      RecordStream* dir_;
       Mutex* itmtx_;
       Error error_;
     };
@@ -2228,7 +2480,7 @@ class DirDB : public BasicDB {
         set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
         return false;
       }
-      if (hard && !File::synchronize_whole()) {
+      if (hard && !File::synchronize_filesystem(path_)) {
         set_error(_KCCODELINE_, Error::SYSTEM, "synchronizing the file system failed");
         err = true;
       }
@@ -2259,7 +2511,7 @@ class DirDB : public BasicDB {
       set_error(_KCCODELINE_, Error::SYSTEM, "making a directory failed");
       return false;
     }
-    if (trhard_ && !File::synchronize_whole()) {
+    if (trhard_ && !File::synchronize_filesystem(path_)) {
       set_error(_KCCODELINE_, Error::SYSTEM, "synchronizing the file system failed");
       return false;
     }
@@ -2283,7 +2535,7 @@ class DirDB : public BasicDB {
       set_error(_KCCODELINE_, Error::SYSTEM, "removing a directory failed");
       return false;
     }
-    if (trhard_ && !File::synchronize_whole()) {
+    if (trhard_ && !File::synchronize_filesystem(path_)) {
       set_error(_KCCODELINE_, Error::SYSTEM, "synchronizing the file system failed");
       err = true;
     }
@@ -2302,11 +2554,12 @@ class DirDB : public BasicDB {
       std::string name;
       while (dir.read(&name)) {
         const std::string& srcpath = walpath_ + File::PATHCHR + name;
-        const std::string& destpath = path_ + File::PATHCHR + name;
+        const std::string& destpath = record_path(path_, name.c_str());
         File::Status sbuf;
         if (File::status(srcpath, &sbuf)) {
           if (sbuf.size > 1) {
-            if (!File::rename(srcpath, destpath)) {
+            if (!File::rename(srcpath, destpath) &&
+                !(make_leaf(destpath) && File::rename(srcpath, destpath))) {
               set_error(_KCCODELINE_, Error::SYSTEM, "renaming a file failed");
               err = true;
             }
@@ -2340,12 +2593,49 @@ class DirDB : public BasicDB {
     }
     count_ = trcount_;
     size_ = trsize_;
-    if (trhard_ && !File::synchronize_whole()) {
+    if (trhard_ && !File::synchronize_filesystem(path_)) {
       set_error(_KCCODELINE_, Error::SYSTEM, "synchronizing the file system failed");
       err = true;
     }
     return !err;
   }
+  /**
+   * Get the path of a record file.
+   * @param cpath the path of the database directory.
+   * @param name the file name of the record.
+   * @return the path of the record file, which is in the hashed subdirectories if any.
+   */
+  std::string record_path(const std::string& cpath, const char* name) {
+    _assert_(name);
+    if (fanout_ < 1) return cpath + File::PATHCHR + name;
+    uint64_t hash = hashmurmur(name, std::strlen(name));
+    std::string rpath = cpath;
+    for (int32_t i = 0; i < fanout_; i++) {
+      strprintf(&rpath, "%c%02x", File::PATHCHR, (unsigned)(hash & 0xff));
+      hash >>= 8;
+    }
+    rpath.append(1, File::PATHCHR);
+    rpath.append(name);
+    return rpath;
+  }
+  /**
+   * Make the hashed subdirectories containing a record file.
+   * @param rpath the path of the record file.
+   * @return true if the subdirectories are checked, or false in the flat layout.
+   * @note Subdirectories are made lazily when the first record in them is written.  Failure
+   * because another thread has made the same one is ignored.
+   */
+  bool make_leaf(const std::string& rpath) {
+    _assert_(true);
+    if (fanout_ < 1) return false;
+    size_t pos = rpath.rfind(File::PATHCHR);
+    if (pos == std::string::npos) return false;
+    for (int32_t i = fanout_ - 1; i >= 0; i--) {
+      size_t len = pos - i * 3;
+      File::make_directory(rpath.substr(0, len));
+    }
+    return true;
+  }
   /**
    * Get the size of the database file.
    * @return the size of the database file in bytes.
@@ -2402,15 +2692,17 @@ class DirDB : public BasicDB {
   /** The options. */
   uint8_t opts_;
   /** The record number. */
-  AtomicInt64 count_;
+  ShardedInt64 count_;
   /** The total size of records. */
-  AtomicInt64 size_;
+  ShardedInt64 size_;
   /** The opaque data. */
   char opaque_[OPAQUESIZ];
   /** The embedded data compressor. */
   Compressor* embcomp_;
   /** The data compressor. */
   Compressor* comp_;
+  /** The depth of hashed subdirectories. */
+  int8_t fanout_;
   /** The compression checksum. */
   bool tran_;
   /** The flag whether hard transaction. */
@@ -31,9 +31,20 @@ const int64_t FILEMAXSIZ = INT64MAX - INT32MAX;  // maximum size of a file
 const char* const WALPATHEXT = "wal";    ///< extension of the WAL file
 const char WALMAGICDATA[] = "KW\n";      ///< magic data of the WAL file
 const uint8_t WALMSGMAGIC = 0xee;        ///< magic data for WAL record
+const int32_t MAPGROWMIN = 1 << 24;      ///< minimum size of growth of the mapped region
+const int32_t DIRTYSHIFT = 16;           ///< bit shift of the unit of dirty tracking
+const uint8_t DIRTYCLEAN = 0;            ///< state of a chunk without update
+const uint8_t DIRTYFRESH = 1;            ///< state of a chunk updated after writeback
+const uint8_t DIRTYSCHED = 2;            ///< state of a chunk whose writeback has started
+const int64_t COPYUNIT = 1LL << 26;      ///< unit size of copying in the kernel
 }
 
 
+#if defined(_SYS_LINUX_) && !defined(FICLONE)
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+
+
 /**
  * File internal.
  */
@@ -56,6 +67,10 @@ struct FileCore {
   bool trhard;                           ///< whether hard transaction
   int64_t trbase;                        ///< base offset of guarded region
   int64_t trmsiz;                        ///< minimum size during transaction
+  uint8_t* dmap;                         ///< states of the chunks of the mapped region
+  int64_t dnum;                          ///< number of the chunks
+  int32_t dshift;                        ///< bit shift of the size of each chunk
+  int64_t mcap;                          ///< size of the reserved address space
 #else
   Mutex alock;                           ///< attribute lock
   TSDKey errmsg;                         ///< error message
@@ -73,6 +88,12 @@ struct FileCore {
   bool trhard;                           ///< whether hard transaction
   int64_t trbase;                        ///< base offset of guarded region
   int64_t trmsiz;                        ///< minimum size during transaction
+  uint8_t* dmap;                         ///< states of the chunks of the mapped region
+  int64_t dnum;                          ///< number of the chunks
+  int32_t dshift;                        ///< bit shift of the size of each chunk
+  int64_t mcap;                          ///< size of the reserved address space
+  int64_t apcnt;                         ///< number of appenders without locking
+  int32_t apstop;                        ///< flag to stop appending without locking
 #endif
 };
 
@@ -101,6 +122,18 @@ struct DirStreamCore {
 };
 
 
+/**
+ * FileView internal.
+ */
+struct FileViewCore {
+  char* map;                             ///< mapped memory
+  size_t msiz;                           ///< map size
+  char* buf;                             ///< buffer for platforms without mapping
+  const char* data;                      ///< pointer to the region
+  size_t size;                           ///< size of the region
+};
+
+
 /**
  * Set the error message.
  * @param core the inner condition.
@@ -109,6 +142,96 @@ struct DirStreamCore {
 static void seterrmsg(FileCore* core, const char* msg);
 
 
+/**
+ * Extend the mapped region in place to cover a region.
+ * @param core the inner condition.
+ * @param end the end offset of the region to be covered.
+ * @note The caller must hold the lock of the inner condition unless no other thread accesses
+ * the file.
+ */
+static void growmap(FileCore* core, int64_t end);
+
+
+/**
+ * Reserve a region at the end of the file without locking.
+ * @param core the inner condition.
+ * @param size the size of the region.
+ * @return the offset of the reserved region, or -1 if the region is not in the extended part
+ * of the file.
+ * @note If a region is reserved, the caller must call endappend after filling it.
+ */
+static int64_t beginappend(FileCore* core, size_t size);
+
+
+/**
+ * Finish filling a region reserved without locking.
+ * @param core the inner condition.
+ * @param end the end offset of the region.
+ */
+static void endappend(FileCore* core, int64_t end);
+
+
+/**
+ * Stop reservation without locking and wait for the reserved regions to be filled.
+ * @param core the inner condition.
+ * @note The caller must hold the lock of the inner condition.
+ */
+static void stopappend(FileCore* core);
+
+
+/**
+ * Resume reservation without locking.
+ * @param core the inner condition.
+ */
+static void resumeappend(FileCore* core);
+
+
+/**
+ * Extend the logical size of the file to an offset.
+ * @param core the inner condition.
+ * @param end the end offset.
+ * @note The caller must hold the lock of the inner condition.
+ */
+static void raiselsiz(FileCore* core, int64_t end);
+
+
+/**
+ * Prepare the states of the chunks of the mapped region.
+ * @param core the inner condition.
+ */
+static void initdirty(FileCore* core);
+
+
+/**
+ * Mark a region of the mapped memory as updated.
+ * @param core the inner condition.
+ * @param off the offset of the region.
+ * @param end the end offset of the region.
+ */
+static void markdirty(FileCore* core, int64_t off, int64_t end);
+
+
+/**
+ * Change the state of a chunk of the mapped region atomically.
+ * @param dp the pointer to the state.
+ * @param oval the expected current state.
+ * @param nval the new state.
+ * @return true if the state was changed, or false if the current state was different.
+ */
+static bool casdirty(uint8_t* dp, uint8_t oval, uint8_t nval);
+
+
+/**
+ * Write back the updated regions of the mapped memory.
+ * @param core the inner condition.
+ * @param hard true to wait for the regions to reach the device, or false to start writing them
+ * back asynchronously.
+ * @param limit the maximum size of the regions to be written back, or -1 for no limit.
+ * @return true on success, or false on failure.
+ */
+static bool flushdirty(FileCore* core, bool hard, int64_t limit);
+
+
 /**
  * Get the path of the WAL file.
  * @param path the path of the destination file.
@@ -221,6 +344,10 @@ File::File() : opq_(NULL) {
   core->tran = false;
   core->trhard = false;
   core->trmsiz = 0;
+  core->dmap = NULL;
+  core->dnum = 0;
+  core->dshift = DIRTYSHIFT;
+  core->mcap = 0;
   opq_ = core;
 #else
   _assert_(true);
@@ -237,6 +364,12 @@ File::File() : opq_(NULL) {
   core->tran = false;
   core->trhard = false;
   core->trmsiz = 0;
+  core->dmap = NULL;
+  core->dnum = 0;
+  core->dshift = DIRTYSHIFT;
+  core->mcap = 0;
+  core->apcnt = 0;
+  core->apstop = 0;
   opq_ = core;
 #endif
 }
@@ -283,7 +416,7 @@ const char* File::error() const {
 /**
  * Open a file.
  */
-bool File::open(const std::string& path, uint32_t mode, int64_t msiz) {
+bool File::open(const std::string& path, uint32_t mode, int64_t msiz, int64_t mcap) {
 #if defined(_SYS_MSVC_) || defined(_SYS_MINGW_)
   _assert_(msiz >= 0 && msiz <= FILEMAXSIZ);
   FileCore* core = (FileCore*)opq_;
@@ -402,6 +535,7 @@ bool File::open(const std::string& path, uint32_t mode, int64_t msiz) {
   core->recov = recov;
   core->omode = mode;
   core->path.append(path);
+  if (mode & OWRITER) initdirty(core);
   return true;
 #else
   _assert_(msiz >= 0 && msiz <= FILEMAXSIZ);
@@ -492,20 +626,46 @@ bool File::open(const std::string& path, uint32_t mode, int64_t msiz) {
   int64_t psiz = lsiz;
   int64_t diff = msiz % PAGESIZ;
   if (diff > 0) msiz += PAGESIZ - diff;
+  diff = mcap % PAGESIZ;
+  if (diff > 0) mcap += PAGESIZ - diff;
+  if (mcap > FILEMAXSIZ) mcap = FILEMAXSIZ;
+  void* map = NULL;
+  if (mcap > msiz) {
+    int32_t rflags = MAP_PRIVATE | MAP_ANONYMOUS;
+#if defined(MAP_NORESERVE)
+    rflags |= MAP_NORESERVE;
+#endif
+    map = ::mmap(0, mcap, PROT_NONE, rflags, -1, 0);
+    if (map == MAP_FAILED) {
+      map = NULL;
+      mcap = 0;
+    } else {
+      int64_t asiz = lsiz;
+      diff = asiz % PAGESIZ;
+      if (diff > 0) asiz += PAGESIZ - diff;
+      if (asiz > mcap) asiz = mcap;
+      if (asiz > msiz || !(mode & OWRITER)) msiz = asiz;
+    }
+  } else {
+    mcap = 0;
+  }
   int32_t mprot = PROT_READ;
   if (mode & OWRITER) {
     mprot |= PROT_WRITE;
-  } else if (msiz > lsiz) {
+  } else if (msiz > lsiz && !map) {
     msiz = lsiz;
   }
-  void* map = NULL;
   if (msiz > 0) {
-    map = ::mmap(0, msiz, mprot, MAP_SHARED, fd, 0);
-    if (map == MAP_FAILED) {
+    int32_t mflags = MAP_SHARED;
+    if (map) mflags |= MAP_FIXED;
+    void* fmap = ::mmap(map, msiz, mprot, mflags, fd, 0);
+    if (fmap == MAP_FAILED) {
       seterrmsg(core, "mmap failed");
+      if (map) ::munmap(map, mcap);
       ::close(fd);
       return false;
     }
+    map = fmap;
   }
   core->fd = fd;
   core->map = (char*)map;
@@ -515,6 +675,8 @@ bool File::open(const std::string& path, uint32_t mode, int64_t msiz) {
   core->recov = recov;
   core->omode = mode;
   core->path.append(path);
+  core->mcap = mcap;
+  if (mode & OWRITER) initdirty(core);
   return true;
 #endif
 }
@@ -584,6 +746,9 @@ bool File::close() {
   core->tran = false;
   core->trhard = false;
   core->trmsiz = 0;
+  delete[] core->dmap;
+  core->dmap = NULL;
+  core->dnum = 0;
   return !err;
 #else
   _assert_(true);
@@ -603,7 +768,8 @@ bool File::close() {
       err = true;
     }
   }
-  if (core->msiz > 0 && ::munmap(core->map, core->msiz) != 0) {
+  int64_t usiz = core->mcap > core->msiz ? core->mcap : core->msiz;
+  if (usiz > 0 && ::munmap(core->map, usiz) != 0) {
     seterrmsg(core, "munmap failed");
     err = true;
   }
@@ -642,6 +808,10 @@ bool File::close() {
   core->tran = false;
   core->trhard = false;
   core->trmsiz = 0;
+  delete[] core->dmap;
+  core->dmap = NULL;
+  core->dnum = 0;
+  core->mcap = 0;
   return !err;
 #endif
 }
@@ -671,9 +841,10 @@ bool File::write(int64_t off, const void* buf, size_t size) {
       }
       core->psiz = psiz;
     }
-    if (end > core->lsiz) core->lsiz = end;
+    if (end > core->lsiz) raiselsiz(core, end);
     core->alock.unlock();
     std::memcpy(core->map + off, buf, size);
+    markdirty(core, off, end);
     return true;
   }
   if (off < core->msiz) {
@@ -687,6 +858,7 @@ bool File::write(int64_t off, const void* buf, size_t size) {
     }
     size_t hsiz = core->msiz - off;
     std::memcpy(core->map + off, buf, hsiz);
+    markdirty(core, off, core->msiz);
     off += hsiz;
     buf = (char*)buf + hsiz;
     size -= hsiz;
@@ -713,6 +885,7 @@ bool File::write(int64_t off, const void* buf, size_t size) {
   if (core->tran && !walwrite(core, off, size, core->trbase)) return false;
   int64_t end = off + size;
   core->alock.lock();
+  if (end > core->msiz) growmap(core, end);
   if (end <= core->msiz) {
     if (end > core->psiz) {
       int64_t psiz = end + core->psiz / 2;
@@ -726,9 +899,10 @@ bool File::write(int64_t off, const void* buf, size_t size) {
       }
       core->psiz = psiz;
     }
-    if (end > core->lsiz) core->lsiz = end;
+    if (end > core->lsiz) raiselsiz(core, end);
     core->alock.unlock();
     std::memcpy(core->map + off, buf, size);
+    markdirty(core, off, end);
     return true;
   }
   if (off < core->msiz) {
@@ -742,11 +916,12 @@ bool File::write(int64_t off, const void* buf, size_t size) {
     }
     size_t hsiz = core->msiz - off;
     std::memcpy(core->map + off, buf, hsiz);
+    markdirty(core, off, core->msiz);
     off += hsiz;
     buf = (char*)buf + hsiz;
     size -= hsiz;
   }
-  if (end > core->lsiz) core->lsiz = end;
+  if (end > core->lsiz) raiselsiz(core, end);
   if (end > core->psiz) {
     if (core->psiz < core->msiz && ::ftruncate(core->fd, core->msiz) != 0) {
       seterrmsg(core, "ftruncate failed");
@@ -776,11 +951,13 @@ bool File::write_fast(int64_t off, const void* buf, size_t size) {
   int64_t end = off + size;
   if (end <= core->msiz) {
     std::memcpy(core->map + off, buf, size);
+    markdirty(core, off, end);
     return true;
   }
   if (off < core->msiz) {
     size_t hsiz = core->msiz - off;
     std::memcpy(core->map + off, buf, hsiz);
+    markdirty(core, off, core->msiz);
     off += hsiz;
     buf = (char*)buf + hsiz;
     size -= hsiz;
@@ -795,13 +972,22 @@ bool File::write_fast(int64_t off, const void* buf, size_t size) {
   FileCore* core = (FileCore*)opq_;
   if (core->tran && !walwrite(core, off, size, core->trbase)) return false;
   int64_t end = off + size;
-  if (end <= core->msiz) {
+  if (end > core->msiz && core->mcap > core->msiz) {
+    core->alock.lock();
+    growmap(core, end);
+    core->alock.unlock();
+  }
+  int64_t msiz = core->msiz;
+  if (msiz > core->psiz) msiz = core->psiz;
+  if (end <= msiz) {
     std::memcpy(core->map + off, buf, size);
+    markdirty(core, off, end);
     return true;
   }
-  if (off < core->msiz) {
-    size_t hsiz = core->msiz - off;
+  if (off < msiz) {
+    size_t hsiz = msiz - off;
     std::memcpy(core->map + off, buf, hsiz);
+    markdirty(core, off, msiz);
     off += hsiz;
     buf = (char*)buf + hsiz;
     size -= hsiz;
@@ -842,6 +1028,7 @@ bool File::append(const void* buf, size_t size) {
     core->lsiz = end;
     core->alock.unlock();
     std::memcpy(core->map + off, buf, size);
+    markdirty(core, off, end);
     return true;
   }
   if (off < core->msiz) {
@@ -855,6 +1042,7 @@ bool File::append(const void* buf, size_t size) {
     }
     size_t hsiz = core->msiz - off;
     std::memcpy(core->map + off, buf, hsiz);
+    markdirty(core, off, core->msiz);
     off += hsiz;
     buf = (char*)buf + hsiz;
     size -= hsiz;
@@ -883,9 +1071,18 @@ bool File::append(const void* buf, size_t size) {
   _assert_(buf && size <= MEMMAXSIZ);
   if (size < 1) return true;
   FileCore* core = (FileCore*)opq_;
+  int64_t off = beginappend(core, size);
+  if (off >= 0) {
+    std::memcpy(core->map + off, buf, size);
+    markdirty(core, off, off + size);
+    endappend(core, off + size);
+    return true;
+  }
   core->alock.lock();
-  int64_t off = core->lsiz;
+  stopappend(core);
+  off = core->lsiz;
   int64_t end = off + size;
+  if (end > core->msiz) growmap(core, end);
   if (end <= core->msiz) {
     if (end > core->psiz) {
       int64_t psiz = end + core->psiz / 2;
@@ -894,20 +1091,24 @@ bool File::append(const void* buf, size_t size) {
       if (psiz > core->msiz) psiz = core->msiz;
       if (::ftruncate(core->fd, psiz) != 0) {
         seterrmsg(core, "ftruncate failed");
+        resumeappend(core);
         core->alock.unlock();
         return false;
       }
       core->psiz = psiz;
     }
     core->lsiz = end;
+    resumeappend(core);
     core->alock.unlock();
     std::memcpy(core->map + off, buf, size);
+    markdirty(core, off, end);
     return true;
   }
   if (off < core->msiz) {
     if (end > core->psiz) {
       if (::ftruncate(core->fd, end) != 0) {
         seterrmsg(core, "ftruncate failed");
+        resumeappend(core);
         core->alock.unlock();
         return false;
       }
@@ -915,12 +1116,14 @@ bool File::append(const void* buf, size_t size) {
     }
     size_t hsiz = core->msiz - off;
     std::memcpy(core->map + off, buf, hsiz);
+    markdirty(core, off, core->msiz);
     off += hsiz;
     buf = (char*)buf + hsiz;
     size -= hsiz;
   }
   core->lsiz = end;
   core->psiz = end;
+  resumeappend(core);
   core->alock.unlock();
   while (true) {
     ssize_t wb = ::pwrite(core->fd, buf, size, off);
@@ -999,6 +1202,7 @@ bool File::read(int64_t off, void* buf, size_t size) {
     core->alock.unlock();
     return false;
   }
+  if (end > core->msiz) growmap(core, end);
   core->alock.unlock();
   if (end <= core->msiz) {
     std::memcpy(buf, core->map + off, size);
@@ -1077,12 +1281,19 @@ bool File::read_fast(int64_t off, void* buf, size_t size) {
   _assert_(off >= 0 && off <= FILEMAXSIZ && buf && size <= MEMMAXSIZ);
   FileCore* core = (FileCore*)opq_;
   int64_t end = off + size;
-  if (end <= core->msiz) {
+  if (end > core->msiz && core->mcap > core->msiz) {
+    core->alock.lock();
+    growmap(core, end);
+    core->alock.unlock();
+  }
+  int64_t msiz = core->msiz;
+  if (msiz > core->psiz) msiz = core->psiz;
+  if (end <= msiz) {
     std::memcpy(buf, core->map + off, size);
     return true;
   }
-  if (off < core->msiz) {
-    int64_t hsiz = core->msiz - off;
+  if (off < msiz) {
+    int64_t hsiz = msiz - off;
     std::memcpy(buf, core->map + off, hsiz);
     off += hsiz;
     buf = (char*)buf + hsiz;
@@ -1181,12 +1392,14 @@ bool File::truncate(int64_t size) {
   }
   bool err = false;
   core->alock.lock();
+  stopappend(core);
   if (::ftruncate(core->fd, size) != 0) {
     seterrmsg(core, "ftruncate failed");
     err = true;
   }
   core->lsiz = size;
   core->psiz = size;
+  resumeappend(core);
   core->alock.unlock();
   return !err;
 #endif
@@ -1202,14 +1415,7 @@ bool File::synchronize(bool hard) {
   FileCore* core = (FileCore*)opq_;
   bool err = false;
   core->alock.lock();
-  if (hard && core->msiz > 0) {
-    int64_t msiz = core->msiz;
-    if (msiz > core->psiz) msiz = core->psiz;
-    if (msiz > 0 && !::FlushViewOfFile(core->map, msiz)) {
-      seterrmsg(core, "FlushViewOfFile failed");
-      err = true;
-    }
-  }
+  if (hard && !flushdirty(core, true, -1)) err = true;
   if (win_ftruncate(core->fh, core->lsiz) != 0) {
     seterrmsg(core, "win_ftruncate failed");
     err = true;
@@ -1226,19 +1432,14 @@ bool File::synchronize(bool hard) {
   FileCore* core = (FileCore*)opq_;
   bool err = false;
   core->alock.lock();
-  if (hard && core->msiz > 0) {
-    int64_t msiz = core->msiz;
-    if (msiz > core->psiz) msiz = core->psiz;
-    if (msiz > 0 && ::msync(core->map, msiz, MS_SYNC) != 0) {
-      seterrmsg(core, "msync failed");
-      err = true;
-    }
-  }
+  if (hard && !flushdirty(core, true, -1)) err = true;
+  stopappend(core);
   if (::ftruncate(core->fd, core->lsiz) != 0) {
     seterrmsg(core, "ftruncate failed");
     err = true;
   }
   if (core->psiz > core->lsiz) core->psiz = core->lsiz;
+  resumeappend(core);
   if (hard && ::fsync(core->fd) != 0) {
     seterrmsg(core, "fsync failed");
     err = true;
@@ -1249,6 +1450,19 @@ bool File::synchronize(bool hard) {
 }
 
 
+/**
+ * Start writing back the updated regions of the mapped memory asynchronously.
+ */
+bool File::write_back(int64_t limit) {
+  _assert_(true);
+  FileCore* core = (FileCore*)opq_;
+  core->alock.lock();
+  bool err = !flushdirty(core, false, limit);
+  core->alock.unlock();
+  return !err;
+}
+
+
 /**
  * Refresh the internal state for update by others.
  */
@@ -1272,8 +1486,13 @@ bool File::refresh() {
     seterrmsg(core, "fstat failed");
     return false;
   }
+  core->alock.lock();
+  stopappend(core);
   core->lsiz = sbuf.st_size;
   core->psiz = sbuf.st_size;
+  growmap(core, core->lsiz);
+  resumeappend(core);
+  core->alock.unlock();
   bool err = false;
   int64_t msiz = core->msiz;
   if (msiz > core->psiz) msiz = core->psiz;
@@ -1402,12 +1621,7 @@ bool File::end_transaction(bool commit) {
     }
   }
   if (core->trhard) {
-    int64_t msiz = core->msiz;
-    if (msiz > core->psiz) msiz = core->psiz;
-    if (msiz > 0 && !::FlushViewOfFile(core->map, msiz)) {
-      seterrmsg(core, "FlushViewOfFile failed");
-      err = true;
-    }
+    if (!flushdirty(core, true, -1)) err = true;
     if (!::FlushFileBuffers(core->fh)) {
       seterrmsg(core, "FlushFileBuffers failed");
       err = true;
@@ -1425,7 +1639,11 @@ bool File::end_transaction(bool commit) {
   FileCore* core = (FileCore*)opq_;
   bool err = false;
   core->alock.lock();
-  if (!commit && !walapply(core)) err = true;
+  if (!commit) {
+    stopappend(core);
+    if (!walapply(core)) err = true;
+    resumeappend(core);
+  }
   if (!err) {
     if (core->walsiz <= IOBUFSIZ) {
       char mbuf[IOBUFSIZ];
@@ -1442,12 +1660,7 @@ bool File::end_transaction(bool commit) {
     }
   }
   if (core->trhard) {
-    int64_t msiz = core->msiz;
-    if (msiz > core->psiz) msiz = core->psiz;
-    if (msiz > 0 && ::msync(core->map, msiz, MS_SYNC) != 0) {
-      seterrmsg(core, "msync failed");
-      err = true;
-    }
+    if (!flushdirty(core, true, -1)) err = true;
     if (::fsync(core->fd) != 0) {
       seterrmsg(core, "fsync failed");
       err = true;
@@ -1504,6 +1717,21 @@ bool File::recovered() const {
 }
 
 
+/**
+ * Get the size of the regions of the mapped memory updated and not written back yet.
+ */
+int64_t File::dirty_size() const {
+  _assert_(true);
+  FileCore* core = (FileCore*)opq_;
+  if (!core->dmap) return 0;
+  int64_t cnt = 0;
+  for (int64_t i = 0; i < core->dnum; i++) {
+    if (((volatile uint8_t*)core->dmap)[i] == DIRTYFRESH) cnt++;
+  }
+  return cnt << core->dshift;
+}
+
+
 /**
  * Read the whole data from a file.
  */
@@ -1631,6 +1859,100 @@ bool File::write_file(const std::string& path, const char* buf, int64_t size) {
 }
 
 
+/**
+ * Copy the whole content of a file into another file.
+ */
+bool File::copy_file(const std::string& spath, const std::string& dpath, CopyChecker* checker) {
+#if defined(_SYS_MSVC_) || defined(_SYS_MINGW_)
+  _assert_(true);
+  if (::CopyFile(spath.c_str(), dpath.c_str(), FALSE) == 0) return false;
+  if (checker) {
+    Status sbuf;
+    if (!status(dpath, &sbuf)) return false;
+    if (!checker->check(sbuf.size, sbuf.size)) return false;
+  }
+  return true;
+#else
+  _assert_(true);
+  int32_t sfd = ::open(spath.c_str(), O_RDONLY, FILEPERM);
+  if (sfd < 0) return false;
+  struct ::stat sbuf;
+  if (::fstat(sfd, &sbuf) != 0 || !S_ISREG(sbuf.st_mode)) {
+    ::close(sfd);
+    return false;
+  }
+  int32_t dfd = ::open(dpath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, FILEPERM);
+  if (dfd < 0) {
+    ::close(sfd);
+    return false;
+  }
+  int64_t allsiz = sbuf.st_size;
+  int64_t cursiz = 0;
+  bool err = false;
+  bool done = false;
+#if defined(_SYS_LINUX_)
+  if (::ioctl(dfd, FICLONE, sfd) == 0) {
+    cursiz = allsiz;
+    if (checker && !checker->check(cursiz, allsiz)) err = true;
+    done = true;
+  }
+#endif
+#if defined(_SYS_LINUX_) && defined(__NR_copy_file_range)
+  while (!done) {
+    ssize_t cb = ::syscall(__NR_copy_file_range, sfd, NULL, dfd, NULL, (size_t)COPYUNIT, 0);
+    if (cb > 0) {
+      cursiz += cb;
+      if (checker && !checker->check(cursiz, allsiz)) {
+        err = true;
+        done = true;
+      }
+      continue;
+    }
+    if (cb == 0) {
+      done = true;
+    } else if (errno != EINTR) {
+      break;
+    }
+  }
+#endif
+  if (!done) {
+    char buf[IOBUFSIZ];
+    int64_t chksiz = cursiz;
+    while (!err) {
+      ssize_t rb = ::read(sfd, buf, sizeof(buf));
+      if (rb == 0) break;
+      if (rb < 0) {
+        if (errno != EINTR) err = true;
+        continue;
+      }
+      cursiz += rb;
+      const char* rp = buf;
+      while (rb > 0) {
+        ssize_t wb = ::write(dfd, rp, rb);
+        if (wb < 0) {
+          if (errno != EINTR) {
+            err = true;
+            break;
+          }
+          continue;
+        }
+        rp += wb;
+        rb -= wb;
+      }
+      if (!err && checker && cursiz - chksiz >= COPYUNIT) {
+        if (!checker->check(cursiz, allsiz)) err = true;
+        chksiz = cursiz;
+      }
+    }
+    if (!err && checker && cursiz > chksiz && !checker->check(cursiz, allsiz)) err = true;
+  }
+  if (::close(dfd) != 0) err = true;
+  if (::close(sfd) != 0) err = true;
+  return !err;
+#endif
+}
+
+
 /**
  * Get the status information of a file.
  */
@@ -1948,6 +2270,29 @@ bool File::synchronize_whole() {
 }
 
 
+/**
+ * Synchronize the file system containing a file with the device.
+ */
+bool File::synchronize_filesystem(const std::string& path) {
+#if defined(_SYS_MSVC_) || defined(_SYS_MINGW_)
+  _assert_(true);
+  return true;
+#elif defined(_SYS_LINUX_) && defined(SYS_syncfs)
+  _assert_(true);
+  int32_t fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  bool err = false;
+  if (::syscall(SYS_syncfs, fd) != 0) err = true;
+  if (::close(fd) != 0) err = true;
+  return !err;
+#else
+  _assert_(true);
+  ::sync();
+  return true;
+#endif
+}
+
+
 
 /**
  * Default constructor.
@@ -2089,6 +2434,130 @@ bool DirStream::read(std::string* path) {
 }
 
 
+/**
+ * Default constructor.
+ */
+FileView::FileView() : opq_(NULL) {
+  _assert_(true);
+  FileViewCore* core = new FileViewCore;
+  core->map = NULL;
+  core->msiz = 0;
+  core->buf = NULL;
+  core->data = NULL;
+  core->size = 0;
+  opq_ = core;
+}
+
+
+/**
+ * Destructor.
+ */
+FileView::~FileView() {
+  _assert_(true);
+  FileViewCore* core = (FileViewCore*)opq_;
+  if (core->data) close();
+  delete core;
+}
+
+
+/**
+ * Open a view.
+ */
+bool FileView::open(File* file, int64_t off, size_t size) {
+#if defined(_SYS_MSVC_) || defined(_SYS_MINGW_)
+  _assert_(file && off >= 0 && off <= FILEMAXSIZ && size <= MEMMAXSIZ);
+  FileViewCore* core = (FileViewCore*)opq_;
+  if (core->data) return false;
+  char* buf = new char[size+1];
+  if (!file->read_fast(off, buf, size)) {
+    delete[] buf;
+    return false;
+  }
+  core->buf = buf;
+  core->data = buf;
+  core->size = size;
+  return true;
+#else
+  _assert_(file && off >= 0 && off <= FILEMAXSIZ && size <= MEMMAXSIZ);
+  FileViewCore* core = (FileViewCore*)opq_;
+  if (core->data) return false;
+  FileCore* fcore = (FileCore*)file->opq_;
+  if (size > 0 && fcore->fd >= 0) {
+    int64_t diff = off % PAGESIZ;
+    size_t msiz = size + diff;
+    void* map = ::mmap(0, msiz, PROT_READ, MAP_SHARED, fcore->fd, off - diff);
+    if (map != MAP_FAILED) {
+      ::madvise(map, msiz, MADV_SEQUENTIAL);
+      core->map = (char*)map;
+      core->msiz = msiz;
+      core->data = core->map + diff;
+      core->size = size;
+      return true;
+    }
+  }
+  char* buf = new char[size+1];
+  if (!file->read_fast(off, buf, size)) {
+    delete[] buf;
+    return false;
+  }
+  core->buf = buf;
+  core->data = buf;
+  core->size = size;
+  return true;
+#endif
+}
+
+
+/**
+ * Close the view.
+ */
+bool FileView::close() {
+#if defined(_SYS_MSVC_) || defined(_SYS_MINGW_)
+  _assert_(true);
+  FileViewCore* core = (FileViewCore*)opq_;
+  if (!core->data) return false;
+  delete[] core->buf;
+  core->buf = NULL;
+  core->data = NULL;
+  core->size = 0;
+  return true;
+#else
+  _assert_(true);
+  FileViewCore* core = (FileViewCore*)opq_;
+  if (!core->data) return false;
+  bool err = false;
+  if (core->map && ::munmap(core->map, core->msiz) != 0) err = true;
+  delete[] core->buf;
+  core->map = NULL;
+  core->msiz = 0;
+  core->buf = NULL;
+  core->data = NULL;
+  core->size = 0;
+  return !err;
+#endif
+}
+
+
+/**
+ * Get the pointer to the region.
+ */
+const char* FileView::data() {
+  _assert_(true);
+  FileViewCore* core = (FileViewCore*)opq_;
+  return core->data;
+}
+
+
+/**
+ * Get the size of the region.
+ */
+size_t FileView::size() {
+  _assert_(true);
+  FileViewCore* core = (FileViewCore*)opq_;
+  return core->size;
+}
+
+
 /**
  * Set the error message.
  */
@@ -2098,6 +2567,242 @@ static void seterrmsg(FileCore* core, const char* msg) {
 }
 
 
+/**
+ * Extend the mapped region in place to cover a region.
+ */
+static void growmap(FileCore* core, int64_t end) {
+#if defined(_SYS_MSVC_) || defined(_SYS_MINGW_)
+  _assert_(core && end >= 0);
+#else
+  _assert_(core && end >= 0);
+  if (end <= core->msiz || core->msiz >= core->mcap) return;
+  int64_t msiz = core->msiz + core->msiz / 2;
+  if (msiz < core->msiz + MAPGROWMIN) msiz = core->msiz + MAPGROWMIN;
+  if (msiz < end) msiz = end;
+  int64_t diff = msiz % PAGESIZ;
+  if (diff > 0) msiz += PAGESIZ - diff;
+  if (msiz > core->mcap) msiz = core->mcap;
+  int32_t mprot = PROT_READ;
+  if (core->omode & File::OWRITER) mprot |= PROT_WRITE;
+  void* map = ::mmap(core->map + core->msiz, msiz - core->msiz, mprot, MAP_SHARED | MAP_FIXED,
+                     core->fd, core->msiz);
+  if (map == MAP_FAILED) return;
+  core->msiz = msiz;
+#endif
+}
+
+
+/**
+ * Reserve a region at the end of the file without locking.
+ */
+static int64_t beginappend(FileCore* core, size_t size) {
+#if defined(_SYS_MSVC_) || defined(_SYS_MINGW_) || !_KC_GCCATOMIC
+  _assert_(core);
+  return -1;
+#else
+  _assert_(core);
+  if (sizeof(void*) < sizeof(int64_t)) return -1;
+  __sync_fetch_and_add(&core->apcnt, 1);
+  if (!core->apstop) {
+    while (true) {
+      int64_t off = core->lsiz;
+      int64_t end = off + size;
+      if (end > core->psiz || end > core->msiz) break;
+      if (__sync_bool_compare_and_swap(&core->lsiz, off, end)) return off;
+    }
+  }
+  __sync_fetch_and_sub(&core->apcnt, 1);
+  return -1;
+#endif
+}
+
+
+/**
+ * Finish filling a region reserved without locking.
+ */
+static void endappend(FileCore* core, int64_t end) {
+#if defined(_SYS_MSVC_) || defined(_SYS_MINGW_) || !_KC_GCCATOMIC
+  _assert_(core && end >= 0);
+#else
+  _assert_(core && end >= 0);
+  __sync_fetch_and_sub(&core->apcnt, 1);
+  int64_t psiz = core->psiz;
+  if (psiz - end >= psiz / 4 || psiz >= core->msiz || !core->alock.lock_try()) return;
+  psiz = core->lsiz + core->psiz / 2;
+  int64_t diff = psiz % PAGESIZ;
+  if (diff > 0) psiz += PAGESIZ - diff;
+  if (psiz > core->msiz) psiz = core->msiz;
+  if (psiz > core->psiz && ::ftruncate(core->fd, psiz) == 0) core->psiz = psiz;
+  core->alock.unlock();
+#endif
+}
+
+
+/**
+ * Stop reservation without locking and wait for the reserved regions to be filled.
+ */
+static void stopappend(FileCore* core) {
+#if defined(_SYS_MSVC_) || defined(_SYS_MINGW_) || !_KC_GCCATOMIC
+  _assert_(core);
+#else
+  _assert_(core);
+  __sync_fetch_and_add(&core->apstop, 1);
+  while (__sync_fetch_and_add(&core->apcnt, 0) > 0) {
+    Thread::yield();
+  }
+#endif
+}
+
+
+/**
+ * Resume reservation without locking.
+ */
+static void resumeappend(FileCore* core) {
+#if defined(_SYS_MSVC_) || defined(_SYS_MINGW_) || !_KC_GCCATOMIC
+  _assert_(core);
+#else
+  _assert_(core);
+  __sync_fetch_and_sub(&core->apstop, 1);
+#endif
+}
+
+
+/**
+ * Extend the logical size of the file to an offset.
+ */
+static void raiselsiz(FileCore* core, int64_t end) {
+#if defined(_SYS_MSVC_) || defined(_SYS_MINGW_) || !_KC_GCCATOMIC
+  _assert_(core && end >= 0);
+  if (end > core->lsiz) core->lsiz = end;
+#else
+  _assert_(core && end >= 0);
+  while (true) {
+    int64_t lsiz = core->lsiz;
+    if (end <= lsiz || __sync_bool_compare_and_swap(&core->lsiz, lsiz, end)) break;
+  }
+#endif
+}
+
+
+/**
+ * Prepare the states of the chunks of the mapped region.
+ */
+static void initdirty(FileCore* core) {
+  _assert_(core);
+  int64_t rsiz = core->mcap > core->msiz ? core->mcap : core->msiz;
+  if (rsiz < 1) return;
+  int32_t dshift = DIRTYSHIFT;
+  while ((1LL << dshift) < PAGESIZ) {
+    dshift++;
+  }
+  core->dshift = dshift;
+  core->dnum = ((rsiz - 1) >> dshift) + 1;
+  core->dmap = new uint8_t[core->dnum];
+  std::memset(core->dmap, DIRTYCLEAN, core->dnum);
+}
+
+
+/**
+ * Mark a region of the mapped memory as updated.
+ */
+static void markdirty(FileCore* core, int64_t off, int64_t end) {
+  _assert_(core && off >= 0 && end >= 0);
+  if (!core->dmap) return;
+  if (end > core->msiz) end = core->msiz;
+  if (off >= end) return;
+  volatile uint8_t* dp = core->dmap + (off >> core->dshift);
+  volatile uint8_t* ep = core->dmap + ((end - 1) >> core->dshift);
+#if !defined(_SYS_MSVC_) && !defined(_SYS_MINGW_) && _KC_GCCATOMIC
+  __sync_synchronize();
+#endif
+  while (dp <= ep) {
+    if (*dp != DIRTYFRESH) *dp = DIRTYFRESH;
+    dp++;
+  }
+}
+
+
+/**
+ * Change the state of a chunk of the mapped region atomically.
+ */
+static bool casdirty(uint8_t* dp, uint8_t oval, uint8_t nval) {
+#if defined(_SYS_MSVC_) || defined(_SYS_MINGW_) || !_KC_GCCATOMIC
+  _assert_(dp);
+  if (*(volatile uint8_t*)dp != oval) return false;
+  *(volatile uint8_t*)dp = nval;
+  return true;
+#else
+  _assert_(dp);
+  return __sync_bool_compare_and_swap(dp, oval, nval);
+#endif
+}
+
+
+/**
+ * Write back the updated regions of the mapped memory.
+ */
+static bool flushdirty(FileCore* core, bool hard, int64_t limit) {
+  _assert_(core);
+  int64_t msiz = core->msiz;
+  if (msiz > core->psiz) msiz = core->psiz;
+  if (!core->dmap || msiz < 1) return true;
+  uint8_t* dmap = core->dmap;
+  int64_t num = ((msiz - 1) >> core->dshift) + 1;
+  if (num > core->dnum) num = core->dnum;
+  bool err = false;
+  int64_t done = 0;
+  int64_t cur = 0;
+  while (cur < num && (limit < 0 || done < limit)) {
+    int64_t beg = cur;
+    while (cur < num) {
+      uint8_t st = ((volatile uint8_t*)dmap)[cur];
+      if (hard ? st == DIRTYCLEAN : st != DIRTYFRESH) break;
+      if (!casdirty(dmap + cur, st, hard ? DIRTYCLEAN : DIRTYSCHED)) continue;
+      cur++;
+    }
+    if (cur == beg) {
+      cur++;
+      continue;
+    }
+    int64_t off = beg << core->dshift;
+    int64_t end = cur << core->dshift;
+    if (end > msiz) end = msiz;
+    size_t size = end - off;
+#if defined(_SYS_MSVC_) || defined(_SYS_MINGW_)
+    if (!::FlushViewOfFile(core->map + off, size)) {
+      seterrmsg(core, "FlushViewOfFile failed");
+      markdirty(core, off, end);
+      err = true;
+    }
+#else
+    if (hard) {
+      if (::msync(core->map + off, size, MS_SYNC) != 0) {
+        seterrmsg(core, "msync failed");
+        markdirty(core, off, end);
+        err = true;
+      }
+    } else {
+#if defined(_SYS_LINUX_) && defined(SYNC_FILE_RANGE_WRITE)
+      if (::sync_file_range(core->fd, off, size, SYNC_FILE_RANGE_WRITE) != 0) {
+        seterrmsg(core, "sync_file_range failed");
+        markdirty(core, off, end);
+        err = true;
+      }
+#else
+      if (::msync(core->map + off, size, MS_ASYNC) != 0) {
+        seterrmsg(core, "msync failed");
+        markdirty(core, off, end);
+        err = true;
+      }
+#endif
+    }
+#endif
+    done += size;
+  }
+  return !err;
+}
+
+
 /**
  * Get the path of the WAL file.
  */
@@ -2362,10 +3067,12 @@ static bool walapply(FileCore* core) {
     int64_t end = off + size;
     if (end <= core->msiz) {
       std::memcpy(core->map + off, rbuf, size);
+      markdirty(core, off, end);
     } else {
       if (off < core->msiz) {
         size_t hsiz = core->msiz - off;
         std::memcpy(core->map + off, rbuf, hsiz);
+        markdirty(core, off, core->msiz);
         off += hsiz;
         rbuf += hsiz;
         size -= hsiz;
@@ -2500,10 +3207,12 @@ static bool walapply(FileCore* core) {
     int64_t end = off + size;
     if (end <= core->msiz) {
       std::memcpy(core->map + off, rbuf, size);
+      markdirty(core, off, end);
     } else {
       if (off < core->msiz) {
         size_t hsiz = core->msiz - off;
         std::memcpy(core->map + off, rbuf, hsiz);
+        markdirty(core, off, core->msiz);
         off += hsiz;
         rbuf += hsiz;
         size -= hsiz;
@@ -27,8 +27,10 @@ namespace kyotocabinet {                 // common namespace
  * Filesystem abstraction.
  */
 class File {
+  friend class FileView;
  public:
   struct Status;
+  class CopyChecker;
  public:
   /** Path delimiter character. */
   static const char PATHCHR;
@@ -50,6 +52,23 @@ class File {
     int64_t size;                        ///< file size
     int64_t mtime;                       ///< last modified time
   };
+  /**
+   * Interface to check the progress of copying a file.
+   */
+  class CopyChecker {
+   public:
+    /**
+     * Destructor.
+     */
+    virtual ~CopyChecker() {}
+    /**
+     * Check the progress.
+     * @param cursiz the size of the data copied so far.
+     * @param allsiz the size of the whole data.
+     * @return true to continue the copy, or false to stop it.
+     */
+    virtual bool check(int64_t cursiz, int64_t allsiz) = 0;
+  };
   /**
    * Open modes.
    */
@@ -85,9 +104,15 @@ class File {
    * mode and the writer mode by bitwise-or: File::ONOLOCK, which means it opens the file
    * without file locking, File::TRYLOCK, which means locking is performed without blocking.
    * @param msiz the size of the internal memory-mapped region.
+   * @param mcap the maximum size to which the memory-mapped region grows as the file grows.  If
+   * it is not more than the size of the region, the region does not grow.
    * @return true on success, or false on failure.
+   * @note If the region grows, the address space of the maximum size is reserved when the file
+   * is opened and the region is extended in place, so that contents once mapped never move.
+   * The region does not grow on Windows.
    */
-  bool open(const std::string& path, uint32_t mode = OWRITER | OCREATE, int64_t msiz = 0);
+  bool open(const std::string& path, uint32_t mode = OWRITER | OCREATE, int64_t msiz = 0,
+            int64_t mcap = 0);
   /**
    * Close the file.
    * @return true on success, or false on failure.
@@ -197,8 +222,18 @@ class File {
    * @param hard true for physical synchronization with the device, or false for logical
    * synchronization with the file system.
    * @return true on success, or false on failure.
+   * @note The updated regions of the mapped memory are written out only by the physical
+   * synchronization, which writes only the regions marked as updated, or by write_back.
    */
   bool synchronize(bool hard);
+  /**
+   * Start writing back the updated regions of the mapped memory asynchronously.
+   * @param limit the maximum size of the regions to be written back, or -1 for no limit.
+   * @return true on success, or false on failure.
+   * @note This does not wait for the completion.  Calling it periodically spreads the output
+   * of a later physical synchronization over time.
+   */
+  bool write_back(int64_t limit);
   /**
    * Refresh the internal state for update by others.
    * @return true on success, or false on failure.
@@ -240,6 +275,11 @@ class File {
    * @return true if recovered, or false if not.
    */
   bool recovered() const;
+  /**
+   * Get the size of the regions of the mapped memory updated and not written back yet.
+   * @return the size of the regions, counted by the unit of dirty tracking.
+   */
+  int64_t dirty_size() const;
   /**
    * Read the whole data from a file.
    * @param path the path of a file.
@@ -263,6 +303,20 @@ class File {
    * to the path, a new file is created.
    */
   static bool write_file(const std::string& path, const char* buf, int64_t size);
+  /**
+   * Copy the whole content of a file into another file.
+   * @param spath the path of the source file.
+   * @param dpath the path of the destination file.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note The existing file corresponding to the destination path is overwritten.  If the file
+   * system supports it, the destination shares the extents of the source and the copy takes
+   * constant time.  Otherwise, the data is copied inside the kernel if possible, and through a
+   * buffer of the process if not.  The checker is called each time a chunk of the data is
+   * copied, or once when the extents are shared, and the copy fails if it returns false.
+   */
+  static bool copy_file(const std::string& spath, const std::string& dpath,
+                        CopyChecker* checker = NULL);
   /**
    * Get the status information of a file.
    * @param path the path of a file.
@@ -330,6 +384,14 @@ class File {
    * @return true on success, or false on failure.
    */
   static bool synchronize_whole();
+  /**
+   * Synchronize the file system containing a file with the device.
+   * @param path the path of a file or a directory on the file system.
+   * @return true on success, or false on failure.
+   * @note If the platform cannot synchronize a single file system, the whole of the file system
+   * is synchronized.
+   */
+  static bool synchronize_filesystem(const std::string& path);
  private:
   /** Dummy constructor to forbid the use. */
   File(const File&);
@@ -381,6 +443,55 @@ class DirStream {
 };
 
 
+/**
+ * Read-only view of a region of a file.
+ * @note The region is mapped into the memory if the platform supports it, or it is read into
+ * a buffer otherwise.  The view does not follow later modification of the region.
+ */
+class FileView {
+ public:
+  /**
+   * Default constructor.
+   */
+  explicit FileView();
+  /**
+   * Destructor.
+   * @note If the view is not closed, it is closed implicitly.
+   */
+  ~FileView();
+  /**
+   * Open a view.
+   * @param file the file object, which should be opened.
+   * @param off the offset of the region.
+   * @param size the size of the region.
+   * @return true on success, or false on failure.
+   */
+  bool open(File* file, int64_t off, size_t size);
+  /**
+   * Close the view.
+   * @return true on success, or false on failure.
+   */
+  bool close();
+  /**
+   * Get the pointer to the region.
+   * @return the pointer to the region, or NULL if the view is not opened.
+   */
+  const char* data();
+  /**
+   * Get the size of the region.
+   * @return the size of the region.
+   */
+  size_t size();
+ private:
+  /** Dummy constructor to forbid the use. */
+  FileView(const FileView&);
+  /** Dummy Operator to forbid the use. */
+  FileView& operator =(const FileView&);
+  /** Opaque pointer. */
+  void* opq_;
+};
+
+
 }                                        // common namespace
 
 #endif                                   // duplication check
@@ -0,0 +1,1221 @@
+/*************************************************************************************************
+ * Filtered database
+ *                                                               Copyright (C) 2009-2012 FAL Labs
+ * This file is part of Kyoto Cabinet.
+ * This program is free software: you can redistribute it and/or modify it under the terms of
+ * the GNU General Public License as published by the Free Software Foundation, either version
+ * 3 of the License, or any later version.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************************************/
+
+
+#ifndef _KCFILTERDB_H                    // duplication check
+#define _KCFILTERDB_H
+
+#include <kccommon.h>
+#include <kcutil.h>
+#include <kcthread.h>
+#include <kcfile.h>
+#include <kccompress.h>
+#include <kccompare.h>
+#include <kcmap.h>
+#include <kcregex.h>
+#include <kcdb.h>
+
+#define KCFDBMAGICDATA  "KCBLOOM\n"      ///< magic data of the filter file
+#define KCFDBPATHEXT  "bloom"            ///< extension of the filter file
+#define KCFDBTMPPATHEXT  "tmp"           ///< extension of the temporary filter file
+#define KCFDBDEFFPR  0.01                ///< default false-positive rate of the filter
+
+namespace kyotocabinet {                 // common namespace
+
+
+/**
+ * Filtered database.
+ * @note This class is a concrete class to put a bloom filter of the existing keys in front of an
+ * arbitrary database.  The inner database is registered by the FilterDB::set_inner method
+ * before the database is opened.  Read-only operations for keys which are not in the filter
+ * are answered without accessing the inner database.  The filter is updated whenever a record
+ * is added and it is stored in a sidecar file next to the database file when the database is
+ * closed.  The sidecar file is removed while the database is opened as a writer so that the
+ * filter is rebuilt by scanning all records after an abnormal termination.  The sidecar file
+ * records the size and the modification time of the database file after closing, and it is
+ * ignored if the database file is modified afterwards by another program.  The filter is also
+ * rebuilt when it gets saturated.
+ */
+class FilterDB : public BasicDB {
+ public:
+  class Cursor;
+ private:
+  class ProxyVisitor;
+  /** The size of the magic data of the filter file. */
+  static const int32_t FILTERMAGICSIZ = 8;
+  /** The size of the header of the filter file. */
+  static const int32_t FILTERHEADSIZ = 64;
+  /** The number of slots of the filter lock. */
+  static const int32_t FLOCKSLOT = 256;
+  /** The minimum number of keys to be expected. */
+  static const int64_t FILTERKEYMIN = 1LL << 16;
+  /** The maximum number of hash functions. */
+  static const int32_t FILTERHASHMAX = 16;
+  /** The number of threads to rebuild the filter. */
+  static const size_t REBUILDTHNUM = 4;
+  /** The threshold of busy loop and sleep for locking. */
+  static const uint32_t LOCKBUSYLOOP = 8192;
+ public:
+  /**
+   * Cursor to indicate a record.
+   */
+  class Cursor : public BasicDB::Cursor {
+    friend class FilterDB;
+   public:
+    /**
+     * Constructor.
+     * @param db the container database object.
+     */
+    explicit Cursor(FilterDB* db) : db_(db), cur_(NULL) {
+      _assert_(db);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->db_) cur_ = db_->db_->cursor();
+    }
+    /**
+     * Destructor.
+     */
+    virtual ~Cursor() {
+      _assert_(true);
+      delete cur_;
+    }
+    /**
+     * Accept a visitor to the current record.
+     * @param visitor a visitor object.
+     * @param writable true for writable operation, or false for read-only operation.
+     * @param step true to move the cursor to the next record, or false for no move.
+     * @return true on success, or false on failure.
+     * @note The operation for each record is performed atomically and other threads accessing
+     * the same record are blocked.  To avoid deadlock, any explicit database operation must not
+     * be performed in this function.
+     */
+    bool accept(Visitor* visitor, bool writable = true, bool step = false) {
+      _assert_(visitor);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0 || !cur_) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (!cur_->accept(visitor, writable, step)) {
+        db_->copy_error(cur_->db());
+        return false;
+      }
+      return true;
+    }
+    /**
+     * Jump the cursor to the first record for forward scan.
+     * @return true on success, or false on failure.
+     */
+    bool jump() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0 || !cur_) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (!cur_->jump()) {
+        db_->copy_error(cur_->db());
+        return false;
+      }
+      return true;
+    }
+    /**
+     * Jump the cursor to a record for forward scan.
+     * @param kbuf the pointer to the key region.
+     * @param ksiz the size of the key region.
+     * @return true on success, or false on failure.
+     */
+    bool jump(const char* kbuf, size_t ksiz) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0 || !cur_) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (!cur_->jump(kbuf, ksiz)) {
+        db_->copy_error(cur_->db());
+        return false;
+      }
+      return true;
+    }
+    /**
+     * Jump the cursor to a record for forward scan.
+     * @note Equal to the original Cursor::jump method except that the parameter is std::string.
+     */
+    bool jump(const std::string& key) {
+      _assert_(true);
+      return jump(key.c_str(), key.size());
+    }
+    /**
+     * Jump the cursor to the last record for backward scan.
+     * @return true on success, or false on failure.
+     * @note This method is dedicated to tree databases.  Some database types, especially hash
+     * databases, may provide a dummy implementation.
+     */
+    bool jump_back() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0 || !cur_) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (!cur_->jump_back()) {
+        db_->copy_error(cur_->db());
+        return false;
+      }
+      return true;
+    }
+    /**
+     * Jump the cursor to a record for backward scan.
+     * @param kbuf the pointer to the key region.
+     * @param ksiz the size of the key region.
+     * @return true on success, or false on failure.
+     * @note This method is dedicated to tree databases.  Some database types, especially hash
+     * databases, will provide a dummy implementation.
+     */
+    bool jump_back(const char* kbuf, size_t ksiz) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0 || !cur_) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (!cur_->jump_back(kbuf, ksiz)) {
+        db_->copy_error(cur_->db());
+        return false;
+      }
+      return true;
+    }
+    /**
+     * Jump the cursor to a record for backward scan.
+     * @note Equal to the original Cursor::jump_back method except that the parameter is
+     * std::string.
+     */
+    bool jump_back(const std::string& key) {
+      _assert_(true);
+      return jump_back(key.c_str(), key.size());
+    }
+    /**
+     * Step the cursor to the next record.
+     * @return true on success, or false on failure.
+     */
+    bool step() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0 || !cur_) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (!cur_->step()) {
+        db_->copy_error(cur_->db());
+        return false;
+      }
+      return true;
+    }
+    /**
+     * Step the cursor to the previous record.
+     * @return true on success, or false on failure.
+     * @note This method is dedicated to tree databases.  Some database types, especially hash
+     * databases, may provide a dummy implementation.
+     */
+    bool step_back() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0 || !cur_) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (!cur_->step_back()) {
+        db_->copy_error(cur_->db());
+        return false;
+      }
+      return true;
+    }
+    /**
+     * Get the database object.
+     * @return the database object.
+     */
+    FilterDB* db() {
+      _assert_(true);
+      return db_;
+    }
+   private:
+    /** Dummy constructor to forbid the use. */
+    Cursor(const Cursor&);
+    /** Dummy Operator to forbid the use. */
+    Cursor& operator =(const Cursor&);
+    /** The inner database. */
+    FilterDB* db_;
+    /** The cursor of the inner database. */
+    BasicDB::Cursor* cur_;
+  };
+  /**
+   * Default constructor.
+   */
+  explicit FilterDB() :
+      mlock_(), flock_(FLOCKSLOT), error_(), logger_(NULL), logkinds_(0), mtrigger_(NULL),
+      omode_(0), tran_(false), db_(NULL), dpath_(""), path_(""), fpath_(""), fmsiz_(0),
+      fpr_(KCFDBDEFFPR), bits_(NULL), bnum_(0), hnum_(0), fcap_(0), fkeycnt_(0),
+      skipcnt_(0), passcnt_(0), rebuildcnt_(0) {
+    _assert_(true);
+  }
+  /**
+   * Destructor.
+   * @note If the database is not closed, it is closed implicitly.  The inner database is
+   * deleted.
+   */
+  virtual ~FilterDB() {
+    _assert_(true);
+    if (omode_ != 0) close();
+    delete db_;
+    delete[] bits_;
+  }
+  /**
+   * Set the inner database.
+   * @param db the inner database object.  Its possession is transferred inside and the object
+   * is deleted automatically.
+   * @param path the path of the inner database, which is given to its open method.
+   * @return true on success, or false on failure.
+   */
+  bool set_inner(BasicDB* db, const std::string& path) {
+    _assert_(db);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    delete db_;
+    db_ = db;
+    dpath_ = path;
+    return true;
+  }
+  /**
+   * Accept a visitor to a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @return true on success, or false on failure.
+   * @note A read-only operation for a key which is not in the filter calls the visit_empty
+   * method of the visitor without accessing the inner database.  To avoid deadlock, any
+   * explicit database operation must not be performed in this function.
+   */
+  bool accept(const char* kbuf, size_t ksiz, Visitor* visitor, bool writable = true) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!writable && !check_key(kbuf, ksiz)) {
+      size_t sp;
+      visitor->visit_empty(kbuf, ksiz, &sp);
+      return true;
+    }
+    ProxyVisitor proxy(this, visitor, writable);
+    if (!db_->accept(kbuf, ksiz, &proxy, writable)) {
+      copy_error(db_);
+      return false;
+    }
+    return true;
+  }
+  /**
+   * Accept a visitor to multiple records at once.
+   * @param keys specifies a string vector of the keys.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @return true on success, or false on failure.
+   * @note In a read-only operation, the keys which are not in the filter are visited first
+   * without accessing the inner database.  The operations for the other records are performed
+   * atomically and other threads accessing the same records are blocked.  To avoid deadlock,
+   * any explicit database operation must not be performed in this function.
+   */
+  bool accept_bulk(const std::vector<std::string>& keys, Visitor* visitor,
+                   bool writable = true) {
+    _assert_(visitor);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    visitor->visit_before();
+    std::vector<std::string> rkeys;
+    const std::vector<std::string>* kp = &keys;
+    if (!writable) {
+      rkeys.reserve(keys.size());
+      std::vector<std::string>::const_iterator it = keys.begin();
+      std::vector<std::string>::const_iterator itend = keys.end();
+      while (it != itend) {
+        if (check_key(it->data(), it->size())) {
+          rkeys.push_back(*it);
+        } else {
+          size_t sp;
+          visitor->visit_empty(it->data(), it->size(), &sp);
+        }
+        ++it;
+      }
+      kp = &rkeys;
+    }
+    bool err = false;
+    if (!kp->empty()) {
+      ProxyVisitor proxy(this, visitor, writable);
+      if (!db_->accept_bulk(*kp, &proxy, writable)) {
+        copy_error(db_);
+        err = true;
+      }
+    }
+    visitor->visit_after();
+    return !err;
+  }
+  /**
+   * Iterate to accept a visitor for each record.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note The whole iteration is performed atomically and other threads are blocked.  To avoid
+   * deadlock, any explicit database operation must not be performed in this function.
+   */
+  bool iterate(Visitor *visitor, bool writable = true, ProgressChecker* checker = NULL) {
+    _assert_(visitor);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!db_->iterate(visitor, writable, checker)) {
+      copy_error(db_);
+      return false;
+    }
+    trigger_meta(MetaTrigger::ITERATE, "iterate");
+    return true;
+  }
+  /**
+   * Scan each record in parallel.
+   * @param visitor a visitor object.
+   * @param thnum the number of worker threads.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note This function is for reading records and not for updating ones.  The return value of
+   * the visitor is just ignored.  To avoid deadlock, any explicit database operation must not
+   * be performed in this function.
+   */
+  bool scan_parallel(Visitor *visitor, size_t thnum, ProgressChecker* checker = NULL) {
+    _assert_(visitor && thnum <= MEMMAXSIZ);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!db_->scan_parallel(visitor, thnum, checker)) {
+      copy_error(db_);
+      return false;
+    }
+    trigger_meta(MetaTrigger::ITERATE, "scan_parallel");
+    return true;
+  }
+  /**
+   * Get the last happened error.
+   * @return the last happened error.
+   */
+  Error error() const {
+    _assert_(true);
+    return error_;
+  }
+  /**
+   * Set the error information.
+   * @param file the file name of the program source code.
+   * @param line the line number of the program source code.
+   * @param func the function name of the program source code.
+   * @param code an error code.
+   * @param message a supplement message.
+   */
+  void set_error(const char* file, int32_t line, const char* func,
+                 Error::Code code, const char* message) {
+    _assert_(file && line > 0 && func && message);
+    error_->set(code, message);
+    if (logger_) {
+      Logger::Kind kind = code == Error::BROKEN || code == Error::SYSTEM ?
+          Logger::ERROR : Logger::INFO;
+      if (kind & logkinds_)
+        report(file, line, func, kind, "%d: %s: %s", code, Error::codename(code), message);
+    }
+  }
+  /**
+   * Open a database file.
+   * @param path the path of the whole database, which is used only for identification.
+   * @param mode the connection mode, which is given to the inner database.
+   * @return true on success, or false on failure.
+   * @note The filter is loaded from the sidecar file if it is consistent with the inner
+   * database, or else it is rebuilt by scanning all records.  The sidecar file is kept only if
+   * the inner database is stored in a file or a directory.
+   */
+  bool open(const std::string& path, uint32_t mode = OWRITER | OCREATE) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    mlock_.set_bias(mode & OREADBIAS);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    if (!db_) {
+      set_error(_KCCODELINE_, Error::INVALID, "no inner database");
+      return false;
+    }
+    report(_KCCODELINE_, Logger::DEBUG, "opening the database (path=%s)", path.c_str());
+    const std::string& spath = dpath_.substr(0, dpath_.find('#'));
+    File::Status sbuf;
+    bool stamped = !spath.empty() && File::status(spath, &sbuf);
+    if (!db_->open(dpath_, mode)) {
+      copy_error(db_);
+      return false;
+    }
+    fpath_.clear();
+    const std::string& ipath = db_->path();
+    if (!ipath.empty() && File::status(ipath)) fpath_ = ipath + File::EXTCHR + KCFDBPATHEXT;
+    bool loaded = !fpath_.empty() && !(mode & OTRUNCATE) && stamped && spath == ipath &&
+        load_filter(sbuf.size, sbuf.mtime);
+    if (!loaded && !rebuild_filter()) {
+      db_->close();
+      return false;
+    }
+    if (!fpath_.empty() && (mode & OWRITER) && File::status(fpath_) && !File::remove(fpath_)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, "removing the filter file failed");
+      db_->close();
+      return false;
+    }
+    omode_ = mode;
+    tran_ = false;
+    path_ = path;
+    trigger_meta(MetaTrigger::OPEN, "open");
+    return true;
+  }
+  /**
+   * Close the database file.
+   * @return true on success, or false on failure.
+   * @note The filter is stored in the sidecar file if the database is opened as a writer.
+   */
+  bool close() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    report(_KCCODELINE_, Logger::DEBUG, "closing the database (path=%s)", path_.c_str());
+    bool err = false;
+    if (tran_ && !db_->end_transaction(false)) {
+      copy_error(db_);
+      err = true;
+    }
+    tran_ = false;
+    const std::string ipath = db_->path();
+    int64_t rnum = -1;
+    if (!fpath_.empty() && (omode_ & OWRITER)) {
+      rnum = db_->count();
+      if (rnum < 0) {
+        copy_error(db_);
+        err = true;
+      }
+    }
+    if (!db_->close()) {
+      copy_error(db_);
+      err = true;
+    }
+    if (!err && rnum >= 0 && !save_filter(ipath, rnum)) err = true;
+    omode_ = 0;
+    path_.clear();
+    fpath_.clear();
+    trigger_meta(MetaTrigger::CLOSE, "close");
+    return !err;
+  }
+  /**
+   * Synchronize updated contents with the file and the device.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @param proc a postprocessor object.  If it is NULL, no postprocessing is performed.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note The filter is rebuilt beforehand if it is saturated.
+   */
+  bool synchronize(bool hard = false, FileProcessor* proc = NULL,
+                   ProgressChecker* checker = NULL) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    bool err = false;
+    if (fmsiz_ < 1 && fkeycnt_.get() > fcap_ && !rebuild_filter()) err = true;
+    if (!db_->synchronize(hard, proc, checker)) {
+      copy_error(db_);
+      err = true;
+    }
+    trigger_meta(MetaTrigger::SYNCHRONIZE, "synchronize");
+    return !err;
+  }
+  /**
+   * Occupy database by locking and do something meanwhile.
+   * @param writable true to use writer lock, or false to use reader lock.
+   * @param proc a processor object.  If it is NULL, no processing is performed.
+   * @return true on success, or false on failure.
+   * @note The operation of the processor is performed atomically and other threads accessing
+   * the same record are blocked.  To avoid deadlock, any explicit database operation must not
+   * be performed in this function.
+   */
+  bool occupy(bool writable = true, FileProcessor* proc = NULL) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, writable);
+    bool err = false;
+    if (proc && !proc->process(path_, count_impl(), size_impl())) {
+      set_error(_KCCODELINE_, Error::LOGIC, "processing failed");
+      err = true;
+    }
+    trigger_meta(MetaTrigger::OCCUPY, "occupy");
+    return !err;
+  }
+  /**
+   * Begin transaction.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @return true on success, or false on failure.
+   * @note Keys added in an aborted transaction remain in the filter.
+   */
+  bool begin_transaction(bool hard = false) {
+    _assert_(true);
+    uint32_t wcnt = 0;
+    while (true) {
+      mlock_.lock_writer();
+      if (omode_ == 0) {
+        set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        mlock_.unlock();
+        return false;
+      }
+      if (!(omode_ & OWRITER)) {
+        set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+        mlock_.unlock();
+        return false;
+      }
+      if (!tran_) break;
+      mlock_.unlock();
+      if (wcnt >= LOCKBUSYLOOP) {
+        Thread::chill();
+      } else {
+        Thread::yield();
+        wcnt++;
+      }
+    }
+    if (!db_->begin_transaction(hard)) {
+      copy_error(db_);
+      mlock_.unlock();
+      return false;
+    }
+    tran_ = true;
+    trigger_meta(MetaTrigger::BEGINTRAN, "begin_transaction");
+    mlock_.unlock();
+    return true;
+  }
+  /**
+   * Try to begin transaction.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @return true on success, or false on failure.
+   */
+  bool begin_transaction_try(bool hard = false) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!(omode_ & OWRITER)) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    if (tran_) {
+      set_error(_KCCODELINE_, Error::LOGIC, "competition avoided");
+      return false;
+    }
+    if (!db_->begin_transaction_try(hard)) {
+      copy_error(db_);
+      return false;
+    }
+    tran_ = true;
+    trigger_meta(MetaTrigger::BEGINTRAN, "begin_transaction_try");
+    return true;
+  }
+  /**
+   * End transaction.
+   * @param commit true to commit the transaction, or false to abort the transaction.
+   * @return true on success, or false on failure.
+   */
+  bool end_transaction(bool commit = true) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!tran_) {
+      set_error(_KCCODELINE_, Error::INVALID, "not in transaction");
+      return false;
+    }
+    bool err = false;
+    if (!db_->end_transaction(commit)) {
+      copy_error(db_);
+      err = true;
+    }
+    tran_ = false;
+    trigger_meta(commit ? MetaTrigger::COMMITTRAN : MetaTrigger::ABORTTRAN, "end_transaction");
+    return !err;
+  }
+  /**
+   * Remove all records.
+   * @return true on success, or false on failure.
+   */
+  bool clear() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!db_->clear()) {
+      copy_error(db_);
+      return false;
+    }
+    std::memset(bits_, 0, bnum_ / 8);
+    fkeycnt_ = 0;
+    trigger_meta(MetaTrigger::CLEAR, "clear");
+    return true;
+  }
+  /**
+   * Get the number of records.
+   * @return the number of records, or -1 on failure.
+   */
+  int64_t count() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return -1;
+    }
+    return count_impl();
+  }
+  /**
+   * Get the size of the database file.
+   * @return the size of the database file in bytes, or -1 on failure.
+   */
+  int64_t size() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return -1;
+    }
+    return size_impl();
+  }
+  /**
+   * Get the path of the database file.
+   * @return the path of the database file, or an empty string on failure.
+   */
+  std::string path() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return "";
+    }
+    return path_;
+  }
+  /**
+   * Get the miscellaneous status information.
+   * @param strmap a string map to contain the result.
+   * @return true on success, or false on failure.
+   * @note The status of the inner database is reported together with the geometry of the
+   * filter and the numbers of skipped and passed lookups.
+   */
+  bool status(std::map<std::string, std::string>* strmap) {
+    _assert_(strmap);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!db_->status(strmap)) {
+      copy_error(db_);
+      return false;
+    }
+    (*strmap)["path"] = path_;
+    (*strmap)["filter_path"] = fpath_;
+    (*strmap)["filter_bits"] = strprintf("%lld", (long long)bnum_);
+    (*strmap)["filter_hashes"] = strprintf("%d", (int)hnum_);
+    (*strmap)["filter_capacity"] = strprintf("%lld", (long long)fcap_);
+    (*strmap)["filter_keys"] = strprintf("%lld", (long long)fkeycnt_.get());
+    (*strmap)["filter_skip"] = strprintf("%lld", (long long)skipcnt_.get());
+    (*strmap)["filter_pass"] = strprintf("%lld", (long long)passcnt_.get());
+    (*strmap)["filter_rebuilt"] = strprintf("%lld", (long long)rebuildcnt_.get());
+    return true;
+  }
+  /**
+   * Create a cursor object.
+   * @return the return value is the created cursor object.
+   * @note Because the object of the return value is allocated by the constructor, it should be
+   * released with the delete operator when it is no longer in use.
+   */
+  Cursor* cursor() {
+    _assert_(true);
+    return new Cursor(this);
+  }
+  /**
+   * Write a log message.
+   * @param file the file name of the program source code.
+   * @param line the line number of the program source code.
+   * @param func the function name of the program source code.
+   * @param kind the kind of the event.  Logger::DEBUG for debugging, Logger::INFO for normal
+   * information, Logger::WARN for warning, and Logger::ERROR for fatal error.
+   * @param message the supplement message.
+   */
+  void log(const char* file, int32_t line, const char* func, Logger::Kind kind,
+           const char* message) {
+    _assert_(file && line > 0 && func && message);
+    ScopedRWLock lock(&mlock_, false);
+    if (!logger_) return;
+    logger_->log(file, line, func, kind, message);
+  }
+  /**
+   * Set the internal logger.
+   * @param logger the logger object.
+   * @param kinds kinds of logged messages by bitwise-or: Logger::DEBUG for debugging,
+   * Logger::INFO for normal information, Logger::WARN for warning, and Logger::ERROR for fatal
+   * error.
+   * @return true on success, or false on failure.
+   */
+  bool tune_logger(Logger* logger, uint32_t kinds = Logger::WARN | Logger::ERROR) {
+    _assert_(logger);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    logger_ = logger;
+    logkinds_ = kinds;
+    return true;
+  }
+  /**
+   * Set the internal meta operation trigger.
+   * @param trigger the trigger object.
+   * @return true on success, or false on failure.
+   */
+  bool tune_meta_trigger(MetaTrigger* trigger) {
+    _assert_(trigger);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    mtrigger_ = trigger;
+    return true;
+  }
+  /**
+   * Set the geometry of the filter.
+   * @param msiz the memory size of the filter in bytes.  If it is not more than 0, the size is
+   * calculated from the number of records whenever the filter is built, and the filter is
+   * rebuilt when the number of keys exceeds twice the number of records at that time.
+   * @param fpr the expected false-positive rate, which determines the number of hash functions
+   * and the number of bits for each key.  If it is not more than 0, the default rate 0.01 is
+   * specified.
+   * @return true on success, or false on failure.
+   */
+  bool tune_filter(int64_t msiz, double fpr = KCFDBDEFFPR) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    fmsiz_ = msiz > 0 ? msiz : 0;
+    fpr_ = fpr > 0 && fpr < 1 ? fpr : KCFDBDEFFPR;
+    return true;
+  }
+  /**
+   * Rebuild the filter by scanning all records.
+   * @return true on success, or false on failure.
+   * @note Keys of removed records are dropped from the filter and the size of the filter is
+   * adjusted to the current number of records.
+   */
+  bool rebuild() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    return rebuild_filter();
+  }
+ protected:
+  /**
+   * Report a message for debugging.
+   * @param file the file name of the program source code.
+   * @param line the line number of the program source code.
+   * @param func the function name of the program source code.
+   * @param kind the kind of the event.  Logger::DEBUG for debugging, Logger::INFO for normal
+   * information, Logger::WARN for warning, and Logger::ERROR for fatal error.
+   * @param format the printf-like format string.
+   * @param ... used according to the format string.
+   */
+  void report(const char* file, int32_t line, const char* func, Logger::Kind kind,
+              const char* format, ...) {
+    _assert_(file && line > 0 && func && format);
+    if (!logger_ || !(kind & logkinds_)) return;
+    std::string message;
+    strprintf(&message, "%s: ", path_.empty() ? "-" : path_.c_str());
+    va_list ap;
+    va_start(ap, format);
+    vstrprintf(&message, format, ap);
+    va_end(ap);
+    logger_->log(file, line, func, kind, message.c_str());
+  }
+  /**
+   * Trigger a meta database operation.
+   * @param kind the kind of the event.  MetaTrigger::OPEN for opening, MetaTrigger::CLOSE for
+   * closing, MetaTrigger::CLEAR for clearing, MetaTrigger::ITERATE for iteration,
+   * MetaTrigger::SYNCHRONIZE for synchronization, MetaTrigger::BEGINTRAN for beginning
+   * transaction, MetaTrigger::COMMITTRAN for committing transaction, MetaTrigger::ABORTTRAN
+   * for aborting transaction, and MetaTrigger::MISC for miscellaneous operations.
+   * @param message the supplement message.
+   */
+  void trigger_meta(MetaTrigger::Kind kind, const char* message) {
+    _assert_(message);
+    if (mtrigger_) mtrigger_->trigger(kind, message);
+  }
+ private:
+  /**
+   * Visitor to add the keys of new records to the filter.
+   */
+  class ProxyVisitor : public Visitor {
+   public:
+    /** constructor */
+    explicit ProxyVisitor(FilterDB* db, Visitor* visitor, bool writable) :
+        db_(db), visitor_(visitor), writable_(writable) {}
+   private:
+    const char* visit_full(const char* kbuf, size_t ksiz,
+                           const char* vbuf, size_t vsiz, size_t* sp) {
+      if (!writable_) db_->passcnt_.add(1);
+      return visitor_->visit_full(kbuf, ksiz, vbuf, vsiz, sp);
+    }
+    const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
+      const char* rbuf = visitor_->visit_empty(kbuf, ksiz, sp);
+      if (writable_) {
+        if (rbuf != NOP && rbuf != REMOVE) db_->add_key(kbuf, ksiz);
+      } else {
+        db_->passcnt_.add(1);
+      }
+      return rbuf;
+    }
+    FilterDB* db_;                       ///< database
+    Visitor* visitor_;                   ///< wrapped visitor
+    bool writable_;                      ///< whether writable
+  };
+  /**
+   * Calculate the probing positions of a key.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param hp the pointer to the variable into which the first hash value is assigned.
+   * @param sp the pointer to the variable into which the step of probing is assigned.
+   */
+  void probe_key(const char* kbuf, size_t ksiz, uint64_t* hp, uint64_t* sp) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && hp && sp);
+    *hp = hashmurmur(kbuf, ksiz);
+    *sp = hashfnv(kbuf, ksiz) | 1;
+  }
+  /**
+   * Add a key to the filter.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   */
+  void add_key(const char* kbuf, size_t ksiz) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ);
+    uint64_t hash, step;
+    probe_key(kbuf, ksiz, &hash, &step);
+    for (int32_t i = 0; i < hnum_; i++) {
+      uint64_t bidx = hash % bnum_;
+      uint64_t widx = bidx / (sizeof(*bits_) * 8);
+      uint64_t mask = 1ULL << (bidx % (sizeof(*bits_) * 8));
+      if (!(bits_[widx] & mask)) {
+        size_t lidx = widx % FLOCKSLOT;
+        flock_.lock(lidx);
+        bits_[widx] |= mask;
+        flock_.unlock(lidx);
+      }
+      hash += step;
+    }
+    fkeycnt_.add(1);
+  }
+  /**
+   * Check whether a key may be in the filter.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @return false if the key is surely absent, or true if it may exist.
+   */
+  bool check_key(const char* kbuf, size_t ksiz) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ);
+    uint64_t hash, step;
+    probe_key(kbuf, ksiz, &hash, &step);
+    for (int32_t i = 0; i < hnum_; i++) {
+      uint64_t bidx = hash % bnum_;
+      uint64_t mask = 1ULL << (bidx % (sizeof(*bits_) * 8));
+      if (!(bits_[bidx/(sizeof(*bits_)*8)] & mask)) {
+        skipcnt_.add(1);
+        return false;
+      }
+      hash += step;
+    }
+    return true;
+  }
+  /**
+   * Allocate the bits of the filter.
+   * @param rnum the number of records.
+   */
+  void setup_filter(int64_t rnum) {
+    _assert_(true);
+    double bpk = -std::log(fpr_) / (std::log(2.0) * std::log(2.0));
+    int64_t bnum;
+    if (fmsiz_ > 0) {
+      bnum = fmsiz_ * 8;
+    } else {
+      int64_t knum = rnum * 2;
+      if (knum < FILTERKEYMIN) knum = FILTERKEYMIN;
+      bnum = (int64_t)(knum * bpk) + 1;
+    }
+    int64_t wbits = sizeof(*bits_) * 8;
+    bnum = (bnum + wbits - 1) / wbits * wbits;
+    int32_t hnum = (int32_t)(bpk * std::log(2.0) + 0.5);
+    if (hnum < 1) hnum = 1;
+    if (hnum > FILTERHASHMAX) hnum = FILTERHASHMAX;
+    delete[] bits_;
+    bits_ = new uint64_t[bnum/wbits];
+    std::memset(bits_, 0, bnum / 8);
+    bnum_ = bnum;
+    hnum_ = hnum;
+    fcap_ = (int64_t)(bnum / bpk);
+    fkeycnt_ = 0;
+  }
+  /**
+   * Rebuild the filter by scanning all records of the inner database.
+   * @return true on success, or false on failure.
+   */
+  bool rebuild_filter() {
+    _assert_(true);
+    int64_t rnum = db_->count();
+    if (rnum < 0) {
+      copy_error(db_);
+      return false;
+    }
+    report(_KCCODELINE_, Logger::INFO, "rebuilding the filter (records=%lld)", (long long)rnum);
+    setup_filter(rnum);
+    class VisitorImpl : public Visitor {
+     public:
+      explicit VisitorImpl(FilterDB* db) : db_(db) {}
+     private:
+      const char* visit_full(const char* kbuf, size_t ksiz,
+                             const char* vbuf, size_t vsiz, size_t* sp) {
+        db_->add_key(kbuf, ksiz);
+        return NOP;
+      }
+      FilterDB* db_;
+    };
+    VisitorImpl visitor(this);
+    if (!db_->scan_parallel(&visitor, REBUILDTHNUM)) {
+      copy_error(db_);
+      return false;
+    }
+    rebuildcnt_.add(1);
+    return true;
+  }
+  /**
+   * Load the filter from the sidecar file.
+   * @param dsiz the size of the database file before it was opened.
+   * @param dmtime the modification time of the database file before it was opened.
+   * @return true on success, or false if the file is missing or inconsistent.
+   */
+  bool load_filter(int64_t dsiz, int64_t dmtime) {
+    _assert_(true);
+    int64_t fsiz;
+    char* fbuf = File::read_file(fpath_, &fsiz);
+    if (!fbuf) return false;
+    bool ok = false;
+    if (fsiz >= FILTERHEADSIZ && !std::memcmp(fbuf, KCFDBMAGICDATA, FILTERMAGICSIZ)) {
+      const char* rp = fbuf + FILTERMAGICSIZ;
+      int64_t bnum = readfixnum(rp, sizeof(int64_t));
+      rp += sizeof(int64_t);
+      int32_t hnum = readfixnum(rp, sizeof(int32_t));
+      rp += sizeof(int32_t) * 2;
+      int64_t knum = readfixnum(rp, sizeof(int64_t));
+      rp += sizeof(int64_t);
+      int64_t rnum = readfixnum(rp, sizeof(int64_t));
+      rp += sizeof(int64_t);
+      int64_t ssiz = readfixnum(rp, sizeof(int64_t));
+      rp += sizeof(int64_t);
+      int64_t smtime = readfixnum(rp, sizeof(int64_t));
+      rp += sizeof(int64_t) * 2;
+      int64_t wbits = sizeof(*bits_) * 8;
+      if (bnum > 0 && bnum % wbits == 0 && fsiz == FILTERHEADSIZ + bnum / 8 &&
+          hnum > 0 && hnum <= FILTERHASHMAX && ssiz == dsiz && smtime == dmtime &&
+          rnum == db_->count() && (fmsiz_ < 1 || fmsiz_ * 8 == bnum)) {
+        setup_filter(rnum);
+        if (bnum_ != bnum) {
+          delete[] bits_;
+          bits_ = new uint64_t[bnum/wbits];
+          bnum_ = bnum;
+        }
+        hnum_ = hnum;
+        for (int64_t i = 0; i < bnum / wbits; i++) {
+          bits_[i] = readfixnum(rp, sizeof(*bits_));
+          rp += sizeof(*bits_);
+        }
+        fkeycnt_ = knum;
+        ok = true;
+      }
+    }
+    delete[] fbuf;
+    if (!ok) report(_KCCODELINE_, Logger::WARN, "ignoring the inconsistent filter file");
+    return ok;
+  }
+  /**
+   * Store the filter into the sidecar file.
+   * @param ipath the path of the closed database file.
+   * @param rnum the number of records.
+   * @return true on success, or false on failure.
+   */
+  bool save_filter(const std::string& ipath, int64_t rnum) {
+    _assert_(rnum >= 0);
+    File::Status sbuf;
+    if (!File::status(ipath, &sbuf)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, "checking the database file failed");
+      return false;
+    }
+    int64_t wnum = bnum_ / (sizeof(*bits_) * 8);
+    int64_t fsiz = FILTERHEADSIZ + wnum * sizeof(*bits_);
+    char* fbuf = new char[fsiz];
+    std::memset(fbuf, 0, FILTERHEADSIZ);
+    std::memcpy(fbuf, KCFDBMAGICDATA, FILTERMAGICSIZ);
+    char* wp = fbuf + FILTERMAGICSIZ;
+    writefixnum(wp, bnum_, sizeof(int64_t));
+    wp += sizeof(int64_t);
+    writefixnum(wp, hnum_, sizeof(int32_t));
+    wp += sizeof(int32_t) * 2;
+    writefixnum(wp, fkeycnt_.get(), sizeof(int64_t));
+    wp += sizeof(int64_t);
+    writefixnum(wp, rnum, sizeof(int64_t));
+    wp += sizeof(int64_t);
+    writefixnum(wp, sbuf.size, sizeof(int64_t));
+    wp += sizeof(int64_t);
+    writefixnum(wp, sbuf.mtime, sizeof(int64_t));
+    wp += sizeof(int64_t) * 2;
+    for (int64_t i = 0; i < wnum; i++) {
+      writefixnum(wp, bits_[i], sizeof(*bits_));
+      wp += sizeof(*bits_);
+    }
+    const std::string& tpath = fpath_ + File::EXTCHR + KCFDBTMPPATHEXT;
+    bool err = false;
+    if (!File::write_file(tpath, fbuf, fsiz) || !File::rename(tpath, fpath_)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, "writing the filter file failed");
+      File::remove(tpath);
+      err = true;
+    }
+    delete[] fbuf;
+    return !err;
+  }
+  /**
+   * Copy the last error of the inner database.
+   * @param db the inner database.
+   */
+  void copy_error(BasicDB* db) {
+    _assert_(db);
+    const Error& error = db->error();
+    error_->set(error.code(), error.message());
+  }
+  /**
+   * Get the number of records.
+   * @return the number of records, or -1 on failure.
+   */
+  int64_t count_impl() {
+    _assert_(true);
+    return db_ ? db_->count() : -1;
+  }
+  /**
+   * Get the size of the database file.
+   * @return the size of the database file in bytes, or -1 on failure.
+   */
+  int64_t size_impl() {
+    _assert_(true);
+    return db_ ? db_->size() : -1;
+  }
+  /** Dummy constructor to forbid the use. */
+  FilterDB(const FilterDB&);
+  /** Dummy Operator to forbid the use. */
+  FilterDB& operator =(const FilterDB&);
+  /** The method lock. */
+  RWLock mlock_;
+  /** The locks of the filter bits. */
+  SlottedSpinLock flock_;
+  /** The last happened error. */
+  TSD<Error> error_;
+  /** The internal logger. */
+  Logger* logger_;
+  /** The kinds of logged messages. */
+  uint32_t logkinds_;
+  /** The internal meta operation trigger. */
+  MetaTrigger* mtrigger_;
+  /** The open mode. */
+  uint32_t omode_;
+  /** The flag whether in transaction. */
+  bool tran_;
+  /** The inner database. */
+  BasicDB* db_;
+  /** The path of the inner database. */
+  std::string dpath_;
+  /** The path of the database. */
+  std::string path_;
+  /** The path of the filter file. */
+  std::string fpath_;
+  /** The tuned memory size of the filter. */
+  int64_t fmsiz_;
+  /** The expected false-positive rate. */
+  double fpr_;
+  /** The bits of the filter. */
+  uint64_t* bits_;
+  /** The number of bits of the filter. */
+  int64_t bnum_;
+  /** The number of hash functions. */
+  int32_t hnum_;
+  /** The number of keys to keep the expected false-positive rate. */
+  int64_t fcap_;
+  /** The number of keys added to the filter. */
+  AtomicInt64 fkeycnt_;
+  /** The number of lookups skipped by the filter. */
+  AtomicInt64 skipcnt_;
+  /** The number of lookups passed to the inner database. */
+  AtomicInt64 passcnt_;
+  /** The number of rebuilds of the filter. */
+  AtomicInt64 rebuildcnt_;
+};
+
+
+}                                        // common namespace
+
+#endif                                   // duplication check
+
+// END OF FILE
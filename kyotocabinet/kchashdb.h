@@ -519,10 +519,11 @@ class HashDB : public BasicDB {
       libver_(0), librev_(0), fmtver_(0), chksum_(0), type_(TYPEHASH),
       apow_(DEFAPOW), fpow_(DEFFPOW), opts_(0), bnum_(DEFBNUM),
       flags_(0), flagopen_(false), count_(0), lsiz_(0), psiz_(0), opaque_(),
-      msiz_(DEFMSIZ), dfunit_(0), embcomp_(ZLIBRAWCOMP),
+      msiz_(DEFMSIZ), mcap_(0), dfunit_(0), embcomp_(ZLIBRAWCOMP),
       align_(0), fbpnum_(0), width_(0), linear_(false),
       comp_(NULL), rhsiz_(0), boff_(0), roff_(0), dfcur_(0), frgcnt_(0),
-      tran_(false), trhard_(false), trfbp_(), trcount_(0), trsize_(0) {
+      tran_(false), trhard_(false), trfbp_(), trcount_(0), trsize_(0),
+      rdcnt_(0), rdsize_(0), wrsize_(0), walkcnt_(0), lockwait_(0) {
     _assert_(true);
   }
   /**
@@ -555,7 +556,10 @@ class HashDB : public BasicDB {
    */
   bool accept(const char* kbuf, size_t ksiz, Visitor* visitor, bool writable = true) {
     _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
-    mlock_.lock_reader();
+    if (!mlock_.lock_reader_try()) {
+      lockwait_ += 1;
+      mlock_.lock_reader();
+    }
     if (omode_ == 0) {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
       mlock_.unlock();
@@ -609,7 +613,10 @@ class HashDB : public BasicDB {
   bool accept_bulk(const std::vector<std::string>& keys, Visitor* visitor,
                    bool writable = true) {
     _assert_(visitor);
-    mlock_.lock_reader();
+    if (!mlock_.lock_reader_try()) {
+      lockwait_ += 1;
+      mlock_.lock_reader();
+    }
     if (omode_ == 0) {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
       mlock_.unlock();
@@ -791,6 +798,8 @@ class HashDB : public BasicDB {
    * HashDB::OTRYLOCK, which means locking is performed without blocking, HashDB::ONOREPAIR,
    * which means the database file is not repaired implicitly even if file destruction is
    * detected.
+   * HashDB::OREADBIAS may also be added to bias the lock of the database object to readers,
+   * which makes reading operations cheaper and updating operations dearer.
    * @return true on success, or false on failure.
    * @note Every opened database must be closed by the HashDB::close method when it is no
    * longer in use.  It is not allowed for two or more database objects in the same process to
@@ -799,6 +808,7 @@ class HashDB : public BasicDB {
   bool open(const std::string& path, uint32_t mode = OWRITER | OCREATE) {
     _assert_(true);
     ScopedRWLock lock(&mlock_, true);
+    mlock_.set_bias(mode & OREADBIAS);
     if (omode_ != 0) {
       set_error(_KCCODELINE_, Error::INVALID, "already opened");
       return false;
@@ -820,7 +830,7 @@ class HashDB : public BasicDB {
     }
     if (mode & ONOLOCK) fmode |= File::ONOLOCK;
     if (mode & OTRYLOCK) fmode |= File::OTRYLOCK;
-    if (!file_.open(path, fmode, msiz_)) {
+    if (!file_.open(path, fmode, msiz_, mcap_)) {
       const char* emsg = file_.error();
       Error::Code code = Error::SYSTEM;
       if (std::strstr(emsg, "(permission denied)") || std::strstr(emsg, "(directory)")) {
@@ -876,7 +886,7 @@ class HashDB : public BasicDB {
         set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
         return false;
       }
-      if (!file_.open(path, fmode, msiz_)) {
+      if (!file_.open(path, fmode, msiz_, mcap_)) {
         set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
         return false;
       }
@@ -1205,6 +1215,7 @@ class HashDB : public BasicDB {
     (*strmap)["opts"] = strprintf("%u", opts_);
     (*strmap)["bnum"] = strprintf("%lld", (long long)bnum_);
     (*strmap)["msiz"] = strprintf("%lld", (long long)msiz_);
+    (*strmap)["mcap"] = strprintf("%lld", (long long)mcap_);
     (*strmap)["dfunit"] = strprintf("%lld", (long long)dfunit_);
     (*strmap)["frgcnt"] = strprintf("%lld", (long long)(frgcnt_ > 0 ? (int64_t)frgcnt_ : 0));
     (*strmap)["realsize"] = strprintf("%lld", (long long)file_.size());
@@ -1231,6 +1242,11 @@ class HashDB : public BasicDB {
     }
     (*strmap)["count"] = strprintf("%lld", (long long)count_);
     (*strmap)["size"] = strprintf("%lld", (long long)lsiz_);
+    (*strmap)["rdcnt"] = strprintf("%lld", (long long)rdcnt_);
+    (*strmap)["rdsize"] = strprintf("%lld", (long long)rdsize_);
+    (*strmap)["wrsize"] = strprintf("%lld", (long long)wrsize_);
+    (*strmap)["walkcnt"] = strprintf("%lld", (long long)walkcnt_);
+    (*strmap)["lockwait"] = strprintf("%lld", (long long)lockwait_);
     return true;
   }
   /**
@@ -1360,9 +1376,11 @@ class HashDB : public BasicDB {
   /**
    * Set the size of the internal memory-mapped region.
    * @param msiz the size of the internal memory-mapped region.
+   * @param mcap the maximum size to which the region grows as the file grows.  If it is not
+   * more than the size of the region, the region does not grow.
    * @return true on success, or false on failure.
    */
-  bool tune_map(int64_t msiz) {
+  bool tune_map(int64_t msiz, int64_t mcap = 0) {
     _assert_(true);
     ScopedRWLock lock(&mlock_, true);
     if (omode_ != 0) {
@@ -1370,6 +1388,7 @@ class HashDB : public BasicDB {
       return false;
     }
     msiz_ = msiz >= 0 ? msiz : DEFMSIZ;
+    mcap_ = mcap > 0 ? mcap : 0;
     return true;
   }
   /**
@@ -1845,6 +1864,7 @@ class HashDB : public BasicDB {
     char rbuf[RECBUFSIZ];
     while (off > 0) {
       rec.off = off;
+      walkcnt_ += 1;
       if (!read_record(&rec, rbuf)) return false;
       if (rec.psiz == UINT16MAX) {
         set_error(_KCCODELINE_, Error::BROKEN, "free block in the chain");
@@ -1899,6 +1919,7 @@ class HashDB : public BasicDB {
           }
           const char* vbuf = rec.vbuf;
           size_t vsiz = rec.vsiz;
+          rdcnt_ += 1;
           char* zbuf = NULL;
           size_t zsiz = 0;
           if (comp_) {
@@ -2710,7 +2731,7 @@ class HashDB : public BasicDB {
     db.tune_fbp(fpow_);
     db.tune_options(opts_);
     db.tune_buckets(bnum_);
-    db.tune_map(msiz_);
+    db.tune_map(msiz_, mcap_);
     if (embcomp_) db.tune_compressor(embcomp_);
     const std::string& npath = path + File::EXTCHR + KCHDBTMPPATHEXT;
     if (db.open(npath, OWRITER | OCREATE | OTRUNCATE)) {
@@ -2985,6 +3006,7 @@ class HashDB : public BasicDB {
              (long long)psiz_, (long long)rec->off, (long long)rsiz, (long long)file_.size());
       return false;
     }
+    rdsize_ += rsiz;
     const char* rp = rbuf;
     uint16_t snum;
     if (*(uint8_t*)rp == RECMAGIC) {
@@ -3125,6 +3147,7 @@ class HashDB : public BasicDB {
       delete[] bbuf;
       return false;
     }
+    rdsize_ += bsiz;
     if (rec->psiz > 0 && ((uint8_t*)bbuf)[bsiz-1] != PADMAGIC) {
       set_error(_KCCODELINE_, Error::BROKEN, "invalid magic data of a record");
       report_binary(_KCCODELINE_, Logger::WARN, "bbuf", bbuf, bsiz);
@@ -3168,6 +3191,7 @@ class HashDB : public BasicDB {
       *wp = PADMAGIC;
       wp += rec->psiz;
     }
+    wrsize_ += rec->rsiz;
     bool err = false;
     if (over) {
       if (!file_.write_fast(rec->off, rbuf, rec->rsiz)) {
@@ -3808,7 +3832,7 @@ class HashDB : public BasicDB {
   /** The flag for open. */
   bool flagopen_;
   /** The record number. */
-  AtomicInt64 count_;
+  ShardedInt64 count_;
   /** The logical size of the file. */
   AtomicInt64 lsiz_;
   /** The physical size of the file. */
@@ -3817,6 +3841,8 @@ class HashDB : public BasicDB {
   char opaque_[HEADSIZ-MOFFOPAQUE];
   /** The size of the internal memory-mapped region. */
   int64_t msiz_;
+  /** The maximum size of the internal memory-mapped region. */
+  int64_t mcap_;
   /** The unit step number of auto defragmentation. */
   int64_t dfunit_;
   /** The embedded data compressor. */
@@ -3851,6 +3877,16 @@ class HashDB : public BasicDB {
   int64_t trcount_;
   /** The size history for transaction. */
   int64_t trsize_;
+  /** The number of records visited. */
+  ShardedInt64 rdcnt_;
+  /** The number of bytes read from the file. */
+  ShardedInt64 rdsize_;
+  /** The number of bytes written into the file. */
+  ShardedInt64 wrsize_;
+  /** The number of records walked in hash chains. */
+  ShardedInt64 walkcnt_;
+  /** The number of waits for the method lock. */
+  ShardedInt64 lockwait_;
 };
 
 
@@ -106,7 +106,8 @@ enum {
   KCOAUTOSYNC = 1 << 5,                  /**< auto synchronization */
   KCONOLOCK = 1 << 6,                    /**< open without locking */
   KCOTRYLOCK = 1 << 7,                   /**< lock without blocking */
-  KCONOREPAIR = 1 << 8                   /**< open without auto repair */
+  KCONOREPAIR = 1 << 8,                  /**< open without auto repair */
+  KCOREADBIAS = 1 << 9                   /**< bias the locking to readers */
 };
 
 
@@ -342,6 +343,7 @@ void kcdbdel(KCDB* db);
  * KCONOLOCK, which means it opens the database file without file locking,
  * KCOTRYLOCK, which means locking is performed without blocking, KCONOREPAIR, which
  * means the database file is not repaired implicitly even if file destruction is detected.
+ * KCOREADBIAS may also be added to bias the lock of the database object to readers.
  * @return true on success, or false on failure.
  * @note The tuning parameter "log" is for the original "tune_logger" and the value specifies
  * the path of the log file, or "-" for the standard output, or "+" for the standard error.
@@ -1372,6 +1372,259 @@ class TinyArrayList {
 };
 
 
+/**
+ * Hierarchical timer wheel of keys.
+ * @note Each key is put in a slot of the wheel by its expiration time in seconds, and keys are
+ * cascaded to the finer levels as the time advances.  Setting, removing, and expiring a key cost
+ * constant time on average.  Keys are identified by their hash values so that the wheel does not
+ * keep copies of them, and keys of the same hash value share one entry.  This class is not
+ * thread-safe.
+ */
+class TimerWheel {
+ public:
+  /**
+   * Constructor.
+   * @param ct the current time.
+   */
+  explicit TimerWheel(int64_t ct) : map_(), cur_(0), wcount_(0) {
+    _assert_(true);
+    clear(ct);
+  }
+  /**
+   * Destructor.
+   */
+  ~TimerWheel() {
+    _assert_(true);
+  }
+  /**
+   * Set the expiration time of a key.
+   * @param hash the hash value of the key.
+   * @param xt the expiration time.
+   * @note If the key already exists, its expiration time is overwritten.
+   */
+  void set(uint64_t hash, int64_t xt) {
+    _assert_(true);
+    std::pair<EntryMap::iterator, bool> res = map_.insert(std::make_pair(hash, Entry()));
+    Entry* ent = &res.first->second;
+    if (res.second) {
+      ent->hash = hash;
+    } else {
+      unlink(ent);
+    }
+    ent->xt = xt;
+    place(ent);
+  }
+  /**
+   * Remove a key.
+   * @param hash the hash value of the key.
+   * @return true on success, or false if the key does not exist.
+   */
+  bool remove(uint64_t hash) {
+    _assert_(true);
+    EntryMap::iterator it = map_.find(hash);
+    if (it == map_.end()) return false;
+    unlink(&it->second);
+    map_.erase(it);
+    return true;
+  }
+  /**
+   * Advance the time and take out expired keys.
+   * @param ct the current time.  Keys whose expiration time is less than it are expired.
+   * @param max the maximum number of keys to be taken out.
+   * @param hashes a vector to contain the hash values of the expired keys.
+   * @return the number of the expired keys.
+   */
+  size_t expire(int64_t ct, size_t max, std::vector<uint64_t>* hashes) {
+    _assert_(hashes);
+    advance(ct - 1);
+    size_t num = 0;
+    while (num < max && ready_.next != &ready_) {
+      Entry* ent = ready_.next;
+      unlink(ent);
+      hashes->push_back(ent->hash);
+      map_.erase(ent->hash);
+      num++;
+    }
+    return num;
+  }
+  /**
+   * Get the time from which the expire method takes out a key.
+   * @return the earliest time when the expire method takes out a key or cascades keys towards
+   * the finer levels, or INT64MAX if there is no key.
+   * @note This costs no more than scanning the slots of the finest level, so that a timer can
+   * call it to decide whether the expire method should be called.
+   */
+  int64_t deadline() {
+    _assert_(true);
+    if (ready_.next != &ready_) return cur_ + 1;
+    int64_t dl = INT64MAX;
+    if (wcount_ > lcounts_[0]) dl = (((cur_ >> SLOTBITS) + 1) << SLOTBITS) + 1;
+    if (lcounts_[0] > 0) {
+      for (int64_t t = cur_ + 1; t < dl && t <= cur_ + SLOTNUM; t++) {
+        const Entry* head = &slots_[0][t&(SLOTNUM-1)];
+        if (head->next != head) return t + 1;
+      }
+    }
+    return dl;
+  }
+  /**
+   * Remove all keys.
+   * @param ct the current time.
+   */
+  void clear(int64_t ct) {
+    _assert_(true);
+    map_.clear();
+    for (int32_t i = 0; i < LEVELNUM; i++) {
+      for (int32_t j = 0; j < SLOTNUM; j++) {
+        Entry* head = &slots_[i][j];
+        head->prev = head;
+        head->next = head;
+      }
+      lcounts_[i] = 0;
+    }
+    far_.prev = &far_;
+    far_.next = &far_;
+    lcounts_[LEVELNUM] = 0;
+    ready_.prev = &ready_;
+    ready_.next = &ready_;
+    cur_ = ct - 1;
+    wcount_ = 0;
+  }
+  /**
+   * Get the number of keys.
+   * @return the number of keys.
+   */
+  size_t count() {
+    _assert_(true);
+    return map_.size();
+  }
+ private:
+  /**
+   * Key entry.
+   */
+  struct Entry {
+    uint64_t hash;                       ///< hash value of the key
+    int64_t xt;                          ///< expiration time
+    int32_t level;                       ///< level of the wheel, or -1 if expired
+    Entry* prev;                         ///< previous entry
+    Entry* next;                         ///< next entry
+  };
+  /** An alias of the map of key entries. */
+  typedef std::unordered_map<uint64_t, Entry> EntryMap;
+  /** The number of levels of the wheel. */
+  static const int32_t LEVELNUM = 4;
+  /** The number of bits of the slot index of each level. */
+  static const int32_t SLOTBITS = 8;
+  /** The number of slots of each level. */
+  static const int32_t SLOTNUM = 1 << SLOTBITS;
+  /**
+   * Put an entry into the slot for its expiration time.
+   * @param ent the entry.
+   */
+  void place(Entry* ent) {
+    _assert_(ent);
+    int64_t delta = ent->xt - cur_;
+    Entry* head = &ready_;
+    int32_t level = -1;
+    if (delta > 0) {
+      level = 0;
+      while (level < LEVELNUM && delta >= (int64_t)1 << (SLOTBITS * (level + 1))) {
+        level++;
+      }
+      head = level < LEVELNUM ?
+          &slots_[level][(ent->xt >> (SLOTBITS * level)) & (SLOTNUM - 1)] : &far_;
+      lcounts_[level]++;
+      wcount_++;
+    }
+    ent->level = level;
+    ent->prev = head->prev;
+    ent->next = head;
+    head->prev->next = ent;
+    head->prev = ent;
+  }
+  /**
+   * Take an entry out of its slot.
+   * @param ent the entry.
+   */
+  void unlink(Entry* ent) {
+    _assert_(ent);
+    ent->prev->next = ent->next;
+    ent->next->prev = ent->prev;
+    if (ent->level >= 0) {
+      lcounts_[ent->level]--;
+      wcount_--;
+    }
+  }
+  /**
+   * Move all entries in a slot into the slots for their expiration times.
+   * @param level the level of the slot, or the number of levels for entries beyond the wheel.
+   * @param sidx the index of the slot.
+   */
+  void cascade(int32_t level, size_t sidx) {
+    _assert_(level >= 0 && level <= LEVELNUM);
+    Entry* head = level < LEVELNUM ? &slots_[level][sidx] : &far_;
+    Entry* ent = head->next;
+    head->prev = head;
+    head->next = head;
+    while (ent != head) {
+      Entry* next = ent->next;
+      lcounts_[level]--;
+      wcount_--;
+      place(ent);
+      ent = next;
+    }
+  }
+  /**
+   * Advance the current time.
+   * @param ct the new current time.
+   */
+  void advance(int64_t ct) {
+    _assert_(true);
+    while (cur_ < ct) {
+      if (wcount_ < 1) {
+        cur_ = ct;
+        break;
+      }
+      int32_t level = 0;
+      while (level < LEVELNUM && lcounts_[level] < 1) {
+        level++;
+      }
+      if (level > 0) {
+        int64_t next = cur_ | (((int64_t)1 << (SLOTBITS * level)) - 1);
+        if (next >= ct) {
+          cur_ = ct;
+          break;
+        }
+        cur_ = next;
+      }
+      cur_++;
+      for (int32_t i = LEVELNUM; i >= 0; i--) {
+        if (cur_ & (((int64_t)1 << (SLOTBITS * i)) - 1)) continue;
+        cascade(i, i < LEVELNUM ? (cur_ >> (SLOTBITS * i)) & (SLOTNUM - 1) : 0);
+      }
+    }
+  }
+  /** Dummy constructor to forbid the use. */
+  TimerWheel(const TimerWheel&);
+  /** Dummy Operator to forbid the use. */
+  TimerWheel& operator =(const TimerWheel&);
+  /** The map of key entries. */
+  EntryMap map_;
+  /** The slots of each level. */
+  Entry slots_[LEVELNUM][SLOTNUM];
+  /** The list of entries beyond the wheel. */
+  Entry far_;
+  /** The list of expired entries. */
+  Entry ready_;
+  /** The numbers of entries of each level. */
+  int64_t lcounts_[LEVELNUM+1];
+  /** The last time whose entries have been expired. */
+  int64_t cur_;
+  /** The number of entries in the wheel. */
+  int64_t wcount_;
+};
+
+
 }                                        // common namespace
 
 #endif                                   // duplication check
@@ -0,0 +1,1616 @@
+/*************************************************************************************************
+ * Merging database
+ *                                                               Copyright (C) 2009-2012 FAL Labs
+ * This file is part of Kyoto Cabinet.
+ * This program is free software: you can redistribute it and/or modify it under the terms of
+ * the GNU General Public License as published by the Free Software Foundation, either version
+ * 3 of the License, or any later version.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************************************/
+
+
+#ifndef _KCMERGEDB_H                     // duplication check
+#define _KCMERGEDB_H
+
+#include <kccommon.h>
+#include <kcutil.h>
+#include <kcthread.h>
+#include <kcfile.h>
+#include <kccompress.h>
+#include <kccompare.h>
+#include <kcmap.h>
+#include <kcregex.h>
+#include <kcdb.h>
+
+#define KCMDBPATHEXT  "mlog"             ///< extension of the operand log file
+
+namespace kyotocabinet {                 // common namespace
+
+
+/**
+ * Merging database.
+ * @note This class is a concrete class to merge operands into records lazily over an arbitrary
+ * database.  The inner database is registered by the MergeDB::set_inner method before the
+ * database is opened.  Operands given by the MergeDB::merge method are folded into each other
+ * on memory and they are merged into the records of the inner database when the records are
+ * visited, when the database is defragmented, or when too many operands are pending.  Pending
+ * operands are merged before any operation on the whole database, including cursor positioning
+ * and transactions.  If the inner database is stored in a file or a directory, each operand is
+ * appended to an operand log in a sidecar file before it is accepted, and so is the new value of
+ * each record which the log refers to.  The log is replayed when the database is opened as a
+ * writer, so that operands survive an abnormal termination.  It is cleared whenever all pending
+ * operands are merged and the inner database is synchronized.  Only operands of the built-in
+ * merge operators and of the operators registered by the MergeDB::tune_operator method are
+ * kept pending.  The others are merged immediately.
+ */
+class MergeDB : public BasicDB {
+ public:
+  class Cursor;
+ private:
+  struct Operand;
+  struct Slot;
+  class ProxyVisitor;
+  class MergeVisitor;
+  /** An alias of map of pending operands. */
+  typedef std::map<std::string, Operand> OperandMap;
+  /** An alias of map of registered merge operators. */
+  typedef std::map<MergeOperator*, int32_t> OperatorMap;
+  /** The number of slots of pending operands. */
+  static const int32_t SLOTNUM = 64;
+  /** The default maximum number of pending operands. */
+  static const int64_t DEFOPMAX = 4096;
+  /** The size of the operand log to cause merging all operands. */
+  static const int64_t LOGCAPSIZ = 1LL << 26;
+  /** The number of records merged at once. */
+  static const size_t FLUSHUNIT = 1024;
+  /** The size of the buffer of a log record on the stack. */
+  static const size_t LOGBUFSIZ = 1024;
+  /** The threshold of busy loop and sleep for locking. */
+  static const uint32_t LOCKBUSYLOOP = 8192;
+  /** The maximum identifier of merge operators. */
+  static const int32_t OPIDMAX = 255;
+ public:
+  /**
+   * Identifiers of merge operators in the operand log.
+   */
+  enum OperatorID {
+    OPINTADD = 1,                        ///< the prepared operator to add integers
+    OPDOUBLEADD = 2,                     ///< the prepared operator to add real numbers
+    OPAPPEND = 3,                        ///< the prepared operator to append operands
+    OPMAXIMUM = 4,                       ///< the prepared operator to keep the maximum
+    OPUSER = 64                          ///< the minimum identifier of user-defined operators
+  };
+  /**
+   * Cursor to indicate a record.
+   */
+  class Cursor : public BasicDB::Cursor {
+    friend class MergeDB;
+   public:
+    /**
+     * Constructor.
+     * @param db the container database object.
+     */
+    explicit Cursor(MergeDB* db) : db_(db), cur_(NULL) {
+      _assert_(db);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->db_) cur_ = db_->db_->cursor();
+    }
+    /**
+     * Destructor.
+     */
+    virtual ~Cursor() {
+      _assert_(true);
+      delete cur_;
+    }
+    /**
+     * Accept a visitor to the current record.
+     * @param visitor a visitor object.
+     * @param writable true for writable operation, or false for read-only operation.
+     * @param step true to move the cursor to the next record, or false for no move.
+     * @return true on success, or false on failure.
+     * @note The operation for each record is performed atomically and other threads accessing
+     * the same record are blocked.  To avoid deadlock, any explicit database operation must not
+     * be performed in this function.
+     */
+    bool accept(Visitor* visitor, bool writable = true, bool step = false) {
+      _assert_(visitor);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0 || !cur_) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      ProxyVisitor proxy(db_, visitor, writable);
+      if (!cur_->accept(&proxy, writable, step)) {
+        db_->copy_error(cur_->db());
+        return false;
+      }
+      return !proxy.error();
+    }
+    /**
+     * Jump the cursor to the first record for forward scan.
+     * @return true on success, or false on failure.
+     */
+    bool jump() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0 || !cur_) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (!db_->flush_operands()) return false;
+      if (!cur_->jump()) {
+        db_->copy_error(cur_->db());
+        return false;
+      }
+      return true;
+    }
+    /**
+     * Jump the cursor to a record for forward scan.
+     * @param kbuf the pointer to the key region.
+     * @param ksiz the size of the key region.
+     * @return true on success, or false on failure.
+     */
+    bool jump(const char* kbuf, size_t ksiz) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0 || !cur_) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (!db_->flush_operands()) return false;
+      if (!cur_->jump(kbuf, ksiz)) {
+        db_->copy_error(cur_->db());
+        return false;
+      }
+      return true;
+    }
+    /**
+     * Jump the cursor to a record for forward scan.
+     * @note Equal to the original Cursor::jump method except that the parameter is std::string.
+     */
+    bool jump(const std::string& key) {
+      _assert_(true);
+      return jump(key.c_str(), key.size());
+    }
+    /**
+     * Jump the cursor to the last record for backward scan.
+     * @return true on success, or false on failure.
+     * @note This method is dedicated to tree databases.  Some database types, especially hash
+     * databases, may provide a dummy implementation.
+     */
+    bool jump_back() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0 || !cur_) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (!db_->flush_operands()) return false;
+      if (!cur_->jump_back()) {
+        db_->copy_error(cur_->db());
+        return false;
+      }
+      return true;
+    }
+    /**
+     * Jump the cursor to a record for backward scan.
+     * @param kbuf the pointer to the key region.
+     * @param ksiz the size of the key region.
+     * @return true on success, or false on failure.
+     * @note This method is dedicated to tree databases.  Some database types, especially hash
+     * databases, will provide a dummy implementation.
+     */
+    bool jump_back(const char* kbuf, size_t ksiz) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0 || !cur_) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (!db_->flush_operands()) return false;
+      if (!cur_->jump_back(kbuf, ksiz)) {
+        db_->copy_error(cur_->db());
+        return false;
+      }
+      return true;
+    }
+    /**
+     * Jump the cursor to a record for backward scan.
+     * @note Equal to the original Cursor::jump_back method except that the parameter is
+     * std::string.
+     */
+    bool jump_back(const std::string& key) {
+      _assert_(true);
+      return jump_back(key.c_str(), key.size());
+    }
+    /**
+     * Step the cursor to the next record.
+     * @return true on success, or false on failure.
+     */
+    bool step() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0 || !cur_) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (!cur_->step()) {
+        db_->copy_error(cur_->db());
+        return false;
+      }
+      return true;
+    }
+    /**
+     * Step the cursor to the previous record.
+     * @return true on success, or false on failure.
+     * @note This method is dedicated to tree databases.  Some database types, especially hash
+     * databases, may provide a dummy implementation.
+     */
+    bool step_back() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0 || !cur_) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (!cur_->step_back()) {
+        db_->copy_error(cur_->db());
+        return false;
+      }
+      return true;
+    }
+    /**
+     * Get the database object.
+     * @return the database object.
+     */
+    MergeDB* db() {
+      _assert_(true);
+      return db_;
+    }
+   private:
+    /** Dummy constructor to forbid the use. */
+    Cursor(const Cursor&);
+    /** Dummy Operator to forbid the use. */
+    Cursor& operator =(const Cursor&);
+    /** The inner database. */
+    MergeDB* db_;
+    /** The cursor of the inner database. */
+    BasicDB::Cursor* cur_;
+  };
+  /**
+   * Default constructor.
+   */
+  explicit MergeDB() :
+      mlock_(), slots_(), error_(), logger_(NULL), logkinds_(0), mtrigger_(NULL), omode_(0),
+      tran_(false), db_(NULL), dpath_(""), path_(""), opids_(), opmax_(DEFOPMAX), opcnt_(0),
+      mlog_(), lpath_(""), mergecnt_(0), foldcnt_(0), failcnt_(0), flushcnt_(0) {
+    _assert_(true);
+  }
+  /**
+   * Destructor.
+   * @note If the database is not closed, it is closed implicitly.  The inner database is
+   * deleted.
+   */
+  virtual ~MergeDB() {
+    _assert_(true);
+    if (omode_ != 0) close();
+    delete db_;
+  }
+  /**
+   * Set the inner database.
+   * @param db the inner database object.  Its possession is transferred inside and the object
+   * is deleted automatically.
+   * @param path the path of the inner database, which is given to its open method.
+   * @return true on success, or false on failure.
+   */
+  bool set_inner(BasicDB* db, const std::string& path) {
+    _assert_(db);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    delete db_;
+    db_ = db;
+    dpath_ = path;
+    return true;
+  }
+  /**
+   * Accept a visitor to a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @return true on success, or false on failure.
+   * @note The visitor is given the value into which the pending operand of the record is
+   * merged.  In a writable operation, the merged value is stored unless the visitor returns
+   * another value.  To avoid deadlock, any explicit database operation must not be performed in
+   * this function.
+   */
+  bool accept(const char* kbuf, size_t ksiz, Visitor* visitor, bool writable = true) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    ProxyVisitor proxy(this, visitor, writable);
+    if (!db_->accept(kbuf, ksiz, &proxy, writable)) {
+      copy_error(db_);
+      return false;
+    }
+    return !proxy.error();
+  }
+  /**
+   * Accept a visitor to multiple records at once.
+   * @param keys specifies a string vector of the keys.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @return true on success, or false on failure.
+   * @note The operations for specified records are performed atomically and other threads
+   * accessing the same records are blocked.  To avoid deadlock, any explicit database operation
+   * must not be performed in this function.
+   */
+  bool accept_bulk(const std::vector<std::string>& keys, Visitor* visitor,
+                   bool writable = true) {
+    _assert_(visitor);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    ProxyVisitor proxy(this, visitor, writable);
+    if (!db_->accept_bulk(keys, &proxy, writable)) {
+      copy_error(db_);
+      return false;
+    }
+    return !proxy.error();
+  }
+  /**
+   * Iterate to accept a visitor for each record.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note The whole iteration is performed atomically and other threads are blocked.  To avoid
+   * deadlock, any explicit database operation must not be performed in this function.
+   */
+  bool iterate(Visitor *visitor, bool writable = true, ProgressChecker* checker = NULL) {
+    _assert_(visitor);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!checkpoint()) return false;
+    if (!db_->iterate(visitor, writable, checker)) {
+      copy_error(db_);
+      return false;
+    }
+    trigger_meta(MetaTrigger::ITERATE, "iterate");
+    return true;
+  }
+  /**
+   * Scan each record in parallel.
+   * @param visitor a visitor object.
+   * @param thnum the number of worker threads.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note This function is for reading records and not for updating ones.  The return value of
+   * the visitor is just ignored.  To avoid deadlock, any explicit database operation must not
+   * be performed in this function.
+   */
+  bool scan_parallel(Visitor *visitor, size_t thnum, ProgressChecker* checker = NULL) {
+    _assert_(visitor && thnum <= MEMMAXSIZ);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!flush_operands()) return false;
+    if (!db_->scan_parallel(visitor, thnum, checker)) {
+      copy_error(db_);
+      return false;
+    }
+    trigger_meta(MetaTrigger::ITERATE, "scan_parallel");
+    return true;
+  }
+  /**
+   * Merge an operand into the value of a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param obuf the pointer to the operand region.
+   * @param osiz the size of the operand region.
+   * @param op the merge operator.
+   * @return true on success, or false on failure.
+   * @note The operand is folded into the pending operand of the record and it is merged into
+   * the record later.  The operand is merged into the record immediately if the operator is
+   * neither a built-in one nor a registered one, if the pending operand was given with another
+   * operator, or if the database is in a transaction.  An operand which can not be merged into
+   * the existing value later is dropped with an error message in the log.
+   */
+  bool merge(const char* kbuf, size_t ksiz, const char* obuf, size_t osiz, MergeOperator* op) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && obuf && osiz <= MEMMAXSIZ && op);
+    bool full = false;
+    {
+      ScopedRWLock lock(&mlock_, false);
+      if (omode_ == 0) {
+        set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (!(omode_ & OWRITER)) {
+        set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+        return false;
+      }
+      mergecnt_.add(1);
+      int32_t opid = tran_ ? -1 : operator_id(op);
+      bool pended = false;
+      if (opid > 0 && !pend_operand(kbuf, ksiz, obuf, osiz, op, opid, &pended)) return false;
+      if (pended) {
+        full = opcnt_.get() >= opmax_ || (!lpath_.empty() && mlog_.size() >= LOGCAPSIZ);
+      } else {
+        MergeVisitor visitor(obuf, osiz, op);
+        ProxyVisitor proxy(this, &visitor, true);
+        if (!db_->accept(kbuf, ksiz, &proxy, true)) {
+          copy_error(db_);
+          return false;
+        }
+        if (proxy.error()) return false;
+        if (visitor.error()) {
+          set_error(_KCCODELINE_, Error::LOGIC, "logical inconsistency");
+          return false;
+        }
+      }
+    }
+    if (full) {
+      ScopedRWLock lock(&mlock_, true);
+      if (omode_ != 0 && !checkpoint()) return false;
+    }
+    return true;
+  }
+  /**
+   * Merge an operand into the value of a record.
+   * @note Equal to the original MergeDB::merge method except that the parameters are
+   * std::string.
+   */
+  bool merge(const std::string& key, const std::string& operand, MergeOperator* op) {
+    _assert_(op);
+    return merge(key.c_str(), key.size(), operand.c_str(), operand.size(), op);
+  }
+  /**
+   * Get the last happened error.
+   * @return the last happened error.
+   */
+  Error error() const {
+    _assert_(true);
+    return error_;
+  }
+  /**
+   * Set the error information.
+   * @param file the file name of the program source code.
+   * @param line the line number of the program source code.
+   * @param func the function name of the program source code.
+   * @param code an error code.
+   * @param message a supplement message.
+   */
+  void set_error(const char* file, int32_t line, const char* func,
+                 Error::Code code, const char* message) {
+    _assert_(file && line > 0 && func && message);
+    error_->set(code, message);
+    if (logger_) {
+      Logger::Kind kind = code == Error::BROKEN || code == Error::SYSTEM ?
+          Logger::ERROR : Logger::INFO;
+      if (kind & logkinds_)
+        report(file, line, func, kind, "%d: %s: %s", code, Error::codename(code), message);
+    }
+  }
+  /**
+   * Open a database file.
+   * @param path the path of the whole database, which is used only for identification.
+   * @param mode the connection mode, which is given to the inner database.
+   * @return true on success, or false on failure.
+   * @note The operand log is kept only if the inner database is stored in a file or a
+   * directory.  If the log is not empty, it is replayed on the inner database when it is opened
+   * as a writer, and it is ignored when it is opened as a reader.
+   */
+  bool open(const std::string& path, uint32_t mode = OWRITER | OCREATE) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    if (!db_) {
+      set_error(_KCCODELINE_, Error::INVALID, "no inner database");
+      return false;
+    }
+    report(_KCCODELINE_, Logger::DEBUG, "opening the database (path=%s)", path.c_str());
+    if (!db_->open(dpath_, mode)) {
+      copy_error(db_);
+      return false;
+    }
+    class FileProcessorImpl : public FileProcessor {
+     public:
+      explicit FileProcessorImpl() : stored_(false) {}
+      bool stored() {
+        return stored_;
+      }
+     private:
+      bool process(const std::string& path, int64_t count, int64_t size) {
+        if (!path.empty() && File::status(path)) stored_ = true;
+        return true;
+      }
+      bool stored_;
+    };
+    FileProcessorImpl proc;
+    if (!db_->synchronize(false, &proc)) {
+      copy_error(db_);
+      db_->close();
+      return false;
+    }
+    lpath_.clear();
+    if (proc.stored()) lpath_ = db_->path() + File::EXTCHR + KCMDBPATHEXT;
+    if (!lpath_.empty()) {
+      if (mode & OWRITER) {
+        uint32_t fmode = File::OWRITER | File::OCREATE;
+        if (mode & OTRUNCATE) fmode |= File::OTRUNCATE;
+        if (mode & ONOLOCK) fmode |= File::ONOLOCK;
+        if (mode & OTRYLOCK) fmode |= File::OTRYLOCK;
+        if (!mlog_.open(lpath_, fmode, 0)) {
+          set_error(_KCCODELINE_, Error::SYSTEM, mlog_.error());
+          db_->close();
+          return false;
+        }
+        if (!replay_log()) {
+          mlog_.close();
+          db_->close();
+          return false;
+        }
+      } else {
+        File::Status sbuf;
+        if (File::status(lpath_, &sbuf) && sbuf.size > 0)
+          report(_KCCODELINE_, Logger::WARN, "the operand log is ignored by a reader");
+        lpath_.clear();
+      }
+    }
+    omode_ = mode;
+    tran_ = false;
+    path_ = path;
+    trigger_meta(MetaTrigger::OPEN, "open");
+    return true;
+  }
+  /**
+   * Close the database file.
+   * @return true on success, or false on failure.
+   * @note Pending operands are merged into the records beforehand.  The operand log is removed
+   * after the inner database is closed successfully.
+   */
+  bool close() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    report(_KCCODELINE_, Logger::DEBUG, "closing the database (path=%s)", path_.c_str());
+    bool err = false;
+    if (tran_ && !db_->end_transaction(false)) {
+      copy_error(db_);
+      err = true;
+    }
+    tran_ = false;
+    if (!flush_operands()) err = true;
+    if (!db_->close()) {
+      copy_error(db_);
+      err = true;
+    }
+    if (!lpath_.empty()) {
+      if (!mlog_.close()) {
+        set_error(_KCCODELINE_, Error::SYSTEM, mlog_.error());
+        err = true;
+      }
+      if (!err && !File::remove(lpath_)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, "removing the operand log failed");
+        err = true;
+      }
+    }
+    clear_operands();
+    omode_ = 0;
+    path_.clear();
+    lpath_.clear();
+    trigger_meta(MetaTrigger::CLOSE, "close");
+    return !err;
+  }
+  /**
+   * Synchronize updated contents with the file and the device.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @param proc a postprocessor object.  If it is NULL, no postprocessing is performed.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note Pending operands are merged into the records beforehand and the operand log is
+   * cleared afterwards.
+   */
+  bool synchronize(bool hard = false, FileProcessor* proc = NULL,
+                   ProgressChecker* checker = NULL) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    bool err = false;
+    if (!flush_operands()) err = true;
+    if (!db_->synchronize(hard, proc, checker)) {
+      copy_error(db_);
+      err = true;
+    }
+    if (!err && !reset_log()) err = true;
+    trigger_meta(MetaTrigger::SYNCHRONIZE, "synchronize");
+    return !err;
+  }
+  /**
+   * Occupy database by locking and do something meanwhile.
+   * @param writable true to use writer lock, or false to use reader lock.
+   * @param proc a processor object.  If it is NULL, no processing is performed.
+   * @return true on success, or false on failure.
+   * @note The operation of the processor is performed atomically and other threads accessing
+   * the same record are blocked.  To avoid deadlock, any explicit database operation must not
+   * be performed in this function.
+   */
+  bool occupy(bool writable = true, FileProcessor* proc = NULL) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, writable);
+    bool err = false;
+    if (omode_ != 0 && !(writable ? checkpoint() : flush_operands())) err = true;
+    if (proc && !proc->process(path_, count_impl(), size_impl())) {
+      set_error(_KCCODELINE_, Error::LOGIC, "processing failed");
+      err = true;
+    }
+    trigger_meta(MetaTrigger::OCCUPY, "occupy");
+    return !err;
+  }
+  /**
+   * Perform defragmentation of the file.
+   * @param step the number of steps.  If it is not more than 0, the whole region is defraged.
+   * @return true on success, or false on failure.
+   * @note Pending operands are merged into the records beforehand.
+   */
+  bool defrag(int64_t step = 0) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!flush_operands()) return false;
+    if (!db_->defrag(step)) {
+      copy_error(db_);
+      return false;
+    }
+    return true;
+  }
+  /**
+   * Begin transaction.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @return true on success, or false on failure.
+   * @note Pending operands are merged into the records beforehand and operands given in the
+   * transaction are merged immediately.
+   */
+  bool begin_transaction(bool hard = false) {
+    _assert_(true);
+    uint32_t wcnt = 0;
+    while (true) {
+      mlock_.lock_writer();
+      if (omode_ == 0) {
+        set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        mlock_.unlock();
+        return false;
+      }
+      if (!(omode_ & OWRITER)) {
+        set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+        mlock_.unlock();
+        return false;
+      }
+      if (!tran_) break;
+      mlock_.unlock();
+      if (wcnt >= LOCKBUSYLOOP) {
+        Thread::chill();
+      } else {
+        Thread::yield();
+        wcnt++;
+      }
+    }
+    if (!checkpoint()) {
+      mlock_.unlock();
+      return false;
+    }
+    if (!db_->begin_transaction(hard)) {
+      copy_error(db_);
+      mlock_.unlock();
+      return false;
+    }
+    tran_ = true;
+    trigger_meta(MetaTrigger::BEGINTRAN, "begin_transaction");
+    mlock_.unlock();
+    return true;
+  }
+  /**
+   * Try to begin transaction.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @return true on success, or false on failure.
+   */
+  bool begin_transaction_try(bool hard = false) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!(omode_ & OWRITER)) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    if (tran_) {
+      set_error(_KCCODELINE_, Error::LOGIC, "competition avoided");
+      return false;
+    }
+    if (!checkpoint()) return false;
+    if (!db_->begin_transaction_try(hard)) {
+      copy_error(db_);
+      return false;
+    }
+    tran_ = true;
+    trigger_meta(MetaTrigger::BEGINTRAN, "begin_transaction_try");
+    return true;
+  }
+  /**
+   * End transaction.
+   * @param commit true to commit the transaction, or false to abort the transaction.
+   * @return true on success, or false on failure.
+   */
+  bool end_transaction(bool commit = true) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!tran_) {
+      set_error(_KCCODELINE_, Error::INVALID, "not in transaction");
+      return false;
+    }
+    bool err = false;
+    if (!db_->end_transaction(commit)) {
+      copy_error(db_);
+      err = true;
+    }
+    tran_ = false;
+    trigger_meta(commit ? MetaTrigger::COMMITTRAN : MetaTrigger::ABORTTRAN, "end_transaction");
+    return !err;
+  }
+  /**
+   * Remove all records.
+   * @return true on success, or false on failure.
+   * @note Pending operands are discarded.
+   */
+  bool clear() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!reset_log()) return false;
+    if (!db_->clear()) {
+      copy_error(db_);
+      return false;
+    }
+    trigger_meta(MetaTrigger::CLEAR, "clear");
+    return true;
+  }
+  /**
+   * Get the number of records.
+   * @return the number of records, or -1 on failure.
+   * @note Pending operands are merged into the records beforehand.
+   */
+  int64_t count() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return -1;
+    }
+    if (!flush_operands()) return -1;
+    return count_impl();
+  }
+  /**
+   * Get the size of the database file.
+   * @return the size of the database file in bytes, or -1 on failure.
+   * @note Pending operands are merged into the records beforehand.
+   */
+  int64_t size() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return -1;
+    }
+    if (!flush_operands()) return -1;
+    return size_impl();
+  }
+  /**
+   * Get the path of the database file.
+   * @return the path of the database file, or an empty string on failure.
+   */
+  std::string path() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return "";
+    }
+    return path_;
+  }
+  /**
+   * Get the miscellaneous status information.
+   * @param strmap a string map to contain the result.
+   * @return true on success, or false on failure.
+   * @note The status of the inner database is reported together with the numbers of merged and
+   * pending operands and the size of the operand log.
+   */
+  bool status(std::map<std::string, std::string>* strmap) {
+    _assert_(strmap);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!flush_operands()) return false;
+    if (!db_->status(strmap)) {
+      copy_error(db_);
+      return false;
+    }
+    (*strmap)["path"] = path_;
+    (*strmap)["merge_max"] = strprintf("%lld", (long long)opmax_);
+    (*strmap)["merge_pending"] = strprintf("%lld", (long long)opcnt_.get());
+    (*strmap)["merge_count"] = strprintf("%lld", (long long)mergecnt_.get());
+    (*strmap)["merge_folded"] = strprintf("%lld", (long long)foldcnt_.get());
+    (*strmap)["merge_failed"] = strprintf("%lld", (long long)failcnt_.get());
+    (*strmap)["merge_flush"] = strprintf("%lld", (long long)flushcnt_.get());
+    (*strmap)["merge_log"] = lpath_;
+    int64_t lsiz = lpath_.empty() ? 0 : mlog_.size();
+    (*strmap)["merge_logsize"] = strprintf("%lld", (long long)lsiz);
+    return true;
+  }
+  /**
+   * Create a cursor object.
+   * @return the return value is the created cursor object.
+   * @note Because the object of the return value is allocated by the constructor, it should be
+   * released with the delete operator when it is no longer in use.
+   */
+  Cursor* cursor() {
+    _assert_(true);
+    return new Cursor(this);
+  }
+  /**
+   * Write a log message.
+   * @param file the file name of the program source code.
+   * @param line the line number of the program source code.
+   * @param func the function name of the program source code.
+   * @param kind the kind of the event.  Logger::DEBUG for debugging, Logger::INFO for normal
+   * information, Logger::WARN for warning, and Logger::ERROR for fatal error.
+   * @param message the supplement message.
+   */
+  void log(const char* file, int32_t line, const char* func, Logger::Kind kind,
+           const char* message) {
+    _assert_(file && line > 0 && func && message);
+    ScopedRWLock lock(&mlock_, false);
+    if (!logger_) return;
+    logger_->log(file, line, func, kind, message);
+  }
+  /**
+   * Set the internal logger.
+   * @param logger the logger object.
+   * @param kinds kinds of logged messages by bitwise-or: Logger::DEBUG for debugging,
+   * Logger::INFO for normal information, Logger::WARN for warning, and Logger::ERROR for fatal
+   * error.
+   * @return true on success, or false on failure.
+   */
+  bool tune_logger(Logger* logger, uint32_t kinds = Logger::WARN | Logger::ERROR) {
+    _assert_(logger);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    logger_ = logger;
+    logkinds_ = kinds;
+    return true;
+  }
+  /**
+   * Set the internal meta operation trigger.
+   * @param trigger the trigger object.
+   * @return true on success, or false on failure.
+   */
+  bool tune_meta_trigger(MetaTrigger* trigger) {
+    _assert_(trigger);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    mtrigger_ = trigger;
+    return true;
+  }
+  /**
+   * Set the maximum number of pending operands.
+   * @param max the maximum number of records with pending operands.  If it is not more than 0,
+   * the default value is specified.  The default value is 4096.
+   * @return true on success, or false on failure.
+   */
+  bool tune_operands(int64_t max) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    opmax_ = max > 0 ? max : DEFOPMAX;
+    return true;
+  }
+  /**
+   * Register a user-defined merge operator.
+   * @param id the identifier of the operator in the operand log.  It must be between
+   * MergeDB::OPUSER and 255.
+   * @param op the merge operator.
+   * @return true on success, or false on failure.
+   * @note Operands of a registered operator are kept pending.  The same identifier should be
+   * given to the same operator whenever the database is opened so that the operand log is
+   * replayed correctly.
+   */
+  bool tune_operator(int32_t id, MergeOperator* op) {
+    _assert_(op);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    if (id < OPUSER || id > OPIDMAX || builtin_id(op) > 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "invalid operator identifier");
+      return false;
+    }
+    opids_[op] = id;
+    return true;
+  }
+  /**
+   * Get a built-in merge operator by its identifier.
+   * @param id the identifier of the operator.
+   * @return the prepared pointer of the operator, or NULL if it is not built in.
+   */
+  static MergeOperator* builtin_operator(int32_t id) {
+    _assert_(true);
+    switch (id) {
+      case OPINTADD: return INTADDMERGE;
+      case OPDOUBLEADD: return DOUBLEADDMERGE;
+      case OPAPPEND: return APPENDMERGE;
+      case OPMAXIMUM: return MAXMERGE;
+    }
+    return NULL;
+  }
+  /**
+   * Get the identifier of a built-in merge operator.
+   * @param op the merge operator.
+   * @return the identifier of the operator, or -1 if it is not built in.
+   */
+  static int32_t builtin_id(MergeOperator* op) {
+    _assert_(op);
+    if (op == INTADDMERGE) return OPINTADD;
+    if (op == DOUBLEADDMERGE) return OPDOUBLEADD;
+    if (op == APPENDMERGE) return OPAPPEND;
+    if (op == MAXMERGE) return OPMAXIMUM;
+    return -1;
+  }
+ protected:
+  /**
+   * Report a message for debugging.
+   * @param file the file name of the program source code.
+   * @param line the line number of the program source code.
+   * @param func the function name of the program source code.
+   * @param kind the kind of the event.  Logger::DEBUG for debugging, Logger::INFO for normal
+   * information, Logger::WARN for warning, and Logger::ERROR for fatal error.
+   * @param format the printf-like format string.
+   * @param ... used according to the format string.
+   */
+  void report(const char* file, int32_t line, const char* func, Logger::Kind kind,
+              const char* format, ...) {
+    _assert_(file && line > 0 && func && format);
+    if (!logger_ || !(kind & logkinds_)) return;
+    std::string message;
+    strprintf(&message, "%s: ", path_.empty() ? "-" : path_.c_str());
+    va_list ap;
+    va_start(ap, format);
+    vstrprintf(&message, format, ap);
+    va_end(ap);
+    logger_->log(file, line, func, kind, message.c_str());
+  }
+  /**
+   * Trigger a meta database operation.
+   * @param kind the kind of the event.  MetaTrigger::OPEN for opening, MetaTrigger::CLOSE for
+   * closing, MetaTrigger::CLEAR for clearing, MetaTrigger::ITERATE for iteration,
+   * MetaTrigger::SYNCHRONIZE for synchronization, MetaTrigger::BEGINTRAN for beginning
+   * transaction, MetaTrigger::COMMITTRAN for committing transaction, MetaTrigger::ABORTTRAN
+   * for aborting transaction, and MetaTrigger::MISC for miscellaneous operations.
+   * @param message the supplement message.
+   */
+  void trigger_meta(MetaTrigger::Kind kind, const char* message) {
+    _assert_(message);
+    if (mtrigger_) mtrigger_->trigger(kind, message);
+  }
+ private:
+  /**
+   * Kinds of records in the operand log.
+   */
+  enum LogKind {
+    LOPERAND = 0xd1,                     ///< operand
+    LSET,                                ///< new value
+    LREMOVE                              ///< removal
+  };
+  /**
+   * Pending operand.
+   */
+  struct Operand {
+    MergeOperator* op;                   ///< merge operator, or NULL if merged
+    std::string value;                   ///< folded operand
+  };
+  /**
+   * Slot of pending operands.
+   */
+  struct Slot {
+    Mutex lock;                          ///< lock
+    OperandMap ops;                      ///< pending operands
+  };
+  /**
+   * Visitor to merge the pending operand of each record.
+   * @note The pending operand is taken while the record is locked by the inner database so
+   * that other threads never observe the record without it.
+   */
+  class ProxyVisitor : public Visitor {
+   public:
+    /** constructor */
+    explicit ProxyVisitor(MergeDB* db, Visitor* visitor, bool writable) :
+        db_(db), visitor_(visitor), writable_(writable), mbuf_(NULL), err_(false) {}
+    /** destructor */
+    ~ProxyVisitor() {
+      delete[] mbuf_;
+    }
+    /** check the error */
+    bool error() {
+      return err_;
+    }
+   private:
+    const char* visit_full(const char* kbuf, size_t ksiz,
+                           const char* vbuf, size_t vsiz, size_t* sp) {
+      return db_->visit_record(kbuf, ksiz, vbuf, vsiz, visitor_, writable_, sp, &mbuf_, &err_);
+    }
+    const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
+      return db_->visit_record(kbuf, ksiz, NULL, 0, visitor_, writable_, sp, &mbuf_, &err_);
+    }
+    void visit_before() {
+      visitor_->visit_before();
+    }
+    void visit_after() {
+      visitor_->visit_after();
+    }
+    MergeDB* db_;                        ///< database
+    Visitor* visitor_;                   ///< wrapped visitor
+    bool writable_;                      ///< whether writable
+    char* mbuf_;                         ///< merged value
+    bool err_;                           ///< whether failed
+  };
+  /**
+   * Visitor to merge an operand immediately.
+   */
+  class MergeVisitor : public Visitor {
+   public:
+    /** constructor */
+    explicit MergeVisitor(const char* obuf, size_t osiz, MergeOperator* op) :
+        obuf_(obuf), osiz_(osiz), op_(op), nbuf_(NULL), err_(false) {}
+    /** destructor */
+    ~MergeVisitor() {
+      delete[] nbuf_;
+    }
+    /** check the error */
+    bool error() {
+      return err_;
+    }
+   private:
+    const char* visit_full(const char* kbuf, size_t ksiz,
+                           const char* vbuf, size_t vsiz, size_t* sp) {
+      delete[] nbuf_;
+      nbuf_ = op_->merge(vbuf, vsiz, obuf_, osiz_, sp);
+      if (!nbuf_) {
+        err_ = true;
+        return NOP;
+      }
+      return nbuf_;
+    }
+    const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
+      delete[] nbuf_;
+      nbuf_ = op_->merge(NULL, 0, obuf_, osiz_, sp);
+      if (!nbuf_) {
+        err_ = true;
+        return NOP;
+      }
+      return nbuf_;
+    }
+    const char* obuf_;                   ///< operand
+    size_t osiz_;                        ///< size of the operand
+    MergeOperator* op_;                  ///< merge operator
+    char* nbuf_;                         ///< merged value
+    bool err_;                           ///< whether failed
+  };
+  /**
+   * Get the identifier of a merge operator.
+   * @param op the merge operator.
+   * @return the identifier of the operator, or -1 if it is neither built in nor registered.
+   */
+  int32_t operator_id(MergeOperator* op) {
+    _assert_(op);
+    int32_t id = builtin_id(op);
+    if (id > 0) return id;
+    OperatorMap::iterator it = opids_.find(op);
+    return it == opids_.end() ? -1 : it->second;
+  }
+  /**
+   * Get a merge operator by its identifier.
+   * @param id the identifier of the operator.
+   * @return the merge operator, or NULL if it is neither built in nor registered.
+   */
+  MergeOperator* find_operator(int32_t id) {
+    _assert_(true);
+    MergeOperator* op = builtin_operator(id);
+    if (op) return op;
+    OperatorMap::iterator it = opids_.begin();
+    OperatorMap::iterator itend = opids_.end();
+    while (it != itend) {
+      if (it->second == id) return it->first;
+      ++it;
+    }
+    return NULL;
+  }
+  /**
+   * Fold an operand into the pending operand of a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param obuf the pointer to the operand region.
+   * @param osiz the size of the operand region.
+   * @param op the merge operator.
+   * @param opid the identifier of the merge operator.
+   * @param pp the pointer to the variable into which whether the operand is kept pending is
+   * assigned.
+   * @return true on success, or false on failure.
+   */
+  bool pend_operand(const char* kbuf, size_t ksiz, const char* obuf, size_t osiz,
+                    MergeOperator* op, int32_t opid, bool* pp) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && obuf && osiz <= MEMMAXSIZ && op && pp);
+    Slot* slot = slots_ + hashmurmur(kbuf, ksiz) % SLOTNUM;
+    std::string key(kbuf, ksiz);
+    ScopedMutex lock(&slot->lock);
+    OperandMap::iterator it = slot->ops.find(key);
+    char* mbuf = NULL;
+    size_t msiz = 0;
+    if (it != slot->ops.end() && it->second.op) {
+      if (it->second.op != op) return true;
+      const std::string& value = it->second.value;
+      mbuf = op->merge(value.data(), value.size(), obuf, osiz, &msiz);
+      if (!mbuf) {
+        set_error(_KCCODELINE_, Error::LOGIC, "logical inconsistency");
+        return false;
+      }
+    }
+    if (!lpath_.empty() && !write_log(LOPERAND, opid, kbuf, ksiz, obuf, osiz)) {
+      delete[] mbuf;
+      return false;
+    }
+    if (it == slot->ops.end()) {
+      it = slot->ops.insert(std::make_pair(key, Operand())).first;
+      opcnt_.add(1);
+    }
+    Operand& od = it->second;
+    od.op = op;
+    if (mbuf) {
+      od.value.assign(mbuf, msiz);
+      delete[] mbuf;
+    } else {
+      od.value.assign(obuf, osiz);
+    }
+    *pp = true;
+    return true;
+  }
+  /**
+   * Visit a record with its pending operand merged.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param vbuf the pointer to the value region, or NULL if no record corresponds.
+   * @param vsiz the size of the value region.
+   * @param visitor the wrapped visitor.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @param sp the pointer to the variable into which the size of the region of the return
+   * value is assigned.
+   * @param mp the pointer to the variable which holds the region of the merged value.
+   * @param errp the pointer to the variable into which whether an error occurred is assigned.
+   * @return the return value for the inner database.
+   * @note In a writable operation on a record which the operand log refers to, the slot is
+   * locked until the result is logged so that the order of the log follows that of updates.
+   */
+  const char* visit_record(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz,
+                           Visitor* visitor, bool writable, size_t* sp, char** mp, bool* errp) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor && sp && mp && errp);
+    if (opcnt_.get() < 1) return call_visitor(visitor, kbuf, ksiz, vbuf, vsiz, sp);
+    Slot* slot = slots_ + hashmurmur(kbuf, ksiz) % SLOTNUM;
+    std::string key(kbuf, ksiz);
+    slot->lock.lock();
+    OperandMap::iterator it = slot->ops.find(key);
+    if (it == slot->ops.end() || (!writable && !it->second.op)) {
+      slot->lock.unlock();
+      return call_visitor(visitor, kbuf, ksiz, vbuf, vsiz, sp);
+    }
+    if (!writable) {
+      Operand od = it->second;
+      slot->lock.unlock();
+      size_t msiz;
+      char* mbuf = od.op->merge(vbuf, vsiz, od.value.data(), od.value.size(), &msiz);
+      if (mbuf) {
+        delete[] *mp;
+        *mp = mbuf;
+        vbuf = mbuf;
+        vsiz = msiz;
+      }
+      return call_visitor(visitor, kbuf, ksiz, vbuf, vsiz, sp);
+    }
+    Operand& od = it->second;
+    bool merged = false;
+    if (od.op) {
+      size_t msiz;
+      char* mbuf = od.op->merge(vbuf, vsiz, od.value.data(), od.value.size(), &msiz);
+      if (mbuf) {
+        delete[] *mp;
+        *mp = mbuf;
+        vbuf = mbuf;
+        vsiz = msiz;
+        merged = true;
+        foldcnt_.add(1);
+      } else {
+        failcnt_.add(1);
+        report(_KCCODELINE_, Logger::ERROR, "dropping an operand which can not be merged");
+      }
+    }
+    const char* rbuf = call_visitor(visitor, kbuf, ksiz, vbuf, vsiz, sp);
+    if (rbuf == Visitor::NOP && merged) {
+      rbuf = *mp;
+      *sp = vsiz;
+    }
+    if (lpath_.empty()) {
+      slot->ops.erase(it);
+      opcnt_.add(-1);
+    } else {
+      bool err = false;
+      if (rbuf == Visitor::REMOVE) {
+        if (!write_log(LREMOVE, 0, kbuf, ksiz, "", 0)) err = true;
+      } else if (rbuf != Visitor::NOP) {
+        if (!write_log(LSET, 0, kbuf, ksiz, rbuf, *sp)) err = true;
+      } else if (od.op) {
+        if (!(vbuf ? write_log(LSET, 0, kbuf, ksiz, vbuf, vsiz) :
+              write_log(LREMOVE, 0, kbuf, ksiz, "", 0))) err = true;
+      }
+      if (err) {
+        slot->lock.unlock();
+        *errp = true;
+        return Visitor::NOP;
+      }
+      od.op = NULL;
+      od.value.clear();
+    }
+    slot->lock.unlock();
+    return rbuf;
+  }
+  /**
+   * Call the visit method of a visitor.
+   * @param visitor the visitor.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param vbuf the pointer to the value region, or NULL if no record corresponds.
+   * @param vsiz the size of the value region.
+   * @param sp the pointer to the variable into which the size of the region of the return
+   * value is assigned.
+   * @return the return value of the visitor.
+   */
+  static const char* call_visitor(Visitor* visitor, const char* kbuf, size_t ksiz,
+                                  const char* vbuf, size_t vsiz, size_t* sp) {
+    _assert_(visitor && kbuf && ksiz <= MEMMAXSIZ && sp);
+    if (vbuf) return visitor->visit_full(kbuf, ksiz, vbuf, vsiz, sp);
+    return visitor->visit_empty(kbuf, ksiz, sp);
+  }
+  /**
+   * Append a record to the operand log.
+   * @param kind the kind of the record.
+   * @param opid the identifier of the merge operator.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param vbuf the pointer to the region of the operand or the value.
+   * @param vsiz the size of the region of the operand or the value.
+   * @return true on success, or false on failure.
+   */
+  bool write_log(LogKind kind, int32_t opid, const char* kbuf, size_t ksiz,
+                 const char* vbuf, size_t vsiz) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ);
+    size_t rsiz = 2 + sizeof(uint64_t) * 2 + ksiz + vsiz;
+    char stack[LOGBUFSIZ];
+    char* rbuf = rsiz > sizeof(stack) ? new char[rsiz] : stack;
+    char* wp = rbuf;
+    *(wp++) = kind;
+    *(wp++) = opid;
+    wp += writevarnum(wp, ksiz);
+    wp += writevarnum(wp, vsiz);
+    std::memcpy(wp, kbuf, ksiz);
+    wp += ksiz;
+    std::memcpy(wp, vbuf, vsiz);
+    wp += vsiz;
+    bool err = false;
+    if (!mlog_.append(rbuf, wp - rbuf)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, mlog_.error());
+      err = true;
+    }
+    if (rbuf != stack) delete[] rbuf;
+    return !err;
+  }
+  /**
+   * Apply the records of the operand log to the inner database and clear the log.
+   * @return true on success, or false on failure.
+   */
+  bool replay_log() {
+    _assert_(true);
+    int64_t lsiz = mlog_.size();
+    if (lsiz < 1) return true;
+    report(_KCCODELINE_, Logger::WARN, "replaying the operand log (size=%lld)", (long long)lsiz);
+    if (lsiz > (int64_t)MEMMAXSIZ) {
+      set_error(_KCCODELINE_, Error::BROKEN, "too large operand log");
+      return false;
+    }
+    char* lbuf = new char[lsiz];
+    if (!mlog_.read(0, lbuf, lsiz)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, mlog_.error());
+      delete[] lbuf;
+      return false;
+    }
+    bool err = false;
+    int64_t rnum = 0;
+    const char* rp = lbuf;
+    const char* ep = lbuf + lsiz;
+    while (rp < ep) {
+      uint8_t kind = *(uint8_t*)rp;
+      if ((kind != LOPERAND && kind != LSET && kind != LREMOVE) || ep - rp < 4) break;
+      int32_t opid = *(uint8_t*)(rp + 1);
+      const char* wp = rp + 2;
+      uint64_t ksiz;
+      size_t step = readvarnum(wp, ep - wp, &ksiz);
+      if (step < 1) break;
+      wp += step;
+      uint64_t vsiz;
+      step = readvarnum(wp, ep - wp, &vsiz);
+      if (step < 1) break;
+      wp += step;
+      if (ksiz > (uint64_t)(ep - wp) || vsiz > (uint64_t)(ep - wp) - ksiz) break;
+      const char* kbuf = wp;
+      const char* vbuf = wp + ksiz;
+      if (kind == LOPERAND) {
+        MergeOperator* op = find_operator(opid);
+        if (!op) {
+          set_error(_KCCODELINE_, Error::BROKEN, "unknown merge operator");
+          err = true;
+          break;
+        }
+        MergeVisitor visitor(vbuf, vsiz, op);
+        if (!db_->accept(kbuf, ksiz, &visitor, true)) {
+          copy_error(db_);
+          err = true;
+          break;
+        }
+        if (visitor.error()) {
+          failcnt_.add(1);
+          report(_KCCODELINE_, Logger::ERROR, "dropping an operand which can not be merged");
+        }
+      } else if (kind == LSET) {
+        if (!db_->set(kbuf, ksiz, vbuf, vsiz)) {
+          copy_error(db_);
+          err = true;
+          break;
+        }
+      } else {
+        if (!db_->remove(kbuf, ksiz) && db_->error() != Error::NOREC) {
+          copy_error(db_);
+          err = true;
+          break;
+        }
+      }
+      rp = vbuf + vsiz;
+      rnum++;
+    }
+    int64_t boff = rp < ep ? rp - lbuf : -1;
+    delete[] lbuf;
+    if (err) return false;
+    if (boff >= 0)
+      report(_KCCODELINE_, Logger::WARN, "the operand log is broken at %lld", (long long)boff);
+    report(_KCCODELINE_, Logger::WARN, "replayed %lld records of the operand log",
+           (long long)rnum);
+    if (!db_->synchronize(false)) {
+      copy_error(db_);
+      return false;
+    }
+    if (!mlog_.truncate(0)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, mlog_.error());
+      return false;
+    }
+    return true;
+  }
+  /**
+   * Merge all pending operands into the records.
+   * @return true on success, or false on failure.
+   */
+  bool flush_operands() {
+    _assert_(true);
+    if (opcnt_.get() < 1) return true;
+    std::vector<std::string> keys;
+    for (int32_t i = 0; i < SLOTNUM; i++) {
+      Slot* slot = slots_ + i;
+      ScopedMutex lock(&slot->lock);
+      OperandMap::iterator it = slot->ops.begin();
+      OperandMap::iterator itend = slot->ops.end();
+      while (it != itend) {
+        if (it->second.op) keys.push_back(it->first);
+        ++it;
+      }
+    }
+    Visitor visitor;
+    bool err = false;
+    size_t knum = keys.size();
+    for (size_t i = 0; !err && i < knum; i += FLUSHUNIT) {
+      size_t end = i + FLUSHUNIT;
+      if (end > knum) end = knum;
+      std::vector<std::string> ukeys(keys.begin() + i, keys.begin() + end);
+      ProxyVisitor proxy(this, &visitor, true);
+      if (!db_->accept_bulk(ukeys, &proxy, true)) {
+        copy_error(db_);
+        err = true;
+      } else if (proxy.error()) {
+        err = true;
+      }
+    }
+    flushcnt_.add(1);
+    return !err;
+  }
+  /**
+   * Merge all pending operands, synchronize the inner database, and clear the operand log.
+   * @return true on success, or false on failure.
+   * @note The writer lock must be held.
+   */
+  bool checkpoint() {
+    _assert_(true);
+    if (opcnt_.get() < 1 && (lpath_.empty() || mlog_.size() < 1)) return true;
+    if (!flush_operands()) return false;
+    if (!lpath_.empty() && !db_->synchronize(false)) {
+      copy_error(db_);
+      return false;
+    }
+    return reset_log();
+  }
+  /**
+   * Clear the operand log and forget the records which it refers to.
+   * @return true on success, or false on failure.
+   * @note The writer lock must be held.
+   */
+  bool reset_log() {
+    _assert_(true);
+    if (!lpath_.empty() && mlog_.size() > 0 && !mlog_.truncate(0)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, mlog_.error());
+      return false;
+    }
+    clear_operands();
+    return true;
+  }
+  /**
+   * Discard all pending operands.
+   */
+  void clear_operands() {
+    _assert_(true);
+    for (int32_t i = 0; i < SLOTNUM; i++) {
+      Slot* slot = slots_ + i;
+      ScopedMutex lock(&slot->lock);
+      opcnt_.add(-(int64_t)slot->ops.size());
+      slot->ops.clear();
+    }
+  }
+  /**
+   * Copy the last error of the inner database.
+   * @param db the inner database.
+   */
+  void copy_error(BasicDB* db) {
+    _assert_(db);
+    const Error& error = db->error();
+    error_->set(error.code(), error.message());
+  }
+  /**
+   * Get the number of records.
+   * @return the number of records, or -1 on failure.
+   */
+  int64_t count_impl() {
+    _assert_(true);
+    return db_ ? db_->count() : -1;
+  }
+  /**
+   * Get the size of the database file.
+   * @return the size of the database file in bytes, or -1 on failure.
+   */
+  int64_t size_impl() {
+    _assert_(true);
+    return db_ ? db_->size() : -1;
+  }
+  /** Dummy constructor to forbid the use. */
+  MergeDB(const MergeDB&);
+  /** Dummy Operator to forbid the use. */
+  MergeDB& operator =(const MergeDB&);
+  /** The method lock. */
+  RWLock mlock_;
+  /** The slots of pending operands. */
+  Slot slots_[SLOTNUM];
+  /** The last happened error. */
+  TSD<Error> error_;
+  /** The internal logger. */
+  Logger* logger_;
+  /** The kinds of logged messages. */
+  uint32_t logkinds_;
+  /** The internal meta operation trigger. */
+  MetaTrigger* mtrigger_;
+  /** The open mode. */
+  uint32_t omode_;
+  /** The flag whether in transaction. */
+  bool tran_;
+  /** The inner database. */
+  BasicDB* db_;
+  /** The path of the inner database. */
+  std::string dpath_;
+  /** The path of the database. */
+  std::string path_;
+  /** The identifiers of the registered merge operators. */
+  OperatorMap opids_;
+  /** The maximum number of pending operands. */
+  int64_t opmax_;
+  /** The number of records with pending operands or referred to by the operand log. */
+  AtomicInt64 opcnt_;
+  /** The file of the operand log. */
+  File mlog_;
+  /** The path of the operand log. */
+  std::string lpath_;
+  /** The number of given operands. */
+  AtomicInt64 mergecnt_;
+  /** The number of operands merged into records. */
+  AtomicInt64 foldcnt_;
+  /** The number of dropped operands. */
+  AtomicInt64 failcnt_;
+  /** The number of flushes of pending operands. */
+  AtomicInt64 flushcnt_;
+};
+
+
+}                                        // common namespace
+
+#endif                                   // duplication check
+
+// END OF FILE
@@ -1008,7 +1008,8 @@ class PlantDB : public BasicDB {
       psiz_(DEFPSIZ), pccap_(DEFPCCAP),
       root_(0), first_(0), last_(0), lcnt_(0), icnt_(0), count_(0), cusage_(0),
       lslots_(), islots_(), reccomp_(), linkcomp_(),
-      tran_(false), trclock_(0), trlcnt_(0), trcount_(0) {
+      tran_(false), trclock_(0), trlcnt_(0), trcount_(0),
+      cachehit_(0), cachemiss_(0), lockwait_(0) {
     _assert_(true);
   }
   /**
@@ -1043,8 +1044,12 @@ class PlantDB : public BasicDB {
     _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
     bool wrlock = writable && (tran_ || autotran_);
     if (wrlock) {
-      mlock_.lock_writer();
-    } else {
+      if (!mlock_.lock_writer_try()) {
+        lockwait_ += 1;
+        mlock_.lock_writer();
+      }
+    } else if (!mlock_.lock_reader_try()) {
+      lockwait_ += 1;
       mlock_.lock_reader();
     }
     if (omode_ == 0) {
@@ -1483,6 +1488,8 @@ class PlantDB : public BasicDB {
    * BasicDB::OTRYLOCK, which means locking is performed without blocking, BasicDB::ONOREPAIR,
    * which means the database file is not repaired implicitly even if file destruction is
    * detected.
+   * BasicDB::OREADBIAS may also be added to bias the lock of the database object to readers,
+   * which makes reading operations cheaper and updating operations dearer.
    * @return true on success, or false on failure.
    * @note Every opened database must be closed by the BasicDB::close method when it is no
    * longer in use.  It is not allowed for two or more database objects in the same process to
@@ -1491,6 +1498,7 @@ class PlantDB : public BasicDB {
   bool open(const std::string& path, uint32_t mode = OWRITER | OCREATE) {
     _assert_(true);
     ScopedRWLock lock(&mlock_, true);
+    mlock_.set_bias(mode & OREADBIAS);
     if (omode_ != 0) {
       set_error(_KCCODELINE_, Error::INVALID, "already opened");
       return false;
@@ -1925,6 +1933,9 @@ class PlantDB : public BasicDB {
     (*strmap)["bnum"] = strprintf("%lld", (long long)bnum_);
     (*strmap)["pnum"] = strprintf("%lld", (long long)db_.count());
     (*strmap)["cusage"] = strprintf("%lld", (long long)cusage_);
+    (*strmap)["cachehit"] = strprintf("%lld", (long long)cachehit_);
+    (*strmap)["cachemiss"] = strprintf("%lld", (long long)cachemiss_);
+    (*strmap)["lockwait"] = strprintf("%lld", (long long)lockwait_);
     if (strmap->count("cusage_lcnt") > 0)
       (*strmap)["cusage_lcnt"] = strprintf("%lld", (long long)calc_leaf_cache_count());
     if (strmap->count("cusage_lsiz") > 0)
@@ -2080,16 +2091,32 @@ class PlantDB : public BasicDB {
   /**
    * Set the size of the internal memory-mapped region.
    * @param msiz the size of the internal memory-mapped region.
+   * @param mcap the maximum size to which the region grows as the file grows.  If it is not
+   * more than the size of the region, the region does not grow.
    * @return true on success, or false on failure.
    */
-  bool tune_map(int64_t msiz) {
+  bool tune_map(int64_t msiz, int64_t mcap = 0) {
     _assert_(true);
     ScopedRWLock lock(&mlock_, true);
     if (omode_ != 0) {
       set_error(_KCCODELINE_, Error::INVALID, "already opened");
       return false;
     }
-    return db_.tune_map(msiz);
+    return db_.tune_map(msiz, mcap);
+  }
+  /**
+   * Set the depth of hashed subdirectories of the internal directory database.
+   * @param depth the number of levels of subdirectories.
+   * @return true on success, or false on failure.
+   */
+  bool tune_fanout(int8_t depth) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    return db_.tune_fanout(depth);
   }
   /**
    * Set the unit step number of auto defragmentation.
@@ -2425,6 +2452,7 @@ class PlantDB : public BasicDB {
   bool flush_leaf_cache(bool save) {
     _assert_(true);
     bool err = false;
+    if (save && !clean_leaf_cache()) err = true;
     for (int32_t i = SLOTNUM - 1; i >= 0; i--) {
       LeafSlot* slot = lslots_ + i;
       typename LeafCache::Iterator it = slot->warm->begin();
@@ -2432,14 +2460,14 @@ class PlantDB : public BasicDB {
       while (it != itend) {
         LeafNode* node = it.value();
         ++it;
-        if (!flush_leaf_node(node, save)) err = true;
+        if (!flush_leaf_node(node, false)) err = true;
       }
       it = slot->hot->begin();
       itend = slot->hot->end();
       while (it != itend) {
         LeafNode* node = it.value();
         ++it;
-        if (!flush_leaf_node(node, save)) err = true;
+        if (!flush_leaf_node(node, false)) err = true;
       }
     }
     return !err;
@@ -2464,6 +2492,7 @@ class PlantDB : public BasicDB {
   /**
    * Clean all of the leaf cache.
    * @return true on success, or false on failure.
+   * @note The dirty nodes of each slot are saved in a batch.
    */
   bool clean_leaf_cache() {
     _assert_(true);
@@ -2471,20 +2500,22 @@ class PlantDB : public BasicDB {
     for (int32_t i = 0; i < SLOTNUM; i++) {
       LeafSlot* slot = lslots_ + i;
       ScopedMutex lock(&slot->lock);
+      std::map<std::string, std::string> batch;
       typename LeafCache::Iterator it = slot->warm->begin();
       typename LeafCache::Iterator itend = slot->warm->end();
       while (it != itend) {
         LeafNode* node = it.value();
-        if (!save_leaf_node(node)) err = true;
+        if (!save_leaf_node(node, &batch)) err = true;
         ++it;
       }
       it = slot->hot->begin();
       itend = slot->hot->end();
       while (it != itend) {
         LeafNode* node = it.value();
-        if (!save_leaf_node(node)) err = true;
+        if (!save_leaf_node(node, &batch)) err = true;
         ++it;
       }
+      if (!save_node_batch(&batch)) err = true;
     }
     return !err;
   }
@@ -2560,9 +2591,10 @@ class PlantDB : public BasicDB {
   /**
    * Save a leaf node.
    * @param node the leaf node.
+   * @param batch the map to which the image of the node is added, or NULL to save it at once.
    * @return true on success, or false on failure.
    */
-  bool save_leaf_node(LeafNode* node) {
+  bool save_leaf_node(LeafNode* node, std::map<std::string, std::string>* batch = NULL) {
     _assert_(node);
     ScopedRWLock lock(&node->lock, false);
     if (!node->dirty) return true;
@@ -2589,7 +2621,11 @@ class PlantDB : public BasicDB {
         wp += rec->vsiz;
         ++rit;
       }
-      if (!db_.set(hbuf, hsiz, rbuf, wp - rbuf)) err = true;
+      if (batch) {
+        (*batch)[std::string(hbuf, hsiz)] = std::string(rbuf, wp - rbuf);
+      } else if (!db_.set(hbuf, hsiz, rbuf, wp - rbuf)) {
+        err = true;
+      }
       delete[] rbuf;
     }
     node->dirty = false;
@@ -2607,7 +2643,10 @@ class PlantDB : public BasicDB {
     LeafSlot* slot = lslots_ + sidx;
     ScopedMutex lock(&slot->lock);
     LeafNode** np = slot->hot->get(id, LeafCache::MLAST);
-    if (np) return *np;
+    if (np) {
+      cachehit_ += 1;
+      return *np;
+    }
     if (prom) {
       if (slot->hot->count() * WARMRATIO > slot->warm->count() + WARMRATIO) {
         slot->hot->first_value()->hot = false;
@@ -2616,12 +2655,17 @@ class PlantDB : public BasicDB {
       np = slot->warm->migrate(id, slot->hot, LeafCache::MLAST);
       if (np) {
         (*np)->hot = true;
+        cachehit_ += 1;
         return *np;
       }
     } else {
       LeafNode** np = slot->warm->get(id, LeafCache::MLAST);
-      if (np) return *np;
+      if (np) {
+        cachehit_ += 1;
+        return *np;
+      }
     }
+    cachemiss_ += 1;
     char hbuf[NUMBUFSIZ];
     size_t hsiz = write_key(hbuf, LNPREFIX, id);
     class VisitorImpl : public DB::Visitor {
@@ -2846,6 +2890,7 @@ class PlantDB : public BasicDB {
   bool flush_inner_cache(bool save) {
     _assert_(true);
     bool err = false;
+    if (save && !clean_inner_cache()) err = true;
     for (int32_t i = SLOTNUM - 1; i >= 0; i--) {
       InnerSlot* slot = islots_ + i;
       typename InnerCache::Iterator it = slot->warm->begin();
@@ -2853,7 +2898,7 @@ class PlantDB : public BasicDB {
       while (it != itend) {
         InnerNode* node = it.value();
         ++it;
-        if (!flush_inner_node(node, save)) err = true;
+        if (!flush_inner_node(node, false)) err = true;
       }
     }
     return !err;
@@ -2875,6 +2920,7 @@ class PlantDB : public BasicDB {
   /**
    * Clean all of the inner cache.
    * @return true on success, or false on failure.
+   * @note The dirty nodes of each slot are saved in a batch.
    */
   bool clean_inner_cache() {
     _assert_(true);
@@ -2882,13 +2928,15 @@ class PlantDB : public BasicDB {
     for (int32_t i = 0; i < SLOTNUM; i++) {
       InnerSlot* slot = islots_ + i;
       ScopedMutex lock(&slot->lock);
+      std::map<std::string, std::string> batch;
       typename InnerCache::Iterator it = slot->warm->begin();
       typename InnerCache::Iterator itend = slot->warm->end();
       while (it != itend) {
         InnerNode* node = it.value();
-        if (!save_inner_node(node)) err = true;
+        if (!save_inner_node(node, &batch)) err = true;
         ++it;
       }
+      if (!save_node_batch(&batch)) err = true;
     }
     return !err;
   }
@@ -2939,9 +2987,10 @@ class PlantDB : public BasicDB {
   /**
    * Save a inner node.
    * @param node the inner node.
+   * @param batch the map to which the image of the node is added, or NULL to save it at once.
    * @return true on success, or false on failure.
    */
-  bool save_inner_node(InnerNode* node) {
+  bool save_inner_node(InnerNode* node, std::map<std::string, std::string>* batch = NULL) {
     _assert_(true);
     if (!node->dirty) return true;
     bool err = false;
@@ -2964,12 +3013,29 @@ class PlantDB : public BasicDB {
         wp += link->ksiz;
         ++lit;
       }
-      if (!db_.set(hbuf, hsiz, rbuf, wp - rbuf)) err = true;
+      if (batch) {
+        (*batch)[std::string(hbuf, hsiz)] = std::string(rbuf, wp - rbuf);
+      } else if (!db_.set(hbuf, hsiz, rbuf, wp - rbuf)) {
+        err = true;
+      }
       delete[] rbuf;
     }
     node->dirty = false;
     return !err;
   }
+  /**
+   * Save the images of nodes in a batch.
+   * @param batch the map of the keys and the images of nodes.  It is cleared.
+   * @return true on success, or false on failure.
+   */
+  bool save_node_batch(std::map<std::string, std::string>* batch) {
+    _assert_(batch);
+    if (batch->empty()) return true;
+    bool err = false;
+    if (db_.set_bulk(*batch, true) < 0) err = true;
+    batch->clear();
+    return !err;
+  }
   /**
    * Load an inner node.
    * @param id the ID number of the inner node.
@@ -2981,7 +3047,11 @@ class PlantDB : public BasicDB {
     InnerSlot* slot = islots_ + sidx;
     ScopedMutex lock(&slot->lock);
     InnerNode** np = slot->warm->get(id, InnerCache::MLAST);
-    if (np) return *np;
+    if (np) {
+      cachehit_ += 1;
+      return *np;
+    }
+    cachemiss_ += 1;
     char hbuf[NUMBUFSIZ];
     size_t hsiz = write_key(hbuf, INPREFIX, id - INIDBASE);
     class VisitorImpl : public DB::Visitor {
@@ -3914,9 +3984,9 @@ class PlantDB : public BasicDB {
   /** The count of inner nodes. */
   int64_t icnt_;
   /** The record number. */
-  AtomicInt64 count_;
+  ShardedInt64 count_;
   /** The cache memory usage. */
-  AtomicInt64 cusage_;
+  ShardedInt64 cusage_;
   /** The Slots of leaf nodes. */
   LeafSlot lslots_[SLOTNUM];
   /** The Slots of inner nodes. */
@@ -3933,6 +4003,12 @@ class PlantDB : public BasicDB {
   int64_t trlcnt_;
   /** The record count history for transaction. */
   int64_t trcount_;
+  /** The number of hits of the node cache. */
+  ShardedInt64 cachehit_;
+  /** The number of misses of the node cache. */
+  ShardedInt64 cachemiss_;
+  /** The number of waits for the method lock. */
+  ShardedInt64 lockwait_;
 };
 
 
@@ -32,6 +32,10 @@
 #include <kchashdb.h>
 #include <kcdirdb.h>
 #include <kctextdb.h>
+#include <kcsharddb.h>
+#include <kcfilterdb.h>
+#include <kcmergedb.h>
+#include <kctierdb.h>
 
 namespace kyotocabinet {                 // common namespace
 
@@ -235,7 +239,8 @@ class PolyDB : public BasicDB {
   explicit PolyDB() :
       type_(TYPEVOID), db_(NULL), error_(),
       stdlogstrm_(NULL), stdlogger_(NULL), logger_(NULL), logkinds_(0),
-      stdmtrgstrm_(NULL), stdmtrigger_(NULL), mtrigger_(NULL), zcomp_(NULL) {
+      stdmtrgstrm_(NULL), stdmtrigger_(NULL), mtrigger_(NULL), zcomp_(NULL),
+      zacomp_(NULL) {
     _assert_(true);
   }
   /**
@@ -245,6 +250,7 @@ class PolyDB : public BasicDB {
   virtual ~PolyDB() {
     _assert_(true);
     if (type_ != TYPEVOID) close();
+    delete zacomp_;
     delete zcomp_;
     delete stdmtrigger_;
     delete stdmtrgstrm_;
@@ -286,6 +292,33 @@ class PolyDB : public BasicDB {
     }
     return db_->accept(kbuf, ksiz, visitor, writable);
   }
+  /**
+   * Merge an operand into the value of a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param obuf the pointer to the operand region.
+   * @param osiz the size of the operand region.
+   * @param op the merge operator.
+   * @return true on success, or false on failure.
+   * @note The operand is merged lazily if the database is opened with the "merge" parameter.
+   */
+  bool merge(const char* kbuf, size_t ksiz, const char* obuf, size_t osiz, MergeOperator* op) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && obuf && osiz <= MEMMAXSIZ && op);
+    if (type_ == TYPEVOID) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    return db_->merge(kbuf, ksiz, obuf, osiz, op);
+  }
+  /**
+   * Merge an operand into the value of a record.
+   * @note Equal to the original PolyDB::merge method except that the parameters are
+   * std::string.
+   */
+  bool merge(const std::string& key, const std::string& operand, MergeOperator* op) {
+    _assert_(op);
+    return merge(key.c_str(), key.size(), operand.c_str(), operand.size(), op);
+  }
   /**
    * Accept a visitor to multiple records at once.
    * @param keys specifies a string vector of the keys.
@@ -394,16 +427,18 @@ class PolyDB : public BasicDB {
    * the database type is determined by the value in "-", "+", ":", "*", "%", "kch", "kct",
    * "kcd", kcf", and "kcx".  All database types support the logging parameters of "log",
    * "logkinds", and "logpx".  The prototype hash database and the prototype tree database do
-   * not support any other tuning parameter.  The stash database supports "bnum".  The cache
-   * hash database supports "opts", "bnum", "zcomp", "capcnt", "capsiz", and "zkey".  The cache
-   * tree database supports all parameters of the cache hash database except for capacity
-   * limitation, and supports "psiz", "rcomp", "pccap" in addition.  The file hash database
-   * supports "apow", "fpow", "opts", "bnum", "msiz", "dfunit", "zcomp", and "zkey".  The file
-   * tree database supports all parameters of the file hash database and "psiz", "rcomp",
-   * "pccap" in addition.  The directory hash database supports "opts", "zcomp", and "zkey".
-   * The directory tree database supports all parameters of the directory hash database and
-   * "psiz", "rcomp", "pccap" in addition.  The plain text database does not support any other
-   * tuning parameter.
+   * not support any other tuning parameter.  The stash database supports "opts", "bnum",
+   * "lfmax", and "xtwidth".  The cache hash database supports "opts", "bnum", "lfmax", "zcomp",
+   * "capcnt", "capsiz", "xtwidth", "zkey", and "zadapt".
+   * The cache tree database supports all parameters of the cache hash database except for
+   * capacity limitation, and supports "psiz", "rcomp", "pccap" in addition.  The file hash
+   * database supports "apow", "fpow", "opts", "bnum", "msiz", "mcap", "dfunit", "zcomp",
+   * "zkey", and "zadapt".
+   * The file tree database supports all parameters of the file hash database and "psiz",
+   * "rcomp", "pccap" in addition.  The directory hash database supports "opts", "fanout",
+   * "zcomp", "zkey", and "zadapt".  The directory tree database supports all parameters of the
+   * directory hash database and "psiz", "rcomp", "pccap" in addition.  The plain text database
+   * does not support any other tuning parameter.
    * @param mode the connection mode.  PolyDB::OWRITER as a writer, PolyDB::OREADER as a
    * reader.  The following may be added to the writer mode by bitwise-or: PolyDB::OCREATE,
    * which means it creates a new database if the file does not exist, PolyDB::OTRUNCATE, which
@@ -415,25 +450,55 @@ class PolyDB : public BasicDB {
    * PolyDB::OTRYLOCK, which means locking is performed without blocking, PolyDB::ONOREPAIR,
    * which means the database file is not repaired implicitly even if file destruction is
    * detected.
+   * PolyDB::OREADBIAS may also be added to bias the lock of the database object to readers,
+   * which makes reading operations cheaper and updating operations dearer.
    * @return true on success, or false on failure.
    * @note The tuning parameter "log" is for the original "tune_logger" and the value specifies
    * the path of the log file, or "-" for the standard output, or "+" for the standard error.
    * "logkinds" specifies kinds of logged messages and the value can be "debug", "info", "warn",
    * or "error".  "logpx" specifies the prefix of each log message.  "opts" is for "tune_options"
-   * and the value can contain "s" for the small option, "l" for the linear option, and "c" for
-   * the compress option.  "bnum" corresponds to "tune_bucket".  "zcomp" is for "tune_compressor"
-   * and the value can be "zlib" for the ZLIB raw compressor, "def" for the ZLIB deflate
-   * compressor, "gz" for the ZLIB gzip compressor, "lzo" for the LZO compressor, "lzma" for the
-   * LZMA compressor, or "arc" for the Arcfour cipher.  "zkey" specifies the cipher key of the
-   * compressor.  "capcnt" is for "cap_count".  "capsiz" is for "cap_size".  "psiz" is for
-   * "tune_page".  "rcomp" is for "tune_comparator" and the value can be "lex" for the lexical
-   * comparator, "dec" for the decimal comparator, "lexdesc" for the lexical descending
-   * comparator, or "decdesc" for the decimal descending comparator.  "pccap" is for
-   * "tune_page_cache".  "apow" is for "tune_alignment".  "fpow" is for "tune_fbp".  "msiz" is
-   * for "tune_map".  "dfunit" is for "tune_defrag".  Every opened database must be closed by
-   * the PolyDB::close method when it is no longer in use.  It is not allowed for two or more
-   * database objects in the same process to keep their connections to the same database file at
-   * the same time.
+   * and the value can contain "s" for the small option, "l" for the linear option, "c" for
+   * the compress option, and "n" for the NUMA option.  The small option of the stash database
+   * selects the compact layout, which is single-writer: its updating operations are serialized
+   * by one lock of the whole table.  "bnum" corresponds to "tune_bucket".
+   * "lfmax" is for "tune_load_factor".  "zcomp" is for "tune_compressor" and the value can be
+   * "zlib" for the ZLIB raw compressor, "def" for the ZLIB deflate compressor, "gz" for the
+   * ZLIB gzip compressor, "lzo" for the LZO compressor, "lzma" for the LZMA compressor, "arc"
+   * for the Arcfour cipher, or "aes" for the AES cipher in the Galois/Counter mode.  "arcz" and
+   * "aesz" compress data with the ZLIB raw compressor before ciphering.  "zkey" specifies the
+   * cipher key of the compressor.  The AES cipher derives its key from "zkey" by a key
+   * derivation function and the open fails if "zkey" is not given.
+   * "zadapt" specifies the maximum ratio of the compressed size to the original size and puts
+   * an AdaptiveCompressor object in front of the compressor, or of the ZLIB raw compressor by
+   * default, so that records and pages saving less are stored raw.  With a cipher, it is
+   * applied before ciphering.  "capcnt"
+   * is for "cap_count".  "capsiz" is for "cap_size".  "xtwidth" is for "tune_expiration".
+   * "psiz" is for "tune_page".  "rcomp" is for "tune_comparator" and the value can be "lex" for
+   * the lexical comparator, "dec" for the decimal comparator, "lexdesc" for the lexical
+   * descending comparator, or "decdesc" for the decimal descending comparator.
+   * "pccap" is for "tune_page_cache".  "apow" is for "tune_alignment".  "fpow" is for
+   * "tune_fbp".  "msiz" is for "tune_map" and "mcap" is for its maximum size of growth.
+   * "dfunit" is for "tune_defrag".  "fanout" is for
+   * "tune_fanout".  "shards" specifies the number of shards.  If it is more than 1, records are
+   * distributed by the hash value of each key among as many inner databases of the same type
+   * by a ShardDB object, and the other parameters are applied to each of them.  The index of
+   * each shard is inserted before the suffix of the file name.  "shardpath" specifies the
+   * directory of each shard, where "%d" is replaced by the index of the shard.  Operations on
+   * multiple records and transactions of a sharded database are not atomic across shards.
+   * "tier" specifies the tiering mode and puts a CacheDB object limited by "capcnt" and "capsiz"
+   * in front of the database by a TierDB object.  The value can be "rt" for the read-through
+   * mode, "wt" for the write-through mode, or "wb" for the write-back mode.  "tierneg" is for
+   * "tune_negative" of the tiered database.  "bloom" specifies the false-positive rate of a
+   * bloom filter and puts a FilterDB object in front of the database so that lookups of absent
+   * keys do not reach it.  "bloomsiz" specifies the memory size of the filter in bytes, which
+   * is calculated from the number of records by default.  The filter is kept in a file whose
+   * name is that of the database file followed by ".bloom".  "merge" specifies the maximum
+   * number of records with pending operands and puts a MergeDB object in front of the database
+   * so that operands given by the PolyDB::merge method are merged into the records lazily.  The
+   * operands are logged in a file whose name is that of the database file followed by ".mlog".
+   * Every opened database must be closed by the PolyDB::close method when it is no longer in
+   * use.  It is not allowed for two or more database objects in the same process to keep their
+   * connections to the same database file at the same time.
    */
   bool open(const std::string& path = ":", uint32_t mode = OWRITER | OCREATE) {
     _assert_(true);
@@ -458,18 +523,31 @@ class PolyDB : public BasicDB {
     int64_t bnum = -1;
     int64_t capcnt = -1;
     int64_t capsiz = -1;
+    int32_t xtwidth = -1;
+    double lfmax = -1;
     int32_t apow = -1;
     int32_t fpow = -1;
     bool tsmall = false;
     bool tlinear = false;
     bool tcompress = false;
+    bool tnuma = false;
     int64_t msiz = -1;
+    int64_t mcap = 0;
     int64_t dfunit = -1;
+    int32_t fanout = -1;
+    int32_t shnum = -1;
+    std::string shpath = "";
+    int32_t tiermode = -1;
+    int64_t tierneg = -1;
+    int64_t mergemax = -1;
+    double bloomfpr = -1;
+    int64_t bloomsiz = -1;
     std::string zcompname = "";
     int64_t psiz = -1;
     Comparator* rcomp = NULL;
     int64_t pccap = 0;
     std::string zkey = "";
+    double zadapt = -1;
     std::vector<std::string>::iterator it = elems.begin();
     std::vector<std::string>::iterator itend = elems.end();
     if (it != itend) {
@@ -584,6 +662,10 @@ class PolyDB : public BasicDB {
         } else if (!std::strcmp(key, "capsiz") || !std::strcmp(key, "capsize") ||
                    !std::strcmp(key, "cap_size")) {
           capsiz = atoix(value);
+        } else if (!std::strcmp(key, "lfmax") || !std::strcmp(key, "load_factor")) {
+          lfmax = atof(value);
+        } else if (!std::strcmp(key, "xtwidth") || !std::strcmp(key, "expiration")) {
+          xtwidth = atoix(value);
         } else if (!std::strcmp(key, "apow") || !std::strcmp(key, "alignment")) {
           apow = atoix(value);
         } else if (!std::strcmp(key, "fpow") || !std::strcmp(key, "fbp")) {
@@ -592,10 +674,35 @@ class PolyDB : public BasicDB {
           if (std::strchr(value, 's')) tsmall = true;
           if (std::strchr(value, 'l')) tlinear = true;
           if (std::strchr(value, 'c')) tcompress = true;
+          if (std::strchr(value, 'n')) tnuma = true;
         } else if (!std::strcmp(key, "msiz") || !std::strcmp(key, "map")) {
           msiz = atoix(value);
+        } else if (!std::strcmp(key, "mcap")) {
+          mcap = atoix(value);
         } else if (!std::strcmp(key, "dfunit") || !std::strcmp(key, "defrag")) {
           dfunit = atoix(value);
+        } else if (!std::strcmp(key, "fanout")) {
+          fanout = atoix(value);
+        } else if (!std::strcmp(key, "shards") || !std::strcmp(key, "shnum")) {
+          shnum = atoix(value);
+        } else if (!std::strcmp(key, "shardpath") || !std::strcmp(key, "shpath")) {
+          shpath = value;
+        } else if (!std::strcmp(key, "tier")) {
+          if (!std::strcmp(value, "rt") || !std::strcmp(value, "read")) {
+            tiermode = TierDB::MREADTHROUGH;
+          } else if (!std::strcmp(value, "wt") || !std::strcmp(value, "write")) {
+            tiermode = TierDB::MWRITETHROUGH;
+          } else if (!std::strcmp(value, "wb") || !std::strcmp(value, "back")) {
+            tiermode = TierDB::MWRITEBACK;
+          }
+        } else if (!std::strcmp(key, "tierneg")) {
+          tierneg = atoix(value);
+        } else if (!std::strcmp(key, "merge")) {
+          mergemax = atoix(value);
+        } else if (!std::strcmp(key, "bloom")) {
+          bloomfpr = atof(value);
+        } else if (!std::strcmp(key, "bloomsiz")) {
+          bloomsiz = atoix(value);
         } else if (!std::strcmp(key, "zcomp") || !std::strcmp(key, "compressor")) {
           zcompname = value;
         } else if (!std::strcmp(key, "psiz") || !std::strcmp(key, "page")) {
@@ -615,6 +722,8 @@ class PolyDB : public BasicDB {
         } else if (!std::strcmp(key, "zkey") || !std::strcmp(key, "pass") ||
                    !std::strcmp(key, "password")) {
           zkey = value;
+        } else if (!std::strcmp(key, "zadapt")) {
+          zadapt = atof(value);
         }
       }
       ++it;
@@ -667,9 +776,136 @@ class PolyDB : public BasicDB {
       }
       if (stdmtrgstrm) stdmtrigger_ = new StreamMetaTrigger(stdmtrgstrm, mtrgpx.c_str());
     }
+    if (mergemax >= 0) {
+      const char* xnames[] = { "merge", NULL };
+      const std::string& mparams = inner_params(elems, xnames);
+      PolyDB* pdb = new PolyDB();
+      MergeDB* mdb = new MergeDB();
+      if (stdlogger_) {
+        pdb->tune_logger(stdlogger_, logkinds);
+        mdb->tune_logger(stdlogger_, logkinds);
+      } else if (logger_) {
+        pdb->tune_logger(logger_, logkinds_);
+        mdb->tune_logger(logger_, logkinds_);
+      }
+      if (stdmtrigger_) {
+        mdb->tune_meta_trigger(stdmtrigger_);
+      } else if (mtrigger_) {
+        mdb->tune_meta_trigger(mtrigger_);
+      }
+      mdb->tune_operands(mergemax);
+      mdb->set_inner(pdb, fpath + mparams);
+      if (!mdb->open(fpath, mode)) {
+        const Error& error = mdb->error();
+        set_error(_KCCODELINE_, error.code(), error.message());
+        delete mdb;
+        return false;
+      }
+      type_ = TYPEMISC;
+      db_ = mdb;
+      return true;
+    }
+    if (tiermode >= 0) {
+      const char* xnames[] = { "tier", "tierneg", NULL };
+      const std::string& tparams = inner_params(elems, xnames);
+      CacheDB* cdb = new CacheDB();
+      if (capcnt > 0) cdb->cap_count(capcnt);
+      if (capsiz > 0) cdb->cap_size(capsiz);
+      PolyDB* pdb = new PolyDB();
+      TierDB* tdb = new TierDB();
+      if (stdlogger_) {
+        cdb->tune_logger(stdlogger_, logkinds);
+        pdb->tune_logger(stdlogger_, logkinds);
+        tdb->tune_logger(stdlogger_, logkinds);
+      } else if (logger_) {
+        cdb->tune_logger(logger_, logkinds_);
+        pdb->tune_logger(logger_, logkinds_);
+        tdb->tune_logger(logger_, logkinds_);
+      }
+      if (stdmtrigger_) {
+        tdb->tune_meta_trigger(stdmtrigger_);
+      } else if (mtrigger_) {
+        tdb->tune_meta_trigger(mtrigger_);
+      }
+      tdb->tune_mode((TierDB::Mode)tiermode);
+      if (tierneg >= 0) tdb->tune_negative(tierneg);
+      tdb->set_tiers(cdb, "*", pdb, fpath + tparams);
+      if (!tdb->open(fpath, mode)) {
+        const Error& error = tdb->error();
+        set_error(_KCCODELINE_, error.code(), error.message());
+        delete tdb;
+        return false;
+      }
+      type_ = TYPEMISC;
+      db_ = tdb;
+      return true;
+    }
+    if (bloomfpr >= 0 || bloomsiz > 0) {
+      const char* xnames[] = { "bloom", "bloomsiz", NULL };
+      const std::string& bparams = inner_params(elems, xnames);
+      PolyDB* pdb = new PolyDB();
+      FilterDB* fdb = new FilterDB();
+      if (stdlogger_) {
+        pdb->tune_logger(stdlogger_, logkinds);
+        fdb->tune_logger(stdlogger_, logkinds);
+      } else if (logger_) {
+        pdb->tune_logger(logger_, logkinds_);
+        fdb->tune_logger(logger_, logkinds_);
+      }
+      if (stdmtrigger_) {
+        fdb->tune_meta_trigger(stdmtrigger_);
+      } else if (mtrigger_) {
+        fdb->tune_meta_trigger(mtrigger_);
+      }
+      fdb->tune_filter(bloomsiz, bloomfpr);
+      fdb->set_inner(pdb, fpath + bparams);
+      if (!fdb->open(fpath, mode)) {
+        const Error& error = fdb->error();
+        set_error(_KCCODELINE_, error.code(), error.message());
+        delete fdb;
+        return false;
+      }
+      type_ = TYPEMISC;
+      db_ = fdb;
+      return true;
+    }
+    if (shnum > 1) {
+      const char* xnames[] = { "shards", "shnum", "shardpath", "shpath", NULL };
+      const std::string& sparams = inner_params(elems, xnames);
+      ShardDB* sdb = new ShardDB();
+      if (stdlogger_) {
+        sdb->tune_logger(stdlogger_, logkinds);
+      } else if (logger_) {
+        sdb->tune_logger(logger_, logkinds_);
+      }
+      if (stdmtrigger_) {
+        sdb->tune_meta_trigger(stdmtrigger_);
+      } else if (mtrigger_) {
+        sdb->tune_meta_trigger(mtrigger_);
+      }
+      for (int32_t i = 0; i < shnum; i++) {
+        PolyDB* pdb = new PolyDB();
+        if (stdlogger_) {
+          pdb->tune_logger(stdlogger_, logkinds);
+        } else if (logger_) {
+          pdb->tune_logger(logger_, logkinds_);
+        }
+        sdb->add_shard(pdb, shard_path(fpath, shpath, i) + sparams);
+      }
+      if (!sdb->open(fpath, mode)) {
+        const Error& error = sdb->error();
+        set_error(_KCCODELINE_, error.code(), error.message());
+        delete sdb;
+        return false;
+      }
+      type_ = TYPEMISC;
+      db_ = sdb;
+      return true;
+    }
     delete zcomp_;
     zcomp_ = NULL;
     ArcfourCompressor* arccomp = NULL;
+    AESCompressor* aescomp = NULL;
     if (!zcompname.empty()) {
       if (zcompname == "zlib" || zcompname == "raw") {
         zcomp_ = new ZLIBCompressor<ZLIB::RAW>;
@@ -694,8 +930,33 @@ class PolyDB : public BasicDB {
         arccomp = new ArcfourCompressor();
         arccomp->set_compressor(ZLIBRAWCOMP);
         zcomp_ = arccomp;
+      } else if (zcompname == "aes") {
+        aescomp = new AESCompressor();
+        zcomp_ = aescomp;
+      } else if (zcompname == "aesz") {
+        aescomp = new AESCompressor();
+        aescomp->set_compressor(ZLIBRAWCOMP);
+        zcomp_ = aescomp;
+      }
+      if (aescomp && zkey.empty()) {
+        set_error(_KCCODELINE_, Error::INVALID, "no cipher key");
+        return false;
       }
     }
+    delete zacomp_;
+    zacomp_ = NULL;
+    if (zadapt > 0) {
+      zacomp_ = new AdaptiveCompressor;
+      zacomp_->set_ratio(zadapt);
+      if (arccomp) {
+        arccomp->set_compressor(zacomp_);
+      } else if (aescomp) {
+        aescomp->set_compressor(zacomp_);
+      } else if (zcomp_) {
+        zacomp_->set_compressor(zcomp_);
+      }
+    }
+    Compressor* zcomp = zacomp_ && !arccomp && !aescomp ? zacomp_ : zcomp_;
     BasicDB *db;
     switch (type) {
       default: {
@@ -733,6 +994,9 @@ class PolyDB : public BasicDB {
         break;
       }
       case TYPESTASH: {
+        int8_t opts = 0;
+        if (tsmall) opts |= StashDB::TSMALL;
+        if (tnuma) opts |= StashDB::TNUMA;
         StashDB* sdb = new StashDB();
         if (stdlogger_) {
           sdb->tune_logger(stdlogger_, logkinds);
@@ -744,13 +1008,17 @@ class PolyDB : public BasicDB {
         } else if (mtrigger_) {
           sdb->tune_meta_trigger(mtrigger_);
         }
+        if (opts > 0) sdb->tune_options(opts);
         if (bnum > 0) sdb->tune_buckets(bnum);
+        if (lfmax >= 0) sdb->tune_load_factor(lfmax);
+        if (xtwidth > 0) sdb->tune_expiration(xtwidth);
         db = sdb;
         break;
       }
       case TYPECACHE: {
         int8_t opts = 0;
         if (tcompress) opts |= CacheDB::TCOMPRESS;
+        if (tnuma) opts |= CacheDB::TNUMA;
         CacheDB* cdb = new CacheDB();
         if (stdlogger_) {
           cdb->tune_logger(stdlogger_, logkinds);
@@ -764,9 +1032,11 @@ class PolyDB : public BasicDB {
         }
         if (opts > 0) cdb->tune_options(opts);
         if (bnum > 0) cdb->tune_buckets(bnum);
-        if (zcomp_) cdb->tune_compressor(zcomp_);
+        if (lfmax >= 0) cdb->tune_load_factor(lfmax);
+        if (zcomp) cdb->tune_compressor(zcomp);
         if (capcnt > 0) cdb->cap_count(capcnt);
         if (capsiz > 0) cdb->cap_size(capsiz);
+        if (xtwidth > 0) cdb->tune_expiration(xtwidth);
         db = cdb;
         break;
       }
@@ -787,7 +1057,7 @@ class PolyDB : public BasicDB {
         if (opts > 0) gdb->tune_options(opts);
         if (bnum > 0) gdb->tune_buckets(bnum);
         if (psiz > 0) gdb->tune_page(psiz);
-        if (zcomp_) gdb->tune_compressor(zcomp_);
+        if (zcomp) gdb->tune_compressor(zcomp);
         if (pccap > 0) gdb->tune_page_cache(pccap);
         if (rcomp) gdb->tune_comparator(rcomp);
         db = gdb;
@@ -813,9 +1083,9 @@ class PolyDB : public BasicDB {
         if (fpow >= 0) hdb->tune_fbp(fpow);
         if (opts > 0) hdb->tune_options(opts);
         if (bnum > 0) hdb->tune_buckets(bnum);
-        if (msiz >= 0) hdb->tune_map(msiz);
+        if (msiz >= 0 || mcap > 0) hdb->tune_map(msiz, mcap);
         if (dfunit > 0) hdb->tune_defrag(dfunit);
-        if (zcomp_) hdb->tune_compressor(zcomp_);
+        if (zcomp) hdb->tune_compressor(zcomp);
         db = hdb;
         break;
       }
@@ -840,9 +1110,9 @@ class PolyDB : public BasicDB {
         if (opts > 0) tdb->tune_options(opts);
         if (bnum > 0) tdb->tune_buckets(bnum);
         if (psiz > 0) tdb->tune_page(psiz);
-        if (msiz >= 0) tdb->tune_map(msiz);
+        if (msiz >= 0 || mcap > 0) tdb->tune_map(msiz, mcap);
         if (dfunit > 0) tdb->tune_defrag(dfunit);
-        if (zcomp_) tdb->tune_compressor(zcomp_);
+        if (zcomp) tdb->tune_compressor(zcomp);
         if (pccap > 0) tdb->tune_page_cache(pccap);
         if (rcomp) tdb->tune_comparator(rcomp);
         db = tdb;
@@ -863,7 +1133,8 @@ class PolyDB : public BasicDB {
           ddb->tune_meta_trigger(mtrigger_);
         }
         if (opts > 0) ddb->tune_options(opts);
-        if (zcomp_) ddb->tune_compressor(zcomp_);
+        if (fanout >= 0) ddb->tune_fanout(fanout);
+        if (zcomp) ddb->tune_compressor(zcomp);
         db = ddb;
         break;
       }
@@ -884,7 +1155,8 @@ class PolyDB : public BasicDB {
         if (opts > 0) fdb->tune_options(opts);
         if (bnum > 0) fdb->tune_buckets(bnum);
         if (psiz > 0) fdb->tune_page(psiz);
-        if (zcomp_) fdb->tune_compressor(zcomp_);
+        if (fanout >= 0) fdb->tune_fanout(fanout);
+        if (zcomp) fdb->tune_compressor(zcomp);
         if (pccap > 0) fdb->tune_page_cache(pccap);
         if (rcomp) fdb->tune_comparator(rcomp);
         db = fdb;
@@ -907,6 +1179,7 @@ class PolyDB : public BasicDB {
       }
     }
     if (arccomp) arccomp->set_key(zkey.c_str(), zkey.size());
+    if (aescomp) aescomp->set_key(zkey.c_str(), zkey.size());
     if (!db->open(fpath, mode)) {
       const Error& error = db->error();
       set_error(_KCCODELINE_, error.code(), error.message());
@@ -939,6 +1212,7 @@ class PolyDB : public BasicDB {
       set_error(_KCCODELINE_, error.code(), error.message());
       err = true;
     }
+    delete zacomp_;
     delete zcomp_;
     delete stdmtrigger_;
     delete stdmtrgstrm_;
@@ -952,6 +1226,7 @@ class PolyDB : public BasicDB {
     stdmtrgstrm_ = NULL;
     stdmtrigger_ = NULL;
     zcomp_ = NULL;
+    zacomp_ = NULL;
     return !err;
   }
   /**
@@ -991,6 +1266,19 @@ class PolyDB : public BasicDB {
     }
     return db_->occupy(writable, proc);
   }
+  /**
+   * Perform defragmentation of the file.
+   * @param step the number of steps.  If it is not more than 0, the whole region is defraged.
+   * @return true on success, or false on failure.
+   */
+  bool defrag(int64_t step = 0) {
+    _assert_(true);
+    if (type_ == TYPEVOID) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    return db_->defrag(step);
+  }
   /**
    * Begin transaction.
    * @param hard true for physical synchronization with the device, or false for logical
@@ -1091,7 +1379,9 @@ class PolyDB : public BasicDB {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
       return false;
     }
-    return db_->status(strmap);
+    if (!db_->status(strmap)) return false;
+    if (zacomp_) zacomp_->status(strmap);
+    return true;
   }
   /**
    * Reveal the inner database object.
@@ -1620,6 +1910,80 @@ class PolyDB : public BasicDB {
       return comp->compare(kbuf, ksiz, right.kbuf, right.ksiz) > 0;
     }
   };
+  /**
+   * Get the parameters to be given to an inner database.
+   * @param elems the elements of the path of the whole database.
+   * @param names the names of the parameters to be excluded, terminated by NULL.
+   * @return the string of the parameters, each of which is prefixed by "#".
+   * @note The parameters of the logger and the meta operation trigger are always excluded
+   * because they are shared by the whole database.
+   */
+  static std::string inner_params(const std::vector<std::string>& elems, const char** names) {
+    _assert_(names);
+    const char* cnames[] = {
+      "log", "logger", "logkinds", "logkind", "logpx", "lpx",
+      "mtrg", "metatrigger", "meta_trigger", "mtrgpx", "mtpx", NULL
+    };
+    std::string params;
+    for (size_t i = 1; i < elems.size(); i++) {
+      std::vector<std::string> fields;
+      if (strsplit(elems[i], '=', &fields) > 1) {
+        const char* key = fields[0].c_str();
+        bool hit = false;
+        for (const char** np = cnames; !hit && *np; np++) {
+          if (!std::strcmp(key, *np)) hit = true;
+        }
+        for (const char** np = names; !hit && *np; np++) {
+          if (!std::strcmp(key, *np)) hit = true;
+        }
+        if (hit) continue;
+      }
+      params.append("#");
+      params.append(elems[i]);
+    }
+    return params;
+  }
+  /**
+   * Get the path of a shard.
+   * @param path the path of the whole database.
+   * @param dir the pattern of the directory of the shard.  "%d" in it is replaced by the index.
+   * If it is empty, the directory of the whole database is used.
+   * @param idx the index of the shard.
+   * @return the path of the shard.
+   * @note The index is inserted before the suffix of the file name.  The names of on-memory
+   * databases are not modified.
+   */
+  static std::string shard_path(const std::string& path, const std::string& dir, int32_t idx) {
+    _assert_(idx >= 0);
+    std::string name = path;
+    std::string base = "";
+    size_t pos = path.rfind(File::PATHCHR);
+    if (pos != std::string::npos) {
+      base = path.substr(0, pos);
+      name = path.substr(pos + 1);
+    }
+    if (name != "-" && name != "+" && name != ":" && name != "*" && name != "%") {
+      size_t epos = name.rfind(File::EXTCHR);
+      if (epos == std::string::npos || epos == 0) epos = name.size();
+      name.insert(epos, strprintf("-%d", idx));
+    }
+    if (!dir.empty()) {
+      base.clear();
+      const char* rp = dir.c_str();
+      while (*rp != '\0') {
+        if (rp[0] == '%' && rp[1] == 'd') {
+          strprintf(&base, "%d", idx);
+          rp += 2;
+        } else {
+          base.push_back(*rp);
+          rp++;
+        }
+      }
+    } else if (pos == std::string::npos) {
+      return name;
+    }
+    return base + File::PATHCHR + name;
+  }
   /** Dummy constructor to forbid the use. */
   PolyDB(const PolyDB&);
   /** Dummy Operator to forbid the use. */
@@ -1646,6 +2010,8 @@ class PolyDB : public BasicDB {
   MetaTrigger* mtrigger_;
   /** The custom compressor. */
   Compressor* zcomp_;
+  /** The adaptive compressor. */
+  AdaptiveCompressor* zacomp_;
 };
 
 
@@ -29,6 +29,7 @@ int main(int argc, char** argv);
 static void usage();
 static void dberrprint(kc::BasicDB* db, int32_t line, const char* func);
 static void dberrprint(kc::IndexDB* db, int32_t line, const char* func);
+static void comperrprint(int32_t line, const char* func, const kc::AsyncDB::Completion& comp);
 static void dbmetaprint(kc::BasicDB* db, bool verbose);
 static void dbmetaprint(kc::IndexDB* db, bool verbose);
 static int32_t runorder(int argc, char** argv);
@@ -37,6 +38,7 @@ static int32_t runwicked(int argc, char** argv);
 static int32_t runtran(int argc, char** argv);
 static int32_t runmapred(int argc, char** argv);
 static int32_t runindex(int argc, char** argv);
+static int32_t runasync(int argc, char** argv);
 static int32_t runmisc(int argc, char** argv);
 static int32_t procorder(const char* path, int64_t rnum, int32_t thnum, bool rnd, int32_t mode,
                          bool tran, int32_t oflags, bool lv);
@@ -51,6 +53,8 @@ static int32_t procmapred(const char* path, int64_t rnum, bool rnd, bool ru, int
                           int64_t clim, int64_t cbnum, int32_t opts);
 static int32_t procindex(const char* path, int64_t rnum, int32_t thnum, bool rnd, int32_t mode,
                          int32_t oflags, bool lv);
+static int32_t procasync(const char* path, int64_t rnum, int32_t thnum, int32_t qmax,
+                         bool rnd, int32_t oflags, bool lv);
 static int32_t procmisc(const char* path);
 
 
@@ -76,6 +80,8 @@ int main(int argc, char** argv) {
     rv = runmapred(argc, argv);
   } else if (!std::strcmp(argv[1], "index")) {
     rv = runindex(argc, argv);
+  } else if (!std::strcmp(argv[1], "async")) {
+    rv = runasync(argc, argv);
   } else if (!std::strcmp(argv[1], "misc")) {
     rv = runmisc(argc, argv);
   } else {
@@ -98,18 +104,20 @@ static void usage() {
   eprintf("\n");
   eprintf("usage:\n");
   eprintf("  %s order [-th num] [-rnd] [-set|-get|-getw|-rem|-etc] [-tran]"
-          " [-oat|-oas|-onl|-otl|-onr] [-lv] path rnum\n", g_progname);
-  eprintf("  %s queue [-th num] [-it num] [-rnd] [-oat|-oas|-onl|-otl|-onr] [-lv]"
+          " [-oat|-oas|-onl|-otl|-onr|-orb] [-lv] path rnum\n", g_progname);
+  eprintf("  %s queue [-th num] [-it num] [-rnd] [-oat|-oas|-onl|-otl|-onr|-orb] [-lv]"
           " path rnum\n", g_progname);
-  eprintf("  %s wicked [-th num] [-it num] [-oat|-oas|-onl|-otl|-onr] [-lv]"
+  eprintf("  %s wicked [-th num] [-it num] [-oat|-oas|-onl|-otl|-onr|-orb] [-lv]"
           " path rnum\n", g_progname);
-  eprintf("  %s tran [-th num] [-it num] [-hard] [-oat|-oas|-onl|-otl|-onr] [-lv]"
+  eprintf("  %s tran [-th num] [-it num] [-hard] [-oat|-oas|-onl|-otl|-onr|-orb] [-lv]"
           " path rnum\n", g_progname);
-  eprintf("  %s mapred [-rnd] [-ru] [-oat|-oas|-onl|-otl|-onr] [-lv] [-tmp str]"
+  eprintf("  %s mapred [-rnd] [-ru] [-oat|-oas|-onl|-otl|-onr|-orb] [-lv] [-tmp str]"
           " [-dbnum num] [-clim num] [-cbnum num] [-xnl] [-xpm] [-xpr] [-xpf] [-xnc]"
           " path rnum\n", g_progname);
   eprintf("  %s index [-th num] [-rnd] [-set|-get|-rem|-etc]"
-          " [-oat|-oas|-onl|-otl|-onr] [-lv] path rnum\n", g_progname);
+          " [-oat|-oas|-onl|-otl|-onr|-orb] [-lv] path rnum\n", g_progname);
+  eprintf("  %s async [-th num] [-qm num] [-rnd] [-oat|-oas|-onl|-otl|-onr|-orb] [-lv]"
+          " path rnum\n", g_progname);
   eprintf("  %s misc path\n", g_progname);
   eprintf("\n");
   std::exit(1);
@@ -124,6 +132,14 @@ static void dberrprint(kc::BasicDB* db, int32_t line, const char* func) {
 }
 
 
+// print the error message of an asynchronous operation
+static void comperrprint(int32_t line, const char* func, const kc::AsyncDB::Completion& comp) {
+  const kc::BasicDB::Error& err = comp.error;
+  oprintf("%s: %d: %s: %s: %d: %s: %s\n",
+          g_progname, line, func, comp.key.c_str(), err.code(), err.name(), err.message());
+}
+
+
 // print the error message of a database
 static void dberrprint(kc::IndexDB* idb, int32_t line, const char* func) {
   dberrprint(idb->reveal_inner_db(), line, func);
@@ -214,6 +230,8 @@ static int32_t runorder(int argc, char** argv) {
         oflags |= kc::PolyDB::OTRYLOCK;
       } else if (!std::strcmp(argv[i], "-onr")) {
         oflags |= kc::PolyDB::ONOREPAIR;
+      } else if (!std::strcmp(argv[i], "-orb")) {
+        oflags |= kc::PolyDB::OREADBIAS;
       } else if (!std::strcmp(argv[i], "-lv")) {
         lv = true;
       } else {
@@ -269,6 +287,8 @@ static int32_t runqueue(int argc, char** argv) {
         oflags |= kc::PolyDB::OTRYLOCK;
       } else if (!std::strcmp(argv[i], "-onr")) {
         oflags |= kc::PolyDB::ONOREPAIR;
+      } else if (!std::strcmp(argv[i], "-orb")) {
+        oflags |= kc::PolyDB::OREADBIAS;
       } else if (!std::strcmp(argv[i], "-lv")) {
         lv = true;
       } else {
@@ -321,6 +341,8 @@ static int32_t runwicked(int argc, char** argv) {
         oflags |= kc::PolyDB::OTRYLOCK;
       } else if (!std::strcmp(argv[i], "-onr")) {
         oflags |= kc::PolyDB::ONOREPAIR;
+      } else if (!std::strcmp(argv[i], "-orb")) {
+        oflags |= kc::PolyDB::OREADBIAS;
       } else if (!std::strcmp(argv[i], "-lv")) {
         lv = true;
       } else {
@@ -376,6 +398,8 @@ static int32_t runtran(int argc, char** argv) {
         oflags |= kc::PolyDB::OTRYLOCK;
       } else if (!std::strcmp(argv[i], "-onr")) {
         oflags |= kc::PolyDB::ONOREPAIR;
+      } else if (!std::strcmp(argv[i], "-orb")) {
+        oflags |= kc::PolyDB::OREADBIAS;
       } else if (!std::strcmp(argv[i], "-lv")) {
         lv = true;
       } else {
@@ -431,6 +455,8 @@ static int32_t runmapred(int argc, char** argv) {
         oflags |= kc::PolyDB::OTRYLOCK;
       } else if (!std::strcmp(argv[i], "-onr")) {
         oflags |= kc::PolyDB::ONOREPAIR;
+      } else if (!std::strcmp(argv[i], "-orb")) {
+        oflags |= kc::PolyDB::OREADBIAS;
       } else if (!std::strcmp(argv[i], "-lv")) {
         lv = true;
       } else if (!std::strcmp(argv[i], "-tmp")) {
@@ -512,6 +538,8 @@ static int32_t runindex(int argc, char** argv) {
         oflags |= kc::PolyDB::OTRYLOCK;
       } else if (!std::strcmp(argv[i], "-onr")) {
         oflags |= kc::PolyDB::ONOREPAIR;
+      } else if (!std::strcmp(argv[i], "-orb")) {
+        oflags |= kc::PolyDB::OREADBIAS;
       } else if (!std::strcmp(argv[i], "-lv")) {
         lv = true;
       } else {
@@ -534,6 +562,62 @@ static int32_t runindex(int argc, char** argv) {
 }
 
 
+// parse arguments of async command
+static int32_t runasync(int argc, char** argv) {
+  bool argbrk = false;
+  const char* path = NULL;
+  const char* rstr = NULL;
+  int32_t thnum = 1;
+  int32_t qmax = 0;
+  bool rnd = false;
+  int32_t oflags = 0;
+  bool lv = false;
+  for (int32_t i = 2; i < argc; i++) {
+    if (!argbrk && argv[i][0] == '-') {
+      if (!std::strcmp(argv[i], "--")) {
+        argbrk = true;
+      } else if (!std::strcmp(argv[i], "-th")) {
+        if (++i >= argc) usage();
+        thnum = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-qm")) {
+        if (++i >= argc) usage();
+        qmax = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-rnd")) {
+        rnd = true;
+      } else if (!std::strcmp(argv[i], "-oat")) {
+        oflags |= kc::PolyDB::OAUTOTRAN;
+      } else if (!std::strcmp(argv[i], "-oas")) {
+        oflags |= kc::PolyDB::OAUTOSYNC;
+      } else if (!std::strcmp(argv[i], "-onl")) {
+        oflags |= kc::PolyDB::ONOLOCK;
+      } else if (!std::strcmp(argv[i], "-otl")) {
+        oflags |= kc::PolyDB::OTRYLOCK;
+      } else if (!std::strcmp(argv[i], "-onr")) {
+        oflags |= kc::PolyDB::ONOREPAIR;
+      } else if (!std::strcmp(argv[i], "-orb")) {
+        oflags |= kc::PolyDB::OREADBIAS;
+      } else if (!std::strcmp(argv[i], "-lv")) {
+        lv = true;
+      } else {
+        usage();
+      }
+    } else if (!path) {
+      argbrk = true;
+      path = argv[i];
+    } else if (!rstr) {
+      rstr = argv[i];
+    } else {
+      usage();
+    }
+  }
+  if (!path || !rstr) usage();
+  int64_t rnum = kc::atoix(rstr);
+  if (rnum < 1 || thnum < 1) usage();
+  int32_t rv = procasync(path, rnum, thnum, qmax, rnd, oflags, lv);
+  return rv;
+}
+
+
 // parse arguments of misc command
 static int32_t runmisc(int argc, char** argv) {
   bool argbrk = false;
@@ -1837,7 +1921,37 @@ static int32_t procwicked(const char* path, int64_t rnum, int32_t thnum, int32_t
                 break;
               }
               case 3: {
-                if (!db_->append(kbuf, ksiz, vbuf, vsiz)) {
+                if (myrand(4) == 0) {
+                  kc::MergeOperator* op = kc::APPENDMERGE;
+                  const char* obuf = vbuf;
+                  size_t osiz = vsiz;
+                  char nbuf[kc::DoubleAddMerger::NUMSIZ];
+                  switch (myrand(4)) {
+                    case 0: {
+                      op = kc::INTADDMERGE;
+                      kc::writefixnum(nbuf, myrand(rnum_), sizeof(int64_t));
+                      obuf = nbuf;
+                      osiz = sizeof(int64_t);
+                      break;
+                    }
+                    case 1: {
+                      op = kc::DOUBLEADDMERGE;
+                      kc::DoubleAddMerger::encode(myrand(rnum_) / 10.0, nbuf);
+                      obuf = nbuf;
+                      osiz = sizeof(nbuf);
+                      break;
+                    }
+                    case 2: {
+                      op = kc::MAXMERGE;
+                      break;
+                    }
+                  }
+                  if (!db_->merge(kbuf, ksiz, obuf, osiz, op) &&
+                      db_->error() != kc::BasicDB::Error::LOGIC) {
+                    dberrprint(db_, __LINE__, "DB::merge");
+                    err_ = true;
+                  }
+                } else if (!db_->append(kbuf, ksiz, vbuf, vsiz)) {
                   dberrprint(db_, __LINE__, "DB::append");
                   err_ = true;
                 }
@@ -2018,6 +2132,37 @@ static int32_t procwicked(const char* path, int64_t rnum, int32_t thnum, int32_t
                 }
                 break;
               }
+              case 2: {
+                kc::BasicDB::WriteBatch batch;
+                for (int32_t j = 0; j < jnum; j++) {
+                  char jbuf[RECBUFSIZ];
+                  size_t jsiz = std::sprintf(jbuf, "%lld", (long long)(myrand(range) + 1));
+                  switch (myrand(4)) {
+                    case 0: {
+                      batch.set(jbuf, jsiz, kbuf, ksiz);
+                      break;
+                    }
+                    case 1: {
+                      batch.append(jbuf, jsiz, kbuf, ksiz);
+                      break;
+                    }
+                    case 2: {
+                      batch.remove(jbuf, jsiz);
+                      break;
+                    }
+                    default: {
+                      batch.increment(jbuf, jsiz, myrand(10), myrand(10));
+                      break;
+                    }
+                  }
+                }
+                if (db_->write_batch(batch) < 0 &&
+                    db_->error() != kc::BasicDB::Error::LOGIC) {
+                  dberrprint(db_, __LINE__, "DB::write_batch");
+                  err_ = true;
+                }
+                break;
+              }
               default: {
                 std::vector<std::string> keys;
                 for (int32_t j = 0; j < jnum; j++) {
@@ -2768,6 +2913,181 @@ static int32_t procindex(const char* path, int64_t rnum, int32_t thnum, bool rnd
 }
 
 
+// perform async command
+static int32_t procasync(const char* path, int64_t rnum, int32_t thnum, int32_t qmax,
+                         bool rnd, int32_t oflags, bool lv) {
+  oprintf("<Asynchronous Test>\n  seed=%u  path=%s  rnum=%lld  thnum=%d  qmax=%d  rnd=%d"
+          "  oflags=%d  lv=%d\n\n", g_randseed, path, (long long)rnum, thnum, qmax, rnd,
+          oflags, lv);
+  bool err = false;
+  kc::PolyDB db;
+  oprintf("opening the database:\n");
+  double stime = kc::time();
+  db.tune_logger(stdlogger(g_progname, &std::cout),
+                 lv ? kc::UINT32MAX : kc::BasicDB::Logger::WARN | kc::BasicDB::Logger::ERROR);
+  if (!db.open(path, kc::PolyDB::OWRITER | kc::PolyDB::OCREATE | kc::PolyDB::OTRUNCATE |
+               oflags)) {
+    dberrprint(&db, __LINE__, "DB::open");
+    err = true;
+  }
+  double etime = kc::time();
+  dbmetaprint(&db, false);
+  oprintf("time: %.3f\n", etime - stime);
+  kc::AsyncDB adb(&db);
+  if (!adb.start(thnum, qmax > 0 ? qmax : 0)) {
+    dberrprint(&db, __LINE__, "AsyncDB::start");
+    err = true;
+  }
+  class Reaper {
+   public:
+    explicit Reaper(kc::AsyncDB* adb, bool rnd) : adb_(adb), rnd_(rnd) {}
+    bool reap(int64_t max) {
+      bool err = false;
+      while (adb_->pending() > max) {
+        kc::AsyncDB::Completion comp;
+        if (!adb_->wait(&comp)) break;
+        if (comp.error == kc::BasicDB::Error::SUCCESS) {
+          if (comp.op == kc::AsyncDB::OGET && comp.value != comp.key) {
+            comperrprint(__LINE__, "AsyncDB::submit_get", comp);
+            err = true;
+          }
+        } else if (!rnd_ || comp.error != kc::BasicDB::Error::NOREC) {
+          comperrprint(__LINE__, "AsyncDB::wait", comp);
+          err = true;
+        }
+      }
+      return !err;
+    }
+   private:
+    kc::AsyncDB* adb_;
+    bool rnd_;
+  };
+  Reaper reaper(&adb, rnd);
+  int64_t wnum = thnum * 64;
+  oprintf("setting records:\n");
+  stime = kc::time();
+  for (int64_t i = 1; !err && i <= rnum; i++) {
+    char kbuf[RECBUFSIZ];
+    size_t ksiz = std::sprintf(kbuf, "%08lld", (long long)(rnd ? myrand(rnum) + 1 : i));
+    std::string key(kbuf, ksiz);
+    if (adb.submit_set(key, key) < 1) {
+      dberrprint(&db, __LINE__, "AsyncDB::submit_set");
+      err = true;
+    }
+    if (!reaper.reap(wnum)) err = true;
+    if (rnum > 250 && i % (rnum / 250) == 0) {
+      oputchar('.');
+      if (i == rnum || i % (rnum / 10) == 0) oprintf(" (%08lld)\n", (long long)i);
+    }
+  }
+  if (!reaper.reap(0)) err = true;
+  etime = kc::time();
+  dbmetaprint(&db, false);
+  oprintf("time: %.3f\n", etime - stime);
+  oprintf("getting records:\n");
+  stime = kc::time();
+  for (int64_t i = 1; !err && i <= rnum; i++) {
+    char kbuf[RECBUFSIZ];
+    size_t ksiz = std::sprintf(kbuf, "%08lld", (long long)(rnd ? myrand(rnum) + 1 : i));
+    if (adb.submit_get(std::string(kbuf, ksiz)) < 1) {
+      dberrprint(&db, __LINE__, "AsyncDB::submit_get");
+      err = true;
+    }
+    if (!reaper.reap(wnum)) err = true;
+    if (rnum > 250 && i % (rnum / 250) == 0) {
+      oputchar('.');
+      if (i == rnum || i % (rnum / 10) == 0) oprintf(" (%08lld)\n", (long long)i);
+    }
+  }
+  if (!reaper.reap(0)) err = true;
+  etime = kc::time();
+  dbmetaprint(&db, false);
+  oprintf("time: %.3f\n", etime - stime);
+  oprintf("accepting visitors:\n");
+  stime = kc::time();
+  class VisitorImpl : public kc::DB::Visitor {
+   public:
+    explicit VisitorImpl() : full_(0), empty_(0) {}
+    int64_t full() {
+      return full_.get();
+    }
+    int64_t empty() {
+      return empty_.get();
+    }
+   private:
+    const char* visit_full(const char* kbuf, size_t ksiz,
+                           const char* vbuf, size_t vsiz, size_t* sp) {
+      full_.add(1);
+      return NOP;
+    }
+    const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
+      empty_.add(1);
+      return NOP;
+    }
+    kc::AtomicInt64 full_;
+    kc::AtomicInt64 empty_;
+  } visitor;
+  for (int64_t i = 1; !err && i <= rnum; i++) {
+    char kbuf[RECBUFSIZ];
+    size_t ksiz = std::sprintf(kbuf, "%08lld", (long long)(rnd ? myrand(rnum) + 1 : i));
+    if (adb.submit_accept(std::string(kbuf, ksiz), &visitor, false) < 1) {
+      dberrprint(&db, __LINE__, "AsyncDB::submit_accept");
+      err = true;
+    }
+    if (!reaper.reap(wnum)) err = true;
+    if (rnum > 250 && i % (rnum / 250) == 0) {
+      oputchar('.');
+      if (i == rnum || i % (rnum / 10) == 0) oprintf(" (%08lld)\n", (long long)i);
+    }
+  }
+  if (!reaper.reap(0)) err = true;
+  if (!err && (visitor.full() + visitor.empty() != rnum || (!rnd && visitor.empty() > 0))) {
+    dberrprint(&db, __LINE__, "AsyncDB::submit_accept");
+    err = true;
+  }
+  etime = kc::time();
+  dbmetaprint(&db, false);
+  oprintf("time: %.3f\n", etime - stime);
+  oprintf("removing records:\n");
+  stime = kc::time();
+  for (int64_t i = 1; !err && i <= rnum; i++) {
+    char kbuf[RECBUFSIZ];
+    size_t ksiz = std::sprintf(kbuf, "%08lld", (long long)(rnd ? myrand(rnum) + 1 : i));
+    if (adb.submit_remove(std::string(kbuf, ksiz)) < 1) {
+      dberrprint(&db, __LINE__, "AsyncDB::submit_remove");
+      err = true;
+    }
+    if (!reaper.reap(wnum)) err = true;
+    if (rnum > 250 && i % (rnum / 250) == 0) {
+      oputchar('.');
+      if (i == rnum || i % (rnum / 10) == 0) oprintf(" (%08lld)\n", (long long)i);
+    }
+  }
+  if (!reaper.reap(0)) err = true;
+  if (!adb.stop()) {
+    dberrprint(&db, __LINE__, "AsyncDB::stop");
+    err = true;
+  }
+  if (!err && !rnd && db.count() != 0) {
+    dberrprint(&db, __LINE__, "DB::count");
+    err = true;
+  }
+  etime = kc::time();
+  dbmetaprint(&db, true);
+  oprintf("time: %.3f\n", etime - stime);
+  oprintf("closing the database:\n");
+  stime = kc::time();
+  if (!db.close()) {
+    dberrprint(&db, __LINE__, "DB::close");
+    err = true;
+  }
+  etime = kc::time();
+  oprintf("time: %.3f\n", etime - stime);
+  oprintf("%s\n\n", err ? "error" : "ok");
+  return err ? 1 : 0;
+}
+
+
 // perform misc command
 static int32_t procmisc(const char* path) {
   oprintf("<Miscellaneous Test>\n  seed=%u  path=%s\n\n", g_randseed, path);
@@ -2956,6 +3276,73 @@ static int32_t procmisc(const char* path) {
       keys.clear();
     }
   }
+  oprintf("batch operations:\n");
+  kc::BasicDB::WriteBatch batch;
+  batch.set("batch:a", "foo");
+  batch.append("batch:a", "bar");
+  batch.set("batch:b", "baz");
+  batch.remove("batch:b");
+  batch.increment(std::string("batch:c"), 10, 5);
+  batch.increment("batch:c", -3);
+  batch.remove("batch:d");
+  batch.set("00000003", "three");
+  if (batch.count() != 8 || db->write_batch(batch) != 3) {
+    dberrprint(db, __LINE__, "DB::write_batch");
+    err = true;
+  }
+  std::string value;
+  if (!db->get("batch:a", &value) || value != "foobar") {
+    dberrprint(db, __LINE__, "DB::get");
+    err = true;
+  }
+  if (db->get("batch:b", &value) || db->error() != kc::BasicDB::Error::NOREC) {
+    dberrprint(db, __LINE__, "DB::get");
+    err = true;
+  }
+  if (db->increment("batch:c", 0) != 12) {
+    dberrprint(db, __LINE__, "DB::increment");
+    err = true;
+  }
+  batch.clear();
+  batch.increment("batch:a", 1);
+  batch.remove("batch:c");
+  if (db->write_batch(batch) != -1 || db->error() != kc::BasicDB::Error::LOGIC ||
+      db->check("batch:a") != 6 || db->check("batch:c") != -1) {
+    dberrprint(db, __LINE__, "DB::write_batch");
+    err = true;
+  }
+  oprintf("merging operands:\n");
+  char obuf[kc::DoubleAddMerger::NUMSIZ];
+  bool mok = true;
+  for (int32_t i = 1; i <= 10; i++) {
+    kc::writefixnum(obuf, i, sizeof(int64_t));
+    if (!db->merge("merge:int", 9, obuf, sizeof(int64_t), kc::INTADDMERGE)) mok = false;
+    kc::DoubleAddMerger::encode(i / 4.0, obuf);
+    if (!db->merge("merge:double", 12, obuf, sizeof(obuf), kc::DOUBLEADDMERGE)) mok = false;
+    const std::string& istr = kc::strprintf("%d", i % 7);
+    if (!db->merge("merge:append", istr, kc::APPENDMERGE)) mok = false;
+    if (!db->merge("merge:max", istr, kc::MAXMERGE)) mok = false;
+  }
+  if (!mok) {
+    dberrprint(db, __LINE__, "DB::merge");
+    err = true;
+  }
+  if (db->increment(std::string("merge:int"), 0) != 55 ||
+      db->increment_double(std::string("merge:double"), 0, 0) != 13.75 ||
+      !db->get("merge:append", &value) || value != "1234560123" ||
+      !db->get("merge:max", &value) || value != "6") {
+    dberrprint(db, __LINE__, "DB::merge");
+    err = true;
+  }
+  if (!db->merge("merge:append", "x", kc::INTADDMERGE) &&
+      db->error() != kc::BasicDB::Error::LOGIC) {
+    dberrprint(db, __LINE__, "DB::merge");
+    err = true;
+  }
+  if (!db->get("merge:append", &value) || value != "1234560123") {
+    dberrprint(db, __LINE__, "DB::get");
+    err = true;
+  }
   kc::PolyDB* pdb = dynamic_cast<kc::PolyDB*>(db);
   if (pdb) {
     kc::BasicDB* idb = pdb->reveal_inner_db();
@@ -2975,7 +3362,29 @@ static int32_t procmisc(const char* path) {
         const std::string& dpath = idb->path() + kc::File::EXTCHR + "tmp" +
             kc::File::EXTCHR + ext;
         oprintf("copying the database file:\n");
-        if (!idb->copy(dpath)) {
+        class CheckerImpl : public kc::BasicDB::ProgressChecker {
+         public:
+          explicit CheckerImpl(bool stop) : stop_(stop), cnt_(0) {}
+          int64_t count() {
+            return cnt_;
+          }
+         private:
+          bool check(const char* name, const char* message, int64_t curcnt, int64_t allcnt) {
+            if (std::strcmp(message, "processing")) return true;
+            cnt_++;
+            return !stop_;
+          }
+          bool stop_;
+          int64_t cnt_;
+        };
+        CheckerImpl stopchecker(true);
+        if (idb->copy(dpath, &stopchecker) || stopchecker.count() != 1) {
+          dberrprint(db, __LINE__, "DB::copy");
+          err = true;
+        }
+        kc::File::remove_recursively(dpath.c_str());
+        CheckerImpl checker(false);
+        if (!idb->copy(dpath, &checker) || checker.count() < 1) {
           dberrprint(db, __LINE__, "DB::copy");
           err = true;
         }
@@ -2996,6 +3405,98 @@ static int32_t procmisc(const char* path) {
         }
         kc::File::remove_recursively(dpath.c_str());
       }
+      if (typeid(*idb) == typeid(kc::TierDB)) {
+        oprintf("stepping over removed records:\n");
+        class VisitorKey : public kc::DB::Visitor {
+         public:
+          explicit VisitorKey() : key_() {}
+          const std::string& key() {
+            return key_;
+          }
+         private:
+          const char* visit_full(const char* kbuf, size_t ksiz,
+                                 const char* vbuf, size_t vsiz, size_t* sp) {
+            key_.assign(kbuf, ksiz);
+            return NOP;
+          }
+          std::string key_;
+        };
+        std::string keys[3];
+        kc::DB::Cursor* cur = db->cursor();
+        if (cur->jump()) {
+          for (int32_t i = 0; i < 3; i++) {
+            if (!cur->get_key(keys + i, true)) {
+              dberrprint(db, __LINE__, "Cursor::get_key");
+              err = true;
+              break;
+            }
+          }
+        } else {
+          dberrprint(db, __LINE__, "Cursor::jump");
+          err = true;
+        }
+        if (!err && cur->jump()) {
+          VisitorKey visitor;
+          if (!db->remove(keys[1])) {
+            dberrprint(db, __LINE__, "DB::remove");
+            err = true;
+          }
+          if (!cur->accept(&visitor, true, true) || visitor.key() != keys[0]) {
+            dberrprint(db, __LINE__, "Cursor::accept");
+            err = true;
+          }
+          if (!cur->accept(&visitor, true, false) || visitor.key() != keys[2]) {
+            dberrprint(db, __LINE__, "Cursor::accept");
+            err = true;
+          }
+        }
+        delete cur;
+      }
+      if (typeid(*idb) == typeid(kc::MergeDB)) {
+        const std::string& ipath = idb->path();
+        const std::string& lpath = ipath + kc::File::EXTCHR + KCMDBPATHEXT;
+        if (!idb->synchronize(false)) {
+          dberrprint(db, __LINE__, "DB::synchronize");
+          err = true;
+        }
+        if (kc::File::status(lpath)) {
+          oprintf("replaying the operand log:\n");
+          for (int32_t i = 1; i <= 10; i++) {
+            kc::writefixnum(obuf, i, sizeof(int64_t));
+            const std::string& istr = kc::strprintf("%d", i % 7);
+            if (!db->merge("mlog:int", 8, obuf, sizeof(int64_t), kc::INTADDMERGE) ||
+                !db->merge("mlog:append", istr, kc::APPENDMERGE)) {
+              dberrprint(db, __LINE__, "DB::merge");
+              err = true;
+            }
+          }
+          size_t pos = ipath.rfind(kc::File::EXTCHR);
+          const std::string& cpath = ipath + kc::File::EXTCHR + "crash" +
+              (pos != std::string::npos ? ipath.substr(pos) : std::string(""));
+          const std::string& clpath = cpath + kc::File::EXTCHR + KCMDBPATHEXT;
+          if (!kc::File::copy_file(ipath, cpath) || !kc::File::copy_file(lpath, clpath)) {
+            eprintf("%s: copying the database files failed\n", g_progname);
+            err = true;
+          }
+          kc::PolyDB cdb;
+          if (cdb.open(cpath + "#merge=8", kc::PolyDB::OWRITER)) {
+            if (cdb.increment(std::string("mlog:int"), 0) != 55 ||
+                !cdb.get("mlog:append", &value) || value != "1234560123") {
+              dberrprint(&cdb, __LINE__, "DB::get");
+              err = true;
+            }
+            if (!cdb.close()) {
+              dberrprint(&cdb, __LINE__, "DB::close");
+              err = true;
+            }
+          } else {
+            dberrprint(&cdb, __LINE__, "DB::open");
+            err = true;
+          }
+          kc::File::remove_recursively(cpath);
+          kc::File::remove(clpath);
+        }
+      }
     }
   }
   oprintf("scanning in parallel:\n");
@@ -742,6 +742,8 @@ class ProtoDB : public BasicDB {
    * BasicDB::OTRYLOCK, which means locking is performed without blocking, BasicDB::ONOREPAIR,
    * which means the database file is not repaired implicitly even if file destruction is
    * detected.
+   * BasicDB::OREADBIAS may also be added to bias the lock of the database object to readers,
+   * which makes reading operations cheaper and updating operations dearer.
    * @return true on success, or false on failure.
    * @note Every opened database must be closed by the BasicDB::close method when it is no
    * longer in use.  It is not allowed for two or more database objects in the same process to
@@ -750,6 +752,7 @@ class ProtoDB : public BasicDB {
   bool open(const std::string& path, uint32_t mode = OWRITER | OCREATE) {
     _assert_(true);
     ScopedRWLock lock(&mlock_, true);
+    mlock_.set_bias(mode & OREADBIAS);
     if (omode_ != 0) {
       set_error(_KCCODELINE_, Error::INVALID, "already opened");
       return false;
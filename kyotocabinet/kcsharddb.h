@@ -0,0 +1,1086 @@
+/*************************************************************************************************
+ * Sharded database
+ *                                                               Copyright (C) 2009-2012 FAL Labs
+ * This file is part of Kyoto Cabinet.
+ * This program is free software: you can redistribute it and/or modify it under the terms of
+ * the GNU General Public License as published by the Free Software Foundation, either version
+ * 3 of the License, or any later version.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************************************/
+
+
+#ifndef _KCSHARDDB_H                     // duplication check
+#define _KCSHARDDB_H
+
+#include <kccommon.h>
+#include <kcutil.h>
+#include <kcthread.h>
+#include <kcfile.h>
+#include <kccompress.h>
+#include <kccompare.h>
+#include <kcmap.h>
+#include <kcregex.h>
+#include <kcdb.h>
+
+namespace kyotocabinet {                 // common namespace
+
+
+/**
+ * Sharded database.
+ * @note This class is a concrete class to distribute records among multiple inner databases by
+ * the hash value of each key.  Inner databases are registered by the ShardDB::add_shard method
+ * before the database is opened and then they are opened and closed together.  Each inner
+ * database can be on a different device so that operations on different shards do not contend
+ * for any lock or disk.  Operations on a single record are as atomic as those of the inner
+ * databases.  Operations on multiple records and transactions are performed on each shard
+ * independently and they are not atomic across shards.
+ */
+class ShardDB : public BasicDB {
+ public:
+  class Cursor;
+ private:
+  class ScopedVisitor;
+  class ProxyVisitor;
+  /** An alias of array of inner databases. */
+  typedef std::vector<BasicDB*> DBArray;
+ public:
+  /**
+   * Cursor to indicate a record.
+   * @note Records are scanned in each shard in turn.
+   */
+  class Cursor : public BasicDB::Cursor {
+    friend class ShardDB;
+   public:
+    /**
+     * Constructor.
+     * @param db the container database object.
+     */
+    explicit Cursor(ShardDB* db) : db_(db), curs_(), idx_(-1), back_(false) {
+      _assert_(db);
+      ScopedRWLock lock(&db_->mlock_, false);
+      size_t dnum = db_->dbs_.size();
+      curs_.reserve(dnum);
+      for (size_t i = 0; i < dnum; i++) {
+        curs_.push_back(db_->dbs_[i]->cursor());
+      }
+    }
+    /**
+     * Destructor.
+     */
+    virtual ~Cursor() {
+      _assert_(true);
+      std::vector<BasicDB::Cursor*>::iterator it = curs_.begin();
+      std::vector<BasicDB::Cursor*>::iterator itend = curs_.end();
+      while (it != itend) {
+        delete *it;
+        ++it;
+      }
+    }
+    /**
+     * Accept a visitor to the current record.
+     * @param visitor a visitor object.
+     * @param writable true for writable operation, or false for read-only operation.
+     * @param step true to move the cursor to the next record, or false for no move.
+     * @return true on success, or false on failure.
+     * @note The operation for each record is performed atomically and other threads accessing
+     * the same record are blocked.  To avoid deadlock, any explicit database operation must not
+     * be performed in this function.
+     */
+    bool accept(Visitor* visitor, bool writable = true, bool step = false) {
+      _assert_(visitor);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      while (true) {
+        if (idx_ < 0 || idx_ >= (int32_t)curs_.size()) {
+          db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+          return false;
+        }
+        BasicDB::Cursor* cur = curs_[idx_];
+        if (cur->accept(visitor, writable, step)) return true;
+        if (cur->error() != Error::NOREC) {
+          db_->copy_error(cur->db());
+          return false;
+        }
+        if (!shift()) return false;
+      }
+    }
+    /**
+     * Jump the cursor to the first record for forward scan.
+     * @return true on success, or false on failure.
+     */
+    bool jump() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      idx_ = -1;
+      back_ = false;
+      return shift();
+    }
+    /**
+     * Jump the cursor to a record for forward scan.
+     * @param kbuf the pointer to the key region.
+     * @param ksiz the size of the key region.
+     * @return true on success, or false on failure.
+     * @note The cursor is set in the shard of the key and then the following shards are
+     * scanned.
+     */
+    bool jump(const char* kbuf, size_t ksiz) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      idx_ = db_->shard_index(kbuf, ksiz);
+      back_ = false;
+      BasicDB::Cursor* cur = curs_[idx_];
+      if (!cur->jump(kbuf, ksiz)) {
+        db_->copy_error(cur->db());
+        idx_ = -1;
+        return false;
+      }
+      return true;
+    }
+    /**
+     * Jump the cursor to a record for forward scan.
+     * @note Equal to the original Cursor::jump method except that the parameter is std::string.
+     */
+    bool jump(const std::string& key) {
+      _assert_(true);
+      return jump(key.c_str(), key.size());
+    }
+    /**
+     * Jump the cursor to the last record for backward scan.
+     * @return true on success, or false on failure.
+     * @note This method is dedicated to tree databases.  Some database types, especially hash
+     * databases, may provide a dummy implementation.
+     */
+    bool jump_back() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      idx_ = curs_.size();
+      back_ = true;
+      return shift();
+    }
+    /**
+     * Jump the cursor to a record for backward scan.
+     * @param kbuf the pointer to the key region.
+     * @param ksiz the size of the key region.
+     * @return true on success, or false on failure.
+     * @note This method is dedicated to tree databases.  Some database types, especially hash
+     * databases, will provide a dummy implementation.
+     */
+    bool jump_back(const char* kbuf, size_t ksiz) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      idx_ = db_->shard_index(kbuf, ksiz);
+      back_ = true;
+      BasicDB::Cursor* cur = curs_[idx_];
+      if (!cur->jump_back(kbuf, ksiz)) {
+        db_->copy_error(cur->db());
+        idx_ = -1;
+        return false;
+      }
+      return true;
+    }
+    /**
+     * Jump the cursor to a record for backward scan.
+     * @note Equal to the original Cursor::jump_back method except that the parameter is
+     * std::string.
+     */
+    bool jump_back(const std::string& key) {
+      _assert_(true);
+      return jump_back(key.c_str(), key.size());
+    }
+    /**
+     * Step the cursor to the next record.
+     * @return true on success, or false on failure.
+     */
+    bool step() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (idx_ < 0 || idx_ >= (int32_t)curs_.size()) {
+        db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+        return false;
+      }
+      BasicDB::Cursor* cur = curs_[idx_];
+      if (cur->step()) return true;
+      if (cur->error() != Error::NOREC) {
+        db_->copy_error(cur->db());
+        return false;
+      }
+      back_ = false;
+      return shift();
+    }
+    /**
+     * Step the cursor to the previous record.
+     * @return true on success, or false on failure.
+     * @note This method is dedicated to tree databases.  Some database types, especially hash
+     * databases, may provide a dummy implementation.
+     */
+    bool step_back() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (idx_ < 0 || idx_ >= (int32_t)curs_.size()) {
+        db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+        return false;
+      }
+      BasicDB::Cursor* cur = curs_[idx_];
+      if (cur->step_back()) return true;
+      if (cur->error() != Error::NOREC) {
+        db_->copy_error(cur->db());
+        return false;
+      }
+      back_ = true;
+      return shift();
+    }
+    /**
+     * Get the database object.
+     * @return the database object.
+     */
+    ShardDB* db() {
+      _assert_(true);
+      return db_;
+    }
+   private:
+    /**
+     * Move the cursor to the first available record of the next shard.
+     * @return true on success, or false on failure.
+     */
+    bool shift() {
+      _assert_(true);
+      int32_t dnum = curs_.size();
+      while (true) {
+        idx_ += back_ ? -1 : 1;
+        if (idx_ < 0 || idx_ >= dnum) break;
+        BasicDB::Cursor* cur = curs_[idx_];
+        if (back_ ? cur->jump_back() : cur->jump()) return true;
+        if (cur->error() != Error::NOREC) {
+          db_->copy_error(cur->db());
+          idx_ = -1;
+          return false;
+        }
+      }
+      db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+      return false;
+    }
+    /** Dummy constructor to forbid the use. */
+    Cursor(const Cursor&);
+    /** Dummy Operator to forbid the use. */
+    Cursor& operator =(const Cursor&);
+    /** The inner database. */
+    ShardDB* db_;
+    /** The cursors of the shards. */
+    std::vector<BasicDB::Cursor*> curs_;
+    /** The index of the current shard. */
+    int32_t idx_;
+    /** The flag of backward scan. */
+    bool back_;
+  };
+  /**
+   * Default constructor.
+   */
+  explicit ShardDB() :
+      mlock_(), error_(), logger_(NULL), logkinds_(0), mtrigger_(NULL),
+      omode_(0), dbs_(), paths_(), path_("") {
+    _assert_(true);
+  }
+  /**
+   * Destructor.
+   * @note If the database is not closed, it is closed implicitly.  The inner databases are
+   * deleted.
+   */
+  virtual ~ShardDB() {
+    _assert_(true);
+    if (omode_ != 0) close();
+    DBArray::iterator it = dbs_.begin();
+    DBArray::iterator itend = dbs_.end();
+    while (it != itend) {
+      delete *it;
+      ++it;
+    }
+  }
+  /**
+   * Add an inner database.
+   * @param db the inner database object.  Its possession is transferred inside and the object
+   * is deleted automatically.
+   * @param path the path of the inner database, which is given to its open method.
+   * @return true on success, or false on failure.
+   */
+  bool add_shard(BasicDB* db, const std::string& path) {
+    _assert_(db);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    dbs_.push_back(db);
+    paths_.push_back(path);
+    return true;
+  }
+  /**
+   * Accept a visitor to a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @return true on success, or false on failure.
+   * @note The operation for each record is performed atomically and other threads accessing the
+   * same record are blocked.  To avoid deadlock, any explicit database operation must not be
+   * performed in this function.
+   */
+  bool accept(const char* kbuf, size_t ksiz, Visitor* visitor, bool writable = true) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    BasicDB* db = dbs_[shard_index(kbuf, ksiz)];
+    if (!db->accept(kbuf, ksiz, visitor, writable)) {
+      copy_error(db);
+      return false;
+    }
+    return true;
+  }
+  /**
+   * Accept a visitor to multiple records at once.
+   * @param keys specifies a string vector of the keys.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @return true on success, or false on failure.
+   * @note The keys are grouped by shard and the groups are processed in parallel.  The
+   * operations in each shard are performed atomically but the visitor is called by one thread
+   * at a time.  To avoid deadlock, any explicit database operation must not be performed in
+   * this function.
+   */
+  bool accept_bulk(const std::vector<std::string>& keys, Visitor* visitor,
+                   bool writable = true) {
+    _assert_(visitor);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    ScopedVisitor svis(visitor);
+    size_t dnum = dbs_.size();
+    std::vector<std::string>* groups = new std::vector<std::string>[dnum];
+    std::vector<std::string>::const_iterator it = keys.begin();
+    std::vector<std::string>::const_iterator itend = keys.end();
+    while (it != itend) {
+      groups[shard_index(it->data(), it->size())].push_back(*it);
+      ++it;
+    }
+    class ThreadImpl : public Thread {
+     public:
+      explicit ThreadImpl() : db_(NULL), keys_(NULL), visitor_(NULL), writable_(false),
+                              error_() {}
+      void init(BasicDB* db, const std::vector<std::string>* keys, Visitor* visitor,
+                bool writable) {
+        db_ = db;
+        keys_ = keys;
+        visitor_ = visitor;
+        writable_ = writable;
+      }
+      const Error& error() {
+        return error_;
+      }
+      void run() {
+        if (!db_->accept_bulk(*keys_, visitor_, writable_)) error_ = db_->error();
+      }
+     private:
+      BasicDB* db_;
+      const std::vector<std::string>* keys_;
+      Visitor* visitor_;
+      bool writable_;
+      Error error_;
+    };
+    Mutex vlock;
+    ProxyVisitor* proxies = new ProxyVisitor[dnum];
+    ThreadImpl* threads = new ThreadImpl[dnum];
+    std::vector<size_t> actives;
+    for (size_t i = 0; i < dnum; i++) {
+      if (groups[i].empty()) continue;
+      proxies[i].init(visitor, &vlock);
+      threads[i].init(dbs_[i], groups + i, proxies + i, writable);
+      actives.push_back(i);
+    }
+    if (actives.size() > 1) {
+      for (size_t i = 0; i < actives.size(); i++) {
+        threads[actives[i]].start();
+      }
+      for (size_t i = 0; i < actives.size(); i++) {
+        threads[actives[i]].join();
+      }
+    } else if (!actives.empty()) {
+      threads[actives.front()].run();
+    }
+    bool err = false;
+    for (size_t i = 0; i < actives.size(); i++) {
+      const Error& error = threads[actives[i]].error();
+      if (error != Error::SUCCESS) {
+        error_->set(error.code(), error.message());
+        err = true;
+      }
+    }
+    delete[] threads;
+    delete[] proxies;
+    delete[] groups;
+    return !err;
+  }
+  /**
+   * Iterate to accept a visitor for each record.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note The shards are iterated in turn.  The iteration of each shard is performed atomically
+   * and other threads are blocked.  To avoid deadlock, any explicit database operation must not
+   * be performed in this function.
+   */
+  bool iterate(Visitor *visitor, bool writable = true, ProgressChecker* checker = NULL) {
+    _assert_(visitor);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    ScopedVisitor svis(visitor);
+    ProxyVisitor proxy;
+    proxy.init(visitor, NULL);
+    size_t dnum = dbs_.size();
+    for (size_t i = 0; i < dnum; i++) {
+      if (!dbs_[i]->iterate(&proxy, writable, checker)) {
+        copy_error(dbs_[i]);
+        return false;
+      }
+    }
+    trigger_meta(MetaTrigger::ITERATE, "iterate");
+    return true;
+  }
+  /**
+   * Scan each record in parallel.
+   * @param visitor a visitor object.
+   * @param thnum the number of worker threads.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note The shards are scanned at the same time and the worker threads are divided among
+   * them.  To avoid deadlock, any explicit database operation must not be performed in this
+   * function.
+   */
+  bool scan_parallel(Visitor *visitor, size_t thnum, ProgressChecker* checker = NULL) {
+    _assert_(visitor && thnum <= MEMMAXSIZ);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    ScopedVisitor svis(visitor);
+    size_t dnum = dbs_.size();
+    size_t shthnum = thnum / dnum;
+    if (shthnum < 1) shthnum = 1;
+    class ThreadImpl : public Thread {
+     public:
+      explicit ThreadImpl() : db_(NULL), visitor_(NULL), thnum_(0), checker_(NULL),
+                              error_() {}
+      void init(BasicDB* db, Visitor* visitor, size_t thnum, ProgressChecker* checker) {
+        db_ = db;
+        visitor_ = visitor;
+        thnum_ = thnum;
+        checker_ = checker;
+      }
+      const Error& error() {
+        return error_;
+      }
+      void run() {
+        if (!db_->scan_parallel(visitor_, thnum_, checker_)) error_ = db_->error();
+      }
+     private:
+      BasicDB* db_;
+      Visitor* visitor_;
+      size_t thnum_;
+      ProgressChecker* checker_;
+      Error error_;
+    };
+    ProxyVisitor proxy;
+    proxy.init(visitor, NULL);
+    ThreadImpl* threads = new ThreadImpl[dnum];
+    for (size_t i = 0; i < dnum; i++) {
+      ThreadImpl* thread = threads + i;
+      thread->init(dbs_[i], &proxy, shthnum, checker);
+      thread->start();
+    }
+    bool err = false;
+    for (size_t i = 0; i < dnum; i++) {
+      ThreadImpl* thread = threads + i;
+      thread->join();
+      const Error& error = thread->error();
+      if (error != Error::SUCCESS) {
+        error_->set(error.code(), error.message());
+        err = true;
+      }
+    }
+    delete[] threads;
+    trigger_meta(MetaTrigger::ITERATE, "scan_parallel");
+    return !err;
+  }
+  /**
+   * Get the last happened error.
+   * @return the last happened error.
+   */
+  Error error() const {
+    _assert_(true);
+    return error_;
+  }
+  /**
+   * Set the error information.
+   * @param file the file name of the program source code.
+   * @param line the line number of the program source code.
+   * @param func the function name of the program source code.
+   * @param code an error code.
+   * @param message a supplement message.
+   */
+  void set_error(const char* file, int32_t line, const char* func,
+                 Error::Code code, const char* message) {
+    _assert_(file && line > 0 && func && message);
+    error_->set(code, message);
+    if (logger_) {
+      Logger::Kind kind = code == Error::BROKEN || code == Error::SYSTEM ?
+          Logger::ERROR : Logger::INFO;
+      if (kind & logkinds_)
+        report(file, line, func, kind, "%d: %s: %s", code, Error::codename(code), message);
+    }
+  }
+  /**
+   * Open a database file.
+   * @param path the path of the whole database, which is used only for identification.
+   * @param mode the connection mode, which is given to every inner database.
+   * @return true on success, or false on failure.
+   * @note If any of the inner databases cannot be opened, the others are closed.
+   */
+  bool open(const std::string& path, uint32_t mode = OWRITER | OCREATE) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    mlock_.set_bias(mode & OREADBIAS);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    if (dbs_.empty()) {
+      set_error(_KCCODELINE_, Error::INVALID, "no shard");
+      return false;
+    }
+    report(_KCCODELINE_, Logger::DEBUG, "opening the database (path=%s)", path.c_str());
+    size_t dnum = dbs_.size();
+    for (size_t i = 0; i < dnum; i++) {
+      if (!dbs_[i]->open(paths_[i], mode)) {
+        copy_error(dbs_[i]);
+        while (i > 0) {
+          dbs_[--i]->close();
+        }
+        return false;
+      }
+    }
+    omode_ = mode;
+    path_ = path;
+    trigger_meta(MetaTrigger::OPEN, "open");
+    return true;
+  }
+  /**
+   * Close the database file.
+   * @return true on success, or false on failure.
+   */
+  bool close() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    report(_KCCODELINE_, Logger::DEBUG, "closing the database (path=%s)", path_.c_str());
+    bool err = false;
+    size_t dnum = dbs_.size();
+    for (size_t i = 0; i < dnum; i++) {
+      if (!dbs_[i]->close()) {
+        copy_error(dbs_[i]);
+        err = true;
+      }
+    }
+    omode_ = 0;
+    path_.clear();
+    trigger_meta(MetaTrigger::CLOSE, "close");
+    return !err;
+  }
+  /**
+   * Synchronize updated contents with the file and the device.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @param proc a postprocessor object.  If it is NULL, no postprocessing is performed.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note The postprocessor is called once for each shard in the order of the index with the
+   * path, the number of records, and the size of the shard.  Therefore, the database copy
+   * method copies each shard to a path made from the destination with the index of the shard.
+   */
+  bool synchronize(bool hard = false, FileProcessor* proc = NULL,
+                   ProgressChecker* checker = NULL) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    bool err = false;
+    size_t dnum = dbs_.size();
+    for (size_t i = 0; i < dnum; i++) {
+      if (!dbs_[i]->synchronize(hard, proc, checker)) {
+        copy_error(dbs_[i]);
+        err = true;
+      }
+    }
+    trigger_meta(MetaTrigger::SYNCHRONIZE, "synchronize");
+    return !err;
+  }
+  /**
+   * Occupy database by locking and do something meanwhile.
+   * @param writable true to use writer lock, or false to use reader lock.
+   * @param proc a processor object.  If it is NULL, no processing is performed.
+   * @return true on success, or false on failure.
+   * @note The operation of the processor is performed atomically and other threads accessing
+   * the same record are blocked.  To avoid deadlock, any explicit database operation must not
+   * be performed in this function.
+   */
+  bool occupy(bool writable = true, FileProcessor* proc = NULL) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, writable);
+    bool err = false;
+    if (proc && !proc->process(path_, count_impl(), size_impl())) {
+      set_error(_KCCODELINE_, Error::LOGIC, "processing failed");
+      err = true;
+    }
+    trigger_meta(MetaTrigger::OCCUPY, "occupy");
+    return !err;
+  }
+  /**
+   * Begin transaction.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @return true on success, or false on failure.
+   * @note A transaction is begun in every shard.  The shards are committed one by one, so a
+   * crash while committing may leave some of them committed.
+   */
+  bool begin_transaction(bool hard = false) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    return begin_transaction_impl(hard, false);
+  }
+  /**
+   * Try to begin transaction.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @return true on success, or false on failure.
+   */
+  bool begin_transaction_try(bool hard = false) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    return begin_transaction_impl(hard, true);
+  }
+  /**
+   * End transaction.
+   * @param commit true to commit the transaction, or false to abort the transaction.
+   * @return true on success, or false on failure.
+   */
+  bool end_transaction(bool commit = true) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    bool err = false;
+    size_t dnum = dbs_.size();
+    for (size_t i = 0; i < dnum; i++) {
+      if (!dbs_[i]->end_transaction(commit)) {
+        copy_error(dbs_[i]);
+        err = true;
+      }
+    }
+    trigger_meta(commit ? MetaTrigger::COMMITTRAN : MetaTrigger::ABORTTRAN, "end_transaction");
+    return !err;
+  }
+  /**
+   * Remove all records.
+   * @return true on success, or false on failure.
+   */
+  bool clear() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    bool err = false;
+    size_t dnum = dbs_.size();
+    for (size_t i = 0; i < dnum; i++) {
+      if (!dbs_[i]->clear()) {
+        copy_error(dbs_[i]);
+        err = true;
+      }
+    }
+    trigger_meta(MetaTrigger::CLEAR, "clear");
+    return !err;
+  }
+  /**
+   * Get the number of records.
+   * @return the number of records, or -1 on failure.
+   */
+  int64_t count() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return -1;
+    }
+    return count_impl();
+  }
+  /**
+   * Get the size of the database file.
+   * @return the size of the database file in bytes, or -1 on failure.
+   */
+  int64_t size() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return -1;
+    }
+    return size_impl();
+  }
+  /**
+   * Get the path of the database file.
+   * @return the path of the database file, or an empty string on failure.
+   */
+  std::string path() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return "";
+    }
+    return path_;
+  }
+  /**
+   * Get the miscellaneous status information.
+   * @param strmap a string map to contain the result.
+   * @return true on success, or false on failure.
+   * @note The status of the first shard is reported except that the number of records and the
+   * size are summed up over all shards.
+   */
+  bool status(std::map<std::string, std::string>* strmap) {
+    _assert_(strmap);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!dbs_.front()->status(strmap)) {
+      copy_error(dbs_.front());
+      return false;
+    }
+    (*strmap)["path"] = path_;
+    (*strmap)["count"] = strprintf("%lld", (long long)count_impl());
+    (*strmap)["size"] = strprintf("%lld", (long long)size_impl());
+    (*strmap)["shards"] = strprintf("%lld", (long long)dbs_.size());
+    return true;
+  }
+  /**
+   * Create a cursor object.
+   * @return the return value is the created cursor object.
+   * @note Because the object of the return value is allocated by the constructor, it should be
+   * released with the delete operator when it is no longer in use.
+   */
+  Cursor* cursor() {
+    _assert_(true);
+    return new Cursor(this);
+  }
+  /**
+   * Write a log message.
+   * @param file the file name of the program source code.
+   * @param line the line number of the program source code.
+   * @param func the function name of the program source code.
+   * @param kind the kind of the event.  Logger::DEBUG for debugging, Logger::INFO for normal
+   * information, Logger::WARN for warning, and Logger::ERROR for fatal error.
+   * @param message the supplement message.
+   */
+  void log(const char* file, int32_t line, const char* func, Logger::Kind kind,
+           const char* message) {
+    _assert_(file && line > 0 && func && message);
+    ScopedRWLock lock(&mlock_, false);
+    if (!logger_) return;
+    logger_->log(file, line, func, kind, message);
+  }
+  /**
+   * Set the internal logger.
+   * @param logger the logger object.
+   * @param kinds kinds of logged messages by bitwise-or: Logger::DEBUG for debugging,
+   * Logger::INFO for normal information, Logger::WARN for warning, and Logger::ERROR for fatal
+   * error.
+   * @return true on success, or false on failure.
+   */
+  bool tune_logger(Logger* logger, uint32_t kinds = Logger::WARN | Logger::ERROR) {
+    _assert_(logger);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    logger_ = logger;
+    logkinds_ = kinds;
+    return true;
+  }
+  /**
+   * Set the internal meta operation trigger.
+   * @param trigger the trigger object.
+   * @return true on success, or false on failure.
+   */
+  bool tune_meta_trigger(MetaTrigger* trigger) {
+    _assert_(trigger);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    mtrigger_ = trigger;
+    return true;
+  }
+ protected:
+  /**
+   * Report a message for debugging.
+   * @param file the file name of the program source code.
+   * @param line the line number of the program source code.
+   * @param func the function name of the program source code.
+   * @param kind the kind of the event.  Logger::DEBUG for debugging, Logger::INFO for normal
+   * information, Logger::WARN for warning, and Logger::ERROR for fatal error.
+   * @param format the printf-like format string.
+   * @param ... used according to the format string.
+   */
+  void report(const char* file, int32_t line, const char* func, Logger::Kind kind,
+              const char* format, ...) {
+    _assert_(file && line > 0 && func && format);
+    if (!logger_ || !(kind & logkinds_)) return;
+    std::string message;
+    strprintf(&message, "%s: ", path_.empty() ? "-" : path_.c_str());
+    va_list ap;
+    va_start(ap, format);
+    vstrprintf(&message, format, ap);
+    va_end(ap);
+    logger_->log(file, line, func, kind, message.c_str());
+  }
+  /**
+   * Trigger a meta database operation.
+   * @param kind the kind of the event.  MetaTrigger::OPEN for opening, MetaTrigger::CLOSE for
+   * closing, MetaTrigger::CLEAR for clearing, MetaTrigger::ITERATE for iteration,
+   * MetaTrigger::SYNCHRONIZE for synchronization, MetaTrigger::BEGINTRAN for beginning
+   * transaction, MetaTrigger::COMMITTRAN for committing transaction, MetaTrigger::ABORTTRAN
+   * for aborting transaction, and MetaTrigger::MISC for miscellaneous operations.
+   * @param message the supplement message.
+   */
+  void trigger_meta(MetaTrigger::Kind kind, const char* message) {
+    _assert_(message);
+    if (mtrigger_) mtrigger_->trigger(kind, message);
+  }
+ private:
+  /**
+   * Scoped visitor.
+   */
+  class ScopedVisitor {
+   public:
+    /** constructor */
+    explicit ScopedVisitor(Visitor* visitor) : visitor_(visitor) {
+      _assert_(visitor);
+      visitor_->visit_before();
+    }
+    /** destructor */
+    ~ScopedVisitor() {
+      _assert_(true);
+      visitor_->visit_after();
+    }
+   private:
+    Visitor* visitor_;                   ///< visitor
+  };
+  /**
+   * Visitor to forward calls to the original visitor of an operation over shards.
+   * @note The calls of visit_before and visit_after are suppressed because they are performed
+   * once by the sharded database itself.  If a lock is given, calls are serialized and the
+   * return value is copied so that it remains valid after the lock is released.
+   */
+  class ProxyVisitor : public Visitor {
+   public:
+    /** constructor */
+    explicit ProxyVisitor() : visitor_(NULL), lock_(NULL), buf_() {}
+    /** initialize the object */
+    void init(Visitor* visitor, Mutex* lock) {
+      visitor_ = visitor;
+      lock_ = lock;
+    }
+   private:
+    const char* visit_full(const char* kbuf, size_t ksiz,
+                           const char* vbuf, size_t vsiz, size_t* sp) {
+      if (!lock_) return visitor_->visit_full(kbuf, ksiz, vbuf, vsiz, sp);
+      ScopedMutex lock(lock_);
+      const char* rbuf = visitor_->visit_full(kbuf, ksiz, vbuf, vsiz, sp);
+      return keep(rbuf, *sp);
+    }
+    const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
+      if (!lock_) return visitor_->visit_empty(kbuf, ksiz, sp);
+      ScopedMutex lock(lock_);
+      const char* rbuf = visitor_->visit_empty(kbuf, ksiz, sp);
+      return keep(rbuf, *sp);
+    }
+    const char* keep(const char* rbuf, size_t rsiz) {
+      if (rbuf == NOP || rbuf == REMOVE) return rbuf;
+      buf_.assign(rbuf, rsiz);
+      return buf_.data();
+    }
+    Visitor* visitor_;                   ///< original visitor
+    Mutex* lock_;                        ///< lock for serialization
+    std::string buf_;                    ///< copy of the return value
+  };
+  /**
+   * Get the index of the shard of a key.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @return the index of the shard.
+   * @note The hash function is different from the ones used by the inner databases so that
+   * records in a shard are spread over its buckets.
+   */
+  size_t shard_index(const char* kbuf, size_t ksiz) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ);
+    return hashfnv(kbuf, ksiz) % dbs_.size();
+  }
+  /**
+   * Copy the last error of an inner database.
+   * @param db the inner database.
+   */
+  void copy_error(BasicDB* db) {
+    _assert_(db);
+    const Error& error = db->error();
+    error_->set(error.code(), error.message());
+  }
+  /**
+   * Begin transaction in every shard.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @param trial true not to wait for other transactions.
+   * @return true on success, or false on failure.
+   */
+  bool begin_transaction_impl(bool hard, bool trial) {
+    _assert_(true);
+    size_t dnum = dbs_.size();
+    for (size_t i = 0; i < dnum; i++) {
+      BasicDB* db = dbs_[i];
+      if (!(trial ? db->begin_transaction_try(hard) : db->begin_transaction(hard))) {
+        copy_error(db);
+        while (i > 0) {
+          dbs_[--i]->end_transaction(false);
+        }
+        return false;
+      }
+    }
+    trigger_meta(MetaTrigger::BEGINTRAN, "begin_transaction");
+    return true;
+  }
+  /**
+   * Get the number of records.
+   * @return the number of records, or -1 on failure.
+   */
+  int64_t count_impl() {
+    _assert_(true);
+    int64_t sum = 0;
+    size_t dnum = dbs_.size();
+    for (size_t i = 0; i < dnum; i++) {
+      int64_t cnt = dbs_[i]->count();
+      if (cnt < 0) return -1;
+      sum += cnt;
+    }
+    return sum;
+  }
+  /**
+   * Get the size of the database file.
+   * @return the size of the database file in bytes, or -1 on failure.
+   */
+  int64_t size_impl() {
+    _assert_(true);
+    int64_t sum = 0;
+    size_t dnum = dbs_.size();
+    for (size_t i = 0; i < dnum; i++) {
+      int64_t size = dbs_[i]->size();
+      if (size < 0) return -1;
+      sum += size;
+    }
+    return sum;
+  }
+  /** Dummy constructor to forbid the use. */
+  ShardDB(const ShardDB&);
+  /** Dummy Operator to forbid the use. */
+  ShardDB& operator =(const ShardDB&);
+  /** The method lock. */
+  RWLock mlock_;
+  /** The last happened error. */
+  TSD<Error> error_;
+  /** The internal logger. */
+  Logger* logger_;
+  /** The kinds of logged messages. */
+  uint32_t logkinds_;
+  /** The internal meta operation trigger. */
+  MetaTrigger* mtrigger_;
+  /** The open mode. */
+  uint32_t omode_;
+  /** The inner databases. */
+  DBArray dbs_;
+  /** The paths of the inner databases. */
+  std::vector<std::string> paths_;
+  /** The path of the database. */
+  std::string path_;
+};
+
+
+}                                        // common namespace
+
+#endif                                   // duplication check
+
+// END OF FILE
@@ -27,6 +27,8 @@
 #include <kcdb.h>
 #include <kcplantdb.h>
 
+#define KCSDBIMGMAGIC  "KCSI\n"          ///< magic data of the memory image file
+
 namespace kyotocabinet {                 // common namespace
 
 
@@ -46,10 +48,13 @@ class StashDB : public BasicDB {
  private:
   struct Record;
   struct TranLog;
+  struct CompactTable;
   class Repeater;
   class Setter;
   class Remover;
+  class Expirer;
   class ScopedVisitor;
+  class ImageWriter;
   /** An alias of list of cursors. */
   typedef std::list<Cursor*> CursorList;
   /** An alias of list of transaction logs. */
@@ -64,6 +69,32 @@ class StashDB : public BasicDB {
   static const uint32_t LOCKBUSYLOOP = 8192;
   /** The mininum number of buckets to use mmap. */
   static const size_t MAPZMAPBNUM = 32768;
+  /** The default maximum load factor of the hash table. */
+  static const int32_t DEFLFMAX = 4;
+  /** The number of old buckets migrated by each operation under resizing. */
+  static const size_t RSZSTEP = 8;
+  /** The interval in buckets of checking the load factor. */
+  static const size_t LFCHKINTV = 64;
+  /** The size of the header of the memory image. */
+  static const size_t IMGHEADSIZ = 64;
+  /** The alignment of each record in the memory image. */
+  static const size_t IMGALIGN = 8;
+  /** The unit size of the memory image IO. */
+  static const size_t IMGIOUNIT = 1 << 20;
+  /** The number of slots in a probing group of the compact layout. */
+  static const size_t CPTGROUP = 16;
+  /** The control byte of an empty slot of the compact layout. */
+  static const uint8_t CPTEMPTY = 0x80;
+  /** The control byte of a deleted slot of the compact layout. */
+  static const uint8_t CPTDELETED = 0xfe;
+  /** The size of each arena page of the compact layout. */
+  static const size_t CPTPAGESIZ = 1 << 16;
+  /** The alignment of each record in arena pages. */
+  static const size_t CPTALIGN = 8;
+  /** The maximum size of a record in arena pages. */
+  static const size_t CPTSMALLMAX = 256;
+  /** The number of groups migrated by each updating operation. */
+  static const size_t CPTMIGSTEP = 4;
  public:
   /**
    * Cursor to indicate a record.
@@ -114,7 +145,7 @@ class StashDB : public BasicDB {
         db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
         return false;
       }
-      Record rec(rbuf_);
+      Record rec(rbuf_, db_->compact_);
       size_t vsiz;
       const char* vbuf = visitor->visit_full(rec.kbuf_, rec.ksiz_, rec.vbuf_, rec.vsiz_, &vsiz);
       if (vbuf == Visitor::REMOVE) {
@@ -142,6 +173,16 @@ class StashDB : public BasicDB {
       }
       bidx_ = 0;
       rbuf_ = NULL;
+      if (db_->obuckets_) db_->finish_resizing();
+      if (db_->compact_) {
+        bidx_ = db_->cpt_next(0);
+        if (bidx_ >= 0) {
+          rbuf_ = db_->cpt_record(bidx_);
+          return true;
+        }
+        db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+        return false;
+      }
       while (bidx_ < (int64_t)db_->bnum_) {
         if (db_->buckets_[bidx_]) {
           rbuf_ = db_->buckets_[bidx_];
@@ -168,6 +209,17 @@ class StashDB : public BasicDB {
       }
       bidx_ = -1;
       rbuf_ = NULL;
+      if (db_->obuckets_) db_->finish_resizing();
+      if (db_->compact_) {
+        int64_t gidx = db_->cpt_locate(kbuf, ksiz, db_->hash_record(kbuf, ksiz));
+        if (gidx >= 0) {
+          bidx_ = gidx;
+          rbuf_ = db_->cpt_record(gidx);
+          return true;
+        }
+        db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+        return false;
+      }
       size_t bidx = db_->hash_record(kbuf, ksiz) % db_->bnum_;
       char* rbuf = db_->buckets_[bidx];
       while (rbuf) {
@@ -280,6 +332,16 @@ class StashDB : public BasicDB {
      */
     bool step_impl() {
       _assert_(true);
+      if (db_->compact_) {
+        bidx_ = db_->cpt_next(bidx_ + 1);
+        if (bidx_ < 0) {
+          db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
+          rbuf_ = NULL;
+          return false;
+        }
+        rbuf_ = db_->cpt_record(bidx_);
+        return true;
+      }
       Record rec(rbuf_);
       rbuf_ = rec.child_;
       if (!rbuf_) {
@@ -306,16 +368,29 @@ class StashDB : public BasicDB {
     /** The buffer of the current record. */
     char* rbuf_;
   };
+  /**
+   * Tuning options.
+   */
+  enum Option {
+    TSMALL = 1 << 0,                     ///< use the compact layout
+    TLINEAR = 1 << 1,                    ///< dummy for compatibility
+    TCOMPRESS = 1 << 2,                  ///< dummy for compatibility
+    TNUMA = 1 << 3                       ///< bind bucket ranges to NUMA nodes
+  };
   /**
    * Default constructor.
    */
   explicit StashDB() :
-      mlock_(), rlock_(RLOCKSLOT), flock_(), error_(),
+      mlock_(), rlock_(RLOCKSLOT), tlock_(), flock_(), xlock_(), error_(),
       logger_(NULL), logkinds_(0), mtrigger_(NULL),
-      omode_(0), curs_(), path_(""), bnum_(DEFBNUM), opaque_(),
+      omode_(0), curs_(), path_(""), opts_(0), bnum_(DEFBNUM), xtwidth_(0), opaque_(),
       count_(0), size_(0), buckets_(NULL),
+      lfmax_(DEFLFMAX), obuckets_(NULL), obnum_(0), rszidx_(0), nodenum_(0), xwheel_(NULL),
+      compact_(false), ctab_(), otab_(), migidx_(0),
+      cptpages_(), cptcur_(NULL), cptrem_(0),
       tran_(false), trlogs_(), trcount_(0), trsize_(0) {
     _assert_(true);
+    std::memset(cptfrees_, 0, sizeof(cptfrees_));
   }
   /**
    * Destructor.
@@ -347,24 +422,53 @@ class StashDB : public BasicDB {
    */
   bool accept(const char* kbuf, size_t ksiz, Visitor* visitor, bool writable = true) {
     _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
-    ScopedRWLock lock(&mlock_, false);
+    mlock_.lock_reader();
     if (omode_ == 0) {
       set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      mlock_.unlock();
       return false;
     }
     if (writable && !(omode_ & OWRITER)) {
       set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      mlock_.unlock();
       return false;
     }
+    if (compact_) {
+      if (writable) {
+        tlock_.lock_writer();
+      } else {
+        tlock_.lock_reader();
+      }
+      accept_compact(kbuf, ksiz, visitor);
+      if (writable) cpt_step();
+      tlock_.unlock();
+      mlock_.unlock();
+      return true;
+    }
     size_t bidx = hash_record(kbuf, ksiz) % bnum_;
-    size_t lidx = bidx % RLOCKSLOT;
-    if (writable) {
-      rlock_.lock_writer(lidx);
+    bool rsz = false;
+    if (obuckets_) {
+      tlock_.lock_writer();
+      accept_impl(kbuf, ksiz, visitor, bidx);
+      step_resizing(RSZSTEP);
+      rsz = rszidx_ >= obnum_;
+      tlock_.unlock();
     } else {
-      rlock_.lock_reader(lidx);
+      size_t lidx = bidx % RLOCKSLOT;
+      if (writable) {
+        rlock_.lock_writer(lidx);
+      } else {
+        rlock_.lock_reader(lidx);
+      }
+      accept_impl(kbuf, ksiz, visitor, bidx);
+      rlock_.unlock(lidx);
+      rsz = writable && lfmax_ > 0 && bidx % LFCHKINTV == 0 && count_ > bnum_ * lfmax_;
+    }
+    mlock_.unlock();
+    if (rsz && mlock_.lock_writer_try()) {
+      adjust_buckets();
+      mlock_.unlock();
     }
-    accept_impl(kbuf, ksiz, visitor, bidx);
-    rlock_.unlock(lidx);
     return true;
   }
   /**
@@ -392,6 +496,30 @@ class StashDB : public BasicDB {
     ScopedVisitor svis(visitor);
     size_t knum = keys.size();
     if (knum < 1) return true;
+    if (compact_) {
+      if (writable) {
+        tlock_.lock_writer();
+      } else {
+        tlock_.lock_reader();
+      }
+      for (size_t i = 0; i < knum; i++) {
+        const std::string& key = keys[i];
+        accept_compact(key.data(), key.size(), visitor);
+        if (writable) cpt_step();
+      }
+      tlock_.unlock();
+      return true;
+    }
+    if (obuckets_) {
+      tlock_.lock_writer();
+      for (size_t i = 0; i < knum; i++) {
+        const std::string& key = keys[i];
+        accept_impl(key.data(), key.size(), visitor, hash_record(key.data(), key.size()) % bnum_);
+        step_resizing(RSZSTEP);
+      }
+      tlock_.unlock();
+      return true;
+    }
     struct RecordKey {
       const char* kbuf;
       size_t ksiz;
@@ -457,27 +585,51 @@ class StashDB : public BasicDB {
       return false;
     }
     int64_t curcnt = 0;
-    for (size_t i = 0; i < bnum_; i++) {
-      char* rbuf = buckets_[i];
-      while (rbuf) {
+    if (obuckets_) finish_resizing();
+    if (compact_) {
+      cpt_settle();
+      for (size_t i = 0; i < ctab_.cap; i++) {
+        if (ctab_.ctrls[i] >= CPTEMPTY) continue;
         curcnt++;
-        Record rec(rbuf);
-        rbuf = rec.child_;
+        Record rec(ctab_.slots[i], true);
         size_t vsiz;
         const char* vbuf = visitor->visit_full(rec.kbuf_, rec.ksiz_,
                                                rec.vbuf_, rec.vsiz_, &vsiz);
         if (vbuf == Visitor::REMOVE) {
           Repeater repeater(Visitor::REMOVE, 0);
-          accept_impl(rec.kbuf_, rec.ksiz_, &repeater, i);
+          accept_compact(rec.kbuf_, rec.ksiz_, &repeater);
         } else if (vbuf != Visitor::NOP) {
           Repeater repeater(vbuf, vsiz);
-          accept_impl(rec.kbuf_, rec.ksiz_, &repeater, i);
+          accept_compact(rec.kbuf_, rec.ksiz_, &repeater);
         }
         if (checker && !checker->check("iterate", "processing", curcnt, allcnt)) {
           set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
           return false;
         }
       }
+    } else {
+      for (size_t i = 0; i < bnum_; i++) {
+        char* rbuf = buckets_[i];
+        while (rbuf) {
+          curcnt++;
+          Record rec(rbuf);
+          rbuf = rec.child_;
+          size_t vsiz;
+          const char* vbuf = visitor->visit_full(rec.kbuf_, rec.ksiz_,
+                                                 rec.vbuf_, rec.vsiz_, &vsiz);
+          if (vbuf == Visitor::REMOVE) {
+            Repeater repeater(Visitor::REMOVE, 0);
+            accept_impl(rec.kbuf_, rec.ksiz_, &repeater, i);
+          } else if (vbuf != Visitor::NOP) {
+            Repeater repeater(vbuf, vsiz);
+            accept_impl(rec.kbuf_, rec.ksiz_, &repeater, i);
+          }
+          if (checker && !checker->check("iterate", "processing", curcnt, allcnt)) {
+            set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+            return false;
+          }
+        }
+      }
     }
     if (checker && !checker->check("iterate", "ending", -1, allcnt)) {
       set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
@@ -505,7 +657,8 @@ class StashDB : public BasicDB {
     }
     if (thnum < 1) thnum = 1;
     if (thnum > (size_t)INT8MAX) thnum = INT8MAX;
-    if (thnum > bnum_) thnum = bnum_;
+    size_t snum = compact_ ? otab_.cap + ctab_.cap : bnum_;
+    if (thnum > snum) thnum = snum;
     ScopedVisitor svis(visitor);
     int64_t allcnt = count_;
     if (checker && !checker->check("scan_parallel", "beginning", 0, allcnt)) {
@@ -536,6 +689,21 @@ class StashDB : public BasicDB {
         ProgressChecker* checker = checker_;
         int64_t allcnt = allcnt_;
         size_t endidx = endidx_;
+        if (db->compact_) {
+          for (size_t i = begidx_; i < endidx; i++) {
+            char* rbuf = db->cpt_record(i);
+            if (!rbuf) continue;
+            Record rec(rbuf, true);
+            size_t vsiz;
+            visitor->visit_full(rec.kbuf_, rec.ksiz_, rec.vbuf_, rec.vsiz_, &vsiz);
+            if (checker && !checker->check("scan_parallel", "processing", -1, allcnt)) {
+              db->set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+              error_ = db->error();
+              break;
+            }
+          }
+          return;
+        }
         char** buckets = db->buckets_;
         for (size_t i = begidx_; i < endidx; i++) {
           char* rbuf = buckets[i];
@@ -561,14 +729,22 @@ class StashDB : public BasicDB {
       Error error_;
     };
     bool err = false;
-    rlock_.lock_reader_all();
+    bool rsz = obuckets_ != NULL;
+    if (compact_) {
+      tlock_.lock_reader();
+    } else if (rsz) {
+      tlock_.lock_writer();
+      step_resizing(obnum_);
+    } else {
+      rlock_.lock_reader_all();
+    }
     ThreadImpl* threads = new ThreadImpl[thnum];
-    double range = (double)bnum_ / thnum;
+    double range = (double)snum / thnum;
     for (size_t i = 0; i < thnum; i++) {
       size_t cidx = i * range;
       size_t nidx = (i + 1) * range;
       if (i < 1) cidx = 0;
-      if (i >= thnum - 1) nidx = bnum_;
+      if (i >= thnum - 1) nidx = snum;
       ThreadImpl* thread = threads + i;
       thread->init(this, visitor, checker, allcnt, cidx, nidx);
       thread->start();
@@ -582,7 +758,11 @@ class StashDB : public BasicDB {
       }
     }
     delete[] threads;
-    rlock_.unlock_all();
+    if (compact_ || rsz) {
+      tlock_.unlock();
+    } else {
+      rlock_.unlock_all();
+    }
     if (err) return false;
     if (checker && !checker->check("scan_parallel", "ending", -1, allcnt)) {
       set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
@@ -632,6 +812,8 @@ class StashDB : public BasicDB {
    * StashDB::OTRYLOCK, which means locking is performed without blocking, StashDB::ONOREPAIR,
    * which means the database file is not repaired implicitly even if file destruction is
    * detected.
+   * StashDB::OREADBIAS may also be added to bias the lock of the database object to readers,
+   * which makes reading operations cheaper and updating operations dearer.
    * @return true on success, or false on failure.
    * @note Every opened database must be closed by the StashDB::close method when it is no
    * longer in use.  It is not allowed for two or more database objects in the same process to
@@ -640,6 +822,7 @@ class StashDB : public BasicDB {
   bool open(const std::string& path, uint32_t mode = OWRITER | OCREATE) {
     _assert_(true);
     ScopedRWLock lock(&mlock_, true);
+    mlock_.set_bias(mode & OREADBIAS);
     if (omode_ != 0) {
       set_error(_KCCODELINE_, Error::INVALID, "already opened");
       return false;
@@ -647,14 +830,16 @@ class StashDB : public BasicDB {
     report(_KCCODELINE_, Logger::DEBUG, "opening the database (path=%s)", path.c_str());
     omode_ = mode;
     path_.append(path);
-    if (bnum_ >= MAPZMAPBNUM) {
-      buckets_ = (char**)mapalloc(sizeof(*buckets_) * bnum_);
-    } else {
-      buckets_ = new char*[bnum_];
-      for (size_t i = 0; i < bnum_; i++) {
-        buckets_[i] = NULL;
-      }
-    }
+    compact_ = opts_ & TSMALL;
+    nodenum_ = (opts_ & TNUMA) && !compact_ ? numanodes() : 0;
+    if (nodenum_ < 2) nodenum_ = 0;
+    if (nodenum_ > 0)
+      report(_KCCODELINE_, Logger::INFO, "binding buckets to NUMA nodes (nodenum=%d)",
+             (int)nodenum_);
+    create_buckets();
+    count_ = 0;
+    size_ = 0;
+    xwheel_ = xtwidth_ > 0 ? new TimerWheel(std::time(NULL)) : NULL;
     std::memset(opaque_, 0, sizeof(opaque_));
     trigger_meta(MetaTrigger::OPEN, "open");
     return true;
@@ -673,20 +858,9 @@ class StashDB : public BasicDB {
     report(_KCCODELINE_, Logger::DEBUG, "closing the database (path=%s)", path_.c_str());
     tran_ = false;
     trlogs_.clear();
-    for (size_t i = 0; i < bnum_; i++) {
-      char* rbuf = buckets_[i];
-      while (rbuf) {
-        Record rec(rbuf);
-        char* child = rec.child_;
-        delete[] rbuf;
-        rbuf = child;
-      }
-    }
-    if (bnum_ >= MAPZMAPBNUM) {
-      mapfree(buckets_);
-    } else {
-      delete[] buckets_;
-    }
+    destroy_buckets();
+    delete xwheel_;
+    xwheel_ = NULL;
     path_.clear();
     omode_ = 0;
     trigger_meta(MetaTrigger::CLOSE, "close");
@@ -857,7 +1031,13 @@ class StashDB : public BasicDB {
       return false;
     }
     disable_cursors();
-    if (count_ > 0) {
+    if (obuckets_) finish_resizing();
+    if (compact_) {
+      destroy_buckets();
+      create_buckets();
+      count_ = 0;
+      size_ = 0;
+    } else if (count_ > 0) {
       for (size_t i = 0; i < bnum_; i++) {
         char* rbuf = buckets_[i];
         while (rbuf) {
@@ -871,6 +1051,7 @@ class StashDB : public BasicDB {
       count_ = 0;
       size_ = 0;
     }
+    if (xwheel_) xwheel_->clear(std::time(NULL));
     std::memset(opaque_, 0, sizeof(opaque_));
     trigger_meta(MetaTrigger::CLEAR, "clear");
     return true;
@@ -929,15 +1110,26 @@ class StashDB : public BasicDB {
     (*strmap)["type"] = strprintf("%u", (unsigned)TYPESTASH);
     (*strmap)["realtype"] = strprintf("%u", (unsigned)TYPESTASH);
     (*strmap)["path"] = path_;
+    (*strmap)["opts"] = strprintf("%u", opts_);
+    (*strmap)["bnum"] = strprintf("%lld", (long long)(compact_ ? ctab_.cap : bnum_));
     if (strmap->count("opaque") > 0)
       (*strmap)["opaque"] = std::string(opaque_, sizeof(opaque_));
     if (strmap->count("bnum_used") > 0) {
       int64_t cnt = 0;
-      for (size_t i = 0; i < bnum_; i++) {
-        if (buckets_[i]) cnt++;
+      if (compact_) {
+        for (size_t i = 0; i < ctab_.cap; i++) {
+          if (ctab_.ctrls[i] < CPTEMPTY) cnt++;
+        }
+      } else {
+        for (size_t i = 0; i < bnum_; i++) {
+          if (buckets_[i]) cnt++;
+        }
       }
       (*strmap)["bnum_used"] = strprintf("%lld", (long long)cnt);
     }
+    (*strmap)["lfmax"] = strprintf("%.3f", lfmax_);
+    (*strmap)["rsznum"] = strprintf("%d", obuckets_ != NULL);
+    (*strmap)["rszrem"] = strprintf("%lld", (long long)(obnum_ - rszidx_));
     (*strmap)["count"] = strprintf("%lld", (long long)count_);
     (*strmap)["size"] = strprintf("%lld", (long long)size_impl());
     return true;
@@ -1002,6 +1194,34 @@ class StashDB : public BasicDB {
     mtrigger_ = trigger;
     return true;
   }
+  /**
+   * Set the optional features.
+   * @param opts the optional features by bitwise-or: StashDB::TSMALL to use the compact layout,
+   * StashDB::TNUMA to bind contiguous ranges of the bucket array to NUMA nodes.  TNUMA has no
+   * effect in the compact layout or on systems with a single node.
+   * @return true on success, or false on failure.
+   * @note TNUMA binds only the bucket array.  Records are allocated from the process heap and
+   * are placed wherever the memory allocator puts them.
+   * @note The compact layout replaces the chained buckets with an open-addressing table of
+   * one-byte tags probed by groups, and packs small records into shared pages without any
+   * per-record header.  The table grows incrementally and the bucket number is used as its
+   * initial capacity.
+   * @note The compact layout is single-writer.  Every updating operation takes the lock of the
+   * whole table, so updating operations of multiple threads are serialized and their
+   * throughput does not grow with the number of threads.  Reading operations are performed in
+   * parallel.  The default layout, whose records are guarded by slotted locks, should be used
+   * for workloads updating records from many threads.
+   */
+  bool tune_options(int8_t opts) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    opts_ = opts;
+    return true;
+  }
   /**
    * Set the number of buckets of the hash table.
    * @param bnum the number of buckets of the hash table.
@@ -1018,6 +1238,102 @@ class StashDB : public BasicDB {
     if (bnum_ > (size_t)INT16MAX) bnum_ = nearbyprime(bnum_);
     return true;
   }
+  /**
+   * Set the maximum load factor of the hash table.
+   * @param lfmax the maximum number of records per bucket.  If it is not more than 0, the hash
+   * table is never resized.
+   * @return true on success, or false on failure.
+   * @note When the load factor exceeds the limit, the bucket array is enlarged and records are
+   * rehashed incrementally by subsequent operations.  The load factor is checked only by the
+   * updating operations on some of the buckets, so it may exceed the limit a little.  This is
+   * not applied to the compact layout, whose probing table grows by itself.
+   */
+  bool tune_load_factor(double lfmax) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    lfmax_ = lfmax;
+    return true;
+  }
+  /**
+   * Set the width of the expiration time embedded in record values.
+   * @param width the width of the expiration time.  If it is positive, each record value whose
+   * size is not less than the width is regarded to begin with the expiration time in seconds
+   * of the epoch, stored as a big-endian integer.  Records whose expiration time is the maximum
+   * value of the width never expire.
+   * @return true on success, or false on failure.
+   * @note Expiration times are tracked in a timer wheel and expired records are removed by the
+   * expire_records method.
+   */
+  bool tune_expiration(int32_t width) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    xtwidth_ = width > (int32_t)sizeof(int64_t) ? (int32_t)sizeof(int64_t) : width;
+    return true;
+  }
+  /**
+   * Remove expired records.
+   * @param max the maximum number of records to be removed.
+   * @return true on success, or false on failure.
+   * @note This function does nothing unless the width of the expiration time is set by the
+   * tune_expiration method.  Expired records are taken out of the timer wheel without scanning
+   * the database.
+   */
+  bool expire_records(int64_t max = INT64MAX) {
+    _assert_(max >= 0);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!(omode_ & OWRITER)) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    if (!xwheel_) return true;
+    int64_t ct = std::time(NULL);
+    std::vector<uint64_t> hashes;
+    xlock_.lock();
+    xwheel_->expire(ct, max, &hashes);
+    xlock_.unlock();
+    std::vector<uint64_t>::iterator it = hashes.begin();
+    std::vector<uint64_t>::iterator itend = hashes.end();
+    while (it != itend) {
+      int64_t xt = expire_hash(*it, ct);
+      if (xt >= 0) {
+        ScopedSpinLock xlock(&xlock_);
+        xwheel_->set(*it, xt);
+      }
+      ++it;
+    }
+    return true;
+  }
+  /**
+   * Get the time when expired records should be removed next.
+   * @return the time in seconds of the epoch from which the expire_records method removes any
+   * record, INT64MAX if no record will expire, or -1 on failure.
+   * @note The time is taken from the timer wheel without scanning the database, so that a
+   * timer can call this function and then the expire_records method to reclaim expired records
+   * without waiting for further updates.
+   */
+  int64_t expiration_deadline() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return -1;
+    }
+    if (!xwheel_) return INT64MAX;
+    ScopedSpinLock xlock(&xlock_);
+    return xwheel_->deadline();
+  }
   /**
    * Get the opaque data.
    * @return the pointer to the opaque data region, whose size is 16 bytes.
@@ -1048,100 +1364,461 @@ class StashDB : public BasicDB {
     }
     return true;
   }
- protected:
-  /**
-   * Report a message for debugging.
-   * @param file the file name of the program source code.
-   * @param line the line number of the program source code.
-   * @param func the function name of the program source code.
-   * @param kind the kind of the event.  Logger::DEBUG for debugging, Logger::INFO for normal
-   * information, Logger::WARN for warning, and Logger::ERROR for fatal error.
-   * @param format the printf-like format string.
-   * @param ... used according to the format string.
-   */
-  void report(const char* file, int32_t line, const char* func, Logger::Kind kind,
-              const char* format, ...) {
-    _assert_(file && line > 0 && func && format);
-    if (!logger_ || !(kind & logkinds_)) return;
-    std::string message;
-    strprintf(&message, "%s: ", path_.empty() ? "-" : path_.c_str());
-    va_list ap;
-    va_start(ap, format);
-    vstrprintf(&message, format, ap);
-    va_end(ap);
-    logger_->log(file, line, func, kind, message.c_str());
-  }
-  /**
-   * Report a message for debugging with variable number of arguments.
-   * @param file the file name of the program source code.
-   * @param line the line number of the program source code.
-   * @param func the function name of the program source code.
-   * @param kind the kind of the event.  Logger::DEBUG for debugging, Logger::INFO for normal
-   * information, Logger::WARN for warning, and Logger::ERROR for fatal error.
-   * @param format the printf-like format string.
-   * @param ap used according to the format string.
-   */
-  void report_valist(const char* file, int32_t line, const char* func, Logger::Kind kind,
-                     const char* format, va_list ap) {
-    _assert_(file && line > 0 && func && format);
-    if (!logger_ || !(kind & logkinds_)) return;
-    std::string message;
-    strprintf(&message, "%s: ", path_.empty() ? "-" : path_.c_str());
-    vstrprintf(&message, format, ap);
-    logger_->log(file, line, func, kind, message.c_str());
-  }
-  /**
-   * Report the content of a binary buffer for debugging.
-   * @param file the file name of the epicenter.
-   * @param line the line number of the epicenter.
-   * @param func the function name of the program source code.
-   * @param kind the kind of the event.  Logger::DEBUG for debugging, Logger::INFO for normal
-   * information, Logger::WARN for warning, and Logger::ERROR for fatal error.
-   * @param name the name of the information.
-   * @param buf the binary buffer.
-   * @param size the size of the binary buffer
-   */
-  void report_binary(const char* file, int32_t line, const char* func, Logger::Kind kind,
-                     const char* name, const char* buf, size_t size) {
-    _assert_(file && line > 0 && func && name && buf && size <= MEMMAXSIZ);
-    if (!logger_) return;
-    char* hex = hexencode(buf, size);
-    report(file, line, func, kind, "%s=%s", name, hex);
-    delete[] hex;
-  }
   /**
-   * Trigger a meta database operation.
-   * @param kind the kind of the event.  MetaTrigger::OPEN for opening, MetaTrigger::CLOSE for
-   * closing, MetaTrigger::CLEAR for clearing, MetaTrigger::ITERATE for iteration,
-   * MetaTrigger::SYNCHRONIZE for synchronization, MetaTrigger::BEGINTRAN for beginning
-   * transaction, MetaTrigger::COMMITTRAN for committing transaction, MetaTrigger::ABORTTRAN
-   * for aborting transaction, and MetaTrigger::MISC for miscellaneous operations.
-   * @param message the supplement message.
+   * Get the NUMA node to which the bucket of a record is bound.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @return the index of the node, or -1 if the database is not bound to NUMA nodes.
+   * @note Threads running on the node access the bucket without crossing the interconnect.
+   * The records chained from the bucket are not bound to the node.
    */
-  void trigger_meta(MetaTrigger::Kind kind, const char* message) {
-    _assert_(message);
-    if (mtrigger_) mtrigger_->trigger(kind, message);
+  int32_t numa_node(const char* kbuf, size_t ksiz) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0 || nodenum_ < 1) return -1;
+    return hash_record(kbuf, ksiz) % bnum_ * nodenum_ / bnum_;
   }
- private:
   /**
-   * Record data.
+   * Dump the memory image of the database into a file.
+   * @param dest the path of the destination file.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note The image keeps the bucket array and the order of every chain, or the probing table
+   * in the compact layout, as they are, so that the StashDB::load_image method can restore them
+   * without rehashing.  The image depends on the architecture of the host and on the layout.
+   * The whole operation is performed atomically and other threads are blocked.
    */
-  struct Record {
-    /** constructor */
-    Record(char* child, const char* kbuf, uint64_t ksiz, const char* vbuf, uint64_t vsiz) :
-        child_(child), kbuf_(kbuf), ksiz_(ksiz), vbuf_(vbuf), vsiz_(vsiz) {
-      _assert_(kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ);
+  bool dump_image(const std::string& dest, ProgressChecker* checker = NULL) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
     }
-    /** constructor */
-    Record(const char* rbuf) :
-        child_(NULL), kbuf_(NULL), ksiz_(0), vbuf_(NULL), vsiz_(0) {
-      _assert_(rbuf);
-      deserialize(rbuf);
+    if (tran_) {
+      set_error(_KCCODELINE_, Error::LOGIC, "competition avoided");
+      return false;
     }
-    /** overwrite the buffer */
-    void overwrite(char* rbuf, const char* vbuf, size_t vsiz) {
-      _assert_(rbuf && vbuf && vsiz <= MEMMAXSIZ);
-      char* wp = rbuf + sizeof(child_) + sizevarnum(ksiz_) + ksiz_;
+    int64_t allcnt = count_;
+    if (checker && !checker->check("dump_image", "beginning", 0, allcnt)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      return false;
+    }
+    if (compact_) cpt_settle();
+    if (obuckets_) finish_resizing();
+    int64_t rsiz = 0;
+    if (compact_) {
+      for (size_t i = 0; i < ctab_.cap; i++) {
+        if (ctab_.ctrls[i] >= CPTEMPTY) continue;
+        Record rec(ctab_.slots[i], true);
+        rsiz += image_record_size(rec);
+      }
+    } else {
+      for (size_t i = 0; i < bnum_; i++) {
+        char* rbuf = buckets_[i];
+        while (rbuf) {
+          Record rec(rbuf);
+          rsiz += image_record_size(rec);
+          rbuf = rec.child_;
+        }
+      }
+    }
+    File file;
+    if (!file.open(dest, File::OWRITER | File::OCREATE | File::OTRUNCATE)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+      return false;
+    }
+    bool err = false;
+    ImageWriter writer(&file);
+    char head[IMGHEADSIZ];
+    std::memset(head, 0, sizeof(head));
+    std::memcpy(head, KCSDBIMGMAGIC, sizeof(KCSDBIMGMAGIC));
+    head[sizeof(KCSDBIMGMAGIC)] = sizeof(void*);
+    head[sizeof(KCSDBIMGMAGIC)+1] = opts_;
+    writefixnum(head + 8, compact_ ? ctab_.cap : bnum_, sizeof(uint64_t));
+    writefixnum(head + 16, count_, sizeof(uint64_t));
+    writefixnum(head + 24, size_, sizeof(uint64_t));
+    writefixnum(head + 32, rsiz, sizeof(uint64_t));
+    std::memcpy(head + 40, opaque_, sizeof(opaque_));
+    if (!writer.write(head, sizeof(head))) err = true;
+    char pad[IMGALIGN];
+    std::memset(pad, 0, sizeof(pad));
+    int64_t curcnt = 0;
+    if (compact_) {
+      for (size_t i = 0; !err && i < ctab_.cap; i++) {
+        if (ctab_.ctrls[i] >= CPTEMPTY) continue;
+        char* rbuf = ctab_.slots[i];
+        Record rec(rbuf, true);
+        uint64_t ssiz = image_record_size(rec) - sizeof(ssiz);
+        size_t dsiz = rec.compact_size();
+        if (!writer.write(&ssiz, sizeof(ssiz)) || !writer.write(rbuf, dsiz) ||
+            !writer.write(pad, ssiz - dsiz)) err = true;
+        curcnt++;
+        if (checker && !checker->check("dump_image", "processing", curcnt, allcnt)) {
+          set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+          err = true;
+        }
+      }
+      uint64_t rnum = 0;
+      for (size_t i = 0; !err && i < ctab_.cap; i++) {
+        uint64_t ent = ctab_.ctrls[i] < CPTEMPTY ? ++rnum : 0;
+        if (!writer.write(&ent, sizeof(ent))) err = true;
+      }
+      if (!err && !writer.write(ctab_.ctrls, ctab_.cap)) err = true;
+    } else {
+      for (size_t i = 0; !err && i < bnum_; i++) {
+        char* rbuf = buckets_[i];
+        while (!err && rbuf) {
+          Record rec(rbuf);
+          uint64_t ssiz = image_record_size(rec) - sizeof(ssiz);
+          size_t dsiz = sizeof(rec.child_) + sizevarnum(rec.ksiz_) + rec.ksiz_ +
+              sizevarnum(rec.vsiz_) + rec.vsiz_;
+          char* link = rec.child_ ? (char*)1 : NULL;
+          if (!writer.write(&ssiz, sizeof(ssiz)) || !writer.write(&link, sizeof(link)) ||
+              !writer.write(rbuf + sizeof(link), dsiz - sizeof(link)) ||
+              !writer.write(pad, ssiz - dsiz)) err = true;
+          curcnt++;
+          if (checker && !checker->check("dump_image", "processing", curcnt, allcnt)) {
+            set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+            err = true;
+          }
+          rbuf = rec.child_;
+        }
+      }
+      uint64_t rnum = 0;
+      for (size_t i = 0; !err && i < bnum_; i++) {
+        char* rbuf = buckets_[i];
+        uint64_t ent = rbuf ? rnum + 1 : 0;
+        if (!writer.write(&ent, sizeof(ent))) err = true;
+        while (rbuf) {
+          Record rec(rbuf);
+          rnum++;
+          rbuf = rec.child_;
+        }
+      }
+    }
+    if (!err && !writer.flush()) err = true;
+    if (err && writer.error()) set_error(_KCCODELINE_, Error::SYSTEM, writer.error());
+    if (!file.close()) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+      err = true;
+    }
+    if (!err && checker && !checker->check("dump_image", "ending", -1, allcnt)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      err = true;
+    }
+    trigger_meta(MetaTrigger::MISC, "dump_image");
+    return !err;
+  }
+  /**
+   * Load the memory image of the database from a file.
+   * @param src the path of the source file, which is made by the StashDB::dump_image method.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note All existing records are removed and replaced with the ones in the image.  The
+   * bucket number of the image has priority over the tuning parameter.  The image file is
+   * mapped into memory and records are copied from it with fixing up their pointers.  The whole
+   * operation is performed atomically and other threads are blocked.
+   */
+  bool load_image(const std::string& src, ProgressChecker* checker = NULL) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!(omode_ & OWRITER)) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    if (tran_) {
+      set_error(_KCCODELINE_, Error::LOGIC, "competition avoided");
+      return false;
+    }
+    File::Status sbuf;
+    if (!File::status(src, &sbuf) || sbuf.isdir) {
+      set_error(_KCCODELINE_, Error::NOREPOS, "open failed (file not found)");
+      return false;
+    }
+    File file;
+    if (!file.open(src, File::OREADER, sbuf.size)) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+      return false;
+    }
+    char head[IMGHEADSIZ];
+    if (!file.read(0, head, sizeof(head))) {
+      set_error(_KCCODELINE_, Error::INVALID, "missing magic data of the file");
+      file.close();
+      return false;
+    }
+    if (std::memcmp(head, KCSDBIMGMAGIC, sizeof(KCSDBIMGMAGIC)) ||
+        head[sizeof(KCSDBIMGMAGIC)] != (char)sizeof(void*)) {
+      set_error(_KCCODELINE_, Error::INVALID, "invalid magic data of the file");
+      file.close();
+      return false;
+    }
+    if (((head[sizeof(KCSDBIMGMAGIC)+1] & TSMALL) != 0) != compact_) {
+      set_error(_KCCODELINE_, Error::INVALID, "incompatible options");
+      file.close();
+      return false;
+    }
+    uint64_t bnum = readfixnum(head + 8, sizeof(uint64_t));
+    uint64_t rnum = readfixnum(head + 16, sizeof(uint64_t));
+    int64_t size = readfixnum(head + 24, sizeof(uint64_t));
+    int64_t rsiz = readfixnum(head + 32, sizeof(uint64_t));
+    int64_t off = sizeof(head);
+    int64_t fsiz = file.size();
+    int64_t esiz = compact_ ? sizeof(uint64_t) + 1 : sizeof(uint64_t);
+    if (bnum < 1 || rsiz < 0 || rnum > (uint64_t)rsiz / (sizeof(uint64_t) + sizeof(char*)) ||
+        off + rsiz > fsiz || (fsiz - off - rsiz) / esiz < (int64_t)bnum ||
+        (compact_ && (bnum < CPTGROUP || (bnum & (bnum - 1)) != 0))) {
+      set_error(_KCCODELINE_, Error::BROKEN, "invalid meta data");
+      file.close();
+      return false;
+    }
+    if (checker && !checker->check("load_image", "beginning", 0, rnum)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      file.close();
+      return false;
+    }
+    disable_cursors();
+    destroy_buckets();
+    if (xwheel_) xwheel_->clear(std::time(NULL));
+    if (compact_) {
+      cpt_create_table(&ctab_, bnum);
+    } else {
+      bnum_ = bnum;
+      create_buckets();
+    }
+    count_ = 0;
+    size_ = 0;
+    char** recs = new char*[rnum+1];
+    recs[0] = NULL;
+    uint64_t lnum = 0;
+    int64_t rend = off + rsiz;
+    bool err = false;
+    while (lnum < rnum) {
+      uint64_t ssiz;
+      if (off + (int64_t)sizeof(ssiz) > rend || !file.read(off, &ssiz, sizeof(ssiz)) ||
+          ssiz < sizeof(char*) || off + (int64_t)(sizeof(ssiz) + ssiz) > rend) {
+        set_error(_KCCODELINE_, Error::BROKEN, "too short record region");
+        err = true;
+        break;
+      }
+      char* rbuf = compact_ ? cpt_alloc(ssiz) : new char[ssiz];
+      if (!file.read(off + sizeof(ssiz), rbuf, ssiz)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+        if (compact_) {
+          cpt_free_region(rbuf, ssiz);
+        } else {
+          delete[] rbuf;
+        }
+        err = true;
+        break;
+      }
+      if (compact_ && cpt_align(Record(rbuf, true).compact_size()) != ssiz) {
+        set_error(_KCCODELINE_, Error::BROKEN, "invalid record data");
+        cpt_free_region(rbuf, ssiz);
+        err = true;
+        break;
+      }
+      recs[++lnum] = rbuf;
+      off += sizeof(ssiz) + ssiz;
+      if (checker && !checker->check("load_image", "processing", lnum, rnum)) {
+        set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+        err = true;
+        break;
+      }
+    }
+    off = sizeof(head) + rsiz;
+    if (!err && compact_) {
+      for (size_t i = 0; i < ctab_.cap; i++) {
+        uint64_t ent;
+        if (!file.read(off, &ent, sizeof(ent))) {
+          set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+          err = true;
+          break;
+        }
+        if (ent > rnum) {
+          set_error(_KCCODELINE_, Error::BROKEN, "invalid bucket data");
+          err = true;
+          break;
+        }
+        ctab_.slots[i] = recs[ent];
+        off += sizeof(ent);
+      }
+      if (!err && !file.read(off, ctab_.ctrls, ctab_.cap)) {
+        set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+        err = true;
+      }
+      for (size_t i = 0; !err && i < ctab_.cap; i++) {
+        if ((ctab_.ctrls[i] < CPTEMPTY) != (ctab_.slots[i] != NULL)) {
+          set_error(_KCCODELINE_, Error::BROKEN, "invalid bucket data");
+          err = true;
+          break;
+        }
+        if (ctab_.ctrls[i] != CPTEMPTY) ctab_.used++;
+      }
+    } else if (!err) {
+      for (uint64_t i = 1; i <= rnum; i++) {
+        char** linkp = (char**)recs[i];
+        *linkp = *linkp && i < rnum ? recs[i+1] : NULL;
+      }
+      for (size_t i = 0; i < bnum_; i++) {
+        uint64_t ent;
+        if (!file.read(off, &ent, sizeof(ent))) {
+          set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+          err = true;
+          break;
+        }
+        if (ent > rnum) {
+          set_error(_KCCODELINE_, Error::BROKEN, "invalid bucket data");
+          err = true;
+          break;
+        }
+        buckets_[i] = recs[ent];
+        off += sizeof(ent);
+      }
+    }
+    if (err && compact_) {
+      std::memset(ctab_.ctrls, CPTEMPTY, ctab_.cap);
+      std::memset(ctab_.slots, 0, sizeof(*ctab_.slots) * ctab_.cap);
+      ctab_.used = 0;
+      for (uint64_t i = 1; i <= lnum; i++) {
+        cpt_free(recs[i]);
+      }
+    } else if (err) {
+      for (size_t i = 0; i < bnum_; i++) {
+        buckets_[i] = NULL;
+      }
+      for (uint64_t i = 1; i <= lnum; i++) {
+        delete[] recs[i];
+      }
+    } else {
+      count_ = rnum;
+      size_ = size;
+      std::memcpy(opaque_, head + 40, sizeof(opaque_));
+      for (uint64_t i = 1; xwheel_ && i <= rnum; i++) {
+        Record rec(recs[i], compact_);
+        track_expiration(rec.kbuf_, rec.ksiz_, rec.vbuf_, rec.vsiz_);
+      }
+    }
+    delete[] recs;
+    if (!file.close()) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file.error());
+      err = true;
+    }
+    if (!err && checker && !checker->check("load_image", "ending", -1, rnum)) {
+      set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+      err = true;
+    }
+    trigger_meta(MetaTrigger::MISC, "load_image");
+    return !err;
+  }
+ protected:
+  /**
+   * Report a message for debugging.
+   * @param file the file name of the program source code.
+   * @param line the line number of the program source code.
+   * @param func the function name of the program source code.
+   * @param kind the kind of the event.  Logger::DEBUG for debugging, Logger::INFO for normal
+   * information, Logger::WARN for warning, and Logger::ERROR for fatal error.
+   * @param format the printf-like format string.
+   * @param ... used according to the format string.
+   */
+  void report(const char* file, int32_t line, const char* func, Logger::Kind kind,
+              const char* format, ...) {
+    _assert_(file && line > 0 && func && format);
+    if (!logger_ || !(kind & logkinds_)) return;
+    std::string message;
+    strprintf(&message, "%s: ", path_.empty() ? "-" : path_.c_str());
+    va_list ap;
+    va_start(ap, format);
+    vstrprintf(&message, format, ap);
+    va_end(ap);
+    logger_->log(file, line, func, kind, message.c_str());
+  }
+  /**
+   * Report a message for debugging with variable number of arguments.
+   * @param file the file name of the program source code.
+   * @param line the line number of the program source code.
+   * @param func the function name of the program source code.
+   * @param kind the kind of the event.  Logger::DEBUG for debugging, Logger::INFO for normal
+   * information, Logger::WARN for warning, and Logger::ERROR for fatal error.
+   * @param format the printf-like format string.
+   * @param ap used according to the format string.
+   */
+  void report_valist(const char* file, int32_t line, const char* func, Logger::Kind kind,
+                     const char* format, va_list ap) {
+    _assert_(file && line > 0 && func && format);
+    if (!logger_ || !(kind & logkinds_)) return;
+    std::string message;
+    strprintf(&message, "%s: ", path_.empty() ? "-" : path_.c_str());
+    vstrprintf(&message, format, ap);
+    logger_->log(file, line, func, kind, message.c_str());
+  }
+  /**
+   * Report the content of a binary buffer for debugging.
+   * @param file the file name of the epicenter.
+   * @param line the line number of the epicenter.
+   * @param func the function name of the program source code.
+   * @param kind the kind of the event.  Logger::DEBUG for debugging, Logger::INFO for normal
+   * information, Logger::WARN for warning, and Logger::ERROR for fatal error.
+   * @param name the name of the information.
+   * @param buf the binary buffer.
+   * @param size the size of the binary buffer
+   */
+  void report_binary(const char* file, int32_t line, const char* func, Logger::Kind kind,
+                     const char* name, const char* buf, size_t size) {
+    _assert_(file && line > 0 && func && name && buf && size <= MEMMAXSIZ);
+    if (!logger_) return;
+    char* hex = hexencode(buf, size);
+    report(file, line, func, kind, "%s=%s", name, hex);
+    delete[] hex;
+  }
+  /**
+   * Trigger a meta database operation.
+   * @param kind the kind of the event.  MetaTrigger::OPEN for opening, MetaTrigger::CLOSE for
+   * closing, MetaTrigger::CLEAR for clearing, MetaTrigger::ITERATE for iteration,
+   * MetaTrigger::SYNCHRONIZE for synchronization, MetaTrigger::BEGINTRAN for beginning
+   * transaction, MetaTrigger::COMMITTRAN for committing transaction, MetaTrigger::ABORTTRAN
+   * for aborting transaction, and MetaTrigger::MISC for miscellaneous operations.
+   * @param message the supplement message.
+   */
+  void trigger_meta(MetaTrigger::Kind kind, const char* message) {
+    _assert_(message);
+    if (mtrigger_) mtrigger_->trigger(kind, message);
+  }
+ private:
+  /**
+   * Record data.
+   */
+  struct Record {
+    /** constructor */
+    Record(char* child, const char* kbuf, uint64_t ksiz, const char* vbuf, uint64_t vsiz) :
+        child_(child), kbuf_(kbuf), ksiz_(ksiz), vbuf_(vbuf), vsiz_(vsiz) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ);
+    }
+    /** constructor */
+    Record(const char* rbuf) :
+        child_(NULL), kbuf_(NULL), ksiz_(0), vbuf_(NULL), vsiz_(0) {
+      _assert_(rbuf);
+      deserialize(rbuf);
+    }
+    /** constructor */
+    Record(const char* rbuf, bool compact) :
+        child_(NULL), kbuf_(NULL), ksiz_(0), vbuf_(NULL), vsiz_(0) {
+      _assert_(rbuf);
+      if (compact) {
+        deserialize_compact(rbuf);
+      } else {
+        deserialize(rbuf);
+      }
+    }
+    /** overwrite the buffer */
+    void overwrite(char* rbuf, const char* vbuf, size_t vsiz) {
+      _assert_(rbuf && vbuf && vsiz <= MEMMAXSIZ);
+      char* wp = rbuf + sizeof(child_) + sizevarnum(ksiz_) + ksiz_;
       wp += writevarnum(wp, vsiz);
       std::memcpy(wp, vbuf, vsiz);
     }
@@ -1172,6 +1849,30 @@ class StashDB : public BasicDB {
       rp += readvarnum(rp, sizeof(vsiz_), &vsiz_);
       vbuf_ = rp;
     }
+    /** get the size of the serialized data in the compact layout */
+    size_t compact_size() const {
+      _assert_(true);
+      return sizevarnum(ksiz_) + ksiz_ + sizevarnum(vsiz_) + vsiz_;
+    }
+    /** serialize data into a buffer in the compact layout */
+    void serialize_compact(char* wp) {
+      _assert_(wp);
+      wp += writevarnum(wp, ksiz_);
+      std::memcpy(wp, kbuf_, ksiz_);
+      wp += ksiz_;
+      wp += writevarnum(wp, vsiz_);
+      std::memcpy(wp, vbuf_, vsiz_);
+    }
+    /** deserialize a buffer in the compact layout into object */
+    void deserialize_compact(const char* rbuf) {
+      _assert_(rbuf);
+      const char* rp = rbuf;
+      rp += readvarnum(rp, sizeof(ksiz_), &ksiz_);
+      kbuf_ = rp;
+      rp += ksiz_;
+      rp += readvarnum(rp, sizeof(vsiz_), &vsiz_);
+      vbuf_ = rp;
+    }
     /** print debug info */
     void print() {
       std::cout << "child:" << (void*)child_ << std::endl;
@@ -1203,6 +1904,15 @@ class StashDB : public BasicDB {
       _assert_(true);
     }
   };
+  /**
+   * Probing table of the compact layout.
+   */
+  struct CompactTable {
+    uint8_t* ctrls;                      ///< control bytes of slots
+    char** slots;                        ///< record addresses of slots
+    size_t cap;                          ///< number of slots
+    size_t used;                         ///< number of slots not empty
+  };
   /**
    * Repeating visitor.
    */
@@ -1218,63 +1928,277 @@ class StashDB : public BasicDB {
       *sp = vsiz_;
       return vbuf_;
     }
-    const char* vbuf_;                   ///< region of the value
-    size_t vsiz_;                        ///< size of the value
-  };
+    const char* vbuf_;                   ///< region of the value
+    size_t vsiz_;                        ///< size of the value
+  };
+  /**
+   * Setting visitor.
+   */
+  class Setter : public Visitor {
+   public:
+    /** constructor */
+    explicit Setter(const char* vbuf, size_t vsiz) : vbuf_(vbuf), vsiz_(vsiz) {}
+   private:
+    /** process a full record */
+    const char* visit_full(const char* kbuf, size_t ksiz,
+                           const char* vbuf, size_t vsiz, size_t* sp) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ && sp);
+      *sp = vsiz_;
+      return vbuf_;
+    }
+    /** process an empty record */
+    const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ && sp);
+      *sp = vsiz_;
+      return vbuf_;
+    }
+    const char* vbuf_;                   ///< region of the value
+    size_t vsiz_;                        ///< size of the value
+  };
+  /**
+   * Removing visitor.
+   */
+  class Remover : public Visitor {
+   private:
+    /** visit a record */
+    const char* visit_full(const char* kbuf, size_t ksiz,
+                           const char* vbuf, size_t vsiz, size_t* sp) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ && sp);
+      return REMOVE;
+    }
+  };
+  /**
+   * Removing visitor of expired records.
+   */
+  class Expirer : public Visitor {
+   public:
+    /** constructor */
+    explicit Expirer(StashDB* db, int64_t ct) : db_(db), ct_(ct), xt_(-1) {}
+    /** get the expiration time of the living record */
+    int64_t xt() {
+      return xt_;
+    }
+   private:
+    /** visit a record */
+    const char* visit_full(const char* kbuf, size_t ksiz,
+                           const char* vbuf, size_t vsiz, size_t* sp) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ && sp);
+      int64_t xt = db_->read_expiration(vbuf, vsiz);
+      if (xt < 0) return NOP;
+      if (xt < ct_) return REMOVE;
+      xt_ = xt;
+      return NOP;
+    }
+    StashDB* db_;                        ///< database
+    int64_t ct_;                         ///< current time
+    int64_t xt_;                         ///< expiration time
+  };
+  /**
+   * Scoped visitor.
+   */
+  class ScopedVisitor {
+   public:
+    /** constructor */
+    explicit ScopedVisitor(Visitor* visitor) : visitor_(visitor) {
+      _assert_(visitor);
+      visitor_->visit_before();
+    }
+    /** destructor */
+    ~ScopedVisitor() {
+      _assert_(true);
+      visitor_->visit_after();
+    }
+   private:
+    Visitor* visitor_;                   ///< visitor
+  };
+  /**
+   * Buffered writer of the memory image.
+   */
+  class ImageWriter {
+   public:
+    /** constructor */
+    explicit ImageWriter(File* file) : file_(file), buf_(), emsg_(NULL) {}
+    /** write data */
+    bool write(const void* buf, size_t size) {
+      _assert_(buf && size <= MEMMAXSIZ);
+      buf_.append((const char*)buf, size);
+      if (buf_.size() < IMGIOUNIT) return true;
+      return flush();
+    }
+    /** flush the buffer */
+    bool flush() {
+      _assert_(true);
+      if (buf_.empty()) return true;
+      bool err = false;
+      if (!file_->append(buf_.data(), buf_.size())) {
+        emsg_ = file_->error();
+        err = true;
+      }
+      buf_.clear();
+      return !err;
+    }
+    /** get the error message */
+    const char* error() {
+      _assert_(true);
+      return emsg_;
+    }
+   private:
+    File* file_;                         ///< destination file
+    std::string buf_;                    ///< write buffer
+    const char* emsg_;                   ///< error message
+  };
+  /**
+   * Get the size of a record in the memory image.
+   * @param rec the record.
+   * @return the size of the record region including the size prefix and the padding.
+   */
+  size_t image_record_size(const Record& rec) {
+    _assert_(true);
+    size_t rsiz = sizeof(uint64_t) + rec.compact_size();
+    if (!compact_) rsiz += sizeof(rec.child_);
+    return (rsiz + IMGALIGN - 1) / IMGALIGN * IMGALIGN;
+  }
+  /**
+   * Allocate the bucket array.
+   */
+  void create_buckets() {
+    _assert_(true);
+    if (compact_) {
+      cpt_create_table(&ctab_, cpt_capacity(bnum_));
+      return;
+    }
+    if (bnum_ >= MAPZMAPBNUM) {
+      buckets_ = (char**)mapalloc(sizeof(*buckets_) * bnum_);
+      for (int32_t i = 0; i < nodenum_; i++) {
+        size_t begin = bnum_ * i / nodenum_;
+        size_t end = bnum_ * (i + 1) / nodenum_;
+        if (!numabind(buckets_ + begin, sizeof(*buckets_) * (end - begin), i))
+          report(_KCCODELINE_, Logger::WARN, "binding to a NUMA node failed (node=%d)", (int)i);
+      }
+    } else {
+      buckets_ = new char*[bnum_];
+      for (size_t i = 0; i < bnum_; i++) {
+        buckets_[i] = NULL;
+      }
+    }
+  }
+  /**
+   * Release all records and the bucket array.
+   */
+  void destroy_buckets() {
+    _assert_(true);
+    if (compact_) {
+      CompactTable* tabs[] = { &otab_, &ctab_ };
+      for (size_t i = 0; i < sizeof(tabs) / sizeof(*tabs); i++) {
+        CompactTable* tab = tabs[i];
+        for (size_t j = 0; j < tab->cap; j++) {
+          if (tab->ctrls[j] >= CPTEMPTY) continue;
+          char* rbuf = tab->slots[j];
+          if (cpt_align(Record(rbuf, true).compact_size()) > CPTSMALLMAX) xfree(rbuf);
+        }
+        cpt_destroy_table(tab);
+      }
+      migidx_ = 0;
+      std::vector<char*>::iterator pit = cptpages_.begin();
+      std::vector<char*>::iterator pitend = cptpages_.end();
+      while (pit != pitend) {
+        xfree(*pit);
+        ++pit;
+      }
+      cptpages_.clear();
+      cptcur_ = NULL;
+      cptrem_ = 0;
+      std::memset(cptfrees_, 0, sizeof(cptfrees_));
+      return;
+    }
+    if (obuckets_) finish_resizing();
+    for (size_t i = 0; i < bnum_; i++) {
+      char* rbuf = buckets_[i];
+      while (rbuf) {
+        Record rec(rbuf);
+        char* child = rec.child_;
+        delete[] rbuf;
+        rbuf = child;
+      }
+    }
+    if (bnum_ >= MAPZMAPBNUM) {
+      mapfree(buckets_);
+    } else {
+      delete[] buckets_;
+    }
+    buckets_ = NULL;
+  }
   /**
-   * Setting visitor.
+   * Adjust the bucket array to the load factor.
+   * @note This function must be called while the method lock is held as a writer.
    */
-  class Setter : public Visitor {
-   public:
-    /** constructor */
-    explicit Setter(const char* vbuf, size_t vsiz) : vbuf_(vbuf), vsiz_(vsiz) {}
-   private:
-    /** process a full record */
-    const char* visit_full(const char* kbuf, size_t ksiz,
-                           const char* vbuf, size_t vsiz, size_t* sp) {
-      _assert_(kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ && sp);
-      *sp = vsiz_;
-      return vbuf_;
+  void adjust_buckets() {
+    _assert_(true);
+    if (omode_ == 0 || compact_) return;
+    if (obuckets_) {
+      if (rszidx_ >= obnum_) finish_resizing();
+      return;
     }
-    /** process an empty record */
-    const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
-      _assert_(kbuf && ksiz <= MEMMAXSIZ && sp);
-      *sp = vsiz_;
-      return vbuf_;
+    if (lfmax_ <= 0 || count_ <= bnum_ * lfmax_) return;
+    CursorList::const_iterator cit = curs_.begin();
+    CursorList::const_iterator citend = curs_.end();
+    while (cit != citend) {
+      Cursor* cur = *cit;
+      if (cur->bidx_ >= 0) return;
+      ++cit;
     }
-    const char* vbuf_;                   ///< region of the value
-    size_t vsiz_;                        ///< size of the value
-  };
+    size_t bnum = nearbyprime(bnum_ * 2 + 1);
+    if (bnum <= bnum_) return;
+    report(_KCCODELINE_, Logger::INFO, "resizing the bucket array (bnum=%lld)", (long long)bnum);
+    obuckets_ = buckets_;
+    obnum_ = bnum_;
+    rszidx_ = 0;
+    bnum_ = bnum;
+    create_buckets();
+  }
   /**
-   * Removing visitor.
+   * Migrate records from old buckets to the current bucket array.
+   * @param num the number of old buckets to be migrated.
    */
-  class Remover : public Visitor {
-   private:
-    /** visit a record */
-    const char* visit_full(const char* kbuf, size_t ksiz,
-                           const char* vbuf, size_t vsiz, size_t* sp) {
-      _assert_(kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ && sp);
-      return REMOVE;
+  void step_resizing(size_t num) {
+    _assert_(obuckets_);
+    size_t end = num < obnum_ - rszidx_ ? rszidx_ + num : obnum_;
+    while (rszidx_ < end) {
+      migrate_bucket(rszidx_++);
     }
-  };
+  }
   /**
-   * Scoped visitor.
+   * Complete the migration from the old bucket array.
+   * @note This function must be called while the method lock is held as a writer.
    */
-  class ScopedVisitor {
-   public:
-    /** constructor */
-    explicit ScopedVisitor(Visitor* visitor) : visitor_(visitor) {
-      _assert_(visitor);
-      visitor_->visit_before();
+  void finish_resizing() {
+    _assert_(obuckets_);
+    step_resizing(obnum_);
+    if (obnum_ >= MAPZMAPBNUM) {
+      mapfree(obuckets_);
+    } else {
+      delete[] obuckets_;
     }
-    /** destructor */
-    ~ScopedVisitor() {
-      _assert_(true);
-      visitor_->visit_after();
+    obuckets_ = NULL;
+    obnum_ = 0;
+    rszidx_ = 0;
+  }
+  /**
+   * Migrate records of an old bucket to the current bucket array.
+   * @param obidx the index of the old bucket.
+   */
+  void migrate_bucket(size_t obidx) {
+    _assert_(obuckets_ && obidx < obnum_);
+    char* rbuf = obuckets_[obidx];
+    obuckets_[obidx] = NULL;
+    while (rbuf) {
+      Record rec(rbuf);
+      char** entp = buckets_ + hash_record(rec.kbuf_, rec.ksiz_) % bnum_;
+      *(char**)rbuf = *entp;
+      *entp = rbuf;
+      rbuf = rec.child_;
     }
-   private:
-    Visitor* visitor_;                   ///< visitor
-  };
+  }
   /**
    * Accept a visitor to a record.
    * @param kbuf the pointer to the key region.
@@ -1284,6 +2208,11 @@ class StashDB : public BasicDB {
    */
   void accept_impl(const char* kbuf, size_t ksiz, Visitor* visitor, size_t bidx) {
     _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
+    if (compact_) {
+      accept_compact(kbuf, ksiz, visitor);
+      return;
+    }
+    if (obuckets_) migrate_bucket(hash_record(kbuf, ksiz) % obnum_);
     char* rbuf = buckets_[bidx];
     char** entp = buckets_ + bidx;
     while (rbuf) {
@@ -1300,6 +2229,7 @@ class StashDB : public BasicDB {
           }
           count_ -= 1;
           size_ -= rec.ksiz_ + rec.vsiz_;
+          if (xwheel_) untrack_expiration(rec.kbuf_, rec.ksiz_);
           escape_cursors(rbuf);
           *entp = rec.child_;
           delete[] rbuf;
@@ -1309,6 +2239,7 @@ class StashDB : public BasicDB {
             TranLog log(rec.kbuf_, rec.ksiz_, rec.vbuf_, rec.vsiz_);
             trlogs_.push_back(log);
           }
+          if (xwheel_) track_expiration(kbuf, ksiz, vbuf, vsiz);
           int32_t oh = (int32_t)sizevarnum(vsiz) - (int32_t)sizevarnum(rec.vsiz_);
           int64_t diff = (int64_t)rec.vsiz_ - (int64_t)(vsiz + oh);
           size_ += (int64_t)vsiz - (int64_t)rec.vsiz_;
@@ -1335,12 +2266,507 @@ class StashDB : public BasicDB {
         TranLog log(kbuf, ksiz);
         trlogs_.push_back(log);
       }
+      if (xwheel_) track_expiration(kbuf, ksiz, vbuf, vsiz);
       Record nrec(NULL, kbuf, ksiz, vbuf, vsiz);
       *entp = nrec.serialize();
       count_ += 1;
       size_ += ksiz + vsiz;
     }
   }
+  /**
+   * Accept a visitor to a record in the compact layout.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param visitor a visitor object.
+   */
+  void accept_compact(const char* kbuf, size_t ksiz, Visitor* visitor) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
+    size_t hash = hash_record(kbuf, ksiz);
+    int64_t gidx = cpt_locate(kbuf, ksiz, hash);
+    if (gidx >= 0) {
+      CompactTable* tab = &ctab_;
+      size_t sidx = gidx;
+      if (sidx < otab_.cap) {
+        tab = &otab_;
+      } else {
+        sidx -= otab_.cap;
+      }
+      char* rbuf = tab->slots[sidx];
+      Record rec(rbuf, true);
+      size_t vsiz;
+      const char* vbuf = visitor->visit_full(rec.kbuf_, rec.ksiz_,
+                                             rec.vbuf_, rec.vsiz_, &vsiz);
+      if (vbuf == Visitor::REMOVE) {
+        if (tran_) {
+          ScopedMutex lock(&flock_);
+          TranLog log(rec.kbuf_, rec.ksiz_, rec.vbuf_, rec.vsiz_);
+          trlogs_.push_back(log);
+        }
+        count_ -= 1;
+        size_ -= rec.ksiz_ + rec.vsiz_;
+        if (xwheel_) untrack_expiration(rec.kbuf_, rec.ksiz_);
+        escape_cursors(rbuf);
+        cpt_erase(tab, sidx);
+        cpt_free(rbuf);
+      } else if (vbuf != Visitor::NOP) {
+        if (tran_) {
+          ScopedMutex lock(&flock_);
+          TranLog log(rec.kbuf_, rec.ksiz_, rec.vbuf_, rec.vsiz_);
+          trlogs_.push_back(log);
+        }
+        size_ += (int64_t)vsiz - (int64_t)rec.vsiz_;
+        if (xwheel_) track_expiration(rec.kbuf_, rec.ksiz_, vbuf, vsiz);
+        Record nrec(NULL, rec.kbuf_, rec.ksiz_, vbuf, vsiz);
+        size_t nsiz = nrec.compact_size();
+        if (cpt_align(nsiz) == cpt_align(rec.compact_size()) &&
+            sizevarnum(vsiz) == sizevarnum(rec.vsiz_)) {
+          char* wp = rbuf + sizevarnum(rec.ksiz_) + rec.ksiz_;
+          wp += writevarnum(wp, vsiz);
+          std::memmove(wp, vbuf, vsiz);
+        } else {
+          char* nbuf = cpt_alloc(nsiz);
+          nrec.serialize_compact(nbuf);
+          adjust_cursors(rbuf, nbuf);
+          tab->slots[sidx] = nbuf;
+          cpt_free(rbuf);
+        }
+      }
+      return;
+    }
+    size_t vsiz;
+    const char* vbuf = visitor->visit_empty(kbuf, ksiz, &vsiz);
+    if (vbuf != Visitor::REMOVE && vbuf != Visitor::NOP) {
+      if (tran_) {
+        ScopedMutex lock(&flock_);
+        TranLog log(kbuf, ksiz);
+        trlogs_.push_back(log);
+      }
+      if (xwheel_) track_expiration(kbuf, ksiz, vbuf, vsiz);
+      Record nrec(NULL, kbuf, ksiz, vbuf, vsiz);
+      char* nbuf = cpt_alloc(nrec.compact_size());
+      nrec.serialize_compact(nbuf);
+      cpt_reserve();
+      cpt_insert(&ctab_, nbuf, hash);
+      count_ += 1;
+      size_ += ksiz + vsiz;
+    }
+  }
+  /**
+   * Get the number of slots of a probing table to hold records.
+   * @param num the number of records.
+   * @return the number of slots, which is a power of two.
+   */
+  size_t cpt_capacity(size_t num) {
+    _assert_(true);
+    size_t cap = CPTGROUP;
+    while (cap < num && cap < SIZEMAX / 2) {
+      cap <<= 1;
+    }
+    return cap;
+  }
+  /**
+   * Get the aligned size of a region in arena pages.
+   * @param rsiz the size of a record.
+   * @return the aligned size.
+   */
+  size_t cpt_align(size_t rsiz) {
+    _assert_(true);
+    return (rsiz + CPTALIGN - 1) / CPTALIGN * CPTALIGN;
+  }
+  /**
+   * Get the tag of a hash value stored in the control byte.
+   * @param hash the hash value.
+   * @return the tag, which is less than the control byte of an empty slot.
+   */
+  static uint8_t cpt_tag(size_t hash) {
+    _assert_(true);
+    return hash >> (sizeof(hash) * 8 - 7);
+  }
+  /**
+   * Get the bit mask of slots in a group whose control bytes are equal to a value.
+   * @param ctrl the control bytes of the group.
+   * @param value the value to match.
+   * @return the bit mask of matched slots.
+   */
+  static uint32_t cpt_match(const uint8_t* ctrl, uint8_t value) {
+    _assert_(ctrl);
+#if defined(__SSE2__)
+    __m128i grp = _mm_loadu_si128((const __m128i*)ctrl);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(grp, _mm_set1_epi8((char)value)));
+#else
+    uint32_t bits = 0;
+    for (size_t i = 0; i < CPTGROUP; i++) {
+      if (ctrl[i] == value) bits |= 1U << i;
+    }
+    return bits;
+#endif
+  }
+  /**
+   * Get the bit mask of slots in a group which are empty or deleted.
+   * @param ctrl the control bytes of the group.
+   * @return the bit mask of unused slots.
+   */
+  static uint32_t cpt_match_unused(const uint8_t* ctrl) {
+    _assert_(ctrl);
+#if defined(__SSE2__)
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrl));
+#else
+    uint32_t bits = 0;
+    for (size_t i = 0; i < CPTGROUP; i++) {
+      if (ctrl[i] >= CPTEMPTY) bits |= 1U << i;
+    }
+    return bits;
+#endif
+  }
+  /**
+   * Get the index of the lowest set bit.
+   * @param bits the bit mask, which must not be zero.
+   * @return the index of the lowest set bit.
+   */
+  static size_t cpt_lowbit(uint32_t bits) {
+    _assert_(bits != 0);
+#if defined(__GNUC__)
+    return __builtin_ctz(bits);
+#else
+    size_t idx = 0;
+    while (!(bits & 1)) {
+      bits >>= 1;
+      idx++;
+    }
+    return idx;
+#endif
+  }
+  /**
+   * Allocate a probing table.
+   * @param tab the table object.
+   * @param cap the number of slots, which must be a power of two.
+   */
+  void cpt_create_table(CompactTable* tab, size_t cap) {
+    _assert_(tab && cap >= CPTGROUP);
+    if (cap >= MAPZMAPBNUM) {
+      tab->ctrls = (uint8_t*)mapalloc(cap);
+      tab->slots = (char**)mapalloc(sizeof(*tab->slots) * cap);
+    } else {
+      tab->ctrls = new uint8_t[cap];
+      tab->slots = new char*[cap];
+      std::memset(tab->slots, 0, sizeof(*tab->slots) * cap);
+    }
+    std::memset(tab->ctrls, CPTEMPTY, cap);
+    tab->cap = cap;
+    tab->used = 0;
+  }
+  /**
+   * Release a probing table.
+   * @param tab the table object.
+   */
+  void cpt_destroy_table(CompactTable* tab) {
+    _assert_(tab);
+    if (!tab->ctrls) return;
+    if (tab->cap >= MAPZMAPBNUM) {
+      mapfree(tab->slots);
+      mapfree(tab->ctrls);
+    } else {
+      delete[] tab->slots;
+      delete[] tab->ctrls;
+    }
+    tab->ctrls = NULL;
+    tab->slots = NULL;
+    tab->cap = 0;
+    tab->used = 0;
+  }
+  /**
+   * Search a probing table for a record.
+   * @param tab the table object.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param hash the hash value of the key.
+   * @return the index of the slot, or -1 if no record corresponds.
+   */
+  int64_t cpt_search(const CompactTable* tab, const char* kbuf, size_t ksiz, size_t hash) {
+    _assert_(tab && kbuf && ksiz <= MEMMAXSIZ);
+    size_t gmask = tab->cap / CPTGROUP - 1;
+    size_t gidx = hash & gmask;
+    uint8_t tag = cpt_tag(hash);
+    for (size_t i = 0; i <= gmask; i++) {
+      size_t base = gidx * CPTGROUP;
+      const uint8_t* ctrl = tab->ctrls + base;
+      uint32_t bits = cpt_match(ctrl, tag);
+      while (bits) {
+        size_t sidx = base + cpt_lowbit(bits);
+        Record rec(tab->slots[sidx], true);
+        if (rec.ksiz_ == ksiz && !std::memcmp(rec.kbuf_, kbuf, ksiz)) return sidx;
+        bits &= bits - 1;
+      }
+      if (cpt_match(ctrl, CPTEMPTY)) break;
+      gidx = (gidx + i + 1) & gmask;
+    }
+    return -1;
+  }
+  /**
+   * Collect the keys of a hash value in a probing table.
+   * @param tab the table object.
+   * @param hash the hash value of the keys.
+   * @param keys a string vector to contain the keys.
+   */
+  void cpt_collect(const CompactTable* tab, size_t hash, std::vector<std::string>* keys) {
+    _assert_(tab && keys);
+    size_t gmask = tab->cap / CPTGROUP - 1;
+    size_t gidx = hash & gmask;
+    uint8_t tag = cpt_tag(hash);
+    for (size_t i = 0; i <= gmask; i++) {
+      size_t base = gidx * CPTGROUP;
+      const uint8_t* ctrl = tab->ctrls + base;
+      uint32_t bits = cpt_match(ctrl, tag);
+      while (bits) {
+        size_t sidx = base + cpt_lowbit(bits);
+        Record rec(tab->slots[sidx], true);
+        if (hash_record(rec.kbuf_, rec.ksiz_) == hash)
+          keys->push_back(std::string(rec.kbuf_, rec.ksiz_));
+        bits &= bits - 1;
+      }
+      if (cpt_match(ctrl, CPTEMPTY)) break;
+      gidx = (gidx + i + 1) & gmask;
+    }
+  }
+  /**
+   * Put a record into an unused slot of a probing table.
+   * @param tab the table object.
+   * @param rbuf the record buffer.
+   * @param hash the hash value of the key.
+   * @return the index of the slot.
+   */
+  size_t cpt_insert(CompactTable* tab, char* rbuf, size_t hash) {
+    _assert_(tab && rbuf && tab->used < tab->cap);
+    size_t gmask = tab->cap / CPTGROUP - 1;
+    size_t gidx = hash & gmask;
+    size_t i = 0;
+    while (true) {
+      size_t base = gidx * CPTGROUP;
+      uint32_t bits = cpt_match_unused(tab->ctrls + base);
+      if (bits) {
+        size_t sidx = base + cpt_lowbit(bits);
+        if (tab->ctrls[sidx] == CPTEMPTY) tab->used++;
+        tab->ctrls[sidx] = cpt_tag(hash);
+        tab->slots[sidx] = rbuf;
+        return sidx;
+      }
+      gidx = (gidx + ++i) & gmask;
+    }
+  }
+  /**
+   * Remove a record from a slot of a probing table.
+   * @param tab the table object.
+   * @param sidx the index of the slot.
+   */
+  void cpt_erase(CompactTable* tab, size_t sidx) {
+    _assert_(tab && sidx < tab->cap);
+    if (cpt_match(tab->ctrls + sidx / CPTGROUP * CPTGROUP, CPTEMPTY)) {
+      tab->ctrls[sidx] = CPTEMPTY;
+      tab->used--;
+    } else {
+      tab->ctrls[sidx] = CPTDELETED;
+    }
+    tab->slots[sidx] = NULL;
+  }
+  /**
+   * Locate a record in the probing tables.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param hash the hash value of the key.
+   * @return the index of the slot counted over the old table and the current table, or -1 if
+   * no record corresponds.
+   */
+  int64_t cpt_locate(const char* kbuf, size_t ksiz, size_t hash) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ);
+    int64_t sidx = cpt_search(&ctab_, kbuf, ksiz, hash);
+    if (sidx >= 0) return otab_.cap + sidx;
+    if (otab_.ctrls) return cpt_search(&otab_, kbuf, ksiz, hash);
+    return -1;
+  }
+  /**
+   * Get the record in a slot of the probing tables.
+   * @param gidx the index of the slot counted over the old table and the current table.
+   * @return the record buffer, or NULL if the slot is unused.
+   */
+  char* cpt_record(size_t gidx) {
+    _assert_(true);
+    const CompactTable* tab = &ctab_;
+    if (gidx < otab_.cap) {
+      tab = &otab_;
+    } else {
+      gidx -= otab_.cap;
+    }
+    return tab->ctrls[gidx] < CPTEMPTY ? tab->slots[gidx] : NULL;
+  }
+  /**
+   * Get the first used slot of the probing tables at or after a position.
+   * @param gidx the index of the slot counted over the old table and the current table.
+   * @return the index of the used slot, or -1 if no more slot is used.
+   */
+  int64_t cpt_next(int64_t gidx) {
+    _assert_(gidx >= 0);
+    size_t snum = otab_.cap + ctab_.cap;
+    for (size_t i = gidx; i < snum; i++) {
+      if (cpt_record(i)) return i;
+    }
+    return -1;
+  }
+  /**
+   * Allocate a region for a record in the compact layout.
+   * @param rsiz the size of the record.
+   * @return the pointer to the region.
+   */
+  char* cpt_alloc(size_t rsiz) {
+    _assert_(rsiz <= MEMMAXSIZ);
+    size_t asiz = cpt_align(rsiz);
+    if (asiz > CPTSMALLMAX) {
+      return (char*)xmalloc(asiz);
+    }
+    char** freep = cptfrees_ + asiz / CPTALIGN;
+    if (*freep) {
+      char* rbuf = *freep;
+      *freep = *(char**)rbuf;
+      return rbuf;
+    }
+    if (cptrem_ < asiz) {
+      if (cptrem_ > 0) cpt_free_region(cptcur_, cptrem_);
+      cptcur_ = (char*)xmalloc(CPTPAGESIZ);
+      cptrem_ = CPTPAGESIZ;
+      cptpages_.push_back(cptcur_);
+    }
+    char* rbuf = cptcur_;
+    cptcur_ += asiz;
+    cptrem_ -= asiz;
+    return rbuf;
+  }
+  /**
+   * Release the region of a record in the compact layout.
+   * @param rbuf the record buffer.
+   */
+  void cpt_free(char* rbuf) {
+    _assert_(rbuf);
+    cpt_free_region(rbuf, cpt_align(Record(rbuf, true).compact_size()));
+  }
+  /**
+   * Release a region allocated for the compact layout.
+   * @param rbuf the pointer to the region.
+   * @param asiz the aligned size of the region.
+   */
+  void cpt_free_region(char* rbuf, size_t asiz) {
+    _assert_(rbuf && asiz % CPTALIGN == 0);
+    if (asiz > CPTSMALLMAX) {
+      xfree(rbuf);
+      return;
+    }
+    char** freep = cptfrees_ + asiz / CPTALIGN;
+    *(char**)rbuf = *freep;
+    *freep = rbuf;
+  }
+  /**
+   * Make room for a new record in the current probing table.
+   */
+  void cpt_reserve() {
+    _assert_(true);
+    if (ctab_.used < ctab_.cap / 8 * 7) return;
+    if (otab_.ctrls) {
+      cpt_rebuild();
+      return;
+    }
+    size_t cap = ctab_.cap;
+    if ((size_t)count_ >= cap / 16 * 7) cap *= 2;
+    otab_ = ctab_;
+    cpt_create_table(&ctab_, cap);
+    migidx_ = 0;
+  }
+  /**
+   * Proceed the migration from the old probing table by a step.
+   * @note The migration is postponed while any cursor points to a record, in order not to
+   * move records under cursors.
+   */
+  void cpt_step() {
+    _assert_(true);
+    if (!otab_.ctrls) return;
+    CursorList::const_iterator cit = curs_.begin();
+    CursorList::const_iterator citend = curs_.end();
+    while (cit != citend) {
+      Cursor* cur = *cit;
+      if (cur->bidx_ >= 0) return;
+      ++cit;
+    }
+    cpt_migrate(CPTMIGSTEP);
+  }
+  /**
+   * Complete the migration from the old probing table.
+   */
+  void cpt_settle() {
+    _assert_(true);
+    if (otab_.ctrls) cpt_migrate(otab_.cap / CPTGROUP);
+  }
+  /**
+   * Migrate records from the old probing table to the current one.
+   * @param gnum the number of groups to be migrated.
+   */
+  void cpt_migrate(size_t gnum) {
+    _assert_(true);
+    size_t ognum = otab_.cap / CPTGROUP;
+    size_t gend = gnum < ognum - migidx_ ? migidx_ + gnum : ognum;
+    for (size_t i = migidx_ * CPTGROUP; i < gend * CPTGROUP; i++) {
+      if (otab_.ctrls[i] >= CPTEMPTY) continue;
+      if (ctab_.used >= ctab_.cap / 8 * 7) {
+        cpt_rebuild();
+        return;
+      }
+      char* rbuf = otab_.slots[i];
+      Record rec(rbuf, true);
+      cpt_insert(&ctab_, rbuf, hash_record(rec.kbuf_, rec.ksiz_));
+      otab_.ctrls[i] = CPTDELETED;
+      otab_.slots[i] = NULL;
+    }
+    migidx_ = gend;
+    if (migidx_ < ognum) return;
+    cpt_destroy_table(&otab_);
+    migidx_ = 0;
+    cpt_relocate_cursors();
+  }
+  /**
+   * Rebuild the probing tables into a new one at once.
+   */
+  void cpt_rebuild() {
+    _assert_(true);
+    CompactTable ntab;
+    cpt_create_table(&ntab, cpt_capacity((size_t)count_ * 2 + 1));
+    CompactTable* tabs[] = { &otab_, &ctab_ };
+    for (size_t i = 0; i < sizeof(tabs) / sizeof(*tabs); i++) {
+      CompactTable* tab = tabs[i];
+      for (size_t j = 0; j < tab->cap; j++) {
+        if (tab->ctrls[j] >= CPTEMPTY) continue;
+        Record rec(tab->slots[j], true);
+        cpt_insert(&ntab, tab->slots[j], hash_record(rec.kbuf_, rec.ksiz_));
+      }
+      cpt_destroy_table(tab);
+    }
+    ctab_ = ntab;
+    migidx_ = 0;
+    cpt_relocate_cursors();
+  }
+  /**
+   * Relocate cursors after records are moved between probing tables.
+   */
+  void cpt_relocate_cursors() {
+    _assert_(true);
+    ScopedMutex lock(&flock_);
+    CursorList::const_iterator cit = curs_.begin();
+    CursorList::const_iterator citend = curs_.end();
+    while (cit != citend) {
+      Cursor* cur = *cit;
+      if (cur->bidx_ >= 0) {
+        Record rec(cur->rbuf_, true);
+        cur->bidx_ = cpt_locate(rec.kbuf_, rec.ksiz_, hash_record(rec.kbuf_, rec.ksiz_));
+        if (cur->bidx_ < 0) cur->rbuf_ = NULL;
+      }
+      ++cit;
+    }
+  }
   /**
    * Get the hash value of a record.
    * @param kbuf the pointer to the key region.
@@ -1357,7 +2783,11 @@ class StashDB : public BasicDB {
    */
   int64_t size_impl() {
     _assert_(true);
-    return bnum_ * sizeof(*buckets_) + count_ * (4 + sizeof(void*)) + size_;
+    if (compact_) {
+      ScopedRWLock lock(&tlock_, false);
+      return ctab_.cap * (sizeof(*ctab_.slots) + 1) + count_ * 4 + size_;
+    }
+    return (bnum_ + obnum_) * sizeof(*buckets_) + count_ * (4 + sizeof(void*)) + size_;
   }
   /**
    * Escape cursors on a shifted or removed records.
@@ -1430,6 +2860,102 @@ class StashDB : public BasicDB {
       }
     }
   }
+  /**
+   * Track the expiration time of a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param vbuf the pointer to the value region.
+   * @param vsiz the size of the value region.
+   */
+  void track_expiration(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && vbuf && vsiz <= MEMMAXSIZ);
+    int64_t xt = read_expiration(vbuf, vsiz);
+    uint64_t hash = hash_record(kbuf, ksiz);
+    ScopedSpinLock lock(&xlock_);
+    if (xt >= 0) {
+      xwheel_->set(hash, xt);
+    } else {
+      xwheel_->remove(hash);
+    }
+  }
+  /**
+   * Stop tracking the expiration time of a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   */
+  void untrack_expiration(const char* kbuf, size_t ksiz) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ);
+    uint64_t hash = hash_record(kbuf, ksiz);
+    ScopedSpinLock lock(&xlock_);
+    xwheel_->remove(hash);
+  }
+  /**
+   * Remove expired records of a hash value.
+   * @param hash the hash value of the keys.
+   * @param ct the current time.
+   * @return the earliest expiration time of the living records of the hash value, or -1 if
+   * there is no such record.
+   */
+  int64_t expire_hash(uint64_t hash, int64_t ct) {
+    _assert_(true);
+    std::vector<std::string> keys;
+    size_t bidx = 0;
+    size_t lidx = 0;
+    if (compact_) {
+      tlock_.lock_writer();
+      cpt_collect(&ctab_, hash, &keys);
+      if (otab_.ctrls) cpt_collect(&otab_, hash, &keys);
+    } else {
+      bidx = hash % bnum_;
+      lidx = bidx % RLOCKSLOT;
+      if (obuckets_) {
+        tlock_.lock_writer();
+        migrate_bucket(hash % obnum_);
+      } else {
+        rlock_.lock_writer(lidx);
+      }
+      char* rbuf = buckets_[bidx];
+      while (rbuf) {
+        Record rec(rbuf);
+        if (hash_record(rec.kbuf_, rec.ksiz_) == hash)
+          keys.push_back(std::string(rec.kbuf_, rec.ksiz_));
+        rbuf = rec.child_;
+      }
+    }
+    int64_t xt = -1;
+    std::vector<std::string>::iterator it = keys.begin();
+    std::vector<std::string>::iterator itend = keys.end();
+    while (it != itend) {
+      Expirer expirer(this, ct);
+      if (compact_) {
+        accept_compact(it->data(), it->size(), &expirer);
+        cpt_step();
+      } else {
+        accept_impl(it->data(), it->size(), &expirer, bidx);
+      }
+      if (expirer.xt() >= 0 && (xt < 0 || expirer.xt() < xt)) xt = expirer.xt();
+      ++it;
+    }
+    if (compact_ || obuckets_) {
+      tlock_.unlock();
+    } else {
+      rlock_.unlock(lidx);
+    }
+    return xt;
+  }
+  /**
+   * Read the expiration time embedded in a record value.
+   * @param vbuf the pointer to the value region.
+   * @param vsiz the size of the value region.
+   * @return the expiration time, or -1 if the record never expires.
+   */
+  int64_t read_expiration(const char* vbuf, size_t vsiz) {
+    _assert_(vbuf && vsiz <= MEMMAXSIZ);
+    if (vsiz < (size_t)xtwidth_) return -1;
+    int64_t xt = readfixnum(vbuf, xtwidth_);
+    if (xtwidth_ < (int32_t)sizeof(xt) && xt >= ((int64_t)1 << (xtwidth_ * 8)) - 1) return -1;
+    return xt < 0 ? -1 : xt;
+  }
   /** Dummy constructor to forbid the use. */
   StashDB(const StashDB&);
   /** Dummy Operator to forbid the use. */
@@ -1438,8 +2964,12 @@ class StashDB : public BasicDB {
   RWLock mlock_;
   /** The record locks. */
   SlottedRWLock rlock_;
+  /** The table lock of the compact layout. */
+  RWLock tlock_;
   /** The file lock. */
   Mutex flock_;
+  /** The lock of the timer wheel. */
+  SpinLock xlock_;
   /** The last happened error. */
   TSD<Error> error_;
   /** The internal logger. */
@@ -1454,16 +2984,48 @@ class StashDB : public BasicDB {
   CursorList curs_;
   /** The path of the database file. */
   std::string path_;
+  /** The options. */
+  uint8_t opts_;
   /** The number of buckets. */
   size_t bnum_;
+  /** The width of the expiration time. */
+  int32_t xtwidth_;
   /** The opaque data. */
   char opaque_[OPAQUESIZ];
   /** The record number. */
-  AtomicInt64 count_;
+  ShardedInt64 count_;
   /** The total size of records. */
-  AtomicInt64 size_;
+  ShardedInt64 size_;
   /** The bucket array. */
   char** buckets_;
+  /** The maximum load factor. */
+  double lfmax_;
+  /** The old bucket array under resizing. */
+  char** obuckets_;
+  /** The number of old buckets. */
+  size_t obnum_;
+  /** The index of the next old bucket to be migrated. */
+  size_t rszidx_;
+  /** The number of NUMA nodes to which bucket ranges are bound. */
+  int32_t nodenum_;
+  /** The timer wheel of expiration. */
+  TimerWheel* xwheel_;
+  /** The flag whether in the compact layout. */
+  bool compact_;
+  /** The current probing table of the compact layout. */
+  CompactTable ctab_;
+  /** The old probing table under migration. */
+  CompactTable otab_;
+  /** The index of the next group to be migrated. */
+  size_t migidx_;
+  /** The arena pages of the compact layout. */
+  std::vector<char*> cptpages_;
+  /** The unused region of the current arena page. */
+  char* cptcur_;
+  /** The size of the unused region of the current arena page. */
+  size_t cptrem_;
+  /** The free lists of arena regions by size. */
+  char* cptfrees_[CPTSMALLMAX/CPTALIGN+1];
   /** The flag whether in transaction. */
   bool tran_;
   /** The list of transaction logs. */
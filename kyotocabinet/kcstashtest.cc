@@ -33,11 +33,13 @@ static int32_t runqueue(int argc, char** argv);
 static int32_t runwicked(int argc, char** argv);
 static int32_t runtran(int argc, char** argv);
 static int32_t procorder(int64_t rnum, int32_t thnum, bool rnd, bool etc, bool tran,
-                         int64_t bnum, bool lv);
+                         int32_t opts, int64_t bnum, bool lv);
 static int32_t procqueue(int64_t rnum, int32_t thnum, int32_t itnum, bool rnd,
-                         int64_t bnum, bool lv);
-static int32_t procwicked(int64_t rnum, int32_t thnum, int32_t itnum, int64_t bnum, bool lv);
-static int32_t proctran(int64_t rnum, int32_t thnum, int32_t itnum, int64_t bnum, bool lv);
+                         int32_t opts, int64_t bnum, bool lv);
+static int32_t procwicked(int64_t rnum, int32_t thnum, int32_t itnum,
+                          int32_t opts, int64_t bnum, bool lv);
+static int32_t proctran(int64_t rnum, int32_t thnum, int32_t itnum,
+                        int32_t opts, int64_t bnum, bool lv);
 
 
 // main routine
@@ -77,11 +79,11 @@ static void usage() {
   eprintf("%s: test cases of the stash database of Kyoto Cabinet\n", g_progname);
   eprintf("\n");
   eprintf("usage:\n");
-  eprintf("  %s order [-th num] [-rnd] [-etc] [-tran] [-bnum num] [-lv] rnum\n",
+  eprintf("  %s order [-th num] [-rnd] [-etc] [-tran] [-ts] [-bnum num] [-lv] rnum\n",
           g_progname);
-  eprintf("  %s queue [-th num] [-it num] [-rnd] [-bnum num] [-lv] rnum\n", g_progname);
-  eprintf("  %s wicked [-th num] [-it num] [-bnum num] [-lv] rnum\n", g_progname);
-  eprintf("  %s tran [-th num] [-it num] [-bnum num] [-lv] rnum\n", g_progname);
+  eprintf("  %s queue [-th num] [-it num] [-rnd] [-ts] [-bnum num] [-lv] rnum\n", g_progname);
+  eprintf("  %s wicked [-th num] [-it num] [-ts] [-bnum num] [-lv] rnum\n", g_progname);
+  eprintf("  %s tran [-th num] [-it num] [-ts] [-bnum num] [-lv] rnum\n", g_progname);
   eprintf("\n");
   std::exit(1);
 }
@@ -151,6 +153,7 @@ static int32_t runorder(int argc, char** argv) {
   bool rnd = false;
   bool etc = false;
   bool tran = false;
+  int32_t opts = 0;
   int64_t bnum = -1;
   bool lv = false;
   for (int32_t i = 2; i < argc; i++) {
@@ -166,6 +169,8 @@ static int32_t runorder(int argc, char** argv) {
         etc = true;
       } else if (!std::strcmp(argv[i], "-tran")) {
         tran = true;
+      } else if (!std::strcmp(argv[i], "-ts")) {
+        opts |= kc::StashDB::TSMALL;
       } else if (!std::strcmp(argv[i], "-bnum")) {
         if (++i >= argc) usage();
         bnum = kc::atoix(argv[i]);
@@ -185,7 +190,7 @@ static int32_t runorder(int argc, char** argv) {
   int64_t rnum = kc::atoix(rstr);
   if (rnum < 1 || thnum < 1) usage();
   if (thnum > THREADMAX) thnum = THREADMAX;
-  int32_t rv = procorder(rnum, thnum, rnd, etc, tran, bnum, lv);
+  int32_t rv = procorder(rnum, thnum, rnd, etc, tran, opts, bnum, lv);
   return rv;
 }
 
@@ -197,6 +202,7 @@ static int32_t runqueue(int argc, char** argv) {
   int32_t thnum = 1;
   int32_t itnum = 1;
   bool rnd = false;
+  int32_t opts = 0;
   int64_t bnum = -1;
   bool lv = false;
   for (int32_t i = 2; i < argc; i++) {
@@ -211,6 +217,8 @@ static int32_t runqueue(int argc, char** argv) {
         itnum = kc::atoix(argv[i]);
       } else if (!std::strcmp(argv[i], "-rnd")) {
         rnd = true;
+      } else if (!std::strcmp(argv[i], "-ts")) {
+        opts |= kc::StashDB::TSMALL;
       } else if (!std::strcmp(argv[i], "-bnum")) {
         if (++i >= argc) usage();
         bnum = kc::atoix(argv[i]);
@@ -230,7 +238,7 @@ static int32_t runqueue(int argc, char** argv) {
   int64_t rnum = kc::atoix(rstr);
   if (rnum < 1 || thnum < 1 || itnum < 1) usage();
   if (thnum > THREADMAX) thnum = THREADMAX;
-  int32_t rv = procqueue(rnum, thnum, itnum, rnd, bnum, lv);
+  int32_t rv = procqueue(rnum, thnum, itnum, rnd, opts, bnum, lv);
   return rv;
 }
 
@@ -241,6 +249,7 @@ static int32_t runwicked(int argc, char** argv) {
   const char* rstr = NULL;
   int32_t thnum = 1;
   int32_t itnum = 1;
+  int32_t opts = 0;
   int64_t bnum = -1;
   bool lv = false;
   for (int32_t i = 2; i < argc; i++) {
@@ -253,6 +262,8 @@ static int32_t runwicked(int argc, char** argv) {
       } else if (!std::strcmp(argv[i], "-it")) {
         if (++i >= argc) usage();
         itnum = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-ts")) {
+        opts |= kc::StashDB::TSMALL;
       } else if (!std::strcmp(argv[i], "-bnum")) {
         if (++i >= argc) usage();
         bnum = kc::atoix(argv[i]);
@@ -272,7 +283,7 @@ static int32_t runwicked(int argc, char** argv) {
   int64_t rnum = kc::atoix(rstr);
   if (rnum < 1 || thnum < 1 || itnum < 1) usage();
   if (thnum > THREADMAX) thnum = THREADMAX;
-  int32_t rv = procwicked(rnum, thnum, itnum, bnum, lv);
+  int32_t rv = procwicked(rnum, thnum, itnum, opts, bnum, lv);
   return rv;
 }
 
@@ -283,6 +294,7 @@ static int32_t runtran(int argc, char** argv) {
   const char* rstr = NULL;
   int32_t thnum = 1;
   int32_t itnum = 1;
+  int32_t opts = 0;
   int64_t bnum = -1;
   bool lv = false;
   for (int32_t i = 2; i < argc; i++) {
@@ -295,6 +307,8 @@ static int32_t runtran(int argc, char** argv) {
       } else if (!std::strcmp(argv[i], "-it")) {
         if (++i >= argc) usage();
         itnum = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-ts")) {
+        opts |= kc::StashDB::TSMALL;
       } else if (!std::strcmp(argv[i], "-bnum")) {
         if (++i >= argc) usage();
         bnum = kc::atoix(argv[i]);
@@ -314,23 +328,24 @@ static int32_t runtran(int argc, char** argv) {
   int64_t rnum = kc::atoix(rstr);
   if (rnum < 1 || thnum < 1 || itnum < 1) usage();
   if (thnum > THREADMAX) thnum = THREADMAX;
-  int32_t rv = proctran(rnum, thnum, itnum, bnum, lv);
+  int32_t rv = proctran(rnum, thnum, itnum, opts, bnum, lv);
   return rv;
 }
 
 
 // perform order command
 static int32_t procorder(int64_t rnum, int32_t thnum, bool rnd, bool etc, bool tran,
-                         int64_t bnum, bool lv) {
+                         int32_t opts, int64_t bnum, bool lv) {
   oprintf("<In-order Test>\n  seed=%u  rnum=%lld  thnum=%d  rnd=%d  etc=%d  tran=%d"
-          "  bnum=%lld  lv=%d\n\n",
-          g_randseed, (long long)rnum, thnum, rnd, etc, tran, (long long)bnum, lv);
+          "  opts=%d  bnum=%lld  lv=%d\n\n",
+          g_randseed, (long long)rnum, thnum, rnd, etc, tran, opts, (long long)bnum, lv);
   bool err = false;
   kc::StashDB db;
   oprintf("opening the database:\n");
   double stime = kc::time();
   db.tune_logger(stdlogger(g_progname, &std::cout),
                  lv ? kc::UINT32MAX : kc::BasicDB::Logger::WARN | kc::BasicDB::Logger::ERROR);
+  if (opts > 0) db.tune_options(opts);
   if (bnum > 0) db.tune_buckets(bnum);
   if (!db.open(":", kc::StashDB::OWRITER | kc::StashDB::OCREATE | kc::StashDB::OTRUNCATE)) {
     dberrprint(&db, __LINE__, "DB::open");
@@ -1137,6 +1152,34 @@ static int32_t procorder(int64_t rnum, int32_t thnum, bool rnd, bool etc, bool t
     dbmetaprint(&db, false);
     oprintf("time: %.3f\n", etime - stime);
   }
+  if (etc && db.size() < (256LL << 20)) {
+    oprintf("dumping records into image:\n");
+    stime = kc::time();
+    const std::string imgpath = "casket.kcsi";
+    int64_t cnt = db.count();
+    int64_t size = db.size();
+    if (!db.dump_image(imgpath)) {
+      dberrprint(&db, __LINE__, "DB::dump_image");
+      err = true;
+    }
+    etime = kc::time();
+    dbmetaprint(&db, false);
+    oprintf("time: %.3f\n", etime - stime);
+    oprintf("loading records from image:\n");
+    stime = kc::time();
+    if (rnd && myrand(2) == 0 && !db.clear()) {
+      dberrprint(&db, __LINE__, "DB::clear");
+      err = true;
+    }
+    if (!db.load_image(imgpath) || db.count() != cnt || db.size() != size) {
+      dberrprint(&db, __LINE__, "DB::load_image");
+      err = true;
+    }
+    kc::File::remove(imgpath);
+    etime = kc::time();
+    dbmetaprint(&db, false);
+    oprintf("time: %.3f\n", etime - stime);
+  }
   oprintf("removing records:\n");
   stime = kc::time();
   class ThreadRemove : public kc::Thread {
@@ -1325,14 +1368,15 @@ static int32_t procorder(int64_t rnum, int32_t thnum, bool rnd, bool etc, bool t
 
 // perform queue command
 static int32_t procqueue(int64_t rnum, int32_t thnum, int32_t itnum, bool rnd,
-                         int64_t bnum, bool lv) {
+                         int32_t opts, int64_t bnum, bool lv) {
   oprintf("<Queue Test>\n  seed=%u  rnum=%lld  thnum=%d  itnum=%d  rnd=%d"
-          "  bnum=%lld  lv=%d\n\n",
-          g_randseed, (long long)rnum, thnum, itnum, rnd, (long long)bnum, lv);
+          "  opts=%d  bnum=%lld  lv=%d\n\n",
+          g_randseed, (long long)rnum, thnum, itnum, rnd, opts, (long long)bnum, lv);
   bool err = false;
   kc::StashDB db;
   db.tune_logger(stdlogger(g_progname, &std::cout),
                  lv ? kc::UINT32MAX : kc::BasicDB::Logger::WARN | kc::BasicDB::Logger::ERROR);
+  if (opts > 0) db.tune_options(opts);
   if (bnum > 0) db.tune_buckets(bnum);
   for (int32_t itcnt = 1; itcnt <= itnum; itcnt++) {
     if (itnum > 1) oprintf("iteration %d:\n", itcnt);
@@ -1518,14 +1562,16 @@ static int32_t procqueue(int64_t rnum, int32_t thnum, int32_t itnum, bool rnd,
 
 
 // perform wicked command
-static int32_t procwicked(int64_t rnum, int32_t thnum, int32_t itnum, int64_t bnum, bool lv) {
+static int32_t procwicked(int64_t rnum, int32_t thnum, int32_t itnum,
+                          int32_t opts, int64_t bnum, bool lv) {
   oprintf("<Wicked Test>\n  seed=%u  rnum=%lld  thnum=%d  itnum=%d"
-          "  bnum=%lld  lv=%d\n\n",
-          g_randseed, (long long)rnum, thnum, itnum, (long long)bnum, lv);
+          "  opts=%d  bnum=%lld  lv=%d\n\n",
+          g_randseed, (long long)rnum, thnum, itnum, opts, (long long)bnum, lv);
   bool err = false;
   kc::StashDB db;
   db.tune_logger(stdlogger(g_progname, &std::cout),
                  lv ? kc::UINT32MAX : kc::BasicDB::Logger::WARN | kc::BasicDB::Logger::ERROR);
+  if (opts > 0) db.tune_options(opts);
   if (bnum > 0) db.tune_buckets(bnum);
   for (int32_t itcnt = 1; itcnt <= itnum; itcnt++) {
     if (itnum > 1) oprintf("iteration %d:\n", itcnt);
@@ -1853,10 +1899,11 @@ static int32_t procwicked(int64_t rnum, int32_t thnum, int32_t itnum, int64_t bn
 
 
 // perform tran command
-static int32_t proctran(int64_t rnum, int32_t thnum, int32_t itnum, int64_t bnum, bool lv) {
+static int32_t proctran(int64_t rnum, int32_t thnum, int32_t itnum,
+                        int32_t opts, int64_t bnum, bool lv) {
   oprintf("<Transaction Test>\n  seed=%u  rnum=%lld  thnum=%d  itnum=%d"
-          "  bnum=%lld  lv=%d\n\n",
-          g_randseed, (long long)rnum, thnum, itnum, (long long)bnum, lv);
+          "  opts=%d  bnum=%lld  lv=%d\n\n",
+          g_randseed, (long long)rnum, thnum, itnum, opts, (long long)bnum, lv);
   bool err = false;
   kc::StashDB db;
   kc::StashDB paradb;
@@ -1864,6 +1911,7 @@ static int32_t proctran(int64_t rnum, int32_t thnum, int32_t itnum, int64_t bnum
                  lv ? kc::UINT32MAX : kc::BasicDB::Logger::WARN | kc::BasicDB::Logger::ERROR);
   paradb.tune_logger(stdlogger(g_progname, &std::cout), lv ? kc::UINT32MAX :
                      kc::BasicDB::Logger::WARN | kc::BasicDB::Logger::ERROR);
+  if (opts > 0) db.tune_options(opts);
   if (bnum > 0) db.tune_buckets(bnum);
   for (int32_t itcnt = 1; itcnt <= itnum; itcnt++) {
     oprintf("iteration %d updating:\n", itcnt);
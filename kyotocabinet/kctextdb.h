@@ -43,6 +43,7 @@ class TextDB : public BasicDB {
  public:
   class Cursor;
  private:
+  class LineReader;
   class ScopedVisitor;
   /** An alias of list of cursors. */
   typedef std::list<Cursor*> CursorList;
@@ -50,6 +51,99 @@ class TextDB : public BasicDB {
   typedef std::pair<int64_t, std::string> Record;
   /** The size of the IO buffer. */
   static const size_t IOBUFSIZ = 1024;
+  /** The size of the window mapped for scanning. */
+  static const int64_t SCANWINSIZ = 1LL << 24;
+  /**
+   * Reader of the lines in a region of the file.
+   */
+  class LineReader {
+   public:
+    /**
+     * Constructor.
+     * @param file the file object.
+     * @param off the offset of the beginning of the region.
+     * @param end the offset of the end of the region.
+     */
+    explicit LineReader(File* file, int64_t off, int64_t end) :
+        file_(file), view_(), woff_(off), end_(end), rp_(NULL), ep_(NULL),
+        loff_(0), line_(), out_(), err_(false) {
+      _assert_(file && off >= 0 && end >= 0);
+    }
+    /**
+     * Read the next line.
+     * @param offp the pointer to the variable into which the offset of the line is assigned.
+     * @param sp the pointer to the variable into which the size of the line is assigned.
+     * @return the pointer to the line, or NULL if no more line is available or on failure.
+     * @note The line does not include the line feed.  The region of the return value is valid
+     * until the next call.  The last line without the line feed is ignored.
+     */
+    const char* read(int64_t* offp, size_t* sp) {
+      _assert_(offp && sp);
+      while (true) {
+        if (rp_ < ep_) {
+          const char* pv = rp_;
+          const char* np = (const char*)std::memchr(pv, '\n', ep_ - pv);
+          if (np) {
+            rp_ = np + 1;
+            if (line_.empty()) {
+              *offp = woff_ - (ep_ - pv);
+              *sp = np - pv;
+              return pv;
+            }
+            line_.append(pv, np - pv);
+            out_.swap(line_);
+            line_.clear();
+            *offp = loff_;
+            *sp = out_.size();
+            return out_.data();
+          }
+          if (line_.empty()) loff_ = woff_ - (ep_ - pv);
+          line_.append(pv, ep_ - pv);
+          rp_ = ep_;
+        }
+        if (woff_ >= end_) return NULL;
+        int64_t wsiz = end_ - woff_;
+        if (wsiz > SCANWINSIZ) wsiz = SCANWINSIZ;
+        view_.close();
+        if (!view_.open(file_, woff_, wsiz)) {
+          err_ = true;
+          return NULL;
+        }
+        rp_ = view_.data();
+        ep_ = rp_ + wsiz;
+        woff_ += wsiz;
+      }
+    }
+    /**
+     * Check whether an error occurred.
+     * @return true if an error occurred, or false if not.
+     */
+    bool error() {
+      _assert_(true);
+      return err_;
+    }
+   private:
+    /** The file object. */
+    File* file_;
+    /** The view of the current window. */
+    FileView view_;
+    /** The offset of the end of the current window. */
+    int64_t woff_;
+    /** The offset of the end of the region. */
+    int64_t end_;
+    /** The current position in the window. */
+    const char* rp_;
+    /** The end position in the window. */
+    const char* ep_;
+    /** The offset of the pending line. */
+    int64_t loff_;
+    /** The pending line across windows. */
+    std::string line_;
+    /** The line returned last. */
+    std::string out_;
+    /** The flag of error. */
+    bool err_;
+  };
  public:
   /**
    * Cursor to indicate a record.
@@ -61,7 +155,7 @@ class TextDB : public BasicDB {
      * Constructor.
      * @param db the container database object.
      */
-    explicit Cursor(TextDB* db) : db_(db), off_(INT64MAX), end_(0), queue_(), line_() {
+    explicit Cursor(TextDB* db) : db_(db), off_(INT64MAX), end_(0), queue_(), reader_(NULL) {
       _assert_(db);
       ScopedRWLock lock(&db_->mlock_, true);
       db_->curs_.push_back(this);
@@ -71,6 +165,7 @@ class TextDB : public BasicDB {
      */
     virtual ~Cursor() {
       _assert_(true);
+      delete reader_;
       if (!db_) return;
       ScopedRWLock lock(&db_->mlock_, true);
       db_->curs_.remove(this);
@@ -113,7 +208,8 @@ class TextDB : public BasicDB {
       off_ = 0;
       end_ = db_->file_.size();
       queue_.clear();
-      line_.clear();
+      delete reader_;
+      reader_ = NULL;
       if (off_ >= end_) {
         db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
         return false;
@@ -136,7 +232,8 @@ class TextDB : public BasicDB {
       off_ = atoin(kbuf, ksiz);
       end_ = db_->file_.size();
       queue_.clear();
-      line_.clear();
+      delete reader_;
+      reader_ = NULL;
       if (off_ >= end_) {
         db_->set_error(_KCCODELINE_, Error::NOREC, "no record");
         return false;
@@ -274,34 +371,18 @@ class TextDB : public BasicDB {
      */
     bool read_next() {
       _assert_(true);
-      while (off_ < end_) {
-        char stack[IOBUFSIZ];
-        int64_t rsiz = end_ - off_;
-        if (rsiz > (int64_t)sizeof(stack)) rsiz = sizeof(stack);
-        if (!db_->file_.read_fast(off_, stack, rsiz)) {
-          db_->set_error(_KCCODELINE_, Error::SYSTEM, db_->file_.error());
-          return false;
-        }
-        const char* rp = stack;
-        const char* pv = rp;
-        const char* ep = rp + rsiz;
-        while (rp < ep) {
-          if (*rp == '\n') {
-            line_.append(pv, rp - pv);
-            Record rec;
-            rec.first = off_ + pv - stack;
-            rec.second = line_;
-            queue_.push_back(rec);
-            line_.clear();
-            rp++;
-            pv = rp;
-          } else {
-            rp++;
-          }
-        }
-        line_.append(pv, rp - pv);
-        off_ += rsiz;
-        if (!queue_.empty()) break;
+      if (off_ >= end_) return true;
+      if (!reader_) reader_ = new LineReader(&db_->file_, off_, end_);
+      int64_t off;
+      size_t lsiz;
+      const char* lbuf = reader_->read(&off, &lsiz);
+      if (lbuf) {
+        queue_.push_back(Record(off, std::string(lbuf, lsiz)));
+      } else if (reader_->error()) {
+        db_->set_error(_KCCODELINE_, Error::SYSTEM, db_->file_.error());
+        return false;
+      } else {
+        off_ = end_;
       }
       return true;
     }
@@ -317,8 +398,8 @@ class TextDB : public BasicDB {
     int64_t end_;
     /** The queue of read lines. */
     std::deque<Record> queue_;
-    /** The current line. */
-    std::string line_;
+    /** The reader of lines. */
+    LineReader* reader_;
   };
   /**
    * Default constructor.
@@ -496,6 +577,8 @@ class TextDB : public BasicDB {
    * TextDB::OTRYLOCK, which means locking is performed without blocking, TextDB::ONOREPAIR,
    * which means the database file is not repaired implicitly even if file destruction is
    * detected.
+   * TextDB::OREADBIAS may also be added to bias the lock of the database object to readers,
+   * which makes reading operations cheaper and updating operations dearer.
    * @return true on success, or false on failure.
    * @note Every opened database must be closed by the TextDB::close method when it is no
    * longer in use.  It is not allowed for two or more database objects in the same process to
@@ -504,6 +587,7 @@ class TextDB : public BasicDB {
   bool open(const std::string& path, uint32_t mode = OWRITER | OCREATE) {
     _assert_(true);
     ScopedRWLock lock(&mlock_, true);
+    mlock_.set_bias(mode & OREADBIAS);
     if (omode_ != 0) {
       set_error(_KCCODELINE_, Error::INVALID, "already opened");
       return false;
@@ -933,60 +1017,38 @@ class TextDB : public BasicDB {
       set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
       return false;
     }
-    int64_t off = 0;
-    int64_t end = file_.size();
+    LineReader reader(&file_, 0, file_.size());
     int64_t curcnt = 0;
-    std::string line;
-    char stack[IOBUFSIZ*4];
-    while (off < end) {
-      int64_t rsiz = end - off;
-      if (rsiz > (int64_t)sizeof(stack)) rsiz = sizeof(stack);
-      if (!file_.read_fast(off, stack, rsiz)) {
-        set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
-        return false;
-      }
-      const char* rp = stack;
-      const char* pv = rp;
-      const char* ep = rp + rsiz;
-      while (rp < ep) {
-        if (*rp == '\n') {
-          char kbuf[NUMBUFSIZ];
-          size_t ksiz = write_key(kbuf, off + pv - stack);
-          const char* vbuf;
-          size_t vsiz;
-          if (line.empty()) {
-            vbuf = visitor->visit_full(kbuf, ksiz, pv, rp - pv, &vsiz);
-          } else {
-            line.append(pv, rp - pv);
-            vbuf = visitor->visit_full(kbuf, ksiz, line.data(), line.size(), &vsiz);
-            line.clear();
-          }
-          if (vbuf != Visitor::NOP && vbuf != Visitor::REMOVE) {
-            char tstack[IOBUFSIZ];
-            size_t trsiz = vsiz + 1;
-            char* trbuf = trsiz > sizeof(tstack) ? new char[trsiz] : tstack;
-            std::memcpy(trbuf, vbuf, vsiz);
-            trbuf[vsiz] = '\n';
-            if (!file_.append(trbuf, trsiz)) {
-              set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
-              if (trbuf != stack) delete[] trbuf;
-              return false;
-            }
-            if (trbuf != tstack) delete[] trbuf;
-          }
-          curcnt++;
-          if (checker && !checker->check("iterate", "processing", curcnt, -1)) {
-            set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
-            return false;
-          }
-          rp++;
-          pv = rp;
-        } else {
-          rp++;
+    int64_t off;
+    size_t lsiz;
+    const char* lbuf;
+    while ((lbuf = reader.read(&off, &lsiz)) != NULL) {
+      char kbuf[NUMBUFSIZ];
+      size_t ksiz = write_key(kbuf, off);
+      size_t vsiz;
+      const char* vbuf = visitor->visit_full(kbuf, ksiz, lbuf, lsiz, &vsiz);
+      if (vbuf != Visitor::NOP && vbuf != Visitor::REMOVE) {
+        char stack[IOBUFSIZ];
+        size_t rsiz = vsiz + 1;
+        char* rbuf = rsiz > sizeof(stack) ? new char[rsiz] : stack;
+        std::memcpy(rbuf, vbuf, vsiz);
+        rbuf[vsiz] = '\n';
+        if (!file_.append(rbuf, rsiz)) {
+          set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
+          if (rbuf != stack) delete[] rbuf;
+          return false;
         }
+        if (rbuf != stack) delete[] rbuf;
+      }
+      curcnt++;
+      if (checker && !checker->check("iterate", "processing", curcnt, -1)) {
+        set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+        return false;
       }
-      line.append(pv, rp - pv);
-      off += rsiz;
+    }
+    if (reader.error()) {
+      set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
+      return false;
     }
     if (checker && !checker->check("iterate", "ending", -1, -1)) {
       set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
@@ -1026,18 +1088,9 @@ class TextDB : public BasicDB {
           set_error(_KCCODELINE_, Error::SYSTEM, file_.error());
           return false;
         }
-        int64_t noff = -1;
-        const char* rp = rbuf;
-        const char* ep = rp + rsiz;
-        while (rp < ep) {
-          if (*rp == '\n') {
-            noff = edge + (rp - rbuf);
-            break;
-          }
-          rp++;
-        }
-        if (noff >= 0) {
-          off = noff + 1;
+        const char* rp = (const char*)std::memchr(rbuf, '\n', rsiz);
+        if (rp) {
+          off = edge + (rp - rbuf) + 1;
           break;
         }
         edge += rsiz;
@@ -1067,45 +1120,24 @@ class TextDB : public BasicDB {
           File* file = &db->file_;
           Visitor* visitor = visitor_;
           ProgressChecker* checker = checker_;
-          int64_t off = begoff_;
-          int64_t end = endoff_;
-          std::string line;
-          char stack[IOBUFSIZ*4];
-          while (off < end) {
-            int64_t rsiz = end - off;
-            if (rsiz > (int64_t)sizeof(stack)) rsiz = sizeof(stack);
-            if (!file->read_fast(off, stack, rsiz)) {
-              db->set_error(_KCCODELINE_, Error::SYSTEM, file->error());
+          LineReader reader(file, begoff_, endoff_);
+          int64_t off;
+          size_t lsiz;
+          const char* lbuf;
+          while ((lbuf = reader.read(&off, &lsiz)) != NULL) {
+            char kbuf[NUMBUFSIZ];
+            size_t ksiz = db->write_key(kbuf, off);
+            size_t vsiz;
+            visitor->visit_full(kbuf, ksiz, lbuf, lsiz, &vsiz);
+            if (checker && !checker->check("iterate", "processing", -1, -1)) {
+              db->set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
+              error_ = db->error();
               return;
             }
-            const char* rp = stack;
-            const char* pv = rp;
-            const char* ep = rp + rsiz;
-            while (rp < ep) {
-              if (*rp == '\n') {
-                char kbuf[NUMBUFSIZ];
-                size_t ksiz = db->write_key(kbuf, off + pv - stack);
-                if (line.empty()) {
-                  size_t vsiz;
-                  visitor->visit_full(kbuf, ksiz, pv, rp - pv, &vsiz);
-                } else {
-                  line.append(pv, rp - pv);
-                  size_t vsiz;
-                  visitor->visit_full(kbuf, ksiz, line.data(), line.size(), &vsiz);
-                  line.clear();
-                }
-                if (checker && !checker->check("iterate", "processing", -1, -1)) {
-                  db->set_error(_KCCODELINE_, Error::LOGIC, "checker failed");
-                  return;
-                }
-                rp++;
-                pv = rp;
-              } else {
-                rp++;
-              }
-            }
-            line.append(pv, rp - pv);
-            off += rsiz;
+          }
+          if (reader.error()) {
+            db->set_error(_KCCODELINE_, Error::SYSTEM, file->error());
+            error_ = db->error();
           }
         }
         TextDB* db_;
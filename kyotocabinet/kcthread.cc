@@ -25,9 +25,27 @@ namespace kyotocabinet {                 // common namespace
 namespace {
 const uint32_t LOCKBUSYLOOP = 8192;      ///< threshold of busy loop and sleep for locking
 const size_t LOCKSEMNUM = 256;           ///< number of semaphores for locking
+const uint32_t LOCKSPINMAX = 10;         ///< number of rounds of spinning before parking
+const uint32_t LOCKPAUSEMAX = 64;        ///< maximum number of pauses in a round of spinning
+const int32_t SRWLOCKWRITER = 1 << 30;   ///< state of a spin rwlock held by the writer
+const size_t RWLOCKSLOTNUM = 64;         ///< number of reader slots of a biased rwlock
+const size_t RWLOCKLINESIZ = 64;         ///< size of a cache line for the reader slots
+const int32_t RWLOCKBIAS = 1 << 0;       ///< flag of a rwlock biased to readers
+const int32_t RWLOCKDRAIN = 1 << 1;      ///< flag of a biased rwlock draining the readers
+const int32_t RWLOCKHELD = 1 << 2;       ///< flag of a biased rwlock held by the writer
 }
 
 
+/**
+ * Whether the adaptive locking devices are available.
+ */
+#if !defined(_SYS_MSVC_) && !defined(_SYS_MINGW_) && _KC_GCCATOMIC
+#define _KC_ADAPTLOCK  1
+#else
+#define _KC_ADAPTLOCK  0
+#endif
+
+
 /**
  * Thread internal.
  */
@@ -69,6 +87,71 @@ static void* threadrun(void* arg);
 #endif
 
 
+#if _KC_ADAPTLOCK
+
+
+/**
+ * Spin for a while before retrying to get a lock.
+ * @param rnd the number of rounds spun so far, which makes the period longer exponentially.
+ */
+static void lockspin(uint32_t rnd);
+
+
+/**
+ * Block the current thread while a word keeps a value.
+ * @param addr the address of the word.
+ * @param val the value.
+ * @param wcnt the counter of blocking, which is used where the system has no futex.
+ */
+static void lockwait(int32_t* addr, int32_t val, uint32_t* wcnt);
+
+
+/**
+ * Wake up threads blocked on a word.
+ * @param addr the address of the word.
+ * @param num the maximum number of threads to wake up.
+ */
+static void locknotify(int32_t* addr, int32_t num);
+
+
+/**
+ * Park the current thread until a lock is released.
+ * @param seq the address of the sequence number incremented on each release.
+ * @param sleep the address of the number of parked threads.
+ * @param state the address of the state of the lock.
+ * @param obs the state with which the lock was found busy.
+ * @param wcnt the counter of blocking.
+ */
+static void lockpark(int32_t* seq, int32_t* sleep, int32_t* state, int32_t obs,
+                     uint32_t* wcnt);
+
+
+/**
+ * Wake up the threads parked on a lock.
+ * @param seq the address of the sequence number incremented on each release.
+ * @param sleep the address of the number of parked threads.
+ */
+static void lockwake(int32_t* seq, int32_t* sleep);
+
+
+/**
+ * Get an adaptive lock.
+ * @param word the address of the lock word, which is 0 when unlocked, 1 when locked, or 2 when
+ * locked and some threads may be parked.
+ */
+static void adaptlock(int32_t* word);
+
+
+/**
+ * Release an adaptive lock.
+ * @param word the address of the lock word.
+ */
+static void adaptunlock(int32_t* word);
+
+
+#endif
+
+
 /**
  * Default constructor.
  */
@@ -270,6 +353,63 @@ int64_t Thread::hash() {
 }
 
 
+/**
+ * Get the index of a slot for the current thread.
+ */
+size_t Thread::slot(size_t num) {
+  _assert_(num > 0);
+  uint64_t code = hash();
+  code = (code ^ (code >> 29)) * 0x9e3779b97f4a7c15ULL;
+  return (code >> 32) % num;
+}
+
+
+/**
+ * Bind the current thread to the processors of a NUMA node.
+ */
+bool Thread::bind_node(int32_t node) {
+#if defined(_SYS_LINUX_) && defined(CPU_SET)
+  _assert_(node >= 0);
+  char path[64];
+  std::sprintf(path, "/sys/devices/system/node/node%d/cpulist", (int)node);
+  int32_t fd = ::open(path, O_RDONLY);
+  if (fd < 0) return false;
+  char buf[4096];
+  ssize_t size = ::read(fd, buf, sizeof(buf) - 1);
+  ::close(fd);
+  if (size < 1) return false;
+  buf[size] = '\0';
+  ::cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  int32_t cnum = 0;
+  const char* rp = buf;
+  while (*rp != '\0') {
+    if (!std::isdigit((unsigned char)*rp)) {
+      rp++;
+      continue;
+    }
+    int64_t first = atoi(rp);
+    while (std::isdigit((unsigned char)*rp)) rp++;
+    int64_t last = first;
+    if (*rp == '-') {
+      rp++;
+      last = atoi(rp);
+      while (std::isdigit((unsigned char)*rp)) rp++;
+    }
+    for (int64_t i = first; i <= last && i < CPU_SETSIZE; i++) {
+      CPU_SET(i, &cpus);
+      cnum++;
+    }
+  }
+  if (cnum < 1) return false;
+  return ::sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+#else
+  _assert_(node >= 0);
+  return false;
+#endif
+}
+
+
 /**
  * Call the running thread.
  */
@@ -667,15 +807,7 @@ void SpinLock::lock() {
   }
 #elif _KC_GCCATOMIC
   _assert_(true);
-  uint32_t wcnt = 0;
-  while (!__sync_bool_compare_and_swap(&opq_, (void*)0, (void*)1)) {
-    if (wcnt >= LOCKBUSYLOOP) {
-      Thread::chill();
-    } else {
-      Thread::yield();
-      wcnt++;
-    }
-  }
+  adaptlock((int32_t*)&opq_);
 #else
   _assert_(true);
   ::pthread_spinlock_t* spin = (::pthread_spinlock_t*)opq_;
@@ -693,7 +825,7 @@ bool SpinLock::lock_try() {
   return ::InterlockedCompareExchange((LONG*)&opq_, 1, 0) == 0;
 #elif _KC_GCCATOMIC
   _assert_(true);
-  return __sync_bool_compare_and_swap(&opq_, (void*)0, (void*)1);
+  return __sync_bool_compare_and_swap((int32_t*)&opq_, 0, 1);
 #else
   _assert_(true);
   ::pthread_spinlock_t* spin = (::pthread_spinlock_t*)opq_;
@@ -714,7 +846,7 @@ void SpinLock::unlock() {
   ::InterlockedExchange((LONG*)&opq_, 0);
 #elif _KC_GCCATOMIC
   _assert_(true);
-  __sync_lock_release(&opq_);
+  adaptunlock((int32_t*)&opq_);
 #else
   _assert_(true);
   ::pthread_spinlock_t* spin = (::pthread_spinlock_t*)opq_;
@@ -809,16 +941,7 @@ void SlottedSpinLock::lock(size_t idx) {
 #elif _KC_GCCATOMIC
   _assert_(true);
   SlottedSpinLockCore* core = (SlottedSpinLockCore*)opq_;
-  uint32_t* lock = core->locks + idx;
-  uint32_t wcnt = 0;
-  while (!__sync_bool_compare_and_swap(lock, 0, 1)) {
-    if (wcnt >= LOCKBUSYLOOP) {
-      Thread::chill();
-    } else {
-      Thread::yield();
-      wcnt++;
-    }
-  }
+  adaptlock((int32_t*)(core->locks + idx));
 #else
   _assert_(true);
   SlottedSpinLockCore* core = (SlottedSpinLockCore*)opq_;
@@ -840,8 +963,7 @@ void SlottedSpinLock::unlock(size_t idx) {
 #elif _KC_GCCATOMIC
   _assert_(true);
   SlottedSpinLockCore* core = (SlottedSpinLockCore*)opq_;
-  uint32_t* lock = core->locks + idx;
-  __sync_lock_release(lock);
+  adaptunlock((int32_t*)(core->locks + idx));
 #else
   _assert_(true);
   SlottedSpinLockCore* core = (SlottedSpinLockCore*)opq_;
@@ -878,16 +1000,7 @@ void SlottedSpinLock::lock_all() {
   uint32_t* locks = core->locks;
   size_t slotnum = core->slotnum;
   for (size_t i = 0; i < slotnum; i++) {
-    uint32_t* lock = locks + i;
-    uint32_t wcnt = 0;
-    while (!__sync_bool_compare_and_swap(lock, 0, 1)) {
-      if (wcnt >= LOCKBUSYLOOP) {
-        Thread::chill();
-      } else {
-        Thread::yield();
-        wcnt++;
-      }
-    }
+    adaptlock((int32_t*)(locks + i));
   }
 #else
   _assert_(true);
@@ -921,8 +1034,7 @@ void SlottedSpinLock::unlock_all() {
   uint32_t* locks = core->locks;
   size_t slotnum = core->slotnum;
   for (size_t i = 0; i < slotnum; i++) {
-    uint32_t* lock = locks + i;
-    __sync_lock_release(lock);
+    adaptunlock((int32_t*)(locks + i));
   }
 #else
   _assert_(true);
@@ -937,6 +1049,60 @@ void SlottedSpinLock::unlock_all() {
 }
 
 
+/**
+ * RWLock internal.
+ */
+#if _KC_ADAPTLOCK
+struct RWLockSlot {
+  int32_t cnt;                           ///< count of readers
+  char pad[RWLOCKLINESIZ];               ///< padding
+};
+#endif
+#if !defined(_SYS_MSVC_) && !defined(_SYS_MINGW_)
+struct RWLockCore {
+  ::pthread_rwlock_t rwlock;             ///< the native rwlock
+#if _KC_ADAPTLOCK
+  int32_t flags;                         ///< flags of the reader bias
+  int32_t seq;                           ///< sequence number of releases
+  int32_t sleep;                         ///< number of parked threads
+  RWLockSlot* slots;                     ///< reader slots
+#endif
+};
+#endif
+
+
+#if _KC_ADAPTLOCK
+
+
+/**
+ * Get the reader slot of the current thread.
+ * @param core the internal fields.
+ * @return the pointer to the count of the slot.
+ */
+static int32_t* rwlockslot(RWLockCore* core);
+
+
+/**
+ * Get a reader lock of RWLock by the reader slot.
+ * @param core the internal fields.
+ * @param wait true to wait for the writer, or false to fail soon.
+ * @return true on success, or false if the bias is off or the writer holds the lock.
+ */
+static bool rwlocklockreader(RWLockCore* core, bool wait);
+
+
+/**
+ * Drain the readers of RWLock by the reader slots.
+ * @param core the internal fields.
+ * @param wait true to wait for the readers, or false to fail soon.
+ * @return true on success, or false if some readers hold the lock.
+ */
+static bool rwlockdrain(RWLockCore* core, bool wait);
+
+
+#endif
+
+
 /**
  * Default constructor.
  */
@@ -947,9 +1113,18 @@ RWLock::RWLock() : opq_(NULL) {
   opq_ = (void*)rwlock;
 #else
   _assert_(true);
-  ::pthread_rwlock_t* rwlock = new ::pthread_rwlock_t;
-  if (::pthread_rwlock_init(rwlock, NULL) != 0) throw std::runtime_error("pthread_rwlock_init");
-  opq_ = (void*)rwlock;
+  RWLockCore* core = new RWLockCore;
+  if (::pthread_rwlock_init(&core->rwlock, NULL) != 0) {
+    delete core;
+    throw std::runtime_error("pthread_rwlock_init");
+  }
+#if _KC_ADAPTLOCK
+  core->flags = 0;
+  core->seq = 0;
+  core->sleep = 0;
+  core->slots = NULL;
+#endif
+  opq_ = (void*)core;
 #endif
 }
 
@@ -964,9 +1139,12 @@ RWLock::~RWLock() {
   delete rwlock;
 #else
   _assert_(true);
-  ::pthread_rwlock_t* rwlock = (::pthread_rwlock_t*)opq_;
-  ::pthread_rwlock_destroy(rwlock);
-  delete rwlock;
+  RWLockCore* core = (RWLockCore*)opq_;
+  ::pthread_rwlock_destroy(&core->rwlock);
+#if _KC_ADAPTLOCK
+  delete[] core->slots;
+#endif
+  delete core;
 #endif
 }
 
@@ -981,8 +1159,11 @@ void RWLock::lock_writer() {
   rwlock->lock_writer();
 #else
   _assert_(true);
-  ::pthread_rwlock_t* rwlock = (::pthread_rwlock_t*)opq_;
-  if (::pthread_rwlock_wrlock(rwlock) != 0) throw std::runtime_error("pthread_rwlock_lock");
+  RWLockCore* core = (RWLockCore*)opq_;
+  if (::pthread_rwlock_wrlock(&core->rwlock) != 0) throw std::runtime_error("pthread_rwlock_lock");
+#if _KC_ADAPTLOCK
+  if (*(volatile int32_t*)&core->flags & RWLOCKBIAS) rwlockdrain(core, true);
+#endif
 #endif
 }
 
@@ -997,9 +1178,18 @@ bool RWLock::lock_writer_try() {
   return rwlock->lock_writer_try();
 #else
   _assert_(true);
-  ::pthread_rwlock_t* rwlock = (::pthread_rwlock_t*)opq_;
-  int32_t ecode = ::pthread_rwlock_trywrlock(rwlock);
-  if (ecode == 0) return true;
+  RWLockCore* core = (RWLockCore*)opq_;
+  int32_t ecode = ::pthread_rwlock_trywrlock(&core->rwlock);
+  if (ecode == 0) {
+#if _KC_ADAPTLOCK
+    if ((*(volatile int32_t*)&core->flags & RWLOCKBIAS) && !rwlockdrain(core, false)) {
+      if (::pthread_rwlock_unlock(&core->rwlock) != 0)
+        throw std::runtime_error("pthread_rwlock_unlock");
+      return false;
+    }
+#endif
+    return true;
+  }
   if (ecode != EBUSY) throw std::runtime_error("pthread_rwlock_trylock");
   return false;
 #endif
@@ -1014,10 +1204,21 @@ void RWLock::lock_reader() {
   _assert_(true);
   SpinRWLock* rwlock = (SpinRWLock*)opq_;
   rwlock->lock_reader();
+#elif _KC_ADAPTLOCK
+  _assert_(true);
+  RWLockCore* core = (RWLockCore*)opq_;
+  while (true) {
+    if ((*(volatile int32_t*)&core->flags & RWLOCKBIAS) && rwlocklockreader(core, true)) return;
+    if (::pthread_rwlock_rdlock(&core->rwlock) != 0)
+      throw std::runtime_error("pthread_rwlock_lock");
+    if (!(*(volatile int32_t*)&core->flags & RWLOCKBIAS)) return;
+    if (::pthread_rwlock_unlock(&core->rwlock) != 0)
+      throw std::runtime_error("pthread_rwlock_unlock");
+  }
 #else
   _assert_(true);
-  ::pthread_rwlock_t* rwlock = (::pthread_rwlock_t*)opq_;
-  if (::pthread_rwlock_rdlock(rwlock) != 0) throw std::runtime_error("pthread_rwlock_lock");
+  RWLockCore* core = (RWLockCore*)opq_;
+  if (::pthread_rwlock_rdlock(&core->rwlock) != 0) throw std::runtime_error("pthread_rwlock_lock");
 #endif
 }
 
@@ -1032,9 +1233,21 @@ bool RWLock::lock_reader_try() {
   return rwlock->lock_reader_try();
 #else
   _assert_(true);
-  ::pthread_rwlock_t* rwlock = (::pthread_rwlock_t*)opq_;
-  int32_t ecode = ::pthread_rwlock_tryrdlock(rwlock);
-  if (ecode == 0) return true;
+  RWLockCore* core = (RWLockCore*)opq_;
+#if _KC_ADAPTLOCK
+  if (*(volatile int32_t*)&core->flags & RWLOCKBIAS) return rwlocklockreader(core, false);
+#endif
+  int32_t ecode = ::pthread_rwlock_tryrdlock(&core->rwlock);
+  if (ecode == 0) {
+#if _KC_ADAPTLOCK
+    if (*(volatile int32_t*)&core->flags & RWLOCKBIAS) {
+      if (::pthread_rwlock_unlock(&core->rwlock) != 0)
+        throw std::runtime_error("pthread_rwlock_unlock");
+      return rwlocklockreader(core, false);
+    }
+#endif
+    return true;
+  }
   if (ecode != EBUSY) throw std::runtime_error("pthread_rwlock_trylock");
   return false;
 #endif
@@ -1051,12 +1264,131 @@ void RWLock::unlock() {
   rwlock->unlock();
 #else
   _assert_(true);
-  ::pthread_rwlock_t* rwlock = (::pthread_rwlock_t*)opq_;
-  if (::pthread_rwlock_unlock(rwlock) != 0) throw std::runtime_error("pthread_rwlock_unlock");
+  RWLockCore* core = (RWLockCore*)opq_;
+#if _KC_ADAPTLOCK
+  int32_t flags = *(volatile int32_t*)&core->flags;
+  if (flags & RWLOCKHELD) {
+    __sync_bool_compare_and_swap(&core->flags, flags, RWLOCKBIAS);
+    lockwake(&core->seq, &core->sleep);
+  } else if (flags & RWLOCKBIAS) {
+    __sync_sub_and_fetch(rwlockslot(core), 1);
+    lockwake(&core->seq, &core->sleep);
+    return;
+  }
+#endif
+  if (::pthread_rwlock_unlock(&core->rwlock) != 0)
+    throw std::runtime_error("pthread_rwlock_unlock");
+#endif
+}
+
+
+/**
+ * Set the bias to readers.
+ */
+void RWLock::set_bias(bool bias) {
+#if _KC_ADAPTLOCK
+  _assert_(true);
+  RWLockCore* core = (RWLockCore*)opq_;
+  int32_t flags = *(volatile int32_t*)&core->flags;
+  if (bias) {
+    if (flags & RWLOCKBIAS) return;
+    if (!core->slots) {
+      core->slots = new RWLockSlot[RWLOCKSLOTNUM];
+      for (size_t i = 0; i < RWLOCKSLOTNUM; i++) {
+        core->slots[i].cnt = 0;
+      }
+    }
+    __sync_bool_compare_and_swap(&core->flags, flags, RWLOCKBIAS | RWLOCKHELD);
+  } else {
+    if (!(flags & RWLOCKBIAS)) return;
+    __sync_bool_compare_and_swap(&core->flags, flags, 0);
+    lockwake(&core->seq, &core->sleep);
+  }
+#else
+  _assert_(true);
 #endif
 }
 
 
+#if _KC_ADAPTLOCK
+
+
+/**
+ * Get the reader slot of the current thread.
+ */
+static int32_t* rwlockslot(RWLockCore* core) {
+  _assert_(core);
+  return &core->slots[Thread::slot(RWLOCKSLOTNUM)].cnt;
+}
+
+
+/**
+ * Get a reader lock of RWLock by the reader slot.
+ */
+static bool rwlocklockreader(RWLockCore* core, bool wait) {
+  _assert_(core);
+  int32_t* cnt = rwlockslot(core);
+  uint32_t rnd = 0;
+  uint32_t wcnt = 0;
+  while (true) {
+    __sync_add_and_fetch(cnt, 1);
+    int32_t flags = *(volatile int32_t*)&core->flags;
+    if (flags == RWLOCKBIAS) return true;
+    __sync_sub_and_fetch(cnt, 1);
+    lockwake(&core->seq, &core->sleep);
+    if (!(flags & RWLOCKBIAS) || !wait) return false;
+    if (rnd < LOCKSPINMAX) {
+      lockspin(rnd++);
+    } else {
+      lockpark(&core->seq, &core->sleep, &core->flags, flags, &wcnt);
+    }
+  }
+}
+
+
+/**
+ * Drain the readers of RWLock by the reader slots.
+ */
+static bool rwlockdrain(RWLockCore* core, bool wait) {
+  _assert_(core);
+  RWLockSlot* slots = core->slots;
+  __sync_bool_compare_and_swap(&core->flags, RWLOCKBIAS, RWLOCKBIAS | RWLOCKDRAIN);
+  uint32_t rnd = 0;
+  uint32_t wcnt = 0;
+  while (true) {
+    int64_t sum = 0;
+    for (size_t i = 0; i < RWLOCKSLOTNUM; i++) {
+      sum += *(volatile int32_t*)&slots[i].cnt;
+    }
+    if (sum < 1) {
+      __sync_bool_compare_and_swap(&core->flags, RWLOCKBIAS | RWLOCKDRAIN,
+                                   RWLOCKBIAS | RWLOCKHELD);
+      return true;
+    }
+    if (!wait) {
+      __sync_bool_compare_and_swap(&core->flags, RWLOCKBIAS | RWLOCKDRAIN, RWLOCKBIAS);
+      lockwake(&core->seq, &core->sleep);
+      return false;
+    }
+    if (rnd < LOCKSPINMAX) {
+      lockspin(rnd++);
+      continue;
+    }
+    int32_t cur = *(volatile int32_t*)&core->seq;
+    __sync_add_and_fetch(&core->sleep, 1);
+    sum = 0;
+    for (size_t i = 0; i < RWLOCKSLOTNUM; i++) {
+      sum += *(volatile int32_t*)&slots[i].cnt;
+    }
+    if (sum > 0) lockwait(&core->seq, cur, &wcnt);
+    __sync_sub_and_fetch(&core->sleep, 1);
+  }
+}
+
+
+#endif
+
+
 /**
  * SlottedRWLock internal.
  */
@@ -1252,8 +1584,10 @@ struct SpinRWLockCore {
   LONG sem;                              ///< semaphore
   uint32_t cnt;                          ///< count of threads
 #elif _KC_GCCATOMIC
-  int32_t sem;                           ///< semaphore
-  uint32_t cnt;                          ///< count of threads
+  int32_t state;                         ///< count of readers or the writer flag
+  int32_t wwait;                         ///< number of waiting writers
+  int32_t seq;                           ///< sequence number of releases
+  int32_t sleep;                         ///< number of parked threads
 #else
   ::pthread_spinlock_t sem;              ///< semaphore
   uint32_t cnt;                          ///< count of threads
@@ -1261,6 +1595,9 @@ struct SpinRWLockCore {
 };
 
 
+#if !_KC_ADAPTLOCK
+
+
 /**
  * Lock the semephore of SpinRWLock.
  * @param core the internal fields.
@@ -1275,16 +1612,27 @@ static void spinrwlocklock(SpinRWLockCore* core);
 static void spinrwlockunlock(SpinRWLockCore* core);
 
 
+#endif
+
+
 /**
  * Default constructor.
  */
 SpinRWLock::SpinRWLock() : opq_(NULL) {
-#if defined(_SYS_MSVC_) || defined(_SYS_MINGW_) || _KC_GCCATOMIC
+#if defined(_SYS_MSVC_) || defined(_SYS_MINGW_)
   _assert_(true);
   SpinRWLockCore* core = new SpinRWLockCore;
   core->sem = 0;
   core->cnt = 0;
   opq_ = (void*)core;
+#elif _KC_GCCATOMIC
+  _assert_(true);
+  SpinRWLockCore* core = new SpinRWLockCore;
+  core->state = 0;
+  core->wwait = 0;
+  core->seq = 0;
+  core->sleep = 0;
+  opq_ = (void*)core;
 #else
   _assert_(true);
   SpinRWLockCore* core = new SpinRWLockCore;
@@ -1317,6 +1665,25 @@ SpinRWLock::~SpinRWLock() {
  * Get the writer lock.
  */
 void SpinRWLock::lock_writer() {
+#if _KC_ADAPTLOCK
+  _assert_(true);
+  SpinRWLockCore* core = (SpinRWLockCore*)opq_;
+  if (__sync_bool_compare_and_swap(&core->state, 0, SRWLOCKWRITER)) return;
+  __sync_add_and_fetch(&core->wwait, 1);
+  uint32_t rnd = 0;
+  uint32_t wcnt = 0;
+  while (true) {
+    int32_t state = *(volatile int32_t*)&core->state;
+    if (state == 0) {
+      if (__sync_bool_compare_and_swap(&core->state, 0, SRWLOCKWRITER)) break;
+    } else if (rnd < LOCKSPINMAX) {
+      lockspin(rnd++);
+    } else {
+      lockpark(&core->seq, &core->sleep, &core->state, state, &wcnt);
+    }
+  }
+  __sync_sub_and_fetch(&core->wwait, 1);
+#else
   _assert_(true);
   SpinRWLockCore* core = (SpinRWLockCore*)opq_;
   spinrwlocklock(core);
@@ -1333,6 +1700,7 @@ void SpinRWLock::lock_writer() {
   }
   core->cnt = INT32MAX;
   spinrwlockunlock(core);
+#endif
 }
 
 
@@ -1340,6 +1708,11 @@ void SpinRWLock::lock_writer() {
  * Try to get the writer lock.
  */
 bool SpinRWLock::lock_writer_try() {
+#if _KC_ADAPTLOCK
+  _assert_(true);
+  SpinRWLockCore* core = (SpinRWLockCore*)opq_;
+  return __sync_bool_compare_and_swap(&core->state, 0, SRWLOCKWRITER);
+#else
   _assert_(true);
   SpinRWLockCore* core = (SpinRWLockCore*)opq_;
   spinrwlocklock(core);
@@ -1350,6 +1723,7 @@ bool SpinRWLock::lock_writer_try() {
   core->cnt = INT32MAX;
   spinrwlockunlock(core);
   return true;
+#endif
 }
 
 
@@ -1357,6 +1731,23 @@ bool SpinRWLock::lock_writer_try() {
  * Get a reader lock.
  */
 void SpinRWLock::lock_reader() {
+#if _KC_ADAPTLOCK
+  _assert_(true);
+  SpinRWLockCore* core = (SpinRWLockCore*)opq_;
+  uint32_t rnd = 0;
+  uint32_t wcnt = 0;
+  while (true) {
+    int32_t state = *(volatile int32_t*)&core->state;
+    if (!(state & SRWLOCKWRITER) &&
+        (rnd >= LOCKSPINMAX || *(volatile int32_t*)&core->wwait < 1)) {
+      if (__sync_bool_compare_and_swap(&core->state, state, state + 1)) break;
+    } else if (rnd < LOCKSPINMAX) {
+      lockspin(rnd++);
+    } else {
+      lockpark(&core->seq, &core->sleep, &core->state, state, &wcnt);
+    }
+  }
+#else
   _assert_(true);
   SpinRWLockCore* core = (SpinRWLockCore*)opq_;
   spinrwlocklock(core);
@@ -1373,6 +1764,7 @@ void SpinRWLock::lock_reader() {
   }
   core->cnt++;
   spinrwlockunlock(core);
+#endif
 }
 
 
@@ -1380,6 +1772,15 @@ void SpinRWLock::lock_reader() {
  * Try to get a reader lock.
  */
 bool SpinRWLock::lock_reader_try() {
+#if _KC_ADAPTLOCK
+  _assert_(true);
+  SpinRWLockCore* core = (SpinRWLockCore*)opq_;
+  while (true) {
+    int32_t state = *(volatile int32_t*)&core->state;
+    if (state & SRWLOCKWRITER) return false;
+    if (__sync_bool_compare_and_swap(&core->state, state, state + 1)) return true;
+  }
+#else
   _assert_(true);
   SpinRWLockCore* core = (SpinRWLockCore*)opq_;
   spinrwlocklock(core);
@@ -1390,6 +1791,7 @@ bool SpinRWLock::lock_reader_try() {
   core->cnt++;
   spinrwlockunlock(core);
   return true;
+#endif
 }
 
 
@@ -1397,6 +1799,16 @@ bool SpinRWLock::lock_reader_try() {
  * Release the lock.
  */
 void SpinRWLock::unlock() {
+#if _KC_ADAPTLOCK
+  _assert_(true);
+  SpinRWLockCore* core = (SpinRWLockCore*)opq_;
+  if (*(volatile int32_t*)&core->state & SRWLOCKWRITER) {
+    __sync_bool_compare_and_swap(&core->state, SRWLOCKWRITER, 0);
+    lockwake(&core->seq, &core->sleep);
+  } else if (__sync_sub_and_fetch(&core->state, 1) == 0) {
+    lockwake(&core->seq, &core->sleep);
+  }
+#else
   _assert_(true);
   SpinRWLockCore* core = (SpinRWLockCore*)opq_;
   spinrwlocklock(core);
@@ -1406,6 +1818,7 @@ void SpinRWLock::unlock() {
     core->cnt--;
   }
   spinrwlockunlock(core);
+#endif
 }
 
 
@@ -1413,6 +1826,11 @@ void SpinRWLock::unlock() {
  * Promote a reader lock to the writer lock.
  */
 bool SpinRWLock::promote() {
+#if _KC_ADAPTLOCK
+  _assert_(true);
+  SpinRWLockCore* core = (SpinRWLockCore*)opq_;
+  return __sync_bool_compare_and_swap(&core->state, 1, SRWLOCKWRITER);
+#else
   _assert_(true);
   SpinRWLockCore* core = (SpinRWLockCore*)opq_;
   spinrwlocklock(core);
@@ -1423,6 +1841,7 @@ bool SpinRWLock::promote() {
   core->cnt = INT32MAX;
   spinrwlockunlock(core);
   return true;
+#endif
 }
 
 
@@ -1430,14 +1849,24 @@ bool SpinRWLock::promote() {
  * Demote the writer lock to a reader lock.
  */
 void SpinRWLock::demote() {
+#if _KC_ADAPTLOCK
+  _assert_(true);
+  SpinRWLockCore* core = (SpinRWLockCore*)opq_;
+  __sync_bool_compare_and_swap(&core->state, SRWLOCKWRITER, 1);
+  lockwake(&core->seq, &core->sleep);
+#else
   _assert_(true);
   SpinRWLockCore* core = (SpinRWLockCore*)opq_;
   spinrwlocklock(core);
   core->cnt = 1;
   spinrwlockunlock(core);
+#endif
 }
 
 
+#if !_KC_ADAPTLOCK
+
+
 /**
  * Lock the semephore of SpinRWLock.
  */
@@ -1447,11 +1876,6 @@ static void spinrwlocklock(SpinRWLockCore* core) {
   while (::InterlockedCompareExchange(&core->sem, 1, 0) != 0) {
     ::Sleep(0);
   }
-#elif _KC_GCCATOMIC
-  _assert_(core);
-  while (!__sync_bool_compare_and_swap(&core->sem, 0, 1)) {
-    ::sched_yield();
-  }
 #else
   _assert_(core);
   if (::pthread_spin_lock(&core->sem) != 0) throw std::runtime_error("pthread_spin_lock");
@@ -1466,9 +1890,6 @@ static void spinrwlockunlock(SpinRWLockCore* core) {
 #if defined(_SYS_MSVC_) || defined(_SYS_MINGW_)
   _assert_(core);
   ::InterlockedExchange(&core->sem, 0);
-#elif _KC_GCCATOMIC
-  _assert_(core);
-  __sync_lock_release(&core->sem);
 #else
   _assert_(core);
   if (::pthread_spin_unlock(&core->sem) != 0) throw std::runtime_error("pthread_spin_unlock");
@@ -1476,14 +1897,23 @@ static void spinrwlockunlock(SpinRWLockCore* core) {
 }
 
 
+#endif
+
+
 /**
  * SlottedRWLock internal.
  */
+#if !defined(_SYS_MSVC_) && !defined(_SYS_MINGW_) && _KC_GCCATOMIC
+struct SlottedSpinRWLockWait {
+  int32_t seq;                           ///< sequence number of releases
+  int32_t sleep;                         ///< number of parked threads
+};
+#endif
 struct SlottedSpinRWLockCore {
 #if defined(_SYS_MSVC_) || defined(_SYS_MINGW_)
   LONG sems[LOCKSEMNUM];                 ///< semaphores
 #elif _KC_GCCATOMIC
-  int32_t sems[LOCKSEMNUM];              ///< semaphores
+  SlottedSpinRWLockWait* waits;          ///< wait words of the slots
 #else
   ::pthread_spinlock_t sems[LOCKSEMNUM]; ///< semaphores
 #endif
@@ -1492,6 +1922,36 @@ struct SlottedSpinRWLockCore {
 };
 
 
+#if _KC_ADAPTLOCK
+
+
+/**
+ * Get the writer lock of a slot of SlottedSpinRWLock.
+ * @param core the internal fields.
+ * @param idx the index of the slot.
+ */
+static void slottedspinrwlockwriter(SlottedSpinRWLockCore* core, size_t idx);
+
+
+/**
+ * Get a reader lock of a slot of SlottedSpinRWLock.
+ * @param core the internal fields.
+ * @param idx the index of the slot.
+ */
+static void slottedspinrwlockreader(SlottedSpinRWLockCore* core, size_t idx);
+
+
+/**
+ * Release the lock of a slot of SlottedSpinRWLock.
+ * @param core the internal fields.
+ * @param idx the index of the slot.
+ */
+static void slottedspinrwlockrelease(SlottedSpinRWLockCore* core, size_t idx);
+
+
+#else
+
+
 /**
  * Lock the semephore of SlottedSpinRWLock.
  * @param core the internal fields.
@@ -1508,6 +1968,9 @@ static void slottedspinrwlocklock(SlottedSpinRWLockCore* core, size_t idx);
 static void slottedspinrwlockunlock(SlottedSpinRWLockCore* core, size_t idx);
 
 
+#endif
+
+
 /**
  * Constructor.
  */
@@ -1527,14 +1990,14 @@ SlottedSpinRWLock::SlottedSpinRWLock(size_t slotnum) : opq_(NULL) {
   opq_ = (void*)core;
 #elif _KC_GCCATOMIC
   SlottedSpinRWLockCore* core = new SlottedSpinRWLockCore;
-  int32_t* sems = core->sems;
+  SlottedSpinRWLockWait* waits = new SlottedSpinRWLockWait[slotnum];
   uint32_t* cnts = new uint32_t[slotnum];
-  for (size_t i = 0; i < LOCKSEMNUM; i++) {
-    sems[i] = 0;
-  }
   for (size_t i = 0; i < slotnum; i++) {
+    waits[i].seq = 0;
+    waits[i].sleep = 0;
     cnts[i] = 0;
   }
+  core->waits = waits;
   core->cnts = cnts;
   core->slotnum = slotnum;
   opq_ = (void*)core;
@@ -1561,10 +2024,16 @@ SlottedSpinRWLock::SlottedSpinRWLock(size_t slotnum) : opq_(NULL) {
  * Destructor.
  */
 SlottedSpinRWLock::~SlottedSpinRWLock() {
-#if defined(_SYS_MSVC_) || defined(_SYS_MINGW_) || _KC_GCCATOMIC
+#if defined(_SYS_MSVC_) || defined(_SYS_MINGW_)
+  _assert_(true);
+  SlottedSpinRWLockCore* core = (SlottedSpinRWLockCore*)opq_;
+  delete[] core->cnts;
+  delete core;
+#elif _KC_GCCATOMIC
   _assert_(true);
   SlottedSpinRWLockCore* core = (SlottedSpinRWLockCore*)opq_;
   delete[] core->cnts;
+  delete[] core->waits;
   delete core;
 #else
   _assert_(true);
@@ -1583,6 +2052,11 @@ SlottedSpinRWLock::~SlottedSpinRWLock() {
  * Get the writer lock of a slot.
  */
 void SlottedSpinRWLock::lock_writer(size_t idx) {
+#if _KC_ADAPTLOCK
+  _assert_(true);
+  SlottedSpinRWLockCore* core = (SlottedSpinRWLockCore*)opq_;
+  slottedspinrwlockwriter(core, idx);
+#else
   _assert_(true);
   SlottedSpinRWLockCore* core = (SlottedSpinRWLockCore*)opq_;
   size_t semidx = idx % LOCKSEMNUM;
@@ -1600,6 +2074,7 @@ void SlottedSpinRWLock::lock_writer(size_t idx) {
   }
   core->cnts[idx] = INT32MAX;
   slottedspinrwlockunlock(core, semidx);
+#endif
 }
 
 
@@ -1607,6 +2082,11 @@ void SlottedSpinRWLock::lock_writer(size_t idx) {
  * Get the reader lock of a slot.
  */
 void SlottedSpinRWLock::lock_reader(size_t idx) {
+#if _KC_ADAPTLOCK
+  _assert_(true);
+  SlottedSpinRWLockCore* core = (SlottedSpinRWLockCore*)opq_;
+  slottedspinrwlockreader(core, idx);
+#else
   _assert_(true);
   SlottedSpinRWLockCore* core = (SlottedSpinRWLockCore*)opq_;
   size_t semidx = idx % LOCKSEMNUM;
@@ -1624,6 +2104,7 @@ void SlottedSpinRWLock::lock_reader(size_t idx) {
   }
   core->cnts[idx]++;
   slottedspinrwlockunlock(core, semidx);
+#endif
 }
 
 
@@ -1631,6 +2112,11 @@ void SlottedSpinRWLock::lock_reader(size_t idx) {
  * Release the lock of a slot.
  */
 void SlottedSpinRWLock::unlock(size_t idx) {
+#if _KC_ADAPTLOCK
+  _assert_(true);
+  SlottedSpinRWLockCore* core = (SlottedSpinRWLockCore*)opq_;
+  slottedspinrwlockrelease(core, idx);
+#else
   _assert_(true);
   SlottedSpinRWLockCore* core = (SlottedSpinRWLockCore*)opq_;
   size_t semidx = idx % LOCKSEMNUM;
@@ -1641,6 +2127,7 @@ void SlottedSpinRWLock::unlock(size_t idx) {
     core->cnts[idx]--;
   }
   slottedspinrwlockunlock(core, semidx);
+#endif
 }
 
 
@@ -1648,6 +2135,14 @@ void SlottedSpinRWLock::unlock(size_t idx) {
  * Get the writer locks of all slots.
  */
 void SlottedSpinRWLock::lock_writer_all() {
+#if _KC_ADAPTLOCK
+  _assert_(true);
+  SlottedSpinRWLockCore* core = (SlottedSpinRWLockCore*)opq_;
+  size_t slotnum = core->slotnum;
+  for (size_t i = 0; i < slotnum; i++) {
+    slottedspinrwlockwriter(core, i);
+  }
+#else
   _assert_(true);
   SlottedSpinRWLockCore* core = (SlottedSpinRWLockCore*)opq_;
   uint32_t* cnts = core->cnts;
@@ -1669,6 +2164,7 @@ void SlottedSpinRWLock::lock_writer_all() {
     cnts[i] = INT32MAX;
     slottedspinrwlockunlock(core, semidx);
   }
+#endif
 }
 
 
@@ -1676,6 +2172,14 @@ void SlottedSpinRWLock::lock_writer_all() {
  * Get the reader locks of all slots.
  */
 void SlottedSpinRWLock::lock_reader_all() {
+#if _KC_ADAPTLOCK
+  _assert_(true);
+  SlottedSpinRWLockCore* core = (SlottedSpinRWLockCore*)opq_;
+  size_t slotnum = core->slotnum;
+  for (size_t i = 0; i < slotnum; i++) {
+    slottedspinrwlockreader(core, i);
+  }
+#else
   _assert_(true);
   SlottedSpinRWLockCore* core = (SlottedSpinRWLockCore*)opq_;
   uint32_t* cnts = core->cnts;
@@ -1697,6 +2201,7 @@ void SlottedSpinRWLock::lock_reader_all() {
     cnts[i]++;
     slottedspinrwlockunlock(core, semidx);
   }
+#endif
 }
 
 
@@ -1704,6 +2209,14 @@ void SlottedSpinRWLock::lock_reader_all() {
  * Release the locks of all slots.
  */
 void SlottedSpinRWLock::unlock_all() {
+#if _KC_ADAPTLOCK
+  _assert_(true);
+  SlottedSpinRWLockCore* core = (SlottedSpinRWLockCore*)opq_;
+  size_t slotnum = core->slotnum;
+  for (size_t i = 0; i < slotnum; i++) {
+    slottedspinrwlockrelease(core, i);
+  }
+#else
   _assert_(true);
   SlottedSpinRWLockCore* core = (SlottedSpinRWLockCore*)opq_;
   uint32_t* cnts = core->cnts;
@@ -1718,9 +2231,76 @@ void SlottedSpinRWLock::unlock_all() {
     }
     slottedspinrwlockunlock(core, semidx);
   }
+#endif
+}
+
+
+#if _KC_ADAPTLOCK
+
+
+/**
+ * Get the writer lock of a slot of SlottedSpinRWLock.
+ */
+static void slottedspinrwlockwriter(SlottedSpinRWLockCore* core, size_t idx) {
+  _assert_(core);
+  int32_t* cnt = (int32_t*)(core->cnts + idx);
+  SlottedSpinRWLockWait* wait = core->waits + idx;
+  uint32_t rnd = 0;
+  uint32_t wcnt = 0;
+  while (true) {
+    int32_t state = *(volatile int32_t*)cnt;
+    if (state == 0) {
+      if (__sync_bool_compare_and_swap(cnt, 0, INT32MAX)) break;
+    } else if (rnd < LOCKSPINMAX) {
+      lockspin(rnd++);
+    } else {
+      lockpark(&wait->seq, &wait->sleep, cnt, state, &wcnt);
+    }
+  }
+}
+
+
+/**
+ * Get a reader lock of a slot of SlottedSpinRWLock.
+ */
+static void slottedspinrwlockreader(SlottedSpinRWLockCore* core, size_t idx) {
+  _assert_(core);
+  int32_t* cnt = (int32_t*)(core->cnts + idx);
+  SlottedSpinRWLockWait* wait = core->waits + idx;
+  uint32_t rnd = 0;
+  uint32_t wcnt = 0;
+  while (true) {
+    int32_t state = *(volatile int32_t*)cnt;
+    if (state < INT32MAX) {
+      if (__sync_bool_compare_and_swap(cnt, state, state + 1)) break;
+    } else if (rnd < LOCKSPINMAX) {
+      lockspin(rnd++);
+    } else {
+      lockpark(&wait->seq, &wait->sleep, cnt, state, &wcnt);
+    }
+  }
 }
 
 
+/**
+ * Release the lock of a slot of SlottedSpinRWLock.
+ */
+static void slottedspinrwlockrelease(SlottedSpinRWLockCore* core, size_t idx) {
+  _assert_(core);
+  int32_t* cnt = (int32_t*)(core->cnts + idx);
+  SlottedSpinRWLockWait* wait = core->waits + idx;
+  if (*(volatile int32_t*)cnt >= INT32MAX) {
+    __sync_bool_compare_and_swap(cnt, INT32MAX, 0);
+    lockwake(&wait->seq, &wait->sleep);
+  } else if (__sync_sub_and_fetch(cnt, 1) == 0) {
+    lockwake(&wait->seq, &wait->sleep);
+  }
+}
+
+
+#else
+
+
 /**
  * Lock the semephore of SlottedSpinRWLock.
  */
@@ -1730,11 +2310,6 @@ static void slottedspinrwlocklock(SlottedSpinRWLockCore* core, size_t idx) {
   while (::InterlockedCompareExchange(core->sems + idx, 1, 0) != 0) {
     ::Sleep(0);
   }
-#elif _KC_GCCATOMIC
-  _assert_(core);
-  while (!__sync_bool_compare_and_swap(core->sems + idx, 0, 1)) {
-    ::sched_yield();
-  }
 #else
   _assert_(core);
   if (::pthread_spin_lock(core->sems + idx) != 0) throw std::runtime_error("pthread_spin_lock");
@@ -1749,9 +2324,6 @@ static void slottedspinrwlockunlock(SlottedSpinRWLockCore* core, size_t idx) {
 #if defined(_SYS_MSVC_) || defined(_SYS_MINGW_)
   _assert_(core);
   ::InterlockedExchange(core->sems + idx, 0);
-#elif _KC_GCCATOMIC
-  _assert_(core);
-  __sync_lock_release(core->sems + idx);
 #else
   _assert_(core);
   if (::pthread_spin_unlock(core->sems + idx) != 0)
@@ -1760,6 +2332,9 @@ static void slottedspinrwlockunlock(SlottedSpinRWLockCore* core, size_t idx) {
 }
 
 
+#endif
+
+
 /**
  * Default constructor.
  */
@@ -2141,6 +2716,119 @@ int64_t AtomicInt64::get() const {
 }
 
 
+#if _KC_ADAPTLOCK
+
+
+/**
+ * Spin for a while before retrying to get a lock.
+ */
+static void lockspin(uint32_t rnd) {
+  _assert_(true);
+  uint32_t num = rnd < 6 ? (uint32_t)1 << rnd : LOCKPAUSEMAX;
+  for (uint32_t i = 0; i < num; i++) {
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__("pause" ::: "memory");
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    __sync_synchronize();
+#endif
+  }
+}
+
+
+/**
+ * Block the current thread while a word keeps a value.
+ */
+static void lockwait(int32_t* addr, int32_t val, uint32_t* wcnt) {
+#if defined(_SYS_LINUX_)
+  _assert_(addr && wcnt);
+  struct ::timespec ts;
+  ts.tv_sec = 1;
+  ts.tv_nsec = 0;
+  ::syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, &ts, NULL, 0);
+#else
+  _assert_(addr && wcnt);
+  if (*(volatile int32_t*)addr != val) return;
+  if (*wcnt >= LOCKBUSYLOOP) {
+    Thread::chill();
+  } else {
+    Thread::yield();
+    (*wcnt)++;
+  }
+#endif
+}
+
+
+/**
+ * Wake up threads blocked on a word.
+ */
+static void locknotify(int32_t* addr, int32_t num) {
+#if defined(_SYS_LINUX_)
+  _assert_(addr && num > 0);
+  ::syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, num, NULL, NULL, 0);
+#else
+  _assert_(addr && num > 0);
+#endif
+}
+
+
+/**
+ * Park the current thread until a lock is released.
+ */
+static void lockpark(int32_t* seq, int32_t* sleep, int32_t* state, int32_t obs,
+                     uint32_t* wcnt) {
+  _assert_(seq && sleep && state && wcnt);
+  int32_t cur = *(volatile int32_t*)seq;
+  __sync_add_and_fetch(sleep, 1);
+  if (*(volatile int32_t*)state == obs) lockwait(seq, cur, wcnt);
+  __sync_sub_and_fetch(sleep, 1);
+}
+
+
+/**
+ * Wake up the threads parked on a lock.
+ */
+static void lockwake(int32_t* seq, int32_t* sleep) {
+  _assert_(seq && sleep);
+  if (*(volatile int32_t*)sleep < 1) return;
+  __sync_add_and_fetch(seq, 1);
+  locknotify(seq, INT32MAX);
+}
+
+
+/**
+ * Get an adaptive lock.
+ */
+static void adaptlock(int32_t* word) {
+  _assert_(word);
+  if (__sync_bool_compare_and_swap(word, 0, 1)) return;
+  for (uint32_t rnd = 0; rnd < LOCKSPINMAX; rnd++) {
+    lockspin(rnd);
+    if (*(volatile int32_t*)word == 0 && __sync_bool_compare_and_swap(word, 0, 1)) return;
+  }
+  uint32_t wcnt = 0;
+  while (__sync_lock_test_and_set(word, 2) != 0) {
+    lockwait(word, 2, &wcnt);
+  }
+}
+
+
+/**
+ * Release an adaptive lock.
+ */
+static void adaptunlock(int32_t* word) {
+  _assert_(word);
+  if (__sync_fetch_and_sub(word, 1) != 1) {
+    __sync_lock_release(word);
+    locknotify(word, 1);
+  }
+}
+
+
+#endif
+
+
 }                                        // common namespace
 
 // END OF FILE
@@ -74,6 +74,19 @@ class Thread {
    * @return the hash value of the current thread.
    */
   static int64_t hash();
+  /**
+   * Get the index of a slot for the current thread.
+   * @param num the number of slots.
+   * @return the index of the slot, which is spread evenly among threads and does not change
+   * while the current thread lives.
+   */
+  static size_t slot(size_t num);
+  /**
+   * Bind the current thread to the processors of a NUMA node.
+   * @param node the index of the node.
+   * @return true on success, or false on failure.
+   */
+  static bool bind_node(int32_t node);
  private:
   /** Dummy constructor to forbid the use. */
   Thread(const Thread&);
@@ -210,6 +223,7 @@ class SlottedMutex {
 
 /**
  * Lightweight mutual exclusion device.
+ * @note A waiting thread spins for a short while and then sleeps until the lock is released.
  */
 class SpinLock {
  public:
@@ -314,6 +328,10 @@ class SlottedSpinLock {
 
 /**
  * Reader-writer locking device.
+ * @note If the lock is biased to readers, each reader counts itself in one of the slots per
+ * thread group, which makes reader locks cheap but writer locks expensive.  A waiting writer
+ * then takes precedence over new readers, so a thread holding a reader lock must not get
+ * another reader lock of the same object.
  */
 class RWLock {
  public:
@@ -347,6 +365,13 @@ class RWLock {
    * Release the lock.
    */
   void unlock();
+  /**
+   * Set the bias to readers.
+   * @param bias true to bias the lock to readers, or false to bias it to nothing.
+   * @note This method must be called by the thread holding the writer lock.  It is ignored on
+   * platforms without atomic operations.
+   */
+  void set_bias(bool bias);
  private:
   /** Dummy constructor to forbid the use. */
   RWLock(const RWLock&);
@@ -441,6 +466,8 @@ class SlottedRWLock {
 
 /**
  * Lightweight reader-writer locking device.
+ * @note A waiting thread spins for a short while and then sleeps until the lock is released.
+ * Waiting writers take precedence over new readers while they spin.
  */
 class SpinRWLock {
  public:
@@ -1052,16 +1079,137 @@ class AtomicInt64 {
 };
 
 
+/**
+ * Integer counter sharded among threads.
+ * @note The value is divided into slots on separate cache lines and each thread adds values to
+ * the slot chosen by its identifier, so that frequent additions by many threads do not contend
+ * for the same cache line.  The slots are summed up whenever the value is read.  Reading is thus
+ * more expensive than with AtomicInt64 and the value read while other threads are adding may
+ * not be a snapshot at any moment.
+ */
+class ShardedInt64 {
+ public:
+  /** The number of slots. */
+  static const size_t SLOTNUM = 16;
+  /**
+   * Default constructor.
+   */
+  explicit ShardedInt64() : slots_() {
+    _assert_(true);
+  }
+  /**
+   * Constructor.
+   * @param num the initial value.
+   */
+  explicit ShardedInt64(int64_t num) : slots_() {
+    _assert_(true);
+    slots_[0].value = num;
+  }
+  /**
+   * Set the new value.
+   * @param val the new value.
+   * @return the old value.
+   * @note The value should not be added by other threads at the same time.
+   */
+  int64_t set(int64_t val) {
+    _assert_(true);
+    int64_t old = get();
+    slots_[0].value = val;
+    for (size_t i = 1; i < SLOTNUM; i++) {
+      slots_[i].value = 0;
+    }
+    return old;
+  }
+  /**
+   * Add a value.
+   * @param val the additional value.
+   */
+  void add(int64_t val) {
+    _assert_(true);
+    slots_[Thread::slot(SLOTNUM)].value.add(val);
+  }
+  /**
+   * Get the current value.
+   * @return the sum of all slots.
+   */
+  int64_t get() const {
+    _assert_(true);
+    int64_t sum = 0;
+    for (size_t i = 0; i < SLOTNUM; i++) {
+      sum += slots_[i].value.get();
+    }
+    return sum;
+  }
+  /**
+   * Assignment operator from integer.
+   * @param right the right operand.
+   * @return the reference to itself.
+   */
+  ShardedInt64& operator =(const int64_t& right) {
+    _assert_(true);
+    set(right);
+    return *this;
+  }
+  /**
+   * Cast operator to integer.
+   * @return the current value.
+   */
+  operator int64_t() const {
+    _assert_(true);
+    return get();
+  }
+  /**
+   * Summation assignment operator by integer.
+   * @param right the right operand.
+   * @return the reference to itself.
+   */
+  ShardedInt64& operator +=(int64_t right) {
+    _assert_(true);
+    add(right);
+    return *this;
+  }
+  /**
+   * Subtraction assignment operator by integer.
+   * @param right the right operand.
+   * @return the reference to itself.
+   */
+  ShardedInt64& operator -=(int64_t right) {
+    _assert_(true);
+    add(-right);
+    return *this;
+  }
+ private:
+  /** The size of a cache line. */
+  static const size_t LINESIZ = 64;
+  /**
+   * Slot of the value.
+   */
+  struct Slot {
+    AtomicInt64 value;                   ///< partial value
+    char pad[LINESIZ];                   ///< padding to keep slots on separate lines
+  };
+  /** Dummy constructor to forbid the use. */
+  ShardedInt64(const ShardedInt64&);
+  /** Dummy Operator to forbid the use. */
+  ShardedInt64& operator =(const ShardedInt64&);
+  /** The slots. */
+  Slot slots_[SLOTNUM];
+};
+
+
 /**
  * Task queue device.
+ * @note Each worker thread has its own queue of tasks.  Tasks are distributed among the queues
+ * in round robin and a worker thread whose queue is empty steals tasks from the others.  Only
+ * idle worker threads are woken up.
  */
 class TaskQueue {
  public:
   class Task;
  private:
   class WorkerThread;
-  /** An alias of list of tasks. */
-  typedef std::list<Task*> TaskList;
+  /** An alias of deque of tasks. */
+  typedef std::deque<Task*> TaskDeque;
  public:
   /**
    * Interface of a task.
@@ -1117,7 +1265,7 @@ class TaskQueue {
   /**
    * Default Constructor.
    */
-  TaskQueue() : thary_(NULL), thnum_(0), tasks_(), count_(0), mutex_(), cond_(), seed_(0) {
+  TaskQueue() : thary_(NULL), thnum_(0), seed_(0) {
     _assert_(true);
   }
   /**
@@ -1157,9 +1305,11 @@ class TaskQueue {
     for (size_t i = 0; i < thnum; i++) {
       thary_[i].id_ = i;
       thary_[i].queue_ = this;
-      thary_[i].start();
     }
     thnum_ = thnum;
+    for (size_t i = 0; i < thnum; i++) {
+      thary_[i].start();
+    }
   }
   /**
    * Finish the task queue.
@@ -1167,37 +1317,38 @@ class TaskQueue {
    */
   void finish() {
     _assert_(true);
-    mutex_.lock();
-    TaskList::iterator it = tasks_.begin();
-    TaskList::iterator itend = tasks_.end();
-    while (it != itend) {
-      Task* task = *it;
-      task->aborted_ = true;
-      ++it;
+    for (size_t i = 0; i < thnum_; i++) {
+      WorkerThread* worker = thary_ + i;
+      worker->lock_.lock();
+      TaskDeque::iterator it = worker->tasks_.begin();
+      TaskDeque::iterator itend = worker->tasks_.end();
+      while (it != itend) {
+        Task* task = *it;
+        task->aborted_ = true;
+        ++it;
+      }
+      worker->lock_.unlock();
+      worker->wake();
     }
-    cond_.broadcast();
-    mutex_.unlock();
     Thread::yield();
     for (double wsec = 1.0 / CLOCKTICK; true; wsec *= 2) {
-      mutex_.lock();
-      if (tasks_.empty()) {
-        mutex_.unlock();
-        break;
-      }
-      mutex_.unlock();
+      if (count() < 1) break;
       if (wsec > 1.0) wsec = 1.0;
       Thread::sleep(wsec);
     }
-    mutex_.lock();
     for (size_t i = 0; i < thnum_; i++) {
-      thary_[i].aborted_ = true;
+      WorkerThread* worker = thary_ + i;
+      worker->mutex_.lock();
+      worker->aborted_ = true;
+      worker->cond_.signal();
+      worker->mutex_.unlock();
     }
-    cond_.broadcast();
-    mutex_.unlock();
     for (size_t i = 0; i < thnum_; i++) {
       thary_[i].join();
     }
     delete[] thary_;
+    thary_ = NULL;
+    thnum_ = 0;
   }
   /**
    * Add a task.
@@ -1206,13 +1357,19 @@ class TaskQueue {
    */
   int64_t add_task(Task* task) {
     _assert_(task);
-    mutex_.lock();
-    task->id_ = ++seed_;
-    tasks_.push_back(task);
-    int64_t count = ++count_;
-    cond_.signal();
-    mutex_.unlock();
-    return count;
+    task->id_ = seed_.add(1) + 1;
+    size_t idx = (task->id_ - 1) % thnum_;
+    WorkerThread* worker = thary_ + idx;
+    worker->lock_.lock();
+    worker->tasks_.push_back(task);
+    worker->tnum_++;
+    worker->lock_.unlock();
+    if (!worker->wake()) {
+      for (size_t i = 1; i < thnum_; i++) {
+        if (thary_[(idx+i)%thnum_].wake()) break;
+      }
+    }
+    return count();
   }
   /**
    * Get the number of tasks in the queue.
@@ -1220,10 +1377,11 @@ class TaskQueue {
    */
   int64_t count() {
     _assert_(true);
-    mutex_.lock();
-    int64_t count = count_;
-    mutex_.unlock();
-    return count;
+    int64_t sum = 0;
+    for (size_t i = 0; i < thnum_; i++) {
+      sum += thary_[i].tnum_;
+    }
+    return sum;
   }
  private:
   /**
@@ -1231,8 +1389,12 @@ class TaskQueue {
    */
   class WorkerThread : public Thread {
     friend class TaskQueue;
+    /** The number of retries before parking. */
+    static const uint32_t IDLEBUSYLOOP = 16;
    public:
-    explicit WorkerThread() : id_(0), queue_(NULL), aborted_(false) {
+    explicit WorkerThread() :
+        id_(0), queue_(NULL), tasks_(), tnum_(0), lock_(), mutex_(), cond_(), parked_(false),
+        aborted_(false) {
       _assert_(true);
     }
    private:
@@ -1242,26 +1404,27 @@ class TaskQueue {
       stask->thid_ = id_;
       queue_->do_start(stask);
       delete stask;
-      bool empty = false;
+      uint32_t wcnt = 0;
       while (true) {
-        queue_->mutex_.lock();
-        if (aborted_) {
-          queue_->mutex_.unlock();
-          break;
+        Task* task = queue_->pop_task(this);
+        if (task) {
+          queue_->do_task(task);
+          wcnt = 0;
+          continue;
         }
-        if (empty) queue_->cond_.wait(&queue_->mutex_, 1.0);
-        Task * task = NULL;
-        if (queue_->tasks_.empty()) {
-          empty = true;
-        } else {
-          task = queue_->tasks_.front();
-          task->thid_ = id_;
-          queue_->tasks_.pop_front();
-          queue_->count_--;
-          empty = false;
+        if (wcnt < IDLEBUSYLOOP) {
+          Thread::yield();
+          wcnt++;
+          continue;
         }
-        queue_->mutex_.unlock();
-        if (task) queue_->do_task(task);
+        wcnt = 0;
+        mutex_.lock();
+        parked_ = true;
+        if (!aborted_ && !queue_->check_tasks()) cond_.wait(&mutex_, 1.0);
+        parked_ = false;
+        bool aborted = aborted_;
+        mutex_.unlock();
+        if (aborted) break;
       }
       Task* ftask = new Task;
       ftask->thid_ = id_;
@@ -1269,11 +1432,80 @@ class TaskQueue {
       queue_->do_finish(ftask);
       delete ftask;
     }
+    /**
+     * Wake up the thread if it is parked.
+     * @return true if it was parked, or false if not.
+     * @note The flag is checked without the mutex first, which is safe because the parking
+     * thread checks the queues under their locks after raising the flag.
+     */
+    bool wake() {
+      _assert_(true);
+      if (!parked_) return false;
+      mutex_.lock();
+      bool parked = parked_;
+      if (parked) {
+        parked_ = false;
+        cond_.signal();
+      }
+      mutex_.unlock();
+      return parked;
+    }
     uint32_t id_;
     TaskQueue* queue_;
-    Task* task_;
+    TaskDeque tasks_;
+    volatile size_t tnum_;
+    SpinLock lock_;
+    Mutex mutex_;
+    CondVar cond_;
+    volatile bool parked_;
     bool aborted_;
   };
+  /**
+   * Pop a task from the queue of a worker thread or steal one from the others.
+   * @param worker the worker thread.
+   * @return the task object, or NULL if no task is queued.
+   */
+  Task* pop_task(WorkerThread* worker) {
+    _assert_(worker);
+    Task* task = NULL;
+    worker->lock_.lock();
+    if (!worker->tasks_.empty()) {
+      task = worker->tasks_.front();
+      worker->tasks_.pop_front();
+      worker->tnum_--;
+    }
+    worker->lock_.unlock();
+    for (size_t i = 1; !task && i < thnum_; i++) {
+      WorkerThread* victim = thary_ + (worker->id_ + i) % thnum_;
+      victim->lock_.lock();
+      if (!victim->tasks_.empty()) {
+        task = victim->tasks_.back();
+        victim->tasks_.pop_back();
+        victim->tnum_--;
+      }
+      victim->lock_.unlock();
+    }
+    if (!task) return NULL;
+    task->thid_ = worker->id_;
+    return task;
+  }
+  /**
+   * Check whether any task is queued.
+   * @return true if any task is queued, or false if not.
+   * @note Each queue is checked under its lock, so that a task added after the check always
+   * finds the parking flag raised before it.
+   */
+  bool check_tasks() {
+    _assert_(true);
+    bool hit = false;
+    for (size_t i = 0; !hit && i < thnum_; i++) {
+      WorkerThread* worker = thary_ + i;
+      worker->lock_.lock();
+      hit = !worker->tasks_.empty();
+      worker->lock_.unlock();
+    }
+    return hit;
+  }
   /** Dummy constructor to forbid the use. */
   TaskQueue(const TaskQueue&);
   /** Dummy Operator to forbid the use. */
@@ -1282,16 +1514,8 @@ class TaskQueue {
   WorkerThread* thary_;
   /** The number of worker threads. */
   size_t thnum_;
-  /** The list of tasks. */
-  TaskList tasks_;
-  /** The number of the tasks. */
-  int64_t count_;
-  /** The mutex for the task list. */
-  Mutex mutex_;
-  /** The condition variable for the task list. */
-  CondVar cond_;
   /** The seed of ID numbers. */
-  uint64_t seed_;
+  AtomicInt64 seed_;
 };
 
 
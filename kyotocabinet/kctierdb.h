@@ -0,0 +1,1496 @@
+/*************************************************************************************************
+ * Tiered database
+ *                                                               Copyright (C) 2009-2012 FAL Labs
+ * This file is part of Kyoto Cabinet.
+ * This program is free software: you can redistribute it and/or modify it under the terms of
+ * the GNU General Public License as published by the Free Software Foundation, either version
+ * 3 of the License, or any later version.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************************************/
+
+
+#ifndef _KCTIERDB_H                      // duplication check
+#define _KCTIERDB_H
+
+#include <kccommon.h>
+#include <kcutil.h>
+#include <kcthread.h>
+#include <kcfile.h>
+#include <kccompress.h>
+#include <kccompare.h>
+#include <kcmap.h>
+#include <kcregex.h>
+#include <kcdb.h>
+
+namespace kyotocabinet {                 // common namespace
+
+
+/**
+ * Tiered database.
+ * @note This class is a concrete class to chain an on-memory front tier over a persistent back
+ * tier.  The tiers are registered by the TierDB::set_tiers method before the database is opened
+ * and then they are opened and closed together.  Records missing in the front tier are read
+ * from the back tier and kept in the front tier.  Keys missing in both tiers are remembered in
+ * a negative cache so that repeated lookups of absent keys do not reach the back tier.  The
+ * front tier should be a cache database whose capacity is limited, such as CacheDB.  Updates
+ * are written according to the tiering mode.  In the write-back mode, the back tier is updated
+ * by a background thread in batches.  Dirty records are written to the back tier before any
+ * operation on the whole database, including cursor positioning and transactions.
+ */
+class TierDB : public BasicDB {
+ public:
+  class Cursor;
+ private:
+  struct Change;
+  class ReplayVisitor;
+  class FlushThread;
+  /** An alias of map of pending changes. */
+  typedef std::map<std::string, Change> ChangeMap;
+  /** An alias of map of absent keys. */
+  typedef LinkedHashMap<std::string, bool> NegativeMap;
+  /** The number of slots of the record lock. */
+  static const int32_t RLOCKSLOT = 1024;
+  /** The default capacity of the negative cache. */
+  static const int64_t NEGCAPDEF = 1LL << 16;
+  /** The number of dirty records flushed at once. */
+  static const int64_t FLUSHUNIT = 1024;
+  /** The interval of the background flush in milliseconds. */
+  static const int32_t FLUSHWAIT = 200;
+  /** The number of dirty records above which writers flush them by themselves. */
+  static const int64_t DIRTYMAX = FLUSHUNIT * 64;
+  /** The threshold of busy loop and sleep for locking. */
+  static const uint32_t LOCKBUSYLOOP = 8192;
+ public:
+  /**
+   * Tiering modes.
+   */
+  enum Mode {
+    MREADTHROUGH,                        ///< write to the back tier and invalidate the front
+    MWRITETHROUGH,                       ///< write to both tiers synchronously
+    MWRITEBACK                           ///< write to the front and flush to the back later
+  };
+  /**
+   * Cursor to indicate a record.
+   * @note Records are scanned in the back tier.  Dirty records are written to the back tier
+   * whenever the cursor is positioned.  Records removed after that are skipped.
+   */
+  class Cursor : public BasicDB::Cursor {
+    friend class TierDB;
+   public:
+    /**
+     * Constructor.
+     * @param db the container database object.
+     */
+    explicit Cursor(TierDB* db) : db_(db), cur_(NULL) {
+      _assert_(db);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->back_) cur_ = db_->back_->cursor();
+    }
+    /**
+     * Destructor.
+     */
+    virtual ~Cursor() {
+      _assert_(true);
+      delete cur_;
+    }
+    /**
+     * Accept a visitor to the current record.
+     * @param visitor a visitor object.
+     * @param writable true for writable operation, or false for read-only operation.
+     * @param step true to move the cursor to the next record, or false for no move.
+     * @return true on success, or false on failure.
+     * @note The operation for each record is performed atomically and other threads accessing
+     * the same record are blocked.  To avoid deadlock, any explicit database operation must not
+     * be performed in this function.
+     */
+    bool accept(Visitor* visitor, bool writable = true, bool step = false) {
+      _assert_(visitor);
+      ScopedRWLock lock(&db_->mlock_, writable);
+      if (db_->omode_ == 0 || !cur_) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (writable && !(db_->omode_ & OWRITER)) {
+        db_->set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+        return false;
+      }
+      while (true) {
+        VisitorImpl cvis(db_, visitor, writable);
+        if (!cur_->accept(&cvis, writable, step)) {
+          db_->copy_error(cur_->db());
+          return false;
+        }
+        if (cvis.error()) return false;
+        if (!cvis.hidden()) break;
+        if (!step && !writable && !cur_->step()) {
+          db_->copy_error(cur_->db());
+          return false;
+        }
+      }
+      return true;
+    }
+    /**
+     * Jump the cursor to the first record for forward scan.
+     * @return true on success, or false on failure.
+     */
+    bool jump() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0 || !cur_) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (!db_->flush_dirty(0)) return false;
+      if (!cur_->jump()) {
+        db_->copy_error(cur_->db());
+        return false;
+      }
+      return true;
+    }
+    /**
+     * Jump the cursor to a record for forward scan.
+     * @param kbuf the pointer to the key region.
+     * @param ksiz the size of the key region.
+     * @return true on success, or false on failure.
+     */
+    bool jump(const char* kbuf, size_t ksiz) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0 || !cur_) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (!db_->flush_dirty(0)) return false;
+      if (!cur_->jump(kbuf, ksiz)) {
+        db_->copy_error(cur_->db());
+        return false;
+      }
+      return true;
+    }
+    /**
+     * Jump the cursor to a record for forward scan.
+     * @note Equal to the original Cursor::jump method except that the parameter is std::string.
+     */
+    bool jump(const std::string& key) {
+      _assert_(true);
+      return jump(key.c_str(), key.size());
+    }
+    /**
+     * Jump the cursor to the last record for backward scan.
+     * @return true on success, or false on failure.
+     * @note This method is dedicated to tree databases.  Some database types, especially hash
+     * databases, may provide a dummy implementation.
+     */
+    bool jump_back() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0 || !cur_) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (!db_->flush_dirty(0)) return false;
+      if (!cur_->jump_back()) {
+        db_->copy_error(cur_->db());
+        return false;
+      }
+      return true;
+    }
+    /**
+     * Jump the cursor to a record for backward scan.
+     * @param kbuf the pointer to the key region.
+     * @param ksiz the size of the key region.
+     * @return true on success, or false on failure.
+     * @note This method is dedicated to tree databases.  Some database types, especially hash
+     * databases, will provide a dummy implementation.
+     */
+    bool jump_back(const char* kbuf, size_t ksiz) {
+      _assert_(kbuf && ksiz <= MEMMAXSIZ);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0 || !cur_) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (!db_->flush_dirty(0)) return false;
+      if (!cur_->jump_back(kbuf, ksiz)) {
+        db_->copy_error(cur_->db());
+        return false;
+      }
+      return true;
+    }
+    /**
+     * Jump the cursor to a record for backward scan.
+     * @note Equal to the original Cursor::jump_back method except that the parameter is
+     * std::string.
+     */
+    bool jump_back(const std::string& key) {
+      _assert_(true);
+      return jump_back(key.c_str(), key.size());
+    }
+    /**
+     * Step the cursor to the next record.
+     * @return true on success, or false on failure.
+     */
+    bool step() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0 || !cur_) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (!cur_->step()) {
+        db_->copy_error(cur_->db());
+        return false;
+      }
+      return true;
+    }
+    /**
+     * Step the cursor to the previous record.
+     * @return true on success, or false on failure.
+     * @note This method is dedicated to tree databases.  Some database types, especially hash
+     * databases, may provide a dummy implementation.
+     */
+    bool step_back() {
+      _assert_(true);
+      ScopedRWLock lock(&db_->mlock_, false);
+      if (db_->omode_ == 0 || !cur_) {
+        db_->set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        return false;
+      }
+      if (!cur_->step_back()) {
+        db_->copy_error(cur_->db());
+        return false;
+      }
+      return true;
+    }
+    /**
+     * Get the database object.
+     * @return the database object.
+     */
+    TierDB* db() {
+      _assert_(true);
+      return db_;
+    }
+   private:
+    /**
+     * Visitor to keep the front tier and the dirty records consistent with the back tier.
+     * @note The value of a dirty record is shown instead of the stale one in the back tier.
+     */
+    class VisitorImpl : public Visitor {
+     public:
+      /** constructor */
+      explicit VisitorImpl(TierDB* db, Visitor* visitor, bool writable) :
+          db_(db), visitor_(visitor), writable_(writable), value_(), hidden_(false),
+          err_(false) {}
+      /** check the error status */
+      bool error() {
+        return err_;
+      }
+      /** check whether the record was removed in the dirty records */
+      bool hidden() {
+        return hidden_;
+      }
+     private:
+      const char* visit_full(const char* kbuf, size_t ksiz,
+                             const char* vbuf, size_t vsiz, size_t* sp) {
+        std::string key(kbuf, ksiz);
+        bool dirty = false;
+        bool removed = false;
+        if (db_->mode_ == MWRITEBACK) {
+          ScopedMutex lock(&db_->dlock_);
+          ChangeMap::iterator it = db_->dirty_.find(key);
+          if (it != db_->dirty_.end()) {
+            dirty = true;
+            removed = it->second.removed;
+            value_ = it->second.value;
+          }
+        }
+        const char* rbuf = NOP;
+        if (!dirty) {
+          rbuf = visitor_->visit_full(kbuf, ksiz, vbuf, vsiz, sp);
+        } else if (removed) {
+          hidden_ = true;
+          rbuf = REMOVE;
+        } else {
+          rbuf = visitor_->visit_full(kbuf, ksiz, value_.data(), value_.size(), sp);
+        }
+        if (!writable_ || rbuf == NOP) return NOP;
+        if (dirty) {
+          ScopedMutex lock(&db_->dlock_);
+          db_->dirty_.erase(key);
+        }
+        if (rbuf == REMOVE) {
+          if (!db_->update_front(key, NULL, 0)) err_ = true;
+        } else {
+          if (!db_->update_front(key, rbuf, *sp)) err_ = true;
+        }
+        return rbuf;
+      }
+      TierDB* db_;
+      Visitor* visitor_;
+      bool writable_;
+      std::string value_;
+      bool hidden_;
+      bool err_;
+    };
+    /** Dummy constructor to forbid the use. */
+    Cursor(const Cursor&);
+    /** Dummy Operator to forbid the use. */
+    Cursor& operator =(const Cursor&);
+    /** The inner database. */
+    TierDB* db_;
+    /** The cursor of the back tier. */
+    BasicDB::Cursor* cur_;
+  };
+  /**
+   * Default constructor.
+   */
+  explicit TierDB() :
+      mlock_(), rlock_(RLOCKSLOT), dlock_(), flock_(), nlock_(), wlock_(), wcond_(), error_(),
+      logger_(NULL), logkinds_(0), mtrigger_(NULL), omode_(0), front_(NULL), fpath_(""),
+      back_(NULL), bpath_(""), path_(""), mode_(MWRITETHROUGH), negcap_(NEGCAPDEF),
+      tran_(false), dirty_(), dseq_(0), neg_(), flusher_(NULL), fstop_(false),
+      fhitcnt_(0), fmisscnt_(0), bhitcnt_(0), bmisscnt_(0), nhitcnt_(0), flushcnt_(0) {
+    _assert_(true);
+  }
+  /**
+   * Destructor.
+   * @note If the database is not closed, it is closed implicitly.  The tiers are deleted.
+   */
+  virtual ~TierDB() {
+    _assert_(true);
+    if (omode_ != 0) close();
+    delete front_;
+    delete back_;
+  }
+  /**
+   * Set the tiers.
+   * @param front the database object of the front tier.  Its possession is transferred inside
+   * and the object is deleted automatically.
+   * @param fpath the path of the front tier, which is given to its open method.
+   * @param back the database object of the back tier.  Its possession is transferred inside and
+   * the object is deleted automatically.
+   * @param bpath the path of the back tier, which is given to its open method.
+   * @return true on success, or false on failure.
+   */
+  bool set_tiers(BasicDB* front, const std::string& fpath,
+                 BasicDB* back, const std::string& bpath) {
+    _assert_(front && back);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    delete front_;
+    delete back_;
+    front_ = front;
+    fpath_ = fpath;
+    back_ = back;
+    bpath_ = bpath;
+    return true;
+  }
+  /**
+   * Accept a visitor to a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @return true on success, or false on failure.
+   * @note The operation for each record is performed atomically and other threads accessing the
+   * same record are blocked.  To avoid deadlock, any explicit database operation must not be
+   * performed in this function.
+   */
+  bool accept(const char* kbuf, size_t ksiz, Visitor* visitor, bool writable = true) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (writable && !(omode_ & OWRITER)) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    size_t lidx = hashmurmur(kbuf, ksiz) % RLOCKSLOT;
+    if (writable) {
+      rlock_.lock_writer(lidx);
+    } else {
+      rlock_.lock_reader(lidx);
+    }
+    bool err = false;
+    if (!accept_impl(kbuf, ksiz, visitor, writable, NULL)) err = true;
+    rlock_.unlock(lidx);
+    return !err;
+  }
+  /**
+   * Accept a visitor to multiple records at once.
+   * @param keys specifies a string vector of the keys.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @return true on success, or false on failure.
+   * @note The operations for specified records are performed atomically and other threads
+   * accessing the same records are blocked.  Unless in the write-back mode, the updates are
+   * written to the back tier at once before the front tier is updated.  To avoid deadlock, any
+   * explicit database operation must not be performed in this function.
+   */
+  bool accept_bulk(const std::vector<std::string>& keys, Visitor* visitor,
+                   bool writable = true) {
+    _assert_(visitor);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (writable && !(omode_ & OWRITER)) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    visitor->visit_before();
+    std::set<size_t> lidxs;
+    std::vector<std::string>::const_iterator kit = keys.begin();
+    std::vector<std::string>::const_iterator kitend = keys.end();
+    while (kit != kitend) {
+      lidxs.insert(hashmurmur(kit->data(), kit->size()) % RLOCKSLOT);
+      ++kit;
+    }
+    std::set<size_t>::iterator lit = lidxs.begin();
+    std::set<size_t>::iterator litend = lidxs.end();
+    while (lit != litend) {
+      if (writable) {
+        rlock_.lock_writer(*lit);
+      } else {
+        rlock_.lock_reader(*lit);
+      }
+      ++lit;
+    }
+    bool err = false;
+    ChangeMap batch;
+    ChangeMap* bp = writable && (mode_ != MWRITEBACK || tran_) ? &batch : NULL;
+    kit = keys.begin();
+    while (kit != kitend) {
+      if (!accept_impl(kit->data(), kit->size(), visitor, writable, bp)) {
+        err = true;
+        break;
+      }
+      ++kit;
+    }
+    if (!err && !batch.empty()) {
+      if (apply_changes(batch)) {
+        ChangeMap::iterator it = batch.begin();
+        ChangeMap::iterator itend = batch.end();
+        while (it != itend) {
+          const Change& change = it->second;
+          const char* vbuf = change.removed ? NULL : change.value.data();
+          if (!update_front(it->first, vbuf, change.value.size())) err = true;
+          ++it;
+        }
+      } else {
+        err = true;
+      }
+    }
+    lit = lidxs.begin();
+    while (lit != litend) {
+      rlock_.unlock(*lit);
+      ++lit;
+    }
+    visitor->visit_after();
+    return !err;
+  }
+  /**
+   * Iterate to accept a visitor for each record.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note The records of the back tier are iterated after the dirty records are written.  If
+   * the operation is writable, the front tier is cleared afterwards.  The whole iteration is
+   * performed atomically and other threads are blocked.  To avoid deadlock, any explicit
+   * database operation must not be performed in this function.
+   */
+  bool iterate(Visitor *visitor, bool writable = true, ProgressChecker* checker = NULL) {
+    _assert_(visitor);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (writable && !(omode_ & OWRITER)) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    if (!flush_dirty(0)) return false;
+    bool err = false;
+    if (!back_->iterate(visitor, writable, checker)) {
+      copy_error(back_);
+      err = true;
+    }
+    if (writable && !clear_front()) err = true;
+    trigger_meta(MetaTrigger::ITERATE, "iterate");
+    return !err;
+  }
+  /**
+   * Scan each record in parallel.
+   * @param visitor a visitor object.
+   * @param thnum the number of worker threads.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note This function is for reading records and not for updating ones.  The return value of
+   * the visitor is just ignored.  The records of the back tier are scanned after the dirty
+   * records are written.  To avoid deadlock, any explicit database operation must not be
+   * performed in this function.
+   */
+  bool scan_parallel(Visitor *visitor, size_t thnum, ProgressChecker* checker = NULL) {
+    _assert_(visitor && thnum <= MEMMAXSIZ);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!flush_dirty(0)) return false;
+    if (!back_->scan_parallel(visitor, thnum, checker)) {
+      copy_error(back_);
+      return false;
+    }
+    trigger_meta(MetaTrigger::ITERATE, "scan_parallel");
+    return true;
+  }
+  /**
+   * Get the last happened error.
+   * @return the last happened error.
+   */
+  Error error() const {
+    _assert_(true);
+    return error_;
+  }
+  /**
+   * Set the error information.
+   * @param file the file name of the program source code.
+   * @param line the line number of the program source code.
+   * @param func the function name of the program source code.
+   * @param code an error code.
+   * @param message a supplement message.
+   */
+  void set_error(const char* file, int32_t line, const char* func,
+                 Error::Code code, const char* message) {
+    _assert_(file && line > 0 && func && message);
+    error_->set(code, message);
+    if (logger_) {
+      Logger::Kind kind = code == Error::BROKEN || code == Error::SYSTEM ?
+          Logger::ERROR : Logger::INFO;
+      if (kind & logkinds_)
+        report(file, line, func, kind, "%d: %s: %s", code, Error::codename(code), message);
+    }
+  }
+  /**
+   * Open a database file.
+   * @param path the path of the whole database, which is used only for identification.
+   * @param mode the connection mode, which is given to the back tier.
+   * @return true on success, or false on failure.
+   * @note The front tier is always opened as a new writable database.  In the write-back mode,
+   * the background thread to flush dirty records is started.
+   */
+  bool open(const std::string& path, uint32_t mode = OWRITER | OCREATE) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    mlock_.set_bias(mode & OREADBIAS);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    if (!front_ || !back_) {
+      set_error(_KCCODELINE_, Error::INVALID, "no tier");
+      return false;
+    }
+    report(_KCCODELINE_, Logger::DEBUG, "opening the database (path=%s)", path.c_str());
+    if (!front_->open(fpath_, OWRITER | OCREATE | OTRUNCATE)) {
+      copy_error(front_);
+      return false;
+    }
+    if (!back_->open(bpath_, mode)) {
+      copy_error(back_);
+      front_->close();
+      return false;
+    }
+    omode_ = mode;
+    path_ = path;
+    tran_ = false;
+    if (mode_ == MWRITEBACK && (mode & OWRITER)) {
+      fstop_ = false;
+      flusher_ = new FlushThread(this);
+      flusher_->start();
+    }
+    trigger_meta(MetaTrigger::OPEN, "open");
+    return true;
+  }
+  /**
+   * Close the database file.
+   * @return true on success, or false on failure.
+   * @note Dirty records are written to the back tier before it is closed.
+   */
+  bool close() {
+    _assert_(true);
+    if (flusher_) {
+      wlock_.lock();
+      fstop_ = true;
+      wcond_.broadcast();
+      wlock_.unlock();
+      flusher_->join();
+      delete flusher_;
+      flusher_ = NULL;
+    }
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    report(_KCCODELINE_, Logger::DEBUG, "closing the database (path=%s)", path_.c_str());
+    bool err = false;
+    if (!flush_dirty(0)) err = true;
+    if (tran_ && !back_->end_transaction(false)) {
+      copy_error(back_);
+      err = true;
+    }
+    if (!back_->close()) {
+      copy_error(back_);
+      err = true;
+    }
+    if (!front_->close()) {
+      copy_error(front_);
+      err = true;
+    }
+    nlock_.lock();
+    neg_.clear();
+    nlock_.unlock();
+    omode_ = 0;
+    path_.clear();
+    tran_ = false;
+    trigger_meta(MetaTrigger::CLOSE, "close");
+    return !err;
+  }
+  /**
+   * Synchronize updated contents with the file and the device.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @param proc a postprocessor object.  If it is NULL, no postprocessing is performed.
+   * @param checker a progress checker object.  If it is NULL, no checking is performed.
+   * @return true on success, or false on failure.
+   * @note Dirty records are written before the back tier is synchronized.
+   */
+  bool synchronize(bool hard = false, FileProcessor* proc = NULL,
+                   ProgressChecker* checker = NULL) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!flush_dirty(0)) return false;
+    bool err = false;
+    if (!back_->synchronize(hard, proc, checker)) {
+      copy_error(back_);
+      err = true;
+    }
+    trigger_meta(MetaTrigger::SYNCHRONIZE, "synchronize");
+    return !err;
+  }
+  /**
+   * Occupy database by locking and do something meanwhile.
+   * @param writable true to use writer lock, or false to use reader lock.
+   * @param proc a processor object.  If it is NULL, no processing is performed.
+   * @return true on success, or false on failure.
+   * @note The operation of the processor is performed atomically and other threads accessing
+   * the same record are blocked.  To avoid deadlock, any explicit database operation must not
+   * be performed in this function.
+   */
+  bool occupy(bool writable = true, FileProcessor* proc = NULL) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, writable);
+    bool err = false;
+    if (omode_ != 0 && !flush_dirty(0)) err = true;
+    if (proc && !proc->process(path_, count_impl(), size_impl())) {
+      set_error(_KCCODELINE_, Error::LOGIC, "processing failed");
+      err = true;
+    }
+    trigger_meta(MetaTrigger::OCCUPY, "occupy");
+    return !err;
+  }
+  /**
+   * Begin transaction.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @return true on success, or false on failure.
+   * @note Dirty records are written and then a transaction of the back tier is begun.  Updates
+   * in the transaction are written through even in the write-back mode.  If the transaction is
+   * aborted, the front tier is cleared.
+   */
+  bool begin_transaction(bool hard = false) {
+    _assert_(true);
+    uint32_t wcnt = 0;
+    while (true) {
+      mlock_.lock_writer();
+      if (omode_ == 0) {
+        set_error(_KCCODELINE_, Error::INVALID, "not opened");
+        mlock_.unlock();
+        return false;
+      }
+      if (!(omode_ & OWRITER)) {
+        set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+        mlock_.unlock();
+        return false;
+      }
+      if (!tran_) break;
+      mlock_.unlock();
+      if (wcnt >= LOCKBUSYLOOP) {
+        Thread::chill();
+      } else {
+        Thread::yield();
+        wcnt++;
+      }
+    }
+    if (!begin_transaction_impl(hard)) {
+      mlock_.unlock();
+      return false;
+    }
+    trigger_meta(MetaTrigger::BEGINTRAN, "begin_transaction");
+    mlock_.unlock();
+    return true;
+  }
+  /**
+   * Try to begin transaction.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @return true on success, or false on failure.
+   */
+  bool begin_transaction_try(bool hard = false) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!(omode_ & OWRITER)) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    if (tran_) {
+      set_error(_KCCODELINE_, Error::LOGIC, "competition avoided");
+      return false;
+    }
+    if (!begin_transaction_impl(hard)) return false;
+    trigger_meta(MetaTrigger::BEGINTRAN, "begin_transaction_try");
+    return true;
+  }
+  /**
+   * End transaction.
+   * @param commit true to commit the transaction, or false to abort the transaction.
+   * @return true on success, or false on failure.
+   */
+  bool end_transaction(bool commit = true) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!tran_) {
+      set_error(_KCCODELINE_, Error::INVALID, "not in transaction");
+      return false;
+    }
+    bool err = false;
+    if (!back_->end_transaction(commit)) {
+      copy_error(back_);
+      err = true;
+    }
+    if (!commit && !clear_front()) err = true;
+    tran_ = false;
+    trigger_meta(commit ? MetaTrigger::COMMITTRAN : MetaTrigger::ABORTTRAN, "end_transaction");
+    return !err;
+  }
+  /**
+   * Remove all records.
+   * @return true on success, or false on failure.
+   */
+  bool clear() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!(omode_ & OWRITER)) {
+      set_error(_KCCODELINE_, Error::NOPERM, "permission denied");
+      return false;
+    }
+    dlock_.lock();
+    dirty_.clear();
+    dlock_.unlock();
+    bool err = false;
+    if (!back_->clear()) {
+      copy_error(back_);
+      err = true;
+    }
+    if (!clear_front()) err = true;
+    trigger_meta(MetaTrigger::CLEAR, "clear");
+    return !err;
+  }
+  /**
+   * Get the number of records.
+   * @return the number of records, or -1 on failure.
+   */
+  int64_t count() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return -1;
+    }
+    if (!flush_dirty(0)) return -1;
+    return count_impl();
+  }
+  /**
+   * Get the size of the database file.
+   * @return the size of the database file in bytes, or -1 on failure.
+   */
+  int64_t size() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return -1;
+    }
+    if (!flush_dirty(0)) return -1;
+    return size_impl();
+  }
+  /**
+   * Get the path of the database file.
+   * @return the path of the database file, or an empty string on failure.
+   */
+  std::string path() {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return "";
+    }
+    return path_;
+  }
+  /**
+   * Get the miscellaneous status information.
+   * @param strmap a string map to contain the result.
+   * @return true on success, or false on failure.
+   * @note The status of the back tier is reported together with the hit and miss counts of
+   * each tier.
+   */
+  bool status(std::map<std::string, std::string>* strmap) {
+    _assert_(strmap);
+    ScopedRWLock lock(&mlock_, false);
+    if (omode_ == 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "not opened");
+      return false;
+    }
+    if (!back_->status(strmap)) {
+      copy_error(back_);
+      return false;
+    }
+    (*strmap)["path"] = path_;
+    const char* mstr = "write-through";
+    switch (mode_) {
+      case MREADTHROUGH: mstr = "read-through"; break;
+      case MWRITETHROUGH: mstr = "write-through"; break;
+      case MWRITEBACK: mstr = "write-back"; break;
+    }
+    (*strmap)["tier_mode"] = mstr;
+    (*strmap)["front_count"] = strprintf("%lld", (long long)front_->count());
+    (*strmap)["front_size"] = strprintf("%lld", (long long)front_->size());
+    (*strmap)["front_hit"] = strprintf("%lld", (long long)fhitcnt_.get());
+    (*strmap)["front_miss"] = strprintf("%lld", (long long)fmisscnt_.get());
+    (*strmap)["back_hit"] = strprintf("%lld", (long long)bhitcnt_.get());
+    (*strmap)["back_miss"] = strprintf("%lld", (long long)bmisscnt_.get());
+    (*strmap)["negative_hit"] = strprintf("%lld", (long long)nhitcnt_.get());
+    (*strmap)["flushed"] = strprintf("%lld", (long long)flushcnt_.get());
+    dlock_.lock();
+    (*strmap)["dirty"] = strprintf("%lld", (long long)dirty_.size());
+    dlock_.unlock();
+    nlock_.lock();
+    (*strmap)["negative"] = strprintf("%lld", (long long)neg_.count());
+    nlock_.unlock();
+    return true;
+  }
+  /**
+   * Create a cursor object.
+   * @return the return value is the created cursor object.
+   * @note Because the object of the return value is allocated by the constructor, it should be
+   * released with the delete operator when it is no longer in use.
+   */
+  Cursor* cursor() {
+    _assert_(true);
+    return new Cursor(this);
+  }
+  /**
+   * Write a log message.
+   * @param file the file name of the program source code.
+   * @param line the line number of the program source code.
+   * @param func the function name of the program source code.
+   * @param kind the kind of the event.  Logger::DEBUG for debugging, Logger::INFO for normal
+   * information, Logger::WARN for warning, and Logger::ERROR for fatal error.
+   * @param message the supplement message.
+   */
+  void log(const char* file, int32_t line, const char* func, Logger::Kind kind,
+           const char* message) {
+    _assert_(file && line > 0 && func && message);
+    ScopedRWLock lock(&mlock_, false);
+    if (!logger_) return;
+    logger_->log(file, line, func, kind, message);
+  }
+  /**
+   * Set the internal logger.
+   * @param logger the logger object.
+   * @param kinds kinds of logged messages by bitwise-or: Logger::DEBUG for debugging,
+   * Logger::INFO for normal information, Logger::WARN for warning, and Logger::ERROR for fatal
+   * error.
+   * @return true on success, or false on failure.
+   */
+  bool tune_logger(Logger* logger, uint32_t kinds = Logger::WARN | Logger::ERROR) {
+    _assert_(logger);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    logger_ = logger;
+    logkinds_ = kinds;
+    return true;
+  }
+  /**
+   * Set the internal meta operation trigger.
+   * @param trigger the trigger object.
+   * @return true on success, or false on failure.
+   */
+  bool tune_meta_trigger(MetaTrigger* trigger) {
+    _assert_(trigger);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    mtrigger_ = trigger;
+    return true;
+  }
+  /**
+   * Set the tiering mode.
+   * @param mode the tiering mode.  TierDB::MREADTHROUGH to write updates to the back tier and
+   * remove them from the front tier, TierDB::MWRITETHROUGH to write updates to both tiers, and
+   * TierDB::MWRITEBACK to write updates to the front tier and to the back tier in background.
+   * By default, the write-through mode is used.
+   * @return true on success, or false on failure.
+   * @note In the write-back mode, the background thread keeps flushing while dirty records
+   * accumulate, and writers flush them by themselves while more than about 65000 records are
+   * dirty.
+   */
+  bool tune_mode(Mode mode) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    mode_ = mode;
+    return true;
+  }
+  /**
+   * Set the capacity of the negative cache.
+   * @param num the maximum number of absent keys to be remembered.  If it is not more than 0,
+   * the negative cache is disabled.  The default number is about 65000.
+   * @return true on success, or false on failure.
+   */
+  bool tune_negative(int64_t num) {
+    _assert_(true);
+    ScopedRWLock lock(&mlock_, true);
+    if (omode_ != 0) {
+      set_error(_KCCODELINE_, Error::INVALID, "already opened");
+      return false;
+    }
+    negcap_ = num > 0 ? num : 0;
+    return true;
+  }
+ protected:
+  /**
+   * Report a message for debugging.
+   * @param file the file name of the program source code.
+   * @param line the line number of the program source code.
+   * @param func the function name of the program source code.
+   * @param kind the kind of the event.  Logger::DEBUG for debugging, Logger::INFO for normal
+   * information, Logger::WARN for warning, and Logger::ERROR for fatal error.
+   * @param format the printf-like format string.
+   * @param ... used according to the format string.
+   */
+  void report(const char* file, int32_t line, const char* func, Logger::Kind kind,
+              const char* format, ...) {
+    _assert_(file && line > 0 && func && format);
+    if (!logger_ || !(kind & logkinds_)) return;
+    std::string message;
+    strprintf(&message, "%s: ", path_.empty() ? "-" : path_.c_str());
+    va_list ap;
+    va_start(ap, format);
+    vstrprintf(&message, format, ap);
+    va_end(ap);
+    logger_->log(file, line, func, kind, message.c_str());
+  }
+  /**
+   * Trigger a meta database operation.
+   * @param kind the kind of the event.  MetaTrigger::OPEN for opening, MetaTrigger::CLOSE for
+   * closing, MetaTrigger::CLEAR for clearing, MetaTrigger::ITERATE for iteration,
+   * MetaTrigger::SYNCHRONIZE for synchronization, MetaTrigger::BEGINTRAN for beginning
+   * transaction, MetaTrigger::COMMITTRAN for committing transaction, MetaTrigger::ABORTTRAN
+   * for aborting transaction, and MetaTrigger::MISC for miscellaneous operations.
+   * @param message the supplement message.
+   */
+  void trigger_meta(MetaTrigger::Kind kind, const char* message) {
+    _assert_(message);
+    if (mtrigger_) mtrigger_->trigger(kind, message);
+  }
+ private:
+  /**
+   * Pending change of a record.
+   */
+  struct Change {
+    std::string value;                   ///< new value
+    bool removed;                        ///< whether to be removed
+    uint64_t seq;                        ///< sequence number
+  };
+  /**
+   * Visitor to write pending changes.
+   */
+  class ReplayVisitor : public Visitor {
+   public:
+    /** constructor */
+    explicit ReplayVisitor(const ChangeMap* changes) : changes_(changes) {}
+   private:
+    const char* visit_full(const char* kbuf, size_t ksiz,
+                           const char* vbuf, size_t vsiz, size_t* sp) {
+      return replay(kbuf, ksiz, sp);
+    }
+    const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
+      return replay(kbuf, ksiz, sp);
+    }
+    const char* replay(const char* kbuf, size_t ksiz, size_t* sp) {
+      ChangeMap::const_iterator it = changes_->find(std::string(kbuf, ksiz));
+      if (it == changes_->end()) return NOP;
+      if (it->second.removed) return REMOVE;
+      *sp = it->second.value.size();
+      return it->second.value.data();
+    }
+    const ChangeMap* changes_;           ///< pending changes
+  };
+  /**
+   * Background thread to flush dirty records.
+   */
+  class FlushThread : public Thread {
+   public:
+    /** constructor */
+    explicit FlushThread(TierDB* db) : db_(db) {}
+    /** perform the concrete process */
+    void run() {
+      bool busy = false;
+      while (true) {
+        db_->wlock_.lock();
+        if (!db_->fstop_ && !busy) db_->wcond_.wait(&db_->wlock_, FLUSHWAIT / 1000.0);
+        bool stop = db_->fstop_;
+        db_->wlock_.unlock();
+        if (stop) break;
+        ScopedRWLock lock(&db_->mlock_, false);
+        if (db_->flush_dirty(FLUSHUNIT)) {
+          db_->dlock_.lock();
+          busy = (int64_t)db_->dirty_.size() >= FLUSHUNIT;
+          db_->dlock_.unlock();
+        } else {
+          const Error& error = db_->error();
+          db_->report(_KCCODELINE_, Logger::WARN, "flushing dirty records failed: %s",
+                      error.message());
+          busy = false;
+        }
+      }
+    }
+   private:
+    TierDB* db_;                         ///< database
+  };
+  /**
+   * Accept a visitor to a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param visitor a visitor object.
+   * @param writable true for writable operation, or false for read-only operation.
+   * @param batch the map to hold the updates for the back tier.  If it is NULL, the updates are
+   * written immediately.
+   * @return true on success, or false on failure.
+   */
+  bool accept_impl(const char* kbuf, size_t ksiz, Visitor* visitor, bool writable,
+                   ChangeMap* batch) {
+    _assert_(kbuf && ksiz <= MEMMAXSIZ && visitor);
+    std::string key(kbuf, ksiz);
+    std::string value;
+    bool hit = false;
+    if (!read_record(key, &value, &hit, batch)) return false;
+    size_t rsiz = 0;
+    const char* rbuf;
+    if (hit) {
+      rbuf = visitor->visit_full(kbuf, ksiz, value.data(), value.size(), &rsiz);
+    } else {
+      rbuf = visitor->visit_empty(kbuf, ksiz, &rsiz);
+    }
+    if (!writable || rbuf == Visitor::NOP) return true;
+    if (rbuf == Visitor::REMOVE) {
+      if (!hit) return true;
+      return write_record(key, NULL, 0, batch);
+    }
+    return write_record(key, rbuf, rsiz, batch);
+  }
+  /**
+   * Read the value of a record from the tiers.
+   * @param key the key.
+   * @param value the string to contain the value.
+   * @param hit the pointer to the variable into which whether the record exists is assigned.
+   * @param batch the map of the updates not written yet, or NULL.
+   * @return true on success, or false on failure.
+   */
+  bool read_record(const std::string& key, std::string* value, bool* hit,
+                   const ChangeMap* batch) {
+    _assert_(value && hit);
+    if (batch) {
+      ChangeMap::const_iterator it = batch->find(key);
+      if (it != batch->end()) {
+        *hit = !it->second.removed;
+        if (*hit) *value = it->second.value;
+        return true;
+      }
+    }
+    if (mode_ == MWRITEBACK) {
+      ScopedMutex lock(&dlock_);
+      ChangeMap::iterator it = dirty_.find(key);
+      if (it != dirty_.end()) {
+        *hit = !it->second.removed;
+        if (*hit) *value = it->second.value;
+        fhitcnt_.add(1);
+        return true;
+      }
+    }
+    if (front_->get(key, value)) {
+      fhitcnt_.add(1);
+      *hit = true;
+      return true;
+    }
+    if (front_->error() != Error::NOREC) {
+      copy_error(front_);
+      return false;
+    }
+    fmisscnt_.add(1);
+    if (negcap_ > 0) {
+      ScopedMutex lock(&nlock_);
+      if (neg_.get(key, NegativeMap::MCURRENT)) {
+        nhitcnt_.add(1);
+        *hit = false;
+        return true;
+      }
+    }
+    if (back_->get(key, value)) {
+      bhitcnt_.add(1);
+      *hit = true;
+      if (!front_->set(key, *value)) {
+        copy_error(front_);
+        return false;
+      }
+      return true;
+    }
+    if (back_->error() != Error::NOREC) {
+      copy_error(back_);
+      return false;
+    }
+    bmisscnt_.add(1);
+    *hit = false;
+    add_negative(key);
+    return true;
+  }
+  /**
+   * Write the new value of a record to the tiers.
+   * @param key the key.
+   * @param vbuf the pointer to the value region.  If it is NULL, the record is removed.
+   * @param vsiz the size of the value region.
+   * @param batch the map to hold the updates for the back tier, or NULL.
+   * @return true on success, or false on failure.
+   */
+  bool write_record(const std::string& key, const char* vbuf, size_t vsiz, ChangeMap* batch) {
+    _assert_(vsiz <= MEMMAXSIZ);
+    if (mode_ == MWRITEBACK && !tran_) {
+      dlock_.lock();
+      Change& change = dirty_[key];
+      change.removed = !vbuf;
+      if (vbuf) {
+        change.value.assign(vbuf, vsiz);
+      } else {
+        change.value.clear();
+      }
+      change.seq = ++dseq_;
+      int64_t dnum = dirty_.size();
+      dlock_.unlock();
+      if (dnum >= DIRTYMAX) {
+        if (!flush_dirty(FLUSHUNIT)) return false;
+      } else if (dnum >= FLUSHUNIT) {
+        wlock_.lock();
+        wcond_.signal();
+        wlock_.unlock();
+      }
+      return update_front(key, vbuf, vsiz);
+    }
+    if (batch) {
+      Change& change = (*batch)[key];
+      change.removed = !vbuf;
+      if (vbuf) {
+        change.value.assign(vbuf, vsiz);
+      } else {
+        change.value.clear();
+      }
+      change.seq = 0;
+      return true;
+    }
+    if (vbuf) {
+      if (!back_->set(key.data(), key.size(), vbuf, vsiz)) {
+        copy_error(back_);
+        return false;
+      }
+    } else if (!back_->remove(key.data(), key.size()) && back_->error() != Error::NOREC) {
+      copy_error(back_);
+      return false;
+    }
+    return update_front(key, vbuf, vsiz);
+  }
+  /**
+   * Reflect the new value of a record in the front tier and the negative cache.
+   * @param key the key.
+   * @param vbuf the pointer to the value region.  If it is NULL, the record is removed.
+   * @param vsiz the size of the value region.
+   * @return true on success, or false on failure.
+   */
+  bool update_front(const std::string& key, const char* vbuf, size_t vsiz) {
+    _assert_(vsiz <= MEMMAXSIZ);
+    if (vbuf && mode_ != MREADTHROUGH) {
+      if (!front_->set(key.data(), key.size(), vbuf, vsiz)) {
+        copy_error(front_);
+        return false;
+      }
+    } else if (!front_->remove(key.data(), key.size()) && front_->error() != Error::NOREC) {
+      copy_error(front_);
+      return false;
+    }
+    if (vbuf) {
+      if (negcap_ > 0) {
+        ScopedMutex lock(&nlock_);
+        neg_.remove(key);
+      }
+    } else {
+      add_negative(key);
+    }
+    return true;
+  }
+  /**
+   * Remember an absent key in the negative cache.
+   * @param key the key.
+   */
+  void add_negative(const std::string& key) {
+    _assert_(true);
+    if (negcap_ < 1) return;
+    ScopedMutex lock(&nlock_);
+    neg_.set(key, true, NegativeMap::MLAST);
+    while ((int64_t)neg_.count() > negcap_) {
+      std::string fkey = neg_.first_key();
+      neg_.remove(fkey);
+    }
+  }
+  /**
+   * Remove all records of the front tier and the negative cache.
+   * @return true on success, or false on failure.
+   */
+  bool clear_front() {
+    _assert_(true);
+    nlock_.lock();
+    neg_.clear();
+    nlock_.unlock();
+    if (!front_->clear()) {
+      copy_error(front_);
+      return false;
+    }
+    return true;
+  }
+  /**
+   * Write pending changes to the back tier at once.
+   * @param changes the pending changes.
+   * @return true on success, or false on failure.
+   */
+  bool apply_changes(const ChangeMap& changes) {
+    _assert_(true);
+    std::vector<std::string> keys;
+    keys.reserve(changes.size());
+    ChangeMap::const_iterator it = changes.begin();
+    ChangeMap::const_iterator itend = changes.end();
+    while (it != itend) {
+      keys.push_back(it->first);
+      ++it;
+    }
+    ReplayVisitor visitor(&changes);
+    if (!back_->accept_bulk(keys, &visitor, true)) {
+      copy_error(back_);
+      return false;
+    }
+    return true;
+  }
+  /**
+   * Write dirty records to the back tier.
+   * @param max the maximum number of records to be written.  If it is not more than 0, all
+   * dirty records are written.
+   * @return true on success, or false on failure.
+   * @note A record updated again while being written is kept dirty.
+   */
+  bool flush_dirty(int64_t max) {
+    _assert_(true);
+    if (mode_ != MWRITEBACK) return true;
+    ScopedMutex lock(&flock_);
+    ChangeMap changes;
+    dlock_.lock();
+    ChangeMap::iterator it = dirty_.begin();
+    ChangeMap::iterator itend = dirty_.end();
+    while (it != itend && (max < 1 || (int64_t)changes.size() < max)) {
+      changes.insert(*it);
+      ++it;
+    }
+    dlock_.unlock();
+    if (changes.empty()) return true;
+    if (!apply_changes(changes)) return false;
+    dlock_.lock();
+    it = changes.begin();
+    itend = changes.end();
+    while (it != itend) {
+      ChangeMap::iterator dit = dirty_.find(it->first);
+      if (dit != dirty_.end() && dit->second.seq == it->second.seq) dirty_.erase(dit);
+      ++it;
+    }
+    dlock_.unlock();
+    flushcnt_.add(changes.size());
+    return true;
+  }
+  /**
+   * Begin transaction of the back tier.
+   * @param hard true for physical synchronization with the device, or false for logical
+   * synchronization with the file system.
+   * @return true on success, or false on failure.
+   */
+  bool begin_transaction_impl(bool hard) {
+    _assert_(true);
+    if (!flush_dirty(0)) return false;
+    if (!back_->begin_transaction(hard)) {
+      copy_error(back_);
+      return false;
+    }
+    tran_ = true;
+    return true;
+  }
+  /**
+   * Copy the last error of a tier.
+   * @param db the database of the tier.
+   */
+  void copy_error(BasicDB* db) {
+    _assert_(db);
+    const Error& error = db->error();
+    error_->set(error.code(), error.message());
+  }
+  /**
+   * Get the number of records.
+   * @return the number of records, or -1 on failure.
+   */
+  int64_t count_impl() {
+    _assert_(true);
+    return back_ ? back_->count() : -1;
+  }
+  /**
+   * Get the size of the database file.
+   * @return the size of the database file in bytes, or -1 on failure.
+   */
+  int64_t size_impl() {
+    _assert_(true);
+    return back_ ? back_->size() : -1;
+  }
+  /** Dummy constructor to forbid the use. */
+  TierDB(const TierDB&);
+  /** Dummy Operator to forbid the use. */
+  TierDB& operator =(const TierDB&);
+  /** The method lock. */
+  RWLock mlock_;
+  /** The record locks. */
+  SlottedRWLock rlock_;
+  /** The lock of the dirty records. */
+  Mutex dlock_;
+  /** The lock of flushing. */
+  Mutex flock_;
+  /** The lock of the negative cache. */
+  Mutex nlock_;
+  /** The lock to wake up the flusher. */
+  Mutex wlock_;
+  /** The condition variable to wake up the flusher. */
+  CondVar wcond_;
+  /** The last happened error. */
+  TSD<Error> error_;
+  /** The internal logger. */
+  Logger* logger_;
+  /** The kinds of logged messages. */
+  uint32_t logkinds_;
+  /** The internal meta operation trigger. */
+  MetaTrigger* mtrigger_;
+  /** The open mode. */
+  uint32_t omode_;
+  /** The front tier. */
+  BasicDB* front_;
+  /** The path of the front tier. */
+  std::string fpath_;
+  /** The back tier. */
+  BasicDB* back_;
+  /** The path of the back tier. */
+  std::string bpath_;
+  /** The path of the database. */
+  std::string path_;
+  /** The tiering mode. */
+  Mode mode_;
+  /** The capacity of the negative cache. */
+  int64_t negcap_;
+  /** The flag whether in transaction. */
+  bool tran_;
+  /** The dirty records. */
+  ChangeMap dirty_;
+  /** The sequence number of updates. */
+  uint64_t dseq_;
+  /** The negative cache. */
+  NegativeMap neg_;
+  /** The background flusher. */
+  FlushThread* flusher_;
+  /** The flag to stop the flusher. */
+  bool fstop_;
+  /** The number of hits of the front tier. */
+  AtomicInt64 fhitcnt_;
+  /** The number of misses of the front tier. */
+  AtomicInt64 fmisscnt_;
+  /** The number of hits of the back tier. */
+  AtomicInt64 bhitcnt_;
+  /** The number of misses of the back tier. */
+  AtomicInt64 bmisscnt_;
+  /** The number of hits of the negative cache. */
+  AtomicInt64 nhitcnt_;
+  /** The number of flushed records. */
+  AtomicInt64 flushcnt_;
+};
+
+
+}                                        // common namespace
+
+#endif                                   // duplication check
+
+// END OF FILE
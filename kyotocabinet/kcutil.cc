@@ -189,6 +189,52 @@ void mapfree(void* ptr) {
 }
 
 
+/**
+ * Get the number of NUMA nodes of the system.
+ */
+int32_t numanodes() {
+#if defined(_SYS_LINUX_)
+  _assert_(true);
+  ::DIR* dir = ::opendir("/sys/devices/system/node");
+  if (!dir) return 1;
+  int32_t num = 1;
+  struct ::dirent* dp;
+  while ((dp = ::readdir(dir)) != NULL) {
+    const char* name = dp->d_name;
+    if (std::strncmp(name, "node", 4) || !std::isdigit((unsigned char)name[4])) continue;
+    int64_t id = atoi(name + 4);
+    if (id >= num && id < INT8MAX) num = id + 1;
+  }
+  ::closedir(dir);
+  return num;
+#else
+  _assert_(true);
+  return 1;
+#endif
+}
+
+
+/**
+ * Bind a region on memory to a NUMA node.
+ */
+bool numabind(void* ptr, size_t size, int32_t node) {
+#if defined(_SYS_LINUX_) && defined(SYS_mbind)
+  _assert_(ptr && size <= MEMMAXSIZ && node >= 0);
+  const int32_t MPOLPREFERRED = 1;
+  if (node >= (int32_t)(sizeof(unsigned long) * 8)) return false;
+  uintptr_t top = ((uintptr_t)ptr + PAGESIZ - 1) / PAGESIZ * PAGESIZ;
+  uintptr_t bottom = ((uintptr_t)ptr + size) / PAGESIZ * PAGESIZ;
+  if (bottom <= top) return true;
+  unsigned long mask = 1UL << node;
+  return ::syscall(SYS_mbind, (void*)top, (unsigned long)(bottom - top), MPOLPREFERRED,
+                   &mask, (unsigned long)(sizeof(mask) * 8), 0) == 0;
+#else
+  _assert_(ptr && size <= MEMMAXSIZ && node >= 0);
+  return false;
+#endif
+}
+
+
 /**
  * Get the time of day in seconds.
  * @return the time of day in seconds.  The accuracy is in microseconds.
@@ -865,6 +865,25 @@ void* mapalloc(size_t size);
 void mapfree(void* ptr);
 
 
+/**
+ * Get the number of NUMA nodes of the system.
+ * @return the number of NUMA nodes, which is 1 if the system does not support NUMA.
+ */
+int32_t numanodes();
+
+
+/**
+ * Bind a region on memory to a NUMA node.
+ * @param ptr the pointer to the region.
+ * @param size the size of the region.
+ * @param node the index of the node.
+ * @return true on success, or false on failure.
+ * @note Only pages fully contained in the region are bound.  Pages are allocated on the node
+ * preferably, and on the other nodes if the node runs out of memory.
+ */
+bool numabind(void* ptr, size_t size, int32_t node);
+
+
 /**
  * Get the time of day in seconds.
  * @return the time of day in seconds.  The accuracy is in microseconds.
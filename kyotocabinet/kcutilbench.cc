@@ -0,0 +1,735 @@
+/*************************************************************************************************
+ * The microbenchmark of the utility functions
+ *                                                               Copyright (C) 2009-2012 FAL Labs
+ * This file is part of Kyoto Cabinet.
+ * This program is free software: you can redistribute it and/or modify it under the terms of
+ * the GNU General Public License as published by the Free Software Foundation, either version
+ * 3 of the License, or any later version.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *************************************************************************************************/
+
+
+#include "cmdcommon.h"
+#if defined(_SYS_LINUX_)
+#include <sched.h>
+#endif
+
+
+// constants
+const char* const SIZESDEF = "16,256,4096";   // default input sizes
+const char* const THNUMSDEF = "1";            // default thread numbers
+const int32_t REPDEF = 5;                     // default number of repetitions
+const double TOLDEF = 10.0;                   // default tolerance of regression in percent
+const size_t LOCKSLOTNUM = 64;                // number of slots of the slotted lock
+const int64_t MAPKEYNUM = 65536;              // number of distinct keys of maps
+
+
+// global variables
+const char* g_progname;                  // program name
+uint32_t g_randseed;                     // random seed
+int64_t g_memusage;                      // memory usage
+volatile uint64_t g_sink;                // sink of results to keep computations alive
+
+
+// case of the microbenchmark
+class BenchCase {
+ public:
+  explicit BenchCase(const char* name, bool sized) : name_(name), sized_(sized) {}
+  virtual ~BenchCase() {}
+  const char* name() const {
+    return name_;
+  }
+  bool sized() const {
+    return sized_;
+  }
+  virtual bool setup(int64_t size, int32_t thnum) {
+    input_.clear();
+    for (int64_t i = 0; i < size + 8; i++) {
+      input_.push_back(i % 8 == 7 ? ' ' : (char)('a' + myrand(4) + myrand(4)));
+    }
+    return true;
+  }
+  virtual uint64_t run(int32_t id, int64_t rnum, int64_t size) = 0;
+  virtual void finish() {}
+  virtual void teardown() {}
+ protected:
+  std::string input_;
+ private:
+  const char* name_;
+  bool sized_;
+};
+
+
+// case of a hash function
+class HashCase : public BenchCase {
+ public:
+  explicit HashCase(const char* name, bool fnv) : BenchCase(name, true), fnv_(fnv) {}
+  uint64_t run(int32_t id, int64_t rnum, int64_t size) {
+    const char* buf = input_.data();
+    uint64_t sum = 0;
+    for (int64_t i = 0; i < rnum; i++) {
+      const char* rp = buf + (i & 7);
+      sum += fnv_ ? kc::hashfnv(rp, size) : kc::hashmurmur(rp, size);
+    }
+    return sum;
+  }
+ private:
+  bool fnv_;
+};
+
+
+// case of variable length numbers
+class VarnumCase : public BenchCase {
+ public:
+  explicit VarnumCase() : BenchCase("varnum", false) {}
+  uint64_t run(int32_t id, int64_t rnum, int64_t size) {
+    char buf[kc::NUMBUFSIZ];
+    uint64_t sum = 0;
+    for (int64_t i = 0; i < rnum; i++) {
+      uint64_t num = ((uint64_t)i * 0x9e3779b97f4a7c15ULL) >> (i & 63);
+      size_t step = kc::writevarnum(buf, num);
+      uint64_t onum;
+      kc::readvarnum(buf, step, &onum);
+      sum += onum;
+    }
+    return sum;
+  }
+};
+
+
+// case of a string encoding
+class EncodeCase : public BenchCase {
+ public:
+  explicit EncodeCase(const char* name, int32_t kind) : BenchCase(name, true), kind_(kind) {}
+  uint64_t run(int32_t id, int64_t rnum, int64_t size) {
+    const char* buf = input_.data();
+    uint64_t sum = 0;
+    for (int64_t i = 0; i < rnum; i++) {
+      const char* rp = buf + (i & 7);
+      char* ebuf;
+      size_t dsiz;
+      char* dbuf;
+      switch (kind_) {
+        case 'u': {
+          ebuf = kc::urlencode(rp, size);
+          dbuf = kc::urldecode(ebuf, &dsiz);
+          break;
+        }
+        case 'q': {
+          ebuf = kc::quoteencode(rp, size);
+          dbuf = kc::quotedecode(ebuf, &dsiz);
+          break;
+        }
+        default: {
+          ebuf = kc::baseencode(rp, size);
+          dbuf = kc::basedecode(ebuf, &dsiz);
+          break;
+        }
+      }
+      sum += dsiz + (unsigned char)*ebuf;
+      delete[] dbuf;
+      delete[] ebuf;
+    }
+    return sum;
+  }
+ private:
+  int32_t kind_;
+};
+
+
+// case of a compressor
+class CompressCase : public BenchCase {
+ public:
+  explicit CompressCase(const char* name, kc::Compressor* comp, const char* feature) :
+      BenchCase(name, true), comp_(comp), feature_(feature) {}
+  bool setup(int64_t size, int32_t thnum) {
+    if (feature_ && !std::strstr(kc::FEATURES, feature_)) return false;
+    BenchCase::setup(size, thnum);
+    size_t zsiz;
+    char* zbuf = comp_->compress(input_.data(), size, &zsiz);
+    if (!zbuf) return false;
+    delete[] zbuf;
+    return true;
+  }
+  uint64_t run(int32_t id, int64_t rnum, int64_t size) {
+    const char* buf = input_.data();
+    uint64_t sum = 0;
+    for (int64_t i = 0; i < rnum; i++) {
+      size_t zsiz;
+      char* zbuf = comp_->compress(buf + (i & 7), size, &zsiz);
+      if (!zbuf) break;
+      size_t dsiz;
+      char* dbuf = comp_->decompress(zbuf, zsiz, &dsiz);
+      if (dbuf) {
+        sum += zsiz + dsiz;
+        delete[] dbuf;
+      }
+      delete[] zbuf;
+    }
+    return sum;
+  }
+ private:
+  kc::Compressor* comp_;
+  const char* feature_;
+};
+
+
+// case of the spin reader-writer lock
+class SpinRWLockCase : public BenchCase {
+ public:
+  explicit SpinRWLockCase() : BenchCase("spinrwlock", false), lock_(), value_(0) {}
+  uint64_t run(int32_t id, int64_t rnum, int64_t size) {
+    uint64_t sum = 0;
+    for (int64_t i = 0; i < rnum; i++) {
+      if (i % 16 == 0) {
+        lock_.lock_writer();
+        value_++;
+      } else {
+        lock_.lock_reader();
+        sum += value_;
+      }
+      lock_.unlock();
+    }
+    return sum;
+  }
+ private:
+  kc::SpinRWLock lock_;
+  uint64_t value_;
+};
+
+
+// case of the slotted reader-writer lock
+class SlottedRWLockCase : public BenchCase {
+ public:
+  explicit SlottedRWLockCase() :
+      BenchCase("slottedrwlock", false), lock_(LOCKSLOTNUM), values_() {
+    std::memset(values_, 0, sizeof(values_));
+  }
+  uint64_t run(int32_t id, int64_t rnum, int64_t size) {
+    uint64_t sum = 0;
+    for (int64_t i = 0; i < rnum; i++) {
+      size_t idx = (size_t)(((uint64_t)(i + id * rnum) * 0x9e3779b97f4a7c15ULL) >> 32) %
+          LOCKSLOTNUM;
+      if (i % 16 == 0) {
+        lock_.lock_writer(idx);
+        values_[idx]++;
+      } else {
+        lock_.lock_reader(idx);
+        sum += values_[idx];
+      }
+      lock_.unlock(idx);
+    }
+    return sum;
+  }
+ private:
+  kc::SlottedRWLock lock_;
+  uint64_t values_[LOCKSLOTNUM];
+};
+
+
+// case of the task queue
+class TaskQueueCase : public BenchCase {
+ public:
+  explicit TaskQueueCase() : BenchCase("taskqueue", false), queue_(NULL) {}
+  bool setup(int64_t size, int32_t thnum) {
+    queue_ = new Queue;
+    queue_->start(thnum);
+    return true;
+  }
+  uint64_t run(int32_t id, int64_t rnum, int64_t size) {
+    for (int64_t i = 0; i < rnum; i++) {
+      queue_->add_task(new kc::TaskQueue::Task);
+    }
+    return rnum;
+  }
+  void finish() {
+    queue_->finish();
+  }
+  void teardown() {
+    g_sink += queue_->done.get();
+    delete queue_;
+    queue_ = NULL;
+  }
+ private:
+  class Queue : public kc::TaskQueue {
+   public:
+    void do_task(Task* task) {
+      done += 1;
+      delete task;
+    }
+    kc::AtomicInt64 done;
+  };
+  Queue* queue_;
+};
+
+
+// case of the linked hash map
+class LinkedHashMapCase : public BenchCase {
+ public:
+  explicit LinkedHashMapCase() : BenchCase("lhmap", false) {}
+  uint64_t run(int32_t id, int64_t rnum, int64_t size) {
+    typedef kc::LinkedHashMap<int64_t, int64_t> Map;
+    Map map(MAPKEYNUM);
+    uint64_t sum = 0;
+    for (int64_t i = 0; i < rnum; i++) {
+      int64_t key = (int64_t)(((uint64_t)i * 0x9e3779b97f4a7c15ULL) >> 32) % MAPKEYNUM;
+      switch (i % 4) {
+        case 0: {
+          map.set(key, i, Map::MLAST);
+          break;
+        }
+        case 3: {
+          map.remove(key);
+          break;
+        }
+        default: {
+          int64_t* vp = map.get(key, Map::MCURRENT);
+          if (vp) sum += *vp;
+          break;
+        }
+      }
+    }
+    return sum + map.count();
+  }
+};
+
+
+// case of the tiny hash map
+class TinyHashMapCase : public BenchCase {
+ public:
+  explicit TinyHashMapCase() : BenchCase("tinymap", false) {}
+  uint64_t run(int32_t id, int64_t rnum, int64_t size) {
+    kc::TinyHashMap map(MAPKEYNUM);
+    uint64_t sum = 0;
+    for (int64_t i = 0; i < rnum; i++) {
+      char kbuf[RECBUFSIZ];
+      size_t ksiz = std::sprintf(kbuf, "%08lld", (long long)(i % MAPKEYNUM));
+      if (i % 4 == 0) {
+        map.set(kbuf, ksiz, kbuf, ksiz);
+      } else {
+        size_t vsiz;
+        if (map.get(kbuf, ksiz, &vsiz)) sum += vsiz;
+      }
+    }
+    return sum + map.count();
+  }
+};
+
+
+// worker thread of the microbenchmark
+class BenchWorker : public kc::Thread {
+ public:
+  explicit BenchWorker() :
+      bcase_(NULL), id_(0), rnum_(0), size_(0), cpu_(-1), stime_(0), etime_(0) {}
+  void setparams(BenchCase* bcase, int32_t id, int64_t rnum, int64_t size, int32_t cpu) {
+    bcase_ = bcase;
+    id_ = id;
+    rnum_ = rnum;
+    size_ = size;
+    cpu_ = cpu;
+  }
+  void run() {
+#if defined(_SYS_LINUX_)
+    if (cpu_ >= 0) {
+      ::cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(cpu_, &cpus);
+      ::pthread_setaffinity_np(::pthread_self(), sizeof(cpus), &cpus);
+    }
+#endif
+    stime_ = kc::time();
+    g_sink += bcase_->run(id_, rnum_, size_);
+    etime_ = kc::time();
+  }
+  double start_time() {
+    return stime_;
+  }
+  double end_time() {
+    return etime_;
+  }
+ private:
+  BenchCase* bcase_;
+  int32_t id_;
+  int64_t rnum_;
+  int64_t size_;
+  int32_t cpu_;
+  double stime_;
+  double etime_;
+};
+
+
+// function prototypes
+int main(int argc, char** argv);
+static void usage();
+static int32_t cpunum();
+static void makecases(std::vector<BenchCase*>* cases);
+static bool parsenums(const char* str, std::vector<int64_t>* nums);
+static std::string resultkey(const char* name, int64_t size, int32_t thnum);
+static bool loadbase(const char* path, std::map<std::string, double>* base);
+static int32_t runlist(int argc, char** argv);
+static int32_t runrun(int argc, char** argv);
+static int32_t proclist();
+static int32_t procrun(int64_t rnum, const std::vector<std::string>& names,
+                       const std::vector<int64_t>& sizes, const std::vector<int64_t>& thnums,
+                       int32_t rep, int32_t wu, bool pin, const char* save, const char* base,
+                       double tol, bool json);
+
+
+// main routine
+int main(int argc, char** argv) {
+  g_progname = argv[0];
+  const char* ebuf = kc::getenv("KCRNDSEED");
+  g_randseed = ebuf ? (uint32_t)kc::atoi(ebuf) : (uint32_t)(kc::time() * 1000);
+  mysrand(g_randseed);
+  g_memusage = memusage();
+  kc::setstdiobin();
+  if (argc < 2) usage();
+  int32_t rv = 0;
+  if (!std::strcmp(argv[1], "list")) {
+    rv = runlist(argc, argv);
+  } else if (!std::strcmp(argv[1], "run")) {
+    rv = runrun(argc, argv);
+  } else {
+    usage();
+  }
+  return rv;
+}
+
+
+// print the usage and exit
+static void usage() {
+  eprintf("%s: microbenchmark of the utility functions of Kyoto Cabinet\n", g_progname);
+  eprintf("\n");
+  eprintf("usage:\n");
+  eprintf("  %s list\n", g_progname);
+  eprintf("  %s run [-siz str] [-th str] [-rep num] [-wu num] [-pin] [-save path]"
+          " [-base path] [-tol num] [-json] rnum [name...]\n", g_progname);
+  eprintf("\n");
+  std::exit(1);
+}
+
+
+// get the number of online processors
+static int32_t cpunum() {
+#if defined(_SYS_LINUX_)
+  long num = ::sysconf(_SC_NPROCESSORS_ONLN);
+  return num > 0 ? (int32_t)num : 1;
+#else
+  return 1;
+#endif
+}
+
+
+// make all benchmark cases
+static void makecases(std::vector<BenchCase*>* cases) {
+  static kc::ZLIBCompressor<kc::ZLIB::DEFLATE> zlibdef;
+  static kc::ZLIBCompressor<kc::ZLIB::GZIP> zlibgz;
+  static kc::LZOCompressor<kc::LZO::RAW> lzoraw;
+  static kc::LZMACompressor<kc::LZMA::RAW> lzmaraw;
+  static kc::ArcfourCompressor arccomp;
+  arccomp.set_key("microbench", 10);
+  static kc::AESCompressor aescomp;
+  aescomp.set_key("microbench", 10);
+  cases->push_back(new HashCase("hashmurmur", false));
+  cases->push_back(new HashCase("hashfnv", true));
+  cases->push_back(new VarnumCase);
+  cases->push_back(new EncodeCase("baseencode", 'b'));
+  cases->push_back(new EncodeCase("urlencode", 'u'));
+  cases->push_back(new EncodeCase("quoteencode", 'q'));
+  cases->push_back(new SpinRWLockCase);
+  cases->push_back(new SlottedRWLockCase);
+  cases->push_back(new TaskQueueCase);
+  cases->push_back(new CompressCase("zlibraw", kc::ZLIBRAWCOMP, "(zlib)"));
+  cases->push_back(new CompressCase("zlibdef", &zlibdef, "(zlib)"));
+  cases->push_back(new CompressCase("zlibgz", &zlibgz, "(zlib)"));
+  cases->push_back(new CompressCase("lzo", &lzoraw, "(lzo)"));
+  cases->push_back(new CompressCase("lzma", &lzmaraw, "(lzma)"));
+  cases->push_back(new CompressCase("arcfour", &arccomp, NULL));
+  cases->push_back(new CompressCase("aes", &aescomp, NULL));
+  cases->push_back(new LinkedHashMapCase);
+  cases->push_back(new TinyHashMapCase);
+}
+
+
+// parse a comma separated list of numbers
+static bool parsenums(const char* str, std::vector<int64_t>* nums) {
+  nums->clear();
+  std::vector<std::string> elems;
+  kc::strsplit(str, ',', &elems);
+  for (size_t i = 0; i < elems.size(); i++) {
+    int64_t num = kc::atoix(elems[i].c_str());
+    if (num < 1) return false;
+    nums->push_back(num);
+  }
+  return !nums->empty();
+}
+
+
+// make the key of a result
+static std::string resultkey(const char* name, int64_t size, int32_t thnum) {
+  return kc::strprintf("%s\t%lld\t%d", name, (long long)size, thnum);
+}
+
+
+// load the results of a baseline
+static bool loadbase(const char* path, std::map<std::string, double>* base) {
+  std::ifstream ifs;
+  ifs.open(path, std::ios_base::in | std::ios_base::binary);
+  if (!ifs) return false;
+  std::string line;
+  while (mygetline(&ifs, &line)) {
+    std::vector<std::string> elems;
+    if (kc::strsplit(line, '\t', &elems) < 4) continue;
+    (*base)[resultkey(elems[0].c_str(), kc::atoi(elems[1].c_str()),
+                      kc::atoi(elems[2].c_str()))] = kc::atof(elems[3].c_str());
+  }
+  return true;
+}
+
+
+// parse arguments of list command
+static int32_t runlist(int argc, char** argv) {
+  if (argc != 2) usage();
+  int32_t rv = proclist();
+  return rv;
+}
+
+
+// parse arguments of run command
+static int32_t runrun(int argc, char** argv) {
+  bool argbrk = false;
+  const char* rstr = NULL;
+  std::vector<std::string> names;
+  const char* sstr = SIZESDEF;
+  const char* tstr = THNUMSDEF;
+  int32_t rep = REPDEF;
+  int32_t wu = 1;
+  bool pin = false;
+  const char* save = NULL;
+  const char* base = NULL;
+  double tol = TOLDEF;
+  bool json = false;
+  for (int32_t i = 2; i < argc; i++) {
+    if (!argbrk && argv[i][0] == '-') {
+      if (!std::strcmp(argv[i], "--")) {
+        argbrk = true;
+      } else if (!std::strcmp(argv[i], "-siz")) {
+        if (++i >= argc) usage();
+        sstr = argv[i];
+      } else if (!std::strcmp(argv[i], "-th")) {
+        if (++i >= argc) usage();
+        tstr = argv[i];
+      } else if (!std::strcmp(argv[i], "-rep")) {
+        if (++i >= argc) usage();
+        rep = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-wu")) {
+        if (++i >= argc) usage();
+        wu = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-pin")) {
+        pin = true;
+      } else if (!std::strcmp(argv[i], "-save")) {
+        if (++i >= argc) usage();
+        save = argv[i];
+      } else if (!std::strcmp(argv[i], "-base")) {
+        if (++i >= argc) usage();
+        base = argv[i];
+      } else if (!std::strcmp(argv[i], "-tol")) {
+        if (++i >= argc) usage();
+        tol = kc::atof(argv[i]);
+      } else if (!std::strcmp(argv[i], "-json")) {
+        json = true;
+      } else {
+        usage();
+      }
+    } else if (!rstr) {
+      argbrk = true;
+      rstr = argv[i];
+    } else {
+      names.push_back(argv[i]);
+    }
+  }
+  if (!rstr) usage();
+  int64_t rnum = kc::atoix(rstr);
+  std::vector<int64_t> sizes, thnums;
+  if (rnum < 1 || rep < 1 || wu < 0 || tol < 0 ||
+      !parsenums(sstr, &sizes) || !parsenums(tstr, &thnums)) usage();
+  for (size_t i = 0; i < thnums.size(); i++) {
+    if (thnums[i] > THREADMAX) thnums[i] = THREADMAX;
+  }
+  int32_t rv = procrun(rnum, names, sizes, thnums, rep, wu, pin, save, base, tol, json);
+  return rv;
+}
+
+
+// perform list command
+static int32_t proclist() {
+  std::vector<BenchCase*> cases;
+  makecases(&cases);
+  for (size_t i = 0; i < cases.size(); i++) {
+    oprintf("%s\t%s\n", cases[i]->name(), cases[i]->sized() ? "sized" : "-");
+    delete cases[i];
+  }
+  return 0;
+}
+
+
+// perform run command
+static int32_t procrun(int64_t rnum, const std::vector<std::string>& names,
+                       const std::vector<int64_t>& sizes, const std::vector<int64_t>& thnums,
+                       int32_t rep, int32_t wu, bool pin, const char* save, const char* base,
+                       double tol, bool json) {
+  if (!json) {
+    oprintf("<Microbenchmark>\n  seed=%u  rnum=%lld  rep=%d  wu=%d  pin=%d  cpus=%d"
+            "  tol=%.1f\n\n", g_randseed, (long long)rnum, rep, wu, pin, cpunum(), tol);
+  }
+  bool err = false;
+  std::map<std::string, double> bmap;
+  if (base && !loadbase(base, &bmap)) {
+    eprintf("%s: %s: could not open the baseline\n", g_progname, base);
+    return 1;
+  }
+  std::vector<BenchCase*> cases;
+  makecases(&cases);
+  std::string results;
+  std::string jstr;
+  int32_t ncpu = cpunum();
+  int32_t regnum = 0;
+  for (size_t i = 0; i < names.size(); i++) {
+    bool hit = false;
+    for (size_t j = 0; j < cases.size(); j++) {
+      if (names[i] == cases[j]->name()) hit = true;
+    }
+    if (!hit) {
+      eprintf("%s: %s: unknown case\n", g_progname, names[i].c_str());
+      err = true;
+    }
+  }
+  for (size_t i = 0; !err && i < cases.size(); i++) {
+    BenchCase* bcase = cases[i];
+    bool hit = names.empty();
+    for (size_t j = 0; !hit && j < names.size(); j++) {
+      if (names[j] == bcase->name()) hit = true;
+    }
+    if (!hit) continue;
+    std::vector<int64_t> csizes;
+    if (bcase->sized()) {
+      csizes = sizes;
+    } else {
+      csizes.push_back(0);
+    }
+    for (size_t j = 0; j < csizes.size(); j++) {
+      int64_t size = csizes[j];
+      for (size_t k = 0; k < thnums.size(); k++) {
+        int32_t thnum = thnums[k];
+        std::vector<double> rates;
+        bool ok = true;
+        for (int32_t r = 0; ok && r < wu + rep; r++) {
+          if (!bcase->setup(size, thnum)) {
+            ok = false;
+            break;
+          }
+          BenchWorker* workers = new BenchWorker[thnum];
+          for (int32_t t = 0; t < thnum; t++) {
+            workers[t].setparams(bcase, t, rnum, size, pin ? t % ncpu : -1);
+          }
+          double stime = kc::time();
+          if (thnum < 2) {
+            workers[0].run();
+          } else {
+            for (int32_t t = 0; t < thnum; t++) {
+              workers[t].start();
+            }
+            for (int32_t t = 0; t < thnum; t++) {
+              workers[t].join();
+            }
+          }
+          bcase->finish();
+          double etime = kc::time();
+          if (thnum > 1) {
+            stime = workers[0].start_time();
+            for (int32_t t = 1; t < thnum; t++) {
+              if (workers[t].start_time() < stime) stime = workers[t].start_time();
+            }
+          }
+          delete[] workers;
+          bcase->teardown();
+          double elapsed = etime - stime;
+          if (elapsed < 1e-9) elapsed = 1e-9;
+          if (r >= wu) rates.push_back(rnum * thnum / elapsed);
+        }
+        if (!ok) {
+          if (!json) oprintf("%s: size=%lld  thnum=%d  unsupported\n",
+                             bcase->name(), (long long)size, thnum);
+          continue;
+        }
+        std::sort(rates.begin(), rates.end());
+        size_t cnt = rates.size();
+        double median = cnt % 2 ? rates[cnt / 2] :
+            (rates[cnt / 2 - 1] + rates[cnt / 2]) / 2;
+        double mean = 0;
+        for (size_t r = 0; r < cnt; r++) {
+          mean += rates[r];
+        }
+        mean /= cnt;
+        double var = 0;
+        for (size_t r = 0; r < cnt; r++) {
+          var += (rates[r] - mean) * (rates[r] - mean);
+        }
+        double cv = cnt > 1 ? std::sqrt(var / (cnt - 1)) / mean * 100 : 0.0;
+        double mbps = median * size / (1024.0 * 1024.0);
+        std::string key = resultkey(bcase->name(), size, thnum);
+        kc::strprintf(&results, "%s\t%.3f\n", key.c_str(), median);
+        double bval = -1;
+        std::map<std::string, double>::iterator bit = bmap.find(key);
+        if (bit != bmap.end() && bit->second > 0) bval = bit->second;
+        bool reg = bval > 0 && median < bval * (1 - tol / 100);
+        if (reg) regnum++;
+        if (json) {
+          if (!jstr.empty()) jstr.append(",");
+          kc::strprintf(&jstr, "{\"name\":\"%s\",\"size\":%lld,\"thnum\":%d,\"median\":%.3f,"
+                        "\"mean\":%.3f,\"cv\":%.3f,\"min\":%.3f,\"max\":%.3f,\"mbps\":%.3f",
+                        bcase->name(), (long long)size, thnum, median, mean, cv,
+                        rates.front(), rates.back(), mbps);
+          if (bval > 0) kc::strprintf(&jstr, ",\"base\":%.3f,\"ratio\":%.4f,\"regression\":%s",
+                                      bval, median / bval, reg ? "true" : "false");
+          jstr.append("}");
+        } else {
+          std::string line;
+          kc::strprintf(&line, "%s: size=%lld  thnum=%d  median=%.0f  mean=%.0f  cv=%.2f%%"
+                        "  min=%.0f  max=%.0f", bcase->name(), (long long)size, thnum,
+                        median, mean, cv, rates.front(), rates.back());
+          if (size > 0) kc::strprintf(&line, "  mbps=%.1f", mbps);
+          if (bval > 0) kc::strprintf(&line, "  base=%.0f  ratio=%.3f%s",
+                                      bval, median / bval, reg ? " REGRESSION" : "");
+          oprintf("%s\n", line.c_str());
+        }
+      }
+    }
+  }
+  for (size_t i = 0; i < cases.size(); i++) {
+    delete cases[i];
+  }
+  if (save && !err) {
+    if (!kc::File::write_file(save, results.data(), results.size())) {
+      eprintf("%s: %s: could not write the results\n", g_progname, save);
+      err = true;
+    }
+  }
+  if (json) {
+    oprintf("{\"seed\":%u,\"rnum\":%lld,\"rep\":%d,\"wu\":%d,\"pin\":%s,\"cpus\":%d,"
+            "\"regressions\":%d,\"results\":[%s]}\n", g_randseed, (long long)rnum, rep, wu,
+            pin ? "true" : "false", ncpu, regnum, jstr.c_str());
+  } else {
+    if (base) oprintf("regressions: %d\n", regnum);
+    oprintf("%s\n\n", err ? "error" : regnum > 0 ? "regression" : "ok");
+  }
+  return err || regnum > 0 ? 1 : 0;
+}
+
+
+
+// END OF FILE
@@ -40,14 +40,17 @@ static int32_t runfile(int argc, char** argv);
 static int32_t runlhmap(int argc, char** argv);
 static int32_t runthmap(int argc, char** argv);
 static int32_t runtalist(int argc, char** argv);
+static int32_t runtwheel(int argc, char** argv);
 static int32_t runmisc(int argc, char** argv);
 static int32_t procmutex(int64_t rnum, int32_t thnum, double iv);
 static int32_t proccond(int64_t rnum, int32_t thnum, double iv);
 static int32_t procpara(int64_t rnum, int32_t thnum, double iv);
-static int32_t procfile(const char* path, int64_t rnum, int32_t thnum, bool rnd, int64_t msiz);
+static int32_t procfile(const char* path, int64_t rnum, int32_t thnum, bool rnd, int64_t msiz,
+                        int64_t mcap);
 static int32_t proclhmap(int64_t rnum, bool rnd, int64_t bnum);
 static int32_t procthmap(int64_t rnum, bool rnd, int64_t bnum);
 static int32_t proctalist(int64_t rnum, bool rnd);
+static int32_t proctwheel(int64_t rnum, bool rnd);
 static int32_t procmisc(int64_t rnum);
 
 
@@ -75,6 +78,8 @@ int main(int argc, char** argv) {
     rv = runthmap(argc, argv);
   } else if (!std::strcmp(argv[1], "talist")) {
     rv = runtalist(argc, argv);
+  } else if (!std::strcmp(argv[1], "twheel")) {
+    rv = runtwheel(argc, argv);
   } else if (!std::strcmp(argv[1], "misc")) {
     rv = runmisc(argc, argv);
   } else {
@@ -99,10 +104,11 @@ static void usage() {
   eprintf("  %s mutex [-th num] [-iv num] rnum\n", g_progname);
   eprintf("  %s para [-th num] [-iv num] rnum\n", g_progname);
   eprintf("  %s cond [-th num] [-iv num] rnum\n", g_progname);
-  eprintf("  %s file [-th num] [-rnd] [-msiz num] path rnum\n", g_progname);
+  eprintf("  %s file [-th num] [-rnd] [-msiz num] [-mcap num] path rnum\n", g_progname);
   eprintf("  %s lhmap [-rnd] [-bnum num] rnum\n", g_progname);
   eprintf("  %s thmap [-rnd] [-bnum num] rnum\n", g_progname);
   eprintf("  %s talist [-rnd] rnum\n", g_progname);
+  eprintf("  %s twheel [-rnd] rnum\n", g_progname);
   eprintf("  %s misc rnum\n", g_progname);
   eprintf("\n");
   std::exit(1);
@@ -248,6 +254,7 @@ static int32_t runfile(int argc, char** argv) {
   int32_t thnum = 1;
   bool rnd = false;
   int64_t msiz = 0;
+  int64_t mcap = 0;
   for (int32_t i = 2; i < argc; i++) {
     if (!argbrk && argv[i][0] == '-') {
       if (!std::strcmp(argv[i], "--")) {
@@ -260,6 +267,9 @@ static int32_t runfile(int argc, char** argv) {
       } else if (!std::strcmp(argv[i], "-msiz")) {
         if (++i >= argc) usage();
         msiz = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-mcap")) {
+        if (++i >= argc) usage();
+        mcap = kc::atoix(argv[i]);
       } else {
         usage();
       }
@@ -274,9 +284,9 @@ static int32_t runfile(int argc, char** argv) {
   }
   if (!path || !rstr) usage();
   int64_t rnum = kc::atoix(rstr);
-  if (rnum < 1 || thnum < 1 || msiz < 0) usage();
+  if (rnum < 1 || thnum < 1 || msiz < 0 || mcap < 0) usage();
   if (thnum > THREADMAX) thnum = THREADMAX;
-  int32_t rv = procfile(path, rnum, thnum, rnd, msiz);
+  int32_t rv = procfile(path, rnum, thnum, rnd, msiz, mcap);
   return rv;
 }
 
@@ -376,6 +386,35 @@ static int32_t runtalist(int argc, char** argv) {
 }
 
 
+// parse arguments of twheel command
+static int32_t runtwheel(int argc, char** argv) {
+  bool argbrk = false;
+  const char* rstr = NULL;
+  bool rnd = false;
+  for (int32_t i = 2; i < argc; i++) {
+    if (!argbrk && argv[i][0] == '-') {
+      if (!std::strcmp(argv[i], "--")) {
+        argbrk = true;
+      } else if (!std::strcmp(argv[i], "-rnd")) {
+        rnd = true;
+      } else {
+        usage();
+      }
+    } else if (!rstr) {
+      argbrk = true;
+      rstr = argv[i];
+    } else {
+      usage();
+    }
+  }
+  if (!rstr) usage();
+  int64_t rnum = kc::atoix(rstr);
+  if (rnum < 1) usage();
+  int32_t rv = proctwheel(rnum, rnd);
+  return rv;
+}
+
+
 // parse arguments of misc command
 static int32_t runmisc(int argc, char** argv) {
   bool argbrk = false;
@@ -702,6 +741,105 @@ static int32_t procmutex(int64_t rnum, int32_t thnum, double iv) {
   }
   etime = kc::time();
   oprintf("time: %.3f\n", etime - stime);
+  oprintf("biased reader-writer lock wicked:\n");
+  stime = kc::time();
+  rwlock.lock_writer();
+  rwlock.set_bias(true);
+  rwlock.unlock();
+  class ThreadRWLockWicked : public kc::Thread {
+   public:
+    void setparams(int32_t id, kc::RWLock* rwlock, int64_t rnum, int32_t thnum,
+                   kc::AtomicInt64* rcnt, volatile int64_t* wcnt) {
+      id_ = id;
+      rwlock_ = rwlock;
+      rnum_ = rnum;
+      thnum_ = thnum;
+      rcnt_ = rcnt;
+      wcnt_ = wcnt;
+      err_ = false;
+    }
+    bool error() {
+      return err_;
+    }
+    void run() {
+      for (int64_t i = 1; !err_ && i <= rnum_; i++) {
+        if (myrand(8) == 0) {
+          bool locked = true;
+          if (myrand(4) == 0) {
+            locked = rwlock_->lock_writer_try();
+          } else {
+            rwlock_->lock_writer();
+          }
+          if (locked) {
+            if (rcnt_->get() != 0) {
+              errprint(__LINE__, "RWLock::lock_writer: %lld", (long long)rcnt_->get());
+              err_ = true;
+            }
+            int64_t onum = *wcnt_;
+            *wcnt_ = onum + 1;
+            if (myrand(2) == 0) yield();
+            if (*wcnt_ != onum + 1) {
+              errprint(__LINE__, "RWLock::lock_writer: %lld", (long long)*wcnt_);
+              err_ = true;
+            }
+            rwlock_->unlock();
+          }
+        } else {
+          bool locked = true;
+          if (myrand(4) == 0) {
+            locked = rwlock_->lock_reader_try();
+          } else {
+            rwlock_->lock_reader();
+          }
+          if (locked) {
+            rcnt_->add(1);
+            int64_t onum = *wcnt_;
+            if (myrand(2) == 0) yield();
+            if (*wcnt_ != onum) {
+              errprint(__LINE__, "RWLock::lock_reader: %lld", (long long)*wcnt_);
+              err_ = true;
+            }
+            rcnt_->add(-1);
+            rwlock_->unlock();
+          }
+        }
+        if (id_ < 1 && rnum_ > 250 && i % (rnum_ / 250) == 0) {
+          oputchar('.');
+          if (i == rnum_ || i % (rnum_ / 10) == 0) oprintf(" (%08lld)\n", (long long)i);
+        }
+      }
+    }
+   private:
+    int32_t id_;
+    kc::RWLock* rwlock_;
+    int64_t rnum_;
+    int32_t thnum_;
+    kc::AtomicInt64* rcnt_;
+    volatile int64_t* wcnt_;
+    bool err_;
+  };
+  kc::AtomicInt64 rwlockrcnt;
+  volatile int64_t rwlockwcnt = 0;
+  ThreadRWLockWicked threadrwlockwickeds[THREADMAX];
+  if (thnum < 2) {
+    threadrwlockwickeds[0].setparams(0, &rwlock, rnum, thnum, &rwlockrcnt, &rwlockwcnt);
+    threadrwlockwickeds[0].run();
+    if (threadrwlockwickeds[0].error()) err = true;
+  } else {
+    for (int32_t i = 0; i < thnum; i++) {
+      threadrwlockwickeds[i].setparams(i, &rwlock, rnum, thnum, &rwlockrcnt, &rwlockwcnt);
+      threadrwlockwickeds[i].start();
+    }
+    for (int32_t i = 0; i < thnum; i++) {
+      threadrwlockwickeds[i].join();
+      if (threadrwlockwickeds[i].error()) err = true;
+    }
+  }
+  rwlock.lock_writer();
+  rwlock.set_bias(false);
+  rwlock.unlock();
+  etime = kc::time();
+  oprintf("time: %.3f\n", etime - stime);
   kc::SlottedRWLock srwlock(LOCKSLOTNUM);
   oprintf("slotted reader-writer lock writer:\n");
   stime = kc::time();
@@ -1131,6 +1269,65 @@ static int32_t procmutex(int64_t rnum, int32_t thnum, double iv) {
   }
   etime = kc::time();
   oprintf("time: %.3f\n", etime - stime);
+  oprintf("sharded increment:\n");
+  stime = kc::time();
+  kc::ShardedInt64 snum;
+  snum = rnum * thnum;
+  class ThreadSharded : public kc::Thread {
+   public:
+    void setparams(int32_t id, kc::ShardedInt64* snum, int64_t rnum, int32_t thnum, double iv) {
+      id_ = id;
+      snum_ = snum;
+      rnum_ = rnum;
+      thnum_ = thnum;
+      iv_ = iv;
+    }
+    void run() {
+      for (int64_t i = 1; i <= rnum_; i++) {
+        snum_->add(2);
+        *snum_ += 1;
+        *snum_ -= 1;
+        if (iv_ > 0) {
+          sleep(iv_);
+        } else if (iv_ < 0) {
+          yield();
+        }
+        if (id_ < 1 && rnum_ > 250 && i % (rnum_ / 250) == 0) {
+          oputchar('.');
+          if (i == rnum_ || i % (rnum_ / 10) == 0) oprintf(" (%08lld)\n", (long long)i);
+        }
+      }
+    }
+   private:
+    int32_t id_;
+    kc::ShardedInt64* snum_;
+    int64_t rnum_;
+    int32_t thnum_;
+    double iv_;
+  };
+  ThreadSharded threadsharded[THREADMAX];
+  if (thnum < 2) {
+    threadsharded[0].setparams(0, &snum, rnum, thnum, iv);
+    threadsharded[0].run();
+  } else {
+    for (int32_t i = 0; i < thnum; i++) {
+      threadsharded[i].setparams(i, &snum, rnum, thnum, iv);
+      threadsharded[i].start();
+    }
+    for (int32_t i = 0; i < thnum; i++) {
+      threadsharded[i].join();
+    }
+  }
+  if (snum.get() != rnum * thnum * 3) {
+    errprint(__LINE__, "ShardedInt64::get: %lld", (long long)snum.get());
+    err = true;
+  }
+  if (snum.set(0) != rnum * thnum * 3 || (int64_t)snum != 0) {
+    errprint(__LINE__, "ShardedInt64::set: %lld", (long long)snum.get());
+    err = true;
+  }
+  etime = kc::time();
+  oprintf("time: %.3f\n", etime - stime);
   oprintf("%s\n\n", err ? "error" : "ok");
   return err ? 1 : 0;
 }
@@ -1383,14 +1580,17 @@ static int32_t procpara(int64_t rnum, int32_t thnum, double iv) {
 
 
 // perform file command
-static int32_t procfile(const char* path, int64_t rnum, int32_t thnum, bool rnd, int64_t msiz) {
-  oprintf("<File Test>\n  seed=%u  path=%s  rnum=%lld  thnum=%d  rnd=%d  msiz=%lld\n\n",
-          g_randseed, path, (long long)rnum, thnum, rnd, (long long)msiz);
+static int32_t procfile(const char* path, int64_t rnum, int32_t thnum, bool rnd, int64_t msiz,
+                        int64_t mcap) {
+  oprintf("<File Test>\n  seed=%u  path=%s  rnum=%lld  thnum=%d  rnd=%d  msiz=%lld"
+          "  mcap=%lld\n\n", g_randseed, path, (long long)rnum, thnum, rnd, (long long)msiz,
+          (long long)mcap);
   bool err = false;
   kc::File file;
   oprintf("opening the file:\n");
   double stime = kc::time();
-  if (!file.open(path, kc::File::OWRITER | kc::File::OCREATE | kc::File::OTRUNCATE, msiz)) {
+  if (!file.open(path, kc::File::OWRITER | kc::File::OCREATE | kc::File::OTRUNCATE,
+                 msiz, mcap)) {
     fileerrprint(&file, __LINE__, "File::open");
     err = true;
   }
@@ -1462,6 +1662,76 @@ static int32_t procfile(const char* path, int64_t rnum, int32_t thnum, bool rnd,
       if (threadwrites[i].error()) err = true;
     }
   }
+  if (!file.write_back(-1)) {
+    fileerrprint(&file, __LINE__, "File::write_back");
+    err = true;
+  }
+  etime = kc::time();
+  filemetaprint(&file);
+  oprintf("time: %.3f\n", etime - stime);
+  oprintf("appending:\n");
+  stime = kc::time();
+  class ThreadAppend : public kc::Thread {
+   public:
+    void setparams(int32_t id, kc::File* file, int64_t rnum) {
+      id_ = id;
+      file_ = file;
+      rnum_ = rnum;
+      err_ = false;
+    }
+    bool error() {
+      return err_;
+    }
+    void run() {
+      char rbuf[FILEIOUNIT];
+      std::memset(rbuf, 'a' + id_ % 26, sizeof(rbuf));
+      for (int64_t i = 1; !err_ && i <= rnum_; i++) {
+        if (!file_->append(rbuf, sizeof(rbuf))) {
+          fileerrprint(file_, __LINE__, "File::append");
+          err_ = true;
+        }
+        if (id_ < 1 && rnum_ > 250 && i % (rnum_ / 250) == 0) {
+          oputchar('.');
+          if (i == rnum_ || i % (rnum_ / 10) == 0) oprintf(" (%08lld)\n", (long long)i);
+        }
+      }
+    }
+   private:
+    int32_t id_;
+    kc::File* file_;
+    int64_t rnum_;
+    bool err_;
+  };
+  int64_t abase = file.size();
+  ThreadAppend threadappends[THREADMAX];
+  if (thnum < 2) {
+    threadappends[0].setparams(0, &file, rnum);
+    threadappends[0].run();
+    if (threadappends[0].error()) err = true;
+  } else {
+    for (int32_t i = 0; i < thnum; i++) {
+      threadappends[i].setparams(i, &file, rnum);
+      threadappends[i].start();
+    }
+    for (int32_t i = 0; i < thnum; i++) {
+      threadappends[i].join();
+      if (threadappends[i].error()) err = true;
+    }
+  }
+  if (file.size() != abase + rnum * thnum * (int64_t)FILEIOUNIT) {
+    errprint(__LINE__, "File::size: %lld", (long long)file.size());
+    err = true;
+  }
+  for (int64_t off = abase; !err && off < file.size(); off += FILEIOUNIT) {
+    char rbuf[FILEIOUNIT];
+    if (!file.read(off, rbuf, sizeof(rbuf))) {
+      fileerrprint(&file, __LINE__, "File::read");
+      err = true;
+    } else if (std::count(rbuf, rbuf + sizeof(rbuf), rbuf[0]) != (int64_t)sizeof(rbuf)) {
+      errprint(__LINE__, "File::append: %lld", (long long)off);
+      err = true;
+    }
+  }
   etime = kc::time();
   filemetaprint(&file);
   oprintf("time: %.3f\n", etime - stime);
@@ -1968,6 +2238,74 @@ static int32_t procfile(const char* path, int64_t rnum, int32_t thnum, bool rnd,
     errprint(__LINE__, "DirStream::close");
     err = true;
   }
+  if (mcap > msiz) {
+    oprintf("writing beyond the end of the file in the grown map:\n");
+    const std::string& gpath = std::string(path) + kc::File::EXTCHR + "grow";
+    kc::File gfile;
+    if (!gfile.open(gpath, kc::File::OWRITER | kc::File::OCREATE | kc::File::OTRUNCATE,
+                    msiz, mcap)) {
+      fileerrprint(&gfile, __LINE__, "File::open");
+      err = true;
+    }
+    if (!gfile.write(0, "a", 1)) {
+      fileerrprint(&gfile, __LINE__, "File::write");
+      err = true;
+    }
+    int64_t goff = msiz + (mcap - msiz) / 2;
+    char gbuf[1];
+    gfile.read_fast(goff, gbuf, sizeof(gbuf));
+    if (!gfile.write_fast(goff, "b", 1)) {
+      fileerrprint(&gfile, __LINE__, "File::write_fast");
+      err = true;
+    }
+    if (!gfile.read_fast(goff, gbuf, sizeof(gbuf)) || *gbuf != 'b') {
+      fileerrprint(&gfile, __LINE__, "File::read_fast");
+      err = true;
+    }
+    if (!gfile.close()) {
+      fileerrprint(&gfile, __LINE__, "File::close");
+      err = true;
+    }
+    kc::File::remove(gpath);
+  }
+  oprintf("writing back the updated chunks of the map:\n");
+  const std::string& dpath = std::string(path) + kc::File::EXTCHR + "dirty";
+  kc::File dfile;
+  if (!dfile.open(dpath, kc::File::OWRITER | kc::File::OCREATE | kc::File::OTRUNCATE,
+                  1LL << 24)) {
+    fileerrprint(&dfile, __LINE__, "File::open");
+    err = true;
+  }
+  if (!dfile.write(0, "a", 1)) {
+    fileerrprint(&dfile, __LINE__, "File::write");
+    err = true;
+  }
+  int64_t dunit = dfile.dirty_size();
+  if (dunit < 1 || !dfile.write(dunit * 4, "b", 1) || dfile.dirty_size() != dunit * 2) {
+    fileerrprint(&dfile, __LINE__, "File::dirty_size");
+    err = true;
+  }
+  if (!dfile.synchronize(false) || dfile.dirty_size() != dunit * 2) {
+    fileerrprint(&dfile, __LINE__, "File::synchronize");
+    err = true;
+  }
+  if (!dfile.write_back(dunit) || dfile.dirty_size() != dunit) {
+    fileerrprint(&dfile, __LINE__, "File::write_back");
+    err = true;
+  }
+  if (!dfile.synchronize(true) || dfile.dirty_size() != 0) {
+    fileerrprint(&dfile, __LINE__, "File::synchronize");
+    err = true;
+  }
+  if (!dfile.write(dunit * 2, "c", 1) || dfile.dirty_size() != dunit) {
+    fileerrprint(&dfile, __LINE__, "File::dirty_size");
+    err = true;
+  }
+  if (!dfile.close()) {
+    fileerrprint(&dfile, __LINE__, "File::close");
+    err = true;
+  }
+  kc::File::remove(dpath);
   etime = kc::time();
   oprintf("time: %.3f\n", etime - stime);
   oprintf("%s\n\n", err ? "error" : "ok");
@@ -2480,6 +2818,101 @@ static int32_t proctalist(int64_t rnum, bool rnd) {
 }
 
 
+// perform twheel command
+static int32_t proctwheel(int64_t rnum, bool rnd) {
+  oprintf("<Timer Wheel Test>\n  seed=%u  rnum=%lld  rnd=%d\n\n",
+          g_randseed, (long long)rnum, rnd);
+  bool err = false;
+  int64_t ct = 1LL << 30;
+  kc::TimerWheel wheel(ct);
+  std::map<uint64_t, int64_t> xts;
+  oprintf("setting records:\n");
+  double stime = kc::time();
+  for (int64_t i = 1; i <= rnum; i++) {
+    char kbuf[RECBUFSIZ];
+    size_t ksiz = std::sprintf(kbuf, "%08lld", (long long)(rnd ? myrand(rnum) + 1 : i));
+    int64_t xt = ct + i;
+    if (rnd) {
+      int32_t bits = myrand(36);
+      xt = ct + myrand(1LL << bits) - (bits < 1 ? 1 : 0);
+    }
+    uint64_t hash = kc::hashmurmur(kbuf, ksiz);
+    wheel.set(hash, xt);
+    xts[hash] = xt;
+    if (rnd && myrand(10) == 0) {
+      ksiz = std::sprintf(kbuf, "%08lld", (long long)myrand(rnum) + 1);
+      hash = kc::hashmurmur(kbuf, ksiz);
+      if (wheel.remove(hash) != (xts.erase(hash) > 0)) {
+        errprint(__LINE__, "TimerWheel::remove");
+        err = true;
+      }
+    }
+    if (rnum > 250 && i % (rnum / 250) == 0) {
+      oputchar('.');
+      if (i == rnum || i % (rnum / 10) == 0) oprintf(" (%08lld)\n", (long long)i);
+    }
+  }
+  double etime = kc::time();
+  oprintf("time: %.3f\n", etime - stime);
+  oprintf("count: %lld\n", (long long)wheel.count());
+  if (wheel.count() != xts.size()) {
+    errprint(__LINE__, "TimerWheel::count");
+    err = true;
+  }
+  int64_t musage = memusage();
+  if (musage > 0) oprintf("memory: %lld\n", (long long)(musage - g_memusage));
+  oprintf("expiring records:\n");
+  stime = kc::time();
+  int64_t cnt = 0;
+  while (!err && !xts.empty()) {
+    int64_t step = rnd ? myrand(1LL << myrand(36)) : rnum / 100 + 1;
+    ct += step;
+    std::vector<uint64_t> hashes;
+    size_t max = rnd && myrand(2) == 0 ? myrand(rnum) + 1 : kc::SIZEMAX;
+    wheel.expire(ct, max, &hashes);
+    std::vector<uint64_t>::iterator it = hashes.begin();
+    std::vector<uint64_t>::iterator itend = hashes.end();
+    while (it != itend) {
+      std::map<uint64_t, int64_t>::iterator xit = xts.find(*it);
+      if (xit == xts.end() || xit->second >= ct) {
+        errprint(__LINE__, "TimerWheel::expire: %llu", (unsigned long long)*it);
+        err = true;
+        break;
+      }
+      xts.erase(xit);
+      if (rnum > 250 && ++cnt % (rnum / 250) == 0) {
+        oputchar('.');
+        if (cnt % (rnum / 10) == 0) oprintf(" (%08lld)\n", (long long)cnt);
+      }
+      ++it;
+    }
+    if (hashes.size() >= max) continue;
+    std::map<uint64_t, int64_t>::iterator xit = xts.begin();
+    std::map<uint64_t, int64_t>::iterator xitend = xts.end();
+    while (xit != xitend) {
+      if (xit->second < ct) {
+        errprint(__LINE__, "TimerWheel::expire: %llu", (unsigned long long)xit->first);
+        err = true;
+        break;
+      }
+      ++xit;
+    }
+  }
+  if (rnum > 250) oprintf(" (end)\n");
+  etime = kc::time();
+  oprintf("time: %.3f\n", etime - stime);
+  oprintf("count: %lld\n", (long long)wheel.count());
+  if (wheel.count() != 0) {
+    errprint(__LINE__, "TimerWheel::count");
+    err = true;
+  }
+  musage = memusage();
+  if (musage > 0) oprintf("memory: %lld\n", (long long)(musage - g_memusage));
+  oprintf("%s\n\n", err ? "error" : "ok");
+  return err ? 1 : 0;
+}
+
+
 // perform misc command
 static int32_t procmisc(int64_t rnum) {
   oprintf("<Miscellaneous Test>\n  seed=%u  rnum=%lld\n\n", g_randseed, (long long)rnum);
@@ -2488,6 +2921,120 @@ static int32_t procmisc(int64_t rnum) {
     errprint(__LINE__, "_dummytest");
     err = true;
   }
+  int32_t nodenum = kc::numanodes();
+  if (nodenum < 1) {
+    errprint(__LINE__, "numanodes: %d", (int)nodenum);
+    err = true;
+  } else {
+    size_t msiz = 1 << 20;
+    char* mbuf = (char*)kc::mapalloc(msiz);
+    kc::numabind(mbuf, msiz, nodenum - 1);
+    std::memset(mbuf, 0xff, msiz);
+    kc::mapfree(mbuf);
+  }
+  kc::AdaptiveCompressor acomp;
+  for (int32_t i = 0; i < 2; i++) {
+    size_t asiz = 4096;
+    char* abuf = new char[asiz];
+    for (size_t j = 0; j < asiz; j++) {
+      abuf[j] = i > 0 ? myrand(kc::UINT8MAX + 1) : 'a' + j % 8;
+    }
+    kc::Compressor* comp = &acomp;
+    size_t zsiz;
+    char* zbuf = comp->compress(abuf, asiz, &zsiz);
+    size_t osiz;
+    char* obuf = comp->decompress(zbuf, zsiz, &osiz);
+    if (!obuf || osiz != asiz || std::memcmp(obuf, abuf, osiz)) {
+      errprint(__LINE__, "AdaptiveCompressor::decompress");
+      err = true;
+    }
+    delete[] obuf;
+    delete[] zbuf;
+    delete[] abuf;
+  }
+  std::map<std::string, std::string> astatus;
+  acomp.status(&astatus);
+  if (kc::atoi(astatus["zraw"].c_str()) + kc::atoi(astatus["zcomp"].c_str()) != 2 ||
+      astatus["zskip"] != "1") {
+    errprint(__LINE__, "AdaptiveCompressor::status");
+    err = true;
+  }
+  const char* aeskey = "\xfe\xff\xe9\x92\x86\x65\x73\x1c\x6d\x6a\x8f\x94\x67\x30\x83\x08";
+  const char* aesiv = "\xca\xfe\xba\xbe\xfa\xce\xdb\xad\xde\xca\xf8\x88";
+  const char* aesaad = "\xfe\xed\xfa\xce\xde\xad\xbe\xef\xfe\xed\xfa\xce\xde\xad\xbe\xef"
+    "\xab\xad\xda\xd2";
+  const char* aesplain = "\xd9\x31\x32\x25\xf8\x84\x06\xe5\xa5\x59\x09\xc5\xaf\xf5\x26\x9a"
+    "\x86\xa7\xa9\x53\x15\x34\xf7\xda\x2e\x4c\x30\x3d\x8a\x31\x8a\x72"
+    "\x1c\x3c\x0c\x95\x95\x68\x09\x53\x2f\xcf\x0e\x24\x49\xa6\xb5\x25"
+    "\xb1\x6a\xed\xf5\xaa\x0d\xe6\x57\xba\x63\x7b\x39";
+  const char* aestag = "\x5b\xc9\x4f\xbc\x32\x21\xa5\xdb\x94\xfa\xe9\x5a\xe7\x12\x1a\x47";
+  kc::AES aes;
+  aes.set_key(aeskey, 16);
+  char aesbuf[60], aesdec[60], aesmac[kc::AES::TAGSIZ];
+  aes.encrypt(aesiv, aesplain, sizeof(aesbuf), aesbuf, aesmac, aesaad, 20);
+  if (std::memcmp(aesmac, aestag, sizeof(aesmac)) ||
+      !aes.decrypt(aesiv, aesbuf, sizeof(aesbuf), aesdec, aesmac, aesaad, 20) ||
+      std::memcmp(aesdec, aesplain, sizeof(aesdec))) {
+    errprint(__LINE__, "AES::encrypt");
+    err = true;
+  }
+  aesbuf[0] ^= 1;
+  if (aes.decrypt(aesiv, aesbuf, sizeof(aesbuf), aesdec, aesmac, aesaad, 20)) {
+    errprint(__LINE__, "AES::decrypt");
+    err = true;
+  }
+  char dkey[32];
+  kc::AES::derive_key("mikio", 5, "kyotocabinet:aes", 16, 3, dkey, sizeof(dkey));
+  if (std::memcmp(dkey, "\x38\x79\xf5\x8a\x1a\x1d\xe5\x7c\x80\xfd\x6f\xab\xe1\x20\x4e\x3b"
+                  "\x6f\x5e\xf6\x90\xb5\x24\xd2\xa4\xca\x45\x04\x6f\xef\x42\x20\xe0", 32)) {
+    errprint(__LINE__, "AES::derive_key");
+    err = true;
+  }
+  kc::AES::derive_key("0123456789abcdef", 16, "salt", 4, 2, dkey, 20);
+  if (std::memcmp(dkey, "\x2d\x1c\xb3\x65\x99\xe6\xa9\x18\xe5\xa9\xd6\x56\x1b\x98\x47\x6a"
+                  "\xa9\xbb\x70\x0f", 20)) {
+    errprint(__LINE__, "AES::derive_key");
+    err = true;
+  }
+  kc::AESCompressor aescomp;
+  size_t nsiz;
+  char* nbuf = ((kc::Compressor*)&aescomp)->compress("mikio", 5, &nsiz);
+  if (nbuf || aescomp.set_key("", 0)) {
+    errprint(__LINE__, "AESCompressor::set_key");
+    err = true;
+    delete[] nbuf;
+  }
+  if (!aescomp.set_key("mikio", 5)) {
+    errprint(__LINE__, "AESCompressor::set_key");
+    err = true;
+  }
+  for (int32_t i = 0; i < 2; i++) {
+    if (i > 0) aescomp.set_compressor(kc::ZLIBRAWCOMP);
+    size_t asiz = myrand(65536);
+    char* abuf = new char[asiz+1];
+    for (size_t j = 0; j < asiz; j++) {
+      abuf[j] = 'a' + myrand(4);
+    }
+    kc::Compressor* comp = &aescomp;
+    size_t zsiz;
+    char* zbuf = comp->compress(abuf, asiz, &zsiz);
+    size_t osiz;
+    char* obuf = comp->decompress(zbuf, zsiz, &osiz);
+    if (!obuf || osiz != asiz || std::memcmp(obuf, abuf, osiz)) {
+      errprint(__LINE__, "AESCompressor::decompress");
+      err = true;
+    }
+    delete[] obuf;
+    zbuf[myrand(zsiz)] ^= 1;
+    obuf = comp->decompress(zbuf, zsiz, &osiz);
+    if (obuf) {
+      errprint(__LINE__, "AESCompressor::decompress");
+      err = true;
+      delete[] obuf;
+    }
+    delete[] zbuf;
+    delete[] abuf;
+  }
   double stime = kc::time();
   for (int64_t i = 1; !err && i <= rnum; i++) {
     uint16_t num16 = (1ULL << myrand(sizeof(num16) * 8)) - 5 + myrand(10);
@@ -131,6 +131,13 @@
 #define _KC_PXREGEX    1
 #endif
 
+#if (defined(__x86_64__) || defined(__i386__)) && \
+  (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define _KC_AESNI      1
+#else
+#define _KC_AESNI      0
+#endif
+
 
 
 /*************************************************************************************************
@@ -218,6 +225,14 @@ extern "C" {
 #include <sched.h>
 }
 
+#if defined(_SYS_LINUX_)
+extern "C" {
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/futex.h>
+}
+#endif
+
 #endif
 
 #if defined(_SYS_FREEBSD_) || defined(_SYS_OPENBSD_) || defined(_SYS_NETBSD_) || \
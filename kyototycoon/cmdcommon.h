@@ -46,6 +46,7 @@ const double DEFRIV = 0.04;              // default interval of replication
 const int64_t DEFULIM = 256LL << 20;     // default limit size of update log file
 const double DEFBGSI = 180;              // default interval of background saver
 const char* const BGSPATHEXT = "ktss";   // extension of a snapshot file
+const char* const BGIPATHEXT = "ktsi";   // extension of a memory image file
 
 
 // global variables
@@ -135,6 +136,31 @@ class DBUpdateLogger : public kt::TimedDB::UpdateTrigger {
       ulog_->write_volatile(nbuf, nsiz);
     }
   }
+  void trigger_bulk(const std::vector<std::string>& mvec) {
+    int32_t rsid = (int32_t)(intptr_t)rsid_.get();
+    uint16_t sid = rsid == 0 ? sid_ : (uint16_t)(rsid - 1);
+    std::vector<std::string> nvec;
+    nvec.reserve(mvec.size());
+    std::vector<std::string>::const_iterator it = mvec.begin();
+    std::vector<std::string>::const_iterator itend = mvec.end();
+    while (it != itend) {
+      char hbuf[sizeof(sid)+sizeof(dbid_)];
+      char* wp = hbuf;
+      kc::writefixnum(wp, sid, sizeof(sid));
+      wp += sizeof(sid);
+      kc::writefixnum(wp, dbid_, sizeof(dbid_));
+      nvec.push_back(std::string(hbuf, sizeof(hbuf)));
+      nvec.back().append(*it);
+      ++it;
+    }
+    if (tran_) {
+      trlock_.lock();
+      trcache_.insert(trcache_.end(), nvec.begin(), nvec.end());
+      trlock_.unlock();
+    } else {
+      ulog_->write_bulk(nvec);
+    }
+  }
   void begin_transaction() {
     tran_ = true;
   }
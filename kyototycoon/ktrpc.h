@@ -374,6 +374,14 @@ class RPCServer {
       _assert_(true);
       return sess_->thread_id();
     }
+    /**
+     * Set the NUMA node preferred to process the session.
+     * @param node the index of the node, or -1 for no preference.
+     */
+    void set_node(int32_t node) {
+      _assert_(true);
+      sess_->set_node(node);
+    }
     /**
      * Set the session local data.
      * @param data the session local data.  If it is NULL, no data is registered.
@@ -44,16 +44,19 @@ static void usage();
 static void killserver(int signum);
 static int32_t run(int argc, char** argv);
 static int32_t proc(const std::vector<std::string>& dbpaths,
-                    const char* host, int32_t port, double tout, int32_t thnum,
+                    const char* host, int32_t port, double tout, int32_t thnum, bool numa,
                     const char* logpath, uint32_t logkinds,
                     const char* ulogpath, int64_t ulim, double uasi,
                     int32_t sid, int32_t omode, double asi, bool ash,
-                    const char* bgspath, double bgsi, kc::Compressor* bgscomp, bool dmn,
+                    const char* bgspath, double bgsi, kc::Compressor* bgscomp, bool bgsm,
+                    bool dmn,
                     const char* pidpath, const char* cmdpath, const char* scrpath,
                     const char* mhost, int32_t mport, const char* rtspath, double riv,
                     const char* plsvpath, const char* plsvex, const char* pldbpath);
 static bool dosnapshot(const char* bgspath, kc::Compressor* bgscomp,
-                       kt::TimedDB* dbs, int32_t dbnum, kt::RPCServer* serv);
+                       kt::TimedDB* dbs, int32_t dbnum, kt::RPCServer* serv, bool image = false);
+static bool dumpimage(const char* bgspath, kt::TimedDB* db, int32_t idx, kt::RPCServer* serv);
+static bool loadimage(const std::string& path, kt::TimedDB* db);
 
 
 // logger implementation
@@ -333,12 +336,12 @@ class Worker : public kt::RPCServer::Worker {
   typedef kt::RPCClient::ReturnValue RV;
  public:
   // constructor
-  explicit Worker(int32_t thnum, kc::CondMap* condmap, kt::TimedDB* dbs, int32_t dbnum,
-                  const std::map<std::string, int32_t>& dbmap, int32_t omode,
+  explicit Worker(int32_t thnum, bool numa, kc::CondMap* condmap, kt::TimedDB* dbs,
+                  int32_t dbnum, const std::map<std::string, int32_t>& dbmap, int32_t omode,
                   double asi, bool ash, const char* bgspath, double bgsi,
                   kc::Compressor* bgscomp, kt::UpdateLogger* ulog, DBUpdateLogger* ulogdbs,
                   const char* cmdpath, ScriptProcessor* scrprocs, OpCount* opcounts) :
-      thnum_(thnum), condmap_(condmap), dbs_(dbs), dbnum_(dbnum), dbmap_(dbmap),
+      thnum_(thnum), numa_(numa), condmap_(condmap), dbs_(dbs), dbnum_(dbnum), dbmap_(dbmap),
       omode_(omode), asi_(asi), ash_(ash), bgspath_(bgspath), bgsi_(bgsi), bgscomp_(bgscomp),
       ulog_(ulog), ulogdbs_(ulogdbs), cmdpath_(cmdpath), scrprocs_(scrprocs),
       opcounts_(opcounts), idlecnt_(0), asnext_(0), bgsnext_(0), slave_(NULL) {
@@ -379,6 +382,10 @@ class Worker : public kt::RPCServer::Worker {
       }
     }
     kt::TimedDB* db = dbidx >= 0 && dbidx < dbnum_ ? dbs_ + dbidx : NULL;
+    if (numa_ && db) {
+      rp = kt::strmapget(inmap, "key", &rsiz);
+      if (rp) sess->set_node(db->numa_node(rp, rsiz));
+    }
     int64_t curid = -1;
     rp = kt::strmapget(inmap, "CUR");
     if (rp && *rp >= '0' && *rp <= '9') curid = kc::atoi(rp);
@@ -433,6 +440,8 @@ class Worker : public kt::RPCServer::Worker {
       rv = do_increment(serv, sess, db, inmap, outmap);
     } else if (name == "increment_double") {
       rv = do_increment_double(serv, sess, db, inmap, outmap);
+    } else if (name == "merge") {
+      rv = do_merge(serv, sess, db, inmap, outmap);
     } else if (name == "cas") {
       rv = do_cas(serv, sess, db, inmap, outmap);
     } else if (name == "remove") {
@@ -527,6 +536,7 @@ class Worker : public kt::RPCServer::Worker {
     kt::TimedDB* db = dbs_ + dbidx;
     size_t ksiz;
     char* kbuf = kc::urldecode(pstr, &ksiz);
+    if (numa_) sess->set_node(db->numa_node(kbuf, ksiz));
     int32_t code;
     switch (method) {
       case kt::HTTPClient::MGET: {
@@ -617,6 +627,16 @@ class Worker : public kt::RPCServer::Worker {
   }
   // process each timer event
   void process_timer(kt::RPCServer* serv) {
+    if (omode_ & kc::BasicDB::OWRITER) {
+      for (int32_t i = 0; i < dbnum_; i++) {
+        kt::TimedDB* db = dbs_ + i;
+        if (!db->expire_due()) {
+          const kc::BasicDB::Error& e = db->error();
+          log_db_error(serv, e);
+          break;
+        }
+      }
+    }
     if (asi_ > 0 && (omode_ & kc::BasicDB::OWRITER) && kc::time() >= asnext_) {
       serv->log(Logger::INFO, "synchronizing databases");
       for (int32_t i = 0; i < dbnum_; i++) {
@@ -1240,6 +1260,64 @@ class Worker : public kt::RPCServer::Worker {
     }
     return rv;
   }
+  // process the merge procedure
+  RV do_merge(kt::RPCServer* serv, kt::RPCServer::Session* sess,
+              kt::TimedDB* db,
+              const std::map<std::string, std::string>& inmap,
+              std::map<std::string, std::string>& outmap) {
+    uint32_t thid = sess->thread_id();
+    if (!db) {
+      set_message(outmap, "ERROR", "no such database");
+      return kt::RPCClient::RVEINVALID;
+    }
+    size_t ksiz;
+    const char* kbuf = kt::strmapget(inmap, "key", &ksiz);
+    size_t vsiz;
+    const char* vbuf = kt::strmapget(inmap, "value", &vsiz);
+    const char* rp = kt::strmapget(inmap, "op");
+    if (!kbuf || !vbuf || !rp) {
+      set_message(outmap, "ERROR", "invalid parameters");
+      return kt::RPCClient::RVEINVALID;
+    }
+    char nbuf[kc::DoubleAddMerger::NUMSIZ];
+    kc::MergeOperator* op;
+    if (!std::strcmp(rp, "add")) {
+      kc::writefixnum(nbuf, kc::atoi(vbuf), sizeof(int64_t));
+      vbuf = nbuf;
+      vsiz = sizeof(int64_t);
+      op = kc::INTADDMERGE;
+    } else if (!std::strcmp(rp, "addf")) {
+      kc::DoubleAddMerger::encode(kc::atof(vbuf), nbuf);
+      vbuf = nbuf;
+      vsiz = sizeof(nbuf);
+      op = kc::DOUBLEADDMERGE;
+    } else if (!std::strcmp(rp, "append")) {
+      op = kc::APPENDMERGE;
+    } else if (!std::strcmp(rp, "max")) {
+      op = kc::MAXMERGE;
+    } else {
+      set_message(outmap, "ERROR", "invalid parameters");
+      return kt::RPCClient::RVEINVALID;
+    }
+    rp = kt::strmapget(inmap, "xt");
+    int64_t xt = rp ? kc::atoi(rp) : kc::INT64MAX;
+    RV rv;
+    opcounts_[thid][CNTSET]++;
+    if (db->merge(kbuf, ksiz, vbuf, vsiz, op, xt)) {
+      rv = kt::RPCClient::RVSUCCESS;
+    } else {
+      opcounts_[thid][CNTSETMISS]++;
+      const kc::BasicDB::Error& e = db->error();
+      set_db_error(outmap, e);
+      if (e == kc::BasicDB::Error::LOGIC) {
+        rv = kt::RPCClient::RVELOGIC;
+      } else {
+        log_db_error(serv, e);
+        rv = kt::RPCClient::RVEINTERNAL;
+      }
+    }
+    return rv;
+  }
   // process the cas procedure
   RV do_cas(kt::RPCServer* serv, kt::RPCServer::Session* sess,
             kt::TimedDB* db,
@@ -2315,6 +2393,10 @@ class Worker : public kt::RPCServer::Worker {
               }
               if (mts > rts) rts = mts;
               delete[] mbuf;
+            } else if (ulrd.error()) {
+              serv->log(kt::ThreadedServer::Logger::ERROR,
+                        "reading a broken update log message failed");
+              err = true;
             } else {
               uint64_t cc = kt::UpdateLogger::clock_pure();
               if (cc > 1000000000) cc -= 1000000000;
@@ -2459,6 +2541,9 @@ class Worker : public kt::RPCServer::Worker {
     bool err = false;
     uint32_t hits = 0;
     char stack[kc::NUMBUFSIZ+RECBUFSIZ*4];
+    kc::BasicDB::WriteBatch batch;
+    kt::TimedDB* bdb = NULL;
+    int64_t bxt = 0;
     for (uint32_t i = 0; !err && i < rnum; i++) {
       char hbuf[sizeof(uint16_t)+sizeof(uint32_t)+sizeof(uint32_t)+sizeof(int64_t)];
       if (sess->receive(hbuf, sizeof(hbuf))) {
@@ -2477,13 +2562,11 @@ class Worker : public kt::RPCServer::Worker {
           if (sess->receive(rbuf, rsiz)) {
             if (dbidx < dbnum_) {
               kt::TimedDB* db = dbs_ + dbidx;
-              opcounts_[thid][CNTSET]++;
-              if (db->set(rbuf, ksiz, rbuf + ksiz, vsiz, xt)) {
-                hits++;
-              } else {
-                opcounts_[thid][CNTSETMISS]++;
-                err = true;
-              }
+              if (batch.count() > 0 && (db != bdb || xt != bxt) &&
+                  !apply_bin_batch(bdb, &batch, bxt, thid, &hits)) err = true;
+              bdb = db;
+              bxt = xt;
+              batch.set(rbuf, ksiz, rbuf + ksiz, vsiz);
             }
           } else {
             err = true;
@@ -2496,6 +2579,7 @@ class Worker : public kt::RPCServer::Worker {
         err = true;
       }
     }
+    if (batch.count() > 0 && !apply_bin_batch(bdb, &batch, bxt, thid, &hits)) err = true;
     if (err) {
       char c = kt::RemoteDB::BMERROR;
       if (!norep) sess->send(&c, 1);
@@ -2508,6 +2592,21 @@ class Worker : public kt::RPCServer::Worker {
     }
     return !err;
   }
+  // apply the pending records of the binary set_bulk command
+  bool apply_bin_batch(kt::TimedDB* db, kc::BasicDB::WriteBatch* batch, int64_t xt,
+                       uint32_t thid, uint32_t* hitp) {
+    int64_t num = batch->count();
+    opcounts_[thid][CNTSET] += num;
+    bool err = false;
+    if (db->write_batch(*batch, xt) >= 0) {
+      *hitp += num;
+    } else {
+      opcounts_[thid][CNTSETMISS] += num;
+      err = true;
+    }
+    batch->clear();
+    return !err;
+  }
   // process the binary remove_bulk command
   bool do_bin_remove_bulk(kt::ThreadedServer* serv, kt::ThreadedServer::Session* sess) {
     uint32_t thid = sess->thread_id();
@@ -2673,6 +2772,7 @@ class Worker : public kt::RPCServer::Worker {
     std::map<int64_t, kt::TimedDB::Cursor*> curs_;
   };
   int32_t thnum_;
+  bool numa_;
   kc::CondMap* const condmap_;
   kt::TimedDB* const dbs_;
   const int32_t dbnum_;
@@ -2716,9 +2816,9 @@ static void usage() {
   eprintf("%s: Kyoto Tycoon: a handy cache/storage server\n", g_progname);
   eprintf("\n");
   eprintf("usage:\n");
-  eprintf("  %s [-host str] [-port num] [-tout num] [-th num] [-log file] [-li|-ls|-le|-lz]"
-          " [-ulog dir] [-ulim num] [-uasi num] [-sid num] [-ord] [-oat|-oas|-onl|-otl|-onr]"
-          " [-asi num] [-ash] [-bgs dir] [-bgsi num] [-bgsc str]"
+  eprintf("  %s [-host str] [-port num] [-tout num] [-th num] [-numa] [-log file]"
+          " [-li|-ls|-le|-lz] [-ulog dir] [-ulim num] [-uasi num] [-sid num] [-ord] [-oat|-oas|-onl|-otl|-onr]"
+          " [-asi num] [-ash] [-bgs dir] [-bgsi num] [-bgsc str] [-bgsm]"
           " [-dmn] [-pid file] [-cmd dir] [-scr file]"
           " [-mhost str] [-mport num] [-rts file] [-riv num]"
           " [-plsv file] [-plex str] [-pldb file] [db...]\n", g_progname);
@@ -2746,6 +2846,7 @@ static int32_t run(int argc, char** argv) {
   int32_t port = kt::DEFPORT;
   double tout = DEFTOUT;
   int32_t thnum = DEFTHNUM;
+  bool numa = false;
   const char* logpath = NULL;
   uint32_t logkinds = kc::UINT32MAX;
   const char* ulogpath = NULL;
@@ -2758,6 +2859,7 @@ static int32_t run(int argc, char** argv) {
   const char* bgspath = NULL;
   double bgsi = DEFBGSI;
   kc::Compressor* bgscomp = NULL;
+  bool bgsm = false;
   bool dmn = false;
   const char* pidpath = NULL;
   const char* cmdpath = NULL;
@@ -2785,6 +2887,8 @@ static int32_t run(int argc, char** argv) {
       } else if (!std::strcmp(argv[i], "-th")) {
         if (++i >= argc) usage();
         thnum = kc::atof(argv[i]);
+      } else if (!std::strcmp(argv[i], "-numa")) {
+        numa = true;
       } else if (!std::strcmp(argv[i], "-log")) {
         if (++i >= argc) usage();
         logpath = argv[i];
@@ -2842,6 +2946,8 @@ static int32_t run(int argc, char** argv) {
         } else if (!kc::stricmp(cn, "lzma") || !kc::stricmp(cn, "xz")) {
           bgscomp = new kc::LZMACompressor<kc::LZMA::RAW>;
         }
+      } else if (!std::strcmp(argv[i], "-bgsm")) {
+        bgsm = true;
       } else if (!std::strcmp(argv[i], "-dmn")) {
         dmn = true;
       } else if (!std::strcmp(argv[i], "-pid")) {
@@ -2888,8 +2994,8 @@ static int32_t run(int argc, char** argv) {
     if (pldbpath) usage();
     dbpaths.push_back(":");
   }
-  int32_t rv = proc(dbpaths, host, port, tout, thnum, logpath, logkinds,
-                    ulogpath, ulim, uasi, sid, omode, asi, ash, bgspath, bgsi, bgscomp,
+  int32_t rv = proc(dbpaths, host, port, tout, thnum, numa, logpath, logkinds,
+                    ulogpath, ulim, uasi, sid, omode, asi, ash, bgspath, bgsi, bgscomp, bgsm,
                     dmn, pidpath, cmdpath, scrpath, mhost, mport, rtspath, riv,
                     plsvpath, plsvex, pldbpath);
   delete bgscomp;
@@ -2899,11 +3005,12 @@ static int32_t run(int argc, char** argv) {
 
 // drive the server process
 static int32_t proc(const std::vector<std::string>& dbpaths,
-                    const char* host, int32_t port, double tout, int32_t thnum,
+                    const char* host, int32_t port, double tout, int32_t thnum, bool numa,
                     const char* logpath, uint32_t logkinds,
                     const char* ulogpath, int64_t ulim, double uasi,
                     int32_t sid, int32_t omode, double asi, bool ash,
-                    const char* bgspath, double bgsi, kc::Compressor* bgscomp, bool dmn,
+                    const char* bgspath, double bgsi, kc::Compressor* bgscomp, bool bgsm,
+                    bool dmn,
                     const char* pidpath, const char* cmdpath, const char* scrpath,
                     const char* mhost, int32_t mport, const char* rtspath, double riv,
                     const char* plsvpath, const char* plsvex, const char* pldbpath) {
@@ -3069,21 +3176,42 @@ static int32_t proc(const std::vector<std::string>& dbpaths,
         const char* nstr = name.c_str();
         const char* pv = std::strrchr(nstr, kc::File::EXTCHR);
         int32_t idx = kc::atoi(nstr);
-        if (*nstr >= '0' && *nstr <= '9' && pv && !kc::stricmp(pv + 1, BGSPATHEXT) &&
-            idx >= 0 && idx < dbnum) {
-          std::string path;
-          kc::strprintf(&path, "%s%c%s", bgspath, kc::File::PATHCHR, nstr);
-          uint64_t ssts;
-          int64_t sscount, sssize;
-          if (kt::TimedDB::status_snapshot_atomic(path, &ssts, &sscount, &sssize)) {
-            serv.log(Logger::SYSTEM,
-                     "applying a snapshot file: db=%d ts=%llu count=%lld size=%lld",
-                     idx, (unsigned long long)ssts, (long long)sscount, (long long)sssize);
-            if (!dbs[idx].load_snapshot_atomic(path, bgscomp)) {
-              const kc::BasicDB::Error& e = dbs[idx].error();
-              serv.log(Logger::ERROR, "could not apply a snapshot: %s: %s",
-                       e.name(), e.message());
-            }
+        if (*nstr < '0' || *nstr > '9' || !pv || idx < 0 || idx >= dbnum) continue;
+        std::string path;
+        kc::strprintf(&path, "%s%c%s", bgspath, kc::File::PATHCHR, nstr);
+        std::string ipath, spath;
+        kc::strprintf(&ipath, "%s%c%08d%c%s",
+                      bgspath, kc::File::PATHCHR, idx, kc::File::EXTCHR, BGIPATHEXT);
+        kc::strprintf(&spath, "%s%c%08d%c%s",
+                      bgspath, kc::File::PATHCHR, idx, kc::File::EXTCHR, BGSPATHEXT);
+        kc::File::Status isbuf, ssbuf;
+        bool iok = kc::File::status(ipath, &isbuf);
+        bool sok = kc::File::status(spath, &ssbuf);
+        if (!kc::stricmp(pv + 1, BGIPATHEXT)) {
+          if (sok && ssbuf.mtime > isbuf.mtime) continue;
+          serv.log(Logger::SYSTEM, "loading a memory image file: db=%d size=%lld",
+                   idx, (long long)isbuf.size);
+          if (loadimage(path, dbs + idx)) continue;
+          const kc::BasicDB::Error& e = dbs[idx].reveal_inner_db()->error();
+          serv.log(Logger::ERROR, "could not load a memory image: %s: %s",
+                   e.name(), e.message());
+          if (!sok) continue;
+          path = spath;
+        } else if (!kc::stricmp(pv + 1, BGSPATHEXT)) {
+          if (iok && isbuf.mtime >= ssbuf.mtime) continue;
+        } else {
+          continue;
+        }
+        uint64_t ssts;
+        int64_t sscount, sssize;
+        if (kt::TimedDB::status_snapshot_atomic(path, &ssts, &sscount, &sssize)) {
+          serv.log(Logger::SYSTEM,
+                   "applying a snapshot file: db=%d ts=%llu count=%lld size=%lld",
+                   idx, (unsigned long long)ssts, (long long)sscount, (long long)sssize);
+          if (!dbs[idx].load_snapshot_atomic(path, bgscomp)) {
+            const kc::BasicDB::Error& e = dbs[idx].error();
+            serv.log(Logger::ERROR, "could not apply a snapshot: %s: %s",
+                     e.name(), e.message());
           }
         }
       }
@@ -3139,9 +3267,10 @@ static int32_t proc(const std::vector<std::string>& dbpaths,
     }
   }
   kc::CondMap condmap;
-  Worker worker(thnum, &condmap, dbs, dbnum, dbmap, omode, asi, ash, bgspath, bgsi, bgscomp,
-                ulog, ulogdbs, cmdpath, scrprocs, opcounts);
+  Worker worker(thnum, numa, &condmap, dbs, dbnum, dbmap, omode, asi, ash, bgspath, bgsi,
+                bgscomp, ulog, ulogdbs, cmdpath, scrprocs, opcounts);
   serv.set_worker(&worker, thnum);
+  if (numa) serv.reveal_core()->reveal_core()->set_numa(true);
   if (pidpath) {
     char numbuf[kc::NUMBUFSIZ];
     size_t nsiz = std::sprintf(numbuf, "%d\n", g_procid);
@@ -3204,7 +3333,7 @@ static int32_t proc(const std::vector<std::string>& dbpaths,
   }
   if (bgspath) {
     serv.log(Logger::SYSTEM, "snapshotting databases");
-    if (!dosnapshot(bgspath, bgscomp, dbs, dbnum, &serv)) err = true;
+    if (!dosnapshot(bgspath, bgscomp, dbs, dbnum, &serv, bgsm)) err = true;
   }
   delete[] scrprocs;
   for (int32_t i = 0; i < dbnum; i++) {
@@ -3237,10 +3366,11 @@ static int32_t proc(const std::vector<std::string>& dbpaths,
 
 // snapshot all databases
 static bool dosnapshot(const char* bgspath, kc::Compressor* bgscomp,
-                       kt::TimedDB* dbs, int32_t dbnum, kt::RPCServer* serv) {
+                       kt::TimedDB* dbs, int32_t dbnum, kt::RPCServer* serv, bool image) {
   bool err = false;
   for (int32_t i = 0; i < dbnum; i++) {
     kt::TimedDB* db = dbs + i;
+    if (image && dumpimage(bgspath, db, i, serv)) continue;
     std::string destpath;
     kc::strprintf(&destpath, "%s%c%08d%c%s",
                   bgspath, kc::File::PATHCHR, i, kc::File::EXTCHR, BGSPATHEXT);
@@ -3275,5 +3405,46 @@ static bool dosnapshot(const char* bgspath, kc::Compressor* bgscomp,
 }
 
 
+// dump the memory image of an on-memory database
+static bool dumpimage(const char* bgspath, kt::TimedDB* db, int32_t idx, kt::RPCServer* serv) {
+  kc::BasicDB* idb = db->reveal_inner_db();
+  kc::CacheDB* cdb = dynamic_cast<kc::CacheDB*>(idb);
+  kc::StashDB* sdb = dynamic_cast<kc::StashDB*>(idb);
+  if (!cdb && !sdb) return false;
+  std::string destpath;
+  kc::strprintf(&destpath, "%s%c%08d%c%s",
+                bgspath, kc::File::PATHCHR, idx, kc::File::EXTCHR, BGIPATHEXT);
+  std::string tmppath;
+  kc::strprintf(&tmppath, "%s%ctmp", destpath.c_str(), kc::File::EXTCHR);
+  bool ok = cdb ? cdb->dump_image(tmppath) : sdb->dump_image(tmppath);
+  if (!ok) {
+    const kc::BasicDB::Error& e = idb->error();
+    serv->log(Logger::ERROR, "could not dump a memory image: %s: %s", e.name(), e.message());
+    kc::File::remove(tmppath);
+    return false;
+  }
+  if (!kc::File::rename(tmppath, destpath)) {
+    serv->log(Logger::ERROR, "renaming a file failed: %s: %s",
+              tmppath.c_str(), destpath.c_str());
+    kc::File::remove(tmppath);
+    return false;
+  }
+  serv->log(Logger::SYSTEM, "dumped a memory image: db=%d count=%lld size=%lld",
+            idx, (long long)idb->count(), (long long)idb->size());
+  return true;
+}
+
+
+// load the memory image of an on-memory database
+static bool loadimage(const std::string& path, kt::TimedDB* db) {
+  kc::BasicDB* idb = db->reveal_inner_db();
+  kc::CacheDB* cdb = dynamic_cast<kc::CacheDB*>(idb);
+  if (cdb) return cdb->load_image(path);
+  kc::StashDB* sdb = dynamic_cast<kc::StashDB*>(idb);
+  if (sdb) return sdb->load_image(path);
+  return false;
+}
+
+
 
 // END OF FILE
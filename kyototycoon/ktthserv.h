@@ -147,6 +147,16 @@ class ThreadedServer {
       _assert_(true);
       return thid_;
     }
+    /**
+     * Set the NUMA node preferred to process the session.
+     * @param node the index of the node, or -1 for no preference.
+     * @note The next requests of the session are processed by the worker threads pinned to the
+     * node if the server is NUMA-aware.
+     */
+    void set_node(int32_t node) {
+      _assert_(true);
+      node_ = node;
+    }
     /**
      * Set the session local data.
      * @param data the session local data.  If it is NULL, no data is registered.
@@ -170,7 +180,7 @@ class ThreadedServer {
     /**
      * Default Constructor.
      */
-    explicit Session(uint64_t id) : id_(id), thid_(0), data_(NULL) {
+    explicit Session(uint64_t id) : id_(id), thid_(0), node_(-1), data_(NULL) {
       _assert_(true);
     }
     /**
@@ -185,6 +195,8 @@ class ThreadedServer {
     uint64_t id_;
     /** The ID number of the worker thread. */
     uint32_t thid_;
+    /** The preferred NUMA node. */
+    int32_t node_;
     /** The session local data. */
     Data* data_;
   };
@@ -193,7 +205,7 @@ class ThreadedServer {
    */
   explicit ThreadedServer() :
       run_(false), expr_(), timeout_(0), logger_(NULL), logkinds_(0), worker_(NULL), thnum_(0),
-      sock_(), poll_(), queue_(this), sesscnt_(0), idlesem_(0), timersem_(0) {
+      numa_(false), sock_(), poll_(), queues_(), sesscnt_(0), idlesem_(0), timersem_(0) {
     _assert_(true);
   }
   /**
@@ -234,6 +246,18 @@ class ThreadedServer {
     worker_ = worker;
     thnum_ = thnum;
   }
+  /**
+   * Set the NUMA awareness.
+   * @param numa true to divide the worker threads into pools pinned to each NUMA node, or false
+   * to share one pool.
+   * @note In the NUMA-aware mode, each session is processed by the pool of the node set by the
+   * Session::set_node method, or the pools in round robin if no node is set.  It has no effect
+   * on systems with a single node.
+   */
+  void set_numa(bool numa) {
+    _assert_(true);
+    numa_ = numa;
+  }
   /**
    * Start the service.
    * @return true on success, or false on failure.
@@ -270,8 +294,16 @@ class ThreadedServer {
       log(Logger::ERROR, "poller error: msg=%s", poll_.error());
       err = true;
     }
-    queue_.set_worker(worker_);
-    queue_.start(thnum_);
+    size_t qnum = numa_ ? kc::numanodes() : 1;
+    if (qnum > thnum_) qnum = thnum_;
+    if (qnum > 1) log(Logger::SYSTEM, "pinning workers to NUMA nodes: nodenum=%d", (int)qnum);
+    for (size_t i = 0; i < qnum; i++) {
+      size_t thbase = thnum_ * i / qnum;
+      TaskQueueImpl* queue = new TaskQueueImpl(this, qnum > 1 ? (int32_t)i : -1, thbase);
+      queue->set_worker(worker_);
+      queue->start(thnum_ * (i + 1) / qnum - thbase);
+      queues_.push_back(queue);
+    }
     uint32_t timercnt = 0;
     run_ = true;
     while (run_) {
@@ -300,20 +332,20 @@ class ThreadedServer {
           } else {
             Session* sess = (Session*)event;
             SessionTask* task = new SessionTask(sess);
-            queue_.add_task(task);
+            select_queue(sess)->add_task(task);
           }
         }
         timercnt++;
       } else {
-        if (queue_.count() < 1 && idlesem_.cas(0, 1)) {
+        if (task_count() < 1 && idlesem_.cas(0, 1)) {
           SessionTask* task = new SessionTask(SESSIDLE);
-          queue_.add_task(task);
+          queues_.front()->add_task(task);
         }
         timercnt += kc::UINT8MAX / 4;
       }
       if (timercnt > kc::UINT8MAX && timersem_.cas(0, 1)) {
         SessionTask* task = new SessionTask(SESSTIMER);
-        queue_.add_task(task);
+        queues_.front()->add_task(task);
         timercnt = 0;
       }
     }
@@ -346,11 +378,16 @@ class ThreadedServer {
       return false;
     }
     bool err = false;
-    queue_.finish();
-    if (queue_.error()) {
-      log(Logger::SYSTEM, "one or more errors were detected");
-      err = true;
+    for (size_t i = 0; i < queues_.size(); i++) {
+      TaskQueueImpl* queue = queues_[i];
+      queue->finish();
+      if (queue->error()) {
+        log(Logger::SYSTEM, "one or more errors were detected");
+        err = true;
+      }
+      delete queue;
     }
+    queues_.clear();
     if (poll_.flush()) {
       Pollable* event;
       while ((event = poll_.next()) != NULL) {
@@ -426,7 +463,11 @@ class ThreadedServer {
    */
   int64_t task_count() {
     _assert_(true);
-    return queue_.count();
+    int64_t sum = 0;
+    for (size_t i = 0; i < queues_.size(); i++) {
+      sum += queues_[i]->count();
+    }
+    return sum;
   }
   /**
    * Check whether the thread is to be aborted.
@@ -446,7 +487,8 @@ class ThreadedServer {
    */
   class TaskQueueImpl : public kc::TaskQueue {
    public:
-    explicit TaskQueueImpl(ThreadedServer* serv) : serv_(serv), worker_(NULL), err_(false) {
+    explicit TaskQueueImpl(ThreadedServer* serv, int32_t node, uint32_t thbase) :
+        serv_(serv), node_(node), thbase_(thbase), worker_(NULL), err_(false) {
       _assert_(true);
     }
     void set_worker(Worker* worker) {
@@ -473,7 +515,7 @@ class ThreadedServer {
         if (mytask->aborted()) {
           serv_->log(Logger::INFO, "aborted a request: expr=%s", sess->expression().c_str());
         } else {
-          sess->thid_ = mytask->thread_id();
+          sess->thid_ = thbase_ + mytask->thread_id();
           do {
             keep = worker_->process(serv_, sess);
           } while (keep && sess->left_size() > 0);
@@ -501,6 +543,8 @@ class ThreadedServer {
     }
     void do_start(const kc::TaskQueue::Task* task) {
       _assert_(task);
+      if (node_ >= 0 && !kc::Thread::bind_node(node_))
+        serv_->log(Logger::SYSTEM, "binding to a NUMA node failed: node=%d", (int)node_);
       worker_->process_start(serv_);
     }
     void do_finish(const kc::TaskQueue::Task* task) {
@@ -508,6 +552,8 @@ class ThreadedServer {
       worker_->process_finish(serv_);
     }
     ThreadedServer* serv_;
+    int32_t node_;
+    uint32_t thbase_;
     Worker* worker_;
     bool err_;
   };
@@ -521,6 +567,18 @@ class ThreadedServer {
    private:
     Session* sess_;
   };
+  /**
+   * Select the task queue to process a session.
+   * @param sess the session object.
+   * @return the task queue of the preferred node of the session.
+   */
+  TaskQueueImpl* select_queue(Session* sess) {
+    _assert_(sess);
+    size_t qnum = queues_.size();
+    if (qnum < 2) return queues_.front();
+    if (sess->node_ < 0) return queues_[sess->id_ % qnum];
+    return queues_[sess->node_ % qnum];
+  }
   /** Dummy constructor to forbid the use. */
   ThreadedServer(const ThreadedServer&);
   /** Dummy Operator to forbid the use. */
@@ -539,12 +597,14 @@ class ThreadedServer {
   Worker* worker_;
   /** The number of worker threads. */
   size_t thnum_;
+  /** The flag of NUMA awareness. */
+  bool numa_;
   /** The server socket. */
   ServerSocket sock_;
   /** The event poller. */
   Poller poll_;
-  /** The task queue. */
-  TaskQueueImpl queue_;
+  /** The task queues of NUMA nodes. */
+  std::vector<TaskQueueImpl*> queues_;
   /** The session count. */
   uint64_t sesscnt_;
   /** The idle event semaphore. */
@@ -44,6 +44,7 @@ class TimedDB {
   /** The maximum number of expiration time. */
   static const int64_t XTMAX = (1LL << (XTWIDTH * 8)) - 1;
  private:
+  class BatchTrigger;
   class TimedVisitor;
   class TimedMetaTrigger;
   struct MergeLine;
@@ -719,6 +720,20 @@ class TimedDB {
      * @param commit true to commit the transaction, or false to abort the transaction.
      */
     virtual void end_transaction(bool commit) = 0;
+    /**
+     * Trigger multiple update operations at once.
+     * @param mvec a string vector of the messages.
+     * @note The default implementation calls the UpdateTrigger::trigger method for each message.
+     */
+    virtual void trigger_bulk(const std::vector<std::string>& mvec) {
+      _assert_(true);
+      std::vector<std::string>::const_iterator it = mvec.begin();
+      std::vector<std::string>::const_iterator itend = mvec.end();
+      while (it != itend) {
+        trigger(it->data(), it->size());
+        ++it;
+      }
+    }
   };
   /**
    * Merge modes.
@@ -734,7 +749,7 @@ class TimedDB {
    */
   explicit TimedDB() :
       xlock_(), db_(), mtrigger_(this), utrigger_(NULL), omode_(0),
-      opts_(0), capcnt_(0), capsiz_(0), xcur_(NULL), xsc_(0) {
+      opts_(0), capcnt_(0), capsiz_(0), xcur_(NULL), xsc_(0), xnative_(false) {
     _assert_(true);
     db_.tune_meta_trigger(&mtrigger_);
   }
@@ -785,6 +800,9 @@ class TimedDB {
    * sets the capacity by database size.
    * @param mode the connection mode.  The same as with kc::PolyDB.
    * @return true on success, or false on failure.
+   * @note Unless the persistent option is set, the cache hash database and the stash database
+   * index expiration times of records in timer wheels and expired records are removed without
+   * scanning the database.
    */
   bool open(const std::string& path = ":",
             uint32_t mode = kc::BasicDB::OWRITER | kc::BasicDB::OCREATE) {
@@ -819,10 +837,15 @@ class TimedDB {
       }
       ++it;
     }
-    if (!db_.open(path, mode)) return false;
+    std::string rpath = path;
+    if (!(opts_ & TPERSIST)) kc::strprintf(&rpath, "#xtwidth=%d", (int)XTWIDTH);
+    if (!db_.open(rpath, mode)) return false;
+    xnative_ = false;
     kc::BasicDB* idb = db_.reveal_inner_db();
     if (idb) {
       const std::type_info& info = typeid(*idb);
+      if (info == typeid(kc::CacheDB) || info == typeid(kc::StashDB))
+        xnative_ = !(opts_ & TPERSIST);
       if (info == typeid(kc::HashDB)) {
         kc::HashDB* hdb = (kc::HashDB*)idb;
         char* opq = hdb->opaque();
@@ -1523,6 +1546,46 @@ class TimedDB {
     _assert_(true);
     return increment_double(key.c_str(), key.size(), num, orig, xt);
   }
+  /**
+   * Merge an operand into the value of a record.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param obuf the pointer to the operand region.
+   * @param osiz the size of the operand region.
+   * @param op the merge operator.
+   * @param xt the expiration time from now in seconds.  If it is negative, the absolute value
+   * is treated as the epoch time.
+   * @return true on success, or false on failure.
+   * @note If no record corresponds to the key or the record has expired, a new record is
+   * created with the operand merged into nothing.  If the operand can not be merged into the
+   * existing value, this function fails and the record is not modified.  If the operator is
+   * built in, the update log keeps the operand instead of the merged value, so that replicas
+   * apply the operator by themselves.  If the database is persistent and no update trigger is
+   * set, the operand is given to the inner database so that a MergeDB merges it lazily.
+   */
+  bool merge(const char* kbuf, size_t ksiz, const char* obuf, size_t osiz,
+             kc::MergeOperator* op, int64_t xt = kc::INT64MAX) {
+    _assert_(kbuf && ksiz <= kc::MEMMAXSIZ && obuf && osiz <= kc::MEMMAXSIZ && op);
+    if ((opts_ & TPERSIST) && !utrigger_) return db_.merge(kbuf, ksiz, obuf, osiz, op);
+    bool err = false;
+    MergeVisitor visitor(this, obuf, osiz, op, xt, std::time(NULL));
+    if (!db_.accept(kbuf, ksiz, &visitor, true)) err = true;
+    if (xcur_ && !expire_records(XTSCUNIT)) err = true;
+    if (!err && visitor.error()) {
+      set_error(kc::BasicDB::Error::LOGIC, "logical inconsistency");
+      err = true;
+    }
+    return !err;
+  }
+  /**
+   * Merge an operand into the value of a record.
+   * @note Equal to the original DB::merge method except that the parameters are std::string.
+   */
+  bool merge(const std::string& key, const std::string& operand, kc::MergeOperator* op,
+             int64_t xt = kc::INT64MAX) {
+    _assert_(op);
+    return merge(key.c_str(), key.size(), operand.c_str(), operand.size(), op, xt);
+  }
   /**
    * Perform compare-and-swap.
    * @param kbuf the pointer to the key region.
@@ -1927,42 +1990,15 @@ class TimedDB {
                    int64_t xt = kc::INT64MAX, bool atomic = true) {
     _assert_(true);
     if (atomic) {
-      std::vector<std::string> keys;
-      keys.reserve(recs.size());
+      kc::BasicDB::WriteBatch batch;
       std::map<std::string, std::string>::const_iterator rit = recs.begin();
       std::map<std::string, std::string>::const_iterator ritend = recs.end();
       while (rit != ritend) {
-        keys.push_back(rit->first);
+        batch.set(rit->first, rit->second);
         ++rit;
       }
-      class VisitorImpl : public Visitor {
-       public:
-        explicit VisitorImpl(const std::map<std::string, std::string>& recs, int64_t xt) :
-            recs_(recs), xt_(xt) {}
-       private:
-        const char* visit_full(const char* kbuf, size_t ksiz,
-                               const char* vbuf, size_t vsiz, size_t* sp, int64_t* xtp) {
-          std::map<std::string, std::string>::const_iterator rit =
-              recs_.find(std::string(kbuf, ksiz));
-          if (rit == recs_.end()) return NOP;
-          *sp = rit->second.size();
-          *xtp = xt_;
-          return rit->second.data();
-        }
-        const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp, int64_t* xtp) {
-          std::map<std::string, std::string>::const_iterator rit =
-              recs_.find(std::string(kbuf, ksiz));
-          if (rit == recs_.end()) return NOP;
-          *sp = rit->second.size();
-          *xtp = xt_;
-          return rit->second.data();
-        }
-        const std::map<std::string, std::string>& recs_;
-        int64_t xt_;
-      };
-      VisitorImpl visitor(recs, xt);
-      if (!accept_bulk(keys, &visitor, true)) return -1;
-      return keys.size();
+      if (write_batch(batch, xt) < 0) return -1;
+      return recs.size();
     }
     std::map<std::string, std::string>::const_iterator rit = recs.begin();
     std::map<std::string, std::string>::const_iterator ritend = recs.end();
@@ -1982,26 +2018,14 @@ class TimedDB {
   int64_t remove_bulk(const std::vector<std::string>& keys, bool atomic = true) {
     _assert_(true);
     if (atomic) {
-      class VisitorImpl : public Visitor {
-       public:
-        explicit VisitorImpl() : cnt_(0) {}
-        int64_t cnt() const {
-          return cnt_;
-        }
-       private:
-        const char* visit_full(const char* kbuf, size_t ksiz,
-                               const char* vbuf, size_t vsiz, size_t* sp, int64_t* xtp) {
-          cnt_++;
-          return REMOVE;
-        }
-        const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp, int64_t* xtp) {
-          return REMOVE;
-        }
-        int64_t cnt_;
-      };
-      VisitorImpl visitor;
-      if (!accept_bulk(keys, &visitor, true)) return -1;
-      return visitor.cnt();
+      kc::BasicDB::WriteBatch batch;
+      std::vector<std::string>::const_iterator kit = keys.begin();
+      std::vector<std::string>::const_iterator kitend = keys.end();
+      while (kit != kitend) {
+        batch.remove(*kit);
+        ++kit;
+      }
+      return write_batch(batch);
     }
     int64_t cnt = 0;
     std::vector<std::string>::const_iterator kit = keys.begin();
@@ -2057,6 +2081,81 @@ class TimedDB {
     }
     return recs->size();
   }
+  /**
+   * Apply a batch of updating operations at once.
+   * @param batch the batch of operations.
+   * @param xt the expiration time of the set records from now in seconds.  If it is negative,
+   * the absolute value is treated as the epoch time.
+   * @return the number of changed records, or -1 on failure.
+   * @note All target records are locked in one pass and the update log of them is passed to
+   * the update trigger at once.  See kyotocabinet::BasicDB::write_batch for the semantics.
+   */
+  int64_t write_batch(const kc::BasicDB::WriteBatch& batch, int64_t xt = kc::INT64MAX) {
+    _assert_(true);
+    std::vector<std::string> keys;
+    batch.keys(&keys);
+    class VisitorImpl : public Visitor {
+     public:
+      explicit VisitorImpl(const kc::BasicDB::WriteBatch& batch, int64_t xt) :
+          batch_(batch), xt_(xt), rbuf_(), cnt_(0), fail_(false) {}
+      int64_t cnt() const {
+        return cnt_;
+      }
+      bool fail() const {
+        return fail_;
+      }
+     private:
+      const char* visit_full(const char* kbuf, size_t ksiz,
+                             const char* vbuf, size_t vsiz, size_t* sp, int64_t* xtp) {
+        return replay(kbuf, ksiz, vbuf, vsiz, sp, xtp);
+      }
+      const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp, int64_t* xtp) {
+        return replay(kbuf, ksiz, NULL, 0, sp, xtp);
+      }
+      const char* replay(const char* kbuf, size_t ksiz, const char* vbuf, size_t vsiz,
+                         size_t* sp, int64_t* xtp) {
+        switch (batch_.replay(kbuf, ksiz, vbuf, vsiz, &rbuf_)) {
+          case kc::BasicDB::WriteBatch::RSET: {
+            cnt_++;
+            *sp = rbuf_.size();
+            *xtp = xt_;
+            return rbuf_.data();
+          }
+          case kc::BasicDB::WriteBatch::RREMOVE: {
+            cnt_++;
+            return REMOVE;
+          }
+          case kc::BasicDB::WriteBatch::RFAIL: {
+            fail_ = true;
+            break;
+          }
+          default: {
+            break;
+          }
+        }
+        return NOP;
+      }
+      const kc::BasicDB::WriteBatch& batch_;
+      int64_t xt_;
+      std::string rbuf_;
+      int64_t cnt_;
+      bool fail_;
+    };
+    VisitorImpl visitor(batch, xt);
+    bool err = false;
+    int64_t ct = std::time(NULL);
+    BatchTrigger btrigger(utrigger_, keys.size());
+    TimedVisitor myvisitor(this, &visitor, ct, false, utrigger_ ? &btrigger : NULL);
+    if (!db_.accept_bulk(keys, &myvisitor, true)) err = true;
+    btrigger.flush();
+    if (xcur_ && !expire_records(XTSCUNIT)) err = true;
+    if (err) return -1;
+    if (visitor.fail()) {
+      set_error(kc::BasicDB::Error::LOGIC, "logical inconsistency");
+      return -1;
+    }
+    return visitor.cnt();
+  }
   /**
    * Dump records into a data stream.
    * @param dest the destination stream.
@@ -2123,6 +2222,21 @@ class TimedDB {
     _assert_(true);
     return db_.reveal_inner_db();
   }
+  /**
+   * Get the NUMA node of a record in the inner database.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @return the index of the node, or -1 if the inner database is not bound to NUMA nodes.
+   */
+  int32_t numa_node(const char* kbuf, size_t ksiz) {
+    _assert_(kbuf && ksiz <= kc::MEMMAXSIZ);
+    kc::BasicDB* idb = db_.reveal_inner_db();
+    if (!idb) return -1;
+    const std::type_info& info = typeid(*idb);
+    if (info == typeid(kc::CacheDB)) return ((kc::CacheDB*)idb)->numa_node(kbuf, ksiz);
+    if (info == typeid(kc::StashDB)) return ((kc::StashDB*)idb)->numa_node(kbuf, ksiz);
+    return -1;
+  }
   /**
    * Scan the database and eliminate regions of expired records.
    * @param step the number of steps.  If it is not more than 0, the whole region is scanned.
@@ -2145,6 +2259,38 @@ class TimedDB {
     if (!defrag(step)) err = true;
     return !err;
   }
+  /**
+   * Remove all records whose expiration time has come.
+   * @return true on success, or false on failure.
+   * @note If the inner database indexes expiration times in timer wheels, this function checks
+   * the deadline of the wheels and removes every expired record without scanning the database.
+   * Otherwise, it does nothing.  Because it is cheap while nothing is due, it can be called by
+   * a timer to reclaim expired records while no update is performed.
+   */
+  bool expire_due() {
+    _assert_(true);
+    if (omode_ == 0) {
+      set_error(kc::BasicDB::Error::INVALID, "not opened");
+      return false;
+    }
+    if (!xnative_ || !(omode_ & kc::BasicDB::OWRITER)) return true;
+    int64_t dl = kc::INT64MAX;
+    kc::BasicDB* idb = db_.reveal_inner_db();
+    if (idb) {
+      const std::type_info& info = typeid(*idb);
+      if (info == typeid(kc::CacheDB)) {
+        dl = ((kc::CacheDB*)idb)->expiration_deadline();
+      } else if (info == typeid(kc::StashDB)) {
+        dl = ((kc::StashDB*)idb)->expiration_deadline();
+      }
+    }
+    if (dl < 0) return false;
+    if (std::time(NULL) < dl) return true;
+    if (!xlock_.lock_try()) return true;
+    bool err = !expire_native(kc::INT64MAX);
+    xlock_.unlock();
+    return !err;
+  }
   /**
    * Recover the database with an update log message.
    * @param mbuf the pointer to the message region.
@@ -2203,6 +2349,38 @@ class TimedDB {
         if (utrigger_) log_update(utrigger_, kbuf, ksiz, TimedVisitor::REMOVE, 0);
         break;
       }
+      case UMERGE: {
+        if (msiz < 3 + (size_t)XTWIDTH) {
+          set_error(kc::BasicDB::Error::INVALID, "invalid message format");
+          return false;
+        }
+        uint64_t id;
+        size_t step = kc::readvarnum(rp, msiz, &id);
+        rp += step;
+        msiz -= step;
+        uint64_t ksiz;
+        step = kc::readvarnum(rp, msiz, &ksiz);
+        rp += step;
+        msiz -= step;
+        uint64_t osiz;
+        step = kc::readvarnum(rp, msiz, &osiz);
+        rp += step;
+        msiz -= step;
+        if (msiz != XTWIDTH + ksiz + osiz) {
+          set_error(kc::BasicDB::Error::INVALID, "invalid message format");
+          return false;
+        }
+        int64_t xt = kc::readfixnum(rp, XTWIDTH);
+        const char* kbuf = rp + XTWIDTH;
+        const char* obuf = kbuf + ksiz;
+        kc::MergeOperator* mop = kc::MergeDB::builtin_operator(id);
+        if (!mop) {
+          set_error(kc::BasicDB::Error::INVALID, "unknown merge operator");
+          return false;
+        }
+        if (!merge(kbuf, ksiz, obuf, osiz, mop, -xt)) err = true;
+        break;
+      }
       case UCLEAR: {
         if (msiz != 0) {
           set_error(kc::BasicDB::Error::INVALID, "invalid message format");
@@ -2470,15 +2648,52 @@ class TimedDB {
     UBEGINTRAN,                          ///< beginning transaction
     UCOMMITTRAN,                         ///< committing transaction
     UABORTTRAN,                          ///< aborting transaction
+    UMERGE,                              ///< merging an operand
     UUNKNOWN                             ///< unknown operation
   };
+  /**
+   * Trigger to gather the update operations of a batch.
+   */
+  class BatchTrigger : public UpdateTrigger {
+   public:
+    BatchTrigger(UpdateTrigger* utrigger, int64_t rnum) :
+        utrigger_(utrigger), mvec_(), rest_(rnum) {
+      _assert_(rnum >= 0);
+    }
+    void visited() {
+      _assert_(true);
+      if (--rest_ < 1) flush();
+    }
+    void flush() {
+      _assert_(true);
+      if (mvec_.empty()) return;
+      if (utrigger_) utrigger_->trigger_bulk(mvec_);
+      mvec_.clear();
+    }
+   private:
+    void trigger(const char* mbuf, size_t msiz) {
+      _assert_(mbuf);
+      mvec_.push_back(std::string(mbuf, msiz));
+    }
+    void begin_transaction() {
+      _assert_(true);
+    }
+    void end_transaction(bool commit) {
+      _assert_(true);
+    }
+    UpdateTrigger* utrigger_;
+    std::vector<std::string> mvec_;
+    int64_t rest_;
+  };
   /**
    * Visitor to handle records with time stamps.
    */
   class TimedVisitor : public kc::BasicDB::Visitor {
    public:
-    TimedVisitor(TimedDB* db, TimedDB::Visitor* visitor, int64_t ct, bool isiter) :
-        db_(db), visitor_(visitor), ct_(ct), isiter_(isiter), jbuf_(NULL), again_(false) {
+    TimedVisitor(TimedDB* db, TimedDB::Visitor* visitor, int64_t ct, bool isiter,
+                 BatchTrigger* btrigger = NULL) :
+        db_(db), visitor_(visitor), ct_(ct), isiter_(isiter), jbuf_(NULL), again_(false),
+        utrigger_(btrigger ? btrigger : db->utrigger_), btrigger_(btrigger) {
       _assert_(db && visitor && ct >= 0);
     }
     ~TimedVisitor() {
@@ -2493,12 +2708,25 @@ class TimedDB {
     const char* visit_full(const char* kbuf, size_t ksiz,
                            const char* vbuf, size_t vsiz, size_t* sp) {
       _assert_(kbuf && vbuf && sp);
+      const char* rbuf = visit_full_impl(kbuf, ksiz, vbuf, vsiz, sp);
+      if (btrigger_) btrigger_->visited();
+      return rbuf;
+    }
+    const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
+      _assert_(kbuf && sp);
+      const char* rbuf = visit_empty_impl(kbuf, ksiz, sp);
+      if (btrigger_) btrigger_->visited();
+      return rbuf;
+    }
+    const char* visit_full_impl(const char* kbuf, size_t ksiz,
+                                const char* vbuf, size_t vsiz, size_t* sp) {
+      _assert_(kbuf && vbuf && sp);
       if (db_->opts_ & TimedDB::TPERSIST) {
         size_t rsiz;
         int64_t xt = kc::INT64MAX;
         const char* rbuf = visitor_->visit_full(kbuf, ksiz, vbuf, vsiz, &rsiz, &xt);
         *sp = rsiz;
-        if (db_->utrigger_) log_update(db_->utrigger_, kbuf, ksiz, rbuf, rsiz);
+        if (utrigger_) log_update(utrigger_, kbuf, ksiz, rbuf, rsiz);
         return rbuf;
       }
       if (vsiz < (size_t)XTWIDTH) return NOP;
@@ -2513,7 +2741,7 @@ class TimedDB {
         const char* rbuf = visitor_->visit_empty(kbuf, ksiz, &rsiz, &xt);
         if (rbuf == TimedDB::Visitor::NOP) return NOP;
         if (rbuf == TimedDB::Visitor::REMOVE) {
-          if (db_->utrigger_) log_update(db_->utrigger_, kbuf, ksiz, REMOVE, 0);
+          if (utrigger_) log_update(utrigger_, kbuf, ksiz, REMOVE, 0);
           return REMOVE;
         }
         delete[] jbuf_;
@@ -2521,7 +2749,7 @@ class TimedDB {
         size_t jsiz;
         jbuf_ = make_record_value(rbuf, rsiz, xt, &jsiz);
         *sp = jsiz;
-        if (db_->utrigger_) log_update(db_->utrigger_, kbuf, ksiz, jbuf_, jsiz);
+        if (utrigger_) log_update(utrigger_, kbuf, ksiz, jbuf_, jsiz);
         return jbuf_;
       }
       vbuf += XTWIDTH;
@@ -2530,7 +2758,7 @@ class TimedDB {
       const char* rbuf = visitor_->visit_full(kbuf, ksiz, vbuf, vsiz, &rsiz, &xt);
       if (rbuf == TimedDB::Visitor::NOP) return NOP;
       if (rbuf == TimedDB::Visitor::REMOVE) {
-        if (db_->utrigger_) log_update(db_->utrigger_, kbuf, ksiz, REMOVE, 0);
+        if (utrigger_) log_update(utrigger_, kbuf, ksiz, REMOVE, 0);
         return REMOVE;
       }
       delete[] jbuf_;
@@ -2538,16 +2766,17 @@ class TimedDB {
       size_t jsiz;
       jbuf_ = make_record_value(rbuf, rsiz, xt, &jsiz);
       *sp = jsiz;
-      if (db_->utrigger_) log_update(db_->utrigger_, kbuf, ksiz, jbuf_, jsiz);
+      if (utrigger_) log_update(utrigger_, kbuf, ksiz, jbuf_, jsiz);
       return jbuf_;
     }
-    const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
+    const char* visit_empty_impl(const char* kbuf, size_t ksiz, size_t* sp) {
+      _assert_(kbuf && sp);
       if (db_->opts_ & TimedDB::TPERSIST) {
         size_t rsiz;
         int64_t xt = kc::INT64MAX;
         const char* rbuf = visitor_->visit_empty(kbuf, ksiz, &rsiz, &xt);
         *sp = rsiz;
-        if (db_->utrigger_) log_update(db_->utrigger_, kbuf, ksiz, rbuf, rsiz);
+        if (utrigger_) log_update(utrigger_, kbuf, ksiz, rbuf, rsiz);
         return rbuf;
       }
       size_t rsiz;
@@ -2555,7 +2784,7 @@ class TimedDB {
       const char* rbuf = visitor_->visit_empty(kbuf, ksiz, &rsiz, &xt);
       if (rbuf == TimedDB::Visitor::NOP) return NOP;
       if (rbuf == TimedDB::Visitor::REMOVE) {
-        if (db_->utrigger_) log_update(db_->utrigger_, kbuf, ksiz, REMOVE, 0);
+        if (utrigger_) log_update(utrigger_, kbuf, ksiz, REMOVE, 0);
         return REMOVE;
       }
       delete[] jbuf_;
@@ -2563,7 +2792,7 @@ class TimedDB {
       size_t jsiz;
       jbuf_ = make_record_value(rbuf, rsiz, xt, &jsiz);
       *sp = jsiz;
-      if (db_->utrigger_) log_update(db_->utrigger_, kbuf, ksiz, jbuf_, jsiz);
+      if (utrigger_) log_update(utrigger_, kbuf, ksiz, jbuf_, jsiz);
       return jbuf_;
     }
     void visit_before() {
@@ -2580,6 +2809,84 @@ class TimedDB {
     bool isiter_;
     char* jbuf_;
     bool again_;
+    UpdateTrigger* utrigger_;
+    BatchTrigger* btrigger_;
+  };
+  /**
+   * Visitor to merge an operand into a record with a time stamp.
+   */
+  class MergeVisitor : public kc::BasicDB::Visitor {
+   public:
+    MergeVisitor(TimedDB* db, const char* obuf, size_t osiz, kc::MergeOperator* op,
+                 int64_t xt, int64_t ct) :
+        db_(db), obuf_(obuf), osiz_(osiz), op_(op), xt_(xt), ct_(ct),
+        nbuf_(NULL), jbuf_(NULL), err_(false) {
+      _assert_(db && obuf && op && ct >= 0);
+    }
+    ~MergeVisitor() {
+      _assert_(true);
+      delete[] nbuf_;
+      delete[] jbuf_;
+    }
+    bool error() {
+      _assert_(true);
+      return err_;
+    }
+   private:
+    const char* visit_full(const char* kbuf, size_t ksiz,
+                           const char* vbuf, size_t vsiz, size_t* sp) {
+      _assert_(kbuf && vbuf && sp);
+      if (!(db_->opts_ & TimedDB::TPERSIST)) {
+        if (vsiz < (size_t)XTWIDTH) {
+          err_ = true;
+          return NOP;
+        }
+        if (ct_ > kc::readfixnum(vbuf, XTWIDTH)) return merge_value(kbuf, ksiz, NULL, 0, sp);
+        vbuf += XTWIDTH;
+        vsiz -= XTWIDTH;
+      }
+      return merge_value(kbuf, ksiz, vbuf, vsiz, sp);
+    }
+    const char* visit_empty(const char* kbuf, size_t ksiz, size_t* sp) {
+      _assert_(kbuf && sp);
+      return merge_value(kbuf, ksiz, NULL, 0, sp);
+    }
+    const char* merge_value(const char* kbuf, size_t ksiz,
+                            const char* vbuf, size_t vsiz, size_t* sp) {
+      _assert_(kbuf && sp);
+      size_t rsiz;
+      nbuf_ = op_->merge(vbuf, vsiz, obuf_, osiz_, &rsiz);
+      if (!nbuf_) {
+        err_ = true;
+        return NOP;
+      }
+      const char* rbuf = nbuf_;
+      int64_t xt = modify_exptime(xt_, ct_);
+      if (!(db_->opts_ & TimedDB::TPERSIST)) {
+        jbuf_ = make_record_value(nbuf_, rsiz, xt, &rsiz);
+        rbuf = jbuf_;
+      }
+      UpdateTrigger* utrigger = db_->utrigger_;
+      if (utrigger) {
+        int32_t id = kc::MergeDB::builtin_id(op_);
+        if (id > 0) {
+          log_merge(utrigger, id, kbuf, ksiz, obuf_, osiz_, xt);
+        } else {
+          log_update(utrigger, kbuf, ksiz, rbuf, rsiz);
+        }
+      }
+      *sp = rsiz;
+      return rbuf;
+    }
+    TimedDB* db_;
+    const char* obuf_;
+    size_t osiz_;
+    kc::MergeOperator* op_;
+    int64_t xt_;
+    int64_t ct_;
+    char* nbuf_;
+    char* jbuf_;
+    bool err_;
   };
   /**
    * Trigger of meta database operations.
@@ -2663,7 +2970,12 @@ class TimedDB {
     };
     VisitorImpl visitor(ct);
     bool err = false;
-    for (int64_t i = 0; i < step; i++) {
+    int64_t sweep = step;
+    if (xnative_) {
+      if (!expire_native(step)) err = true;
+      sweep = 0;
+    }
+    for (int64_t i = 0; i < sweep; i++) {
       if (!xcur_->accept(&visitor, true, true)) {
         kc::BasicDB::Error::Code code = db_.error().code();
         if (code == kc::BasicDB::Error::INVALID || code == kc::BasicDB::Error::NOREC) {
@@ -2711,6 +3023,27 @@ class TimedDB {
     xlock_.unlock();
     return !err;
   }
+  /**
+   * Remove expired records by the timer wheel of the inner database.
+   * @param step the maximum number of records to be removed.
+   * @return true on success, or false on failure.
+   */
+  bool expire_native(int64_t step) {
+    _assert_(true);
+    bool err = false;
+    kc::BasicDB* idb = db_.reveal_inner_db();
+    if (idb) {
+      const std::type_info& info = typeid(*idb);
+      if (info == typeid(kc::CacheDB)) {
+        kc::CacheDB* cdb = (kc::CacheDB*)idb;
+        if (!cdb->expire_records(step)) err = true;
+      } else if (info == typeid(kc::StashDB)) {
+        kc::StashDB* sdb = (kc::StashDB*)idb;
+        if (!sdb->expire_records(step)) err = true;
+      }
+    }
+    return !err;
+  }
   /**
    * Perform defragmentation of the database file.
    * @param step the number of steps.  If it is not more than 0, the whole region is defraged.
@@ -2728,6 +3061,9 @@ class TimedDB {
       } else if (info == typeid(kc::TreeDB)) {
         kc::TreeDB* tdb = (kc::TreeDB*)idb;
         if (!tdb->defrag(step)) err = true;
+      } else if (info == typeid(kc::MergeDB)) {
+        kc::MergeDB* mdb = (kc::MergeDB*)idb;
+        if (!mdb->defrag(step)) err = true;
       }
     }
     return !err;
@@ -2806,6 +3142,36 @@ class TimedDB {
       if (mbuf != stack) delete[] mbuf;
     }
   }
+  /**
+   * Log a merge operation.
+   * @param utrigger the update trigger.
+   * @param id the identifier of the built-in merge operator.
+   * @param kbuf the pointer to the key region.
+   * @param ksiz the size of the key region.
+   * @param obuf the pointer to the operand region.
+   * @param osiz the size of the operand region.
+   * @param xt the absolute expiration time.
+   */
+  static void log_merge(UpdateTrigger* utrigger, int32_t id, const char* kbuf, size_t ksiz,
+                        const char* obuf, size_t osiz, int64_t xt) {
+    _assert_(utrigger && id > 0 && kbuf && obuf);
+    size_t msiz = 1 + sizeof(uint64_t) * 3 + XTWIDTH + ksiz + osiz;
+    char stack[LOGBUFSIZ];
+    char* mbuf = msiz > sizeof(stack) ? new char[msiz] : stack;
+    char* wp = mbuf;
+    *(wp++) = UMERGE;
+    wp += kc::writevarnum(wp, id);
+    wp += kc::writevarnum(wp, ksiz);
+    wp += kc::writevarnum(wp, osiz);
+    kc::writefixnum(wp, xt, XTWIDTH);
+    wp += XTWIDTH;
+    std::memcpy(wp, kbuf, ksiz);
+    wp += ksiz;
+    std::memcpy(wp, obuf, osiz);
+    wp += osiz;
+    utrigger->trigger(mbuf, wp - mbuf);
+    if (mbuf != stack) delete[] mbuf;
+  }
   /** Dummy constructor to forbid the use. */
   TimedDB(const TimedDB&);
   /** Dummy Operator to forbid the use. */
@@ -2830,6 +3196,8 @@ class TimedDB {
   kc::PolyDB::Cursor* xcur_;
   /** The score of expiration. */
   kc::AtomicInt64 xsc_;
+  /** The flag whether expiration is performed by the inner database. */
+  bool xnative_;
 };
 
 
@@ -1856,6 +1856,10 @@ static int32_t procrecover(const char* path, const char* dir, int32_t oflags,
         err = true;
       }
       delete[] mbuf;
+    } else if (ulrd.error()) {
+      dberrprint(&db, "UpdateLogger::Reader::read failed");
+      err = true;
+      break;
     } else {
       break;
     }
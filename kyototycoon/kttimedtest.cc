@@ -2700,6 +2700,102 @@ static int32_t procmisc(const char* path) {
     dberrprint(db, __LINE__, "DB::scan_parallel ss");
     err = true;
   }
+  oprintf("expiring records:\n");
+  int64_t ocount = db->count();
+  for (int64_t i = 1; !err && i <= rnum; i++) {
+    char kbuf[RECBUFSIZ];
+    size_t ksiz = std::sprintf(kbuf, "x%08lld", (long long)i);
+    if (!db->set(kbuf, ksiz, kbuf, ksiz, -1)) {
+      dberrprint(db, __LINE__, "DB::set");
+      err = true;
+    }
+  }
+  if (!db->vacuum()) {
+    dberrprint(db, __LINE__, "DB::vacuum");
+    err = true;
+  }
+  if (db->count() != ocount) {
+    dberrprint(db, __LINE__, "DB::vacuum");
+    err = true;
+  }
+  oprintf("expiring records by the deadline:\n");
+  ocount = db->count();
+  int64_t xt = std::time(NULL);
+  for (int64_t i = 1; !err && i <= 100; i++) {
+    char kbuf[RECBUFSIZ];
+    size_t ksiz = std::sprintf(kbuf, "y%08lld", (long long)i);
+    if (!db->set(kbuf, ksiz, kbuf, ksiz, -xt)) {
+      dberrprint(db, __LINE__, "DB::set");
+      err = true;
+    }
+  }
+  while (std::time(NULL) <= xt) {
+    kc::Thread::sleep(0.1);
+  }
+  if (!db->expire_due()) {
+    dberrprint(db, __LINE__, "DB::expire_due");
+    err = true;
+  }
+  kc::BasicDB* idb = db->reveal_inner_db();
+  if (idb && (typeid(*idb) == typeid(kc::CacheDB) || typeid(*idb) == typeid(kc::StashDB)) &&
+      db->count() > ocount) {
+    dberrprint(db, __LINE__, "DB::expire_due");
+    err = true;
+  }
+  oprintf("replaying merge operations:\n");
+  class UpdateTriggerImpl : public kt::TimedDB::UpdateTrigger {
+   public:
+    explicit UpdateTriggerImpl() : mvec_() {}
+    const std::vector<std::string>& messages() {
+      return mvec_;
+    }
+   private:
+    void trigger(const char* mbuf, size_t msiz) {
+      mvec_.push_back(std::string(mbuf, msiz));
+    }
+    void begin_transaction() {}
+    void end_transaction(bool commit) {}
+    std::vector<std::string> mvec_;
+  } utrigger;
+  kt::TimedDB mdb;
+  kt::TimedDB rdb;
+  if (!mdb.tune_update_trigger(&utrigger) ||
+      !mdb.open(":", kc::BasicDB::OWRITER | kc::BasicDB::OCREATE) ||
+      !rdb.open(":", kc::BasicDB::OWRITER | kc::BasicDB::OCREATE)) {
+    dberrprint(&mdb, __LINE__, "DB::open");
+    err = true;
+  }
+  if (rdb.increment("merge:int", 100) != 100 || !rdb.set("merge:append", "x")) {
+    dberrprint(&rdb, __LINE__, "DB::set");
+    err = true;
+  }
+  for (int32_t i = 1; !err && i <= 10; i++) {
+    char obuf[sizeof(int64_t)];
+    kc::writefixnum(obuf, i, sizeof(obuf));
+    const std::string& istr = kc::strprintf("%d", i % 7);
+    if (!mdb.merge("merge:int", 9, obuf, sizeof(obuf), kc::INTADDMERGE) ||
+        !mdb.merge("merge:append", istr, kc::APPENDMERGE)) {
+      dberrprint(&mdb, __LINE__, "DB::merge");
+      err = true;
+    }
+  }
+  const std::vector<std::string>& mvec = utrigger.messages();
+  for (size_t i = 0; !err && i < mvec.size(); i++) {
+    if (!rdb.recover(mvec[i].data(), mvec[i].size())) {
+      dberrprint(&rdb, __LINE__, "DB::recover");
+      err = true;
+    }
+  }
+  std::string value;
+  if (mdb.increment("merge:int", 0) != 55 || rdb.increment("merge:int", 0) != 155 ||
+      !rdb.get("merge:append", &value) || value != "x1234560123") {
+    dberrprint(&rdb, __LINE__, "DB::recover");
+    err = true;
+  }
+  if (!mdb.close() || !rdb.close()) {
+    dberrprint(&mdb, __LINE__, "DB::close");
+    err = true;
+  }
   oprintf("deleting the database object:\n");
   delete db;
   oprintf("deleting the cursor objects:\n");
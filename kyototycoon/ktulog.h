@@ -58,7 +58,7 @@ class UpdateLogger {
     /**
      * Default constructor.
      */
-    explicit Reader() : ulog_(NULL), ts_(0), id_(0), file_(), off_(0) {
+    explicit Reader() : ulog_(NULL), ts_(0), id_(0), file_(), off_(0), error_(false) {
       _assert_(true);
     }
     /**
@@ -144,9 +144,12 @@ class UpdateLogger {
      * @return the pointer to the region of the message, or NULL on failure.  Because the region
      * of the return value is allocated with the the new[] operator, it should be released with
      * the delete[] operator when it is no longer in use.
+     * @note NULL is returned both at the end of the logs and when a message is broken.  Call
+     * the error method to tell the two cases apart.
      */
     char* read(size_t* sp, uint64_t* tsp) {
       _assert_(sp && tsp);
+      error_ = false;
       if (!ulog_) return NULL;
       ulog_->flock_.lock_reader();
       char* mbuf = read_impl(sp, tsp);
@@ -156,8 +159,22 @@ class UpdateLogger {
         delete[] mbuf;
         return NULL;
       }
+      if (ulog_->comp_) {
+        char* zbuf = ulog_->comp_->decompress(mbuf, *sp, sp);
+        delete[] mbuf;
+        if (!zbuf) error_ = true;
+        mbuf = zbuf;
+      }
       return mbuf;
     }
+    /**
+     * Check whether the last reading failed on a broken message.
+     * @return true if the message could not be decompressed, or false if not.
+     */
+    bool error() {
+      _assert_(true);
+      return error_;
+    }
    private:
     /**
      * Read the meta data.
@@ -271,6 +288,8 @@ class UpdateLogger {
     kc::File file_;
     /** The current offset. */
     int64_t off_;
+    /** The flag whether the last message was broken. */
+    bool error_;
   };
   /**
    * Status of each log file.
@@ -286,7 +305,7 @@ class UpdateLogger {
   explicit UpdateLogger() :
       path_(), limsiz_(0), asi_(0), id_(0), file_(),
       cache_(), csiz_(0), cts_(0), clock_(), flock_(), tslock_(),
-      flusher_(this), tswall_(0), tslogic_(0) {
+      flusher_(this), tswall_(0), tslogic_(0), comp_(NULL) {
     _assert_(true);
   }
   /**
@@ -360,6 +379,16 @@ class UpdateLogger {
     flusher_.start();
     return true;
   }
+  /**
+   * Set the data compressor of log messages.
+   * @param comp the data compressor object.
+   * @note It should be called before the logger is opened.  Readers decompress log messages
+   * with the same compressor.
+   */
+  void tune_compressor(kc::Compressor* comp) {
+    _assert_(comp);
+    comp_ = comp;
+  }
   /**
    * Close the logger.
    * @return true on success, or false on failure.
@@ -402,6 +431,12 @@ class UpdateLogger {
   bool write_volatile(char* mbuf, size_t msiz, uint64_t ts = 0) {
     _assert_(mbuf && msiz <= kc::MEMMAXSIZ);
     if (path_.empty()) return false;
+    if (comp_) {
+      char* zbuf = comp_->compress(mbuf, msiz, &msiz);
+      delete[] mbuf;
+      if (!zbuf) return false;
+      mbuf = zbuf;
+    }
     kc::ScopedSpinLock lock(&clock_);
     if (ts < 1) ts = clock_impl();
     bool err = false;
@@ -427,8 +462,18 @@ class UpdateLogger {
     std::vector<std::string>::const_iterator itend = mvec.end();
     while (it != itend) {
       size_t msiz = it->size();
-      char* mbuf = new char[msiz];
-      std::memcpy(mbuf, it->data(), msiz);
+      char* mbuf;
+      if (comp_) {
+        mbuf = comp_->compress(it->data(), msiz, &msiz);
+        if (!mbuf) {
+          err = true;
+          ++it;
+          continue;
+        }
+      } else {
+        mbuf = new char[msiz];
+        std::memcpy(mbuf, it->data(), msiz);
+      }
       uint64_t mts = ts > 0 ? ts : clock_impl();
       Log log = { mbuf, msiz, mts };
       cache_.push_back(log);
@@ -689,6 +734,8 @@ class UpdateLogger {
   uint64_t tswall_;
   /** The logical time stamp. */
   uint64_t tslogic_;
+  /** The data compressor. */
+  kc::Compressor* comp_;
 };
 
 
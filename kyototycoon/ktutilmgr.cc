@@ -515,6 +515,10 @@ static int32_t proculog(const char* path, uint64_t ts, bool uw, bool uf) {
         printdata(mbuf, msiz, true);
         oprintf("\n");
         delete[] mbuf;
+      } else if (ulrd.error()) {
+        eprintf("%s: reading a broken message failed\n", g_progname);
+        err = true;
+        break;
       } else if (uw) {
         kc::Thread::sleep(0.1);
       } else {
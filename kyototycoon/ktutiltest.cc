@@ -36,7 +36,8 @@ static int32_t prochttp(const char* url, int64_t rnum, int32_t thnum,
 static int32_t procrpc(const char* proc, int64_t rnum,
                        std::map<std::string, std::string>* params, int32_t thnum,
                        const char* host, int32_t port, double tout);
-static int32_t proculog(const char* path, int64_t rnum, int32_t thnum, int64_t ulim);
+static int32_t proculog(const char* path, int64_t rnum, int32_t thnum, int64_t ulim,
+                        const char* zkey);
 
 
 // main routine
@@ -78,7 +79,7 @@ static void usage() {
           " [-qs name value] [-tout num] [-ka] url rnum\n", g_progname);
   eprintf("  %s rpc [-th num] [-host str] [-port num] [-tout num] proc rnum [name value ...]\n",
           g_progname);
-  eprintf("  %s ulog [-th num] [-ulim num] path rnum\n", g_progname);
+  eprintf("  %s ulog [-th num] [-ulim num] [-zkey str] path rnum\n", g_progname);
   eprintf("\n");
   std::exit(1);
 }
@@ -221,6 +222,7 @@ static int32_t runulog(int32_t argc, char** argv) {
   const char* rstr = NULL;
   int32_t thnum = 1;
   int64_t ulim = -1;
+  const char* zkey = NULL;
   for (int32_t i = 2; i < argc; i++) {
     if (!argbrk && argv[i][0] == '-') {
       if (!std::strcmp(argv[i], "--")) {
@@ -231,6 +233,9 @@ static int32_t runulog(int32_t argc, char** argv) {
       } else if (!std::strcmp(argv[i], "-ulim")) {
         if (++i >= argc) usage();
         ulim = kc::atoix(argv[i]);
+      } else if (!std::strcmp(argv[i], "-zkey")) {
+        if (++i >= argc) usage();
+        zkey = argv[i];
       } else {
         usage();
       }
@@ -247,7 +252,7 @@ static int32_t runulog(int32_t argc, char** argv) {
   int64_t rnum = kc::atoix(rstr);
   if (rnum < 1 || thnum < 1) usage();
   if (thnum > THREADMAX) thnum = THREADMAX;
-  int32_t rv = proculog(path, rnum, thnum, ulim);
+  int32_t rv = proculog(path, rnum, thnum, ulim, zkey);
   return rv;
 }
 
@@ -507,12 +512,19 @@ static int32_t procrpc(const char* proc, int64_t rnum,
 
 
 // perform ulog command
-static int32_t proculog(const char* path, int64_t rnum, int32_t thnum, int64_t ulim) {
-  oprintf("<Update Logging Test>\n  seed=%u  path=%s  rnum=%lld  thnum=%d  ulim=%lld\n\n",
-          g_randseed, path, (long long)rnum, thnum, (long long)ulim);
+static int32_t proculog(const char* path, int64_t rnum, int32_t thnum, int64_t ulim,
+                        const char* zkey) {
+  oprintf("<Update Logging Test>\n  seed=%u  path=%s  rnum=%lld  thnum=%d  ulim=%lld"
+          "  zkey=%s\n\n", g_randseed, path, (long long)rnum, thnum, (long long)ulim,
+          zkey ? zkey : "");
   bool err = false;
   bool init = !kc::File::status(path);
   kt::UpdateLogger ulog;
+  kc::AESCompressor aescomp;
+  if (zkey) {
+    aescomp.set_key(zkey, std::strlen(zkey));
+    ulog.tune_compressor(&aescomp);
+  }
   if (!ulog.open(path, ulim)) {
     errprint(__LINE__, "opening the logger failed");
     return false;
@@ -580,6 +592,10 @@ static int32_t proculog(const char* path, int64_t rnum, int32_t thnum, int64_t u
           cnt_ += 1;
           delete[] mbuf;
         }
+        if (ulrd.error()) {
+          errprint(__LINE__, "reading a message failed");
+          err_ = true;
+        }
         kc::Thread::sleep(0.1);
       }
       if (!ulrd.close()) {
@@ -632,6 +648,36 @@ static int32_t proculog(const char* path, int64_t rnum, int32_t thnum, int64_t u
     errprint(__LINE__, "closing the logger failed");
     err = true;
   }
+  if (zkey && init) {
+    const std::string& bkey = std::string(zkey) + "x";
+    kc::AESCompressor bcomp;
+    bcomp.set_key(bkey.data(), bkey.size());
+    ulog.tune_compressor(&bcomp);
+    if (ulog.open(path, ulim)) {
+      kt::UpdateLogger::Reader ulrd;
+      if (ulrd.open(&ulog, 0)) {
+        size_t msiz;
+        uint64_t mts;
+        char* mbuf = ulrd.read(&msiz, &mts);
+        if (mbuf || !ulrd.error()) {
+          errprint(__LINE__, "reading a broken message succeeded");
+          err = true;
+        }
+        delete[] mbuf;
+        ulrd.close();
+      } else {
+        errprint(__LINE__, "opening a reader failed");
+        err = true;
+      }
+      if (!ulog.close()) {
+        errprint(__LINE__, "closing the logger failed");
+        err = true;
+      }
+    } else {
+      errprint(__LINE__, "opening the logger failed");
+      err = true;
+    }
+  }
   double etime = kc::time();
   oprintf("time: %.3f\n", etime - stime);
   oprintf("%s\n\n", err ? "error" : "ok");